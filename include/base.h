@@ -17,6 +17,14 @@
 #include <string.h>
 #include <uchar.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h> // madvise, for huge-page arena blocks
+#endif
+
 // =================================================================================================
 // :: Basic Types & Aliases ::
 // =================================================================================================
@@ -59,6 +67,15 @@ typedef ptrdiff_t isize;
 #define BASE_ARENA_DEFAULT_ALIGNMENT (2 * sizeof(usize))
 #endif
 
+#ifndef BASE_ARENA_MAX_BLOCK_SIZE
+#define BASE_ARENA_MAX_BLOCK_SIZE                                              \
+  (64 * 1024 * 1024) // Growable arenas stop doubling blocks past this size
+#endif
+
+#ifndef BASE_ARENA_HUGE_PAGE_SIZE
+#define BASE_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#endif
+
 // =================================================================================================
 // :: Vector Configuration Macros ::
 // =================================================================================================
@@ -88,6 +105,24 @@ typedef ptrdiff_t isize;
   0.7f // Rehash when (item_count + tombstone_count) / bucket_count > this
 #endif
 
+#ifndef BASE_HT_OA_MIGRATE_BUCKETS
+#define BASE_HT_OA_MIGRATE_BUCKETS                                             \
+  8 // Old buckets drained per insert/put/remove while resizing incrementally
+#endif
+
+#ifndef BASE_HT_OA_ZERO_BYTES
+#define BASE_HT_OA_ZERO_BYTES                                                  \
+  4096 // Of the new array zeroed per insert/put/remove before draining starts
+#endif
+
+// =================================================================================================
+// :: Hash Table (Swiss) Configuration Macros ::
+// =================================================================================================
+
+#ifndef BASE_HT_SWISS_DEFAULT_CAPACITY
+#define BASE_HT_SWISS_DEFAULT_CAPACITY 16 // Slots; a power of two >= 16
+#endif
+
 // =================================================================================================
 // :: Useful Constants ::
 // =================================================================================================
@@ -234,15 +269,45 @@ extern LogLevel
 // :: Arena Allocator ::
 // =================================================================================================
 
+// A fixed arena is one block: from arena_init, or a caller's buffer set in
+// 'buffer' and 'total_size'. When it is full, allocations return NULL.
+//
+// A growable arena (arena_init_growable) chains a new block instead, twice
+// the size of the last one up to BASE_ARENA_MAX_BLOCK_SIZE, and at least
+// the size of the request. Allocations never move, so pointers into older
+// blocks stay valid until those blocks are released. Released blocks are
+// kept for reuse until arena_free_all, so an arena reset between statements
+// stops calling malloc once it has grown to the largest one.
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+  ArenaBlock *prev; // Older block, or NULL
+  usize size;       // Usable bytes after the header
+  usize used_before; // Bytes allocated in the older blocks
+};
+
 typedef struct {
-  u8 *buffer;           // The allocated memory block
-  usize total_size;     // Total size of the buffer
-  usize prev_offset;    // Previous allocation offset, for temporary allocations
+  u8 *buffer;           // The current block
+  usize total_size;     // Size of the current block
   usize current_offset; // Current allocation offset from the beginning of the
-                        // buffer
+                        // current block
+  bool is_quiet; // Running out is expected: return NULL without logging
+  // Growable arenas only; NULL for fixed ones.
+  ArenaBlock *block; // Header of the current block
+  ArenaBlock *spare; // Released blocks, linked by 'prev', reused first
+  usize min_block_size;
+  bool huge_pages; // Blocks are 2 MB aligned and advised to use huge pages
 } Arena;
 
+// Position to roll an arena back to. Savepoints nest: taking one, then
+// another, then restoring the inner and the outer one in that order (a stack
+// kept by the callers) works at any depth, across block boundaries.
+typedef struct {
+  ArenaBlock *block;
+  usize offset;
+} ArenaSavepoint;
+
 Arena arena_init(usize total_size_bytes);
+Arena arena_init_growable(usize block_size, bool huge_pages);
 void arena_free_all(Arena *arena);
 void *arena_alloc_aligned(Arena *arena, usize item_size, usize alignment);
 
@@ -250,20 +315,28 @@ static inline void *arena_alloc(Arena *arena, usize item_size) {
   return arena_alloc_aligned(arena, item_size, BASE_ARENA_DEFAULT_ALIGNMENT);
 }
 
-static inline void arena_reset(Arena *arena) {
-  ASSERT(arena);
-  arena->prev_offset = 0;
-  arena->current_offset = 0;
-}
+// Frees everything. A growable arena goes back to its first block.
+void arena_reset(Arena *arena);
 
-static inline void arena_mark_temp(Arena *arena) {
+static inline ArenaSavepoint arena_save(const Arena *arena) {
   ASSERT(arena);
-  arena->prev_offset = arena->current_offset;
+  return (ArenaSavepoint){.block = arena->block,
+                          .offset = arena->current_offset};
 }
 
-static inline void arena_release_temp(Arena *arena) {
+// Frees everything allocated since 'savepoint', and invalidates savepoints
+// taken after it. Returns false, changing nothing, for a savepoint that is not
+// live: from another arena, from a block already released, or past what its
+// block has handed out (e.g. an inner savepoint restored after an outer one).
+// A savepoint into a released block that has since been chained again cannot
+// be told apart from a live one.
+bool arena_restore(Arena *arena, ArenaSavepoint savepoint);
+
+// Bytes allocated, alignment padding included, across all blocks.
+static inline usize arena_used(const Arena *arena) {
   ASSERT(arena);
-  arena->current_offset = arena->prev_offset;
+  return (arena->block ? arena->block->used_before : 0) +
+         arena->current_offset;
 }
 
 // =================================================================================================
@@ -411,6 +484,27 @@ static inline bool sv_equals_cstr(StringView sv, const char *cstr) {
   return memcmp(sv.data, cstr, sv.length) == 0;
 }
 
+// ASCII case-insensitive; 'lower' must be lowercase already.
+static inline bool sv_equals_ignore_case(StringView sv, const char *lower) {
+  usize length = strlen(lower);
+  if (sv.length != length)
+    return false;
+  for (usize i = 0; i < length; ++i) {
+    if (tolower((unsigned char)sv.data[i]) != lower[i])
+      return false;
+  }
+  return true;
+}
+
+// Byte-wise lexicographic order; a proper prefix sorts before the longer view.
+static inline int sv_compare(StringView sv1, StringView sv2) {
+  usize common = sv1.length < sv2.length ? sv1.length : sv2.length;
+  int cmp = common ? memcmp(sv1.data, sv2.data, common) : 0;
+  if (cmp != 0)
+    return cmp;
+  return (sv1.length > sv2.length) - (sv1.length < sv2.length);
+}
+
 static inline StringView sv_slice(StringView sv, usize start, usize end) {
   if (start >= sv.length || !sv.data)
     return (StringView){.data = NULL, .length = 0};
@@ -550,6 +644,24 @@ struct BaseHashTableOA {
 
   Arena *arena; // Optional: if set, 'entries' array (and maybe keys/values) are
                 // allocated from here
+  bool entries_on_heap; // 'entries' came from malloc (freed on rehash)
+
+  // Incremental resize (ht_oa_set_incremental): a rehash allocates the larger
+  // array and leaves the entries where they are. Every insert, put and remove
+  // first zeroes BASE_HT_OA_ZERO_BYTES of the new array, so its pages are
+  // faulted in a few at a time rather than by the scattered writes of the
+  // migration; once it is all zeroed, each one moves
+  // BASE_HT_OA_MIGRATE_BUCKETS old buckets over. Until the old array is
+  // drained a key may be in either one, and lookups probe both.
+  bool incremental;
+  HashTableEntryOA *next_entries; // Array being zeroed, or NULL
+  usize next_bucket_count;
+  usize next_zeroed_count; // Buckets of 'next_entries' zeroed so far
+  HashTableEntryOA *old_entries; // Array being drained, or NULL
+  usize old_bucket_count;
+  usize old_item_count;     // Of item_count, those still in 'old_entries'
+  usize migrate_idx;        // Old buckets below this one are drained
+  bool old_entries_on_heap; // Freed once drained, else left to the arena
 };
 
 // =================================================================================================
@@ -565,6 +677,25 @@ void ht_oa_set_managed_kv(BaseHashTableOA *ht, BaseCopyFunction key_copy_fn,
                           BaseCopyFunction value_copy_fn,
                           BaseFreeFunction value_free_fn);
 
+// Spreads each rehash over the following operations instead of moving every
+// entry at once, bounding the latency of any single insert. Bucket arrays are
+// then always taken from the heap, even with an arena, so a drained array is
+// freed rather than left behind in the arena. Disabling it finishes a resize
+// in progress.
+//
+// Off by default: it trades the tail for the worst case. Inserting 4M random
+// keys (tools/rehash_bench), p99.9 rises from about 1.15 us to 4.6 us, since
+// many more inserts pay for zeroing and migration and lookups probe two
+// arrays mid-resize, while the slowest insert drops from 125 ms to 2.8 ms.
+// Turn it on where one long stall costs more than a slower tail, e.g. a
+// table written under a lock that others wait on.
+//
+// Only insert, put and remove migrate. Lookups take a const table so that
+// readers sharing a lock (as in ConcurrentMap) never write to it; a table
+// that stops being written keeps both arrays, and lookups probe both, until
+// the next write.
+void ht_oa_set_incremental(BaseHashTableOA *ht, bool incremental);
+
 void ht_oa_free(BaseHashTableOA *ht);
 
 bool ht_oa_insert(BaseHashTableOA *ht, const void *key,
@@ -583,15 +714,360 @@ void ht_oa_clear(
 // Iterator for Open Addressing
 typedef struct {
   const BaseHashTableOA *ht;
-  usize current_idx; // Current index in the entries array
+  usize current_idx; // Index in 'entries', then past it in 'old_entries'
 } HashTableIteratorOA;
 
 HashTableIteratorOA ht_oa_iterator_begin(const BaseHashTableOA *ht);
 bool ht_oa_iterator_next(HashTableIteratorOA *iter, const void **out_key,
                          void **out_value);
 
-// (Common hash/equal functions like base_hash_string, base_key_equal_string
-// remain the same)
+// --- Common Hash/Equal Functions ---
+// String and byte hashes read 8 bytes per step (wyhash) and are keyed with a
+// per-process random seed, so clients cannot pick keys that all collide.
+// Hashes therefore differ between runs and must never be stored on disk.
+u64 base_hash_string(const void *key); // Assumes key is const char*
+bool base_key_equal_string(const void *key1, const void *key2);
+u64 base_hash_bytes(const void *key, usize len);
+u64 base_hash_bytes_seeded(const void *key, usize len, u64 seed);
+u64 base_hash_seed(void); // Drawn from /dev/urandom on first use
+void base_hash_set_seed(u64 seed); // For reproducible runs; call before hashing
+u64 base_hash_u64(const void *key); // Assumes key is const u64*
+bool base_key_equal_u64(const void *key1, const void *key2);
+
+// splitmix64 finalizer: spreads dense integer keys (e.g. page ids). Inline so
+// that specialized tables (HT_SWISS_DEFINE) hash without a call.
+static inline u64 base_mix_u64(u64 x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// =================================================================================================
+// :: Hash Table (Swiss) ::
+// =================================================================================================
+
+// Open addressing with the metadata kept apart from the entries: every slot
+// has a control byte holding EMPTY, DELETED or the top 7 bits of its key's
+// hash (the tag). A probe looks at a group of 16 control bytes at once (one
+// SSE2 compare and movemask) and only touches the keys whose tag matches, so
+// a lookup usually reads one control group and one key. Keys and values are
+// kept in separate arrays. Groups are visited in triangular order starting
+// from the one chosen by the low hash bits; the slot count is a power of two,
+// so wrapping around is a mask.
+//
+// HT_SWISS_DECLARE(Name, KeyType, ValueType) declares the table type and its
+// functions, HT_SWISS_DEFINE(Name, KeyType, ValueType, hash_fn, equal_fn)
+// defines them in one translation unit. 'hash_fn' (KeyType -> u64) and
+// 'equal_fn' (KeyType, KeyType -> bool) are inline functions or macros taking
+// keys by value, so they are inlined into the probe loop. Keys and values are
+// copied in; the table does not own what they point to.
+//
+// At most 7/8 of the slots hold a key or a tombstone, so every probe ends at
+// an empty slot. A removed key only leaves a tombstone if its group has no
+// empty slot: a group with an empty slot has never been full, so no probe
+// sequence continues past it.
+#define BASE_HT_SWISS_GROUP_SIZE 16
+#define BASE_HT_SWISS_EMPTY ((u8)0x80)
+#define BASE_HT_SWISS_DELETED ((u8)0xFE)
+#define BASE_HT_SWISS_NOT_FOUND SIZE_MAX
+#define BASE_HT_SWISS_EQUAL(a, b) ((a) == (b)) // equal_fn for scalar keys
+
+// Number of keys a table with 'capacity' slots holds before it grows.
+static inline usize base_swiss_max_load(usize capacity) {
+  return capacity - capacity / 8;
+}
+
+// Smallest capacity that holds 'item_count' keys without growing.
+static inline usize base_swiss_capacity_for(usize item_count) {
+  usize capacity = BASE_HT_SWISS_GROUP_SIZE;
+  while (capacity < BASE_HT_SWISS_DEFAULT_CAPACITY ||
+         base_swiss_max_load(capacity) < item_count) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static inline u8 base_swiss_tag(u64 hash) { return (u8)(hash >> 57); }
+
+// Bit i of the result is set when control byte i of 'group' equals 'ctrl'.
+static inline u32 base_swiss_match(const u8 *group, u8 ctrl) {
+#if defined(__SSE2__)
+  __m128i bytes = _mm_loadu_si128((const __m128i *)(const void *)group);
+  return (u32)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)ctrl)));
+#else
+  u32 mask = 0;
+  for (u32 i = 0; i < BASE_HT_SWISS_GROUP_SIZE; ++i) {
+    mask |= (u32)(group[i] == ctrl) << i;
+  }
+  return mask;
+#endif
+}
+
+// Bit i of the result is set when slot i of 'group' holds no key: EMPTY and
+// DELETED are the only control bytes with the high bit set.
+static inline u32 base_swiss_match_free(const u8 *group) {
+#if defined(__SSE2__)
+  return (u32)_mm_movemask_epi8(
+      _mm_loadu_si128((const __m128i *)(const void *)group));
+#else
+  u32 mask = 0;
+  for (u32 i = 0; i < BASE_HT_SWISS_GROUP_SIZE; ++i) {
+    mask |= (u32)(group[i] >> 7) << i;
+  }
+  return mask;
+#endif
+}
+
+#define HT_SWISS_DECLARE(Name, KeyType, ValueType)                             \
+  typedef struct {                                                             \
+    u8 *ctrl;          /* One control byte per slot */                         \
+    KeyType *keys;     /* Same allocation as 'ctrl' */                         \
+    ValueType *values; /* Same allocation as 'ctrl' */                         \
+    usize capacity;    /* Slots: 0, or a power of two >= 16 */                 \
+    usize size;        /* Keys stored */                                       \
+    usize growth_left; /* Keys that fit in empty slots before a resize */      \
+  } Name;                                                                      \
+                                                                               \
+  /* The table is sized for 'expected_items' keys. If the allocation fails */ \
+  /* its capacity is 0; inserts then try again. */                             \
+  Name ht_##Name##_init(usize expected_items);                                 \
+  void ht_##Name##_free(Name *ht);                                             \
+  void ht_##Name##_clear(Name *ht); /* Keeps the slots */                      \
+  bool ht_##Name##_reserve(Name *ht, usize item_count);                        \
+  ValueType *ht_##Name##_get(const Name *ht, KeyType key);                     \
+  bool ht_##Name##_insert(Name *ht, KeyType key,                               \
+                          ValueType value); /* Fails if key exists */          \
+  bool ht_##Name##_put(Name *ht, KeyType key, ValueType value); /* Upsert */   \
+  /* Returns the value of 'key', adding the key with an uninitialized value */ \
+  /* if it is missing. NULL if the table could not grow. */                    \
+  ValueType *ht_##Name##_emplace(Name *ht, KeyType key, bool *out_inserted);   \
+  bool ht_##Name##_remove(Name *ht, KeyType key);                              \
+  /* Iterates from '*cursor' (start at 0); either output may be NULL. */       \
+  bool ht_##Name##_next(const Name *ht, usize *cursor, KeyType *out_key,       \
+                        ValueType *out_value);                                 \
+                                                                               \
+  static inline usize ht_##Name##_size(const Name *ht) {                       \
+    ASSERT(ht);                                                                \
+    return ht->size;                                                           \
+  }                                                                            \
+                                                                               \
+  static inline bool ht_##Name##_is_empty(const Name *ht) {                    \
+    ASSERT(ht);                                                                \
+    return ht->size == 0;                                                      \
+  }
+
+#define HT_SWISS_DEFINE(Name, KeyType, ValueType, hash_fn, equal_fn)           \
+  static bool ht_##Name##_allocate(Name *ht, usize capacity) {                 \
+    usize keys_offset = ALIGN_UP(capacity, _Alignof(KeyType));                 \
+    usize values_offset = ALIGN_UP(keys_offset + capacity * sizeof(KeyType),   \
+                                   _Alignof(ValueType));                       \
+    u8 *block = (u8 *)malloc(values_offset + capacity * sizeof(ValueType));    \
+    if (!block) {                                                              \
+      LOG_ERROR("Failed to allocate " STRINGIFY(Name) " (capacity %zu)",       \
+                capacity);                                                     \
+      return false;                                                            \
+    }                                                                          \
+    memset(block, BASE_HT_SWISS_EMPTY, capacity);                              \
+    ht->ctrl = block;                                                          \
+    ht->keys = (KeyType *)(void *)(block + keys_offset);                       \
+    ht->values = (ValueType *)(void *)(block + values_offset);                 \
+    ht->capacity = capacity;                                                   \
+    ht->size = 0;                                                              \
+    ht->growth_left = base_swiss_max_load(capacity);                           \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* Slot holding 'key', or BASE_HT_SWISS_NOT_FOUND. */                        \
+  static inline usize ht_##Name##_find(const Name *ht, KeyType key,            \
+                                       u64 hash) {                             \
+    if (ht->size == 0) {                                                       \
+      return BASE_HT_SWISS_NOT_FOUND;                                          \
+    }                                                                          \
+    usize group_mask = ht->capacity / BASE_HT_SWISS_GROUP_SIZE - 1;            \
+    usize group = (usize)hash & group_mask;                                    \
+    u8 tag = base_swiss_tag(hash);                                             \
+    for (usize step = 1;; ++step) {                                            \
+      const u8 *ctrl = ht->ctrl + group * BASE_HT_SWISS_GROUP_SIZE;            \
+      for (u32 match = base_swiss_match(ctrl, tag); match != 0;                \
+           match &= match - 1) {                                               \
+        usize slot = group * BASE_HT_SWISS_GROUP_SIZE +                        \
+                     (usize)__builtin_ctz(match);                              \
+        if (equal_fn(ht->keys[slot], key)) {                                   \
+          return slot;                                                         \
+        }                                                                      \
+      }                                                                        \
+      if (base_swiss_match(ctrl, BASE_HT_SWISS_EMPTY) != 0) {                  \
+        return BASE_HT_SWISS_NOT_FOUND;                                        \
+      }                                                                        \
+      group = (group + step) & group_mask;                                     \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  /* First slot without a key on the probe sequence of 'hash'. */              \
+  static inline usize ht_##Name##_find_free(const Name *ht, u64 hash) {        \
+    usize group_mask = ht->capacity / BASE_HT_SWISS_GROUP_SIZE - 1;            \
+    usize group = (usize)hash & group_mask;                                    \
+    for (usize step = 1;; ++step) {                                            \
+      u32 match =                                                              \
+          base_swiss_match_free(ht->ctrl + group * BASE_HT_SWISS_GROUP_SIZE);  \
+      if (match != 0) {                                                        \
+        return group * BASE_HT_SWISS_GROUP_SIZE + (usize)__builtin_ctz(match); \
+      }                                                                        \
+      group = (group + step) & group_mask;                                     \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  /* Moves every key into a fresh array of 'capacity' slots, which also */     \
+  /* drops the tombstones. */                                                  \
+  static bool ht_##Name##_resize(Name *ht, usize capacity) {                   \
+    Name old = *ht;                                                            \
+    if (!ht_##Name##_allocate(ht, capacity)) {                                 \
+      *ht = old;                                                               \
+      return false;                                                            \
+    }                                                                          \
+    for (usize i = 0; i < old.capacity; ++i) {                                 \
+      if (old.ctrl[i] & BASE_HT_SWISS_EMPTY) {                                 \
+        continue; /* Empty or deleted */                                       \
+      }                                                                        \
+      u64 hash = hash_fn(old.keys[i]);                                         \
+      usize slot = ht_##Name##_find_free(ht, hash);                            \
+      ht->ctrl[slot] = base_swiss_tag(hash);                                   \
+      ht->keys[slot] = old.keys[i];                                            \
+      ht->values[slot] = old.values[i];                                        \
+    }                                                                          \
+    ht->size = old.size;                                                       \
+    ht->growth_left -= old.size;                                               \
+    free(old.ctrl);                                                            \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  Name ht_##Name##_init(usize expected_items) {                                \
+    Name ht;                                                                   \
+    ZERO_STRUCT(ht);                                                           \
+    ht_##Name##_allocate(&ht, base_swiss_capacity_for(expected_items));        \
+    return ht;                                                                 \
+  }                                                                            \
+                                                                               \
+  void ht_##Name##_free(Name *ht) {                                            \
+    ASSERT(ht);                                                                \
+    free(ht->ctrl);                                                            \
+    ZERO_STRUCT(*ht);                                                          \
+  }                                                                            \
+                                                                               \
+  void ht_##Name##_clear(Name *ht) {                                           \
+    ASSERT(ht);                                                                \
+    if (ht->capacity > 0) {                                                    \
+      memset(ht->ctrl, BASE_HT_SWISS_EMPTY, ht->capacity);                     \
+    }                                                                          \
+    ht->size = 0;                                                              \
+    ht->growth_left = base_swiss_max_load(ht->capacity);                       \
+  }                                                                            \
+                                                                               \
+  bool ht_##Name##_reserve(Name *ht, usize item_count) {                       \
+    ASSERT(ht);                                                                \
+    usize capacity = base_swiss_capacity_for(item_count);                      \
+    return capacity <= ht->capacity || ht_##Name##_resize(ht, capacity);       \
+  }                                                                            \
+                                                                               \
+  ValueType *ht_##Name##_get(const Name *ht, KeyType key) {                    \
+    ASSERT(ht);                                                                \
+    usize slot = ht_##Name##_find(ht, key, hash_fn(key));                      \
+    return slot == BASE_HT_SWISS_NOT_FOUND ? NULL : &ht->values[slot];         \
+  }                                                                            \
+                                                                               \
+  ValueType *ht_##Name##_emplace(Name *ht, KeyType key, bool *out_inserted) {  \
+    ASSERT(ht && out_inserted);                                                \
+    *out_inserted = false;                                                     \
+    u64 hash = hash_fn(key);                                                   \
+    usize slot = ht_##Name##_find(ht, key, hash);                              \
+    if (slot != BASE_HT_SWISS_NOT_FOUND) {                                     \
+      return &ht->values[slot];                                                \
+    }                                                                          \
+    slot = ht->capacity > 0 ? ht_##Name##_find_free(ht, hash)                  \
+                            : BASE_HT_SWISS_NOT_FOUND;                         \
+    if (slot == BASE_HT_SWISS_NOT_FOUND ||                                     \
+        (ht->growth_left == 0 && ht->ctrl[slot] == BASE_HT_SWISS_EMPTY)) {     \
+      /* Mostly tombstones: rebuild at the same size instead of doubling. */   \
+      usize capacity =                                                         \
+          ht->capacity == 0 ? base_swiss_capacity_for(0)                       \
+          : ht->size < base_swiss_max_load(ht->capacity) / 2                   \
+              ? ht->capacity                                                   \
+              : ht->capacity * 2;                                              \
+      if (!ht_##Name##_resize(ht, capacity)) {                                 \
+        return NULL;                                                           \
+      }                                                                        \
+      slot = ht_##Name##_find_free(ht, hash);                                  \
+    }                                                                          \
+    if (ht->ctrl[slot] == BASE_HT_SWISS_EMPTY) {                               \
+      ht->growth_left--;                                                       \
+    }                                                                          \
+    ht->ctrl[slot] = base_swiss_tag(hash);                                     \
+    ht->keys[slot] = key;                                                      \
+    ht->size++;                                                                \
+    *out_inserted = true;                                                      \
+    return &ht->values[slot];                                                  \
+  }                                                                            \
+                                                                               \
+  bool ht_##Name##_insert(Name *ht, KeyType key, ValueType value) {            \
+    bool inserted;                                                             \
+    ValueType *slot_value = ht_##Name##_emplace(ht, key, &inserted);           \
+    if (!inserted) {                                                           \
+      return false;                                                            \
+    }                                                                          \
+    *slot_value = value;                                                       \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  bool ht_##Name##_put(Name *ht, KeyType key, ValueType value) {               \
+    bool inserted;                                                             \
+    ValueType *slot_value = ht_##Name##_emplace(ht, key, &inserted);           \
+    if (!slot_value) {                                                         \
+      return false;                                                            \
+    }                                                                          \
+    *slot_value = value;                                                       \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  bool ht_##Name##_remove(Name *ht, KeyType key) {                             \
+    ASSERT(ht);                                                                \
+    usize slot = ht_##Name##_find(ht, key, hash_fn(key));                      \
+    if (slot == BASE_HT_SWISS_NOT_FOUND) {                                     \
+      return false;                                                            \
+    }                                                                          \
+    const u8 *group =                                                          \
+        ht->ctrl + (slot & ~(usize)(BASE_HT_SWISS_GROUP_SIZE - 1));            \
+    if (base_swiss_match(group, BASE_HT_SWISS_EMPTY) != 0) {                   \
+      ht->ctrl[slot] = BASE_HT_SWISS_EMPTY;                                    \
+      ht->growth_left++;                                                       \
+    } else {                                                                   \
+      ht->ctrl[slot] = BASE_HT_SWISS_DELETED;                                  \
+    }                                                                          \
+    ht->size--;                                                                \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  bool ht_##Name##_next(const Name *ht, usize *cursor, KeyType *out_key,       \
+                        ValueType *out_value) {                                \
+    ASSERT(ht && cursor);                                                      \
+    for (usize i = *cursor; i < ht->capacity; ++i) {                           \
+      if (!(ht->ctrl[i] & BASE_HT_SWISS_EMPTY)) {                              \
+        if (out_key) {                                                         \
+          *out_key = ht->keys[i];                                              \
+        }                                                                      \
+        if (out_value) {                                                       \
+          *out_value = ht->values[i];                                          \
+        }                                                                      \
+        *cursor = i + 1;                                                       \
+        return true;                                                           \
+      }                                                                        \
+    }                                                                          \
+    *cursor = ht->capacity;                                                    \
+    return false;                                                              \
+  }
 
 #endif // BASE_H
 
@@ -600,10 +1076,103 @@ bool ht_oa_iterator_next(HashTableIteratorOA *iter, const void **out_key,
 // =================================================================================================
 
 #ifdef BASE_IMPLEMENTATION
+#ifndef BASE_IMPLEMENTATION_INCLUDED // Headers may include base.h again
+#define BASE_IMPLEMENTATION_INCLUDED
 
 LogLevel g_log_level = LOG_LEVEL_INFO; // Default log level
 
 // --- Arena Allocator Implementation ---
+#define BASE_ARENA_BLOCK_HEADER                                                \
+  ALIGN_UP(sizeof(ArenaBlock), BASE_ARENA_DEFAULT_ALIGNMENT)
+
+static inline u8 *arena_block_data(ArenaBlock *block) {
+  return (u8 *)block + BASE_ARENA_BLOCK_HEADER;
+}
+
+// A block with at least 'size' usable bytes, or NULL.
+static ArenaBlock *arena_block_alloc(usize size, bool huge_pages) {
+  usize bytes = BASE_ARENA_BLOCK_HEADER + size;
+  void *memory;
+  if (huge_pages) {
+    bytes = ALIGN_UP(bytes, (usize)BASE_ARENA_HUGE_PAGE_SIZE);
+    memory = aligned_alloc(BASE_ARENA_HUGE_PAGE_SIZE, bytes);
+#if defined(MADV_HUGEPAGE)
+    if (memory) {
+      madvise(memory, bytes, MADV_HUGEPAGE); // Only a hint; failing is fine
+    }
+#endif
+  } else {
+    memory = malloc(bytes);
+  }
+  if (!memory) {
+    return NULL;
+  }
+  ArenaBlock *block = (ArenaBlock *)memory;
+  block->prev = NULL;
+  block->size = bytes - BASE_ARENA_BLOCK_HEADER;
+  block->used_before = 0;
+  return block;
+}
+
+static void arena_use_block(Arena *arena, ArenaBlock *block) {
+  arena->block = block;
+  arena->buffer = arena_block_data(block);
+  arena->total_size = block->size;
+}
+
+// Releases the current block, which must not be the first one.
+static void arena_release_block(Arena *arena) {
+  ArenaBlock *block = arena->block;
+  arena_use_block(arena, block->prev);
+  block->prev = arena->spare;
+  arena->spare = block;
+}
+
+static void arena_free_blocks(ArenaBlock *block) {
+  while (block) {
+    ArenaBlock *prev = block->prev;
+    free(block);
+    block = prev;
+  }
+}
+
+// Chains a block with room for 'item_size' bytes at 'alignment'.
+static bool arena_grow(Arena *arena, usize item_size, usize alignment) {
+  usize needed = item_size + alignment; // Worst-case alignment padding
+  if (needed < item_size) {
+    if (!arena->is_quiet) {
+      LOG_ERROR("Arena out of memory: requested %zu bytes", item_size);
+    }
+    return false;
+  }
+  // Released blocks come back in the order they were first chained.
+  ArenaBlock **link = &arena->spare;
+  while (*link && (*link)->size < needed) {
+    link = &(*link)->prev;
+  }
+  ArenaBlock *block = *link;
+  if (block) {
+    *link = block->prev;
+  } else {
+    usize size = MIN(arena->total_size * 2, (usize)BASE_ARENA_MAX_BLOCK_SIZE);
+    size = MAX(MAX(size, arena->min_block_size), needed);
+    block = arena_block_alloc(size, arena->huge_pages);
+    if (!block) {
+      if (!arena->is_quiet) {
+        LOG_ERROR("Arena out of memory: could not allocate a block of %zu "
+                  "bytes",
+                  size);
+      }
+      return false;
+    }
+  }
+  block->prev = arena->block;
+  block->used_before = arena_used(arena);
+  arena_use_block(arena, block);
+  arena->current_offset = 0;
+  return true;
+}
+
 Arena arena_init(usize total_size_bytes) {
   Arena arena = {0};
   arena.buffer = (u8 *)malloc(total_size_bytes);
@@ -615,32 +1184,100 @@ Arena arena_init(usize total_size_bytes) {
     arena.total_size = total_size_bytes;
   }
   arena.current_offset = 0;
-  arena.prev_offset = 0;
+  return arena;
+}
+
+Arena arena_init_growable(usize block_size, bool huge_pages) {
+  ASSERT(block_size > 0);
+  Arena arena = {0};
+  arena.min_block_size = block_size;
+  arena.huge_pages = huge_pages;
+  ArenaBlock *block = arena_block_alloc(block_size, huge_pages);
+  if (!block) {
+    LOG_FATAL("Failed to allocate memory for Arena (block of %zu bytes)",
+              block_size);
+    return arena;
+  }
+  arena_use_block(&arena, block);
   return arena;
 }
 
 void arena_free_all(Arena *arena) {
   ASSERT(arena);
-  free(arena->buffer);
-  arena->buffer = NULL;
-  arena->total_size = 0;
-  arena->prev_offset = 0;
+  if (arena->block) {
+    arena_free_blocks(arena->block);
+    arena_free_blocks(arena->spare);
+  } else {
+    free(arena->buffer);
+  }
+  ZERO_STRUCT(*arena);
+}
+
+void arena_reset(Arena *arena) {
+  ASSERT(arena);
+  while (arena->block && arena->block->prev) {
+    arena_release_block(arena);
+  }
   arena->current_offset = 0;
 }
 
+bool arena_restore(Arena *arena, ArenaSavepoint savepoint) {
+  ASSERT(arena);
+  // Walk back to the savepoint's block; 'end' is how far each block on the
+  // way was filled, which the next one's used_before records.
+  const ArenaBlock *block = arena->block;
+  usize end = arena->current_offset;
+  while (block != savepoint.block) {
+    if (!block || !block->prev) {
+      LOG_ERROR("Arena savepoint is not from this arena or was released");
+      return false;
+    }
+    end = block->used_before - block->prev->used_before;
+    block = block->prev;
+  }
+  if (savepoint.offset > end) {
+    LOG_ERROR("Arena savepoint at offset %zu is past the %zu bytes in use "
+              "in its block",
+              savepoint.offset, end);
+    return false;
+  }
+  while (arena->block != savepoint.block) {
+    arena_release_block(arena);
+  }
+  arena->current_offset = savepoint.offset;
+  return true;
+}
+
 void *arena_alloc_aligned(Arena *arena, usize item_size, usize alignment) {
   ASSERT(arena);
   ASSERT(alignment > 0 &&
          (alignment & (alignment - 1)) == 0); // Alignment must be power of two
 
-  usize aligned_current_offset = ALIGN_UP(arena->current_offset, alignment);
+  // Align the address rather than the offset: the buffer itself is only
+  // malloc-aligned, which is not enough for e.g. O_DIRECT page buffers.
+  uintptr_t base = (uintptr_t)arena->buffer;
+  usize aligned_current_offset =
+      (usize)(ALIGN_UP(base + arena->current_offset, (uintptr_t)alignment) -
+              base);
   usize new_current_offset = aligned_current_offset + item_size;
 
+  if (new_current_offset > arena->total_size && arena->block) {
+    if (!arena_grow(arena, item_size, alignment)) {
+      return NULL;
+    }
+    base = (uintptr_t)arena->buffer;
+    aligned_current_offset =
+        (usize)(ALIGN_UP(base, (uintptr_t)alignment) - base);
+    new_current_offset = aligned_current_offset + item_size;
+  }
   if (new_current_offset > arena->total_size) {
-    LOG_ERROR("Arena out of memory: requested %zu bytes (aligned to %zu), "
-              "available %zu bytes at offset %zu (aligned %zu)",
-              item_size, alignment, arena->total_size - arena->current_offset,
-              arena->current_offset, aligned_current_offset);
+    if (!arena->is_quiet) {
+      LOG_ERROR("Arena out of memory: requested %zu bytes (aligned to %zu), "
+                "available %zu bytes at offset %zu (aligned %zu)",
+                item_size, alignment,
+                arena->total_size - arena->current_offset,
+                arena->current_offset, aligned_current_offset);
+    }
     return NULL;
   }
 
@@ -1021,6 +1658,118 @@ bool bstr_append_sv(BaseString *bstr, StringView sv) {
   return true;
 }
 
+// --- Hash Table (Open Addressing) Helper: Incremental Rehashing ---
+static HashTableEntryOA *ht_oa_probe(HashTableEntryOA *entries,
+                                     usize bucket_count, u64 hash,
+                                     const void *key,
+                                     BaseKeyEqualFunction key_equal_fn);
+
+// Makes the zeroed 'next_entries' the array entries go to, and the current
+// one the array being drained.
+static void ht_oa_start_draining(BaseHashTableOA *ht) {
+  ht->old_entries = ht->entries;
+  ht->old_bucket_count = ht->bucket_count;
+  ht->old_item_count = ht->item_count;
+  ht->old_entries_on_heap = ht->entries_on_heap;
+  ht->migrate_idx = 0;
+  ht->entries = ht->next_entries;
+  ht->bucket_count = ht->next_bucket_count;
+  ht->tombstone_count = 0;
+  ht->entries_on_heap = true;
+  ht->next_entries = NULL;
+  ht->next_bucket_count = 0;
+  ht->next_zeroed_count = 0;
+}
+
+// One step of a resize: zeroes the next BASE_HT_OA_ZERO_BYTES of the new
+// array until it is ready, then moves the entries of up to 'max_buckets' old
+// buckets into 'entries', and frees the old array once it holds nothing.
+// Moved entries leave tombstones so that the old probe sequences of the
+// remaining keys stay intact. SIZE_MAX finishes the resize.
+static void ht_oa_migrate(BaseHashTableOA *ht, usize max_buckets) {
+  if (ht->next_entries) {
+    usize remaining = ht->next_bucket_count - ht->next_zeroed_count;
+    usize count =
+        max_buckets == SIZE_MAX
+            ? remaining
+            : MIN(remaining, MAX(BASE_HT_OA_ZERO_BYTES /
+                                     sizeof(HashTableEntryOA),
+                                 (usize)1));
+    memset(ht->next_entries + ht->next_zeroed_count, 0,
+           count * sizeof(HashTableEntryOA)); // All HT_ENTRY_EMPTY
+    ht->next_zeroed_count += count;
+    if (ht->next_zeroed_count < ht->next_bucket_count) {
+      return;
+    }
+    ht_oa_start_draining(ht);
+    if (max_buckets != SIZE_MAX) {
+      max_buckets = 0; // Draining starts with the next operation
+    }
+  }
+  if (!ht->old_entries) {
+    return;
+  }
+  for (usize n = 0; n < max_buckets && ht->old_item_count > 0; ++n) {
+    ASSERT(ht->migrate_idx < ht->old_bucket_count);
+    HashTableEntryOA *entry = &ht->old_entries[ht->migrate_idx++];
+    if (entry->state != HT_ENTRY_OCCUPIED) {
+      continue;
+    }
+    usize idx = ht->hash_fn(entry->key) % ht->bucket_count;
+    while (ht->entries[idx].state == HT_ENTRY_OCCUPIED) {
+      idx = (idx + 1) % ht->bucket_count; // Linear probe
+    }
+    if (ht->entries[idx].state == HT_ENTRY_TOMBSTONE) {
+      ht->tombstone_count--;
+    }
+    ht->entries[idx] = *entry;
+    *entry = (HashTableEntryOA){.state = HT_ENTRY_TOMBSTONE};
+    ht->old_item_count--;
+  }
+  if (ht->old_item_count == 0) {
+    if (ht->old_entries_on_heap) {
+      free(ht->old_entries);
+    }
+    ht->old_entries = NULL;
+    ht->old_bucket_count = 0;
+    ht->migrate_idx = 0;
+  }
+}
+
+// Starts a resize into a new array of 'new_bucket_count' buckets, left
+// unzeroed so that no page of it is touched yet. Entries keep going to the
+// current array while the following operations zero the new one, a page or
+// so each, which adds about one entry per page: a small fraction of the
+// headroom the load factor leaves. The current entries are then drained into
+// it; the item count already includes them, so the load factor checks
+// guarantee they fit before the next resize, which first finishes this one.
+static bool ht_oa_begin_migration(BaseHashTableOA *ht,
+                                  usize new_bucket_count) {
+  ht_oa_migrate(ht, SIZE_MAX);
+  HashTableEntryOA *new_entries = (HashTableEntryOA *)malloc(
+      new_bucket_count * sizeof(HashTableEntryOA));
+  if (!new_entries) {
+    LOG_ERROR("Hash table (OA) rehash failed: could not allocate new entries "
+              "array (count %zu).",
+              new_bucket_count);
+    return false;
+  }
+  ht->next_entries = new_entries;
+  ht->next_bucket_count = new_bucket_count;
+  ht->next_zeroed_count = 0;
+  return true;
+}
+
+// The entry of 'key' in the array being drained, or NULL.
+static HashTableEntryOA *ht_oa_find_old(const BaseHashTableOA *ht,
+                                        const void *key) {
+  if (!ht->old_entries || ht->old_item_count == 0) {
+    return NULL;
+  }
+  return ht_oa_probe(ht->old_entries, ht->old_bucket_count, ht->hash_fn(key),
+                     key, ht->key_equal_fn);
+}
+
 // --- Hash Table (Open Addressing) Helper: Rehashing ---
 static bool ht_oa_rehash(BaseHashTableOA *ht, usize new_bucket_count) {
   ASSERT(ht);
@@ -1028,12 +1777,23 @@ static bool ht_oa_rehash(BaseHashTableOA *ht, usize new_bucket_count) {
     new_bucket_count = BASE_HT_OA_DEFAULT_CAPACITY;
   if (new_bucket_count < ht->item_count)
     new_bucket_count = ht->item_count * 2; // Ensure enough space
+  if (ht->incremental && ht->entries) {
+    if (ht->next_entries && new_bucket_count <= ht->next_bucket_count) {
+      // Already resizing: only a full current array cannot wait for it.
+      if (ht->item_count + 1 >= ht->bucket_count) {
+        ht_oa_migrate(ht, SIZE_MAX);
+      }
+      return true;
+    }
+    return ht_oa_begin_migration(ht, new_bucket_count);
+  }
 
   HashTableEntryOA *old_entries = ht->entries;
   usize old_bucket_count = ht->bucket_count;
+  bool old_entries_on_heap = ht->entries_on_heap;
 
   HashTableEntryOA *new_entries_ptr = NULL;
-  if (ht->arena) {
+  if (ht->arena && !ht->incremental) {
     new_entries_ptr = (HashTableEntryOA *)arena_alloc(
         ht->arena, new_bucket_count * sizeof(HashTableEntryOA));
   } else {
@@ -1055,6 +1815,7 @@ static bool ht_oa_rehash(BaseHashTableOA *ht, usize new_bucket_count) {
 
   ht->entries = new_entries_ptr;
   ht->bucket_count = new_bucket_count;
+  ht->entries_on_heap = !ht->arena || ht->incremental;
   ht->item_count = 0;      // Will be recounted
   ht->tombstone_count = 0; // Tombstones are not carried over
 
@@ -1090,7 +1851,7 @@ static bool ht_oa_rehash(BaseHashTableOA *ht, usize new_bucket_count) {
     }
   }
 
-  if (!ht->arena && old_entries) {
+  if (old_entries_on_heap && old_entries) {
     free(old_entries);
   }
   // If old_entries from arena, memory is handled by arena.
@@ -1137,6 +1898,28 @@ static HashTableEntryOA *ht_oa_find_slot(BaseHashTableOA *ht, const void *key,
                                // after full scan.
 }
 
+// Returns the occupied entry holding 'key' in 'entries', or NULL.
+static HashTableEntryOA *ht_oa_probe(HashTableEntryOA *entries,
+                                     usize bucket_count, u64 hash,
+                                     const void *key,
+                                     BaseKeyEqualFunction key_equal_fn) {
+  usize start_idx = hash % bucket_count;
+  usize current_idx = start_idx;
+  do {
+    HashTableEntryOA *entry = &entries[current_idx];
+    if (entry->state == HT_ENTRY_EMPTY) {
+      return NULL; // Key not found
+    } else if (entry->state == HT_ENTRY_OCCUPIED) {
+      if (key_equal_fn(entry->key, key)) {
+        return entry; // Key found
+      }
+    }
+    // If TOMBSTONE, continue probing
+    current_idx = (current_idx + 1) % bucket_count;
+  } while (current_idx != start_idx);
+  return NULL; // Scanned full table
+}
+
 // --- Hash Table (Open Addressing) API Implementation ---
 BaseHashTableOA ht_oa_init(usize initial_bucket_count, BaseHashFunction hash_fn,
                            BaseKeyEqualFunction key_equal_fn,
@@ -1157,6 +1940,7 @@ BaseHashTableOA ht_oa_init(usize initial_bucket_count, BaseHashFunction hash_fn,
   } else {
     ht.entries =
         (HashTableEntryOA *)malloc(ht.bucket_count * sizeof(HashTableEntryOA));
+    ht.entries_on_heap = true;
   }
 
   if (!ht.entries) {
@@ -1185,6 +1969,14 @@ void ht_oa_set_managed_kv(BaseHashTableOA *ht, BaseCopyFunction key_copy_fn,
   ht->value_free_fn = value_free_fn;
 }
 
+void ht_oa_set_incremental(BaseHashTableOA *ht, bool incremental) {
+  ASSERT(ht);
+  if (!incremental) {
+    ht_oa_migrate(ht, SIZE_MAX);
+  }
+  ht->incremental = incremental;
+}
+
 void ht_oa_clear(BaseHashTableOA *ht) {
   ASSERT(ht);
   for (usize i = 0; i < ht->bucket_count; ++i) {
@@ -1198,16 +1990,30 @@ void ht_oa_clear(BaseHashTableOA *ht) {
     ht->entries[i].key = NULL;
     ht->entries[i].value = NULL;
   }
+  for (usize i = 0; ht->old_entries && i < ht->old_bucket_count; ++i) {
+    if (ht->old_entries[i].state == HT_ENTRY_OCCUPIED) {
+      if (ht->key_free_fn && ht->old_entries[i].key)
+        ht->key_free_fn(ht->old_entries[i].key, ht->arena);
+      if (ht->value_free_fn && ht->old_entries[i].value)
+        ht->value_free_fn(ht->old_entries[i].value, ht->arena);
+    }
+  }
   ht->item_count = 0;
   ht->tombstone_count = 0;
+  ht->old_item_count = 0;
+  ht_oa_migrate(ht, 0); // Frees the old array
 }
 
 void ht_oa_free(BaseHashTableOA *ht) {
   ASSERT(ht);
   ht_oa_clear(ht); // Free managed K/V
-  if (!ht->arena && ht->entries) {
+  if (ht->entries_on_heap && ht->entries) {
     free(ht->entries);
   }
+  free(ht->next_entries);
+  ht->next_entries = NULL;
+  ht->next_bucket_count = 0;
+  ht->next_zeroed_count = 0;
   ht->entries = NULL;
   ht->bucket_count = 0;
   // item_count and tombstone_count already zeroed by clear
@@ -1219,6 +2025,7 @@ bool ht_oa_insert(BaseHashTableOA *ht, const void *key, void *value) {
     if (!ht_oa_rehash(ht, BASE_HT_OA_DEFAULT_CAPACITY))
       return false; // Attempt to initialize
   }
+  ht_oa_migrate(ht, BASE_HT_OA_MIGRATE_BUCKETS);
 
   // Check load factor, including tombstones as they affect probe length
   f64 current_load =
@@ -1234,7 +2041,7 @@ bool ht_oa_insert(BaseHashTableOA *ht, const void *key, void *value) {
   bool found_existing;
   HashTableEntryOA *slot = ht_oa_find_slot(ht, key, &found_existing);
 
-  if (found_existing) {
+  if (found_existing || ht_oa_find_old(ht, key)) {
     return false; // Key already exists
   }
 
@@ -1299,6 +2106,7 @@ bool ht_oa_put(BaseHashTableOA *ht, const void *key, void *value) { // Upsert
     if (!ht_oa_rehash(ht, BASE_HT_OA_DEFAULT_CAPACITY))
       return false;
   }
+  ht_oa_migrate(ht, BASE_HT_OA_MIGRATE_BUCKETS);
 
   // Load factor check, similar to insert
   // Add 1 only if key is not present (item_count would increase)
@@ -1316,6 +2124,11 @@ bool ht_oa_put(BaseHashTableOA *ht, const void *key, void *value) { // Upsert
 
   bool found_existing;
   HashTableEntryOA *slot = ht_oa_find_slot(ht, key, &found_existing);
+  HashTableEntryOA *old_slot = found_existing ? NULL : ht_oa_find_old(ht, key);
+  if (old_slot) { // Not migrated yet: update it where it is
+    slot = old_slot;
+    found_existing = true;
+  }
 
   if (found_existing) { // Key exists, update value
     void *old_value = slot->value;
@@ -1392,25 +2205,14 @@ void *ht_oa_get(const BaseHashTableOA *ht, const void *key) {
   if (ht->bucket_count == 0 || ht->item_count == 0)
     return NULL;
 
-  // Need a const version of find_slot or replicate logic carefully
   u64 hash = ht->hash_fn(key);
-  usize start_idx = hash % ht->bucket_count;
-  usize current_idx = start_idx;
-
-  do {
-    const HashTableEntryOA *entry = &ht->entries[current_idx];
-    if (entry->state == HT_ENTRY_EMPTY) {
-      return NULL; // Key not found
-    } else if (entry->state == HT_ENTRY_OCCUPIED) {
-      if (ht->key_equal_fn(entry->key, key)) {
-        return entry->value; // Key found
-      }
-    }
-    // If TOMBSTONE, continue probing
-    current_idx = (current_idx + 1) % ht->bucket_count;
-  } while (current_idx != start_idx);
-
-  return NULL; // Scanned full table
+  const HashTableEntryOA *entry =
+      ht_oa_probe(ht->entries, ht->bucket_count, hash, key, ht->key_equal_fn);
+  if (!entry && ht->old_entries && ht->old_item_count > 0) {
+    entry = ht_oa_probe(ht->old_entries, ht->old_bucket_count, hash, key,
+                        ht->key_equal_fn);
+  }
+  return entry ? entry->value : NULL;
 }
 
 bool ht_oa_contains(const BaseHashTableOA *ht, const void *key) {
@@ -1421,9 +2223,15 @@ bool ht_oa_remove(BaseHashTableOA *ht, const void *key) {
   ASSERT(ht && key);
   if (ht->bucket_count == 0 || ht->item_count == 0)
     return false;
+  ht_oa_migrate(ht, BASE_HT_OA_MIGRATE_BUCKETS);
 
   bool found_existing;
   HashTableEntryOA *slot = ht_oa_find_slot(ht, key, &found_existing);
+  bool in_old = false;
+  if (!found_existing) {
+    slot = ht_oa_find_old(ht, key);
+    found_existing = in_old = slot != NULL;
+  }
 
   if (found_existing && slot && slot->state == HT_ENTRY_OCCUPIED) {
     if (ht->key_free_fn && slot->key)
@@ -1435,7 +2243,11 @@ bool ht_oa_remove(BaseHashTableOA *ht, const void *key) {
     slot->key = NULL;   // Good practice to nullify
     slot->value = NULL; // Good practice
     ht->item_count--;
-    ht->tombstone_count++;
+    if (in_old) {
+      ht->old_item_count--; // Old tombstones are dropped with the array
+    } else {
+      ht->tombstone_count++;
+    }
     return true;
   }
   return false; // Key not found
@@ -1452,14 +2264,30 @@ bool ht_oa_is_empty(const BaseHashTableOA *ht) {
 }
 
 // --- Iterator for Open Addressing ---
+// Indices past the end of 'entries' continue into the array being drained.
+static const HashTableEntryOA *ht_oa_iterator_entry(const BaseHashTableOA *ht,
+                                                    usize idx) {
+  return idx < ht->bucket_count ? &ht->entries[idx]
+                                : &ht->old_entries[idx - ht->bucket_count];
+}
+
+static usize ht_oa_iterator_end(const BaseHashTableOA *ht) {
+  return ht->bucket_count + (ht->old_entries ? ht->old_bucket_count : 0);
+}
+
+static void ht_oa_iterator_skip_free(HashTableIteratorOA *iter) {
+  const BaseHashTableOA *ht = iter->ht;
+  while (iter->current_idx < ht_oa_iterator_end(ht) &&
+         ht_oa_iterator_entry(ht, iter->current_idx)->state !=
+             HT_ENTRY_OCCUPIED) {
+    iter->current_idx++;
+  }
+}
+
 HashTableIteratorOA ht_oa_iterator_begin(const BaseHashTableOA *ht) {
   ASSERT(ht);
   HashTableIteratorOA iter = {.ht = ht, .current_idx = 0};
-  // Advance to first occupied slot
-  while (iter.current_idx < ht->bucket_count &&
-         ht->entries[iter.current_idx].state != HT_ENTRY_OCCUPIED) {
-    iter.current_idx++;
-  }
+  ht_oa_iterator_skip_free(&iter); // Advance to first occupied slot
   return iter;
 }
 
@@ -1467,42 +2295,156 @@ bool ht_oa_iterator_next(HashTableIteratorOA *iter, const void **out_key,
                          void **out_value) {
   ASSERT(iter && iter->ht);
 
-  if (iter->current_idx >= iter->ht->bucket_count) {
+  const BaseHashTableOA *ht = iter->ht;
+  if (iter->current_idx >= ht_oa_iterator_end(ht)) {
     return false; // Already past the end
   }
 
   // Current slot at iter->current_idx is known to be OCCUPIED from previous
   // call or begin
+  const HashTableEntryOA *entry = ht_oa_iterator_entry(ht, iter->current_idx);
   if (out_key)
-    *out_key = iter->ht->entries[iter->current_idx].key;
+    *out_key = entry->key;
   if (out_value)
-    *out_value = iter->ht->entries[iter->current_idx].value;
+    *out_value = entry->value;
 
   // Advance to find the next occupied slot
   iter->current_idx++;
-  while (iter->current_idx < iter->ht->bucket_count &&
-         iter->ht->entries[iter->current_idx].state != HT_ENTRY_OCCUPIED) {
-    iter->current_idx++;
-  }
+  ht_oa_iterator_skip_free(iter);
   return true; // Return true because current item was valid.
-               // If loop finishes and current_idx >= bucket_count, next call
+               // If loop finishes and current_idx reaches the end, next call
                // will return false.
 }
 
 // --- Common Hash/Equal Functions Implementation ---
-#define FNV_OFFSET_BASIS_64 0xCBF29CE484222325ULL
-#define FNV_PRIME_64 0x100000001B3ULL
+// wyhash (final version 4), reading little-endian words with memcpy.
+static const u64 base_wyhash_secret[4] = {
+    0x2D358DCCAA6C78A5ULL, 0x8BB84B93962EACC9ULL, 0x4B33A62ED433D4A3ULL,
+    0x4D5A2DA51DE1AA47ULL};
+
+static u64 g_base_hash_seed = 0; // 0 until drawn or set
+
+static inline void base_wymum(u64 *a, u64 *b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (u64)r;
+  *b = (u64)(r >> 64);
+#else
+  u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+  u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64 t = rl + (rm0 << 32);
+  u64 carry = (u64)(t < rl);
+  u64 lo = t + (rm1 << 32);
+  carry += (u64)(lo < t);
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static inline u64 base_wymix(u64 a, u64 b) {
+  base_wymum(&a, &b);
+  return a ^ b;
+}
+
+static inline u64 base_wyr8(const u8 *p) {
+  u64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline u64 base_wyr4(const u8 *p) {
+  u32 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline u64 base_wyr3(const u8 *p, usize k) {
+  return ((u64)p[0] << 16) | ((u64)p[k >> 1] << 8) | p[k - 1];
+}
+
+u64 base_hash_bytes_seeded(const void *key, usize len, u64 seed) {
+  ASSERT(key || len == 0);
+  const u64 *secret = base_wyhash_secret;
+  const u8 *p = (const u8 *)key;
+  seed ^= base_wymix(seed ^ secret[0], secret[1]);
+  u64 a;
+  u64 b;
+  if (len <= 16) {
+    if (len >= 4) {
+      usize mid = (len >> 3) << 2; // Overlapping reads cover 4..16 bytes
+      a = (base_wyr4(p) << 32) | base_wyr4(p + mid);
+      b = (base_wyr4(p + len - 4) << 32) | base_wyr4(p + len - 4 - mid);
+    } else if (len > 0) {
+      a = base_wyr3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    usize i = len;
+    if (i > 48) { // Three independent lanes keep the multipliers busy
+      u64 see1 = seed;
+      u64 see2 = seed;
+      do {
+        seed = base_wymix(base_wyr8(p) ^ secret[1], base_wyr8(p + 8) ^ seed);
+        see1 = base_wymix(base_wyr8(p + 16) ^ secret[2],
+                          base_wyr8(p + 24) ^ see1);
+        see2 = base_wymix(base_wyr8(p + 32) ^ secret[3],
+                          base_wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = base_wymix(base_wyr8(p) ^ secret[1], base_wyr8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = base_wyr8(p + i - 16); // The last 16 bytes, overlapping if needed
+    b = base_wyr8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  base_wymum(&a, &b);
+  return base_wymix(a ^ secret[0] ^ (u64)len, b ^ secret[1]);
+}
+
+u64 base_hash_seed(void) {
+  u64 seed = __atomic_load_n(&g_base_hash_seed, __ATOMIC_ACQUIRE);
+  if (seed != 0) {
+    return seed;
+  }
+  u64 drawn = 0;
+  FILE *urandom = fopen("/dev/urandom", "rb");
+  if (urandom) {
+    if (fread(&drawn, sizeof(drawn), 1, urandom) != 1) {
+      drawn = 0;
+    }
+    fclose(urandom);
+  }
+  if (drawn == 0) { // No /dev/urandom: fall back on address randomization
+    drawn = base_mix_u64((u64)(uintptr_t)&drawn ^
+                         base_mix_u64((u64)(uintptr_t)&g_base_hash_seed));
+  }
+  drawn |= 1; // Never 0, which means "not drawn yet"
+  // Racing threads must all hash with the seed that won.
+  if (!__atomic_compare_exchange_n(&g_base_hash_seed, &seed, drawn, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return seed;
+  }
+  return drawn;
+}
+
+void base_hash_set_seed(u64 seed) {
+  __atomic_store_n(&g_base_hash_seed, seed | 1, __ATOMIC_RELEASE);
+}
 
 u64 base_hash_string(const void *key) { // Assumes key is const char*
   const char *str = (const char *)key;
-  u64 hash = FNV_OFFSET_BASIS_64;
   if (!str)
-    return hash; // Or a specific hash for NULL if that's a valid distinct key
-  for (const char *p = str; *p; p++) {
-    hash ^= (u64)(*p);
-    hash *= FNV_PRIME_64;
-  }
-  return hash;
+    return 0; // Or a specific hash for NULL if that's a valid distinct key
+  return base_hash_bytes_seeded(str, strlen(str), base_hash_seed());
 }
 
 bool base_key_equal_string(const void *key1,
@@ -1517,13 +2459,16 @@ bool base_key_equal_string(const void *key1,
 }
 
 u64 base_hash_bytes(const void *key, usize len) {
-  const u8 *bytes = (const u8 *)key;
-  u64 hash = FNV_OFFSET_BASIS_64;
-  for (usize i = 0; i < len; ++i) {
-    hash ^= bytes[i];
-    hash *= FNV_PRIME_64;
-  }
-  return hash;
+  return base_hash_bytes_seeded(key, len, base_hash_seed());
+}
+
+u64 base_hash_u64(const void *key) {
+  return base_mix_u64(*(const u64 *)key);
+}
+
+bool base_key_equal_u64(const void *key1, const void *key2) {
+  return *(const u64 *)key1 == *(const u64 *)key2;
 }
 
+#endif // BASE_IMPLEMENTATION_INCLUDED
 #endif // BASE_IMPLEMENTATION
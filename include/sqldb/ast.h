@@ -0,0 +1,221 @@
+#ifndef SQLDB_AST_H
+#define SQLDB_AST_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: AST Types ::
+// =================================================================================================
+
+// Every node is allocated from the arena the statement was parsed into and
+// every name or literal is a view into the query text, so a statement lives
+// exactly as long as both. Lists are singly linked through 'next' and keep
+// their length next to the head.
+
+typedef enum {
+  AST_EXPR_COLUMN,   // [table.]name
+  AST_EXPR_STAR,     // * or table.* in a select list, or COUNT(*)
+  AST_EXPR_INTEGER,
+  AST_EXPR_FLOAT,
+  AST_EXPR_STRING,
+  AST_EXPR_BOOLEAN,
+  AST_EXPR_NULL,
+  AST_EXPR_PARAMETER, // ? or $n placeholder, numbered from 0 in text order
+  AST_EXPR_UNARY,
+  AST_EXPR_BINARY,
+  AST_EXPR_IS_NULL,  // operand IS [NOT] NULL
+  AST_EXPR_FUNCTION, // Scalar or aggregate call, resolved by name later
+} AstExprKind;
+
+typedef enum {
+  AST_OP_OR,
+  AST_OP_AND,
+  AST_OP_NOT,
+  AST_OP_NEGATE,
+  AST_OP_EQUAL,
+  AST_OP_NOT_EQUAL,
+  AST_OP_LESS,
+  AST_OP_LESS_EQUAL,
+  AST_OP_GREATER,
+  AST_OP_GREATER_EQUAL,
+  AST_OP_ADD,
+  AST_OP_SUBTRACT,
+  AST_OP_MULTIPLY,
+  AST_OP_DIVIDE,
+  AST_OP_MODULO,
+} AstOperator;
+
+typedef struct AstExpr AstExpr;
+struct AstExpr {
+  AstExprKind kind;
+  u32 offset;    // Position in the query text, for error messages
+  AstExpr *next; // Next expression of the list this one belongs to
+  union {
+    struct {
+      StringView table; // Empty if unqualified
+      StringView name;  // Unused for AST_EXPR_STAR
+    } column;
+    i64 integer;
+    f64 real;
+    StringView string; // Text between the quotes, '' not yet collapsed
+    bool boolean;
+    u32 parameter;
+    struct {
+      AstOperator op;
+      AstExpr *operand;
+    } unary;
+    struct {
+      AstOperator op;
+      AstExpr *left;
+      AstExpr *right;
+    } binary;
+    struct {
+      AstExpr *operand;
+      bool is_not;
+    } is_null;
+    struct {
+      StringView name;
+      AstExpr *args;
+      u32 arg_count;
+      bool is_distinct;
+    } function;
+  };
+};
+
+typedef struct AstSelectItem AstSelectItem;
+struct AstSelectItem {
+  AstExpr *expr;
+  StringView alias; // Empty without AS
+  AstSelectItem *next;
+};
+
+typedef enum {
+  AST_JOIN_NONE,  // First table of the FROM clause
+  AST_JOIN_CROSS, // Comma-separated table
+  AST_JOIN_INNER,
+  AST_JOIN_LEFT,
+} AstJoinKind;
+
+typedef struct AstTableRef AstTableRef;
+struct AstTableRef {
+  StringView name;
+  StringView alias; // Empty without an alias
+  AstJoinKind join; // How this table joins the ones before it
+  AstExpr *on;      // Join condition, NULL for AST_JOIN_NONE/CROSS
+  AstTableRef *next;
+};
+
+typedef struct AstOrderItem AstOrderItem;
+struct AstOrderItem {
+  AstExpr *expr;
+  bool is_descending;
+  AstOrderItem *next;
+};
+
+typedef struct {
+  AstSelectItem *items;
+  u32 item_count;
+  bool is_distinct;
+  AstTableRef *from; // NULL for SELECT without FROM
+  u32 from_count;
+  AstExpr *where;
+  AstExpr *group_by;
+  u32 group_by_count;
+  AstExpr *having;
+  AstOrderItem *order_by;
+  u32 order_by_count;
+  AstExpr *limit;  // NULL without LIMIT
+  AstExpr *offset; // NULL without OFFSET
+} AstSelect;
+
+typedef struct AstName AstName;
+struct AstName {
+  StringView name;
+  AstName *next;
+};
+
+typedef struct AstInsertRow AstInsertRow;
+struct AstInsertRow {
+  AstExpr *values;
+  u32 value_count;
+  AstInsertRow *next;
+};
+
+typedef struct {
+  StringView table;
+  AstName *columns; // NULL when the column list is omitted
+  u32 column_count;
+  AstInsertRow *rows;
+  u32 row_count;
+} AstInsert;
+
+typedef struct AstAssignment AstAssignment;
+struct AstAssignment {
+  StringView column;
+  AstExpr *value;
+  AstAssignment *next;
+};
+
+typedef struct {
+  StringView table;
+  AstAssignment *assignments;
+  u32 assignment_count;
+  AstExpr *where;
+} AstUpdate;
+
+typedef struct {
+  StringView table;
+  AstExpr *where;
+} AstDelete;
+
+typedef enum {
+  AST_TYPE_INTEGER, // INT, INTEGER, BIGINT
+  AST_TYPE_FLOAT,   // REAL, FLOAT, DOUBLE
+  AST_TYPE_TEXT,    // TEXT, VARCHAR[(n)]
+  AST_TYPE_BOOLEAN,
+} AstDataType;
+
+typedef struct AstColumnDef AstColumnDef;
+struct AstColumnDef {
+  StringView name;
+  AstDataType type;
+  u32 max_length; // VARCHAR(n), 0 if unbounded
+  bool is_not_null;
+  bool is_primary_key;
+  AstColumnDef *next;
+};
+
+typedef struct {
+  StringView table;
+  AstColumnDef *columns;
+  u32 column_count;
+  bool if_not_exists;
+} AstCreateTable;
+
+typedef enum {
+  AST_STMT_SELECT,
+  AST_STMT_INSERT,
+  AST_STMT_UPDATE,
+  AST_STMT_DELETE,
+  AST_STMT_CREATE_TABLE,
+} AstStatementKind;
+
+typedef struct {
+  AstStatementKind kind;
+  u32 parameter_count; // Number of ? placeholders in the statement
+  union {
+    AstSelect select;
+    AstInsert insert;
+    AstUpdate update;
+    AstDelete delete;
+    AstCreateTable create_table;
+  };
+} AstStatement;
+
+// =================================================================================================
+// :: AST API ::
+// =================================================================================================
+
+const char *ast_statement_kind_name(AstStatementKind kind);
+
+#endif // SQLDB_AST_H
@@ -0,0 +1,98 @@
+#ifndef SQLDB_ASYNC_IO_H
+#define SQLDB_ASYNC_IO_H
+
+#include "base.h"
+#include "sqldb/page_file.h"
+
+// =================================================================================================
+// :: Async I/O Types ::
+// =================================================================================================
+
+#define DEFAULT_IO_QUEUE_DEPTH 64
+#define MAX_IO_QUEUE_DEPTH 4096
+
+typedef enum {
+  ASYNC_IO_BACKEND_SYNC = 0,     // pread/pwrite executed at submit time
+  ASYNC_IO_BACKEND_IO_URING = 1, // Linux io_uring, one syscall per batch
+} AsyncIoBackend;
+
+typedef enum {
+  ASYNC_IO_READ = 0,
+  ASYNC_IO_WRITE = 1,
+} AsyncIoOp;
+
+typedef struct {
+  AsyncIoOp op;
+  PageId page_id;
+  u8 *buffer;      // One page; aligned like PageFile buffers
+  void *user_data; // Returned untouched in the completion
+} AsyncIoRequest;
+
+typedef struct {
+  void *user_data;
+  bool ok; // Whole page transferred (reads past EOF are zero-filled)
+} AsyncIoCompletion;
+
+typedef struct {
+  u64 submitted; // Requests handed to the backend
+  u64 completed; // Completions reaped
+  u64 batches;   // Submit calls that carried at least one request
+  u64 failures;  // Completions with ok == false
+} AsyncIoStats;
+
+typedef struct AsyncIoRing AsyncIoRing;
+
+// Page-granular asynchronous I/O against a PageFile. Callers queue requests
+// with async_io_prepare, hand the whole batch to the kernel with a single
+// async_io_submit, then reap completions. At most queue_depth requests can be
+// prepared or in flight at once. Not thread-safe: use one engine per thread.
+typedef struct {
+  AsyncIoBackend backend;
+  PageFile *file;
+  u32 queue_depth;
+
+  AsyncIoRequest *slots; // In-flight requests, indexed by slot
+  u32 *free_slots;       // Stack of unused slot indices
+  u32 free_slot_count;
+  u32 prepared_count; // Queued but not yet submitted
+  u32 *prepared;      // Slots queued by the sync backend
+  u32 *completed;     // Finished slots not yet reaped: sync requests, and
+                      // io_uring ones moved off a full completion queue
+  u32 completed_count;
+
+  AsyncIoRing *ring; // io_uring state, NULL for the sync backend
+  AsyncIoStats stats;
+} AsyncIo;
+
+// =================================================================================================
+// :: Async I/O API ::
+// =================================================================================================
+
+// Sets up the preferred backend, falling back to synchronous pread/pwrite if
+// io_uring is unavailable (old kernel, seccomp, non-Linux build).
+bool async_io_init(AsyncIo *aio, PageFile *file, u32 queue_depth,
+                   AsyncIoBackend preferred);
+
+void async_io_shutdown(AsyncIo *aio);
+
+// Queues a request. Returns false if queue_depth requests are already
+// prepared or in flight; reap some completions first.
+bool async_io_prepare(AsyncIo *aio, const AsyncIoRequest *request);
+
+// Submits every prepared request in one batch. Returns how many were sent;
+// any the kernel did not take stay prepared for the next call.
+u32 async_io_submit(AsyncIo *aio);
+
+// Copies up to 'max' completions into 'out', blocking until at least
+// 'min_complete' are available (clamped to the number in flight).
+u32 async_io_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max,
+                  u32 min_complete);
+
+static inline u32 async_io_in_flight(const AsyncIo *aio) {
+  ASSERT(aio);
+  return aio->queue_depth - aio->free_slot_count - aio->prepared_count;
+}
+
+const char *async_io_backend_name(AsyncIoBackend backend);
+
+#endif // SQLDB_ASYNC_IO_H
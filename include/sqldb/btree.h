@@ -0,0 +1,147 @@
+#ifndef SQLDB_BTREE_H
+#define SQLDB_BTREE_H
+
+#include "base.h"
+#include "sqldb/buffer_pool.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: B+Tree Types ::
+// =================================================================================================
+
+// Every node is one buffer pool page with a sorted slot directory:
+//
+//   +--------+-----------------+-- free --+-------------------+--------+
+//   | header | slot 0 | slot 1 |   space  | entry 1 | entry 0 | prefix |
+//   +--------+-----------------+----------+-------------------+--------+
+//                                         ^free_end           ^prefix_offset
+//
+// An entry is the key bytes followed by a u64 value: the payload in leaves,
+// a child page id in inner nodes. Inner nodes store the prefix shared by all
+// of their separators once, at the end of the page, and only the remaining
+// suffix per entry. Leaves store keys in full so range scans can hand out
+// views straight into the page.
+//
+// Inner node routing: keys below separator 0 go to leftmost_child, keys at or
+// above separator i (and below i + 1) go to the child stored in entry i.
+// Nodes on the same level are chained left to right through right_sibling.
+typedef struct {
+  u32 magic;
+  u16 level;            // 0 for leaves, parents are one above their children
+  u16 count;            // Entries in the slot directory
+  u32 free_end;         // First byte of the entry area
+  u32 dead_bytes;       // Entry area bytes of deleted keys (reclaimed on split)
+  u32 prefix_offset;    // Start of the shared separator prefix (inner nodes)
+  u32 prefix_length;    // 0 in leaves
+  PageId right_sibling; // Next node on this level, or INVALID_PAGE_ID
+  PageId leftmost_child;
+} BTreeNodeHeader;
+
+typedef struct {
+  u16 offset; // Start of the entry within the page
+  u16 length; // Key bytes stored in the entry (suffix length in inner nodes)
+} BTreeSlot;
+
+#define BTREE_NODE_MAGIC 0x42544E44u // "BTND"
+#define BTREE_META_MAGIC 0x42545245u // "BTRE"
+#define BTREE_MIN_PAGE_SIZE 512
+#define BTREE_MAX_PAGE_SIZE 65536
+#define BTREE_MAX_HEIGHT 32
+
+// Optimistic lock of one node in a concurrent tree. The version is even while
+// the node is unlocked and odd while a writer modifies it; unlocking bumps it
+// again. A reader that sees the same even version before and after reading a
+// node has read a consistent copy, otherwise it restarts.
+typedef struct {
+  BufferFrame *frame; // Pinned for as long as concurrency is enabled
+  u64 version;
+} BTreeNodeLatch;
+
+// The latch directory maps PageId -> BTreeNodeLatch in fixed-size chunks, so
+// readers find a node's frame without going through the buffer pool.
+#define BTREE_DIRECTORY_CHUNK_BITS 16
+#define BTREE_DIRECTORY_CHUNK_SIZE (1u << BTREE_DIRECTORY_CHUNK_BITS)
+#define BTREE_DIRECTORY_CHUNKS 65536
+
+typedef struct {
+  u64 lookups;      // Not counted by concurrent readers
+  u64 inserts;      // New keys
+  u64 updates;      // Inserts that replaced the value of an existing key
+  u64 deletes;
+  u64 leaf_splits;
+  u64 inner_splits; // Including root splits
+} BTreeStats;
+
+// A B+tree mapping variable-length byte keys (compared with sv_compare) to u64
+// values. The root page id and height live in a meta page, so a tree is
+// reopened from its meta page id alone. Deleted keys leave their leaf in
+// place; nodes are never merged.
+typedef struct {
+  BufferPool *bp;
+  PageId meta_page_id;
+  PageId root_page_id;
+  u32 height;  // Levels, 1 while the root is a leaf
+  u8 *scratch; // Working space for node rebuilds, page_size-proportional
+  pthread_mutex_t write_lock;      // Serializes writers
+  BTreeNodeLatch **directory;      // Chunks of latches, NULL unless concurrent
+  BTreeNodeLatch *locked[BTREE_MAX_HEIGHT]; // Held by the current writer
+  u32 locked_count;
+  BTreeStats stats;
+} BTree;
+
+// A forward cursor over a leaf level. In a single-threaded tree it holds a pin
+// on the current leaf; in a concurrent tree it reads from a private copy of
+// the leaf, so keys stay valid while writers change the page.
+typedef struct {
+  BTree *tree;
+  BufferFrame *leaf; // Pinned current leaf (single-threaded trees)
+  u8 *snapshot;      // Copy of the current leaf (concurrent trees)
+  const u8 *page;    // Current leaf contents, NULL past the last key
+  u32 index;         // Next slot to return from 'page'
+} BTreeIterator;
+
+// =================================================================================================
+// :: B+Tree API ::
+// =================================================================================================
+
+// Largest key a tree with this page size accepts. Any node can hold at least
+// four entries of this size, which keeps every split well-formed.
+u32 btree_max_key_size(u32 page_size);
+
+// Allocates a meta page and an empty root leaf.
+bool btree_create(BTree *bt, BufferPool *bp);
+
+// Attaches to the tree whose meta page is 'meta_page_id'.
+bool btree_open(BTree *bt, BufferPool *bp, PageId meta_page_id);
+
+void btree_close(BTree *bt);
+
+// Lets lookups and scans run on any number of threads alongside writers,
+// using optimistic lock coupling: readers take no latches and restart when a
+// node they read was modified under them. Writers are serialized by the tree.
+// Every node is pinned from here until btree_close, so the tree must fit in
+// the buffer pool. Call before sharing the tree; while it is shared, the
+// buffer pool must not be used by other threads except through the tree.
+bool btree_enable_concurrency(BTree *bt);
+
+// Returns false if 'key' is not in the tree.
+bool btree_lookup(BTree *bt, StringView key, u64 *out_value);
+
+// Inserts 'key' or, if it is already present, replaces its value.
+bool btree_insert(BTree *bt, StringView key, u64 value);
+
+// Returns false if 'key' is not in the tree.
+bool btree_delete(BTree *bt, StringView key);
+
+// Positions 'it' on the first key >= 'start'. Pass an empty view to scan the
+// whole tree. The iterator must be closed with btree_iter_close.
+bool btree_seek(BTree *bt, StringView start, BTreeIterator *it);
+
+// Returns the next key and value, or false at the end of the tree. The key
+// points into the current leaf and stays valid until the next call.
+bool btree_iter_next(BTreeIterator *it, StringView *out_key, u64 *out_value);
+
+void btree_iter_close(BTreeIterator *it);
+
+#endif // SQLDB_BTREE_H
@@ -0,0 +1,112 @@
+#ifndef SQLDB_BUFFER_POOL_H
+#define SQLDB_BUFFER_POOL_H
+
+#include "base.h"
+#include "sqldb/async_io.h"
+#include "sqldb/eviction.h"
+#include "sqldb/page_file.h"
+#include "sqldb/wal.h"
+
+// =================================================================================================
+// :: Buffer Pool Types ::
+// =================================================================================================
+
+typedef struct {
+  PageId page_id; // Page currently held by this frame (key in the page table)
+  u8 *data;       // page_size bytes: an arena frame, or the file mapping
+  Lsn page_lsn;   // Last WAL record that modified the page (write-back gate)
+  u32 pin_count;  // Number of active users; pinned frames are never evicted
+  bool is_dirty;  // Frame differs from the on-disk page and must be written
+  bool is_valid;  // Frame holds a page (false for never-used frames)
+} BufferFrame;
+
+// PageId -> BufferFrame* of every resident page.
+HT_SWISS_DECLARE(PageTable, PageId, BufferFrame *)
+
+typedef struct {
+  u64 hits;       // Fetches served from a resident frame
+  u64 misses;     // Fetches that had to read the page from disk
+  u64 evictions;  // Valid frames that were recycled for another page
+  u64 writebacks; // Dirty frames written back to disk
+  u64 prefetches; // Pages loaded ahead of use by bp_prefetch_pages
+} BufferPoolStats;
+
+typedef struct {
+  BufferFrame *frames;        // Frame descriptors, allocated from the arena
+  usize frame_count;          // Number of frames in the pool
+  usize *free_frames;         // Stack of frames that hold no page
+  usize free_frame_count;
+  u32 page_size;              // Size of every page/frame in bytes
+  PageId page_count;          // Number of pages in the database file
+  PageTable page_table;       // Resident pages
+  EvictionPolicy eviction;    // Chooses which unpinned frame to recycle
+  PageFile *file;             // Backing database file (not owned)
+  bool is_mapped;             // Frames point into file->map, no page copies
+  AsyncIo *io;                // Optional: batches readahead and writeback
+  Wal *wal;                   // Optional: flushed up to page_lsn first
+  FILE *trace_file; // Optional: every fetched page id is appended here
+  BufferPoolStats stats;
+} BufferPool;
+
+// =================================================================================================
+// :: Buffer Pool API ::
+// =================================================================================================
+
+// Number of arena bytes bp_init needs to carve 'frame_count' frames. Mapped
+// pools only need the frame descriptors, not the page data.
+usize bp_required_arena_size(usize frame_count, u32 page_size,
+                             EvictionPolicyKind eviction, bool is_mapped);
+
+// If 'file' is memory-mapped (pf_map), the pool serves pages straight from
+// the mapping: frames only track pins and residency, and pages are read-only.
+bool bp_init(BufferPool *bp, Arena *arena, usize frame_count, u32 page_size,
+             EvictionPolicyKind eviction, PageFile *file);
+
+void bp_shutdown(BufferPool *bp);
+
+// Returns the pinned frame holding 'page_id', reading it from disk on a miss.
+// Returns NULL if every frame is pinned or the read fails.
+BufferFrame *bp_fetch_page(BufferPool *bp, PageId page_id);
+
+// Appends a zeroed page to the database file and returns its pinned frame.
+// Fails for mapped pools.
+BufferFrame *bp_new_page(BufferPool *bp, PageId *out_page_id);
+
+// Routes readahead and bp_flush_all through 'io' (not owned). Without it,
+// prefetching is a no-op and writeback issues one pwrite per page.
+void bp_set_async_io(BufferPool *bp, AsyncIo *io);
+
+// Loads up to 'count' pages starting at 'first_page_id' into unpinned frames
+// as one batch of asynchronous reads. Resident pages are skipped. Returns the
+// number of pages read. Mapped pools instead ask the kernel to read the range
+// ahead (MADV_WILLNEED) and return the number of pages covered.
+u32 bp_prefetch_pages(BufferPool *bp, PageId first_page_id, u32 count);
+
+// Enforces write-ahead logging against 'wal' (not owned): a dirty page is only
+// written back once the log is durable up to its page_lsn.
+void bp_set_wal(BufferPool *bp, Wal *wal);
+
+// Logs bytes [offset, offset + length) of the pinned 'frame', which the caller
+// has just modified for 'txn_id', and stamps the frame with the record's LSN.
+// The frame is marked dirty. Returns INVALID_LSN if the record could not be
+// logged or no WAL is attached.
+Lsn bp_log_page_write(BufferPool *bp, BufferFrame *frame, u64 txn_id,
+                      u32 offset, u32 length);
+
+// Records every page id passed to bp_fetch_page, one per line, in the format
+// read by tools/cache_replay.c. Pass NULL to stop recording.
+void bp_set_trace_file(BufferPool *bp, FILE *trace_file);
+
+void bp_unpin_page(BufferPool *bp, BufferFrame *frame, bool is_dirty);
+
+bool bp_flush_page(BufferPool *bp, BufferFrame *frame);
+bool bp_flush_all(BufferPool *bp);
+
+// True if a pinned frame is dirty, i.e. may hold changes that are not
+// committed yet. Flushing such a pool would make them permanent.
+bool bp_has_pinned_dirty_page(const BufferPool *bp);
+
+f64 bp_hit_ratio(const BufferPool *bp);
+void bp_log_stats(const BufferPool *bp);
+
+#endif // SQLDB_BUFFER_POOL_H
@@ -0,0 +1,22 @@
+#ifndef SQLDB_CHECKSUM_H
+#define SQLDB_CHECKSUM_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Checksum API ::
+// =================================================================================================
+
+// CRC-32C (Castagnoli), the checksum used for WAL records. Pass 0 as 'crc' to
+// start a new checksum, or a previous result to extend it over more bytes.
+// Uses the SSE4.2 crc32 instruction when the CPU has it.
+u32 crc32c(u32 crc, const void *data, usize len);
+
+// The same checksum from a lookup table, one byte per step. crc32c() falls
+// back on it without SSE4.2.
+u32 crc32c_portable(u32 crc, const void *data, usize len);
+
+// Whether crc32c() runs on the crc32 instruction.
+bool crc32c_is_hardware(void);
+
+#endif // SQLDB_CHECKSUM_H
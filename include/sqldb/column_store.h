@@ -0,0 +1,192 @@
+#ifndef SQLDB_COLUMN_STORE_H
+#define SQLDB_COLUMN_STORE_H
+
+#include "base.h"
+#include "sqldb/buffer_pool.h"
+
+// =================================================================================================
+// :: Column Store Types ::
+// =================================================================================================
+
+// An append-only table for analytic scans. Rows are cut into row groups of
+// COLUMN_GROUP_ROWS rows and every column of a group is stored as one chunk:
+// a header with the chunk's zone map (min, max and NULL count), a NULL
+// bitmap and the values in whichever of the encodings below is smallest for
+// them. A chunk spans as many consecutive pages of the buffer pool as it
+// needs. Scans read only the columns they use and skip whole row groups whose
+// zone maps rule out the predicate.
+//
+// Chunk layout; every section starts on an 8-byte boundary:
+//
+//   +--------------------+-------------+----------------------------------+
+//   | ColumnChunkHeader  | NULL bitmap | payload (depends on the encoding) |
+//   +--------------------+-------------+----------------------------------+
+//
+// The bitmap is only present if the chunk has NULLs. NULL rows are encoded
+// as a copy of the previous value (an empty string for strings) so they do
+// not break runs or widen bit widths, and are decoded as 0 or "".
+#define COLUMN_GROUP_ROWS 65536
+#define COLUMN_ZONE_STRING_BYTES 24 // Prefix of string bounds that is kept
+#define COLUMN_CHUNK_MAGIC 0x434F4C43u // "COLC"
+
+typedef enum {
+  COLUMN_TYPE_INT64,
+  COLUMN_TYPE_FLOAT64,
+  COLUMN_TYPE_STRING,
+} ColumnType;
+
+typedef enum {
+  // Values as they are: 8 bytes per number; strings as u32 offsets[rows + 1]
+  // followed by the bytes.
+  COLUMN_ENCODING_PLAIN,
+  // u32 value count and bit width, the distinct values (stored like PLAIN),
+  // then one bit-packed code per row.
+  COLUMN_ENCODING_DICTIONARY,
+  // u32 run count, the value of every run (stored like PLAIN), then the u32
+  // length of every run.
+  COLUMN_ENCODING_RLE,
+  // Frame of reference, integers only: the minimum as an i64 and a bit width,
+  // then every value minus the minimum, bit-packed.
+  COLUMN_ENCODING_FOR,
+  COLUMN_ENCODING_COUNT,
+} ColumnEncoding;
+
+typedef struct {
+  u8 length;
+  char bytes[COLUMN_ZONE_STRING_BYTES];
+} ColumnZoneString;
+
+// Bounds of the non-NULL values of a chunk. String minimums longer than
+// COLUMN_ZONE_STRING_BYTES are cut, which keeps them a lower bound; a
+// maximum that long has no shorter upper bound and is dropped.
+typedef struct {
+  u32 null_count;
+  bool has_bounds; // False if every value is NULL or a float is NaN
+  bool has_max;    // Only ever false for strings
+  union {
+    i64 i64;
+    f64 f64;
+    ColumnZoneString string;
+  } min, max;
+} ColumnZoneMap;
+
+typedef struct {
+  u32 magic;
+  u8 type;     // ColumnType
+  u8 encoding; // ColumnEncoding
+  u16 reserved;
+  u32 row_count;
+  u32 byte_length; // Whole chunk, header included
+  ColumnZoneMap zone;
+} ColumnChunkHeader;
+
+// Where a chunk lives and what its header says, kept in memory so planning a
+// scan reads no pages.
+typedef struct {
+  PageId first_page;
+  u32 page_count;
+  u32 byte_length;
+  ColumnEncoding encoding;
+  ColumnZoneMap zone;
+} ColumnChunkInfo;
+
+typedef struct {
+  u32 row_count;
+  ColumnChunkInfo *chunks; // One per column
+} ColumnRowGroup;
+
+// Rows appended since the last flush, one buffer per column.
+typedef struct {
+  u8 *values;  // i64 or f64 per row; u32 offsets[rows + 1] for strings
+  char *bytes; // String bytes
+  usize byte_count;
+  usize byte_capacity;
+  u8 *nulls;   // COLUMN_GROUP_ROWS bits, set for NULL rows
+  u32 null_count;
+} ColumnBuffer;
+
+typedef struct {
+  u64 row_groups;
+  u64 chunks[COLUMN_ENCODING_COUNT]; // Chunks written with each encoding
+  u64 plain_bytes;   // What the chunks would take in PLAIN encoding
+  u64 encoded_bytes; // What they take, headers and bitmaps included
+} ColumnTableStats;
+
+// The row group directory lives in memory and is rebuilt after a restart by
+// re-adding every group's chunks with column_table_add_row_group.
+typedef struct {
+  BufferPool *bp;
+  ColumnType *types;
+  u32 column_count;
+  ColumnRowGroup *groups;
+  u32 group_count;
+  u32 group_capacity;
+  u64 row_count; // Flushed rows
+  ColumnBuffer *pending;
+  u32 pending_rows;
+  u8 *scratch; // Chunk being encoded
+  usize scratch_capacity;
+  ColumnTableStats stats;
+} ColumnTable;
+
+// One column of the rows passed to column_table_append.
+typedef struct {
+  const void *values; // i64, f64 or StringView per row
+  const u8 *nulls;    // Bitmap, bit set for NULL rows; NULL if there are none
+} ColumnInput;
+
+// Decodes one chunk of a row group, front to back. The chunk is copied out of
+// the buffer pool on open, so the reader holds no pins.
+typedef struct {
+  const ColumnChunkHeader *header;
+  const u8 *nulls;    // NULL bitmap, NULL if the chunk has none
+  const u8 *values;   // PLAIN values, dictionary or run values
+  const u8 *packed;   // Dictionary codes or FOR offsets
+  const u32 *lengths; // RLE run lengths
+  u32 value_count;    // Entries in 'values'
+  u32 bit_width;
+  i64 base;           // FOR minimum
+  u32 position;       // Next row to decode
+  u32 run;            // RLE: run holding 'position'
+  u32 run_left;       // RLE: rows of that run not decoded yet
+} ColumnReader;
+
+// =================================================================================================
+// :: Column Store API ::
+// =================================================================================================
+
+bool column_table_init(ColumnTable *table, BufferPool *bp,
+                       const ColumnType *types, u32 column_count);
+
+void column_table_free(ColumnTable *table);
+
+// Buffers 'row_count' rows, one ColumnInput per column, and writes a row
+// group every COLUMN_GROUP_ROWS rows. Strings are copied.
+bool column_table_append(ColumnTable *table, const ColumnInput *columns,
+                         u32 row_count);
+
+// Writes the buffered rows as a final, shorter row group.
+bool column_table_flush(ColumnTable *table);
+
+// Registers an existing row group (e.g. after a restart) from the first page
+// of each of its chunks, in column order.
+bool column_table_add_row_group(ColumnTable *table, const PageId *first_pages);
+
+// Positions 'reader' at the first row of chunk 'column' of row group 'group'.
+// 'buffer' receives a copy of the chunk and must hold at least its
+// byte_length; it backs the strings the reader returns.
+bool column_reader_open(ColumnReader *reader, const ColumnTable *table,
+                        u32 group, u32 column, u8 *buffer);
+
+// Decodes the next 'count' rows into 'out' (i64, f64 or StringView per row).
+// If 'out_nulls' is not NULL, out_nulls[i] is set for every NULL row and left
+// alone otherwise, so the NULLs of several columns can be merged.
+void column_reader_read(ColumnReader *reader, u32 count, void *out,
+                        bool *out_nulls);
+
+// Moves past the next 'count' rows without decoding them.
+void column_reader_skip(ColumnReader *reader, u32 count);
+
+const char *column_encoding_name(ColumnEncoding encoding);
+
+#endif // SQLDB_COLUMN_STORE_H
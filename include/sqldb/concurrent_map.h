@@ -0,0 +1,79 @@
+#ifndef SQLDB_CONCURRENT_MAP_H
+#define SQLDB_CONCURRENT_MAP_H
+
+#include "base.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: Concurrent Map Types ::
+// =================================================================================================
+
+// A hash map shared by threads, split into a power-of-two number of shards
+// that each hold a BaseHashTableOA behind a reader-writer lock. The top bits
+// of the key's hash pick the shard and the low bits the bucket inside it, so
+// lookups of different keys rarely touch the same lock and lookups of the
+// same shard run in parallel. With cmap_set_incremental, shards resize
+// incrementally, so a writer never holds a shard for a full rehash.
+//
+// Keys and values are stored as given, like an unmanaged BaseHashTableOA:
+// the caller keeps a key alive while it is in the map, and owns the values.
+// A value returned by cmap_get may be removed by another thread right after,
+// so freeing values needs the caller's own protocol (e.g. reference counts).
+#define CMAP_DEFAULT_SHARDS 64
+#define CMAP_MAX_SHARDS 4096
+#define CMAP_CACHE_LINE 64
+
+typedef struct {
+  // Aligned so that neighbouring shards' locks do not share a cache line.
+  _Alignas(CMAP_CACHE_LINE) pthread_rwlock_t lock;
+  BaseHashTableOA table;
+} CMapShard;
+
+typedef struct {
+  CMapShard *shards;
+  u32 shard_count; // Power of two
+  u32 shard_shift; // 64 - log2(shard_count)
+  BaseHashFunction hash_fn;
+} ConcurrentMap;
+
+// =================================================================================================
+// :: Concurrent Map API ::
+// =================================================================================================
+
+// 'shard_count' is rounded up to a power of two (CMAP_DEFAULT_SHARDS if 0).
+// 'capacity' is the expected number of keys, spread over the shards.
+bool cmap_init(ConcurrentMap *map, u32 shard_count, usize capacity,
+               BaseHashFunction hash_fn, BaseKeyEqualFunction key_equal_fn);
+
+// Must not race with any other call.
+void cmap_free(ConcurrentMap *map);
+
+// Applies ht_oa_set_incremental to every shard. Off by default; must not race
+// with any other call.
+void cmap_set_incremental(ConcurrentMap *map, bool incremental);
+
+// Returns false if 'key' is already present (or on allocation failure).
+bool cmap_insert(ConcurrentMap *map, const void *key, void *value);
+
+// Inserts or replaces. Stores the replaced value in 'out_old_value' (NULL if
+// there was none) when it is not NULL.
+bool cmap_put(ConcurrentMap *map, const void *key, void *value,
+              void **out_old_value);
+
+// Value of 'key', or NULL.
+void *cmap_get(const ConcurrentMap *map, const void *key);
+
+bool cmap_contains(const ConcurrentMap *map, const void *key);
+
+// Stores the removed value in 'out_value' when it is not NULL, so that the
+// thread that removed it is the one to free it.
+bool cmap_remove(ConcurrentMap *map, const void *key, void **out_value);
+
+// Sum of the shard sizes, each read under its lock; only a snapshot while
+// other threads write.
+usize cmap_size(const ConcurrentMap *map);
+
+void cmap_clear(ConcurrentMap *map);
+
+#endif // SQLDB_CONCURRENT_MAP_H
@@ -2,6 +2,9 @@
 #define SQLDB_DATABASE_H
 
 #include "base.h"
+#include "sqldb/buffer_pool.h"
+#include "sqldb/plan_cache.h"
+#include "sqldb/scheduler.h"
 
 // =================================================================================================
 // :: Database Configuration ::
@@ -11,14 +14,26 @@
 #define DEFAULT_PAGE_SIZE 4096
 #define DEFAULT_CACHE_SIZE_MB 64
 #define DEFAULT_PORT 5432
+#define DEFAULT_MAX_CONNECTIONS 65536
+#define MAX_CONNECTIONS_LIMIT 1048576
 
 typedef struct {
   char *db_file_path;
   u32 page_size;
   u32 cache_size_mb;
   u16 port;
+  u32 max_connections; // Clients served at once; more are closed on accept
   bool enable_wal;
-  bool read_only;
+  u32 commit_window_us;  // Group commit: max wait for a batch to gather
+  u32 commit_batch_size; // Group commit: flush early once this many wait
+  bool read_only; // Also serves pages from a read-only mmap of the file
+  bool direct_io;
+  u32 io_queue_depth; // Max asynchronous page reads/writes in flight
+  EvictionPolicyKind eviction_policy;
+  PageAccessHint mmap_advice; // madvise hint for read-only mappings
+  char *page_trace_path; // Optional: record page accesses for cache_replay
+  u32 plan_cache_entries; // Max number of cached statement plans
+  u32 worker_threads;     // Query workers; 0 starts one per online core
   LogLevel log_level;
 } DatabaseConfig;
 
@@ -31,10 +46,15 @@ bool db_config_from_args(DatabaseConfig *config, int argc, char **argv);
 // =================================================================================================
 
 typedef struct {
-  FILE *db_file;
+  PageFile db_file;
+  Wal wal; // Open only when config->enable_wal
+  AsyncIo io;
   Arena main_arena;
-  Arena temp_arena;
-  BaseHashTableOA page_cache;
+  Arena temp_arena; // Growable; scope temporaries with arena_save/restore
+  BufferPool page_cache;
+  PlanCache plan_cache; // Normalized statement -> parsed plan
+  Scheduler scheduler;  // Runs parallel operators; one arena per worker
+  u64 next_txn_id; // Transaction ids when the WAL is disabled
   bool is_initialized;
   const DatabaseConfig *config;
 } Database;
@@ -43,4 +63,24 @@ bool db_init(Database *db, const DatabaseConfig *config);
 
 void db_shutdown(Database *db);
 
+// Returns a new transaction id for logging page writes (bp_log_page_write).
+u64 db_begin_txn(Database *db);
+
+// Makes the changes of 'txn_id' durable. With the WAL this only waits for the
+// log flush, plus a checkpoint once the log outgrows checkpoint_bytes; without
+// it every dirty page is written back and synced.
+bool db_commit(Database *db, u64 txn_id);
+
+// Writes back every dirty page, syncs the data file and truncates the WAL.
+// Skipped (returning true) while a pinned page is dirty, since redo-only
+// recovery could not take its uncommitted changes back out of the data file.
+bool db_checkpoint(Database *db);
+
+// Returns the plan for 'sql' from the plan cache, parsing it only the first
+// time its shape is seen; the values of its literals are returned in
+// 'out_params'. Both live in temp_arena until the statement finishes.
+const PreparedStatement *db_prepare(Database *db, StringView sql,
+                                    SqlParams *out_params,
+                                    SqlParseError *out_error);
+
 #endif // SQLDB_DATABASE_H
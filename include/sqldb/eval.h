@@ -0,0 +1,103 @@
+#ifndef SQLDB_EVAL_H
+#define SQLDB_EVAL_H
+
+#include "base.h"
+#include "sqldb/ast.h"
+#include "sqldb/plan_cache.h"
+#include "sqldb/value.h"
+
+// =================================================================================================
+// :: Eval Types ::
+// =================================================================================================
+
+// Runs SELECT without FROM, the only rows there are until the catalog
+// lands: expressions over literals and parameters, and the set-returning
+// generate_series(start, stop[, step]) in the select list. eval_plan checks
+// a prepared statement and works out its column types before any row is
+// produced; rows are then evaluated one at a time by their position in the
+// row source, so a caller can stop after any row and resume later. Errors
+// carry the SQLSTATE PostgreSQL reports for them.
+
+// Result and parameter types; every value of a column has its column's type.
+typedef enum {
+  EVAL_TYPE_UNKNOWN, // Untyped parameters and NULL
+  EVAL_TYPE_INT8,
+  EVAL_TYPE_FLOAT8,
+  EVAL_TYPE_TEXT,
+  EVAL_TYPE_BOOL,
+} EvalType;
+
+typedef struct {
+  const char *code; // SQLSTATE
+  char message[192];
+  u32 position; // 1-based character of the query it points at, 0 for none
+} SqlError;
+
+// What a statement is run with besides its text: the placeholders found in
+// it and the values bound to them, and what the session functions return.
+typedef struct {
+  const u16 *placeholders; // n - 1 of every $n, in text order
+  u32 placeholder_count;
+  const SqlValue *values; // One per $n; NULL when only describing
+  const EvalType *types;  // Declared type of every $n, may be NULL
+  u32 value_count;
+  const char *database; // current_database()
+  const char *version;  // version()
+} EvalSource;
+
+typedef struct {
+  const SqlValue *params; // Value of every AST parameter
+  u32 param_count;
+  const AstExpr *series; // The generate_series call being expanded, or NULL
+  i64 series_value;
+  const char *database;
+  const char *version;
+  Arena *arena; // Collapsed string literals
+  SqlError *error;
+} EvalContext;
+
+typedef struct {
+  const AstSelect *select;
+  SqlValue *params; // One per AST parameter
+  EvalType *param_types;
+  u32 param_count;
+  EvalType *column_types;
+  u32 column_count;
+  u64 row_count; // Rows of the row source: 1 without generate_series
+  i64 series_start;
+  i64 series_step;
+  u64 offset;
+  u64 limit; // UINT64_MAX without LIMIT
+  EvalContext eval;
+} EvalPlan;
+
+// =================================================================================================
+// :: Eval API ::
+// =================================================================================================
+
+void sql_error_set(SqlError *error, const char *code, u32 position,
+                   const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+// Checks 'statement' (prepared with 'slots' as the values of its literals),
+// binds its parameters and works out the columns. Allocates from 'arena',
+// which must outlive the plan.
+bool eval_plan(Arena *arena, const AstStatement *statement,
+               const SqlParams *slots, const EvalSource *source,
+               EvalPlan *plan, SqlError *error);
+
+// Evaluates what bounds the rows: the generate_series arguments, LIMIT and
+// OFFSET. Describing a statement needs only eval_plan.
+bool eval_plan_rows(EvalPlan *plan, SqlError *error);
+
+// Moves to row 'row' of the row source and evaluates WHERE on it; rows it
+// rejects have '*out_keep' false.
+bool eval_row(EvalPlan *plan, u64 row, bool *out_keep, SqlError *error);
+
+// Evaluates a select item of the plan on the current row.
+bool eval_select_item(EvalPlan *plan, const AstExpr *expr, SqlValue *out,
+                      SqlError *error);
+
+// The PostgreSQL name of the type of values of 'kind'.
+const char *eval_value_type_name(SqlValueKind kind);
+
+#endif // SQLDB_EVAL_H
@@ -0,0 +1,87 @@
+#ifndef SQLDB_EVICTION_H
+#define SQLDB_EVICTION_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Eviction Policy Types ::
+// =================================================================================================
+
+typedef enum {
+  EVICTION_POLICY_CLOCK = 0, // Second-chance CLOCK sweep
+  EVICTION_POLICY_2Q = 1,    // Scan-resistant 2Q (A1in / A1out / Am queues)
+} EvictionPolicyKind;
+
+#define DEFAULT_EVICTION_POLICY EVICTION_POLICY_2Q
+
+// Tells a policy whether a frame may be evicted now (e.g. it is unpinned).
+typedef bool (*EvictionCanEvictFunction)(usize frame_idx, void *ctx);
+
+// Policies only track frame indices (and, for history-based policies, the page
+// ids that passed through them). The buffer pool owns the frames themselves.
+typedef struct {
+  const char *name;
+  // A page was loaded into a frame that the policy did not track.
+  void (*on_insert)(void *state, usize frame_idx, u64 page_id);
+  // A resident page was accessed again.
+  void (*on_access)(void *state, usize frame_idx);
+  // Picks and forgets a victim among the tracked frames accepted by can_evict.
+  bool (*pick_victim)(void *state, EvictionCanEvictFunction can_evict,
+                      void *ctx, usize *out_frame_idx);
+  // The victim just picked stays resident after all (its write-back failed).
+  // Tracks it again as recently used, undoing any history pick_victim kept
+  // for it, so the next pick_victim moves on to another frame.
+  void (*on_reinstate)(void *state, usize frame_idx);
+  void (*destroy)(void *state);
+} EvictionPolicyOps;
+
+typedef struct {
+  const EvictionPolicyOps *ops;
+  void *state;
+  EvictionPolicyKind kind;
+} EvictionPolicy;
+
+// =================================================================================================
+// :: Eviction Policy API ::
+// =================================================================================================
+
+// Number of arena bytes eviction_policy_init needs for 'frame_count' frames.
+usize eviction_policy_required_arena_size(EvictionPolicyKind kind,
+                                          usize frame_count);
+
+bool eviction_policy_init(EvictionPolicy *policy, EvictionPolicyKind kind,
+                          usize frame_count, Arena *arena);
+
+void eviction_policy_free(EvictionPolicy *policy);
+
+const char *eviction_policy_name(EvictionPolicyKind kind);
+
+bool eviction_policy_from_name(const char *name, EvictionPolicyKind *out_kind);
+
+static inline void eviction_policy_on_insert(EvictionPolicy *policy,
+                                             usize frame_idx, u64 page_id) {
+  ASSERT(policy && policy->ops);
+  policy->ops->on_insert(policy->state, frame_idx, page_id);
+}
+
+static inline void eviction_policy_on_access(EvictionPolicy *policy,
+                                             usize frame_idx) {
+  ASSERT(policy && policy->ops);
+  policy->ops->on_access(policy->state, frame_idx);
+}
+
+static inline void eviction_policy_on_reinstate(EvictionPolicy *policy,
+                                                usize frame_idx) {
+  ASSERT(policy && policy->ops);
+  policy->ops->on_reinstate(policy->state, frame_idx);
+}
+
+static inline bool
+eviction_policy_pick_victim(EvictionPolicy *policy,
+                            EvictionCanEvictFunction can_evict, void *ctx,
+                            usize *out_frame_idx) {
+  ASSERT(policy && policy->ops);
+  return policy->ops->pick_victim(policy->state, can_evict, ctx, out_frame_idx);
+}
+
+#endif // SQLDB_EVICTION_H
@@ -0,0 +1,359 @@
+#ifndef SQLDB_EXECUTOR_H
+#define SQLDB_EXECUTOR_H
+
+#include "base.h"
+#include "sqldb/ast.h"
+#include "sqldb/column_store.h"
+#include "sqldb/scheduler.h"
+#include "sqldb/value.h"
+
+// =================================================================================================
+// :: Executor Types ::
+// =================================================================================================
+
+// Operators exchange batches of up to EXEC_BATCH_SIZE rows stored column by
+// column, so every operator runs tight loops over plain arrays and pays one
+// indirect call per batch instead of one per row. Filters do not copy: they
+// hand on the same vectors with a selection vector listing the rows that
+// passed. Every buffer comes from the arena of the ExecContext (normally
+// Database.temp_arena) and is reused from batch to batch, so a query does no
+// heap allocation and resetting the arena frees the whole plan.
+#define EXEC_BATCH_SIZE 1024
+
+typedef enum {
+  EXEC_TYPE_INT64,
+  EXEC_TYPE_FLOAT64,
+  EXEC_TYPE_STRING,
+} ExecType;
+
+typedef struct {
+  ExecType type;
+  union {
+    i64 *i64s;
+    f64 *f64s;
+    StringView *strings;
+  };
+} ExecVector;
+
+typedef struct {
+  ExecVector *columns;
+  u32 column_count;
+  u32 row_count;      // Rows in every vector
+  u32 *selection;     // Active rows in increasing order, NULL if all are
+  u32 selected_count; // Active rows, row_count without a selection
+} ExecBatch;
+
+typedef struct {
+  Arena *arena;
+  bool has_error; // Allocation failed or division by zero; no more batches
+} ExecContext;
+
+// An in-memory table, column by column. Scans hand out slices of its arrays
+// without copying.
+typedef struct {
+  ExecVector *columns;
+  u32 column_count;
+  usize row_count;
+} ExecTable;
+
+typedef enum {
+  EXEC_EXPR_COLUMN,     // Column of the input batch
+  EXEC_EXPR_CONSTANT,
+  EXEC_EXPR_CAST,       // INT64 -> FLOAT64, inserted by the constructors
+  EXEC_EXPR_ARITHMETIC, // + - * / %
+  EXEC_EXPR_COMPARE,    // Predicate: = <> < <= > >=
+  EXEC_EXPR_AND,        // Predicate
+  EXEC_EXPR_OR,         // Predicate
+} ExecExprKind;
+
+typedef struct ExecExpr ExecExpr;
+struct ExecExpr {
+  ExecExprKind kind;
+  ExecType type;     // Value type; unused for predicates
+  bool is_predicate; // Evaluated into a selection vector, not a value
+  ExecVector result; // EXEC_BATCH_SIZE values, or the input column
+  u32 *scratch;      // 2 * EXEC_BATCH_SIZE rows for OR
+  union {
+    u32 column;
+    SqlValue constant;
+    ExecExpr *operand; // EXEC_EXPR_CAST
+    struct {
+      AstOperator op;
+      ExecExpr *left;
+      ExecExpr *right;
+    } binary;
+  };
+};
+
+typedef enum {
+  EXEC_AGG_COUNT_STAR,
+  EXEC_AGG_COUNT,
+  EXEC_AGG_SUM,
+  EXEC_AGG_MIN,
+  EXEC_AGG_MAX,
+  EXEC_AGG_AVG,
+} ExecAggregateKind;
+
+typedef struct {
+  ExecAggregateKind kind;
+  ExecExpr *input; // NULL for EXEC_AGG_COUNT_STAR
+} ExecAggregate;
+
+typedef struct {
+  u32 column;
+  bool is_descending;
+} ExecSortKey;
+
+// Rows of a hash join's build side, hashed on the join key. Once built it is
+// only read, so any number of probes may share it, e.g. one per worker.
+typedef struct ExecJoinTable ExecJoinTable;
+
+typedef struct ExecOperator ExecOperator;
+
+typedef struct {
+  const char *name;
+  // Returns the next non-empty batch, or NULL once the input is exhausted
+  // (or ctx->has_error is set). The batch stays valid until the next call.
+  ExecBatch *(*next)(ExecOperator *op);
+  // Releases what the operator holds outside the arena, such as temp files.
+  // NULL if it holds nothing. Called once, by exec_close.
+  void (*close)(ExecOperator *op);
+} ExecOperatorOps;
+
+typedef struct {
+  u64 batches; // Batches returned
+  u64 rows;    // Selected rows returned
+} ExecOperatorStats;
+
+struct ExecOperator {
+  const ExecOperatorOps *ops;
+  void *state;
+  ExecContext *ctx;
+  ExecOperator *child;      // Input, NULL for scans
+  ExecOperator *build;      // Build side of a hash join
+  ExecType *types;          // Output column types
+  u32 column_count;         // Output columns
+  bool is_closed;           // exec_close ran; no more batches
+  ExecOperatorStats stats;
+};
+
+// --- Column scan ---
+
+typedef struct {
+  u32 row_groups;         // Row groups considered
+  u32 row_groups_skipped; // Ruled out by their zone maps, never read
+  u64 rows_scanned;       // Rows of the row groups that were read
+} ExecColumnScanStats;
+
+// --- Parallel execution ---
+
+// Parallel operators split a table scan into morsels of EXEC_MORSEL_ROWS rows
+// run on the workers of a Scheduler. Every worker gets its own copy of the
+// pipeline above the scan, built in its own arena, and pulls morsels into it
+// until the table is exhausted; the operator then combines the workers'
+// output. Worker arenas are not reset by the operators, so their output stays
+// valid until sched_reset_arenas.
+#define EXEC_MORSEL_ROWS (64 * EXEC_BATCH_SIZE)
+
+// Builds one worker's pipeline on top of 'scan', allocating from 'ctx'. Called
+// once per worker, on the thread constructing the parallel operator.
+typedef ExecOperator *(*ExecPipelineFn)(ExecContext *ctx, ExecOperator *scan,
+                                        void *arg);
+
+typedef struct {
+  const ExecTable *table;
+  const u32 *columns; // Scanned columns of 'table'
+  u32 column_count;
+  ExecPipelineFn build; // NULL to pass the scanned rows on unchanged
+  void *arg;
+} ExecMorselSource;
+
+typedef struct {
+  ExecAggregateKind kind;
+  u32 column; // Input column of the pipeline, unused for COUNT(*)
+} ExecColumnAggregate;
+
+// --- Radix join ---
+
+// A radix join splits its build side on the low bits of the key hash into
+// partitions whose hash tables fit in L2, and probes them with chunks of the
+// probe side split the same way, so every probe hits a table that is already
+// in cache. Build sides larger than the memory budget are first split on the
+// high hash bits into temp files, one per partition and side, which are then
+// joined one pair at a time.
+#define EXEC_RADIX_PARTITION_BYTES (256 * 1024)
+#define EXEC_RADIX_MAX_BITS 12    // At most 4096 partitions
+#define EXEC_RADIX_SPILL_BITS 6   // 64 temp files per side
+#define EXEC_RADIX_PROBE_CHUNK (16 * EXEC_BATCH_SIZE)
+
+typedef struct {
+  u32 partitions;       // Radix partitions of the last build side joined
+  u32 spill_partitions; // Temp files per side, 0 if nothing was spilled
+  u64 spilled_rows;     // Build and probe rows written to temp files
+  u64 probe_rescans;    // Extra passes over probe files, see exec_radix_join
+} ExecRadixJoinStats;
+
+// --- Sort ---
+
+// Sorts order rows by a normalized key: the first sort key mapped to a u64
+// whose unsigned order is the key's order (ints and floats exactly, strings
+// by their first 8 bytes), radix-sorted, with ties on that prefix broken by
+// comparing the full keys. With a memory budget, the input is cut into sorted
+// runs that fit it, written to temp files and merged back through a loser
+// tree, in several passes if there are more runs than EXEC_SORT_MAX_FAN_IN or
+// than the budget can buffer at once.
+#define EXEC_SORT_MAX_FAN_IN 64
+#define EXEC_SORT_IO_BYTES (256 * 1024) // stdio buffer per temp file
+
+typedef struct {
+  u32 runs;         // Sorted runs written to temp files, 0 if in memory
+  u32 merge_passes; // Intermediate merges before the final one
+  u64 spilled_rows; // Rows written to temp files, all passes included
+} ExecSortStats;
+
+// =================================================================================================
+// :: Executor API ::
+// =================================================================================================
+
+static inline u32 exec_batch_row(const ExecBatch *batch, u32 i) {
+  return batch->selection ? batch->selection[i] : i;
+}
+
+// Allocates from ctx->arena, setting ctx->has_error on failure.
+void *exec_alloc(ExecContext *ctx, usize size);
+
+// --- Expressions ---
+
+// Constructors return NULL on allocation failure and insert casts so both
+// sides of an arithmetic operator or comparison have the same type.
+ExecExpr *exec_expr_column(ExecContext *ctx, u32 column, ExecType type);
+ExecExpr *exec_expr_constant(ExecContext *ctx, SqlValue value);
+ExecExpr *exec_expr_arithmetic(ExecContext *ctx, AstOperator op,
+                               ExecExpr *left, ExecExpr *right);
+ExecExpr *exec_expr_compare(ExecContext *ctx, AstOperator op, ExecExpr *left,
+                            ExecExpr *right);
+ExecExpr *exec_expr_and(ExecContext *ctx, ExecExpr *left, ExecExpr *right);
+ExecExpr *exec_expr_or(ExecContext *ctx, ExecExpr *left, ExecExpr *right);
+// low <= value AND value <= high
+ExecExpr *exec_expr_between(ExecContext *ctx, ExecExpr *value, ExecExpr *low,
+                            ExecExpr *high);
+
+// --- Operators ---
+
+// Returns the next batch of 'op' and counts it in op->stats.
+ExecBatch *exec_next(ExecOperator *op);
+
+// Closes 'op' and its inputs, releasing their temp files. Call it on the root
+// of every plan before resetting its arena, whether or not the plan was
+// drained: operators such as sorts and radix joins only close their files
+// once their output runs out. A closed operator returns no more batches.
+// Closing twice is a no-op.
+void exec_close(ExecOperator *op);
+
+// Scans 'columns' of 'table' in order, EXEC_BATCH_SIZE rows at a time.
+ExecOperator *exec_scan(ExecContext *ctx, const ExecTable *table,
+                        const u32 *columns, u32 column_count);
+
+// Scans 'columns' of a columnar table, passing on the rows for which
+// 'predicate', over the scanned columns, holds (all rows if it is NULL). Row
+// groups whose zone maps rule the predicate out are skipped unread, and
+// chunks are decoded straight into the batch vectors. The executor has no
+// NULLs: rows where a predicate column is NULL never match, and other NULLs
+// read as 0 or "". String chunks are copied into the arena, so strings stay
+// valid until it is reset.
+ExecOperator *exec_column_scan(ExecContext *ctx, const ColumnTable *table,
+                               const u32 *columns, u32 column_count,
+                               ExecExpr *predicate);
+
+// Zone map pruning counters of a column scan.
+ExecColumnScanStats exec_column_scan_stats(const ExecOperator *op);
+
+// Passes on the rows of 'child' for which 'predicate' holds.
+ExecOperator *exec_filter(ExecContext *ctx, ExecOperator *child,
+                          ExecExpr *predicate);
+
+// Computes one output column per expression.
+ExecOperator *exec_project(ExecContext *ctx, ExecOperator *child,
+                           ExecExpr **exprs, u32 expr_count);
+
+// Groups the input by 'groups' and outputs one row per group: the group
+// values, then one column per aggregate. COUNT results are INT64, AVG is
+// FLOAT64 and SUM, MIN and MAX keep the input type. Without groups there is
+// exactly one output row, even for empty input.
+ExecOperator *exec_hash_aggregate(ExecContext *ctx, ExecOperator *child,
+                                  ExecExpr **groups, u32 group_count,
+                                  const ExecAggregate *aggregates,
+                                  u32 aggregate_count);
+
+// Inner equi-join. Every row of 'build' is loaded into a hash table on
+// 'build_key' first; 'probe' is then streamed through it. Output columns are
+// the probe columns followed by the build columns.
+ExecOperator *exec_hash_join(ExecContext *ctx, ExecOperator *build,
+                             ExecExpr *build_key, ExecOperator *probe,
+                             ExecExpr *probe_key);
+
+// Loads every row of 'build' into a join table on 'build_key'.
+ExecJoinTable *exec_join_table_build(ExecContext *ctx, ExecOperator *build,
+                                     ExecExpr *build_key);
+
+// Inner equi-join of 'probe' against an already built 'table', with the
+// output columns of exec_hash_join.
+ExecOperator *exec_hash_join_probe(ExecContext *ctx,
+                                   const ExecJoinTable *table,
+                                   ExecOperator *probe, ExecExpr *probe_key);
+
+// Inner equi-join with the output columns of exec_hash_join, for inputs much
+// larger than the CPU caches. The build side is spilled once its rows take
+// more than 'memory_budget' bytes (0 never spills; size it from
+// DatabaseConfig.cache_size_mb). With a 'scheduler', the partition tables are
+// built on its workers; pass NULL inside a parallel pipeline. Strings read
+// back from temp files go to buffers reused for every chunk, so memory stays
+// near the budget. A temp file of build rows over the budget, as skewed keys
+// make, is joined in budget-sized pieces, each against the whole probe file.
+ExecOperator *exec_radix_join(ExecContext *ctx, ExecOperator *build,
+                              ExecExpr *build_key, ExecOperator *probe,
+                              ExecExpr *probe_key, usize memory_budget,
+                              Scheduler *scheduler);
+
+// Partitioning and spilling counters of a radix join.
+ExecRadixJoinStats exec_radix_join_stats(const ExecOperator *op);
+
+// Orders the input by 'keys', columns of 'child', in memory. Stable.
+ExecOperator *exec_sort(ExecContext *ctx, ExecOperator *child,
+                        const ExecSortKey *keys, u32 key_count);
+
+// exec_sort, spilling sorted runs to temp files once the rows take more than
+// 'memory_budget' bytes (0 never spills). The budget covers the run buffer,
+// its sort entries and the merge's read buffers, not the string bytes the
+// input points to.
+ExecOperator *exec_external_sort(ExecContext *ctx, ExecOperator *child,
+                                 const ExecSortKey *keys, u32 key_count,
+                                 usize memory_budget);
+
+// Run and merge counters of a sort.
+ExecSortStats exec_sort_stats(const ExecOperator *op);
+
+// Skips 'offset' rows, then passes on at most 'limit'. Closes 'child' as soon
+// as the last row is passed on.
+ExecOperator *exec_limit(ExecContext *ctx, ExecOperator *child, u64 limit,
+                         u64 offset);
+
+// Runs the pipeline of 'source' on every worker of 'scheduler' and passes on
+// the union of their output, in no particular order.
+ExecOperator *exec_parallel_scan(ExecContext *ctx, Scheduler *scheduler,
+                                 const ExecMorselSource *source);
+
+// Like exec_hash_aggregate over the output of exec_parallel_scan, with group
+// keys and aggregate inputs given as pipeline columns. Every worker
+// aggregates its morsels into its own partial groups, which are merged once
+// all workers are done.
+ExecOperator *exec_parallel_aggregate(ExecContext *ctx, Scheduler *scheduler,
+                                      const ExecMorselSource *source,
+                                      const u32 *group_columns,
+                                      u32 group_count,
+                                      const ExecColumnAggregate *aggregates,
+                                      u32 aggregate_count);
+
+const char *exec_type_name(ExecType type);
+
+#endif // SQLDB_EXECUTOR_H
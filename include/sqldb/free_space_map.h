@@ -0,0 +1,52 @@
+#ifndef SQLDB_FREE_SPACE_MAP_H
+#define SQLDB_FREE_SPACE_MAP_H
+
+#include "base.h"
+#include "sqldb/page_file.h"
+
+// =================================================================================================
+// :: Free Space Map Types ::
+// =================================================================================================
+
+// Pages are bucketed by free space into FSM_CATEGORY_COUNT categories of
+// page_size / 256 bytes each. Every category keeps an intrusive list of its
+// pages and a bitmap records which lists are non-empty, so finding a page
+// with room for a tuple is a few bit scans regardless of the file size.
+#define FSM_CATEGORY_COUNT 255
+#define FSM_UNTRACKED 0xFF
+#define FSM_BITMAP_WORDS ((FSM_CATEGORY_COUNT + 63) / 64)
+
+typedef struct {
+  u32 page_size;
+  u32 category_bytes; // Free space covered by one category
+
+  // Indexed by PageId. Pages that are not part of the map are FSM_UNTRACKED.
+  u8 *categories;
+  PageId *prev;
+  PageId *next;
+  usize capacity;
+
+  PageId heads[FSM_CATEGORY_COUNT];
+  u64 non_empty[FSM_BITMAP_WORDS];
+  usize page_count; // Tracked pages
+} FreeSpaceMap;
+
+// =================================================================================================
+// :: Free Space Map API ::
+// =================================================================================================
+
+void fsm_init(FreeSpaceMap *fsm, u32 page_size);
+
+void fsm_free(FreeSpaceMap *fsm);
+
+// Records that 'page_id' has 'free_bytes' available, adding it to the map if
+// it was not tracked yet.
+bool fsm_update(FreeSpaceMap *fsm, PageId page_id, u32 free_bytes);
+
+void fsm_remove(FreeSpaceMap *fsm, PageId page_id);
+
+// Returns a tracked page with at least 'needed' free bytes, or
+// INVALID_PAGE_ID if there is none. Recently updated pages are preferred.
+PageId fsm_find(const FreeSpaceMap *fsm, u32 needed);
+
+#endif // SQLDB_FREE_SPACE_MAP_H
@@ -0,0 +1,64 @@
+#ifndef SQLDB_HEAP_FILE_H
+#define SQLDB_HEAP_FILE_H
+
+#include "base.h"
+#include "sqldb/buffer_pool.h"
+#include "sqldb/free_space_map.h"
+#include "sqldb/heap_page.h"
+
+// =================================================================================================
+// :: Heap File Types ::
+// =================================================================================================
+
+// Stable address of a tuple: its page and its slot within the page.
+typedef struct {
+  PageId page_id;
+  u16 slot;
+} RecordId;
+
+typedef struct {
+  u64 inserts;
+  u64 deletes;
+  u64 pages_allocated;
+  u64 fsm_misses; // Inserts that found no page with room and appended one
+} HeapFileStats;
+
+// An unordered collection of variable-length tuples stored in slotted pages
+// of the buffer pool. The free space map is kept in memory and is rebuilt by
+// re-adding the heap's pages with heap_file_add_page.
+typedef struct {
+  BufferPool *bp;
+  FreeSpaceMap fsm;
+  u64 tuple_count;
+  u64 tuple_bytes; // Payload bytes of live tuples
+  HeapFileStats stats;
+} HeapFile;
+
+// =================================================================================================
+// :: Heap File API ::
+// =================================================================================================
+
+void heap_file_init(HeapFile *heap, BufferPool *bp);
+
+void heap_file_free(HeapFile *heap);
+
+// Registers an existing heap page (e.g. after a restart) with the free space
+// map and the tuple counters.
+bool heap_file_add_page(HeapFile *heap, PageId page_id);
+
+bool heap_insert(HeapFile *heap, const u8 *data, u32 length,
+                 RecordId *out_rid);
+
+// Returns the tuple at 'rid' and the pinned frame holding it, or NULL if the
+// tuple does not exist. Unpin the frame with bp_unpin_page when done.
+const u8 *heap_fetch(HeapFile *heap, RecordId rid, u32 *out_length,
+                     BufferFrame **out_frame);
+
+bool heap_delete(HeapFile *heap, RecordId rid);
+
+// Number of pages the heap occupies.
+static inline usize heap_file_page_count(const HeapFile *heap) {
+  return heap->fsm.page_count;
+}
+
+#endif // SQLDB_HEAP_FILE_H
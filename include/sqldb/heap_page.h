@@ -0,0 +1,81 @@
+#ifndef SQLDB_HEAP_PAGE_H
+#define SQLDB_HEAP_PAGE_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Heap Page Types ::
+// =================================================================================================
+
+// Slotted page layout, for any page_size from 512 to 65536 bytes:
+//
+//   +--------+---------------------+-- free --+-----------------------------+
+//   | header | slot 0 | slot 1 ... |   space  | ... tuple 1 | tuple 0       |
+//   +--------+---------------------+----------+-----------------------------+
+//                                  ^free_start ^free_end
+//
+// The slot directory grows up from the header and tuples grow down from the
+// end of the page. A tuple is addressed by its slot number, which never
+// changes while the tuple lives, so tuples can be moved within the page
+// (compaction, growing updates) without touching any reference to them.
+typedef struct {
+  u32 free_start; // First byte past the slot directory
+  u32 free_end;   // First byte of the tuple area
+  u32 dead_bytes; // Tuple area bytes no live tuple uses (reclaimed by compact)
+  u16 slot_count; // Slots in the directory, used or free
+  u16 live_count; // Slots holding a tuple
+  u32 page_size;
+  u32 magic;
+} HeapPageHeader;
+
+typedef struct {
+  u16 offset; // 0 marks a free slot (the header owns offset 0)
+  u16 length;
+} HeapSlot;
+
+#define HEAP_PAGE_MIN_SIZE 512
+#define HEAP_PAGE_MAX_SIZE 65536
+#define HEAP_PAGE_MAGIC 0x48454150u // "HEAP"
+
+// =================================================================================================
+// :: Heap Page API ::
+// =================================================================================================
+
+void heap_page_init(u8 *page, u32 page_size);
+
+bool heap_page_is_valid(const u8 *page, u32 page_size);
+
+// Largest tuple an empty page of this size can hold.
+u32 heap_page_max_tuple_size(u32 page_size);
+
+// Largest tuple heap_page_insert would currently accept, counting space that
+// compaction would reclaim.
+u32 heap_page_free_space(const u8 *page);
+
+// Stores a copy of 'data' and returns its slot. Compacts the page first if
+// the contiguous free space is too small. Tuples must be non-empty and 'data'
+// must not point into the page. Returns false if the tuple does not fit.
+bool heap_page_insert(u8 *page, const u8 *data, u32 length, u16 *out_slot);
+
+// Returns the tuple in 'slot', or NULL if the slot is free or out of range.
+const u8 *heap_page_get(const u8 *page, u16 slot, u32 *out_length);
+
+bool heap_page_delete(u8 *page, u16 slot);
+
+// Replaces the tuple in 'slot', moving it within the page if it grows. Returns
+// false (leaving the old tuple intact) if the new version does not fit.
+bool heap_page_update(u8 *page, u16 slot, const u8 *data, u32 length);
+
+// Slides all live tuples to the end of the page so that the free space is one
+// contiguous gap. Slot numbers are preserved.
+void heap_page_compact(u8 *page);
+
+static inline u16 heap_page_slot_count(const u8 *page) {
+  return ((const HeapPageHeader *)page)->slot_count;
+}
+
+static inline u16 heap_page_live_count(const u8 *page) {
+  return ((const HeapPageHeader *)page)->live_count;
+}
+
+#endif // SQLDB_HEAP_PAGE_H
@@ -0,0 +1,47 @@
+#ifndef SQLDB_HISTOGRAM_H
+#define SQLDB_HISTOGRAM_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Histogram Types ::
+// =================================================================================================
+
+// Log-linear histogram of u64 samples: every power of two is split into
+// HISTOGRAM_SUB_BUCKETS linear buckets, so percentiles are accurate to within
+// 1/HISTOGRAM_SUB_BUCKETS of the true value at any magnitude. Fixed size, no
+// allocation, cheap enough to record on hot paths.
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKET_COUNT (64 * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+  u64 counts[HISTOGRAM_BUCKET_COUNT];
+  u64 total_count;
+  u64 sum;
+  u64 min;
+  u64 max;
+} Histogram;
+
+// =================================================================================================
+// :: Histogram API ::
+// =================================================================================================
+
+void histogram_init(Histogram *hist);
+
+void histogram_record(Histogram *hist, u64 value);
+
+void histogram_merge(Histogram *dst, const Histogram *src);
+
+// Returns an upper bound of the value at 'percentile' (0.0 to 100.0).
+u64 histogram_percentile(const Histogram *hist, f64 percentile);
+
+static inline f64 histogram_mean(const Histogram *hist) {
+  ASSERT(hist);
+  return hist->total_count ? (f64)hist->sum / (f64)hist->total_count : 0.0;
+}
+
+// Logs count, mean and p50/p90/p99/p99.9/max on one line.
+void histogram_log(const Histogram *hist, const char *name, const char *unit);
+
+#endif // SQLDB_HISTOGRAM_H
@@ -0,0 +1,115 @@
+#ifndef SQLDB_LEXER_H
+#define SQLDB_LEXER_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Lexer Types ::
+// =================================================================================================
+
+typedef enum {
+  TOKEN_EOF = 0,
+  TOKEN_ERROR, // Lexer.error says why; text covers the offending input
+
+  // Literals and names
+  TOKEN_IDENTIFIER,        // Bare or "quoted" (text excludes the quotes)
+  TOKEN_INTEGER,
+  TOKEN_FLOAT,
+  TOKEN_STRING,            // Text excludes the quotes, '' is left as is
+  TOKEN_PARAMETER,         // ? or $n placeholder, bound at execution
+
+  // Punctuation and operators
+  TOKEN_LEFT_PAREN,
+  TOKEN_RIGHT_PAREN,
+  TOKEN_COMMA,
+  TOKEN_SEMICOLON,
+  TOKEN_DOT,
+  TOKEN_STAR,
+  TOKEN_PLUS,
+  TOKEN_MINUS,
+  TOKEN_SLASH,
+  TOKEN_PERCENT,
+  TOKEN_EQUAL,
+  TOKEN_NOT_EQUAL,         // <> or !=
+  TOKEN_LESS,
+  TOKEN_LESS_EQUAL,
+  TOKEN_GREATER,
+  TOKEN_GREATER_EQUAL,
+
+  // Keywords (matched case-insensitively)
+  TOKEN_KW_AND,
+  TOKEN_KW_AS,
+  TOKEN_KW_ASC,
+  TOKEN_KW_BIGINT,
+  TOKEN_KW_BOOLEAN,
+  TOKEN_KW_BY,
+  TOKEN_KW_CREATE,
+  TOKEN_KW_DELETE,
+  TOKEN_KW_DESC,
+  TOKEN_KW_DISTINCT,
+  TOKEN_KW_DOUBLE,
+  TOKEN_KW_EXISTS,
+  TOKEN_KW_FALSE,
+  TOKEN_KW_FLOAT,
+  TOKEN_KW_FROM,
+  TOKEN_KW_GROUP,
+  TOKEN_KW_HAVING,
+  TOKEN_KW_IF,
+  TOKEN_KW_INNER,
+  TOKEN_KW_INSERT,
+  TOKEN_KW_INT,
+  TOKEN_KW_INTEGER,
+  TOKEN_KW_INTO,
+  TOKEN_KW_IS,
+  TOKEN_KW_JOIN,
+  TOKEN_KW_KEY,
+  TOKEN_KW_LEFT,
+  TOKEN_KW_LIMIT,
+  TOKEN_KW_NOT,
+  TOKEN_KW_NULL,
+  TOKEN_KW_OFFSET,
+  TOKEN_KW_ON,
+  TOKEN_KW_OR,
+  TOKEN_KW_ORDER,
+  TOKEN_KW_OUTER,
+  TOKEN_KW_PRIMARY,
+  TOKEN_KW_REAL,
+  TOKEN_KW_SELECT,
+  TOKEN_KW_SET,
+  TOKEN_KW_TABLE,
+  TOKEN_KW_TEXT,
+  TOKEN_KW_TRUE,
+  TOKEN_KW_UPDATE,
+  TOKEN_KW_VALUES,
+  TOKEN_KW_VARCHAR,
+  TOKEN_KW_WHERE,
+} TokenKind;
+
+// A token is a view into the query text; nothing is copied.
+typedef struct {
+  TokenKind kind;
+  StringView text;
+  u32 offset; // Byte offset of the token in the query text
+} Token;
+
+typedef struct {
+  StringView source;
+  usize position;
+  const char *error; // Set when a TOKEN_ERROR is returned
+  bool skip_keywords; // Return keywords as TOKEN_IDENTIFIER, skipping lookup
+} Lexer;
+
+// =================================================================================================
+// :: Lexer API ::
+// =================================================================================================
+
+void lexer_init(Lexer *lexer, StringView source);
+
+// Returns the next token. TOKEN_EOF is returned at the end of the input and
+// on every call after it. Whitespace, -- line and /* block */ comments are
+// skipped.
+Token lexer_next(Lexer *lexer);
+
+const char *token_kind_name(TokenKind kind);
+
+#endif // SQLDB_LEXER_H
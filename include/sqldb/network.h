@@ -0,0 +1,178 @@
+#ifndef SQLDB_NETWORK_H
+#define SQLDB_NETWORK_H
+
+#include "base.h"
+#include "sqldb/core.h"
+#include "sqldb/pg_wire.h"
+
+// =================================================================================================
+// :: Wire Protocol Types ::
+// =================================================================================================
+
+// Every message, in both directions, is a frame: a NET_FRAME_HEADER_SIZE
+// header holding the payload length (u32) and the message type (u8),
+// followed by the payload. Integers are big-endian. Requests are answered in
+// the order they arrive, one response each, so a client may pipeline them.
+//
+//   PING     ->  PONG    (both empty)
+//   QUERY    ->  RESULT  u8 statement kind (AstStatementKind), u32 number of
+//                        literals bound as parameters
+//            ->  ERROR   u32 line, u32 column, message bytes
+//
+// A frame that is too large or of an unknown type closes the connection.
+//
+// PostgreSQL clients connect to the same port (see pg_wire.h). The type byte
+// of a native frame is never 0 or 4, which is what the fifth byte of every
+// PostgreSQL startup packet is, so the first five bytes decide.
+#define NET_FRAME_HEADER_SIZE 5
+#define NET_BUFFER_SIZE 16384 // Per direction; also the largest frame
+#define NET_MAX_PAYLOAD (NET_BUFFER_SIZE - NET_FRAME_HEADER_SIZE)
+#define NET_MAX_RESPONSE 256 // Largest frame the server ever sends
+
+typedef enum {
+  NET_MSG_PING = 1,
+  NET_MSG_QUERY = 2,
+  NET_MSG_PONG = 64,
+  NET_MSG_RESULT = 65,
+  NET_MSG_ERROR = 66,
+} NetMessageType;
+
+typedef struct {
+  u32 length; // Payload bytes
+  u8 type;    // NetMessageType
+} NetFrameHeader;
+
+typedef enum {
+  NET_PROTOCOL_UNKNOWN, // Fewer than five bytes received so far
+  NET_PROTOCOL_NATIVE,
+  NET_PROTOCOL_POSTGRES,
+} NetProtocol;
+
+// =================================================================================================
+// :: Network Server Types ::
+// =================================================================================================
+
+// Fixed-size blocks handed out from slabs of 'items_per_slab' blocks. Freed
+// blocks go on a free list and are reused before a new slab is allocated;
+// slabs are only returned to the system by net_pool_free.
+typedef struct {
+  usize item_size;
+  usize items_per_slab;
+  void *free_list; // Each free block starts with the next one's address
+  u8 **slabs;
+  usize slab_count;
+  usize slab_capacity;
+  usize in_use; // Blocks handed out
+} NetPool;
+
+// A client connection. Buffers are taken from the pool only while they hold
+// bytes and given back as soon as they drain, so an idle connection costs
+// this struct and its socket.
+struct NetConnection {
+  int fd;
+  u32 in_length;       // Received bytes not consumed yet
+  u32 out_length;      // Response bytes queued
+  u32 out_sent;        // Of those, already written to the socket
+  u8 protocol;         // NetProtocol
+  bool is_closing;     // Close once the queued responses are written
+  u8 *in;              // NET_BUFFER_SIZE bytes from buffer_pool, or NULL
+  u8 *out;             // NET_BUFFER_SIZE bytes from buffer_pool, or NULL
+  PgSession *pg;       // NET_PROTOCOL_POSTGRES state, from session_pool
+  bool is_ready;       // On the server's ready list
+  NetConnection *prev; // Open connections, for shutdown
+  NetConnection *next;
+  // The server's ready list, while 'is_ready'
+  NetConnection *ready_prev;
+  NetConnection *ready_next;
+};
+
+typedef struct {
+  u64 accepted;
+  u64 rejected; // Closed on accept: max_connections reached
+  u64 closed;
+  u64 requests;
+  u64 protocol_errors;   // Connections dropped for a malformed frame
+  u64 postgres_sessions; // Connections that spoke the PostgreSQL protocol
+  u64 bytes_read;
+  u64 bytes_written;
+  u64 peak_connections;
+  u64 peak_buffers; // Most pool buffers in use at once
+} NetServerStats;
+
+// Single-threaded front end: one epoll instance in edge-triggered mode
+// watches the listening socket and every connection. All sockets are
+// non-blocking; a connection reads until EAGAIN, answers every complete
+// request, and keeps what it could not write for the next EPOLLOUT. A wakeup
+// serves a connection for a bounded number of rounds; one that still has
+// work waits on the ready list, which is served round-robin between polls
+// because no new edge would bring it back.
+struct NetServer {
+  Database *db;
+  int listen_fd;
+  int epoll_fd;
+  u16 port;
+  u32 max_connections;
+  u32 connection_count;
+  NetConnection *connections; // Most recently accepted first
+  NetConnection *ready_head;  // Connections with work left, oldest first
+  NetConnection *ready_tail;
+  u32 ready_count;            // Connections on the ready list
+  NetPool connection_pool;    // NetConnection structs
+  NetPool buffer_pool;        // NET_BUFFER_SIZE read and write buffers
+  NetPool session_pool;       // PgSession structs
+  NetServerStats stats;
+};
+
+// =================================================================================================
+// :: Wire Protocol API ::
+// =================================================================================================
+
+// Writes the header of a frame with 'payload_length' bytes of payload to
+// 'out' (NET_FRAME_HEADER_SIZE bytes).
+void net_encode_header(u8 *out, NetMessageType type, u32 payload_length);
+
+// Reads a frame header from 'data' if 'length' bytes hold one.
+bool net_decode_header(const u8 *data, usize length, NetFrameHeader *out);
+
+static inline void net_put_u32(u8 *out, u32 value) {
+  out[0] = (u8)(value >> 24);
+  out[1] = (u8)(value >> 16);
+  out[2] = (u8)(value >> 8);
+  out[3] = (u8)value;
+}
+
+static inline u32 net_get_u32(const u8 *data) {
+  return (u32)data[0] << 24 | (u32)data[1] << 16 | (u32)data[2] << 8 |
+         (u32)data[3];
+}
+
+const char *net_message_type_name(NetMessageType type);
+
+// =================================================================================================
+// :: Network Server API ::
+// =================================================================================================
+
+void net_pool_init(NetPool *pool, usize item_size, usize items_per_slab);
+
+void *net_pool_acquire(NetPool *pool);
+
+void net_pool_release(NetPool *pool, void *item);
+
+void net_pool_free(NetPool *pool);
+
+// Listens on 'port' on every interface; with port 0 the kernel picks a free
+// one and 'server->port' holds it. Statements are prepared through 'db',
+// which must outlive the server.
+bool net_server_init(NetServer *server, Database *db, u16 port,
+                     u32 max_connections);
+
+// Serves clients until '*stop_requested' becomes true; it is checked at least
+// every 100 ms. Returns false if the event loop fails.
+bool net_server_run(NetServer *server, volatile bool *stop_requested);
+
+// Closes every connection and the listening socket.
+void net_server_shutdown(NetServer *server);
+
+void net_server_log_stats(const NetServer *server);
+
+#endif // SQLDB_NETWORK_H
@@ -0,0 +1,102 @@
+#ifndef SQLDB_PAGE_FILE_H
+#define SQLDB_PAGE_FILE_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Page File Types ::
+// =================================================================================================
+
+typedef u64 PageId;
+
+#define INVALID_PAGE_ID UINT64_MAX
+
+// Minimum buffer alignment for O_DIRECT transfers. Buffer pool frames are
+// aligned to page_size, which is always a multiple of this.
+#define PAGE_FILE_DIRECT_IO_ALIGNMENT 512
+
+// Access pattern hints for a memory-mapped file, forwarded to madvise.
+typedef enum {
+  PAGE_ACCESS_NORMAL = 0,     // Default kernel readahead
+  PAGE_ACCESS_RANDOM = 1,     // Point lookups: no readahead
+  PAGE_ACCESS_SEQUENTIAL = 2, // Scans: aggressive readahead, early reclaim
+  PAGE_ACCESS_WILLNEED = 3,   // Start reading the range in now
+} PageAccessHint;
+
+#define DEFAULT_PAGE_ACCESS_HINT PAGE_ACCESS_RANDOM
+
+// A database file accessed in whole pages with pread/pwrite. There is no file
+// position and no user-space buffering, so any number of threads may read and
+// write distinct pages concurrently. The two fields that change under them,
+// direct_io and page_count, are only touched atomically; read them through
+// pf_uses_direct_io and pf_page_count.
+//
+// A read-only file can additionally be mapped into memory with pf_map, after
+// which pages are served straight out of the kernel page cache.
+typedef struct {
+  int fd;
+  u32 page_size;
+  bool read_only;
+  bool direct_io;    // Transfers bypass the kernel page cache (O_DIRECT)
+  PageId page_count; // Pages in the file; grows when writing past the end
+  u8 *map;           // PROT_READ mapping of page_count pages, or NULL
+  usize map_size;
+} PageFile;
+
+// =================================================================================================
+// :: Page File API ::
+// =================================================================================================
+
+// Opens (or, unless read_only, creates) the file at 'path'. If direct_io is
+// requested but unsupported by the file system, falls back to buffered I/O.
+bool pf_open(PageFile *pf, const char *path, u32 page_size, bool read_only,
+             bool direct_io);
+
+void pf_close(PageFile *pf);
+
+// Reads one page into 'out_data'. Pages past the end of the file read as
+// zeroes. With direct I/O, 'out_data' must be PAGE_FILE_DIRECT_IO_ALIGNMENT
+// aligned.
+bool pf_read_page(PageFile *pf, PageId page_id, u8 *out_data);
+
+bool pf_write_page(PageFile *pf, PageId page_id, const u8 *data);
+
+// Makes every completed write durable (fdatasync).
+bool pf_sync(const PageFile *pf);
+
+// Cleared when the device rejects direct I/O alignment mid-run.
+static inline bool pf_uses_direct_io(const PageFile *pf) {
+  return __atomic_load_n(&pf->direct_io, __ATOMIC_RELAXED);
+}
+
+static inline PageId pf_page_count(const PageFile *pf) {
+  return __atomic_load_n(&pf->page_count, __ATOMIC_RELAXED);
+}
+
+// Grows page_count to cover 'page_id' after a write that bypassed
+// pf_write_page (e.g. one completed by io_uring).
+void pf_note_page_written(PageFile *pf, PageId page_id);
+
+// Maps the whole file read-only and applies 'hint' to the mapping. Only valid
+// for files opened read_only; the mapping lives until pf_close.
+bool pf_map(PageFile *pf, PageAccessHint hint);
+
+// Returns the mapped bytes of 'page_id', or NULL if the file is not mapped or
+// the page lies past the end of the mapping. Writing through it faults.
+static inline u8 *pf_mapped_page(const PageFile *pf, PageId page_id) {
+  ASSERT(pf);
+  if (!pf->map || page_id >= pf_page_count(pf)) {
+    return NULL;
+  }
+  return pf->map + page_id * pf->page_size;
+}
+
+// Applies 'hint' to 'count' pages starting at 'first_page_id' (clamped to the
+// mapping). A no-op for files that are not mapped.
+bool pf_advise(const PageFile *pf, PageId first_page_id, PageId count,
+               PageAccessHint hint);
+
+const char *pf_access_hint_name(PageAccessHint hint);
+bool pf_access_hint_from_name(const char *name, PageAccessHint *out_hint);
+
+#endif // SQLDB_PAGE_FILE_H
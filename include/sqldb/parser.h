@@ -0,0 +1,34 @@
+#ifndef SQLDB_PARSER_H
+#define SQLDB_PARSER_H
+
+#include "base.h"
+#include "sqldb/ast.h"
+#include "sqldb/lexer.h"
+
+// =================================================================================================
+// :: Parser Types ::
+// =================================================================================================
+
+#define SQL_ERROR_MESSAGE_SIZE 128
+#define SQL_MAX_EXPR_DEPTH 1000 // Deeper expressions are a parse error
+
+typedef struct {
+  char message[SQL_ERROR_MESSAGE_SIZE];
+  u32 offset; // Byte offset of the offending token
+  u32 line;   // 1-based
+  u32 column; // 1-based, in bytes
+} SqlParseError;
+
+// =================================================================================================
+// :: Parser API ::
+// =================================================================================================
+
+// Parses one statement, optionally terminated by ';'. Every node is allocated
+// from 'arena' and names and literals point into 'sql': parsing does no heap
+// allocation, and resetting the arena (e.g. Database.temp_arena once the
+// statement finishes) frees the whole tree. Returns NULL and fills 'out_error'
+// on a syntax error, when expressions nest deeper than SQL_MAX_EXPR_DEPTH
+// (which bounds the recursion), or when the arena runs out.
+AstStatement *sql_parse(Arena *arena, StringView sql, SqlParseError *out_error);
+
+#endif // SQLDB_PARSER_H
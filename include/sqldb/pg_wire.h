@@ -0,0 +1,149 @@
+#ifndef SQLDB_PG_WIRE_H
+#define SQLDB_PG_WIRE_H
+
+#include "base.h"
+#include "sqldb/value.h"
+
+// =================================================================================================
+// :: PostgreSQL Protocol Types ::
+// =================================================================================================
+
+// Version 3.0 of the PostgreSQL frontend/backend protocol, served on the same
+// port as the native protocol: the first bytes a client sends tell the two
+// apart (see network.h). Supported: the startup handshake without
+// authentication (SSL and GSS encryption requests are declined), the simple
+// query protocol with several statements per query, and the extended query
+// protocol (Parse, Bind with text or binary parameters, Describe, Execute
+// with a row limit, Close, Sync, Flush), and CancelRequest.
+//
+// Statements are parsed by the SQL parser and run by eval.h, which decides
+// what a SELECT can produce; $n placeholders map to the parameters of Bind.
+// This layer frames, encodes and streams: rows are encoded one DataRow at a
+// time straight into the connection's output buffer; when it fills up the
+// query stops where it is and resumes once the socket drains, so results of
+// any size stream through a fixed amount of memory. A long query also stops
+// after a bounded number of rows per turn and resumes on the next, which is
+// where a CancelRequest takes effect.
+#define PG_PROTOCOL_VERSION 196608 // 3.0
+#define PG_SSL_REQUEST_CODE 80877103
+#define PG_GSSENC_REQUEST_CODE 80877104
+#define PG_CANCEL_REQUEST_CODE 80877102
+#define PG_SERVER_VERSION "14.0"
+#define PG_NAME_SIZE 64 // NAMEDATALEN: user, database and statement names
+
+// Type OIDs of pg_type that parameters and result columns use.
+#define PG_OID_BOOL 16
+#define PG_OID_INT8 20
+#define PG_OID_INT2 21
+#define PG_OID_INT4 23
+#define PG_OID_TEXT 25
+#define PG_OID_FLOAT4 700
+#define PG_OID_FLOAT8 701
+#define PG_OID_UNKNOWN 705
+#define PG_OID_VARCHAR 1043
+
+typedef enum {
+  PG_PHASE_STARTUP, // Waiting for the startup message
+  PG_PHASE_READY,   // Serving queries
+} PgPhase;
+
+// A statement created by Parse.
+typedef struct {
+  char name[PG_NAME_SIZE]; // Empty for the unnamed statement
+  char *sql;               // Query text, owned
+  u32 sql_length;
+  u32 *param_types;  // OID of every $n as given by Parse, 0 if unspecified
+  u32 param_count;   // Highest $n
+  u16 *placeholders; // n - 1 of every placeholder, in text order
+  u32 placeholder_count;
+} PgStatement;
+
+typedef enum {
+  PG_PORTAL_READY,    // Nothing sent yet
+  PG_PORTAL_ROWS,     // Sending rows
+  PG_PORTAL_COMPLETE, // Every row sent
+} PgPortalState;
+
+// A statement bound to parameter values (by Bind, or internally for each
+// statement of a simple query), with the position of its result stream.
+typedef struct {
+  char name[PG_NAME_SIZE];
+  char *sql;         // Owned copy, or a view into PgSession.query
+  bool owns_sql;
+  u32 sql_length;
+  u16 *placeholders; // Owned copy of the statement's
+  u32 placeholder_count;
+  SqlValue *params;  // One per $n; strings point into param_bytes
+  u32 *param_types;  // Owned copy of the statement's
+  u32 param_count;
+  u8 *param_bytes;
+  i16 *formats;      // Result column formats: none (text), one or per column
+  u32 format_count;
+  PgPortalState state;
+  u64 next_row;      // Next row of the row source
+  u64 skipped;       // Rows dropped by OFFSET so far
+  u64 emitted;       // Rows sent so far
+} PgPortal;
+
+typedef enum {
+  PG_WORK_NONE,
+  PG_WORK_QUERY,   // A simple query, one statement after the other
+  PG_WORK_EXECUTE, // An Execute message
+} PgWork;
+
+typedef struct {
+  PgPhase phase;
+  u32 process_id; // BackendKeyData: random, not the server pid
+  u32 secret_key;
+  char user[PG_NAME_SIZE];
+  char database[PG_NAME_SIZE];
+  bool skip_until_sync; // An extended query failed: ignore up to Sync
+  PgStatement *statements;
+  u32 statement_count;
+  u32 statement_capacity;
+  PgPortal *portals;
+  u32 portal_count;
+  u32 portal_capacity;
+
+  // The query or Execute being answered; input waits until it is done.
+  PgWork work;
+  char *query;       // PG_WORK_QUERY: owned copy of the query string
+  u32 query_length;
+  u32 query_offset;  // Start of the statement after the current one
+  bool query_ran;    // Any statement found, else EmptyQueryResponse
+  PgPortal current;  // PG_WORK_QUERY: the statement being run
+  u32 portal;        // PG_WORK_EXECUTE: index into portals
+  u64 row_limit;     // PG_WORK_EXECUTE: max rows, 0 for all
+  u64 rows_sent;     // PG_WORK_EXECUTE: rows sent by this Execute
+  // A CancelRequest named this session while it had work; stops it
+  bool is_cancel_requested;
+} PgSession;
+
+// The server and connection types live in network.h, which includes this.
+typedef struct NetServer NetServer;
+typedef struct NetConnection NetConnection;
+
+// =================================================================================================
+// :: PostgreSQL Protocol API ::
+// =================================================================================================
+
+// Whether the first bytes a client sent ('length' of them, at least 5) are a
+// PostgreSQL startup, SSL, GSS or cancel request rather than a native frame.
+bool pg_is_startup_packet(const u8 *data, usize length);
+
+void pg_session_init(PgSession *session);
+
+void pg_session_free(PgSession *session);
+
+// Answers the complete messages in conn->in, appending responses to conn->out
+// (which must be allocated) and continuing a result stream left off earlier.
+// Stops when the output has no room left or a long query has had its turn,
+// for the next call to resume. Sets
+// conn->is_closing on Terminate and fatal errors. Returns false if the
+// connection must be dropped at once.
+bool pg_handle_input(NetServer *server, NetConnection *conn);
+
+// Whether pg_handle_input has anything to do without new input.
+bool pg_has_work(const NetConnection *conn);
+
+#endif // SQLDB_PG_WIRE_H
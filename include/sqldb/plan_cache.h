@@ -0,0 +1,100 @@
+#ifndef SQLDB_PLAN_CACHE_H
+#define SQLDB_PLAN_CACHE_H
+
+#include "base.h"
+#include "sqldb/ast.h"
+#include "sqldb/parser.h"
+#include "sqldb/value.h"
+
+// =================================================================================================
+// :: Plan Cache Types ::
+// =================================================================================================
+
+#define PLAN_CACHE_NONE UINT32_MAX
+#define DEFAULT_PLAN_CACHE_ENTRIES 512
+#define DEFAULT_PLAN_CACHE_ENTRY_SIZE 4096
+#define PLAN_CACHE_OVERSIZED_KEYS 64 // Statements remembered as too large
+
+typedef struct {
+  StringView text; // Normalized statement: literals are ?, single spaces
+  u64 hash;        // base_hash_bytes of 'text'
+} PlanCacheKey;
+
+// A statement compiled once for every query of the same shape. Its literals
+// are AST_EXPR_PARAMETER nodes, bound from SqlParams at execution.
+typedef struct {
+  PlanCacheKey key;        // Must stay first: the table hashes entries by key
+  AstStatement *statement; // Parsed from key.text
+  u64 executions;          // Times this plan was handed out
+  bool is_cached;          // False for one-off plans built in the temp arena
+  u32 lru_prev;            // Towards the most recently used entry
+  u32 lru_next;            // Towards the eviction victim; free list link
+  Arena arena;             // Slot memory holding key.text and the statement
+} PreparedStatement;
+
+// Values of the placeholders of one execution, in text order.
+typedef struct {
+  SqlValue *values;
+  u32 count;
+} SqlParams;
+
+typedef struct {
+  u64 hits;        // Statements served without parsing
+  u64 misses;      // Statements parsed and added to the cache
+  u64 evictions;   // Least recently used plans dropped to make room
+  u64 uncacheable; // Statements parsed per execution (DDL, too large)
+} PlanCacheStats;
+
+// A fixed number of fixed-size slots carved from the arena at init, so the
+// cache never grows: a new plan takes a free slot, evicting the least
+// recently used plan once every slot is in use. One spare slot is kept so a
+// statement is parsed before anything is evicted for it.
+typedef struct {
+  PreparedStatement *entries; // capacity + 1 slots
+  u8 *memory;                 // entry_size bytes per slot
+  usize capacity;             // Max number of cached plans
+  usize entry_size;           // Arena bytes per plan (text and AST)
+  usize count;                // Cached plans
+  u32 lru_head;               // Most recently used plan
+  u32 lru_tail;               // Least recently used plan
+  u32 free_head;              // Slots holding no plan
+  BaseHashTableOA table;      // PlanCacheKey* -> PreparedStatement*
+  // Hashes of normalized statements whose plan outgrew a slot, indexed by
+  // hash modulo PLAN_CACHE_OVERSIZED_KEYS, so their repeats skip the slot.
+  u64 *oversized;
+  PlanCacheStats stats;
+} PlanCache;
+
+// =================================================================================================
+// :: Plan Cache API ::
+// =================================================================================================
+
+// Number of arena bytes plan_cache_init needs for 'capacity' plans.
+usize plan_cache_required_arena_size(usize capacity, usize entry_size);
+
+bool plan_cache_init(PlanCache *cache, Arena *arena, usize capacity,
+                     usize entry_size);
+
+// Returns the plan for 'sql' and the values of its placeholders. The query is
+// normalized in one lexer pass (integer, float and string literals become ?
+// placeholders) and looked up by the hash of the normalized text; only a miss
+// parses. Names and keywords are compared as written, so differently cased
+// spellings of a statement get separate plans. The normalized text and
+// 'out_params' are allocated from 'temp', as are one-off plans for statements
+// that are not cached (DDL, or plans larger than a slot). A statement whose
+// plan outgrew a slot is remembered, so its repeats are parsed once, straight
+// into 'temp'. A cached plan stays valid until the next call, which may evict
+// it. Returns NULL and fills 'out_error' if 'sql' does not parse.
+const PreparedStatement *plan_cache_prepare(PlanCache *cache, Arena *temp,
+                                            StringView sql,
+                                            SqlParams *out_params,
+                                            SqlParseError *out_error);
+
+// Drops every cached plan, e.g. after a schema change.
+void plan_cache_clear(PlanCache *cache);
+
+f64 plan_cache_hit_ratio(const PlanCache *cache);
+
+void plan_cache_log_stats(const PlanCache *cache);
+
+#endif // SQLDB_PLAN_CACHE_H
@@ -0,0 +1,105 @@
+#ifndef SQLDB_SCHEDULER_H
+#define SQLDB_SCHEDULER_H
+
+#include "base.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: Scheduler Types ::
+// =================================================================================================
+
+// A fixed pool of worker threads, one per core by default, that runs one job
+// at a time over a range of work units (table rows, pages) split into
+// morsels. Every worker runs the job function once; the function pulls
+// morsels with sched_next_morsel until none are left. The morsels are dealt
+// out up front as contiguous runs, one run per worker deque, so each worker
+// starts on neighbouring data; a worker whose deque runs dry steals from the
+// far end of another's, so a slow or late worker does not hold up the job.
+#define DEFAULT_WORKER_THREADS 0 // One per online core
+#define DEFAULT_WORKER_ARENA_MB 16
+#define MAX_WORKER_THREADS 256
+
+typedef struct {
+  usize begin;
+  usize end;
+} SchedMorsel;
+
+// Morsels of the running job. The owner takes them from the head, thieves
+// from the tail.
+typedef struct {
+  pthread_mutex_t lock;
+  SchedMorsel *morsels;
+  usize capacity;
+  usize head;
+  usize count;
+} SchedDeque;
+
+typedef struct Scheduler Scheduler;
+
+typedef struct {
+  u64 morsels; // Morsels run, stolen ones included
+  u64 steals;  // Morsels taken from another worker's deque
+} SchedWorkerStats;
+
+typedef struct {
+  Scheduler *scheduler;
+  u32 index;   // 0 .. worker_count - 1, stable for the pool's lifetime
+  Arena arena; // Scratch owned by this worker; see sched_reset_arenas
+  SchedDeque deque;
+  u64 rng_state; // Picks steal victims
+  SchedWorkerStats stats;
+  pthread_t thread;
+} SchedWorker;
+
+// Runs on every worker for each job, with the 'arg' given to sched_run.
+typedef void (*SchedJobFn)(SchedWorker *worker, void *arg);
+
+struct Scheduler {
+  SchedWorker *workers;
+  u32 worker_count;
+  pthread_mutex_t run_lock; // Held by sched_run: one job at a time
+  pthread_mutex_t lock;     // Guards the fields below
+  pthread_cond_t job_ready;
+  pthread_cond_t job_done;
+  SchedJobFn job_fn;
+  void *job_arg;
+  u64 job_sequence;   // Bumped per job; workers run each one once
+  u32 active_workers; // Workers still inside job_fn
+  bool is_stopping;
+  u64 jobs; // Jobs run
+};
+
+// =================================================================================================
+// :: Scheduler API ::
+// =================================================================================================
+
+// Starts 'worker_count' workers (one per online core if 0), each with a
+// growable arena of 'arena_size'-byte huge-page blocks.
+bool sched_init(Scheduler *scheduler, u32 worker_count, usize arena_size);
+
+// Stops the workers and frees their deques and arenas. Must not race with
+// sched_run.
+void sched_shutdown(Scheduler *scheduler);
+
+// Splits [0, total) into morsels of 'morsel_size' units, runs 'fn' on every
+// worker and returns once all of them are done. Must not be called from a
+// worker. Returns false if the morsels could not be queued.
+bool sched_run(Scheduler *scheduler, usize total, usize morsel_size,
+               SchedJobFn fn, void *arg);
+
+// Hands 'worker' the next morsel of the running job: its own first, then one
+// stolen from another worker. Returns false once every morsel was taken.
+bool sched_next_morsel(SchedWorker *worker, SchedMorsel *out_morsel);
+
+// Worker arenas are never reset by jobs, so what a job leaves there (e.g.
+// partial results read by the caller) survives until this is called, once
+// the statement that ran the jobs is finished. Like Database.temp_arena.
+void sched_reset_arenas(Scheduler *scheduler);
+
+void sched_log_stats(const Scheduler *scheduler);
+
+// Number of online cores, at least 1.
+u32 sched_online_cores(void);
+
+#endif // SQLDB_SCHEDULER_H
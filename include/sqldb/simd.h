@@ -0,0 +1,110 @@
+#ifndef SQLDB_SIMD_H
+#define SQLDB_SIMD_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: SIMD Types ::
+// =================================================================================================
+
+// Kernels over fixed-width column buffers. Predicates write a selection
+// bitmap: bit i % 64 of word i / 64 is set when value i passes, and the bits
+// past 'count' in the last word are cleared. Aggregates fold the values whose
+// bit is set in 'bits' (every value if 'bits' is NULL) into a partial result
+// that callers combine across batches.
+//
+// Every kernel has a scalar version and, on x86-64, SSE4.2 and AVX2 versions
+// compiled with per-function target attributes, so the library builds without
+// extra flags. The best level the CPU supports is picked on first use.
+#define SIMD_BITMAP_WORDS(count) (((count) + 63) / 64)
+
+typedef enum {
+  SIMD_LEVEL_SCALAR,
+  SIMD_LEVEL_SSE42,
+  SIMD_LEVEL_AVX2,
+  SIMD_LEVEL_COUNT,
+} SimdLevel;
+
+typedef enum {
+  SIMD_CMP_EQUAL,
+  SIMD_CMP_NOT_EQUAL,
+  SIMD_CMP_LESS,
+  SIMD_CMP_LESS_EQUAL,
+  SIMD_CMP_GREATER,
+  SIMD_CMP_GREATER_EQUAL,
+} SimdCompare;
+
+// =================================================================================================
+// :: SIMD API ::
+// =================================================================================================
+
+// Best level supported by this CPU.
+SimdLevel simd_detect_level(void);
+
+// Level the kernels currently run at.
+SimdLevel simd_level(void);
+
+// Forces 'level', e.g. to compare implementations. Returns false if the CPU
+// does not support it.
+bool simd_set_level(SimdLevel level);
+
+const char *simd_level_name(SimdLevel level);
+
+// --- Predicates ---
+
+// value <op> constant. Float comparisons follow C: only <> holds for NaN.
+void simd_select_i32(const i32 *values, usize count, SimdCompare op,
+                     i32 constant, u64 *out_bits);
+void simd_select_i64(const i64 *values, usize count, SimdCompare op,
+                     i64 constant, u64 *out_bits);
+void simd_select_f64(const f64 *values, usize count, SimdCompare op,
+                     f64 constant, u64 *out_bits);
+
+// low <= value AND value <= high
+void simd_between_i32(const i32 *values, usize count, i32 low, i32 high,
+                      u64 *out_bits);
+void simd_between_i64(const i64 *values, usize count, i64 low, i64 high,
+                      u64 *out_bits);
+void simd_between_f64(const f64 *values, usize count, f64 low, f64 high,
+                      u64 *out_bits);
+
+// value IN (set[0], ..., set[set_count - 1]). Meant for short lists: every
+// value is compared with every element.
+void simd_in_i32(const i32 *values, usize count, const i32 *set,
+                 usize set_count, u64 *out_bits);
+void simd_in_i64(const i64 *values, usize count, const i64 *set,
+                 usize set_count, u64 *out_bits);
+void simd_in_f64(const f64 *values, usize count, const f64 *set,
+                 usize set_count, u64 *out_bits);
+
+// --- Aggregates ---
+
+// Integer sums wrap on overflow. Float sums are added in a different order at
+// each level, so they may differ in the last bits.
+i64 simd_sum_i32(const i32 *values, usize count, const u64 *bits);
+i64 simd_sum_i64(const i64 *values, usize count, const u64 *bits);
+f64 simd_sum_f64(const f64 *values, usize count, const u64 *bits);
+
+// Without selected values these return the identity: the type's maximum for
+// MIN and minimum for MAX (+/-infinity for floats). NaNs are skipped.
+i32 simd_min_i32(const i32 *values, usize count, const u64 *bits);
+i64 simd_min_i64(const i64 *values, usize count, const u64 *bits);
+f64 simd_min_f64(const f64 *values, usize count, const u64 *bits);
+i32 simd_max_i32(const i32 *values, usize count, const u64 *bits);
+i64 simd_max_i64(const i64 *values, usize count, const u64 *bits);
+f64 simd_max_f64(const f64 *values, usize count, const u64 *bits);
+
+// --- Bitmaps ---
+
+// Number of selected values, i.e. COUNT over the selection.
+usize simd_bitmap_count(const u64 *bits, usize count);
+
+// dst &= src and dst |= src, to combine predicates.
+void simd_bitmap_and(u64 *dst, const u64 *src, usize count);
+void simd_bitmap_or(u64 *dst, const u64 *src, usize count);
+
+// Writes the indexes of the selected values to 'out' in increasing order and
+// returns their number.
+u32 simd_bitmap_to_selection(const u64 *bits, usize count, u32 *out);
+
+#endif // SQLDB_SIMD_H
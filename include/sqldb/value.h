@@ -0,0 +1,30 @@
+#ifndef SQLDB_VALUE_H
+#define SQLDB_VALUE_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Value Types ::
+// =================================================================================================
+
+typedef enum {
+  SQL_VALUE_NULL,
+  SQL_VALUE_INTEGER,
+  SQL_VALUE_FLOAT,
+  SQL_VALUE_STRING,
+  SQL_VALUE_BOOLEAN,
+} SqlValueKind;
+
+// A single SQL value. Strings are views, usually into the query text, and
+// live as long as it does.
+typedef struct {
+  SqlValueKind kind;
+  union {
+    i64 integer;
+    f64 real;
+    StringView string; // Text between the quotes, '' not yet collapsed
+    bool boolean;
+  };
+} SqlValue;
+
+#endif // SQLDB_VALUE_H
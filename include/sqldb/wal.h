@@ -0,0 +1,153 @@
+#ifndef SQLDB_WAL_H
+#define SQLDB_WAL_H
+
+#include "base.h"
+#include "sqldb/histogram.h"
+#include "sqldb/page_file.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: Write-Ahead Log Types ::
+// =================================================================================================
+
+// Log sequence number: the position of a record in the (never reused) log
+// byte stream. Larger LSNs were written later.
+typedef u64 Lsn;
+
+#define INVALID_LSN 0
+#define WAL_FILE_SUFFIX "-wal"
+#define WAL_BUFFER_SIZE (1024 * 1024)
+
+#define DEFAULT_COMMIT_WINDOW_US 0
+#define DEFAULT_COMMIT_BATCH_SIZE 32
+#define MAX_COMMIT_WINDOW_US 100000
+#define DEFAULT_WAL_CHECKPOINT_BYTES (64 * 1024 * 1024)
+
+typedef enum {
+  WAL_RECORD_PAGE_WRITE = 1, // After-image of a byte range of one page
+  WAL_RECORD_COMMIT = 2,     // Transaction is durable once this is flushed
+} WalRecordType;
+
+// On-disk record header. Records are padded to 8 bytes; the payload (page
+// bytes for WAL_RECORD_PAGE_WRITE) follows the header directly.
+typedef struct {
+  u32 checksum; // CRC-32C of everything after this field, payload included
+  u32 size;     // Header + payload + padding
+  Lsn lsn;      // Must match the record's position, catches stale tails
+  u64 txn_id;
+  PageId page_id;
+  u32 page_offset; // First byte of the page covered by the payload
+  u32 length;      // Payload bytes
+  u32 type;        // WalRecordType
+  u32 reserved;
+} WalRecordHeader;
+
+typedef struct {
+  u64 records;     // Records appended
+  u64 bytes;       // Record bytes appended
+  u64 flushes;     // fdatasync calls on the log
+  u64 commits;     // Commit records made durable
+  u64 checkpoints; // Log truncations after the data file was synced
+  u64 recovered;   // Page writes replayed by wal_recover
+
+  Histogram commit_batch_sizes; // Commits made durable per log flush
+  Histogram flush_latency_us;   // Write + fdatasync time per log flush
+} WalStats;
+
+// Append-only redo log. Records are staged in an in-memory buffer and reach
+// the disk on wal_flush; a transaction is durable once its commit record is
+// flushed, independently of when its data pages are written back.
+//
+// Recovery is redo-only: page writes of committed transactions are replayed
+// in LSN order, everything else is discarded. Pages carrying uncommitted
+// changes must therefore stay in the buffer pool (pinned) until commit.
+//
+// Appends, commits and flushes may come from any number of threads. Commits
+// are made durable by group commit: the first committer to find no flush in
+// progress becomes the leader, optionally waits up to commit_window_us for
+// commit_batch_size commits to gather, and then writes and syncs everything
+// appended so far with a single fdatasync. Everyone else waits for a leader
+// to cover their commit record. Commits arriving while a flush is running
+// form the next batch, so batching happens even with a zero window.
+//
+// The log only shrinks at a checkpoint, once the changes it holds have been
+// written back to the synced data file. wal_needs_checkpoint tells the owner
+// of the buffer pool (db_commit) when the log has grown past checkpoint_bytes.
+typedef struct {
+  int fd;
+  u32 page_size;
+  Lsn base_lsn;    // LSN of the first record in the file
+  Lsn next_lsn;    // LSN the next appended record receives
+  Lsn flushed_lsn; // Every record below this is durable
+  u64 next_txn_id;
+
+  u8 *buffer;        // Records not yet written to the file
+  u8 *flush_buffer;  // Swapped with 'buffer' by the flushing leader
+  usize buffer_used; // Bytes staged in 'buffer'
+  Lsn buffer_lsn;    // LSN of buffer[0]
+
+  pthread_mutex_t lock;
+  pthread_cond_t flushed;     // Broadcast when a leader's flush finishes
+  pthread_cond_t batch_ready; // Wakes a leader waiting for its batch to fill
+  bool flush_in_progress;     // A leader is writing/syncing without the lock
+  bool io_failed;             // Sticky: durability can no longer be promised
+  u32 pending_commits;        // Commit records not yet claimed by a leader
+  u32 commit_window_us;
+  u32 commit_batch_size;
+  u64 checkpoint_bytes; // Log size at which wal_needs_checkpoint turns true
+
+  WalStats stats;
+} Wal;
+
+// =================================================================================================
+// :: Write-Ahead Log API ::
+// =================================================================================================
+
+// Opens (creating if needed) the log at 'path'. Existing records are left in
+// place for wal_recover.
+bool wal_open(Wal *wal, const char *path, u32 page_size);
+
+// Closes the log without flushing staged records.
+void wal_close(Wal *wal);
+
+// Sets how long a group-commit leader may wait (in microseconds, 0 = never)
+// for 'batch_size' commits to gather before it flushes.
+void wal_set_group_commit(Wal *wal, u32 window_us, u32 batch_size);
+
+// Replays the page writes of every committed transaction into 'file', syncs
+// it, then truncates the log. Stops at the first torn or corrupt record.
+bool wal_recover(Wal *wal, PageFile *file);
+
+u64 wal_begin_txn(Wal *wal);
+
+// Logs that bytes [offset, offset + length) of 'page_id' now hold 'data'.
+// Returns the record's LSN, or INVALID_LSN if it could not be staged.
+Lsn wal_log_page_write(Wal *wal, u64 txn_id, PageId page_id, u32 offset,
+                       const u8 *data, u32 length);
+
+// Appends a commit record for 'txn_id' and waits until it is durable, sharing
+// the log flush with concurrent commits.
+bool wal_commit(Wal *wal, u64 txn_id);
+
+// Makes every record below 'lsn' durable (at least; it may flush more).
+bool wal_flush(Wal *wal, Lsn lsn);
+
+// LSN the next appended record will receive.
+Lsn wal_next_lsn(Wal *wal);
+
+// True once the records in the log take up at least checkpoint_bytes.
+bool wal_needs_checkpoint(Wal *wal);
+
+// Discards the log, given that every change logged below 'lsn' has reached
+// the data file and the data file has been synced. If records were appended
+// at or after 'lsn' in the meantime, the log is kept whole and the checkpoint
+// is left to a later call. Waits for a running flush; safe to call while
+// other threads append and commit.
+bool wal_checkpoint(Wal *wal, Lsn lsn);
+
+// Logs counters plus the commit batch size and flush latency histograms.
+// Call once the log is quiescent (e.g. at shutdown).
+void wal_log_stats(const Wal *wal);
+
+#endif // SQLDB_WAL_H
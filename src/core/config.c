@@ -1,4 +1,4 @@
-#include "sqldb/database.h"
+#include "sqldb/core.h"
 
 // =================================================================================================
 // :: Private Helper Functions ::
@@ -16,8 +16,18 @@ void db_config_init_defaults(DatabaseConfig *config) {
   config->page_size = DEFAULT_PAGE_SIZE;
   config->cache_size_mb = DEFAULT_CACHE_SIZE_MB;
   config->port = DEFAULT_PORT;
+  config->max_connections = DEFAULT_MAX_CONNECTIONS;
   config->enable_wal = false;
+  config->commit_window_us = DEFAULT_COMMIT_WINDOW_US;
+  config->commit_batch_size = DEFAULT_COMMIT_BATCH_SIZE;
   config->read_only = false;
+  config->direct_io = false;
+  config->io_queue_depth = DEFAULT_IO_QUEUE_DEPTH;
+  config->eviction_policy = DEFAULT_EVICTION_POLICY;
+  config->mmap_advice = DEFAULT_PAGE_ACCESS_HINT;
+  config->page_trace_path = NULL;
+  config->plan_cache_entries = DEFAULT_PLAN_CACHE_ENTRIES;
+  config->worker_threads = DEFAULT_WORKER_THREADS;
   config->log_level = LOG_LEVEL_INFO;
 }
 
@@ -47,6 +57,18 @@ bool db_config_from_args(DatabaseConfig *config, int argc, char **argv) {
         return false;
       }
       config->port = (u16)port;
+    } else if (strcmp(arg, "--max-connections") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long connections = strtol(argv[i], NULL, 10);
+      if (connections <= 0 || connections > MAX_CONNECTIONS_LIMIT) {
+        LOG_ERROR("Max connections must be between 1 and %d",
+                  MAX_CONNECTIONS_LIMIT);
+        return false;
+      }
+      config->max_connections = (u32)connections;
     } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--cache") == 0) {
       if (++i >= argc) {
         LOG_ERROR("Option %s requires a value", arg);
@@ -70,10 +92,98 @@ bool db_config_from_args(DatabaseConfig *config, int argc, char **argv) {
         return false;
       }
       config->page_size = (u32)page_size;
+    } else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--eviction") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      if (!eviction_policy_from_name(argv[i], &config->eviction_policy)) {
+        LOG_ERROR("Unknown eviction policy: %s (expected clock or 2q)",
+                  argv[i]);
+        return false;
+      }
+    } else if (strcmp(arg, "--page-trace") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      config->page_trace_path = argv[i];
+    } else if (strcmp(arg, "--plan-cache") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long entries = strtol(argv[i], NULL, 10);
+      if (entries <= 0 || entries > 1048576) {
+        LOG_ERROR("Plan cache size must be between 1 and 1048576 entries");
+        return false;
+      }
+      config->plan_cache_entries = (u32)entries;
+    } else if (strcmp(arg, "--workers") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long workers = strtol(argv[i], NULL, 10);
+      if (workers < 0 || workers > MAX_WORKER_THREADS) {
+        LOG_ERROR("Worker threads must be between 0 and %d (0: one per core)",
+                  MAX_WORKER_THREADS);
+        return false;
+      }
+      config->worker_threads = (u32)workers;
     } else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--read-only") == 0) {
       config->read_only = true;
+    } else if (strcmp(arg, "--mmap-advice") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      if (!pf_access_hint_from_name(argv[i], &config->mmap_advice) ||
+          config->mmap_advice == PAGE_ACCESS_WILLNEED) {
+        LOG_ERROR("Unknown mmap advice: %s (expected normal, random or "
+                  "sequential)",
+                  argv[i]);
+        return false;
+      }
+    } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--direct-io") == 0) {
+      config->direct_io = true;
+    } else if (strcmp(arg, "--io-depth") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long depth = strtol(argv[i], NULL, 10);
+      if (depth <= 0 || depth > MAX_IO_QUEUE_DEPTH) {
+        LOG_ERROR("I/O queue depth must be between 1 and %d",
+                  MAX_IO_QUEUE_DEPTH);
+        return false;
+      }
+      config->io_queue_depth = (u32)depth;
     } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--wal") == 0) {
       config->enable_wal = true;
+    } else if (strcmp(arg, "--commit-window") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long window_us = strtol(argv[i], NULL, 10);
+      if (window_us < 0 || window_us > MAX_COMMIT_WINDOW_US) {
+        LOG_ERROR("Commit window must be between 0 and %d us",
+                  MAX_COMMIT_WINDOW_US);
+        return false;
+      }
+      config->commit_window_us = (u32)window_us;
+    } else if (strcmp(arg, "--commit-batch") == 0) {
+      if (++i >= argc) {
+        LOG_ERROR("Option %s requires a value", arg);
+        return false;
+      }
+      long batch_size = strtol(argv[i], NULL, 10);
+      if (batch_size <= 0 || batch_size > 65536) {
+        LOG_ERROR("Commit batch size must be between 1 and 65536");
+        return false;
+      }
+      config->commit_batch_size = (u32)batch_size;
     } else if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
       config->log_level = LOG_LEVEL_DEBUG;
     } else if (strcmp(arg, "-q") == 0 || strcmp(arg, "--quiet") == 0) {
@@ -97,12 +207,37 @@ static void print_usage(const char *program_name) {
   printf("  -f, --file <path>       Database file path (default: %s)\n",
          DEFAULT_DB_FILE);
   printf("  -p, --port <port>       Server port (default: %d)\n", DEFAULT_PORT);
+  printf("      --max-connections <n>\n"
+         "                          Clients served at once (default: %d)\n",
+         DEFAULT_MAX_CONNECTIONS);
   printf("  -c, --cache <MB>        Cache size in MB (default: %d)\n",
          DEFAULT_CACHE_SIZE_MB);
   printf("  -s, --page-size <size>  Page size in bytes (default: %d)\n",
          DEFAULT_PAGE_SIZE);
-  printf("  -r, --read-only         Open database in read-only mode\n");
+  printf("  -e, --eviction <policy> Page eviction policy: clock, 2q "
+         "(default: %s)\n",
+         eviction_policy_name(DEFAULT_EVICTION_POLICY));
+  printf("      --page-trace <path> Record page accesses for cache_replay\n");
+  printf("      --plan-cache <n>    Cached statement plans (default: %d)\n",
+         DEFAULT_PLAN_CACHE_ENTRIES);
+  printf("      --workers <n>       Query worker threads (default: one per "
+         "core)\n");
+  printf("  -r, --read-only         Open database read-only, served from "
+         "mmap\n");
+  printf("      --mmap-advice <a>   Read-only access pattern: normal, random, "
+         "sequential\n"
+         "                          (default: %s)\n",
+         pf_access_hint_name(DEFAULT_PAGE_ACCESS_HINT));
+  printf("  -d, --direct-io         Bypass the OS page cache (O_DIRECT)\n");
+  printf("      --io-depth <n>      Async I/O queue depth (default: %d)\n",
+         DEFAULT_IO_QUEUE_DEPTH);
   printf("  -w, --wal               Enable Write-Ahead Logging\n");
+  printf("      --commit-window <n> Group commit wait in us for a batch "
+         "(default: %d)\n",
+         DEFAULT_COMMIT_WINDOW_US);
+  printf("      --commit-batch <n>  Group commit flushes once n commits "
+         "wait (default: %d)\n",
+         DEFAULT_COMMIT_BATCH_SIZE);
   printf("  -v, --verbose           Enable debug logging\n");
   printf("  -q, --quiet             Enable quiet mode (errors only)\n");
   printf("  -h, --help              Show this help message\n");
@@ -1,38 +1,109 @@
-#include "sqldb/database.h"
+#include "sqldb/core.h"
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool db_uses_wal(const Database *db);
+static bool db_open_wal(Database *db);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
 
 bool db_init(Database *db, const DatabaseConfig *config) {
   ASSERT(db && config);
   LOG_INFO("Initializing database with file: %s", config->db_file_path);
 
-  usize temp_arena_size = 1024 * 1024; // 1 MB for temporary allocations
-  usize main_arena_size = config->cache_size_mb * 1024 * 1024;
+  usize temp_arena_block_size = 1024 * 1024; // Grows by chaining blocks
+  usize cache_size_bytes = (usize)config->cache_size_mb * 1024 * 1024;
+  usize frame_count = cache_size_bytes / config->page_size;
 
   db->config = config;
-  db->main_arena = arena_init(main_arena_size);
-  db->temp_arena = arena_init(temp_arena_size);
+  if (!pf_open(&db->db_file, config->db_file_path, config->page_size,
+               config->read_only, config->direct_io)) {
+    LOG_ERROR("Failed to open database file: %s", config->db_file_path);
+    return false;
+  }
 
-  const char *mode = config->read_only ? "rb" : "rb+";
-  db->db_file = fopen(config->db_file_path, mode);
-  if (!db->db_file && !config->read_only) {
-    LOG_INFO("Database file doesn't exist, creating new file: %s",
-             config->db_file_path);
-    db->db_file = fopen(config->db_file_path, "wb+");
+  // Read-only databases are served straight from the kernel page cache, so
+  // the buffer pool needs no page copies. Direct I/O explicitly asks to
+  // bypass that cache, so it keeps the pread path.
+  if (config->read_only && !pf_uses_direct_io(&db->db_file) &&
+      !pf_map(&db->db_file, config->mmap_advice)) {
+    LOG_WARN("Falling back to buffered reads for the read-only database");
   }
 
-  if (!db->db_file) {
-    LOG_ERROR("Failed to open database file: %s", config->db_file_path);
-    arena_free_all(&db->temp_arena);
-    arena_free_all(&db->main_arena);
+  if (config->enable_wal && config->read_only) {
+    LOG_WARN("Ignoring --wal for a read-only database");
+  }
+  if (db_uses_wal(db) && !db_open_wal(db)) {
+    pf_close(&db->db_file);
     return false;
   }
 
-  // TODO: Initialize page cache hash table
-  // db->page_cache = ht_oa_init(256, page_hash_fn, page_equal_fn,
-  // db->main_arena);
+  usize main_arena_size =
+      bp_required_arena_size(frame_count, config->page_size,
+                             config->eviction_policy, db->db_file.map != NULL) +
+      plan_cache_required_arena_size(config->plan_cache_entries,
+                                     DEFAULT_PLAN_CACHE_ENTRY_SIZE);
+  db->main_arena = arena_init(main_arena_size);
+  db->temp_arena = arena_init_growable(temp_arena_block_size, false);
+
+  if (!async_io_init(&db->io, &db->db_file, config->io_queue_depth,
+                     ASYNC_IO_BACKEND_IO_URING)) {
+    LOG_ERROR("Failed to initialize async I/O engine");
+    goto fail_arenas;
+  }
+  if (!bp_init(&db->page_cache, &db->main_arena, frame_count,
+               config->page_size, config->eviction_policy, &db->db_file)) {
+    LOG_ERROR("Failed to initialize buffer pool");
+    goto fail_async_io;
+  }
+  bp_set_async_io(&db->page_cache, &db->io);
+  // The plan cache lives in the main arena and needs no teardown of its own.
+  if (!plan_cache_init(&db->plan_cache, &db->main_arena,
+                       config->plan_cache_entries,
+                       DEFAULT_PLAN_CACHE_ENTRY_SIZE)) {
+    LOG_ERROR("Failed to initialize plan cache");
+    goto fail_buffer_pool;
+  }
+  if (!sched_init(&db->scheduler, config->worker_threads,
+                  (usize)DEFAULT_WORKER_ARENA_MB * 1024 * 1024)) {
+    LOG_ERROR("Failed to start the query workers");
+    goto fail_buffer_pool;
+  }
+  if (db_uses_wal(db)) {
+    bp_set_wal(&db->page_cache, &db->wal);
+  }
+
+  if (config->page_trace_path) {
+    FILE *trace_file = fopen(config->page_trace_path, "w");
+    if (trace_file) {
+      bp_set_trace_file(&db->page_cache, trace_file);
+      LOG_INFO("Recording page accesses to %s", config->page_trace_path);
+    } else {
+      LOG_WARN("Failed to open page trace file: %s", config->page_trace_path);
+    }
+  }
 
   db->is_initialized = true;
   LOG_INFO("Database initialized successfully");
   return true;
+
+  // Undoes the steps above in reverse order, from the one that failed.
+fail_buffer_pool:
+  bp_shutdown(&db->page_cache);
+fail_async_io:
+  async_io_shutdown(&db->io);
+fail_arenas:
+  arena_free_all(&db->temp_arena);
+  arena_free_all(&db->main_arena);
+  if (db_uses_wal(db)) {
+    wal_close(&db->wal);
+  }
+  pf_close(&db->db_file);
+  return false;
 }
 
 void db_shutdown(Database *db) {
@@ -42,15 +113,115 @@ void db_shutdown(Database *db) {
 
   LOG_INFO("Shutting down database");
 
-  if (db->db_file) {
-    fclose(db->db_file);
-    db->db_file = NULL;
+  Lsn checkpoint_lsn = db_uses_wal(db) ? wal_next_lsn(&db->wal) : INVALID_LSN;
+  bool flushed = db->config->read_only || bp_flush_all(&db->page_cache);
+  if (!flushed) {
+    LOG_ERROR("Failed to write back dirty pages");
+  }
+  bp_log_stats(&db->page_cache);
+  plan_cache_log_stats(&db->plan_cache);
+  sched_log_stats(&db->scheduler);
+  sched_shutdown(&db->scheduler);
+  if (db_uses_wal(db)) {
+    // Every logged change is now in the synced data file; otherwise keep the
+    // log so the next start can replay it.
+    if (flushed) {
+      wal_checkpoint(&db->wal, checkpoint_lsn);
+    }
+    wal_log_stats(&db->wal);
+  }
+  if (db->page_cache.trace_file) {
+    fclose(db->page_cache.trace_file);
+    bp_set_trace_file(&db->page_cache, NULL);
   }
+  bp_shutdown(&db->page_cache);
+  async_io_shutdown(&db->io);
+  if (db_uses_wal(db)) {
+    wal_close(&db->wal);
+  }
+
+  pf_close(&db->db_file);
 
-  ht_oa_free(&db->page_cache);
   arena_free_all(&db->main_arena);
   arena_free_all(&db->temp_arena);
 
   db->is_initialized = false;
   LOG_INFO("Database shutdown complete");
-}
\ No newline at end of file
+}
+
+u64 db_begin_txn(Database *db) {
+  ASSERT(db && db->is_initialized);
+  return db_uses_wal(db) ? wal_begin_txn(&db->wal) : ++db->next_txn_id;
+}
+
+bool db_commit(Database *db, u64 txn_id) {
+  ASSERT(db && db->is_initialized);
+  if (db_uses_wal(db)) {
+    if (!wal_commit(&db->wal, txn_id)) {
+      return false;
+    }
+    // The commit is durable either way; a failed checkpoint keeps the log.
+    if (wal_needs_checkpoint(&db->wal) && !db_checkpoint(db)) {
+      LOG_WARN("WAL checkpoint failed, the log keeps growing");
+    }
+    return true;
+  }
+  return bp_flush_all(&db->page_cache);
+}
+
+bool db_checkpoint(Database *db) {
+  ASSERT(db && db->is_initialized);
+  if (!db_uses_wal(db)) {
+    return true;
+  }
+  if (bp_has_pinned_dirty_page(&db->page_cache)) {
+    LOG_DEBUG("WAL checkpoint deferred: a pinned page is dirty");
+    return true;
+  }
+  // Every record below this LSN describes a change already in the pool, so
+  // once the pool is written back and synced the log up to here is redundant.
+  Lsn lsn = wal_next_lsn(&db->wal);
+  return bp_flush_all(&db->page_cache) && wal_checkpoint(&db->wal, lsn);
+}
+
+const PreparedStatement *db_prepare(Database *db, StringView sql,
+                                    SqlParams *out_params,
+                                    SqlParseError *out_error) {
+  ASSERT(db && db->is_initialized);
+  return plan_cache_prepare(&db->plan_cache, &db->temp_arena, sql, out_params,
+                            out_error);
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool db_uses_wal(const Database *db) {
+  return db->config->enable_wal && !db->config->read_only;
+}
+
+// Opens '<db_file_path>-wal' and replays it into the data file before the
+// buffer pool can cache any page.
+static bool db_open_wal(Database *db) {
+  usize path_len = strlen(db->config->db_file_path) + sizeof(WAL_FILE_SUFFIX);
+  char *wal_path = (char *)malloc(path_len);
+  if (!wal_path) {
+    LOG_ERROR("Failed to allocate the WAL path");
+    return false;
+  }
+  snprintf(wal_path, path_len, "%s%s", db->config->db_file_path,
+           WAL_FILE_SUFFIX);
+
+  bool ok = wal_open(&db->wal, wal_path, db->config->page_size);
+  if (ok) {
+    wal_set_group_commit(&db->wal, db->config->commit_window_us,
+                         db->config->commit_batch_size);
+  }
+  if (ok && !wal_recover(&db->wal, &db->db_file)) {
+    LOG_ERROR("WAL recovery failed: %s", wal_path);
+    wal_close(&db->wal);
+    ok = false;
+  }
+  free(wal_path);
+  return ok;
+}
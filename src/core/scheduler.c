@@ -0,0 +1,279 @@
+#include "sqldb/scheduler.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static _Thread_local SchedWorker *t_current_worker = NULL;
+
+static void *sched_worker_main(void *arg);
+static bool sched_deque_reserve(SchedDeque *deque, usize capacity);
+static bool sched_deque_pop_head(SchedDeque *deque, SchedMorsel *out_morsel);
+static bool sched_deque_pop_tail(SchedDeque *deque, SchedMorsel *out_morsel);
+static void sched_stop_workers(Scheduler *scheduler, u32 started);
+static u64 sched_rng_next(u64 *state);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool sched_init(Scheduler *scheduler, u32 worker_count, usize arena_size) {
+  ASSERT(scheduler && arena_size > 0);
+  ZERO_STRUCT(*scheduler);
+  if (worker_count == 0) {
+    worker_count = sched_online_cores();
+  }
+  worker_count = MIN(worker_count, (u32)MAX_WORKER_THREADS);
+
+  scheduler->workers =
+      (SchedWorker *)calloc(worker_count, sizeof(SchedWorker));
+  if (!scheduler->workers) {
+    LOG_ERROR("Failed to allocate %u workers", worker_count);
+    return false;
+  }
+  scheduler->worker_count = worker_count;
+  pthread_mutex_init(&scheduler->run_lock, NULL);
+  pthread_mutex_init(&scheduler->lock, NULL);
+  pthread_cond_init(&scheduler->job_ready, NULL);
+  pthread_cond_init(&scheduler->job_done, NULL);
+
+  for (u32 w = 0; w < worker_count; ++w) {
+    SchedWorker *worker = &scheduler->workers[w];
+    worker->scheduler = scheduler;
+    worker->index = w;
+    worker->arena = arena_init_growable(arena_size, true);
+    worker->rng_state = 0x9E3779B97F4A7C15ULL * (w + 1);
+    pthread_mutex_init(&worker->deque.lock, NULL);
+  }
+  for (u32 w = 0; w < worker_count; ++w) {
+    SchedWorker *worker = &scheduler->workers[w];
+    if (pthread_create(&worker->thread, NULL, sched_worker_main, worker) !=
+        0) {
+      LOG_ERROR("Failed to start worker thread %u", w);
+      sched_stop_workers(scheduler, w);
+      sched_shutdown(scheduler);
+      return false;
+    }
+  }
+  LOG_INFO("Started %u worker threads (%zu KB arena each)", worker_count,
+           arena_size / 1024);
+  return true;
+}
+
+void sched_shutdown(Scheduler *scheduler) {
+  ASSERT(scheduler);
+  if (!scheduler->workers) {
+    return;
+  }
+  if (!scheduler->is_stopping) {
+    sched_stop_workers(scheduler, scheduler->worker_count);
+  }
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    SchedWorker *worker = &scheduler->workers[w];
+    pthread_mutex_destroy(&worker->deque.lock);
+    free(worker->deque.morsels);
+    arena_free_all(&worker->arena);
+  }
+  pthread_cond_destroy(&scheduler->job_done);
+  pthread_cond_destroy(&scheduler->job_ready);
+  pthread_mutex_destroy(&scheduler->lock);
+  pthread_mutex_destroy(&scheduler->run_lock);
+  free(scheduler->workers);
+  scheduler->workers = NULL;
+  scheduler->worker_count = 0;
+}
+
+bool sched_run(Scheduler *scheduler, usize total, usize morsel_size,
+               SchedJobFn fn, void *arg) {
+  ASSERT(scheduler && scheduler->workers && fn && morsel_size > 0);
+  ASSERT_MSG(!t_current_worker, "Jobs cannot be started from a worker");
+  pthread_mutex_lock(&scheduler->run_lock);
+
+  // Worker w gets morsels [w * n / W, (w + 1) * n / W). Every deque is
+  // sized first so a failure leaves nothing queued. The workers are idle
+  // between jobs, but the deque locks still order these writes before any
+  // steal.
+  u32 worker_count = scheduler->worker_count;
+  usize morsel_count = total / morsel_size + (total % morsel_size != 0);
+  for (u32 w = 0; w < worker_count; ++w) {
+    usize share = (w + 1) * morsel_count / worker_count -
+                  w * morsel_count / worker_count;
+    if (!sched_deque_reserve(&scheduler->workers[w].deque, share)) {
+      LOG_ERROR("Failed to queue %zu morsels", morsel_count);
+      pthread_mutex_unlock(&scheduler->run_lock);
+      return false;
+    }
+  }
+  for (u32 w = 0; w < worker_count; ++w) {
+    SchedDeque *deque = &scheduler->workers[w].deque;
+    usize first = w * morsel_count / worker_count;
+    usize last = (w + 1) * morsel_count / worker_count;
+    pthread_mutex_lock(&deque->lock);
+    deque->head = 0;
+    deque->count = 0;
+    for (usize m = first; m < last; ++m) {
+      usize begin = m * morsel_size;
+      deque->morsels[deque->count++] =
+          (SchedMorsel){begin, MIN(begin + morsel_size, total)};
+    }
+    pthread_mutex_unlock(&deque->lock);
+  }
+
+  pthread_mutex_lock(&scheduler->lock);
+  scheduler->job_fn = fn;
+  scheduler->job_arg = arg;
+  scheduler->active_workers = worker_count;
+  scheduler->job_sequence++;
+  pthread_cond_broadcast(&scheduler->job_ready);
+  while (scheduler->active_workers > 0) {
+    pthread_cond_wait(&scheduler->job_done, &scheduler->lock);
+  }
+  scheduler->job_fn = NULL;
+  scheduler->job_arg = NULL;
+  scheduler->jobs++;
+  pthread_mutex_unlock(&scheduler->lock);
+
+  pthread_mutex_unlock(&scheduler->run_lock);
+  return true;
+}
+
+bool sched_next_morsel(SchedWorker *worker, SchedMorsel *out_morsel) {
+  ASSERT(worker && out_morsel);
+  if (sched_deque_pop_head(&worker->deque, out_morsel)) {
+    worker->stats.morsels++;
+    return true;
+  }
+  // Every morsel is queued before the job starts, so one sweep over the
+  // other deques finding nothing means the job has no work left.
+  Scheduler *scheduler = worker->scheduler;
+  u32 worker_count = scheduler->worker_count;
+  u32 start = (u32)(sched_rng_next(&worker->rng_state) % worker_count);
+  for (u32 i = 0; i < worker_count; ++i) {
+    SchedWorker *victim = &scheduler->workers[(start + i) % worker_count];
+    if (victim != worker && sched_deque_pop_tail(&victim->deque, out_morsel)) {
+      worker->stats.morsels++;
+      worker->stats.steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void sched_reset_arenas(Scheduler *scheduler) {
+  ASSERT(scheduler);
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    arena_reset(&scheduler->workers[w].arena);
+  }
+}
+
+void sched_log_stats(const Scheduler *scheduler) {
+  ASSERT(scheduler);
+  u64 morsels = 0;
+  u64 steals = 0;
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    morsels += scheduler->workers[w].stats.morsels;
+    steals += scheduler->workers[w].stats.steals;
+  }
+  LOG_INFO("Scheduler: %u workers, %" PRIu64 " jobs, %" PRIu64
+           " morsels (%" PRIu64 " stolen)",
+           scheduler->worker_count, scheduler->jobs, morsels, steals);
+}
+
+u32 sched_online_cores(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (u32)cores : 1;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static void *sched_worker_main(void *arg) {
+  SchedWorker *worker = (SchedWorker *)arg;
+  Scheduler *scheduler = worker->scheduler;
+  t_current_worker = worker;
+
+  u64 seen_sequence = 0;
+  pthread_mutex_lock(&scheduler->lock);
+  for (;;) {
+    while (!scheduler->is_stopping &&
+           scheduler->job_sequence == seen_sequence) {
+      pthread_cond_wait(&scheduler->job_ready, &scheduler->lock);
+    }
+    if (scheduler->is_stopping) {
+      break;
+    }
+    seen_sequence = scheduler->job_sequence;
+    SchedJobFn fn = scheduler->job_fn;
+    void *job_arg = scheduler->job_arg;
+    pthread_mutex_unlock(&scheduler->lock);
+
+    fn(worker, job_arg);
+
+    pthread_mutex_lock(&scheduler->lock);
+    if (--scheduler->active_workers == 0) {
+      pthread_cond_signal(&scheduler->job_done);
+    }
+  }
+  pthread_mutex_unlock(&scheduler->lock);
+  return NULL;
+}
+
+static bool sched_deque_reserve(SchedDeque *deque, usize capacity) {
+  if (capacity <= deque->capacity) {
+    return true;
+  }
+  pthread_mutex_lock(&deque->lock);
+  SchedMorsel *morsels =
+      (SchedMorsel *)realloc(deque->morsels, capacity * sizeof(SchedMorsel));
+  if (morsels) {
+    deque->morsels = morsels;
+    deque->capacity = capacity;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return morsels != NULL;
+}
+
+static bool sched_deque_pop_head(SchedDeque *deque, SchedMorsel *out_morsel) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->count > 0;
+  if (found) {
+    *out_morsel = deque->morsels[deque->head++];
+    deque->count--;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+static bool sched_deque_pop_tail(SchedDeque *deque, SchedMorsel *out_morsel) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->count > 0;
+  if (found) {
+    *out_morsel = deque->morsels[deque->head + --deque->count];
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+// Wakes the first 'started' workers to exit and joins them.
+static void sched_stop_workers(Scheduler *scheduler, u32 started) {
+  pthread_mutex_lock(&scheduler->lock);
+  scheduler->is_stopping = true;
+  pthread_cond_broadcast(&scheduler->job_ready);
+  pthread_mutex_unlock(&scheduler->lock);
+  for (u32 w = 0; w < started; ++w) {
+    pthread_join(scheduler->workers[w].thread, NULL);
+  }
+}
+
+static u64 sched_rng_next(u64 *state) {
+  u64 x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
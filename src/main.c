@@ -1,8 +1,8 @@
 #define BASE_IMPLEMENTATION
 #include "sqldb/core.h"
+#include "sqldb/network.h"
 
 #include <signal.h>
-#include <unistd.h>
 
 // =================================================================================================
 // :: Global Variables ::
@@ -29,19 +29,36 @@ static int run_database_server(Database *db) {
   LOG_INFO("Database file: %s", db->config->db_file_path);
   LOG_INFO("Page size: %u bytes", db->config->page_size);
   LOG_INFO("Cache size: %u MB", db->config->cache_size_mb);
+  LOG_INFO("Eviction policy: %s",
+           eviction_policy_name(db->config->eviction_policy));
+  LOG_INFO("Query workers: %u", db->scheduler.worker_count);
   LOG_INFO("Read-only mode: %s",
            db->config->read_only ? "enabled" : "disabled");
+  if (db->db_file.map) {
+    LOG_INFO("Memory-mapped: %zu bytes (%s access)", db->db_file.map_size,
+             pf_access_hint_name(db->config->mmap_advice));
+  }
+  LOG_INFO("Direct I/O: %s", db->db_file.direct_io ? "enabled" : "disabled");
+  LOG_INFO("I/O backend: %s (queue depth %u)",
+           async_io_backend_name(db->io.backend), db->io.queue_depth);
   LOG_INFO("WAL mode: %s", db->config->enable_wal ? "enabled" : "disabled");
-  while (!g_shutdown_requested) {
-    // TODO: Implement main server logic
-    // - Accept client connections
-    // - Parse SQL queries
-    // - Execute queries
-    // - Return results
-    usleep(100000); // 100ms
+  if (db->config->enable_wal) {
+    LOG_INFO("Group commit: %u us window, batches of up to %u",
+             db->config->commit_window_us, db->config->commit_batch_size);
+  }
+
+  NetServer server;
+  if (!net_server_init(&server, db, db->config->port,
+                       db->config->max_connections)) {
+    return EXIT_FAILURE;
   }
+  LOG_INFO("Listening on port %u (up to %u connections)", server.port,
+           server.max_connections);
+  bool ok = net_server_run(&server, &g_shutdown_requested);
+  net_server_log_stats(&server);
+  net_server_shutdown(&server);
   LOG_INFO("Server loop exited");
-  return EXIT_SUCCESS;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 // =================================================================================================
@@ -0,0 +1,1907 @@
+#include "sqldb/network.h"
+#include "sqldb/eval.h"
+#include "sqldb/lexer.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+typedef enum {
+  PG_STEP_DONE,    // Message answered
+  PG_STEP_BLOCKED, // Not enough room in the output buffer; nothing changed
+  PG_STEP_YIELDED, // Work left that the server comes back to
+} PgStep;
+
+typedef enum {
+  PG_RUN_DONE,      // Every row sent, CommandComplete queued
+  PG_RUN_SUSPENDED, // Execute's row limit reached with rows left
+  PG_RUN_BLOCKED,   // Output buffer full; the portal resumes where it stopped
+  PG_RUN_YIELDED,   // PG_ROWS_PER_TURN rows looked at; resumes the same way
+  PG_RUN_FAILED,    // Error set; rows queued so far stay queued
+} PgRunResult;
+
+typedef enum {
+  PG_FRAME_MESSAGE, // A complete message
+  PG_FRAME_PARTIAL, // More input needed
+  PG_FRAME_INVALID, // Length out of range
+} PgFrame;
+
+typedef struct {
+  const u8 *data;
+  u32 length;
+  u32 position;
+  bool is_malformed; // Read past the end, or a string without its NUL
+} PgReader;
+
+// Appends one message to conn->out. A message that does not fit is dropped
+// whole by pg_end_message, so the buffer only ever holds complete messages.
+typedef struct {
+  NetConnection *conn;
+  u32 start; // Offset of the type byte
+  bool overflow;
+} PgWriter;
+
+typedef struct {
+  u8 type; // 0 for the untyped startup packets
+  PgReader body;
+  u32 size; // Input bytes the message takes
+} PgMessage;
+
+// What a statement is run with: its text, and for the extended protocol the
+// placeholders found by Parse and the values given by Bind.
+typedef struct {
+  StringView sql;
+  u32 base; // Offset of 'sql' in the client's query string, for positions
+  const u16 *placeholders;
+  u32 placeholder_count;
+  const SqlValue *values; // One per $n; NULL when only describing
+  const u32 *types;       // Declared OID of every $n, may be NULL
+  u32 value_count;
+} PgSource;
+
+typedef struct {
+  const char *tag; // CommandComplete tag of a utility command, else NULL
+  bool is_discard; // DISCARD ALL: drop every statement and portal
+  EvalPlan query;  // Without a tag; query.select is NULL with one
+} PgPlan;
+
+static void pg_fatal(NetConnection *conn, const char *code, const char *fmt,
+                     ...) __attribute__((format(printf, 3, 4)));
+
+static u8 pg_read_u8(PgReader *r);
+static u16 pg_read_u16(PgReader *r);
+static u16 pg_get_u16(const u8 *data);
+static u32 pg_read_u32(PgReader *r);
+static const char *pg_read_string(PgReader *r, u32 *out_length);
+static const u8 *pg_read_bytes(PgReader *r, u32 count);
+
+static void pg_begin_message(PgWriter *w, NetConnection *conn, u8 type);
+static void pg_put_bytes(PgWriter *w, const void *data, usize length);
+static void pg_put_u8(PgWriter *w, u8 value);
+static void pg_put_u16(PgWriter *w, u16 value);
+static void pg_put_u32(PgWriter *w, u32 value);
+static void pg_put_u64(PgWriter *w, u64 value);
+static void pg_put_string(PgWriter *w, const char *string);
+static void pg_put_name(PgWriter *w, StringView name, bool fold_case);
+static bool pg_end_message(PgWriter *w);
+static void pg_abort_message(PgWriter *w);
+static bool pg_send_empty(NetConnection *conn, u8 type);
+static bool pg_send_ready(NetConnection *conn);
+static bool pg_send_parameter(NetConnection *conn, const char *name,
+                              const char *value);
+static bool pg_send_command_complete(NetConnection *conn, const char *tag);
+static bool pg_send_error(NetConnection *conn, const char *severity,
+                          const SqlError *error);
+static bool pg_report_error(NetConnection *conn, PgSession *session,
+                            const SqlError *error);
+
+static PgFrame pg_next_message(const PgSession *session, const u8 *data,
+                               u32 length, PgMessage *out);
+static PgStep pg_handle_message(NetServer *server, NetConnection *conn,
+                                PgMessage *message);
+static PgStep pg_handle_startup(NetServer *server, NetConnection *conn,
+                                PgReader *r);
+static void pg_cancel_request(NetServer *server, u32 process_id,
+                              u32 secret_key);
+static PgStep pg_handle_query(NetConnection *conn, PgReader *r);
+static PgStep pg_handle_parse(NetServer *server, NetConnection *conn,
+                              PgReader *r);
+static PgStep pg_handle_bind(NetConnection *conn, PgReader *r);
+static PgStep pg_handle_describe(NetServer *server, NetConnection *conn,
+                                 PgReader *r);
+static PgStep pg_handle_execute(NetConnection *conn, PgReader *r);
+static PgStep pg_handle_close(NetConnection *conn, PgReader *r);
+static PgStep pg_handle_sync(NetConnection *conn);
+static PgStep pg_continue_work(NetServer *server, NetConnection *conn);
+static PgStep pg_cancel_work(NetConnection *conn);
+static bool pg_next_statement(PgSession *session, StringView *out);
+
+static PgStatement *pg_find_statement(PgSession *session, const char *name);
+static PgPortal *pg_find_portal(PgSession *session, const char *name);
+static bool pg_add_statement(PgSession *session, const PgStatement *statement);
+static bool pg_add_portal(PgSession *session, const PgPortal *portal);
+static void pg_remove_statement(PgSession *session, PgStatement *statement);
+static void pg_remove_portal(PgSession *session, PgPortal *portal);
+static void pg_free_statement(PgStatement *statement);
+static void pg_free_portal(PgPortal *portal);
+static void pg_discard_all(PgSession *session);
+static bool pg_scan_placeholders(StringView sql, PgStatement *statement,
+                                 SqlError *error);
+static bool pg_decode_param(u32 oid, u16 format, const u8 *data, u32 length,
+                            u8 **bytes, SqlValue *out, SqlError *error);
+
+static const char *pg_utility_tag(StringView sql, bool *out_is_discard);
+static bool pg_plan(Database *db, const PgSession *session,
+                    const PgSource *source, PgPlan *plan, SqlError *error);
+static PgRunResult pg_run_portal(NetServer *server, NetConnection *conn,
+                                 PgPortal *portal, bool describe,
+                                 u64 row_limit, u64 *rows_sent,
+                                 SqlError *error);
+static PgRunResult pg_run_plan(NetConnection *conn, PgPortal *portal,
+                               PgPlan *plan, bool describe, u64 row_limit,
+                               u64 *rows_sent, SqlError *error);
+static PgRunResult pg_blocked(const NetConnection *conn, SqlError *error);
+static bool pg_send_row_description(NetConnection *conn,
+                                    const EvalPlan *query,
+                                    const PgPortal *portal);
+static bool pg_put_value(PgWriter *w, const SqlValue *value, EvalType type,
+                         i16 format, SqlError *error);
+static i16 pg_column_format(const PgPortal *portal, u32 column);
+
+static bool pg_parse_integer(const u8 *text, u32 length, i64 *out);
+static bool pg_parse_float(const u8 *text, u32 length, f64 *out);
+static bool pg_parse_bool(const u8 *text, u32 length, bool *out);
+static StringView pg_value_text(const SqlValue *value, char *buffer,
+                                usize size);
+static EvalType pg_type_from_oid(u32 oid);
+static u32 pg_type_oid(EvalType type);
+static i16 pg_type_length(EvalType type);
+
+// Free output space needed before a message is taken from the input. Every
+// reply other than rows and row descriptions fits into it, so only those
+// ever wait for the output to drain.
+#define PG_MESSAGE_ROOM 1024
+// Rows of the row source a query looks at per turn, sent or filtered out.
+// Past that it yields, so a query that filters out billions of rows neither
+// holds up other clients nor stays deaf to its CancelRequest.
+#define PG_ROWS_PER_TURN 4096
+#define PG_MAX_PARAMETERS 65535 // Bind counts them in 16 bits
+#define PG_FORMAT_TEXT 0
+#define PG_FORMAT_BINARY 1
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool pg_is_startup_packet(const u8 *data, usize length) {
+  ASSERT(data);
+  return length >= NET_FRAME_HEADER_SIZE && (data[4] == 0 || data[4] == 4);
+}
+
+void pg_session_init(PgSession *session) {
+  ASSERT(session);
+  ZERO_STRUCT(*session);
+  session->phase = PG_PHASE_STARTUP;
+  // The pair lets a CancelRequest on another connection name this session,
+  // so both halves come from the kernel's CSPRNG: nothing a client sees of
+  // its own sessions helps it guess another's.
+  u32 key[2];
+  if (getrandom(key, sizeof(key), 0) != (ssize_t)sizeof(key)) {
+    LOG_WARN("getrandom failed, falling back to the hash seed: %s",
+             strerror(errno));
+    static u64 counter = 0;
+    u64 n = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+    u64 hash = base_hash_bytes_seeded(&n, sizeof(n), base_hash_seed());
+    key[0] = (u32)hash;
+    key[1] = (u32)(hash >> 32);
+  }
+  session->process_id = key[0] & 0x7fffffff; // Clients expect a positive pid
+  session->secret_key = key[1];
+}
+
+void pg_session_free(PgSession *session) {
+  ASSERT(session);
+  for (u32 i = 0; i < session->statement_count; ++i) {
+    pg_free_statement(&session->statements[i]);
+  }
+  for (u32 i = 0; i < session->portal_count; ++i) {
+    pg_free_portal(&session->portals[i]);
+  }
+  free(session->statements);
+  free(session->portals);
+  free(session->query);
+  ZERO_STRUCT(*session);
+}
+
+bool pg_handle_input(NetServer *server, NetConnection *conn) {
+  ASSERT(server && conn && conn->pg && conn->out);
+  PgSession *session = conn->pg;
+  u32 offset = 0;
+  while (!conn->is_closing) {
+    if (session->work != PG_WORK_NONE) {
+      if (pg_continue_work(server, conn) != PG_STEP_DONE) {
+        break;
+      }
+      continue;
+    }
+    const u8 *input = conn->in ? conn->in + offset : NULL;
+    u32 available = conn->in ? conn->in_length - offset : 0;
+    PgMessage message;
+    PgFrame frame = pg_next_message(session, input, available, &message);
+    if (frame == PG_FRAME_PARTIAL) {
+      break;
+    }
+    if (frame == PG_FRAME_INVALID) {
+      LOG_DEBUG("Dropping a PostgreSQL client that sent a bad length");
+      pg_fatal(conn, "08P01", "invalid message length");
+      break;
+    }
+    if (NET_BUFFER_SIZE - conn->out_length < PG_MESSAGE_ROOM) {
+      break; // Answered once the output drains
+    }
+    u32 mark = conn->out_length;
+    if (pg_handle_message(server, conn, &message) == PG_STEP_BLOCKED) {
+      conn->out_length = mark;
+      if (mark > 0) {
+        break;
+      }
+      SqlError error;
+      sql_error_set(&error, "54000", 0, "response does not fit into %u bytes",
+                    NET_BUFFER_SIZE);
+      pg_report_error(conn, session, &error);
+    }
+    offset += message.size;
+    server->stats.requests++;
+  }
+  if (offset > 0) {
+    memmove(conn->in, conn->in + offset, conn->in_length - offset);
+    conn->in_length -= offset;
+  }
+  return true;
+}
+
+bool pg_has_work(const NetConnection *conn) {
+  ASSERT(conn && conn->pg);
+  if (conn->pg->work != PG_WORK_NONE) {
+    return true;
+  }
+  PgMessage message;
+  return conn->in && pg_next_message(conn->pg, conn->in, conn->in_length,
+                                     &message) != PG_FRAME_PARTIAL;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// --- Errors ---
+
+// Queues a FATAL error and closes the connection once it is written.
+static void pg_fatal(NetConnection *conn, const char *code, const char *fmt,
+                     ...) {
+  SqlError error = {.code = code, .position = 0};
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(error.message, sizeof(error.message), fmt, args);
+  va_end(args);
+  pg_send_error(conn, "FATAL", &error);
+  conn->is_closing = true;
+}
+
+// --- Reading Messages ---
+
+static u8 pg_read_u8(PgReader *r) {
+  const u8 *data = pg_read_bytes(r, 1);
+  return data ? data[0] : 0;
+}
+
+static u16 pg_read_u16(PgReader *r) {
+  const u8 *data = pg_read_bytes(r, 2);
+  return data ? pg_get_u16(data) : (u16)0;
+}
+
+static u16 pg_get_u16(const u8 *data) {
+  return (u16)(data[0] << 8 | data[1]);
+}
+
+static u32 pg_read_u32(PgReader *r) {
+  const u8 *data = pg_read_bytes(r, 4);
+  return data ? net_get_u32(data) : 0;
+}
+
+// Reads a NUL-terminated string; "" once the message is malformed.
+static const char *pg_read_string(PgReader *r, u32 *out_length) {
+  const u8 *start = r->data + r->position;
+  const u8 *end = r->is_malformed
+                      ? NULL
+                      : (const u8 *)memchr(start, 0, r->length - r->position);
+  if (!end) {
+    r->is_malformed = true;
+    *out_length = 0;
+    return "";
+  }
+  *out_length = (u32)(end - start);
+  r->position += *out_length + 1;
+  return (const char *)start;
+}
+
+static const u8 *pg_read_bytes(PgReader *r, u32 count) {
+  if (r->is_malformed || r->length - r->position < count) {
+    r->is_malformed = true;
+    return NULL;
+  }
+  const u8 *data = r->data + r->position;
+  r->position += count;
+  return data;
+}
+
+// --- Writing Messages ---
+
+static void pg_begin_message(PgWriter *w, NetConnection *conn, u8 type) {
+  w->conn = conn;
+  w->start = conn->out_length;
+  w->overflow = false;
+  pg_put_u8(w, type);
+  pg_put_u32(w, 0); // Patched by pg_end_message
+}
+
+static void pg_put_bytes(PgWriter *w, const void *data, usize length) {
+  NetConnection *conn = w->conn;
+  if (w->overflow || length > NET_BUFFER_SIZE - conn->out_length) {
+    w->overflow = true;
+    return;
+  }
+  if (length > 0) {
+    memcpy(conn->out + conn->out_length, data, length);
+    conn->out_length += (u32)length;
+  }
+}
+
+static void pg_put_u8(PgWriter *w, u8 value) { pg_put_bytes(w, &value, 1); }
+
+static void pg_put_u16(PgWriter *w, u16 value) {
+  u8 bytes[2] = {(u8)(value >> 8), (u8)value};
+  pg_put_bytes(w, bytes, sizeof(bytes));
+}
+
+static void pg_put_u32(PgWriter *w, u32 value) {
+  u8 bytes[4];
+  net_put_u32(bytes, value);
+  pg_put_bytes(w, bytes, sizeof(bytes));
+}
+
+static void pg_put_u64(PgWriter *w, u64 value) {
+  pg_put_u32(w, (u32)(value >> 32));
+  pg_put_u32(w, (u32)value);
+}
+
+static void pg_put_string(PgWriter *w, const char *string) {
+  pg_put_bytes(w, string, strlen(string) + 1);
+}
+
+// A column name, cut to NAMEDATALEN. Unquoted names fold to lower case the
+// way the server folds identifiers.
+static void pg_put_name(PgWriter *w, StringView name, bool fold_case) {
+  char buffer[PG_NAME_SIZE];
+  usize length = MIN(name.length, sizeof(buffer) - 1);
+  for (usize i = 0; i < length; ++i) {
+    char c = name.data[i];
+    buffer[i] = fold_case ? (char)tolower((unsigned char)c) : c;
+  }
+  buffer[length] = '\0';
+  pg_put_bytes(w, buffer, length + 1);
+}
+
+// Patches the length of the message, or drops it if it did not fit.
+static bool pg_end_message(PgWriter *w) {
+  if (w->overflow) {
+    pg_abort_message(w);
+    return false;
+  }
+  NetConnection *conn = w->conn;
+  net_put_u32(conn->out + w->start + 1, conn->out_length - w->start - 1);
+  return true;
+}
+
+static void pg_abort_message(PgWriter *w) { w->conn->out_length = w->start; }
+
+static bool pg_send_empty(NetConnection *conn, u8 type) {
+  PgWriter w;
+  pg_begin_message(&w, conn, type);
+  return pg_end_message(&w);
+}
+
+// Sessions never leave autocommit, so the status is always idle.
+static bool pg_send_ready(NetConnection *conn) {
+  PgWriter w;
+  pg_begin_message(&w, conn, 'Z');
+  pg_put_u8(&w, 'I');
+  return pg_end_message(&w);
+}
+
+static bool pg_send_parameter(NetConnection *conn, const char *name,
+                              const char *value) {
+  PgWriter w;
+  pg_begin_message(&w, conn, 'S');
+  pg_put_string(&w, name);
+  pg_put_string(&w, value);
+  return pg_end_message(&w);
+}
+
+static bool pg_send_command_complete(NetConnection *conn, const char *tag) {
+  PgWriter w;
+  pg_begin_message(&w, conn, 'C');
+  pg_put_string(&w, tag);
+  return pg_end_message(&w);
+}
+
+static bool pg_send_error(NetConnection *conn, const char *severity,
+                          const SqlError *error) {
+  PgWriter w;
+  pg_begin_message(&w, conn, 'E');
+  pg_put_u8(&w, 'S');
+  pg_put_string(&w, severity);
+  pg_put_u8(&w, 'V');
+  pg_put_string(&w, severity);
+  pg_put_u8(&w, 'C');
+  pg_put_string(&w, error->code);
+  pg_put_u8(&w, 'M');
+  pg_put_string(&w, error->message);
+  if (error->position > 0) {
+    char position[16];
+    snprintf(position, sizeof(position), "%u", error->position);
+    pg_put_u8(&w, 'P');
+    pg_put_string(&w, position);
+  }
+  pg_put_u8(&w, 0);
+  return pg_end_message(&w);
+}
+
+// An error in the extended protocol discards every message up to Sync.
+static bool pg_report_error(NetConnection *conn, PgSession *session,
+                            const SqlError *error) {
+  if (!pg_send_error(conn, "ERROR", error)) {
+    return false;
+  }
+  session->skip_until_sync = true;
+  return true;
+}
+
+// --- Messages ---
+
+// Startup packets are a length and a body; every later message is a type
+// byte, then a length that counts itself but not the type.
+static PgFrame pg_next_message(const PgSession *session, const u8 *data,
+                               u32 length, PgMessage *out) {
+  bool is_startup = session->phase == PG_PHASE_STARTUP;
+  u32 header = is_startup ? 4 : 5;
+  if (!data || length < header) {
+    return PG_FRAME_PARTIAL;
+  }
+  u32 declared = net_get_u32(is_startup ? data : data + 1);
+  u32 size = is_startup ? declared : declared + 1;
+  if (declared < (is_startup ? 8u : 4u) || declared > NET_BUFFER_SIZE - 1) {
+    return PG_FRAME_INVALID;
+  }
+  if (length < size) {
+    return PG_FRAME_PARTIAL;
+  }
+  out->type = is_startup ? 0 : data[0];
+  out->body = (PgReader){.data = data + header, .length = size - header};
+  out->size = size;
+  return PG_FRAME_MESSAGE;
+}
+
+static PgStep pg_handle_message(NetServer *server, NetConnection *conn,
+                                PgMessage *message) {
+  PgSession *session = conn->pg;
+  PgReader *r = &message->body;
+  if (session->phase == PG_PHASE_STARTUP) {
+    return pg_handle_startup(server, conn, r);
+  }
+  if (session->skip_until_sync && message->type != 'S' &&
+      message->type != 'X') {
+    return PG_STEP_DONE;
+  }
+  switch (message->type) {
+  case 'Q':
+    return pg_handle_query(conn, r);
+  case 'P':
+    return pg_handle_parse(server, conn, r);
+  case 'B':
+    return pg_handle_bind(conn, r);
+  case 'D':
+    return pg_handle_describe(server, conn, r);
+  case 'E':
+    return pg_handle_execute(conn, r);
+  case 'C':
+    return pg_handle_close(conn, r);
+  case 'S':
+    return pg_handle_sync(conn);
+  case 'H':
+    return PG_STEP_DONE; // Every response is flushed as soon as it is queued
+  case 'X':
+    conn->is_closing = true;
+    return PG_STEP_DONE;
+  default:
+    LOG_DEBUG("Dropping a PostgreSQL client that sent message type %u",
+              message->type);
+    pg_fatal(conn, "08P01", "invalid frontend message type %u",
+             message->type);
+    return PG_STEP_DONE;
+  }
+}
+
+static PgStep pg_handle_startup(NetServer *server, NetConnection *conn,
+                                PgReader *r) {
+  PgSession *session = conn->pg;
+  u32 code = pg_read_u32(r);
+  if (code == PG_SSL_REQUEST_CODE || code == PG_GSSENC_REQUEST_CODE) {
+    conn->out[conn->out_length++] = 'N'; // Go on unencrypted
+    return PG_STEP_DONE;
+  }
+  if (code == PG_CANCEL_REQUEST_CODE) {
+    u32 process_id = pg_read_u32(r);
+    u32 secret_key = pg_read_u32(r);
+    if (!r->is_malformed) {
+      pg_cancel_request(server, process_id, secret_key);
+    }
+    conn->is_closing = true; // Never answered, as in PostgreSQL
+    return PG_STEP_DONE;
+  }
+  if (code >> 16 != PG_PROTOCOL_VERSION >> 16) {
+    pg_fatal(conn, "0A000",
+             "unsupported frontend protocol %u.%u: server supports 3.0",
+             code >> 16, code & 0xFFFF);
+    return PG_STEP_DONE;
+  }
+
+  char user[PG_NAME_SIZE] = "";
+  char database[PG_NAME_SIZE] = "";
+  char application_name[PG_NAME_SIZE] = "";
+  for (;;) {
+    u32 key_length, value_length;
+    const char *key = pg_read_string(r, &key_length);
+    if (key_length == 0) {
+      break;
+    }
+    const char *value = pg_read_string(r, &value_length);
+    char *target = strcmp(key, "user") == 0       ? user
+                   : strcmp(key, "database") == 0 ? database
+                   : strcmp(key, "application_name") == 0
+                       ? application_name
+                       : NULL;
+    if (target) {
+      snprintf(target, PG_NAME_SIZE, "%s", value);
+    }
+  }
+  if (r->is_malformed) {
+    pg_fatal(conn, "08P01", "invalid startup packet layout");
+    return PG_STEP_DONE;
+  }
+  if (user[0] == '\0') {
+    pg_fatal(conn, "28000",
+             "no PostgreSQL user name specified in startup packet");
+    return PG_STEP_DONE;
+  }
+
+  PgWriter w;
+  pg_begin_message(&w, conn, 'R');
+  pg_put_u32(&w, 0); // AuthenticationOk: every user is trusted
+  bool ok = pg_end_message(&w) &&
+            pg_send_parameter(conn, "server_version", PG_SERVER_VERSION) &&
+            pg_send_parameter(conn, "server_encoding", "UTF8") &&
+            pg_send_parameter(conn, "client_encoding", "UTF8") &&
+            pg_send_parameter(conn, "DateStyle", "ISO, MDY") &&
+            pg_send_parameter(conn, "integer_datetimes", "on") &&
+            pg_send_parameter(conn, "standard_conforming_strings", "on") &&
+            pg_send_parameter(conn, "TimeZone", "UTC") &&
+            pg_send_parameter(conn, "is_superuser", "off") &&
+            pg_send_parameter(conn, "session_authorization", user) &&
+            pg_send_parameter(conn, "application_name", application_name);
+  if (ok) {
+    pg_begin_message(&w, conn, 'K');
+    pg_put_u32(&w, session->process_id);
+    pg_put_u32(&w, session->secret_key);
+    ok = pg_end_message(&w) && pg_send_ready(conn);
+  }
+  if (!ok) {
+    return PG_STEP_BLOCKED;
+  }
+  memcpy(session->user, user, sizeof(user));
+  memcpy(session->database, database[0] ? database : user, sizeof(database));
+  session->phase = PG_PHASE_READY;
+  return PG_STEP_DONE;
+}
+
+// Flags the work of the session BackendKeyData named, which stops with an
+// error the next time it runs. A session with nothing running ignores it.
+static void pg_cancel_request(NetServer *server, u32 process_id,
+                              u32 secret_key) {
+  for (NetConnection *other = server->connections; other;
+       other = other->next) {
+    PgSession *target = other->pg;
+    if (target && target->phase == PG_PHASE_READY &&
+        target->process_id == process_id && target->secret_key == secret_key) {
+      if (target->work != PG_WORK_NONE) {
+        target->is_cancel_requested = true;
+      }
+      return;
+    }
+  }
+}
+
+// A simple query runs statement by statement from pg_continue_work.
+static PgStep pg_handle_query(NetConnection *conn, PgReader *r) {
+  PgSession *session = conn->pg;
+  u32 length;
+  const char *sql = pg_read_string(r, &length);
+  if (r->is_malformed) {
+    pg_fatal(conn, "08P01", "invalid query message");
+    return PG_STEP_DONE;
+  }
+  char *query = (char *)malloc(length + 1);
+  if (!query) {
+    SqlError error;
+    sql_error_set(&error, "53200", 0, "out of memory");
+    return pg_send_error(conn, "ERROR", &error) && pg_send_ready(conn)
+               ? PG_STEP_DONE
+               : PG_STEP_BLOCKED;
+  }
+  memcpy(query, sql, length + 1);
+  // A simple query replaces the unnamed statement and portal.
+  PgStatement *unnamed_statement = pg_find_statement(session, "");
+  if (unnamed_statement) {
+    pg_remove_statement(session, unnamed_statement);
+  }
+  PgPortal *unnamed_portal = pg_find_portal(session, "");
+  if (unnamed_portal) {
+    pg_remove_portal(session, unnamed_portal);
+  }
+  session->work = PG_WORK_QUERY;
+  session->query = query;
+  session->query_length = length;
+  session->query_offset = 0;
+  session->query_ran = false;
+  ZERO_STRUCT(session->current);
+  return PG_STEP_DONE;
+}
+
+static PgStep pg_handle_parse(NetServer *server, NetConnection *conn,
+                              PgReader *r) {
+  PgSession *session = conn->pg;
+  u32 name_length, sql_length;
+  const char *name = pg_read_string(r, &name_length);
+  const char *sql = pg_read_string(r, &sql_length);
+  u16 type_count = pg_read_u16(r);
+  const u8 *types = pg_read_bytes(r, (u32)type_count * 4);
+  if (r->is_malformed) {
+    pg_fatal(conn, "08P01", "invalid Parse message");
+    return PG_STEP_DONE;
+  }
+
+  SqlError error;
+  PgStatement statement;
+  ZERO_STRUCT(statement);
+  if (name_length >= PG_NAME_SIZE) {
+    sql_error_set(&error, "42622", 0, "prepared statement name is too long");
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+  if (name_length > 0 && pg_find_statement(session, name)) {
+    sql_error_set(&error, "42P05", 0,
+                  "prepared statement \"%s\" already exists", name);
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+  memcpy(statement.name, name, name_length + 1);
+  statement.sql_length = sql_length;
+  bool ok = pg_scan_placeholders(sv_from_parts(sql, sql_length), &statement,
+                                 &error);
+  if (ok) {
+    statement.param_count = MAX(statement.param_count, type_count);
+    statement.sql = (char *)malloc(sql_length + 1);
+    statement.param_types =
+        (u32 *)calloc(MAX(statement.param_count, 1), sizeof(u32));
+    ok = statement.sql && statement.param_types;
+    if (!ok) {
+      sql_error_set(&error, "53200", 0, "out of memory");
+    }
+  }
+  if (ok) {
+    memcpy(statement.sql, sql, sql_length + 1);
+    for (u32 i = 0; i < type_count; ++i) {
+      statement.param_types[i] = net_get_u32(types + 4 * i);
+    }
+    // Parse errors surface here rather than at the first Execute.
+    PgSource source = {
+        .sql = sv_from_parts(sql, sql_length),
+        .placeholders = statement.placeholders,
+        .placeholder_count = statement.placeholder_count,
+        .types = statement.param_types,
+        .value_count = statement.param_count,
+    };
+    PgPlan plan;
+    Arena *temp = &server->db->temp_arena;
+    ArenaSavepoint savepoint = arena_save(temp); // The plan is only a check
+    ok = pg_plan(server->db, session, &source, &plan, &error);
+    if (!arena_restore(temp, savepoint) && ok) {
+      sql_error_set(&error, "XX000", 0, "internal error");
+      ok = false;
+    }
+  }
+  if (ok && !pg_send_empty(conn, '1')) {
+    pg_free_statement(&statement);
+    return PG_STEP_BLOCKED;
+  }
+  if (ok) {
+    PgStatement *unnamed = name_length == 0 ? pg_find_statement(session, "")
+                                            : NULL;
+    if (unnamed) {
+      pg_remove_statement(session, unnamed);
+    }
+    if (!pg_add_statement(session, &statement)) {
+      conn->out_length -= 5; // Take back the ParseComplete
+      sql_error_set(&error, "53200", 0, "out of memory");
+      ok = false;
+    }
+  }
+  if (!ok) {
+    pg_free_statement(&statement);
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+  return PG_STEP_DONE;
+}
+
+static PgStep pg_handle_bind(NetConnection *conn, PgReader *r) {
+  PgSession *session = conn->pg;
+  u32 portal_length, statement_length;
+  const char *portal_name = pg_read_string(r, &portal_length);
+  const char *statement_name = pg_read_string(r, &statement_length);
+  u16 format_count = pg_read_u16(r);
+  const u8 *formats = pg_read_bytes(r, (u32)format_count * 2);
+  u16 value_count = pg_read_u16(r);
+  u32 values_start = r->position;
+  for (u32 i = 0; i < value_count; ++i) {
+    u32 length = pg_read_u32(r);
+    if (length != UINT32_MAX) {
+      pg_read_bytes(r, length);
+    }
+  }
+  u32 values_end = r->position;
+  u16 result_format_count = pg_read_u16(r);
+  const u8 *result_formats = pg_read_bytes(r, (u32)result_format_count * 2);
+  if (r->is_malformed) {
+    pg_fatal(conn, "08P01", "invalid Bind message");
+    return PG_STEP_DONE;
+  }
+
+  SqlError error;
+  PgStatement *statement = pg_find_statement(session, statement_name);
+  bool ok = false;
+  if (portal_length >= PG_NAME_SIZE) {
+    sql_error_set(&error, "42622", 0, "portal name is too long");
+  } else if (!statement) {
+    sql_error_set(&error, "26000", 0,
+                  "prepared statement \"%s\" does not exist", statement_name);
+  } else if (value_count != statement->param_count) {
+    sql_error_set(&error, "08P01", 0,
+                  "bind message supplies %u parameters, but prepared statement "
+                  "\"%s\" requires %u",
+                  value_count, statement_name, statement->param_count);
+  } else if (format_count > 1 && format_count != value_count) {
+    sql_error_set(&error, "08P01", 0,
+                  "bind message has %u parameter formats but %u parameters",
+                  format_count, value_count);
+  } else if (portal_length > 0 && pg_find_portal(session, portal_name)) {
+    sql_error_set(&error, "42P03", 0, "portal \"%s\" already exists",
+                  portal_name);
+  } else {
+    ok = true;
+  }
+  for (u32 i = 0; ok && i < (u32)result_format_count; ++i) {
+    u16 format = pg_get_u16(result_formats + 2 * i);
+    if (format > PG_FORMAT_BINARY) {
+      sql_error_set(&error, "22023", 0, "unsupported format code: %u", format);
+      ok = false;
+    }
+  }
+  if (!ok) {
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+
+  // Every string parameter is copied into param_bytes, which the values of
+  // the message bound from above.
+  PgPortal portal;
+  ZERO_STRUCT(portal);
+  memcpy(portal.name, portal_name, portal_length + 1);
+  u32 count = MAX(statement->param_count, 1);
+  portal.sql = (char *)malloc(statement->sql_length + 1);
+  portal.owns_sql = true;
+  portal.sql_length = statement->sql_length;
+  portal.placeholders =
+      (u16 *)malloc(MAX(statement->placeholder_count, 1) * sizeof(u16));
+  portal.placeholder_count = statement->placeholder_count;
+  portal.params = (SqlValue *)calloc(count, sizeof(SqlValue));
+  portal.param_types = (u32 *)calloc(count, sizeof(u32));
+  portal.param_count = statement->param_count;
+  portal.param_bytes = (u8 *)malloc(MAX(values_end - values_start, 1));
+  portal.formats = (i16 *)malloc(MAX(result_format_count, 1) * sizeof(i16));
+  portal.format_count = result_format_count;
+  ok = portal.sql && portal.placeholders && portal.params &&
+       portal.param_types && portal.param_bytes && portal.formats;
+  if (!ok) {
+    sql_error_set(&error, "53200", 0, "out of memory");
+  } else {
+    memcpy(portal.sql, statement->sql, statement->sql_length + 1);
+    if (statement->placeholder_count > 0) {
+      memcpy(portal.placeholders, statement->placeholders,
+             statement->placeholder_count * sizeof(u16));
+    }
+    memcpy(portal.param_types, statement->param_types,
+           statement->param_count * sizeof(u32));
+    for (u32 i = 0; i < (u32)result_format_count; ++i) {
+      portal.formats[i] = (i16)pg_get_u16(result_formats + 2 * i);
+    }
+  }
+  PgReader values = {.data = r->data, .length = values_end,
+                     .position = values_start};
+  u8 *bytes = portal.param_bytes;
+  for (u32 i = 0; ok && i < value_count; ++i) {
+    u32 index = format_count == 1 ? 0 : i;
+    u16 format = format_count == 0 ? (u16)PG_FORMAT_TEXT
+                                   : pg_get_u16(formats + 2 * index);
+    u32 length = pg_read_u32(&values);
+    if (length == UINT32_MAX) {
+      continue; // NULL
+    }
+    const u8 *data = pg_read_bytes(&values, length);
+    ok = pg_decode_param(portal.param_types[i], format, data, length, &bytes,
+                         &portal.params[i], &error);
+  }
+  if (ok && !pg_send_empty(conn, '2')) {
+    pg_free_portal(&portal);
+    return PG_STEP_BLOCKED;
+  }
+  if (ok) {
+    PgPortal *unnamed = portal_length == 0 ? pg_find_portal(session, "")
+                                           : NULL;
+    if (unnamed) {
+      pg_remove_portal(session, unnamed);
+    }
+    if (!pg_add_portal(session, &portal)) {
+      conn->out_length -= 5; // Take back the BindComplete
+      sql_error_set(&error, "53200", 0, "out of memory");
+      ok = false;
+    }
+  }
+  if (!ok) {
+    pg_free_portal(&portal);
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+  return PG_STEP_DONE;
+}
+
+// Describing a statement sends the types of its parameters, then its columns
+// in text format; describing a portal sends its columns in the formats Bind
+// asked for. Statements without rows answer NoData.
+static PgStep pg_handle_describe(NetServer *server, NetConnection *conn,
+                                 PgReader *r) {
+  PgSession *session = conn->pg;
+  u8 kind = pg_read_u8(r);
+  u32 name_length;
+  const char *name = pg_read_string(r, &name_length);
+  if (r->is_malformed || (kind != 'S' && kind != 'P')) {
+    pg_fatal(conn, "08P01", "invalid Describe message");
+    return PG_STEP_DONE;
+  }
+
+  SqlError error;
+  PgSource source;
+  ZERO_STRUCT(source);
+  PgStatement *statement = NULL;
+  PgPortal *portal = NULL;
+  bool ok = true;
+  if (kind == 'S') {
+    statement = pg_find_statement(session, name);
+    if (!statement) {
+      sql_error_set(&error, "26000", 0,
+                    "prepared statement \"%s\" does not exist", name);
+      ok = false;
+    } else {
+      source = (PgSource){
+          .sql = sv_from_parts(statement->sql, statement->sql_length),
+          .placeholders = statement->placeholders,
+          .placeholder_count = statement->placeholder_count,
+          .types = statement->param_types,
+          .value_count = statement->param_count,
+      };
+    }
+  } else {
+    portal = pg_find_portal(session, name);
+    if (!portal) {
+      sql_error_set(&error, "34000", 0, "portal \"%s\" does not exist", name);
+      ok = false;
+    } else {
+      source = (PgSource){
+          .sql = sv_from_parts(portal->sql, portal->sql_length),
+          .placeholders = portal->placeholders,
+          .placeholder_count = portal->placeholder_count,
+          .values = portal->params,
+          .types = portal->param_types,
+          .value_count = portal->param_count,
+      };
+    }
+  }
+
+  PgPlan plan;
+  ok = ok && pg_plan(server->db, session, &source, &plan, &error);
+  if (ok && portal && portal->format_count > 1 && plan.query.select &&
+      portal->format_count != plan.query.column_count) {
+    sql_error_set(&error, "08P01", 0,
+                  "bind message has %u result formats but query has %u columns",
+                  portal->format_count, plan.query.column_count);
+    ok = false;
+  }
+  PgStep step = PG_STEP_DONE;
+  if (ok) {
+    PgWriter w;
+    if (statement) {
+      pg_begin_message(&w, conn, 't');
+      pg_put_u16(&w, (u16)statement->param_count);
+      for (u32 i = 0; i < statement->param_count; ++i) {
+        EvalType type = pg_type_from_oid(statement->param_types[i]);
+        pg_put_u32(&w, statement->param_types[i] ? statement->param_types[i]
+                                                 : pg_type_oid(type));
+      }
+      ok = pg_end_message(&w);
+    }
+    if (ok && plan.query.select) {
+      ok = pg_send_row_description(conn, &plan.query, portal);
+    } else if (ok) {
+      ok = pg_send_empty(conn, 'n');
+    }
+    step = ok ? PG_STEP_DONE : PG_STEP_BLOCKED;
+  } else if (!pg_report_error(conn, session, &error)) {
+    step = PG_STEP_BLOCKED;
+  }
+  arena_reset(&server->db->temp_arena);
+  return step;
+}
+
+static PgStep pg_handle_execute(NetConnection *conn, PgReader *r) {
+  PgSession *session = conn->pg;
+  u32 name_length;
+  const char *name = pg_read_string(r, &name_length);
+  u32 max_rows = pg_read_u32(r);
+  if (r->is_malformed) {
+    pg_fatal(conn, "08P01", "invalid Execute message");
+    return PG_STEP_DONE;
+  }
+  PgPortal *portal = pg_find_portal(session, name);
+  if (!portal) {
+    SqlError error;
+    sql_error_set(&error, "34000", 0, "portal \"%s\" does not exist", name);
+    return pg_report_error(conn, session, &error) ? PG_STEP_DONE
+                                                  : PG_STEP_BLOCKED;
+  }
+  session->work = PG_WORK_EXECUTE;
+  session->portal = (u32)(portal - session->portals);
+  session->row_limit = (i32)max_rows > 0 ? max_rows : 0;
+  session->rows_sent = 0;
+  return PG_STEP_DONE;
+}
+
+static PgStep pg_handle_close(NetConnection *conn, PgReader *r) {
+  PgSession *session = conn->pg;
+  u8 kind = pg_read_u8(r);
+  u32 name_length;
+  const char *name = pg_read_string(r, &name_length);
+  if (r->is_malformed || (kind != 'S' && kind != 'P')) {
+    pg_fatal(conn, "08P01", "invalid Close message");
+    return PG_STEP_DONE;
+  }
+  if (!pg_send_empty(conn, '3')) {
+    return PG_STEP_BLOCKED;
+  }
+  // Closing something that does not exist is not an error.
+  if (kind == 'S') {
+    PgStatement *statement = pg_find_statement(session, name);
+    if (statement) {
+      pg_remove_statement(session, statement);
+    }
+  } else {
+    PgPortal *portal = pg_find_portal(session, name);
+    if (portal) {
+      pg_remove_portal(session, portal);
+    }
+  }
+  return PG_STEP_DONE;
+}
+
+// Sync ends the implicit transaction of an extended query, which takes the
+// unnamed portal with it.
+static PgStep pg_handle_sync(NetConnection *conn) {
+  PgSession *session = conn->pg;
+  if (!pg_send_ready(conn)) {
+    return PG_STEP_BLOCKED;
+  }
+  session->skip_until_sync = false;
+  PgPortal *unnamed = pg_find_portal(session, "");
+  if (unnamed) {
+    pg_remove_portal(session, unnamed);
+  }
+  return PG_STEP_DONE;
+}
+
+// Sends rows of the simple query or Execute in progress until it finishes,
+// the output buffer fills up or it has had its turn.
+static PgStep pg_continue_work(NetServer *server, NetConnection *conn) {
+  PgSession *session = conn->pg;
+  SqlError error;
+  if (session->is_cancel_requested) {
+    // A simple query between statements has only ReadyForQuery left.
+    if (session->work == PG_WORK_EXECUTE || session->current.sql) {
+      return pg_cancel_work(conn);
+    }
+    session->is_cancel_requested = false;
+  }
+  if (session->work == PG_WORK_EXECUTE) {
+    PgPortal *portal = &session->portals[session->portal];
+    switch (pg_run_portal(server, conn, portal, false, session->row_limit,
+                          &session->rows_sent, &error)) {
+    case PG_RUN_BLOCKED:
+      return PG_STEP_BLOCKED;
+    case PG_RUN_YIELDED:
+      return PG_STEP_YIELDED;
+    case PG_RUN_SUSPENDED:
+      if (!pg_send_empty(conn, 's')) {
+        return PG_STEP_BLOCKED;
+      }
+      break;
+    case PG_RUN_FAILED:
+      if (!pg_report_error(conn, session, &error)) {
+        return PG_STEP_BLOCKED;
+      }
+      break;
+    case PG_RUN_DONE:
+      break;
+    }
+    session->work = PG_WORK_NONE;
+    return PG_STEP_DONE;
+  }
+
+  for (;;) {
+    if (!session->current.sql) {
+      StringView statement;
+      if (!pg_next_statement(session, &statement)) {
+        u32 mark = conn->out_length;
+        if ((!session->query_ran && !pg_send_empty(conn, 'I')) ||
+            !pg_send_ready(conn)) {
+          conn->out_length = mark;
+          return PG_STEP_BLOCKED;
+        }
+        free(session->query);
+        session->query = NULL;
+        session->work = PG_WORK_NONE;
+        return PG_STEP_DONE;
+      }
+      ZERO_STRUCT(session->current);
+      session->current.sql = (char *)statement.data;
+      session->current.sql_length = (u32)statement.length;
+      session->query_ran = true;
+    }
+    u64 rows_sent = 0;
+    switch (pg_run_portal(server, conn, &session->current, true, 0,
+                          &rows_sent, &error)) {
+    case PG_RUN_BLOCKED:
+      return PG_STEP_BLOCKED;
+    case PG_RUN_YIELDED:
+      return PG_STEP_YIELDED;
+    case PG_RUN_FAILED:
+      // The first error ends the query; later statements do not run.
+      if (!pg_send_error(conn, "ERROR", &error)) {
+        return PG_STEP_BLOCKED;
+      }
+      session->query_offset = session->query_length;
+      break;
+    case PG_RUN_SUSPENDED:
+    case PG_RUN_DONE:
+      break;
+    }
+    session->current.sql = NULL;
+  }
+}
+
+// Stops the statement in progress as PostgreSQL does on a CancelRequest:
+// rows already queued stay queued, and the error ends the simple query or
+// sends the extended one to the next Sync.
+static PgStep pg_cancel_work(NetConnection *conn) {
+  PgSession *session = conn->pg;
+  SqlError error;
+  sql_error_set(&error, "57014", 0, "canceling statement due to user request");
+  if (session->work == PG_WORK_EXECUTE) {
+    if (!pg_report_error(conn, session, &error)) {
+      return PG_STEP_BLOCKED;
+    }
+    session->work = PG_WORK_NONE;
+  } else {
+    if (!pg_send_error(conn, "ERROR", &error)) {
+      return PG_STEP_BLOCKED;
+    }
+    session->query_offset = session->query_length;
+    session->current.sql = NULL;
+  }
+  session->is_cancel_requested = false;
+  return PG_STEP_DONE;
+}
+
+// Finds the next statement of a simple query, splitting on semicolons
+// outside of strings and comments and skipping empty statements.
+static bool pg_next_statement(PgSession *session, StringView *out) {
+  while (session->query_offset < session->query_length) {
+    StringView rest = sv_from_parts(session->query + session->query_offset,
+                                    session->query_length -
+                                        session->query_offset);
+    Lexer lexer;
+    lexer_init(&lexer, rest);
+    lexer.skip_keywords = true;
+    Token token = lexer_next(&lexer);
+    if (token.kind == TOKEN_EOF) {
+      break;
+    }
+    if (token.kind == TOKEN_SEMICOLON) {
+      session->query_offset += (u32)lexer.position;
+      continue;
+    }
+    u32 start = token.offset;
+    u32 end = (u32)rest.length;
+    u32 next = end;
+    // A lexer error runs to the end; the parser reports it.
+    while (token.kind != TOKEN_EOF && token.kind != TOKEN_ERROR) {
+      if (token.kind == TOKEN_SEMICOLON) {
+        end = token.offset;
+        next = (u32)lexer.position;
+        break;
+      }
+      token = lexer_next(&lexer);
+    }
+    *out = sv_from_parts(rest.data + start, end - start);
+    session->query_offset += next;
+    return true;
+  }
+  session->query_offset = session->query_length;
+  return false;
+}
+
+// --- Statements and Portals ---
+
+static PgStatement *pg_find_statement(PgSession *session, const char *name) {
+  for (u32 i = 0; i < session->statement_count; ++i) {
+    if (strcmp(session->statements[i].name, name) == 0) {
+      return &session->statements[i];
+    }
+  }
+  return NULL;
+}
+
+static PgPortal *pg_find_portal(PgSession *session, const char *name) {
+  for (u32 i = 0; i < session->portal_count; ++i) {
+    if (strcmp(session->portals[i].name, name) == 0) {
+      return &session->portals[i];
+    }
+  }
+  return NULL;
+}
+
+static bool pg_add_statement(PgSession *session,
+                             const PgStatement *statement) {
+  if (session->statement_count == session->statement_capacity) {
+    u32 capacity = MAX(session->statement_capacity * 2, 4);
+    PgStatement *statements = (PgStatement *)realloc(
+        session->statements, capacity * sizeof(PgStatement));
+    if (!statements) {
+      return false;
+    }
+    session->statements = statements;
+    session->statement_capacity = capacity;
+  }
+  session->statements[session->statement_count++] = *statement;
+  return true;
+}
+
+static bool pg_add_portal(PgSession *session, const PgPortal *portal) {
+  if (session->portal_count == session->portal_capacity) {
+    u32 capacity = MAX(session->portal_capacity * 2, 4);
+    PgPortal *portals =
+        (PgPortal *)realloc(session->portals, capacity * sizeof(PgPortal));
+    if (!portals) {
+      return false;
+    }
+    session->portals = portals;
+    session->portal_capacity = capacity;
+  }
+  session->portals[session->portal_count++] = *portal;
+  return true;
+}
+
+// Order does not matter, so the last entry fills the gap.
+static void pg_remove_statement(PgSession *session, PgStatement *statement) {
+  pg_free_statement(statement);
+  *statement = session->statements[--session->statement_count];
+}
+
+static void pg_remove_portal(PgSession *session, PgPortal *portal) {
+  pg_free_portal(portal);
+  *portal = session->portals[--session->portal_count];
+}
+
+static void pg_free_statement(PgStatement *statement) {
+  free(statement->sql);
+  free(statement->param_types);
+  free(statement->placeholders);
+  ZERO_STRUCT(*statement);
+}
+
+static void pg_free_portal(PgPortal *portal) {
+  if (portal->owns_sql) {
+    free(portal->sql);
+  }
+  free(portal->placeholders);
+  free(portal->params);
+  free(portal->param_types);
+  free(portal->param_bytes);
+  free(portal->formats);
+  ZERO_STRUCT(*portal);
+}
+
+// Drops every statement and every portal but the one an Execute is running.
+static void pg_discard_all(PgSession *session) {
+  for (u32 i = 0; i < session->statement_count; ++i) {
+    pg_free_statement(&session->statements[i]);
+  }
+  session->statement_count = 0;
+  bool keep = session->work == PG_WORK_EXECUTE;
+  for (u32 i = 0; i < session->portal_count; ++i) {
+    if (!keep || i != session->portal) {
+      pg_free_portal(&session->portals[i]);
+    }
+  }
+  if (keep) {
+    session->portals[0] = session->portals[session->portal];
+    session->portal = 0;
+  }
+  session->portal_count = keep ? 1 : 0;
+}
+
+// Numbers the placeholders of 'sql' in text order: ? takes the next number,
+// $n its own. Sets statement->param_count to the highest.
+static bool pg_scan_placeholders(StringView sql, PgStatement *statement,
+                                 SqlError *error) {
+  Lexer lexer;
+  lexer_init(&lexer, sql);
+  lexer.skip_keywords = true;
+  u32 capacity = 0;
+  u32 sequential = 0;
+  for (Token token = lexer_next(&lexer);
+       token.kind != TOKEN_EOF && token.kind != TOKEN_ERROR;
+       token = lexer_next(&lexer)) {
+    if (token.kind != TOKEN_PARAMETER) {
+      continue;
+    }
+    u32 number = 0;
+    if (token.text.length == 1) {
+      number = ++sequential;
+    } else {
+      for (usize i = 1; i < token.text.length && number <= PG_MAX_PARAMETERS;
+           ++i) {
+        number = number * 10 + (u32)(token.text.data[i] - '0');
+      }
+    }
+    if (number == 0 || number > PG_MAX_PARAMETERS) {
+      sql_error_set(error, "42P02", token.offset + 1,
+                    "there is no parameter %.*s", (int)token.text.length,
+                    token.text.data);
+      return false;
+    }
+    if (statement->placeholder_count == capacity) {
+      capacity = MAX(capacity * 2, 8);
+      u16 *placeholders = (u16 *)realloc(statement->placeholders,
+                                         capacity * sizeof(u16));
+      if (!placeholders) {
+        sql_error_set(error, "53200", 0, "out of memory");
+        return false;
+      }
+      statement->placeholders = placeholders;
+    }
+    statement->placeholders[statement->placeholder_count++] =
+        (u16)(number - 1);
+    statement->param_count = MAX(statement->param_count, number);
+  }
+  return true;
+}
+
+// Decodes one Bind parameter of type 'oid'. Strings are copied to '*bytes',
+// which moves past them. Parameters of unspecified type become whatever
+// their text reads as: an integer, a float, or else a string.
+static bool pg_decode_param(u32 oid, u16 format, const u8 *data, u32 length,
+                            u8 **bytes, SqlValue *out, SqlError *error) {
+  EvalType type = pg_type_from_oid(oid);
+  if (format == PG_FORMAT_BINARY) {
+    u64 bits = 0;
+    for (u32 i = 0; i < length && i < 8; ++i) {
+      bits = bits << 8 | data[i];
+    }
+    bool ok = true;
+    switch (oid) {
+    case PG_OID_INT2:
+      ok = length == 2;
+      *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = (i16)bits};
+      break;
+    case PG_OID_INT4:
+      ok = length == 4;
+      *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = (i32)bits};
+      break;
+    case PG_OID_INT8:
+      ok = length == 8;
+      *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = (i64)bits};
+      break;
+    case PG_OID_FLOAT4: {
+      ok = length == 4;
+      u32 bits32 = (u32)bits;
+      f32 real;
+      memcpy(&real, &bits32, sizeof(real));
+      *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = real};
+      break;
+    }
+    case PG_OID_FLOAT8: {
+      ok = length == 8;
+      f64 real;
+      memcpy(&real, &bits, sizeof(real));
+      *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = real};
+      break;
+    }
+    case PG_OID_BOOL:
+      ok = length == 1;
+      *out = (SqlValue){.kind = SQL_VALUE_BOOLEAN, .boolean = bits != 0};
+      break;
+    case 0:
+    case PG_OID_UNKNOWN:
+    case PG_OID_TEXT:
+    case PG_OID_VARCHAR:
+      type = EVAL_TYPE_TEXT;
+      break;
+    default:
+      sql_error_set(error, "42P18", 0,
+                    "binary format for parameters of type %u is not supported",
+                    oid);
+      return false;
+    }
+    if (!ok) {
+      sql_error_set(error, "22P03", 0,
+                    "incorrect binary data format in bind parameter");
+      return false;
+    }
+    if (type != EVAL_TYPE_TEXT) {
+      return true;
+    }
+  }
+
+  i64 integer;
+  f64 real;
+  bool boolean;
+  switch (type) {
+  case EVAL_TYPE_INT8:
+    if (!pg_parse_integer(data, length, &integer)) {
+      break;
+    }
+    *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = integer};
+    return true;
+  case EVAL_TYPE_FLOAT8:
+    if (!pg_parse_float(data, length, &real)) {
+      break;
+    }
+    *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = real};
+    return true;
+  case EVAL_TYPE_BOOL:
+    if (!pg_parse_bool(data, length, &boolean)) {
+      break;
+    }
+    *out = (SqlValue){.kind = SQL_VALUE_BOOLEAN, .boolean = boolean};
+    return true;
+  case EVAL_TYPE_UNKNOWN:
+    if (oid == 0 || oid == PG_OID_UNKNOWN) {
+      if (pg_parse_integer(data, length, &integer)) {
+        *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = integer};
+        return true;
+      }
+      if (pg_parse_float(data, length, &real)) {
+        *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = real};
+        return true;
+      }
+    }
+    // Other types are passed on as their text.
+    // fall through
+  case EVAL_TYPE_TEXT:
+    if (length > 0) {
+      memcpy(*bytes, data, length);
+    }
+    *out = (SqlValue){.kind = SQL_VALUE_STRING,
+                      .string = sv_from_parts((const char *)*bytes, length)};
+    *bytes += length;
+    return true;
+  }
+  sql_error_set(error, "22P02", 0,
+                "invalid input syntax for type %s: \"%.*s\"",
+                type == EVAL_TYPE_INT8     ? "bigint"
+                : type == EVAL_TYPE_FLOAT8 ? "double precision"
+                                           : "boolean",
+                (int)MIN(length, 64), (const char *)data);
+  return false;
+}
+
+// --- Planning ---
+
+// Session and transaction commands are accepted and do nothing: every
+// statement commits on its own, and no setting changes how it runs.
+static const char *pg_utility_tag(StringView sql, bool *out_is_discard) {
+  static const struct {
+    const char *word;
+    const char *tag;
+  } commands[] = {
+      {"begin", "BEGIN"},       {"start", "START TRANSACTION"},
+      {"commit", "COMMIT"},     {"end", "COMMIT"},
+      {"rollback", "ROLLBACK"}, {"abort", "ROLLBACK"},
+      {"set", "SET"},           {"reset", "RESET"},
+      {"discard", "DISCARD ALL"},
+  };
+  *out_is_discard = false;
+  Lexer lexer;
+  lexer_init(&lexer, sql);
+  lexer.skip_keywords = true;
+  Token token = lexer_next(&lexer);
+  if (token.kind != TOKEN_IDENTIFIER) {
+    return NULL;
+  }
+  for (usize i = 0; i < ARRAY_SIZE(commands); ++i) {
+    if (!sv_equals_ignore_case(token.text, commands[i].word)) {
+      continue;
+    }
+    if (strcmp(commands[i].word, "discard") == 0) {
+      // Only DISCARD ALL; the other forms fail to parse as usual.
+      Token what = lexer_next(&lexer);
+      if (!sv_equals_ignore_case(what.text, "all")) {
+        return NULL;
+      }
+      *out_is_discard = true;
+    }
+    return commands[i].tag;
+  }
+  return NULL;
+}
+
+// Prepares 'source' through the plan cache and plans it with eval_plan,
+// unless it is a utility command. Allocates from the database's temp arena,
+// which the caller resets.
+static bool pg_plan(Database *db, const PgSession *session,
+                    const PgSource *source, PgPlan *plan, SqlError *error) {
+  ZERO_STRUCT(*plan);
+  plan->tag = pg_utility_tag(source->sql, &plan->is_discard);
+  if (plan->tag) {
+    return true;
+  }
+  SqlParams slots;
+  SqlParseError parse_error;
+  const PreparedStatement *prepared =
+      db_prepare(db, source->sql, &slots, &parse_error);
+  if (!prepared) {
+    sql_error_set(error, "42601", source->base + parse_error.offset + 1, "%s",
+                  parse_error.message);
+    return false;
+  }
+  Arena *arena = &db->temp_arena;
+  EvalType *types = NULL;
+  if (source->types && source->value_count > 0) {
+    types = (EvalType *)arena_alloc(arena,
+                                    source->value_count * sizeof(EvalType));
+    if (!types) {
+      sql_error_set(error, "53200", 0, "out of memory");
+      return false;
+    }
+    for (u32 i = 0; i < source->value_count; ++i) {
+      types[i] = pg_type_from_oid(source->types[i]);
+    }
+  }
+  EvalSource eval_source = {
+      .placeholders = source->placeholders,
+      .placeholder_count = source->placeholder_count,
+      .values = source->values,
+      .types = types,
+      .value_count = source->value_count,
+      .database = session->database,
+      .version = "PostgreSQL " PG_SERVER_VERSION " (sqldb)",
+  };
+  return eval_plan(arena, prepared->statement, &slots, &eval_source,
+                   &plan->query, error);
+}
+
+// --- Execution ---
+
+// Runs 'portal' from where it stopped: planned afresh every call, which the
+// plan cache makes cheap, with rows counted by position in the row source.
+// 'describe' sends a RowDescription first (simple queries). Rows go out
+// until the portal is done or 'row_limit' rows went out this Execute, with
+// a break after every PG_ROWS_PER_TURN rows of the row source.
+static PgRunResult pg_run_portal(NetServer *server, NetConnection *conn,
+                                 PgPortal *portal, bool describe,
+                                 u64 row_limit, u64 *rows_sent,
+                                 SqlError *error) {
+  PgSession *session = conn->pg;
+  Database *db = server->db;
+  PgSource source = {
+      .sql = sv_from_parts(portal->sql, portal->sql_length),
+      .base = portal->owns_sql ? 0 : (u32)(portal->sql - session->query),
+      .placeholders = portal->placeholders,
+      .placeholder_count = portal->placeholder_count,
+      .values = portal->params,
+      .types = portal->param_types,
+      .value_count = portal->param_count,
+  };
+  PgPlan plan;
+  PgRunResult result = PG_RUN_FAILED;
+  if (pg_plan(db, session, &source, &plan, error) &&
+      (!plan.query.select || eval_plan_rows(&plan.query, error))) {
+    result = pg_run_plan(conn, portal, &plan, describe, row_limit, rows_sent,
+                         error);
+  }
+  arena_reset(&db->temp_arena);
+  return result;
+}
+
+static PgRunResult pg_run_plan(NetConnection *conn, PgPortal *portal,
+                               PgPlan *plan, bool describe, u64 row_limit,
+                               u64 *rows_sent, SqlError *error) {
+  if (plan->tag) {
+    if (!pg_send_command_complete(conn, plan->tag)) {
+      return pg_blocked(conn, error);
+    }
+    if (plan->is_discard && portal->state != PG_PORTAL_COMPLETE) {
+      pg_discard_all(conn->pg);
+    }
+    portal->state = PG_PORTAL_COMPLETE;
+    return PG_RUN_DONE;
+  }
+  EvalPlan *query = &plan->query;
+  if (portal->format_count > 1 && portal->format_count != query->column_count) {
+    sql_error_set(error, "08P01", 0,
+                  "bind message has %u result formats but query has %u columns",
+                  portal->format_count, query->column_count);
+    return PG_RUN_FAILED;
+  }
+  if (describe && portal->state == PG_PORTAL_READY &&
+      !pg_send_row_description(conn, query, portal)) {
+    return pg_blocked(conn, error);
+  }
+  if (portal->state == PG_PORTAL_READY) {
+    portal->state = PG_PORTAL_ROWS;
+  }
+
+  PgWriter w;
+  u32 budget = PG_ROWS_PER_TURN;
+  while (portal->state == PG_PORTAL_ROWS &&
+         portal->next_row < query->row_count &&
+         portal->emitted < query->limit) {
+    if (row_limit > 0 && *rows_sent >= row_limit) {
+      return PG_RUN_SUSPENDED;
+    }
+    if (budget-- == 0) {
+      return PG_RUN_YIELDED;
+    }
+    bool keep;
+    if (!eval_row(query, portal->next_row, &keep, error)) {
+      return PG_RUN_FAILED;
+    }
+    if (!keep) {
+      portal->next_row++;
+      continue;
+    }
+    if (portal->skipped < query->offset) {
+      portal->skipped++;
+      portal->next_row++;
+      continue;
+    }
+
+    pg_begin_message(&w, conn, 'D');
+    pg_put_u16(&w, (u16)query->column_count);
+    u32 column = 0;
+    for (AstSelectItem *item = query->select->items; item; item = item->next) {
+      SqlValue value;
+      if (!eval_select_item(query, item->expr, &value, error) ||
+          !pg_put_value(&w, &value, query->column_types[column],
+                        pg_column_format(portal, column), error)) {
+        pg_abort_message(&w);
+        return PG_RUN_FAILED;
+      }
+      column++;
+    }
+    if (!pg_end_message(&w)) {
+      return pg_blocked(conn, error);
+    }
+    portal->next_row++;
+    portal->emitted++;
+    (*rows_sent)++;
+  }
+
+  char tag[32];
+  snprintf(tag, sizeof(tag), "SELECT %" PRIu64,
+           describe ? portal->emitted : *rows_sent);
+  if (!pg_send_command_complete(conn, tag)) {
+    return pg_blocked(conn, error);
+  }
+  portal->state = PG_PORTAL_COMPLETE;
+  return PG_RUN_DONE;
+}
+
+// A message that did not fit waits for the output to drain, unless there
+// was nothing to drain.
+static PgRunResult pg_blocked(const NetConnection *conn, SqlError *error) {
+  if (conn->out_length > 0) {
+    return PG_RUN_BLOCKED;
+  }
+  sql_error_set(error, "54000", 0, "result message does not fit into %u bytes",
+                NET_BUFFER_SIZE);
+  return PG_RUN_FAILED;
+}
+
+// Columns are named after their alias, else the function they call. Every
+// column is computed, so the table OID and attribute number are 0.
+static bool pg_send_row_description(NetConnection *conn,
+                                    const EvalPlan *query,
+                                    const PgPortal *portal) {
+  PgWriter w;
+  pg_begin_message(&w, conn, 'T');
+  pg_put_u16(&w, (u16)query->column_count);
+  u32 column = 0;
+  for (AstSelectItem *item = query->select->items; item; item = item->next) {
+    const AstExpr *expr = item->expr;
+    if (item->alias.length > 0) {
+      // Quoted aliases keep their case; their view starts past the quote.
+      pg_put_name(&w, item->alias, item->alias.data[-1] != '"');
+    } else if (expr->kind == AST_EXPR_FUNCTION) {
+      pg_put_name(&w, expr->function.name, true);
+    } else {
+      pg_put_string(&w, "?column?");
+    }
+    EvalType type = query->column_types[column];
+    pg_put_u32(&w, 0); // Table OID
+    pg_put_u16(&w, 0); // Attribute number
+    pg_put_u32(&w, pg_type_oid(type));
+    pg_put_u16(&w, (u16)pg_type_length(type));
+    pg_put_u32(&w, UINT32_MAX); // No type modifier
+    pg_put_u16(&w, (u16)(portal ? pg_column_format(portal, column)
+                                : PG_FORMAT_TEXT));
+    column++;
+  }
+  return pg_end_message(&w);
+}
+
+static bool pg_put_value(PgWriter *w, const SqlValue *value, EvalType type,
+                         i16 format, SqlError *error) {
+  if (value->kind == SQL_VALUE_NULL) {
+    pg_put_u32(w, UINT32_MAX);
+    return true;
+  }
+  if (format == PG_FORMAT_BINARY && type != EVAL_TYPE_UNKNOWN &&
+      type != EVAL_TYPE_TEXT) {
+    bool matches = type == EVAL_TYPE_INT8
+                       ? value->kind == SQL_VALUE_INTEGER
+                   : type == EVAL_TYPE_FLOAT8
+                       ? value->kind == SQL_VALUE_FLOAT ||
+                             value->kind == SQL_VALUE_INTEGER
+                       : value->kind == SQL_VALUE_BOOLEAN;
+    if (!matches) {
+      // Only untyped parameters can turn out other than described.
+      SqlValueKind expected = type == EVAL_TYPE_INT8     ? SQL_VALUE_INTEGER
+                              : type == EVAL_TYPE_FLOAT8 ? SQL_VALUE_FLOAT
+                                                         : SQL_VALUE_BOOLEAN;
+      sql_error_set(error, "42804", 0,
+                    "column of type %s returned a %s value",
+                    eval_value_type_name(expected),
+                    eval_value_type_name(value->kind));
+      return false;
+    }
+    if (type == EVAL_TYPE_INT8) {
+      pg_put_u32(w, 8);
+      pg_put_u64(w, (u64)value->integer);
+    } else if (type == EVAL_TYPE_FLOAT8) {
+      f64 real = value->kind == SQL_VALUE_INTEGER ? (f64)value->integer
+                                                  : value->real;
+      u64 bits;
+      memcpy(&bits, &real, sizeof(bits));
+      pg_put_u32(w, 8);
+      pg_put_u64(w, bits);
+    } else {
+      pg_put_u32(w, 1);
+      pg_put_u8(w, value->boolean ? 1 : 0);
+    }
+    return true;
+  }
+  // Text, which is also the binary format of text columns.
+  char buffer[64];
+  StringView text = pg_value_text(value, buffer, sizeof(buffer));
+  pg_put_u32(w, (u32)text.length);
+  pg_put_bytes(w, text.data, text.length);
+  return true;
+}
+
+static i16 pg_column_format(const PgPortal *portal, u32 column) {
+  if (portal->format_count == 0) {
+    return PG_FORMAT_TEXT;
+  }
+  return portal->formats[portal->format_count == 1 ? 0 : column];
+}
+
+// --- Values ---
+
+// Text input of the integer types: an optional sign and digits, with
+// surrounding spaces allowed.
+static bool pg_parse_integer(const u8 *text, u32 length, i64 *out) {
+  u32 i = 0;
+  while (i < length && isspace(text[i])) {
+    i++;
+  }
+  bool negative = i < length && text[i] == '-';
+  if (i < length && (text[i] == '-' || text[i] == '+')) {
+    i++;
+  }
+  u32 digits_start = i;
+  u64 value = 0;
+  u64 max = negative ? (u64)INT64_MAX + 1 : (u64)INT64_MAX;
+  for (; i < length && isdigit(text[i]); ++i) {
+    u64 digit = (u64)(text[i] - '0');
+    if (value > (max - digit) / 10) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  if (i == digits_start) {
+    return false;
+  }
+  while (i < length && isspace(text[i])) {
+    i++;
+  }
+  if (i != length) {
+    return false;
+  }
+  *out = negative ? (i64)((u64)0 - value) : (i64)value;
+  return true;
+}
+
+// Text input of the float types, including NaN and [-]Infinity.
+static bool pg_parse_float(const u8 *text, u32 length, f64 *out) {
+  char buffer[64];
+  if (length == 0 || length >= sizeof(buffer)) {
+    return false;
+  }
+  memcpy(buffer, text, length);
+  buffer[length] = '\0';
+  char *end;
+  f64 value = strtod(buffer, &end);
+  while (isspace((unsigned char)*end)) {
+    end++;
+  }
+  if (end == buffer || *end != '\0') {
+    return false;
+  }
+  *out = value;
+  return true;
+}
+
+static bool pg_parse_bool(const u8 *text, u32 length, bool *out) {
+  static const char *words[] = {"t", "true", "yes", "on", "1",
+                                "f", "false", "no", "off", "0"};
+  StringView input = sv_trim(sv_from_parts((const char *)text, length));
+  for (usize i = 0; i < ARRAY_SIZE(words); ++i) {
+    if (sv_equals_ignore_case(input, words[i])) {
+      *out = i < ARRAY_SIZE(words) / 2;
+      return true;
+    }
+  }
+  return false;
+}
+
+// The text format of a value; numbers are written to 'buffer'. Floats use
+// the fewest digits that read back as the same double.
+static StringView pg_value_text(const SqlValue *value, char *buffer,
+                                usize size) {
+  int length = 0;
+  switch (value->kind) {
+  case SQL_VALUE_INTEGER:
+    length = snprintf(buffer, size, "%" PRId64, value->integer);
+    break;
+  case SQL_VALUE_FLOAT: {
+    f64 real = value->real;
+    if (isnan(real)) {
+      return SV("NaN");
+    }
+    if (isinf(real)) {
+      return real > 0 ? SV("Infinity") : SV("-Infinity");
+    }
+    for (int precision = 15; precision <= 17; ++precision) {
+      length = snprintf(buffer, size, "%.*g", precision, real);
+      if (strtod(buffer, NULL) == real) {
+        break;
+      }
+    }
+    break;
+  }
+  case SQL_VALUE_STRING:
+    return value->string;
+  case SQL_VALUE_BOOLEAN:
+    return value->boolean ? SV("t") : SV("f");
+  case SQL_VALUE_NULL:
+    break;
+  }
+  return sv_from_parts(buffer, length > 0 ? (usize)length : 0);
+}
+
+static EvalType pg_type_from_oid(u32 oid) {
+  switch (oid) {
+  case PG_OID_INT2:
+  case PG_OID_INT4:
+  case PG_OID_INT8:
+    return EVAL_TYPE_INT8;
+  case PG_OID_FLOAT4:
+  case PG_OID_FLOAT8:
+    return EVAL_TYPE_FLOAT8;
+  case PG_OID_TEXT:
+  case PG_OID_VARCHAR:
+    return EVAL_TYPE_TEXT;
+  case PG_OID_BOOL:
+    return EVAL_TYPE_BOOL;
+  default:
+    return EVAL_TYPE_UNKNOWN;
+  }
+}
+
+// Untyped columns are described as text, which is how they are sent.
+static u32 pg_type_oid(EvalType type) {
+  switch (type) {
+  case EVAL_TYPE_INT8:
+    return PG_OID_INT8;
+  case EVAL_TYPE_FLOAT8:
+    return PG_OID_FLOAT8;
+  case EVAL_TYPE_BOOL:
+    return PG_OID_BOOL;
+  case EVAL_TYPE_TEXT:
+  case EVAL_TYPE_UNKNOWN:
+    break;
+  }
+  return PG_OID_TEXT;
+}
+
+static i16 pg_type_length(EvalType type) {
+  switch (type) {
+  case EVAL_TYPE_INT8:
+  case EVAL_TYPE_FLOAT8:
+    return 8;
+  case EVAL_TYPE_BOOL:
+    return 1;
+  case EVAL_TYPE_TEXT:
+  case EVAL_TYPE_UNKNOWN:
+    break;
+  }
+  return -1; // Variable length
+}
@@ -0,0 +1,37 @@
+#include "sqldb/network.h"
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void net_encode_header(u8 *out, NetMessageType type, u32 payload_length) {
+  ASSERT(out);
+  net_put_u32(out, payload_length);
+  out[4] = (u8)type;
+}
+
+bool net_decode_header(const u8 *data, usize length, NetFrameHeader *out) {
+  ASSERT(data && out);
+  if (length < NET_FRAME_HEADER_SIZE) {
+    return false;
+  }
+  out->length = net_get_u32(data);
+  out->type = data[4];
+  return true;
+}
+
+const char *net_message_type_name(NetMessageType type) {
+  switch (type) {
+  case NET_MSG_PING:
+    return "ping";
+  case NET_MSG_QUERY:
+    return "query";
+  case NET_MSG_PONG:
+    return "pong";
+  case NET_MSG_RESULT:
+    return "result";
+  case NET_MSG_ERROR:
+    return "error";
+  }
+  return "unknown";
+}
@@ -0,0 +1,607 @@
+#include "sqldb/network.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+typedef enum {
+  NET_IO_DONE,    // Made progress, try again
+  NET_IO_BLOCKED, // EAGAIN: wait for the next edge
+  NET_IO_CLOSED,  // Peer went away or the socket failed
+} NetIoResult;
+
+static void net_raise_fd_limit(u32 max_connections);
+static void net_accept_clients(NetServer *server);
+static void net_service_connection(NetServer *server, NetConnection *conn);
+static void net_close_connection(NetServer *server, NetConnection *conn);
+static void net_serve_ready(NetServer *server);
+static void net_push_ready(NetServer *server, NetConnection *conn);
+static void net_remove_ready(NetServer *server, NetConnection *conn);
+static u8 *net_acquire_buffer(NetServer *server);
+static void net_release_idle_buffers(NetServer *server, NetConnection *conn);
+static NetIoResult net_read_input(NetServer *server, NetConnection *conn);
+static NetIoResult net_flush_output(NetServer *server, NetConnection *conn);
+static bool net_has_work(const NetConnection *conn);
+static bool net_handle_input(NetServer *server, NetConnection *conn);
+static bool net_handle_frames(NetServer *server, NetConnection *conn);
+static u8 *net_begin_response(NetConnection *conn, NetMessageType type,
+                              u32 payload_length);
+static void net_handle_query(NetServer *server, NetConnection *conn,
+                             const u8 *sql, u32 length);
+
+#define NET_MAX_EVENTS 256
+#define NET_WAIT_TIMEOUT_MS 100
+#define NET_TURN_ROUNDS 4 // Service rounds a connection gets per wakeup
+#define NET_SPARE_FDS 64 // Data file, WAL, epoll, listener, logs...
+#define NET_CONNECTIONS_PER_SLAB 1024
+#define NET_BUFFERS_PER_SLAB 64
+#define NET_SESSIONS_PER_SLAB 64
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void net_pool_init(NetPool *pool, usize item_size, usize items_per_slab) {
+  ASSERT(pool && item_size > 0 && items_per_slab > 0);
+  ZERO_STRUCT(*pool);
+  pool->item_size = ALIGN_UP(MAX(item_size, sizeof(void *)),
+                             BASE_ARENA_DEFAULT_ALIGNMENT);
+  pool->items_per_slab = items_per_slab;
+}
+
+void *net_pool_acquire(NetPool *pool) {
+  ASSERT(pool);
+  if (!pool->free_list) {
+    if (pool->slab_count == pool->slab_capacity) {
+      usize capacity = MAX(pool->slab_capacity * 2, 8);
+      u8 **slabs = (u8 **)realloc(pool->slabs, capacity * sizeof(u8 *));
+      if (!slabs) {
+        return NULL;
+      }
+      pool->slabs = slabs;
+      pool->slab_capacity = capacity;
+    }
+    u8 *slab = (u8 *)malloc(pool->item_size * pool->items_per_slab);
+    if (!slab) {
+      return NULL;
+    }
+    pool->slabs[pool->slab_count++] = slab;
+    // Thread the new blocks back to front so they are handed out in order.
+    for (usize i = pool->items_per_slab; i-- > 0;) {
+      void *item = slab + i * pool->item_size;
+      *(void **)item = pool->free_list;
+      pool->free_list = item;
+    }
+  }
+  void *item = pool->free_list;
+  pool->free_list = *(void **)item;
+  pool->in_use++;
+  return item;
+}
+
+void net_pool_release(NetPool *pool, void *item) {
+  ASSERT(pool && item && pool->in_use > 0);
+  *(void **)item = pool->free_list;
+  pool->free_list = item;
+  pool->in_use--;
+}
+
+void net_pool_free(NetPool *pool) {
+  ASSERT(pool);
+  for (usize i = 0; i < pool->slab_count; ++i) {
+    free(pool->slabs[i]);
+  }
+  free(pool->slabs);
+  usize item_size = pool->item_size;
+  usize items_per_slab = pool->items_per_slab;
+  ZERO_STRUCT(*pool);
+  pool->item_size = item_size;
+  pool->items_per_slab = items_per_slab;
+}
+
+bool net_server_init(NetServer *server, Database *db, u16 port,
+                     u32 max_connections) {
+  ASSERT(server && db && db->is_initialized && max_connections > 0);
+  ZERO_STRUCT(*server);
+  server->db = db;
+  server->port = port;
+  server->max_connections = max_connections;
+  server->listen_fd = -1;
+  server->epoll_fd = -1;
+  net_pool_init(&server->connection_pool, sizeof(NetConnection),
+                NET_CONNECTIONS_PER_SLAB);
+  net_pool_init(&server->buffer_pool, NET_BUFFER_SIZE, NET_BUFFERS_PER_SLAB);
+  net_pool_init(&server->session_pool, sizeof(PgSession),
+                NET_SESSIONS_PER_SLAB);
+  net_raise_fd_limit(max_connections);
+
+  server->listen_fd =
+      socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (server->listen_fd < 0) {
+    LOG_ERROR("Failed to create the listening socket: %s", strerror(errno));
+    return false;
+  }
+  int one = 1;
+  setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  ZERO_STRUCT(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(server->listen_fd, SOMAXCONN) != 0) {
+    LOG_ERROR("Failed to listen on port %u: %s", port, strerror(errno));
+    net_server_shutdown(server);
+    return false;
+  }
+  // Port 0 binds any free port; report the one the kernel picked.
+  socklen_t addr_size = sizeof(addr);
+  if (getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_size) ==
+      0) {
+    server->port = ntohs(addr.sin_port);
+  }
+
+  server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = {.events = EPOLLIN | EPOLLET, .data.ptr = NULL};
+  if (server->epoll_fd < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD,
+                                        server->listen_fd, &event) != 0) {
+    LOG_ERROR("Failed to set up epoll: %s", strerror(errno));
+    net_server_shutdown(server);
+    return false;
+  }
+  return true;
+}
+
+bool net_server_run(NetServer *server, volatile bool *stop_requested) {
+  ASSERT(server && server->epoll_fd >= 0 && stop_requested);
+  struct epoll_event events[NET_MAX_EVENTS];
+  while (!*stop_requested) {
+    // Connections with work left must not wait for an edge that never comes.
+    int timeout = server->ready_head ? 0 : NET_WAIT_TIMEOUT_MS;
+    int count = epoll_wait(server->epoll_fd, events, NET_MAX_EVENTS, timeout);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+      return false;
+    }
+    for (int i = 0; i < count; ++i) {
+      NetConnection *conn = (NetConnection *)events[i].data.ptr;
+      if (!conn) {
+        net_accept_clients(server);
+      } else if (events[i].events & EPOLLERR) {
+        net_close_connection(server, conn);
+      } else {
+        // Hang-ups are noticed by the read returning 0 once the data the
+        // peer sent before closing has been answered.
+        net_service_connection(server, conn);
+      }
+    }
+    net_serve_ready(server);
+  }
+  return true;
+}
+
+void net_server_shutdown(NetServer *server) {
+  ASSERT(server);
+  while (server->connections) {
+    net_close_connection(server, server->connections);
+  }
+  if (server->epoll_fd >= 0) {
+    close(server->epoll_fd);
+    server->epoll_fd = -1;
+  }
+  if (server->listen_fd >= 0) {
+    close(server->listen_fd);
+    server->listen_fd = -1;
+  }
+  net_pool_free(&server->connection_pool);
+  net_pool_free(&server->buffer_pool);
+  net_pool_free(&server->session_pool);
+}
+
+void net_server_log_stats(const NetServer *server) {
+  ASSERT(server);
+  const NetServerStats *stats = &server->stats;
+  LOG_INFO("Network: %" PRIu64 " connections accepted (%" PRIu64
+           " rejected, peak %" PRIu64 ", %" PRIu64 " PostgreSQL), %" PRIu64
+           " requests, %" PRIu64 " protocol errors",
+           stats->accepted, stats->rejected, stats->peak_connections,
+           stats->postgres_sessions, stats->requests, stats->protocol_errors);
+  LOG_INFO("Network: %.2f MB read, %.2f MB written, peak %" PRIu64
+           " buffers (%.2f MB)",
+           (f64)stats->bytes_read / (1024.0 * 1024.0),
+           (f64)stats->bytes_written / (1024.0 * 1024.0), stats->peak_buffers,
+           (f64)(stats->peak_buffers * NET_BUFFER_SIZE) / (1024.0 * 1024.0));
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// --- Connections ---
+
+// Every connection is a file descriptor, so the default soft limit (often
+// 1024) would cap the server well below max_connections.
+static void net_raise_fd_limit(u32 max_connections) {
+  rlim_t needed = (rlim_t)max_connections + NET_SPARE_FDS;
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= needed) {
+    return;
+  }
+  limit.rlim_cur = limit.rlim_max == RLIM_INFINITY
+                       ? needed
+                       : MIN(needed, limit.rlim_max);
+  if (setrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur < needed) {
+    LOG_WARN("Open file limit of %" PRIu64 " allows fewer than %u connections",
+             (u64)limit.rlim_cur, max_connections);
+  }
+}
+
+static void net_accept_clients(NetServer *server) {
+  for (;;) {
+    int fd = accept4(server->listen_fd, NULL, NULL,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        // Out of descriptors: the pending clients are picked up with the
+        // next connection attempt.
+        LOG_WARN("Failed to accept a connection: %s", strerror(errno));
+      }
+      return;
+    }
+    NetConnection *conn =
+        server->connection_count < server->max_connections
+            ? (NetConnection *)net_pool_acquire(&server->connection_pool)
+            : NULL;
+    if (!conn) {
+      close(fd);
+      server->stats.rejected++;
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    *conn = (NetConnection){.fd = fd, .next = server->connections};
+    // Both directions are watched for the connection's whole life: with
+    // edge triggering EPOLLOUT only fires when the socket becomes writable
+    // again, so it costs nothing while responses fit in the socket buffer.
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = conn,
+    };
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      LOG_WARN("Failed to watch a connection: %s", strerror(errno));
+      close(fd);
+      net_pool_release(&server->connection_pool, conn);
+      continue;
+    }
+    if (server->connections) {
+      server->connections->prev = conn;
+    }
+    server->connections = conn;
+    server->connection_count++;
+    server->stats.accepted++;
+    server->stats.peak_connections =
+        MAX(server->stats.peak_connections, server->connection_count);
+  }
+}
+
+// Alternates answering buffered requests, writing responses and reading more
+// input until the socket would block. Input is not read while responses are
+// stuck behind a full socket buffer, which pushes back on clients that send
+// faster than they read. After NET_TURN_ROUNDS rounds the connection goes to
+// the back of the ready list, so one busy client cannot starve the others.
+static void net_service_connection(NetServer *server, NetConnection *conn) {
+  net_remove_ready(server, conn);
+  for (u32 round = 0;; ++round) {
+    if (round == NET_TURN_ROUNDS) {
+      net_push_ready(server, conn);
+      break;
+    }
+    if (!net_handle_input(server, conn)) {
+      server->stats.protocol_errors++;
+      net_close_connection(server, conn);
+      return;
+    }
+    NetIoResult flushed = net_flush_output(server, conn);
+    if (flushed == NET_IO_CLOSED ||
+        (flushed == NET_IO_DONE && conn->is_closing)) {
+      net_close_connection(server, conn);
+      return;
+    }
+    if (flushed == NET_IO_BLOCKED) {
+      break; // EPOLLOUT brings us back
+    }
+    if (net_has_work(conn)) {
+      continue; // Requests or rows left over from a full output buffer
+    }
+    NetIoResult read = net_read_input(server, conn);
+    if (read == NET_IO_CLOSED) {
+      net_close_connection(server, conn);
+      return;
+    }
+    if (read == NET_IO_BLOCKED) {
+      break;
+    }
+  }
+  net_release_idle_buffers(server, conn);
+}
+
+static void net_close_connection(NetServer *server, NetConnection *conn) {
+  close(conn->fd); // Also removes it from the epoll set
+  net_remove_ready(server, conn);
+  if (conn->in) {
+    net_pool_release(&server->buffer_pool, conn->in);
+  }
+  if (conn->out) {
+    net_pool_release(&server->buffer_pool, conn->out);
+  }
+  if (conn->pg) {
+    pg_session_free(conn->pg);
+    net_pool_release(&server->session_pool, conn->pg);
+  }
+  if (conn->prev) {
+    conn->prev->next = conn->next;
+  } else {
+    server->connections = conn->next;
+  }
+  if (conn->next) {
+    conn->next->prev = conn->prev;
+  }
+  net_pool_release(&server->connection_pool, conn);
+  server->connection_count--;
+  server->stats.closed++;
+}
+
+// Gives every connection on the ready list one more turn. Those that use it
+// up go to the back and wait for the next pass.
+static void net_serve_ready(NetServer *server) {
+  for (u32 n = server->ready_count; n > 0 && server->ready_head; --n) {
+    net_service_connection(server, server->ready_head);
+  }
+}
+
+static void net_push_ready(NetServer *server, NetConnection *conn) {
+  ASSERT(!conn->is_ready);
+  conn->is_ready = true;
+  conn->ready_prev = server->ready_tail;
+  conn->ready_next = NULL;
+  if (server->ready_tail) {
+    server->ready_tail->ready_next = conn;
+  } else {
+    server->ready_head = conn;
+  }
+  server->ready_tail = conn;
+  server->ready_count++;
+}
+
+static void net_remove_ready(NetServer *server, NetConnection *conn) {
+  if (!conn->is_ready) {
+    return;
+  }
+  if (conn->ready_prev) {
+    conn->ready_prev->ready_next = conn->ready_next;
+  } else {
+    server->ready_head = conn->ready_next;
+  }
+  if (conn->ready_next) {
+    conn->ready_next->ready_prev = conn->ready_prev;
+  } else {
+    server->ready_tail = conn->ready_prev;
+  }
+  conn->is_ready = false;
+  server->ready_count--;
+}
+
+// --- Buffers ---
+
+static u8 *net_acquire_buffer(NetServer *server) {
+  u8 *buffer = (u8 *)net_pool_acquire(&server->buffer_pool);
+  if (!buffer) {
+    LOG_ERROR("Failed to allocate a connection buffer");
+    return NULL;
+  }
+  server->stats.peak_buffers =
+      MAX(server->stats.peak_buffers, server->buffer_pool.in_use);
+  return buffer;
+}
+
+static void net_release_idle_buffers(NetServer *server, NetConnection *conn) {
+  if (conn->in && conn->in_length == 0) {
+    net_pool_release(&server->buffer_pool, conn->in);
+    conn->in = NULL;
+  }
+  if (conn->out && conn->out_length == 0) {
+    net_pool_release(&server->buffer_pool, conn->out);
+    conn->out = NULL;
+  }
+}
+
+// --- Socket I/O ---
+
+static NetIoResult net_read_input(NetServer *server, NetConnection *conn) {
+  if (!conn->in && !(conn->in = net_acquire_buffer(server))) {
+    return NET_IO_CLOSED;
+  }
+  // Frames are answered as soon as they are complete and none is larger than
+  // the buffer, so there is always room for the rest of a partial one.
+  ASSERT(conn->in_length < NET_BUFFER_SIZE);
+  for (;;) {
+    ssize_t n = recv(conn->fd, conn->in + conn->in_length,
+                     NET_BUFFER_SIZE - conn->in_length, 0);
+    if (n > 0) {
+      conn->in_length += (u32)n;
+      server->stats.bytes_read += (u64)n;
+      return NET_IO_DONE;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return NET_IO_BLOCKED;
+    }
+    return NET_IO_CLOSED;
+  }
+}
+
+// Writes the queued responses. NET_IO_DONE means nothing is left queued.
+static NetIoResult net_flush_output(NetServer *server, NetConnection *conn) {
+  while (conn->out_sent < conn->out_length) {
+    ssize_t n = send(conn->fd, conn->out + conn->out_sent,
+                     conn->out_length - conn->out_sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      conn->out_sent += (u32)n;
+      server->stats.bytes_written += (u64)n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return NET_IO_BLOCKED;
+    } else {
+      return NET_IO_CLOSED;
+    }
+  }
+  conn->out_length = 0;
+  conn->out_sent = 0;
+  return NET_IO_DONE;
+}
+
+// --- Requests ---
+
+static bool net_has_work(const NetConnection *conn) {
+  if (conn->is_closing) {
+    return false;
+  }
+  if (conn->protocol == NET_PROTOCOL_POSTGRES) {
+    return pg_has_work(conn);
+  }
+  NetFrameHeader header;
+  return conn->in &&
+         net_decode_header(conn->in, conn->in_length, &header) &&
+         conn->in_length - NET_FRAME_HEADER_SIZE >= header.length;
+}
+
+// Picks the protocol from the first bytes of a connection and hands the
+// input to it. Returns false if the connection must be dropped.
+static bool net_handle_input(NetServer *server, NetConnection *conn) {
+  if (conn->is_closing) {
+    return true;
+  }
+  if (conn->protocol == NET_PROTOCOL_UNKNOWN) {
+    if (!conn->in || conn->in_length < NET_FRAME_HEADER_SIZE) {
+      return true;
+    }
+    conn->protocol = NET_PROTOCOL_NATIVE;
+    if (pg_is_startup_packet(conn->in, conn->in_length)) {
+      conn->pg = (PgSession *)net_pool_acquire(&server->session_pool);
+      if (!conn->pg) {
+        LOG_ERROR("Failed to allocate a PostgreSQL session");
+        return false;
+      }
+      pg_session_init(conn->pg);
+      conn->protocol = NET_PROTOCOL_POSTGRES;
+      server->stats.postgres_sessions++;
+    }
+  }
+  if (conn->protocol == NET_PROTOCOL_NATIVE) {
+    return net_handle_frames(server, conn);
+  }
+  if (conn->in_length == 0 && conn->pg->work == PG_WORK_NONE) {
+    return true;
+  }
+  if (!conn->out && !(conn->out = net_acquire_buffer(server))) {
+    return false;
+  }
+  return pg_handle_input(server, conn);
+}
+
+// Answers every complete request in the input buffer while the output buffer
+// has room for a response. Returns false on a malformed frame.
+static bool net_handle_frames(NetServer *server, NetConnection *conn) {
+  if (!conn->in) {
+    return true;
+  }
+  u32 offset = 0;
+  NetFrameHeader header;
+  while (net_decode_header(conn->in + offset, conn->in_length - offset,
+                           &header)) {
+    if (header.length > NET_MAX_PAYLOAD) {
+      LOG_DEBUG("Dropping a client that sent a %u byte frame", header.length);
+      return false;
+    }
+    if (conn->in_length - offset - NET_FRAME_HEADER_SIZE < header.length) {
+      break; // Partial frame
+    }
+    if (!conn->out && !(conn->out = net_acquire_buffer(server))) {
+      return false;
+    }
+    if (NET_BUFFER_SIZE - conn->out_length < NET_MAX_RESPONSE) {
+      break; // Answered once the output drains
+    }
+    const u8 *payload = conn->in + offset + NET_FRAME_HEADER_SIZE;
+    switch (header.type) {
+    case NET_MSG_PING:
+      net_begin_response(conn, NET_MSG_PONG, 0);
+      break;
+    case NET_MSG_QUERY:
+      net_handle_query(server, conn, payload, header.length);
+      break;
+    default:
+      LOG_DEBUG("Dropping a client that sent message type %u", header.type);
+      return false;
+    }
+    offset += NET_FRAME_HEADER_SIZE + header.length;
+    server->stats.requests++;
+  }
+  if (offset > 0) {
+    memmove(conn->in, conn->in + offset, conn->in_length - offset);
+    conn->in_length -= offset;
+  }
+  return true;
+}
+
+// Queues the header of a response and returns where its payload goes. The
+// caller checked that NET_MAX_RESPONSE bytes are free.
+static u8 *net_begin_response(NetConnection *conn, NetMessageType type,
+                              u32 payload_length) {
+  ASSERT(NET_FRAME_HEADER_SIZE + payload_length <= NET_MAX_RESPONSE);
+  u8 *frame = conn->out + conn->out_length;
+  net_encode_header(frame, type, payload_length);
+  conn->out_length += NET_FRAME_HEADER_SIZE + payload_length;
+  return frame + NET_FRAME_HEADER_SIZE;
+}
+
+// Statements are prepared (parsed, or found in the plan cache) and described
+// back to the client; executing them is up to the layers above.
+static void net_handle_query(NetServer *server, NetConnection *conn,
+                             const u8 *sql, u32 length) {
+  Database *db = server->db;
+  SqlParams params;
+  SqlParseError error;
+  const PreparedStatement *prepared = db_prepare(
+      db, sv_from_parts((const char *)sql, length), &params, &error);
+  if (prepared) {
+    u8 *payload = net_begin_response(conn, NET_MSG_RESULT, 5);
+    payload[0] = (u8)prepared->statement->kind;
+    net_put_u32(payload + 1, params.count);
+  } else {
+    u32 message_length = (u32)strnlen(error.message, sizeof(error.message));
+    u8 *payload = net_begin_response(conn, NET_MSG_ERROR, 8 + message_length);
+    net_put_u32(payload, error.line);
+    net_put_u32(payload + 4, error.column);
+    memcpy(payload + 8, error.message, message_length);
+  }
+  arena_reset(&db->temp_arena);
+}
@@ -0,0 +1,783 @@
+#include "sqldb/eval.h"
+
+#include <stdarg.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+typedef enum {
+  EVAL_FUNCTION_NONE,
+  EVAL_FUNCTION_GENERATE_SERIES,
+  EVAL_FUNCTION_VERSION,
+  EVAL_FUNCTION_CURRENT_DATABASE,
+} EvalFunction;
+
+static bool eval_check_expr(const AstExpr *expr, bool allow_series,
+                            const AstExpr **series, SqlError *error);
+static EvalType eval_infer(const EvalPlan *plan, const AstExpr *expr);
+static bool eval_expr(EvalContext *ev, const AstExpr *expr, SqlValue *out);
+static bool eval_logical(EvalContext *ev, const AstExpr *expr, SqlValue *out);
+static bool eval_compare(EvalContext *ev, AstOperator op, SqlValue left,
+                         SqlValue right, SqlValue *out);
+static bool eval_arithmetic(EvalContext *ev, AstOperator op, SqlValue left,
+                            SqlValue right, SqlValue *out);
+static EvalFunction eval_function(StringView name);
+static StringView eval_collapse_quotes(Arena *arena, StringView text);
+static EvalType eval_type_of(SqlValueKind kind);
+static const char *eval_operator_symbol(AstOperator op);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void sql_error_set(SqlError *error, const char *code, u32 position,
+                   const char *fmt, ...) {
+  ASSERT(error && code && fmt);
+  error->code = code;
+  error->position = position;
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(error->message, sizeof(error->message), fmt, args);
+  va_end(args);
+}
+
+bool eval_plan(Arena *arena, const AstStatement *statement,
+               const SqlParams *slots, const EvalSource *source,
+               EvalPlan *plan, SqlError *error) {
+  ASSERT(arena && statement && slots && source && plan && error);
+  ZERO_STRUCT(*plan);
+  plan->limit = UINT64_MAX;
+  switch (statement->kind) {
+  case AST_STMT_SELECT:
+    break;
+  case AST_STMT_INSERT:
+  case AST_STMT_UPDATE:
+  case AST_STMT_DELETE: {
+    StringView table = statement->kind == AST_STMT_INSERT
+                           ? statement->insert.table
+                       : statement->kind == AST_STMT_UPDATE
+                           ? statement->update.table
+                           : statement->delete.table;
+    sql_error_set(error, "42P01", 0, "relation \"%.*s\" does not exist",
+                  (int)table.length, table.data);
+    return false;
+  }
+  case AST_STMT_CREATE_TABLE:
+    sql_error_set(error, "0A000", 0, "CREATE TABLE is not supported yet");
+    return false;
+  }
+
+  const AstSelect *select = &statement->select;
+  if (select->from) {
+    sql_error_set(error, "42P01", 0, "relation \"%.*s\" does not exist",
+                  (int)select->from->name.length, select->from->name.data);
+    return false;
+  }
+  const char *unsupported = select->is_distinct ? "DISTINCT"
+                            : select->group_by  ? "GROUP BY"
+                            : select->having    ? "HAVING"
+                            : select->order_by  ? "ORDER BY"
+                                                : NULL;
+  if (unsupported) {
+    sql_error_set(error, "0A000", 0, "%s is not supported yet", unsupported);
+    return false;
+  }
+
+  // Normalization turned the literals into parameters as well; placeholders
+  // are the slots it left NULL. Without normalization every parameter is a
+  // placeholder.
+  u32 count = statement->parameter_count;
+  plan->param_count = count;
+  if (count > 0) {
+    plan->params = (SqlValue *)arena_alloc(arena, count * sizeof(SqlValue));
+    plan->param_types =
+        (EvalType *)arena_alloc(arena, count * sizeof(EvalType));
+    if (!plan->params || !plan->param_types) {
+      sql_error_set(error, "53200", 0, "out of memory");
+      return false;
+    }
+  }
+  u32 placeholder = 0;
+  for (u32 k = 0; k < count; ++k) {
+    SqlValue value = slots->count == count
+                         ? slots->values[k]
+                         : (SqlValue){.kind = SQL_VALUE_NULL};
+    EvalType type = eval_type_of(value.kind);
+    if (value.kind == SQL_VALUE_STRING) {
+      value.string = eval_collapse_quotes(arena, value.string);
+    } else if (value.kind == SQL_VALUE_NULL) {
+      if (placeholder >= source->placeholder_count) {
+        sql_error_set(error, "42P02", 0,
+                      "there is no parameter $%u; use the extended query "
+                      "protocol to bind parameters",
+                      placeholder + 1);
+        return false;
+      }
+      u32 n = source->placeholders[placeholder++];
+      ASSERT(n < source->value_count);
+      if (source->values) {
+        value = source->values[n];
+      }
+      type = source->types ? source->types[n] : EVAL_TYPE_UNKNOWN;
+      if (type == EVAL_TYPE_UNKNOWN) {
+        type = eval_type_of(value.kind);
+      }
+    }
+    plan->params[k] = value;
+    plan->param_types[k] = type;
+  }
+
+  const AstExpr *series = NULL;
+  for (AstSelectItem *item = select->items; item; item = item->next) {
+    if (!eval_check_expr(item->expr, true, &series, error)) {
+      return false;
+    }
+  }
+  const AstExpr *clauses[] = {select->where, select->limit, select->offset};
+  for (u32 i = 0; i < ARRAY_SIZE(clauses); ++i) {
+    if (clauses[i] && !eval_check_expr(clauses[i], false, NULL, error)) {
+      return false;
+    }
+  }
+  plan->select = select;
+  plan->column_count = select->item_count;
+  plan->column_types = (EvalType *)arena_alloc(
+      arena, MAX(select->item_count, 1) * sizeof(EvalType));
+  if (!plan->column_types) {
+    sql_error_set(error, "53200", 0, "out of memory");
+    return false;
+  }
+  u32 column = 0;
+  for (AstSelectItem *item = select->items; item; item = item->next) {
+    plan->column_types[column++] = eval_infer(plan, item->expr);
+  }
+  plan->eval = (EvalContext){
+      .params = plan->params,
+      .param_count = count,
+      .series = series,
+      .database = source->database,
+      .version = source->version,
+      .arena = arena,
+      .error = error,
+  };
+  plan->row_count = 1;
+  return true;
+}
+
+bool eval_plan_rows(EvalPlan *plan, SqlError *error) {
+  ASSERT(plan && plan->select && error);
+  const AstSelect *select = plan->select;
+  EvalContext *ev = &plan->eval;
+  ev->error = error;
+  if (ev->series) {
+    const AstExpr *series = ev->series;
+    i64 args[3] = {0, 0, 1};
+    u32 arg = 0;
+    for (const AstExpr *expr = series->function.args; expr;
+         expr = expr->next) {
+      SqlValue value;
+      if (!eval_expr(ev, expr, &value)) {
+        return false;
+      }
+      if (value.kind == SQL_VALUE_NULL) {
+        plan->row_count = 0; // Strict: NULL in, no rows out
+        return true;
+      }
+      if (value.kind != SQL_VALUE_INTEGER) {
+        sql_error_set(error, "42883", 0,
+                      "function generate_series does not take type %s",
+                      eval_value_type_name(value.kind));
+        return false;
+      }
+      args[arg++] = value.integer;
+    }
+    i64 start = args[0], stop = args[1], step = args[2];
+    if (step == 0) {
+      sql_error_set(error, "22023", 0, "step size cannot equal zero");
+      return false;
+    }
+    plan->series_start = start;
+    plan->series_step = step;
+    // Unsigned differences cannot overflow; the full i64 range in steps of
+    // one loses its last row, which nobody reaches.
+    u64 steps = 0;
+    if (step > 0 && start <= stop) {
+      steps = ((u64)stop - (u64)start) / (u64)step;
+    } else if (step < 0 && start >= stop) {
+      steps = ((u64)start - (u64)stop) / ((u64)0 - (u64)step);
+    } else {
+      plan->row_count = 0;
+      return true;
+    }
+    plan->row_count = steps == UINT64_MAX ? steps : steps + 1;
+  }
+
+  static const char *clauses[] = {"LIMIT", "OFFSET"};
+  const AstExpr *exprs[] = {select->limit, select->offset};
+  u64 *targets[] = {&plan->limit, &plan->offset};
+  for (u32 i = 0; i < ARRAY_SIZE(exprs); ++i) {
+    SqlValue value;
+    if (!exprs[i]) {
+      continue;
+    }
+    if (!eval_expr(ev, exprs[i], &value)) {
+      return false;
+    }
+    if (value.kind == SQL_VALUE_NULL) {
+      continue; // LIMIT NULL is no limit, OFFSET NULL no offset
+    }
+    if (value.kind != SQL_VALUE_INTEGER) {
+      sql_error_set(error, "42804", 0,
+                    "argument of %s must be type bigint, not type %s",
+                    clauses[i], eval_value_type_name(value.kind));
+      return false;
+    }
+    if (value.integer < 0) {
+      sql_error_set(error, i == 0 ? "2201W" : "2201X", 0,
+                    "%s must not be negative", clauses[i]);
+      return false;
+    }
+    *targets[i] = (u64)value.integer;
+  }
+  return true;
+}
+
+
+bool eval_row(EvalPlan *plan, u64 row, bool *out_keep, SqlError *error) {
+  ASSERT(plan && plan->select && row < plan->row_count && out_keep && error);
+  EvalContext *ev = &plan->eval;
+  ev->error = error;
+  ev->series_value =
+      (i64)((u64)plan->series_start + row * (u64)plan->series_step);
+  *out_keep = true;
+  const AstExpr *where = plan->select->where;
+  if (!where) {
+    return true;
+  }
+  SqlValue keep;
+  if (!eval_expr(ev, where, &keep)) {
+    return false;
+  }
+  if (keep.kind != SQL_VALUE_BOOLEAN && keep.kind != SQL_VALUE_NULL) {
+    sql_error_set(error, "42804", 0,
+                  "argument of WHERE must be type boolean, not type %s",
+                  eval_value_type_name(keep.kind));
+    return false;
+  }
+  *out_keep = keep.kind == SQL_VALUE_BOOLEAN && keep.boolean;
+  return true;
+}
+
+bool eval_select_item(EvalPlan *plan, const AstExpr *expr, SqlValue *out,
+                      SqlError *error) {
+  ASSERT(plan && expr && out && error);
+  plan->eval.error = error;
+  return eval_expr(&plan->eval, expr, out);
+}
+
+const char *eval_value_type_name(SqlValueKind kind) {
+  switch (kind) {
+  case SQL_VALUE_NULL:
+    return "unknown";
+  case SQL_VALUE_INTEGER:
+    return "bigint";
+  case SQL_VALUE_FLOAT:
+    return "double precision";
+  case SQL_VALUE_STRING:
+    return "text";
+  case SQL_VALUE_BOOLEAN:
+    return "boolean";
+  }
+  return "unknown";
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// --- Checking ---
+
+// Rejects what a FROM-less SELECT cannot run before any row is sent:
+// columns, *, unknown functions, and generate_series anywhere but the select
+// list (and more than once there).
+static bool eval_check_expr(const AstExpr *expr, bool allow_series,
+                            const AstExpr **series, SqlError *error) {
+  switch (expr->kind) {
+  case AST_EXPR_COLUMN:
+    sql_error_set(error, "42703", 0, "column \"%.*s\" does not exist",
+                  (int)expr->column.name.length, expr->column.name.data);
+    return false;
+  case AST_EXPR_STAR:
+    sql_error_set(error, "42601", 0,
+                  "SELECT * with no tables specified is not valid");
+    return false;
+  case AST_EXPR_INTEGER:
+  case AST_EXPR_FLOAT:
+  case AST_EXPR_STRING:
+  case AST_EXPR_BOOLEAN:
+  case AST_EXPR_NULL:
+  case AST_EXPR_PARAMETER:
+    return true;
+  case AST_EXPR_UNARY:
+    return eval_check_expr(expr->unary.operand, allow_series, series, error);
+  case AST_EXPR_BINARY:
+    return eval_check_expr(expr->binary.left, allow_series, series, error) &&
+           eval_check_expr(expr->binary.right, allow_series, series, error);
+  case AST_EXPR_IS_NULL:
+    return eval_check_expr(expr->is_null.operand, allow_series, series, error);
+  case AST_EXPR_FUNCTION:
+    break;
+  }
+
+  StringView name = expr->function.name;
+  EvalFunction function = eval_function(name);
+  u32 args = expr->function.arg_count;
+  bool arity = function == EVAL_FUNCTION_GENERATE_SERIES
+                   ? args == 2 || args == 3
+                   : args == 0;
+  if (function == EVAL_FUNCTION_NONE || !arity || expr->function.is_distinct) {
+    sql_error_set(error, "42883", 0,
+                  "function %.*s with %u arguments does not exist",
+                  (int)name.length, name.data, args);
+    return false;
+  }
+  if (function == EVAL_FUNCTION_GENERATE_SERIES) {
+    if (!allow_series) {
+      sql_error_set(error, "0A000", 0,
+                    "set-returning functions are only supported in the select "
+                    "list");
+      return false;
+    }
+    if (*series) {
+      sql_error_set(error, "0A000", 0,
+                    "only one set-returning function per query is supported");
+      return false;
+    }
+    *series = expr;
+  }
+  for (const AstExpr *arg = expr->function.args; arg; arg = arg->next) {
+    if (!eval_check_expr(arg, false, NULL, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The type of every value 'expr' yields, as far as it can be known before
+// running it.
+static EvalType eval_infer(const EvalPlan *plan, const AstExpr *expr) {
+  switch (expr->kind) {
+  case AST_EXPR_INTEGER:
+    return EVAL_TYPE_INT8;
+  case AST_EXPR_FLOAT:
+    return EVAL_TYPE_FLOAT8;
+  case AST_EXPR_STRING:
+    return EVAL_TYPE_TEXT;
+  case AST_EXPR_BOOLEAN:
+  case AST_EXPR_IS_NULL:
+    return EVAL_TYPE_BOOL;
+  case AST_EXPR_PARAMETER:
+    return expr->parameter < plan->param_count
+               ? plan->param_types[expr->parameter]
+               : EVAL_TYPE_UNKNOWN;
+  case AST_EXPR_UNARY:
+    return expr->unary.op == AST_OP_NOT
+               ? EVAL_TYPE_BOOL
+               : eval_infer(plan, expr->unary.operand);
+  case AST_EXPR_BINARY: {
+    switch (expr->binary.op) {
+    case AST_OP_ADD:
+    case AST_OP_SUBTRACT:
+    case AST_OP_MULTIPLY:
+    case AST_OP_DIVIDE:
+    case AST_OP_MODULO: {
+      EvalType left = eval_infer(plan, expr->binary.left);
+      EvalType right = eval_infer(plan, expr->binary.right);
+      return left == EVAL_TYPE_FLOAT8 || right == EVAL_TYPE_FLOAT8
+                 ? EVAL_TYPE_FLOAT8
+                 : EVAL_TYPE_INT8;
+    }
+    default:
+      return EVAL_TYPE_BOOL;
+    }
+  }
+  case AST_EXPR_FUNCTION:
+    return eval_function(expr->function.name) == EVAL_FUNCTION_GENERATE_SERIES
+               ? EVAL_TYPE_INT8
+               : EVAL_TYPE_TEXT;
+  case AST_EXPR_NULL:
+  case AST_EXPR_COLUMN:
+  case AST_EXPR_STAR:
+    break;
+  }
+  return EVAL_TYPE_UNKNOWN;
+}
+
+// --- Evaluation ---
+
+static bool eval_expr(EvalContext *ev, const AstExpr *expr, SqlValue *out) {
+  switch (expr->kind) {
+  case AST_EXPR_INTEGER:
+    *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = expr->integer};
+    return true;
+  case AST_EXPR_FLOAT:
+    *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = expr->real};
+    return true;
+  case AST_EXPR_STRING:
+    *out = (SqlValue){.kind = SQL_VALUE_STRING,
+                      .string = eval_collapse_quotes(ev->arena, expr->string)};
+    return true;
+  case AST_EXPR_BOOLEAN:
+    *out = (SqlValue){.kind = SQL_VALUE_BOOLEAN, .boolean = expr->boolean};
+    return true;
+  case AST_EXPR_NULL:
+    *out = (SqlValue){.kind = SQL_VALUE_NULL};
+    return true;
+  case AST_EXPR_PARAMETER:
+    *out = expr->parameter < ev->param_count
+               ? ev->params[expr->parameter]
+               : (SqlValue){.kind = SQL_VALUE_NULL};
+    return true;
+  case AST_EXPR_UNARY: {
+    SqlValue operand;
+    if (!eval_expr(ev, expr->unary.operand, &operand)) {
+      return false;
+    }
+    *out = operand;
+    if (operand.kind == SQL_VALUE_NULL) {
+      return true;
+    }
+    if (expr->unary.op == AST_OP_NOT) {
+      if (operand.kind != SQL_VALUE_BOOLEAN) {
+        sql_error_set(ev->error, "42804", 0,
+                      "argument of NOT must be type boolean, not type %s",
+                      eval_value_type_name(operand.kind));
+        return false;
+      }
+      out->boolean = !operand.boolean;
+      return true;
+    }
+    if (operand.kind == SQL_VALUE_INTEGER) {
+      if (operand.integer == INT64_MIN) {
+        sql_error_set(ev->error, "22003", 0, "bigint out of range");
+        return false;
+      }
+      out->integer = -operand.integer;
+      return true;
+    }
+    if (operand.kind == SQL_VALUE_FLOAT) {
+      out->real = -operand.real;
+      return true;
+    }
+    sql_error_set(ev->error, "42883", 0, "operator does not exist: - %s",
+                  eval_value_type_name(operand.kind));
+    return false;
+  }
+  case AST_EXPR_BINARY: {
+    AstOperator op = expr->binary.op;
+    if (op == AST_OP_AND || op == AST_OP_OR) {
+      return eval_logical(ev, expr, out);
+    }
+    SqlValue left, right;
+    if (!eval_expr(ev, expr->binary.left, &left) ||
+        !eval_expr(ev, expr->binary.right, &right)) {
+      return false;
+    }
+    if (op >= AST_OP_EQUAL && op <= AST_OP_GREATER_EQUAL) {
+      return eval_compare(ev, op, left, right, out);
+    }
+    return eval_arithmetic(ev, op, left, right, out);
+  }
+  case AST_EXPR_IS_NULL: {
+    SqlValue operand;
+    if (!eval_expr(ev, expr->is_null.operand, &operand)) {
+      return false;
+    }
+    bool is_null = operand.kind == SQL_VALUE_NULL;
+    *out = (SqlValue){.kind = SQL_VALUE_BOOLEAN,
+                      .boolean = is_null != expr->is_null.is_not};
+    return true;
+  }
+  case AST_EXPR_FUNCTION:
+    switch (eval_function(expr->function.name)) {
+    case EVAL_FUNCTION_GENERATE_SERIES:
+      ASSERT(expr == ev->series);
+      *out = (SqlValue){.kind = SQL_VALUE_INTEGER,
+                        .integer = ev->series_value};
+      return true;
+    case EVAL_FUNCTION_VERSION:
+      *out = (SqlValue){.kind = SQL_VALUE_STRING,
+                        .string = sv_from_cstr(ev->version)};
+      return true;
+    case EVAL_FUNCTION_CURRENT_DATABASE:
+      *out = (SqlValue){.kind = SQL_VALUE_STRING,
+                        .string = sv_from_cstr(ev->database)};
+      return true;
+    case EVAL_FUNCTION_NONE:
+      break;
+    }
+    break;
+  case AST_EXPR_COLUMN:
+  case AST_EXPR_STAR:
+    break;
+  }
+  ASSERT_MSG(false, "Expression kind rejected by eval_check_expr");
+  return false;
+}
+
+// AND and OR in three-valued logic, skipping the right side when the left
+// decides.
+static bool eval_logical(EvalContext *ev, const AstExpr *expr, SqlValue *out) {
+  bool is_and = expr->binary.op == AST_OP_AND;
+  const AstExpr *sides[2] = {expr->binary.left, expr->binary.right};
+  bool saw_null = false;
+  for (u32 i = 0; i < 2; ++i) {
+    SqlValue value;
+    if (!eval_expr(ev, sides[i], &value)) {
+      return false;
+    }
+    if (value.kind == SQL_VALUE_NULL) {
+      saw_null = true;
+      continue;
+    }
+    if (value.kind != SQL_VALUE_BOOLEAN) {
+      sql_error_set(ev->error, "42804", 0,
+                    "argument of %s must be type boolean, not type %s",
+                    is_and ? "AND" : "OR", eval_value_type_name(value.kind));
+      return false;
+    }
+    if (value.boolean != is_and) {
+      *out = value; // false AND x, true OR x
+      return true;
+    }
+  }
+  *out = saw_null ? (SqlValue){.kind = SQL_VALUE_NULL}
+                  : (SqlValue){.kind = SQL_VALUE_BOOLEAN, .boolean = is_and};
+  return true;
+}
+
+static bool eval_compare(EvalContext *ev, AstOperator op, SqlValue left,
+                         SqlValue right, SqlValue *out) {
+  if (left.kind == SQL_VALUE_NULL || right.kind == SQL_VALUE_NULL) {
+    *out = (SqlValue){.kind = SQL_VALUE_NULL};
+    return true;
+  }
+  bool left_number =
+      left.kind == SQL_VALUE_INTEGER || left.kind == SQL_VALUE_FLOAT;
+  bool right_number =
+      right.kind == SQL_VALUE_INTEGER || right.kind == SQL_VALUE_FLOAT;
+  int cmp;
+  if (left.kind == SQL_VALUE_INTEGER && right.kind == SQL_VALUE_INTEGER) {
+    cmp = (left.integer > right.integer) - (left.integer < right.integer);
+  } else if (left_number && right_number) {
+    f64 a = left.kind == SQL_VALUE_INTEGER ? (f64)left.integer : left.real;
+    f64 b = right.kind == SQL_VALUE_INTEGER ? (f64)right.integer : right.real;
+    cmp = (a > b) - (a < b);
+  } else if (left.kind == SQL_VALUE_STRING &&
+             right.kind == SQL_VALUE_STRING) {
+    cmp = sv_compare(left.string, right.string);
+  } else if (left.kind == SQL_VALUE_BOOLEAN &&
+             right.kind == SQL_VALUE_BOOLEAN) {
+    cmp = (int)left.boolean - (int)right.boolean;
+  } else {
+    sql_error_set(ev->error, "42883", 0, "operator does not exist: %s %s %s",
+                  eval_value_type_name(left.kind), eval_operator_symbol(op),
+                  eval_value_type_name(right.kind));
+    return false;
+  }
+  bool result = false;
+  switch (op) {
+  case AST_OP_EQUAL:
+    result = cmp == 0;
+    break;
+  case AST_OP_NOT_EQUAL:
+    result = cmp != 0;
+    break;
+  case AST_OP_LESS:
+    result = cmp < 0;
+    break;
+  case AST_OP_LESS_EQUAL:
+    result = cmp <= 0;
+    break;
+  case AST_OP_GREATER:
+    result = cmp > 0;
+    break;
+  case AST_OP_GREATER_EQUAL:
+    result = cmp >= 0;
+    break;
+  default:
+    ASSERT_MSG(false, "Not a comparison");
+  }
+  *out = (SqlValue){.kind = SQL_VALUE_BOOLEAN, .boolean = result};
+  return true;
+}
+
+// Integer arithmetic is checked for overflow; mixing in a float makes it
+// floating point.
+static bool eval_arithmetic(EvalContext *ev, AstOperator op, SqlValue left,
+                            SqlValue right, SqlValue *out) {
+  if (left.kind == SQL_VALUE_NULL || right.kind == SQL_VALUE_NULL) {
+    *out = (SqlValue){.kind = SQL_VALUE_NULL};
+    return true;
+  }
+  if (left.kind == SQL_VALUE_INTEGER && right.kind == SQL_VALUE_INTEGER) {
+    i64 a = left.integer, b = right.integer, result = 0;
+    bool overflow = false;
+    switch (op) {
+    case AST_OP_ADD:
+      overflow = __builtin_add_overflow(a, b, &result);
+      break;
+    case AST_OP_SUBTRACT:
+      overflow = __builtin_sub_overflow(a, b, &result);
+      break;
+    case AST_OP_MULTIPLY:
+      overflow = __builtin_mul_overflow(a, b, &result);
+      break;
+    case AST_OP_DIVIDE:
+    case AST_OP_MODULO:
+      if (b == 0) {
+        sql_error_set(ev->error, "22012", 0, "division by zero");
+        return false;
+      }
+      if (b == -1) {
+        // INT64_MIN / -1 overflows; INT64_MIN % -1 traps on x86.
+        overflow = op == AST_OP_DIVIDE && a == INT64_MIN;
+        result = op == AST_OP_DIVIDE ? (overflow ? 0 : -a) : 0;
+      } else {
+        result = op == AST_OP_DIVIDE ? a / b : a % b;
+      }
+      break;
+    default:
+      ASSERT_MSG(false, "Not an arithmetic operator");
+    }
+    if (overflow) {
+      sql_error_set(ev->error, "22003", 0, "bigint out of range");
+      return false;
+    }
+    *out = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = result};
+    return true;
+  }
+
+  bool left_number =
+      left.kind == SQL_VALUE_INTEGER || left.kind == SQL_VALUE_FLOAT;
+  bool right_number =
+      right.kind == SQL_VALUE_INTEGER || right.kind == SQL_VALUE_FLOAT;
+  if (!left_number || !right_number || op == AST_OP_MODULO) {
+    sql_error_set(ev->error, "42883", 0, "operator does not exist: %s %s %s",
+                  eval_value_type_name(left.kind), eval_operator_symbol(op),
+                  eval_value_type_name(right.kind));
+    return false;
+  }
+  f64 a = left.kind == SQL_VALUE_INTEGER ? (f64)left.integer : left.real;
+  f64 b = right.kind == SQL_VALUE_INTEGER ? (f64)right.integer : right.real;
+  f64 result = 0.0;
+  switch (op) {
+  case AST_OP_ADD:
+    result = a + b;
+    break;
+  case AST_OP_SUBTRACT:
+    result = a - b;
+    break;
+  case AST_OP_MULTIPLY:
+    result = a * b;
+    break;
+  case AST_OP_DIVIDE:
+    if (b == 0.0) {
+      sql_error_set(ev->error, "22012", 0, "division by zero");
+      return false;
+    }
+    result = a / b;
+    break;
+  default:
+    ASSERT_MSG(false, "Not an arithmetic operator");
+  }
+  *out = (SqlValue){.kind = SQL_VALUE_FLOAT, .real = result};
+  return true;
+}
+
+static EvalFunction eval_function(StringView name) {
+  if (sv_equals_ignore_case(name, "generate_series")) {
+    return EVAL_FUNCTION_GENERATE_SERIES;
+  }
+  if (sv_equals_ignore_case(name, "version")) {
+    return EVAL_FUNCTION_VERSION;
+  }
+  if (sv_equals_ignore_case(name, "current_database")) {
+    return EVAL_FUNCTION_CURRENT_DATABASE;
+  }
+  return EVAL_FUNCTION_NONE;
+}
+
+// --- Values ---
+
+// Turns the '' of a string literal into '. Literals without one are
+// returned as they are, without copying.
+static StringView eval_collapse_quotes(Arena *arena, StringView text) {
+  if (text.length == 0 || !memchr(text.data, '\'', text.length)) {
+    return text;
+  }
+  char *copy = (char *)arena_alloc(arena, text.length);
+  if (!copy) {
+    return text;
+  }
+  usize length = 0;
+  for (usize i = 0; i < text.length; ++i) {
+    copy[length++] = text.data[i];
+    if (text.data[i] == '\'' && i + 1 < text.length &&
+        text.data[i + 1] == '\'') {
+      i++;
+    }
+  }
+  return sv_from_parts(copy, length);
+}
+
+static EvalType eval_type_of(SqlValueKind kind) {
+  switch (kind) {
+  case SQL_VALUE_INTEGER:
+    return EVAL_TYPE_INT8;
+  case SQL_VALUE_FLOAT:
+    return EVAL_TYPE_FLOAT8;
+  case SQL_VALUE_STRING:
+    return EVAL_TYPE_TEXT;
+  case SQL_VALUE_BOOLEAN:
+    return EVAL_TYPE_BOOL;
+  case SQL_VALUE_NULL:
+    break;
+  }
+  return EVAL_TYPE_UNKNOWN;
+}
+
+static const char *eval_operator_symbol(AstOperator op) {
+  switch (op) {
+  case AST_OP_EQUAL:
+    return "=";
+  case AST_OP_NOT_EQUAL:
+    return "<>";
+  case AST_OP_LESS:
+    return "<";
+  case AST_OP_LESS_EQUAL:
+    return "<=";
+  case AST_OP_GREATER:
+    return ">";
+  case AST_OP_GREATER_EQUAL:
+    return ">=";
+  case AST_OP_ADD:
+    return "+";
+  case AST_OP_SUBTRACT:
+    return "-";
+  case AST_OP_MULTIPLY:
+    return "*";
+  case AST_OP_DIVIDE:
+    return "/";
+  case AST_OP_MODULO:
+    return "%";
+  case AST_OP_OR:
+  case AST_OP_AND:
+  case AST_OP_NOT:
+  case AST_OP_NEGATE:
+    break;
+  }
+  return "?";
+}
+
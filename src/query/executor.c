@@ -0,0 +1,3686 @@
+#include "sqldb/executor.h"
+
+#include <errno.h>
+#include <math.h>
+
+// =================================================================================================
+// :: Private Types ::
+// =================================================================================================
+
+// Rows materialized by a blocking operator, column by column. Arrays grow by
+// doubling; the old ones stay in the arena until it is reset.
+typedef struct {
+  ExecVector *columns;
+  u32 column_count;
+  usize count;
+  usize capacity;
+} ExecRows;
+
+typedef struct {
+  const ExecTable *table;
+  u32 *columns; // Table column of every output column
+  usize position;
+  usize end;           // Rows before this one are scanned
+  SchedWorker *worker; // Hands out the rows of morsel scans, NULL otherwise
+  ExecBatch batch;
+} ScanState;
+
+typedef struct {
+  const ColumnTable *table;
+  u32 *columns; // Table column of every output column
+  ExecExpr *predicate;
+  bool *is_predicate_column; // Per output column
+  ColumnReader *readers;
+  u8 **buffers; // Chunk copy per numeric column, reused across row groups
+  u32 *buffer_sizes;
+  bool *nulls;      // EXEC_BATCH_SIZE rows, NULL in a predicate column
+  u32 *candidates;  // Rows with no NULL predicate column
+  u32 *selection;
+  u32 next_group;
+  u32 rows_left; // Rows of the open row group not decoded yet
+  ExecColumnScanStats stats;
+  ExecBatch batch;
+} ColumnScanState;
+
+typedef struct {
+  ExecExpr *predicate;
+  u32 *selection;
+  ExecBatch batch;
+} FilterState;
+
+typedef struct {
+  ExecExpr **exprs;
+  u32 expr_count;
+  ExecBatch batch;
+} ProjectState;
+
+// Groups live in 'groups' with the layout [keys][hash][accumulators][AVG
+// counts]; 'slots' is an open-addressing table of group index + 1.
+typedef struct {
+  ExecExpr **keys;
+  const ExecVector **key_vectors; // Values of 'keys' for the current batch
+  u32 key_count;
+  ExecAggregate *aggregates;
+  u32 aggregate_count;
+  u32 *avg_columns; // Count column of each AVG aggregate, 0 otherwise
+  ExecRows groups;
+  u32 *slots;
+  usize slot_mask;
+  u64 *hashes;    // EXEC_BATCH_SIZE, per input row
+  u32 *group_ids; // EXEC_BATCH_SIZE, per input row
+  bool is_built;
+  usize position;
+  ExecBatch batch;
+} AggregateState;
+
+// Build rows hold the build columns followed by the key. Rows with the same
+// bucket are chained through 'next' (row index + 1, 0 ends the chain).
+struct ExecJoinTable {
+  ExecExpr *build_key;
+  ExecType *types; // Build columns
+  u32 column_count;
+  ExecRows rows;
+  ExecVector *append_vectors;
+  u32 *buckets;
+  u32 *next;
+  usize bucket_mask;
+};
+
+typedef struct {
+  const ExecJoinTable *table;
+  ExecJoinTable *pending_table; // Loaded from op->build on the first batch
+  ExecExpr *probe_key;
+
+  ExecBatch *probe_batch; // Probe batch being joined, NULL between batches
+  const ExecVector *probe_keys;
+  u32 probe_index; // Selected row of probe_batch being matched
+  u32 chain;       // Next build row to test for it, + 1
+  u32 *probe_rows; // EXEC_BATCH_SIZE matched probe rows
+  u32 *build_rows; // EXEC_BATCH_SIZE matched build rows
+  ExecBatch batch;
+} JoinState;
+
+// Strings copied out of a buffer that is reused: filling it past its capacity
+// moves on to a new, larger one, so the strings already handed out stay put.
+typedef struct {
+  char *data;
+  usize size;
+  usize capacity;
+} ExecStrings;
+
+// The key hash and row of every row of a build side, grouped by partition
+// (low hash bits) and, within a partition, by bucket (the bits above). A
+// bucket is a contiguous run of entries, so a probe scans one short array
+// instead of following a chain, and duplicate keys only slow down probes for
+// that key.
+typedef struct {
+  u32 bits;          // log2 of the partition count
+  u32 *part_start;   // Partition p has entries [part_start[p], [p + 1])
+  u32 *bucket_base;  // First bucket_start index of partition p
+  u8 *bucket_bits;   // log2 of the bucket count of partition p
+  u32 *bucket_start; // Bucket b of p: entries [[base + b], [base + b + 1])
+  usize bucket_capacity;
+  u64 *hashes;
+  u32 *rows;
+  u64 *scratch_hashes;
+  u32 *scratch_rows;
+  usize capacity; // Entries allocated
+} RadixTable;
+
+typedef struct {
+  ExecExpr *build_key;
+  ExecExpr *probe_key;
+  usize memory_budget;
+  Scheduler *scheduler;
+  usize build_row_bytes; // Memory charged per build row
+  ExecRows build;        // Build columns + key: all rows, or one spill file
+  ExecRows probe;        // Probe columns + key: the current chunk
+  ExecVector *append_vectors;
+  RadixTable table;
+  bool is_started;
+  bool is_probe_done; // Child exhausted
+
+  // The current probe chunk, grouped by partition like the table.
+  u64 *probe_hashes;
+  u32 *probe_part_start;
+  u64 *probe_entry_hashes;
+  u32 *probe_entry_rows;
+  u32 probe_count;
+  u32 probe_index; // Next entry of the chunk to match
+  u32 cursor;      // Next table entry to test for the current probe row
+  u32 cursor_end;
+  u32 probe_row;
+  u64 probe_hash;
+
+  FILE **spill_files; // Build files, then probe files; NULL if not spilled
+  u32 spill_partition; // Spill file pair being joined
+  bool is_build_split; // 'build' holds only part of its file, see below
+  ExecStrings build_strings; // Of 'build', once spilled
+  ExecStrings probe_strings; // Of 'probe', once spilled
+
+  ExecRadixJoinStats stats;
+  u32 *probe_rows; // EXEC_BATCH_SIZE matched probe rows
+  u32 *build_rows; // EXEC_BATCH_SIZE matched build rows
+  ExecBatch batch;
+} RadixJoinState;
+
+// A row of the run being sorted and the normalized key of its first sort
+// key.
+typedef struct {
+  u64 prefix;
+  u32 row;
+} SortEntry;
+
+// Reads a spilled run back, EXEC_BATCH_SIZE rows at a time.
+typedef struct {
+  FILE *file;
+  ExecRows block;
+  usize position; // Head row of 'block'
+  u64 prefix;     // Normalized key of the head row
+  bool is_done;
+  ExecStrings strings; // Of 'block'
+} SortReader;
+
+typedef struct {
+  const ExecSortKey *keys;
+  u32 key_count;
+  bool is_prefix_complete; // Rows with equal prefixes have equal keys
+  usize run_rows;          // Rows per run, 0 if the sort never spills
+  ExecRows rows;           // All rows, or the run being filled
+  SortEntry *entries;      // 'rows' in sorted order
+  SortEntry *scratch;
+  usize entry_capacity;
+  u32 *order; // EXEC_BATCH_SIZE rows being output
+  bool is_sorted;
+  usize position; // Next entry to output, if nothing was spilled
+
+  FILE **runs; // Spilled runs in input order
+  u32 run_count;
+  u32 run_capacity;
+  SortReader *readers; // 'fan_in' of them, allocated by the first merge
+  u32 fan_in;
+  u32 merge_count; // Readers of the current merge
+  u32 *tree;       // Loser tree: [0] the winner, [1, merge_count) the losers
+  u32 *winners;    // Scratch for building 'tree'
+  ExecStrings strings; // Of the output batch, once merging
+
+  ExecSortStats stats;
+  ExecBatch batch;
+} SortState;
+
+// What one worker runs of a parallel operator, allocated in its arena.
+typedef struct {
+  ExecContext ctx;
+  ExecOperator *pipeline;  // Over a morsel scan
+  ExecOperator *aggregate; // Partial groups over 'pipeline', aggregates only
+  ExecRows rows;           // Output of 'pipeline', scans only
+} ExecWorkerPlan;
+
+typedef struct {
+  Scheduler *scheduler;
+  const ExecTable *table;
+  ExecWorkerPlan *plans; // One per worker
+  bool is_done;
+  u32 worker; // Worker whose rows are being passed on
+  usize position;
+  ExecBatch batch;
+} ParallelState;
+
+typedef struct {
+  u64 limit;  // Rows still to pass on
+  u64 offset; // Rows still to skip
+  u32 *selection;
+  ExecBatch batch;
+} LimitState;
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// Runs 'body' for every active row of 'batch' with 'row' bound to its index.
+#define EXEC_FOR_EACH_ROW(batch, row, ...)                                     \
+  do {                                                                         \
+    if ((batch)->selection) {                                                  \
+      for (u32 i_ = 0; i_ < (batch)->selected_count; ++i_) {                   \
+        u32 row = (batch)->selection[i_];                                      \
+        __VA_ARGS__;                                                           \
+      }                                                                        \
+    } else {                                                                   \
+      for (u32 row = 0; row < (batch)->row_count; ++row) {                     \
+        __VA_ARGS__;                                                           \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+static void *exec_zalloc(ExecContext *ctx, usize size);
+static usize exec_type_size(ExecType type);
+static ExecOperator *exec_new_operator(ExecContext *ctx,
+                                       const ExecOperatorOps *ops,
+                                       usize state_size, u32 column_count);
+static bool exec_init_batch(ExecContext *ctx, ExecBatch *batch,
+                            const ExecType *types, u32 column_count,
+                            bool owns_vectors);
+
+static ExecExpr *exec_new_expr(ExecContext *ctx, ExecExprKind kind,
+                               ExecType type);
+static ExecExpr *exec_expr_cast(ExecContext *ctx, ExecExpr *operand);
+static bool exec_unify_types(ExecContext *ctx, ExecExpr **left,
+                             ExecExpr **right);
+static const ExecVector *exec_eval(ExecContext *ctx, ExecExpr *expr,
+                                   const ExecBatch *batch);
+static void exec_eval_arithmetic(ExecContext *ctx, ExecExpr *expr,
+                                 const ExecVector *l, const ExecVector *r,
+                                 const ExecBatch *batch);
+static u32 exec_select(ExecContext *ctx, ExecExpr *predicate,
+                       const ExecBatch *batch, const u32 *in, u32 in_count,
+                       u32 *out);
+static u32 exec_select_compare(ExecContext *ctx, ExecExpr *predicate,
+                               const ExecBatch *batch, const u32 *in,
+                               u32 in_count, u32 *out);
+static bool exec_compare_holds(AstOperator op, int cmp);
+static AstOperator exec_mirror_compare(AstOperator op);
+
+static bool exec_rows_init(ExecContext *ctx, ExecRows *rows,
+                           const ExecType *types, u32 column_count);
+static bool exec_rows_reserve(ExecContext *ctx, ExecRows *rows, usize needed);
+static bool exec_rows_append(ExecContext *ctx, ExecRows *rows,
+                             const ExecVector *vectors,
+                             const ExecBatch *batch);
+static void exec_gather(ExecVector *dst, const ExecVector *src,
+                        const u32 *rows, u32 count);
+static bool exec_rows_write(FILE *file, const ExecRows *rows, usize row);
+
+static u64 exec_hash_i64(u64 x);
+static u64 exec_hash_value(const ExecVector *vector, usize row);
+static bool exec_values_equal(const ExecVector *a, usize a_row,
+                              const ExecVector *b, usize b_row);
+
+static ExecOperator *exec_morsel_scan(ExecContext *ctx,
+                                      const ExecMorselSource *source,
+                                      SchedWorker *worker);
+static ExecBatch *exec_scan_next(ExecOperator *op);
+static ExecBatch *exec_column_scan_next(ExecOperator *op);
+static bool exec_column_scan_open_group(ExecOperator *op);
+static bool exec_zone_may_match(const ExecExpr *predicate,
+                                const ColumnRowGroup *group,
+                                const u32 *columns);
+static bool exec_zone_may_compare(const ExecExpr *compare,
+                                  const ColumnRowGroup *group,
+                                  const u32 *columns);
+static void exec_mark_columns(const ExecExpr *expr, bool *is_used);
+static ExecType exec_column_type(ColumnType type);
+static ExecBatch *exec_filter_next(ExecOperator *op);
+static ExecBatch *exec_project_next(ExecOperator *op);
+static ExecBatch *exec_aggregate_next(ExecOperator *op);
+static bool exec_aggregate_build(ExecOperator *op);
+static bool exec_aggregate_drain(ExecOperator *op);
+static void exec_aggregate_finish(AggregateState *state);
+static bool exec_aggregate_consume(ExecOperator *op, const ExecBatch *batch);
+static bool exec_aggregate_find_group(ExecContext *ctx, AggregateState *state,
+                                      const ExecVector *const *keys, u32 row,
+                                      u64 hash, u32 *out_group);
+static bool exec_aggregate_new_group(ExecContext *ctx, AggregateState *state,
+                                     const ExecVector *const *keys, u32 row,
+                                     u64 hash, u32 *out_group);
+static bool exec_aggregate_grow_slots(ExecContext *ctx, AggregateState *state);
+static bool exec_aggregate_merge(ExecContext *ctx, AggregateState *into,
+                                 const AggregateState *from);
+static ExecJoinTable *exec_join_table_new(ExecContext *ctx,
+                                          ExecOperator *build,
+                                          ExecExpr *build_key);
+static bool exec_join_table_load(ExecContext *ctx, ExecJoinTable *table,
+                                 ExecOperator *build);
+static ExecOperator *exec_join_new(ExecContext *ctx,
+                                   const ExecJoinTable *table,
+                                   ExecOperator *probe, ExecExpr *probe_key);
+static ExecBatch *exec_join_next(ExecOperator *op);
+static void exec_join_start_row(JoinState *state);
+static ExecBatch *exec_radix_join_next(ExecOperator *op);
+static bool exec_radix_join_start(ExecOperator *op);
+static bool exec_radix_next_chunk(ExecOperator *op);
+static bool exec_radix_fill_chunk(ExecOperator *op);
+static void exec_radix_partition_chunk(RadixJoinState *state);
+static bool exec_radix_build_table(ExecContext *ctx, RadixJoinState *state);
+static void exec_radix_build_job(SchedWorker *worker, void *arg);
+static void exec_radix_bucket_partition(RadixTable *table, u32 partition);
+static u32 exec_radix_match(RadixJoinState *state);
+static bool exec_radix_spill_rows(ExecContext *ctx, RadixJoinState *state,
+                                  ExecRows *rows, FILE **files);
+static bool exec_radix_load_spill(ExecContext *ctx, FILE *file,
+                                  ExecRows *rows, ExecStrings *strings,
+                                  usize max_rows);
+static bool exec_radix_open_spill(ExecContext *ctx, RadixJoinState *state);
+static bool exec_radix_load_partition(ExecContext *ctx, RadixJoinState *state,
+                                      u32 partition);
+static bool exec_radix_load_build(ExecContext *ctx, RadixJoinState *state);
+static void exec_radix_close_spill(RadixJoinState *state);
+static void exec_radix_join_close(ExecOperator *op);
+static ExecBatch *exec_sort_next(ExecOperator *op);
+static bool exec_sort_consume(ExecOperator *op);
+static bool exec_sort_run(ExecContext *ctx, SortState *state);
+static SortEntry *exec_sort_radix(SortEntry *entries, SortEntry *scratch,
+                                  usize count);
+static u64 exec_sort_prefix(const ExecVector *column, usize row,
+                            bool is_descending);
+static int exec_sort_compare(const void *a, const void *b, void *arg);
+static int exec_sort_compare_rows(const SortState *state, const ExecRows *a,
+                                  usize a_row, const ExecRows *b, usize b_row);
+static bool exec_sort_spill_run(ExecContext *ctx, SortState *state);
+static FILE *exec_sort_new_run(ExecContext *ctx, SortState *state);
+static bool exec_sort_merge_pass(ExecOperator *op);
+static bool exec_sort_start_merge(ExecOperator *op, FILE **files, u32 count);
+static bool exec_sort_read_block(ExecContext *ctx, const SortState *state,
+                                 SortReader *reader);
+static SortReader *exec_sort_head(SortState *state);
+static bool exec_sort_advance(ExecContext *ctx, SortState *state);
+static bool exec_sort_less(const SortState *state, u32 a, u32 b);
+static void exec_sort_build_tree(SortState *state);
+static void exec_sort_replay(SortState *state, u32 leaf);
+static ExecBatch *exec_sort_merge_next(ExecOperator *op);
+static char *exec_string_space(ExecContext *ctx, ExecStrings *strings,
+                               usize length);
+static void exec_sort_close_runs(SortState *state);
+static void exec_sort_close(ExecOperator *op);
+static ExecBatch *exec_limit_next(ExecOperator *op);
+static ExecWorkerPlan *exec_parallel_plans(ExecContext *ctx,
+                                           Scheduler *scheduler,
+                                           const ExecMorselSource *source);
+static bool exec_parallel_run(ExecOperator *op, SchedJobFn job);
+static void exec_parallel_scan_job(SchedWorker *worker, void *arg);
+static void exec_parallel_aggregate_job(SchedWorker *worker, void *arg);
+static ExecBatch *exec_parallel_scan_next(ExecOperator *op);
+static ExecBatch *exec_parallel_aggregate_next(ExecOperator *op);
+static void exec_parallel_close(ExecOperator *op);
+
+static const ExecOperatorOps scan_ops = {"scan", exec_scan_next, NULL};
+static const ExecOperatorOps column_scan_ops = {"column scan",
+                                                exec_column_scan_next, NULL};
+static const ExecOperatorOps filter_ops = {"filter", exec_filter_next, NULL};
+static const ExecOperatorOps project_ops = {"project", exec_project_next,
+                                            NULL};
+static const ExecOperatorOps aggregate_ops = {"hash aggregate",
+                                              exec_aggregate_next, NULL};
+static const ExecOperatorOps join_ops = {"hash join", exec_join_next, NULL};
+static const ExecOperatorOps radix_join_ops = {
+    "radix join", exec_radix_join_next, exec_radix_join_close};
+static const ExecOperatorOps sort_ops = {"sort", exec_sort_next,
+                                         exec_sort_close};
+static const ExecOperatorOps limit_ops = {"limit", exec_limit_next, NULL};
+static const ExecOperatorOps parallel_scan_ops = {
+    "parallel scan", exec_parallel_scan_next, exec_parallel_close};
+static const ExecOperatorOps parallel_aggregate_ops = {
+    "parallel aggregate", exec_parallel_aggregate_next, exec_parallel_close};
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void *exec_alloc(ExecContext *ctx, usize size) {
+  ASSERT(ctx && ctx->arena);
+  void *ptr = arena_alloc(ctx->arena, size);
+  if (!ptr) {
+    ctx->has_error = true;
+  }
+  return ptr;
+}
+
+// --- Expressions ---
+
+ExecExpr *exec_expr_column(ExecContext *ctx, u32 column, ExecType type) {
+  ExecExpr *expr = exec_new_expr(ctx, EXEC_EXPR_COLUMN, type);
+  if (expr) {
+    expr->column = column;
+  }
+  return expr;
+}
+
+// Constants are expanded into a full vector once, so operators treat them
+// like any other input.
+ExecExpr *exec_expr_constant(ExecContext *ctx, SqlValue value) {
+  ExecType type;
+  switch (value.kind) {
+  case SQL_VALUE_INTEGER:
+  case SQL_VALUE_BOOLEAN:
+    type = EXEC_TYPE_INT64;
+    break;
+  case SQL_VALUE_FLOAT:
+    type = EXEC_TYPE_FLOAT64;
+    break;
+  case SQL_VALUE_STRING:
+    type = EXEC_TYPE_STRING;
+    break;
+  default:
+    ASSERT_MSG(false, "NULL constants are not supported by the executor");
+    return NULL;
+  }
+  ExecExpr *expr = exec_new_expr(ctx, EXEC_EXPR_CONSTANT, type);
+  if (!expr) {
+    return NULL;
+  }
+  if (value.kind == SQL_VALUE_BOOLEAN) {
+    value = (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = value.boolean};
+  }
+  expr->constant = value;
+  for (u32 i = 0; i < EXEC_BATCH_SIZE; ++i) {
+    switch (type) {
+    case EXEC_TYPE_INT64:
+      expr->result.i64s[i] = value.integer;
+      break;
+    case EXEC_TYPE_FLOAT64:
+      expr->result.f64s[i] = value.real;
+      break;
+    case EXEC_TYPE_STRING:
+      expr->result.strings[i] = value.string;
+      break;
+    }
+  }
+  return expr;
+}
+
+ExecExpr *exec_expr_arithmetic(ExecContext *ctx, AstOperator op,
+                               ExecExpr *left, ExecExpr *right) {
+  ASSERT(op >= AST_OP_ADD && op <= AST_OP_MODULO);
+  if (!left || !right || !exec_unify_types(ctx, &left, &right)) {
+    return NULL;
+  }
+  ASSERT_MSG(left->type != EXEC_TYPE_STRING, "No arithmetic on strings");
+  ExecExpr *expr = exec_new_expr(ctx, EXEC_EXPR_ARITHMETIC, left->type);
+  if (expr) {
+    expr->binary.op = op;
+    expr->binary.left = left;
+    expr->binary.right = right;
+  }
+  return expr;
+}
+
+ExecExpr *exec_expr_compare(ExecContext *ctx, AstOperator op, ExecExpr *left,
+                            ExecExpr *right) {
+  ASSERT(op >= AST_OP_EQUAL && op <= AST_OP_GREATER_EQUAL);
+  if (!left || !right || !exec_unify_types(ctx, &left, &right)) {
+    return NULL;
+  }
+  // Keep constants on the right, where the comparison loops expect them.
+  if (left->kind == EXEC_EXPR_CONSTANT && right->kind != EXEC_EXPR_CONSTANT) {
+    ExecExpr *tmp = left;
+    left = right;
+    right = tmp;
+    op = exec_mirror_compare(op);
+  }
+  ExecExpr *expr = (ExecExpr *)exec_zalloc(ctx, sizeof(ExecExpr));
+  if (expr) {
+    expr->kind = EXEC_EXPR_COMPARE;
+    expr->is_predicate = true;
+    expr->binary.op = op;
+    expr->binary.left = left;
+    expr->binary.right = right;
+  }
+  return expr;
+}
+
+ExecExpr *exec_expr_and(ExecContext *ctx, ExecExpr *left, ExecExpr *right) {
+  if (!left || !right) {
+    return NULL;
+  }
+  ASSERT(left->is_predicate && right->is_predicate);
+  ExecExpr *expr = (ExecExpr *)exec_zalloc(ctx, sizeof(ExecExpr));
+  if (expr) {
+    expr->kind = EXEC_EXPR_AND;
+    expr->is_predicate = true;
+    expr->binary.op = AST_OP_AND;
+    expr->binary.left = left;
+    expr->binary.right = right;
+  }
+  return expr;
+}
+
+ExecExpr *exec_expr_or(ExecContext *ctx, ExecExpr *left, ExecExpr *right) {
+  if (!left || !right) {
+    return NULL;
+  }
+  ASSERT(left->is_predicate && right->is_predicate);
+  ExecExpr *expr = (ExecExpr *)exec_zalloc(ctx, sizeof(ExecExpr));
+  if (!expr) {
+    return NULL;
+  }
+  expr->kind = EXEC_EXPR_OR;
+  expr->is_predicate = true;
+  expr->binary.op = AST_OP_OR;
+  expr->binary.left = left;
+  expr->binary.right = right;
+  expr->scratch = (u32 *)exec_alloc(ctx, 2 * EXEC_BATCH_SIZE * sizeof(u32));
+  return expr->scratch ? expr : NULL;
+}
+
+ExecExpr *exec_expr_between(ExecContext *ctx, ExecExpr *value, ExecExpr *low,
+                            ExecExpr *high) {
+  return exec_expr_and(
+      ctx, exec_expr_compare(ctx, AST_OP_GREATER_EQUAL, value, low),
+      exec_expr_compare(ctx, AST_OP_LESS_EQUAL, value, high));
+}
+
+// --- Operators ---
+
+ExecBatch *exec_next(ExecOperator *op) {
+  ASSERT(op && op->ops);
+  if (op->ctx->has_error || op->is_closed) {
+    return NULL;
+  }
+  ExecBatch *batch = op->ops->next(op);
+  if (!batch || op->ctx->has_error) {
+    return NULL;
+  }
+  op->stats.batches++;
+  op->stats.rows += batch->selected_count;
+  return batch;
+}
+
+void exec_close(ExecOperator *op) {
+  if (!op || op->is_closed) {
+    return;
+  }
+  op->is_closed = true;
+  exec_close(op->child);
+  exec_close(op->build);
+  if (op->ops->close) {
+    op->ops->close(op);
+  }
+}
+
+ExecOperator *exec_scan(ExecContext *ctx, const ExecTable *table,
+                        const u32 *columns, u32 column_count) {
+  ASSERT(ctx && table && columns && column_count > 0);
+  ExecOperator *op =
+      exec_new_operator(ctx, &scan_ops, sizeof(ScanState), column_count);
+  if (!op) {
+    return NULL;
+  }
+  ScanState *state = (ScanState *)op->state;
+  state->table = table;
+  state->end = table->row_count;
+  state->columns = (u32 *)exec_alloc(ctx, column_count * sizeof(u32));
+  if (!state->columns) {
+    return NULL;
+  }
+  for (u32 c = 0; c < column_count; ++c) {
+    ASSERT(columns[c] < table->column_count);
+    state->columns[c] = columns[c];
+    op->types[c] = table->columns[columns[c]].type;
+  }
+  return exec_init_batch(ctx, &state->batch, op->types, column_count, false)
+             ? op
+             : NULL;
+}
+
+ExecOperator *exec_column_scan(ExecContext *ctx, const ColumnTable *table,
+                               const u32 *columns, u32 column_count,
+                               ExecExpr *predicate) {
+  ASSERT(ctx && table && columns && column_count > 0);
+  ASSERT(!predicate || predicate->is_predicate);
+  ExecOperator *op = exec_new_operator(ctx, &column_scan_ops,
+                                       sizeof(ColumnScanState), column_count);
+  if (!op) {
+    return NULL;
+  }
+  ColumnScanState *state = (ColumnScanState *)op->state;
+  state->table = table;
+  state->predicate = predicate;
+  state->columns = (u32 *)exec_alloc(ctx, column_count * sizeof(u32));
+  state->is_predicate_column =
+      (bool *)exec_zalloc(ctx, column_count * sizeof(bool));
+  state->readers =
+      (ColumnReader *)exec_zalloc(ctx, column_count * sizeof(ColumnReader));
+  state->buffers = (u8 **)exec_zalloc(ctx, column_count * sizeof(u8 *));
+  state->buffer_sizes = (u32 *)exec_zalloc(ctx, column_count * sizeof(u32));
+  state->nulls = (bool *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(bool));
+  state->candidates = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  state->selection = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  if (!state->columns || !state->is_predicate_column || !state->readers ||
+      !state->buffers || !state->buffer_sizes || !state->nulls ||
+      !state->candidates || !state->selection) {
+    return NULL;
+  }
+  for (u32 c = 0; c < column_count; ++c) {
+    ASSERT(columns[c] < table->column_count);
+    state->columns[c] = columns[c];
+    op->types[c] = exec_column_type(table->types[columns[c]]);
+  }
+  if (predicate) {
+    exec_mark_columns(predicate, state->is_predicate_column);
+  }
+  return exec_init_batch(ctx, &state->batch, op->types, column_count, true)
+             ? op
+             : NULL;
+}
+
+ExecColumnScanStats exec_column_scan_stats(const ExecOperator *op) {
+  ASSERT(op && op->ops == &column_scan_ops);
+  return ((const ColumnScanState *)op->state)->stats;
+}
+
+ExecOperator *exec_filter(ExecContext *ctx, ExecOperator *child,
+                          ExecExpr *predicate) {
+  if (!child || !predicate) {
+    return NULL;
+  }
+  ASSERT(predicate->is_predicate);
+  ExecOperator *op = exec_new_operator(ctx, &filter_ops, sizeof(FilterState),
+                                       child->column_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = child;
+  memcpy(op->types, child->types, child->column_count * sizeof(ExecType));
+  FilterState *state = (FilterState *)op->state;
+  state->predicate = predicate;
+  state->selection = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  return state->selection ? op : NULL;
+}
+
+ExecOperator *exec_project(ExecContext *ctx, ExecOperator *child,
+                           ExecExpr **exprs, u32 expr_count) {
+  if (!child || !exprs || expr_count == 0) {
+    return NULL;
+  }
+  ExecOperator *op = exec_new_operator(ctx, &project_ops,
+                                       sizeof(ProjectState), expr_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = child;
+  ProjectState *state = (ProjectState *)op->state;
+  state->exprs = (ExecExpr **)exec_alloc(ctx, expr_count * sizeof(ExecExpr *));
+  if (!state->exprs) {
+    return NULL;
+  }
+  for (u32 i = 0; i < expr_count; ++i) {
+    if (!exprs[i]) {
+      return NULL;
+    }
+    ASSERT_MSG(!exprs[i]->is_predicate, "Predicates cannot be projected");
+    state->exprs[i] = exprs[i];
+    op->types[i] = exprs[i]->type;
+  }
+  state->expr_count = expr_count;
+  return exec_init_batch(ctx, &state->batch, op->types, expr_count, false)
+             ? op
+             : NULL;
+}
+
+ExecOperator *exec_hash_aggregate(ExecContext *ctx, ExecOperator *child,
+                                  ExecExpr **groups, u32 group_count,
+                                  const ExecAggregate *aggregates,
+                                  u32 aggregate_count) {
+  if (!child || (group_count > 0 && !groups) ||
+      (aggregate_count > 0 && !aggregates)) {
+    return NULL;
+  }
+  ASSERT(group_count + aggregate_count > 0);
+  ExecOperator *op =
+      exec_new_operator(ctx, &aggregate_ops, sizeof(AggregateState),
+                        group_count + aggregate_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = child;
+  AggregateState *state = (AggregateState *)op->state;
+  state->key_count = group_count;
+  state->aggregate_count = aggregate_count;
+  state->keys = (ExecExpr **)exec_alloc(
+      ctx, (group_count > 0 ? group_count : 1) * sizeof(ExecExpr *));
+  state->key_vectors = (const ExecVector **)exec_alloc(
+      ctx, (group_count > 0 ? group_count : 1) * sizeof(ExecVector *));
+  state->aggregates = (ExecAggregate *)exec_alloc(
+      ctx, (aggregate_count > 0 ? aggregate_count : 1) * sizeof(ExecAggregate));
+  state->avg_columns = (u32 *)exec_zalloc(
+      ctx, (aggregate_count > 0 ? aggregate_count : 1) * sizeof(u32));
+  if (!state->keys || !state->key_vectors || !state->aggregates ||
+      !state->avg_columns) {
+    return NULL;
+  }
+
+  u32 avg_count = 0;
+  for (u32 a = 0; a < aggregate_count; ++a) {
+    avg_count += aggregates[a].kind == EXEC_AGG_AVG ? 1u : 0u;
+  }
+  u32 column_count = group_count + 1 + aggregate_count + avg_count;
+  ExecType *types = (ExecType *)exec_alloc(ctx, column_count * sizeof(ExecType));
+  if (!types) {
+    return NULL;
+  }
+  for (u32 g = 0; g < group_count; ++g) {
+    if (!groups[g]) {
+      return NULL;
+    }
+    ASSERT_MSG(!groups[g]->is_predicate, "Predicates cannot be grouped on");
+    state->keys[g] = groups[g];
+    types[g] = op->types[g] = groups[g]->type;
+  }
+  types[group_count] = EXEC_TYPE_INT64; // Hash
+
+  u32 next_avg_column = group_count + 1 + aggregate_count;
+  for (u32 a = 0; a < aggregate_count; ++a) {
+    ExecAggregate aggregate = aggregates[a];
+    ExecType type = EXEC_TYPE_INT64;
+    if (aggregate.kind != EXEC_AGG_COUNT_STAR) {
+      if (!aggregate.input) {
+        return NULL;
+      }
+      ASSERT_MSG(!aggregate.input->is_predicate,
+                 "Predicates cannot be aggregated");
+      ASSERT_MSG(aggregate.kind == EXEC_AGG_COUNT ||
+                     aggregate.input->type != EXEC_TYPE_STRING,
+                 "Only COUNT accepts strings");
+    }
+    switch (aggregate.kind) {
+    case EXEC_AGG_COUNT_STAR:
+    case EXEC_AGG_COUNT:
+      break;
+    case EXEC_AGG_SUM:
+    case EXEC_AGG_MIN:
+    case EXEC_AGG_MAX:
+      type = aggregate.input->type;
+      break;
+    case EXEC_AGG_AVG:
+      if (aggregate.input->type == EXEC_TYPE_INT64) {
+        aggregate.input = exec_expr_cast(ctx, aggregate.input);
+        if (!aggregate.input) {
+          return NULL;
+        }
+      }
+      type = EXEC_TYPE_FLOAT64;
+      state->avg_columns[a] = next_avg_column;
+      types[next_avg_column++] = EXEC_TYPE_INT64;
+      break;
+    }
+    state->aggregates[a] = aggregate;
+    types[group_count + 1 + a] = op->types[group_count + a] = type;
+  }
+
+  state->hashes = (u64 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u64));
+  state->group_ids = (u32 *)exec_zalloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  if (!state->hashes || !state->group_ids ||
+      !exec_rows_init(ctx, &state->groups, types, column_count) ||
+      !exec_init_batch(ctx, &state->batch, op->types, op->column_count,
+                       false)) {
+    return NULL;
+  }
+  if (group_count == 0) {
+    // A single group that exists even for empty input. Every input row maps
+    // to it through the zeroed group_ids.
+    u32 group;
+    if (!exec_aggregate_new_group(ctx, state, NULL, 0, 0, &group)) {
+      return NULL;
+    }
+  } else if (!exec_aggregate_grow_slots(ctx, state)) {
+    return NULL;
+  }
+  return op;
+}
+
+ExecOperator *exec_hash_join(ExecContext *ctx, ExecOperator *build,
+                             ExecExpr *build_key, ExecOperator *probe,
+                             ExecExpr *probe_key) {
+  if (!build || !build_key) {
+    return NULL;
+  }
+  ExecJoinTable *table = exec_join_table_new(ctx, build, build_key);
+  ExecOperator *op =
+      table ? exec_join_new(ctx, table, probe, probe_key) : NULL;
+  if (!op) {
+    return NULL;
+  }
+  op->build = build;
+  ((JoinState *)op->state)->pending_table = table;
+  return op;
+}
+
+ExecJoinTable *exec_join_table_build(ExecContext *ctx, ExecOperator *build,
+                                     ExecExpr *build_key) {
+  if (!build || !build_key) {
+    return NULL;
+  }
+  ExecJoinTable *table = exec_join_table_new(ctx, build, build_key);
+  return table && exec_join_table_load(ctx, table, build) ? table : NULL;
+}
+
+ExecOperator *exec_hash_join_probe(ExecContext *ctx,
+                                   const ExecJoinTable *table,
+                                   ExecOperator *probe, ExecExpr *probe_key) {
+  if (!table) {
+    return NULL;
+  }
+  return exec_join_new(ctx, table, probe, probe_key);
+}
+
+ExecOperator *exec_radix_join(ExecContext *ctx, ExecOperator *build,
+                              ExecExpr *build_key, ExecOperator *probe,
+                              ExecExpr *probe_key, usize memory_budget,
+                              Scheduler *scheduler) {
+  if (!build || !build_key || !probe || !probe_key) {
+    return NULL;
+  }
+  ASSERT(!build_key->is_predicate && !probe_key->is_predicate);
+  ASSERT_MSG(build_key->type == probe_key->type,
+             "Join keys must have the same type");
+  ExecOperator *op =
+      exec_new_operator(ctx, &radix_join_ops, sizeof(RadixJoinState),
+                        probe->column_count + build->column_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = probe;
+  op->build = build;
+  memcpy(op->types, probe->types, probe->column_count * sizeof(ExecType));
+  memcpy(op->types + probe->column_count, build->types,
+         build->column_count * sizeof(ExecType));
+
+  RadixJoinState *state = (RadixJoinState *)op->state;
+  state->build_key = build_key;
+  state->probe_key = probe_key;
+  state->memory_budget = memory_budget;
+  state->scheduler = scheduler;
+  u32 build_columns = build->column_count + 1;
+  u32 probe_columns = probe->column_count + 1;
+  ExecType *build_types =
+      (ExecType *)exec_alloc(ctx, build_columns * sizeof(ExecType));
+  ExecType *probe_types =
+      (ExecType *)exec_alloc(ctx, probe_columns * sizeof(ExecType));
+  state->append_vectors = (ExecVector *)exec_alloc(
+      ctx, MAX(build_columns, probe_columns) * sizeof(ExecVector));
+  if (!build_types || !probe_types || !state->append_vectors) {
+    return NULL;
+  }
+  memcpy(build_types, build->types, build->column_count * sizeof(ExecType));
+  build_types[build->column_count] = build_key->type;
+  memcpy(probe_types, probe->types, probe->column_count * sizeof(ExecType));
+  probe_types[probe->column_count] = probe_key->type;
+  // Entries, their scratch copies and about one bucket per row.
+  state->build_row_bytes = 2 * (sizeof(u64) + sizeof(u32)) + sizeof(u32);
+  for (u32 c = 0; c < build_columns; ++c) {
+    state->build_row_bytes += exec_type_size(build_types[c]);
+  }
+
+  usize partitions = (usize)1 << EXEC_RADIX_MAX_BITS;
+  RadixTable *table = &state->table;
+  table->part_start = (u32 *)exec_alloc(ctx, (partitions + 1) * sizeof(u32));
+  table->bucket_base = (u32 *)exec_alloc(ctx, partitions * sizeof(u32));
+  table->bucket_bits = (u8 *)exec_alloc(ctx, partitions);
+  state->probe_part_start =
+      (u32 *)exec_alloc(ctx, (partitions + 1) * sizeof(u32));
+  state->probe_hashes =
+      (u64 *)exec_alloc(ctx, EXEC_RADIX_PROBE_CHUNK * sizeof(u64));
+  state->probe_entry_hashes =
+      (u64 *)exec_alloc(ctx, EXEC_RADIX_PROBE_CHUNK * sizeof(u64));
+  state->probe_entry_rows =
+      (u32 *)exec_alloc(ctx, EXEC_RADIX_PROBE_CHUNK * sizeof(u32));
+  state->probe_rows = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  state->build_rows = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  if (!table->part_start || !table->bucket_base || !table->bucket_bits ||
+      !state->probe_part_start || !state->probe_hashes ||
+      !state->probe_entry_hashes || !state->probe_entry_rows ||
+      !state->probe_rows || !state->build_rows ||
+      !exec_rows_init(ctx, &state->build, build_types, build_columns) ||
+      !exec_rows_init(ctx, &state->probe, probe_types, probe_columns) ||
+      !exec_rows_reserve(ctx, &state->probe, EXEC_RADIX_PROBE_CHUNK) ||
+      !exec_init_batch(ctx, &state->batch, op->types, op->column_count,
+                       true)) {
+    return NULL;
+  }
+  return op;
+}
+
+ExecRadixJoinStats exec_radix_join_stats(const ExecOperator *op) {
+  ASSERT(op && op->ops == &radix_join_ops);
+  return ((const RadixJoinState *)op->state)->stats;
+}
+
+ExecOperator *exec_sort(ExecContext *ctx, ExecOperator *child,
+                        const ExecSortKey *keys, u32 key_count) {
+  return exec_external_sort(ctx, child, keys, key_count, 0);
+}
+
+ExecOperator *exec_external_sort(ExecContext *ctx, ExecOperator *child,
+                                 const ExecSortKey *keys, u32 key_count,
+                                 usize memory_budget) {
+  if (!child || !keys || key_count == 0) {
+    return NULL;
+  }
+  ExecOperator *op = exec_new_operator(ctx, &sort_ops, sizeof(SortState),
+                                       child->column_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = child;
+  memcpy(op->types, child->types, child->column_count * sizeof(ExecType));
+  SortState *state = (SortState *)op->state;
+  ExecSortKey *copy =
+      (ExecSortKey *)exec_alloc(ctx, key_count * sizeof(ExecSortKey));
+  if (!copy) {
+    return NULL;
+  }
+  for (u32 k = 0; k < key_count; ++k) {
+    ASSERT(keys[k].column < child->column_count);
+    copy[k] = keys[k];
+  }
+  state->keys = copy;
+  state->key_count = key_count;
+  state->is_prefix_complete =
+      key_count == 1 && op->types[keys[0].column] != EXEC_TYPE_STRING;
+  if (memory_budget > 0) {
+    // A run row costs its columns and two entries (sorted and scratch); a
+    // merge reader its stdio buffer and a block of rows.
+    usize row_bytes = 0;
+    for (u32 c = 0; c < op->column_count; ++c) {
+      row_bytes += exec_type_size(op->types[c]);
+    }
+    state->run_rows = MAX(memory_budget / (row_bytes + 2 * sizeof(SortEntry)),
+                          (usize)EXEC_BATCH_SIZE);
+    usize reader_bytes = EXEC_SORT_IO_BYTES + EXEC_BATCH_SIZE * row_bytes;
+    state->fan_in = (u32)MIN(MAX(memory_budget / reader_bytes, (usize)2),
+                             (usize)EXEC_SORT_MAX_FAN_IN);
+  }
+  state->order = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  if (!state->order ||
+      !exec_rows_init(ctx, &state->rows, op->types, op->column_count) ||
+      !exec_init_batch(ctx, &state->batch, op->types, op->column_count,
+                       true)) {
+    return NULL;
+  }
+  return op;
+}
+
+ExecSortStats exec_sort_stats(const ExecOperator *op) {
+  ASSERT(op && op->ops == &sort_ops);
+  return ((const SortState *)op->state)->stats;
+}
+
+ExecOperator *exec_limit(ExecContext *ctx, ExecOperator *child, u64 limit,
+                         u64 offset) {
+  if (!child) {
+    return NULL;
+  }
+  ExecOperator *op = exec_new_operator(ctx, &limit_ops, sizeof(LimitState),
+                                       child->column_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = child;
+  memcpy(op->types, child->types, child->column_count * sizeof(ExecType));
+  LimitState *state = (LimitState *)op->state;
+  state->limit = limit;
+  state->offset = offset;
+  state->selection = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  return state->selection ? op : NULL;
+}
+
+ExecOperator *exec_parallel_scan(ExecContext *ctx, Scheduler *scheduler,
+                                 const ExecMorselSource *source) {
+  ASSERT(ctx && scheduler && source);
+  ExecWorkerPlan *plans = exec_parallel_plans(ctx, scheduler, source);
+  if (!plans) {
+    return NULL;
+  }
+  const ExecOperator *pipeline = plans[0].pipeline;
+  ExecOperator *op = exec_new_operator(ctx, &parallel_scan_ops,
+                                       sizeof(ParallelState),
+                                       pipeline->column_count);
+  if (!op) {
+    return NULL;
+  }
+  memcpy(op->types, pipeline->types, op->column_count * sizeof(ExecType));
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    if (!exec_rows_init(&plans[w].ctx, &plans[w].rows, op->types,
+                        op->column_count)) {
+      ctx->has_error = true;
+      return NULL;
+    }
+  }
+  ParallelState *state = (ParallelState *)op->state;
+  state->scheduler = scheduler;
+  state->table = source->table;
+  state->plans = plans;
+  return exec_init_batch(ctx, &state->batch, op->types, op->column_count,
+                         false)
+             ? op
+             : NULL;
+}
+
+ExecOperator *exec_parallel_aggregate(ExecContext *ctx, Scheduler *scheduler,
+                                      const ExecMorselSource *source,
+                                      const u32 *group_columns,
+                                      u32 group_count,
+                                      const ExecColumnAggregate *aggregates,
+                                      u32 aggregate_count) {
+  ASSERT(ctx && scheduler && source);
+  if ((group_count > 0 && !group_columns) ||
+      (aggregate_count > 0 && !aggregates)) {
+    return NULL;
+  }
+  ExecWorkerPlan *plans = exec_parallel_plans(ctx, scheduler, source);
+  if (!plans) {
+    return NULL;
+  }
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    ExecWorkerPlan *plan = &plans[w];
+    ExecContext *worker_ctx = &plan->ctx;
+    const ExecOperator *pipeline = plan->pipeline;
+    ExecExpr **groups = (ExecExpr **)exec_alloc(
+        worker_ctx, (group_count > 0 ? group_count : 1) * sizeof(ExecExpr *));
+    ExecAggregate *worker_aggregates = (ExecAggregate *)exec_zalloc(
+        worker_ctx,
+        (aggregate_count > 0 ? aggregate_count : 1) * sizeof(ExecAggregate));
+    if (!groups || !worker_aggregates) {
+      ctx->has_error = true;
+      return NULL;
+    }
+    for (u32 g = 0; g < group_count; ++g) {
+      u32 column = group_columns[g];
+      ASSERT(column < pipeline->column_count);
+      groups[g] = exec_expr_column(worker_ctx, column, pipeline->types[column]);
+    }
+    for (u32 a = 0; a < aggregate_count; ++a) {
+      u32 column = aggregates[a].column;
+      worker_aggregates[a].kind = aggregates[a].kind;
+      if (aggregates[a].kind != EXEC_AGG_COUNT_STAR) {
+        ASSERT(column < pipeline->column_count);
+        worker_aggregates[a].input =
+            exec_expr_column(worker_ctx, column, pipeline->types[column]);
+      }
+    }
+    plan->aggregate =
+        exec_hash_aggregate(worker_ctx, plan->pipeline, groups, group_count,
+                            worker_aggregates, aggregate_count);
+    if (!plan->aggregate) {
+      ctx->has_error = ctx->has_error || worker_ctx->has_error;
+      return NULL;
+    }
+  }
+
+  const ExecOperator *partial = plans[0].aggregate;
+  ExecOperator *op = exec_new_operator(ctx, &parallel_aggregate_ops,
+                                       sizeof(ParallelState),
+                                       partial->column_count);
+  if (!op) {
+    return NULL;
+  }
+  memcpy(op->types, partial->types, op->column_count * sizeof(ExecType));
+  ParallelState *state = (ParallelState *)op->state;
+  state->scheduler = scheduler;
+  state->table = source->table;
+  state->plans = plans;
+  return op;
+}
+
+const char *exec_type_name(ExecType type) {
+  switch (type) {
+  case EXEC_TYPE_INT64:
+    return "INT64";
+  case EXEC_TYPE_FLOAT64:
+    return "FLOAT64";
+  case EXEC_TYPE_STRING:
+    return "STRING";
+  }
+  return "unknown";
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static void *exec_zalloc(ExecContext *ctx, usize size) {
+  void *ptr = exec_alloc(ctx, size);
+  if (ptr) {
+    memset(ptr, 0, size);
+  }
+  return ptr;
+}
+
+static usize exec_type_size(ExecType type) {
+  switch (type) {
+  case EXEC_TYPE_INT64:
+    return sizeof(i64);
+  case EXEC_TYPE_FLOAT64:
+    return sizeof(f64);
+  case EXEC_TYPE_STRING:
+    return sizeof(StringView);
+  }
+  return 0;
+}
+
+static ExecOperator *exec_new_operator(ExecContext *ctx,
+                                       const ExecOperatorOps *ops,
+                                       usize state_size, u32 column_count) {
+  ASSERT(ctx && ops);
+  ExecOperator *op = (ExecOperator *)exec_zalloc(ctx, sizeof(ExecOperator));
+  if (!op) {
+    return NULL;
+  }
+  op->ops = ops;
+  op->ctx = ctx;
+  op->column_count = column_count;
+  op->state = exec_zalloc(ctx, state_size);
+  op->types = (ExecType *)exec_alloc(ctx, column_count * sizeof(ExecType));
+  return op->state && op->types ? op : NULL;
+}
+
+// Operators that compute or gather their output own one vector of
+// EXEC_BATCH_SIZE values per column; the others point theirs at input data.
+static bool exec_init_batch(ExecContext *ctx, ExecBatch *batch,
+                            const ExecType *types, u32 column_count,
+                            bool owns_vectors) {
+  ZERO_STRUCT(*batch);
+  batch->columns =
+      (ExecVector *)exec_zalloc(ctx, column_count * sizeof(ExecVector));
+  if (!batch->columns) {
+    return false;
+  }
+  batch->column_count = column_count;
+  for (u32 c = 0; c < column_count; ++c) {
+    batch->columns[c].type = types[c];
+    if (owns_vectors) {
+      batch->columns[c].i64s = (i64 *)exec_alloc(
+          ctx, EXEC_BATCH_SIZE * exec_type_size(types[c]));
+      if (!batch->columns[c].i64s) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// --- Expressions ---
+
+static ExecExpr *exec_new_expr(ExecContext *ctx, ExecExprKind kind,
+                               ExecType type) {
+  ExecExpr *expr = (ExecExpr *)exec_zalloc(ctx, sizeof(ExecExpr));
+  if (!expr) {
+    return NULL;
+  }
+  expr->kind = kind;
+  expr->type = type;
+  expr->result.type = type;
+  if (kind != EXEC_EXPR_COLUMN) {
+    expr->result.i64s =
+        (i64 *)exec_alloc(ctx, EXEC_BATCH_SIZE * exec_type_size(type));
+    if (!expr->result.i64s) {
+      return NULL;
+    }
+  }
+  return expr;
+}
+
+static ExecExpr *exec_expr_cast(ExecContext *ctx, ExecExpr *operand) {
+  ASSERT(operand->type == EXEC_TYPE_INT64);
+  if (operand->kind == EXEC_EXPR_CONSTANT) {
+    return exec_expr_constant(
+        ctx, (SqlValue){.kind = SQL_VALUE_FLOAT,
+                        .real = (f64)operand->constant.integer});
+  }
+  ExecExpr *expr = exec_new_expr(ctx, EXEC_EXPR_CAST, EXEC_TYPE_FLOAT64);
+  if (expr) {
+    expr->operand = operand;
+  }
+  return expr;
+}
+
+// Promotes an INT64 side to FLOAT64 when the other side is FLOAT64.
+static bool exec_unify_types(ExecContext *ctx, ExecExpr **left,
+                             ExecExpr **right) {
+  ASSERT(!(*left)->is_predicate && !(*right)->is_predicate);
+  if ((*left)->type == (*right)->type) {
+    return true;
+  }
+  ASSERT_MSG((*left)->type != EXEC_TYPE_STRING &&
+                 (*right)->type != EXEC_TYPE_STRING,
+             "Strings only compare with strings");
+  ExecExpr **side = (*left)->type == EXEC_TYPE_INT64 ? left : right;
+  *side = exec_expr_cast(ctx, *side);
+  return *side != NULL;
+}
+
+// Computes 'expr' for the active rows of 'batch'. Results are indexed by row,
+// like the input columns, so the batch's selection still applies to them.
+static const ExecVector *exec_eval(ExecContext *ctx, ExecExpr *expr,
+                                   const ExecBatch *batch) {
+  switch (expr->kind) {
+  case EXEC_EXPR_COLUMN:
+    ASSERT(expr->column < batch->column_count);
+    ASSERT(batch->columns[expr->column].type == expr->type);
+    return &batch->columns[expr->column];
+  case EXEC_EXPR_CONSTANT:
+    return &expr->result;
+  case EXEC_EXPR_CAST: {
+    const i64 *src = exec_eval(ctx, expr->operand, batch)->i64s;
+    f64 *dst = expr->result.f64s;
+    EXEC_FOR_EACH_ROW(batch, row, dst[row] = (f64)src[row]);
+    return &expr->result;
+  }
+  case EXEC_EXPR_ARITHMETIC:
+    exec_eval_arithmetic(ctx, expr, exec_eval(ctx, expr->binary.left, batch),
+                         exec_eval(ctx, expr->binary.right, batch), batch);
+    return &expr->result;
+  default:
+    ASSERT_MSG(false, "Predicates have no value");
+    return &expr->result;
+  }
+}
+
+// Integer arithmetic wraps instead of overflowing; division by zero fails the
+// query.
+static void exec_eval_arithmetic(ExecContext *ctx, ExecExpr *expr,
+                                 const ExecVector *l, const ExecVector *r,
+                                 const ExecBatch *batch) {
+  if (expr->type == EXEC_TYPE_FLOAT64) {
+    const f64 *a = l->f64s;
+    const f64 *b = r->f64s;
+    f64 *out = expr->result.f64s;
+    switch (expr->binary.op) {
+    case AST_OP_ADD:
+      EXEC_FOR_EACH_ROW(batch, row, out[row] = a[row] + b[row]);
+      break;
+    case AST_OP_SUBTRACT:
+      EXEC_FOR_EACH_ROW(batch, row, out[row] = a[row] - b[row]);
+      break;
+    case AST_OP_MULTIPLY:
+      EXEC_FOR_EACH_ROW(batch, row, out[row] = a[row] * b[row]);
+      break;
+    case AST_OP_DIVIDE:
+      EXEC_FOR_EACH_ROW(batch, row, out[row] = a[row] / b[row]);
+      break;
+    default:
+      EXEC_FOR_EACH_ROW(batch, row, out[row] = fmod(a[row], b[row]));
+      break;
+    }
+    return;
+  }
+
+  const i64 *a = l->i64s;
+  const i64 *b = r->i64s;
+  i64 *out = expr->result.i64s;
+  switch (expr->binary.op) {
+  case AST_OP_ADD:
+    EXEC_FOR_EACH_ROW(batch, row,
+                      out[row] = (i64)((u64)a[row] + (u64)b[row]));
+    break;
+  case AST_OP_SUBTRACT:
+    EXEC_FOR_EACH_ROW(batch, row,
+                      out[row] = (i64)((u64)a[row] - (u64)b[row]));
+    break;
+  case AST_OP_MULTIPLY:
+    EXEC_FOR_EACH_ROW(batch, row,
+                      out[row] = (i64)((u64)a[row] * (u64)b[row]));
+    break;
+  default: {
+    bool is_divide = expr->binary.op == AST_OP_DIVIDE;
+    bool divided_by_zero = false;
+    EXEC_FOR_EACH_ROW(batch, row, {
+      i64 divisor = b[row];
+      if (divisor == 0) {
+        divided_by_zero = true;
+        out[row] = 0;
+      } else if (divisor == -1) { // INT64_MIN / -1 overflows
+        out[row] = is_divide ? (i64)(0 - (u64)a[row]) : 0;
+      } else {
+        out[row] = is_divide ? a[row] / divisor : a[row] % divisor;
+      }
+    });
+    if (divided_by_zero && !ctx->has_error) {
+      LOG_ERROR("Division by zero");
+      ctx->has_error = true;
+    }
+    break;
+  }
+  }
+}
+
+// Writes the rows of 'in' (or 0..in_count-1 if NULL) that satisfy
+// 'predicate' to 'out', which may alias 'in'. Returns their number.
+static u32 exec_select(ExecContext *ctx, ExecExpr *predicate,
+                       const ExecBatch *batch, const u32 *in, u32 in_count,
+                       u32 *out) {
+  switch (predicate->kind) {
+  case EXEC_EXPR_COMPARE:
+    return exec_select_compare(ctx, predicate, batch, in, in_count, out);
+  case EXEC_EXPR_AND: {
+    u32 count =
+        exec_select(ctx, predicate->binary.left, batch, in, in_count, out);
+    return count > 0 ? exec_select(ctx, predicate->binary.right, batch, out,
+                                   count, out)
+                     : 0;
+  }
+  case EXEC_EXPR_OR: {
+    // Both sides select from the same input; merging the two sorted results
+    // keeps the output sorted and free of duplicates.
+    u32 *a = predicate->scratch;
+    u32 *b = predicate->scratch + EXEC_BATCH_SIZE;
+    u32 a_count =
+        exec_select(ctx, predicate->binary.left, batch, in, in_count, a);
+    u32 b_count =
+        exec_select(ctx, predicate->binary.right, batch, in, in_count, b);
+    u32 i = 0, j = 0, count = 0;
+    while (i < a_count && j < b_count) {
+      u32 next = MIN(a[i], b[j]);
+      i += a[i] == next ? 1u : 0u;
+      j += b[j] == next ? 1u : 0u;
+      out[count++] = next;
+    }
+    while (i < a_count) {
+      out[count++] = a[i++];
+    }
+    while (j < b_count) {
+      out[count++] = b[j++];
+    }
+    return count;
+  }
+  default:
+    ASSERT_MSG(false, "Not a predicate");
+    return 0;
+  }
+}
+
+// The row index is written unconditionally and the output position only
+// advances on a match, so the loops have no data-dependent branch.
+#define EXEC_SELECT_ROWS(cond)                                                 \
+  do {                                                                         \
+    u32 n_ = 0;                                                                \
+    if (in) {                                                                  \
+      for (u32 i_ = 0; i_ < in_count; ++i_) {                                  \
+        u32 row = in[i_];                                                      \
+        out[n_] = row;                                                         \
+        n_ += (cond) ? 1u : 0u;                                                \
+      }                                                                        \
+    } else {                                                                   \
+      for (u32 row = 0; row < in_count; ++row) {                               \
+        out[n_] = row;                                                         \
+        n_ += (cond) ? 1u : 0u;                                                \
+      }                                                                        \
+    }                                                                          \
+    return n_;                                                                 \
+  } while (0)
+
+#define EXEC_SELECT_COMPARE(lhs, rhs)                                          \
+  switch (op) {                                                                \
+  case AST_OP_EQUAL:                                                           \
+    EXEC_SELECT_ROWS((lhs) == (rhs));                                          \
+  case AST_OP_NOT_EQUAL:                                                       \
+    EXEC_SELECT_ROWS((lhs) != (rhs));                                          \
+  case AST_OP_LESS:                                                            \
+    EXEC_SELECT_ROWS((lhs) < (rhs));                                           \
+  case AST_OP_LESS_EQUAL:                                                      \
+    EXEC_SELECT_ROWS((lhs) <= (rhs));                                          \
+  case AST_OP_GREATER:                                                         \
+    EXEC_SELECT_ROWS((lhs) > (rhs));                                           \
+  default:                                                                     \
+    EXEC_SELECT_ROWS((lhs) >= (rhs));                                          \
+  }
+
+static u32 exec_select_compare(ExecContext *ctx, ExecExpr *predicate,
+                               const ExecBatch *batch, const u32 *in,
+                               u32 in_count, u32 *out) {
+  AstOperator op = predicate->binary.op;
+  ExecExpr *right = predicate->binary.right;
+  const ExecVector *l = exec_eval(ctx, predicate->binary.left, batch);
+
+  if (right->kind == EXEC_EXPR_CONSTANT) {
+    switch (l->type) {
+    case EXEC_TYPE_INT64: {
+      const i64 *a = l->i64s;
+      i64 c = right->constant.integer;
+      EXEC_SELECT_COMPARE(a[row], c);
+    }
+    case EXEC_TYPE_FLOAT64: {
+      const f64 *a = l->f64s;
+      f64 c = right->constant.real;
+      EXEC_SELECT_COMPARE(a[row], c);
+    }
+    case EXEC_TYPE_STRING: {
+      const StringView *a = l->strings;
+      StringView c = right->constant.string;
+      EXEC_SELECT_ROWS(exec_compare_holds(op, sv_compare(a[row], c)));
+    }
+    }
+  }
+
+  const ExecVector *r = exec_eval(ctx, right, batch);
+  switch (l->type) {
+  case EXEC_TYPE_INT64: {
+    const i64 *a = l->i64s;
+    const i64 *b = r->i64s;
+    EXEC_SELECT_COMPARE(a[row], b[row]);
+  }
+  case EXEC_TYPE_FLOAT64: {
+    const f64 *a = l->f64s;
+    const f64 *b = r->f64s;
+    EXEC_SELECT_COMPARE(a[row], b[row]);
+  }
+  case EXEC_TYPE_STRING: {
+    const StringView *a = l->strings;
+    const StringView *b = r->strings;
+    EXEC_SELECT_ROWS(exec_compare_holds(op, sv_compare(a[row], b[row])));
+  }
+  }
+  return 0;
+}
+
+static bool exec_compare_holds(AstOperator op, int cmp) {
+  switch (op) {
+  case AST_OP_EQUAL:
+    return cmp == 0;
+  case AST_OP_NOT_EQUAL:
+    return cmp != 0;
+  case AST_OP_LESS:
+    return cmp < 0;
+  case AST_OP_LESS_EQUAL:
+    return cmp <= 0;
+  case AST_OP_GREATER:
+    return cmp > 0;
+  default:
+    return cmp >= 0;
+  }
+}
+
+// 'a op b' is 'b mirror(op) a'.
+static AstOperator exec_mirror_compare(AstOperator op) {
+  switch (op) {
+  case AST_OP_LESS:
+    return AST_OP_GREATER;
+  case AST_OP_LESS_EQUAL:
+    return AST_OP_GREATER_EQUAL;
+  case AST_OP_GREATER:
+    return AST_OP_LESS;
+  case AST_OP_GREATER_EQUAL:
+    return AST_OP_LESS_EQUAL;
+  default:
+    return op;
+  }
+}
+
+// --- Materialized rows ---
+
+static bool exec_rows_init(ExecContext *ctx, ExecRows *rows,
+                           const ExecType *types, u32 column_count) {
+  ZERO_STRUCT(*rows);
+  rows->columns =
+      (ExecVector *)exec_zalloc(ctx, column_count * sizeof(ExecVector));
+  if (!rows->columns) {
+    return false;
+  }
+  rows->column_count = column_count;
+  for (u32 c = 0; c < column_count; ++c) {
+    rows->columns[c].type = types[c];
+  }
+  return true;
+}
+
+static bool exec_rows_reserve(ExecContext *ctx, ExecRows *rows, usize needed) {
+  if (needed <= rows->capacity) {
+    return true;
+  }
+  if (needed > UINT32_MAX) {
+    LOG_ERROR("Operator input exceeds %u rows", UINT32_MAX);
+    ctx->has_error = true;
+    return false;
+  }
+  usize capacity = MAX(MAX(needed, rows->capacity * 2), EXEC_BATCH_SIZE);
+  for (u32 c = 0; c < rows->column_count; ++c) {
+    ExecVector *column = &rows->columns[c];
+    usize size = exec_type_size(column->type);
+    void *data = exec_alloc(ctx, capacity * size);
+    if (!data) {
+      return false;
+    }
+    if (rows->count > 0) {
+      memcpy(data, column->i64s, rows->count * size);
+    }
+    column->i64s = (i64 *)data;
+  }
+  rows->capacity = capacity;
+  return true;
+}
+
+// Appends the active rows of 'batch', taking column c from vectors[c].
+static bool exec_rows_append(ExecContext *ctx, ExecRows *rows,
+                             const ExecVector *vectors,
+                             const ExecBatch *batch) {
+  if (!exec_rows_reserve(ctx, rows, rows->count + batch->selected_count)) {
+    return false;
+  }
+  for (u32 c = 0; c < rows->column_count; ++c) {
+    ExecVector dst = rows->columns[c];
+    const ExecVector *src = &vectors[c];
+    ASSERT(dst.type == src->type);
+    usize size = exec_type_size(dst.type);
+    u8 *out = (u8 *)dst.i64s + rows->count * size;
+    if (!batch->selection) {
+      memcpy(out, src->i64s, batch->row_count * size);
+      continue;
+    }
+    ExecVector tail = {.type = dst.type, .i64s = (i64 *)out};
+    exec_gather(&tail, src, batch->selection, batch->selected_count);
+  }
+  rows->count += batch->selected_count;
+  return true;
+}
+
+static void exec_gather(ExecVector *dst, const ExecVector *src,
+                        const u32 *rows, u32 count) {
+  switch (src->type) {
+  case EXEC_TYPE_INT64:
+    for (u32 i = 0; i < count; ++i) {
+      dst->i64s[i] = src->i64s[rows[i]];
+    }
+    break;
+  case EXEC_TYPE_FLOAT64:
+    for (u32 i = 0; i < count; ++i) {
+      dst->f64s[i] = src->f64s[rows[i]];
+    }
+    break;
+  case EXEC_TYPE_STRING:
+    for (u32 i = 0; i < count; ++i) {
+      dst->strings[i] = src->strings[rows[i]];
+    }
+    break;
+  }
+}
+
+// Writes one row to a temp file: numbers as 8 bytes, strings as a u32
+// length and their bytes.
+static bool exec_rows_write(FILE *file, const ExecRows *rows, usize row) {
+  for (u32 c = 0; c < rows->column_count; ++c) {
+    const ExecVector *column = &rows->columns[c];
+    if (column->type != EXEC_TYPE_STRING) {
+      if (fwrite(&column->i64s[row], sizeof(i64), 1, file) != 1) {
+        return false;
+      }
+      continue;
+    }
+    StringView value = column->strings[row];
+    ASSERT(value.length <= UINT32_MAX);
+    u32 length = (u32)value.length;
+    if (fwrite(&length, sizeof(length), 1, file) != 1 ||
+        fwrite(value.data, 1, length, file) != length) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// --- Hashing ---
+
+static u64 exec_hash_i64(u64 x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Floats hash and compare by bit pattern, which is exact for keys that were
+// produced the same way.
+static u64 exec_hash_value(const ExecVector *vector, usize row) {
+  switch (vector->type) {
+  case EXEC_TYPE_INT64:
+    return exec_hash_i64((u64)vector->i64s[row]);
+  case EXEC_TYPE_FLOAT64: {
+    u64 bits;
+    memcpy(&bits, &vector->f64s[row], sizeof(bits));
+    return exec_hash_i64(bits);
+  }
+  case EXEC_TYPE_STRING:
+    return base_hash_bytes(vector->strings[row].data,
+                           vector->strings[row].length);
+  }
+  return 0;
+}
+
+static bool exec_values_equal(const ExecVector *a, usize a_row,
+                              const ExecVector *b, usize b_row) {
+  switch (a->type) {
+  case EXEC_TYPE_INT64:
+    return a->i64s[a_row] == b->i64s[b_row];
+  case EXEC_TYPE_FLOAT64:
+    return memcmp(&a->f64s[a_row], &b->f64s[b_row], sizeof(f64)) == 0;
+  case EXEC_TYPE_STRING:
+    return sv_equals(a->strings[a_row], b->strings[b_row]);
+  }
+  return false;
+}
+
+// --- Scan, filter, project ---
+
+// A scan over the morsels 'worker' takes of the source table; it ends once
+// the job running it has no morsels left.
+static ExecOperator *exec_morsel_scan(ExecContext *ctx,
+                                      const ExecMorselSource *source,
+                                      SchedWorker *worker) {
+  ExecOperator *op = exec_scan(ctx, source->table, source->columns,
+                               source->column_count);
+  if (!op) {
+    return NULL;
+  }
+  ScanState *state = (ScanState *)op->state;
+  state->end = 0;
+  state->worker = worker;
+  return op;
+}
+
+static ExecBatch *exec_scan_next(ExecOperator *op) {
+  ScanState *state = (ScanState *)op->state;
+  const ExecTable *table = state->table;
+  if (state->position >= state->end) {
+    SchedMorsel morsel;
+    if (!state->worker || !sched_next_morsel(state->worker, &morsel)) {
+      return NULL;
+    }
+    state->position = morsel.begin;
+    state->end = MIN(morsel.end, table->row_count);
+  }
+  u32 count =
+      (u32)MIN((usize)EXEC_BATCH_SIZE, state->end - state->position);
+  ExecBatch *batch = &state->batch;
+  for (u32 c = 0; c < op->column_count; ++c) {
+    const ExecVector *src = &table->columns[state->columns[c]];
+    usize size = exec_type_size(src->type);
+    batch->columns[c].i64s =
+        (i64 *)((u8 *)src->i64s + state->position * size);
+  }
+  batch->row_count = count;
+  batch->selection = NULL;
+  batch->selected_count = count;
+  state->position += count;
+  return batch;
+}
+
+static ExecBatch *exec_filter_next(ExecOperator *op) {
+  FilterState *state = (FilterState *)op->state;
+  ExecBatch *input;
+  while ((input = exec_next(op->child)) != NULL) {
+    u32 count = exec_select(op->ctx, state->predicate, input, input->selection,
+                            input->selected_count, state->selection);
+    if (op->ctx->has_error) {
+      return NULL;
+    }
+    if (count > 0) {
+      state->batch = *input;
+      state->batch.selection = state->selection;
+      state->batch.selected_count = count;
+      return &state->batch;
+    }
+  }
+  return NULL;
+}
+
+static ExecBatch *exec_project_next(ExecOperator *op) {
+  ProjectState *state = (ProjectState *)op->state;
+  ExecBatch *input = exec_next(op->child);
+  if (!input) {
+    return NULL;
+  }
+  ExecBatch *batch = &state->batch;
+  for (u32 i = 0; i < state->expr_count; ++i) {
+    batch->columns[i] = *exec_eval(op->ctx, state->exprs[i], input);
+  }
+  batch->row_count = input->row_count;
+  batch->selection = input->selection;
+  batch->selected_count = input->selected_count;
+  return batch;
+}
+
+// --- Column scan ---
+
+// Decodes the predicate columns of the next batch first and the other columns
+// only if some row matched, so a selective predicate skips most decoding.
+static ExecBatch *exec_column_scan_next(ExecOperator *op) {
+  ColumnScanState *state = (ColumnScanState *)op->state;
+  ExecBatch *batch = &state->batch;
+  for (;;) {
+    if (state->rows_left == 0 && !exec_column_scan_open_group(op)) {
+      return NULL;
+    }
+    u32 count = MIN((u32)EXEC_BATCH_SIZE, state->rows_left);
+    state->rows_left -= count;
+    batch->row_count = count;
+    batch->selection = NULL;
+    batch->selected_count = count;
+
+    u32 selected = count;
+    if (state->predicate) {
+      bool has_nulls = false;
+      for (u32 c = 0; c < op->column_count; ++c) {
+        ColumnReader *reader = &state->readers[c];
+        if (!state->is_predicate_column[c]) {
+          continue;
+        }
+        if (reader->nulls && !has_nulls) {
+          memset(state->nulls, 0, count * sizeof(bool));
+          has_nulls = true;
+        }
+        column_reader_read(reader, count, batch->columns[c].i64s,
+                           reader->nulls ? state->nulls : NULL);
+      }
+      const u32 *in = NULL;
+      u32 in_count = count;
+      if (has_nulls) {
+        in_count = 0;
+        for (u32 row = 0; row < count; ++row) {
+          state->candidates[in_count] = row;
+          in_count += state->nulls[row] ? 0u : 1u;
+        }
+        in = state->candidates;
+      }
+      selected = in_count > 0
+                     ? exec_select(op->ctx, state->predicate, batch, in,
+                                   in_count, state->selection)
+                     : 0;
+      if (op->ctx->has_error) {
+        return NULL;
+      }
+      batch->selection = state->selection;
+      batch->selected_count = selected;
+    }
+
+    for (u32 c = 0; c < op->column_count; ++c) {
+      if (state->predicate && state->is_predicate_column[c]) {
+        continue;
+      }
+      if (selected > 0) {
+        column_reader_read(&state->readers[c], count, batch->columns[c].i64s,
+                           NULL);
+      } else {
+        column_reader_skip(&state->readers[c], count);
+      }
+    }
+    state->stats.rows_scanned += count;
+    if (selected > 0) {
+      return batch;
+    }
+  }
+}
+
+// Opens the readers on the next row group the zone maps do not rule out.
+// Returns false once there is none left or a chunk cannot be read.
+static bool exec_column_scan_open_group(ExecOperator *op) {
+  ColumnScanState *state = (ColumnScanState *)op->state;
+  const ColumnTable *table = state->table;
+  while (state->next_group < table->group_count) {
+    u32 g = state->next_group++;
+    const ColumnRowGroup *group = &table->groups[g];
+    state->stats.row_groups++;
+    if (state->predicate &&
+        !exec_zone_may_match(state->predicate, group, state->columns)) {
+      state->stats.row_groups_skipped++;
+      continue;
+    }
+    for (u32 c = 0; c < op->column_count; ++c) {
+      const ColumnChunkInfo *chunk = &group->chunks[state->columns[c]];
+      u8 *buffer;
+      if (op->types[c] == EXEC_TYPE_STRING) {
+        // Strings point into the chunk, so each one gets its own copy.
+        buffer = (u8 *)exec_alloc(op->ctx, chunk->byte_length);
+      } else {
+        if (chunk->byte_length > state->buffer_sizes[c]) {
+          state->buffers[c] = (u8 *)exec_alloc(op->ctx, chunk->byte_length);
+          state->buffer_sizes[c] = state->buffers[c] ? chunk->byte_length : 0;
+        }
+        buffer = state->buffers[c];
+      }
+      if (!buffer) {
+        return false;
+      }
+      if (!column_reader_open(&state->readers[c], table, g,
+                              state->columns[c], buffer)) {
+        op->ctx->has_error = true;
+        return false;
+      }
+    }
+    state->rows_left = group->row_count;
+    return true;
+  }
+  return false;
+}
+
+// False only if no row of 'group' can satisfy 'predicate'. Comparisons of a
+// column with a constant are checked against the column's zone map; anything
+// else may match.
+static bool exec_zone_may_match(const ExecExpr *predicate,
+                                const ColumnRowGroup *group,
+                                const u32 *columns) {
+  switch (predicate->kind) {
+  case EXEC_EXPR_AND:
+    return exec_zone_may_match(predicate->binary.left, group, columns) &&
+           exec_zone_may_match(predicate->binary.right, group, columns);
+  case EXEC_EXPR_OR:
+    return exec_zone_may_match(predicate->binary.left, group, columns) ||
+           exec_zone_may_match(predicate->binary.right, group, columns);
+  case EXEC_EXPR_COMPARE:
+    return exec_zone_may_compare(predicate, group, columns);
+  default:
+    return true;
+  }
+}
+
+static bool exec_zone_may_compare(const ExecExpr *compare,
+                                  const ColumnRowGroup *group,
+                                  const u32 *columns) {
+  const ExecExpr *left = compare->binary.left;
+  const ExecExpr *right = compare->binary.right;
+  ExecType type = left->type; // Both sides have it after unification
+  if (left->kind == EXEC_EXPR_CAST) {
+    left = left->operand;
+  }
+  if (right->kind == EXEC_EXPR_CAST) {
+    right = right->operand;
+  }
+  if (left->kind != EXEC_EXPR_COLUMN || right->kind != EXEC_EXPR_CONSTANT) {
+    return true;
+  }
+  const ColumnZoneMap *zone = &group->chunks[columns[left->column]].zone;
+  if (zone->null_count == group->row_count) {
+    return false; // NULL never matches
+  }
+  if (!zone->has_bounds) {
+    return true;
+  }
+
+  // Order of the bounds relative to the constant; a missing maximum is
+  // treated as larger than anything.
+  int cmp_min = 0;
+  int cmp_max = 1;
+  const SqlValue *constant = &right->constant;
+  switch (type) {
+  case EXEC_TYPE_INT64: {
+    i64 c = constant->integer;
+    cmp_min = (zone->min.i64 > c) - (zone->min.i64 < c);
+    cmp_max = (zone->max.i64 > c) - (zone->max.i64 < c);
+    break;
+  }
+  case EXEC_TYPE_FLOAT64: {
+    bool is_int_column = left->type == EXEC_TYPE_INT64;
+    f64 min = is_int_column ? (f64)zone->min.i64 : zone->min.f64;
+    f64 max = is_int_column ? (f64)zone->max.i64 : zone->max.f64;
+    f64 c = constant->kind == SQL_VALUE_INTEGER ? (f64)constant->integer
+                                                : constant->real;
+    if (isnan(c)) {
+      return true;
+    }
+    cmp_min = (min > c) - (min < c);
+    cmp_max = (max > c) - (max < c);
+    break;
+  }
+  case EXEC_TYPE_STRING:
+    cmp_min = sv_compare(sv_from_parts(zone->min.string.bytes,
+                                       zone->min.string.length),
+                         constant->string);
+    if (zone->has_max) {
+      cmp_max = sv_compare(sv_from_parts(zone->max.string.bytes,
+                                         zone->max.string.length),
+                           constant->string);
+    }
+    break;
+  }
+
+  switch (compare->binary.op) {
+  case AST_OP_EQUAL:
+    return cmp_min <= 0 && cmp_max >= 0;
+  case AST_OP_NOT_EQUAL:
+    return cmp_min != 0 || cmp_max != 0;
+  case AST_OP_LESS:
+    return cmp_min < 0;
+  case AST_OP_LESS_EQUAL:
+    return cmp_min <= 0;
+  case AST_OP_GREATER:
+    return cmp_max > 0;
+  case AST_OP_GREATER_EQUAL:
+    return cmp_max >= 0;
+  default:
+    return true;
+  }
+}
+
+// Sets is_used[c] for every input column 'expr' reads.
+static void exec_mark_columns(const ExecExpr *expr, bool *is_used) {
+  switch (expr->kind) {
+  case EXEC_EXPR_COLUMN:
+    is_used[expr->column] = true;
+    break;
+  case EXEC_EXPR_CONSTANT:
+    break;
+  case EXEC_EXPR_CAST:
+    exec_mark_columns(expr->operand, is_used);
+    break;
+  case EXEC_EXPR_ARITHMETIC:
+  case EXEC_EXPR_COMPARE:
+  case EXEC_EXPR_AND:
+  case EXEC_EXPR_OR:
+    exec_mark_columns(expr->binary.left, is_used);
+    exec_mark_columns(expr->binary.right, is_used);
+    break;
+  }
+}
+
+static ExecType exec_column_type(ColumnType type) {
+  switch (type) {
+  case COLUMN_TYPE_INT64:
+    return EXEC_TYPE_INT64;
+  case COLUMN_TYPE_FLOAT64:
+    return EXEC_TYPE_FLOAT64;
+  case COLUMN_TYPE_STRING:
+    return EXEC_TYPE_STRING;
+  }
+  return EXEC_TYPE_INT64;
+}
+
+// --- Hash aggregate ---
+
+static ExecBatch *exec_aggregate_next(ExecOperator *op) {
+  AggregateState *state = (AggregateState *)op->state;
+  if (!state->is_built && !exec_aggregate_build(op)) {
+    return NULL;
+  }
+  ExecRows *groups = &state->groups;
+  if (state->position >= groups->count) {
+    return NULL;
+  }
+  u32 count =
+      (u32)MIN((usize)EXEC_BATCH_SIZE, groups->count - state->position);
+  // Skip the hash column: output is the keys, then the aggregates.
+  for (u32 c = 0; c < op->column_count; ++c) {
+    u32 column = c < state->key_count ? c : c + 1;
+    usize size = exec_type_size(groups->columns[column].type);
+    state->batch.columns[c].i64s =
+        (i64 *)((u8 *)groups->columns[column].i64s + state->position * size);
+  }
+  state->batch.row_count = count;
+  state->batch.selection = NULL;
+  state->batch.selected_count = count;
+  state->position += count;
+  return &state->batch;
+}
+
+static bool exec_aggregate_build(ExecOperator *op) {
+  if (!exec_aggregate_drain(op)) {
+    return false;
+  }
+  exec_aggregate_finish((AggregateState *)op->state);
+  return true;
+}
+
+// Folds the whole input into the groups, leaving AVG columns as sums.
+static bool exec_aggregate_drain(ExecOperator *op) {
+  ExecBatch *input;
+  while ((input = exec_next(op->child)) != NULL) {
+    if (!exec_aggregate_consume(op, input)) {
+      return false;
+    }
+  }
+  return !op->ctx->has_error;
+}
+
+// Turns the AVG sums into averages; the groups are then ready to output.
+static void exec_aggregate_finish(AggregateState *state) {
+  for (u32 a = 0; a < state->aggregate_count; ++a) {
+    if (state->aggregates[a].kind != EXEC_AGG_AVG) {
+      continue;
+    }
+    ExecVector *avg = &state->groups.columns[state->key_count + 1 + a];
+    const i64 *counts = state->groups.columns[state->avg_columns[a]].i64s;
+    for (usize g = 0; g < state->groups.count; ++g) {
+      avg->f64s[g] = counts[g] > 0 ? avg->f64s[g] / (f64)counts[g] : 0.0;
+    }
+  }
+  state->is_built = true;
+}
+
+// Maps every active row to its group (hashing all rows first, then probing),
+// then runs one tight update loop per aggregate.
+static bool exec_aggregate_consume(ExecOperator *op, const ExecBatch *batch) {
+  AggregateState *state = (AggregateState *)op->state;
+  ExecContext *ctx = op->ctx;
+  u32 count = batch->selected_count;
+  u32 *group_ids = state->group_ids;
+
+  if (state->key_count > 0) {
+    const ExecVector **keys = state->key_vectors;
+    for (u32 k = 0; k < state->key_count; ++k) {
+      keys[k] = exec_eval(ctx, state->keys[k], batch);
+    }
+    u64 *hashes = state->hashes;
+    for (u32 i = 0; i < count; ++i) {
+      u32 row = exec_batch_row(batch, i);
+      u64 hash = 0;
+      for (u32 k = 0; k < state->key_count; ++k) {
+        hash = (hash ^ exec_hash_value(keys[k], row)) * 0x9E3779B97F4A7C15ULL;
+      }
+      hashes[i] = hash;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+      if (!exec_aggregate_find_group(ctx, state, keys,
+                                     exec_batch_row(batch, i), hashes[i],
+                                     &group_ids[i])) {
+        return false;
+      }
+    }
+  }
+
+  for (u32 a = 0; a < state->aggregate_count; ++a) {
+    const ExecAggregate *aggregate = &state->aggregates[a];
+    ExecVector *acc = &state->groups.columns[state->key_count + 1 + a];
+    if (aggregate->kind == EXEC_AGG_COUNT_STAR ||
+        aggregate->kind == EXEC_AGG_COUNT) {
+      for (u32 i = 0; i < count; ++i) {
+        acc->i64s[group_ids[i]]++;
+      }
+      continue;
+    }
+
+    const ExecVector *input = exec_eval(ctx, aggregate->input, batch);
+    if (aggregate->kind == EXEC_AGG_AVG) {
+      i64 *counts = state->groups.columns[state->avg_columns[a]].i64s;
+      for (u32 i = 0; i < count; ++i) {
+        counts[group_ids[i]]++;
+      }
+    }
+    if (input->type == EXEC_TYPE_INT64) {
+      const i64 *v = input->i64s;
+      i64 *out = acc->i64s;
+      for (u32 i = 0; i < count; ++i) {
+        u32 row = exec_batch_row(batch, i);
+        u32 g = group_ids[i];
+        switch (aggregate->kind) {
+        case EXEC_AGG_SUM:
+          out[g] = (i64)((u64)out[g] + (u64)v[row]);
+          break;
+        case EXEC_AGG_MIN:
+          out[g] = MIN(out[g], v[row]);
+          break;
+        default:
+          out[g] = MAX(out[g], v[row]);
+          break;
+        }
+      }
+    } else {
+      const f64 *v = input->f64s;
+      f64 *out = acc->f64s;
+      for (u32 i = 0; i < count; ++i) {
+        u32 row = exec_batch_row(batch, i);
+        u32 g = group_ids[i];
+        switch (aggregate->kind) {
+        case EXEC_AGG_MIN:
+          out[g] = MIN(out[g], v[row]);
+          break;
+        case EXEC_AGG_MAX:
+          out[g] = MAX(out[g], v[row]);
+          break;
+        default: // SUM, AVG
+          out[g] += v[row];
+          break;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Looks up the group of the key values of 'row', adding it if it is new.
+static bool exec_aggregate_find_group(ExecContext *ctx, AggregateState *state,
+                                      const ExecVector *const *keys, u32 row,
+                                      u64 hash, u32 *out_group) {
+  ExecRows *groups = &state->groups;
+  usize slot = (usize)hash & state->slot_mask;
+  for (;;) {
+    u32 entry = state->slots[slot];
+    if (entry == 0) {
+      if (!exec_aggregate_new_group(ctx, state, keys, row, hash, out_group)) {
+        return false;
+      }
+      state->slots[slot] = *out_group + 1;
+      return groups->count * 2 <= state->slot_mask + 1 ||
+             exec_aggregate_grow_slots(ctx, state);
+    }
+    u32 group = entry - 1;
+    if ((u64)groups->columns[state->key_count].i64s[group] == hash) {
+      bool is_equal = true;
+      for (u32 k = 0; k < state->key_count && is_equal; ++k) {
+        is_equal = exec_values_equal(&groups->columns[k], group, keys[k], row);
+      }
+      if (is_equal) {
+        *out_group = group;
+        return true;
+      }
+    }
+    slot = (slot + 1) & state->slot_mask;
+  }
+}
+
+// Appends a group with the key values of 'row' and identity accumulators.
+// Group strings are copied, as the input they point to may not outlive the
+// next batch.
+static bool exec_aggregate_new_group(ExecContext *ctx, AggregateState *state,
+                                     const ExecVector *const *keys, u32 row,
+                                     u64 hash, u32 *out_group) {
+  ExecRows *groups = &state->groups;
+  if (!exec_rows_reserve(ctx, groups, groups->count + 1)) {
+    return false;
+  }
+  usize g = groups->count;
+  for (u32 k = 0; k < state->key_count; ++k) {
+    ExecVector *dst = &groups->columns[k];
+    switch (dst->type) {
+    case EXEC_TYPE_INT64:
+      dst->i64s[g] = keys[k]->i64s[row];
+      break;
+    case EXEC_TYPE_FLOAT64:
+      dst->f64s[g] = keys[k]->f64s[row];
+      break;
+    case EXEC_TYPE_STRING: {
+      StringView value = keys[k]->strings[row];
+      char *copy = (char *)exec_alloc(ctx, value.length > 0 ? value.length : 1);
+      if (!copy) {
+        return false;
+      }
+      memcpy(copy, value.data, value.length);
+      dst->strings[g] = sv_from_parts(copy, value.length);
+      break;
+    }
+    }
+  }
+  groups->columns[state->key_count].i64s[g] = (i64)hash;
+
+  for (u32 a = 0; a < state->aggregate_count; ++a) {
+    ExecVector *acc = &groups->columns[state->key_count + 1 + a];
+    bool is_int = acc->type == EXEC_TYPE_INT64;
+    switch (state->aggregates[a].kind) {
+    case EXEC_AGG_MIN:
+      if (is_int) {
+        acc->i64s[g] = INT64_MAX;
+      } else {
+        acc->f64s[g] = INFINITY;
+      }
+      break;
+    case EXEC_AGG_MAX:
+      if (is_int) {
+        acc->i64s[g] = INT64_MIN;
+      } else {
+        acc->f64s[g] = -INFINITY;
+      }
+      break;
+    case EXEC_AGG_AVG:
+      groups->columns[state->avg_columns[a]].i64s[g] = 0;
+      acc->f64s[g] = 0.0;
+      break;
+    default:
+      if (is_int) {
+        acc->i64s[g] = 0;
+      } else {
+        acc->f64s[g] = 0.0;
+      }
+      break;
+    }
+  }
+  groups->count++;
+  *out_group = (u32)g;
+  return true;
+}
+
+// Doubles the slot table (or creates it) and re-inserts every group by its
+// stored hash.
+static bool exec_aggregate_grow_slots(ExecContext *ctx, AggregateState *state) {
+  usize slot_count = state->slots ? (state->slot_mask + 1) * 2
+                                  : 2 * (usize)EXEC_BATCH_SIZE;
+  u32 *slots = (u32 *)exec_zalloc(ctx, slot_count * sizeof(u32));
+  if (!slots) {
+    return false;
+  }
+  usize mask = slot_count - 1;
+  const i64 *hashes = state->groups.columns[state->key_count].i64s;
+  for (usize g = 0; g < state->groups.count; ++g) {
+    usize slot = (usize)hashes[g] & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = (u32)g + 1;
+  }
+  state->slots = slots;
+  state->slot_mask = mask;
+  return true;
+}
+
+// Adds the groups of 'from' into 'into', partial aggregates of the same
+// shape whose AVG columns still hold sums.
+static bool exec_aggregate_merge(ExecContext *ctx, AggregateState *into,
+                                 const AggregateState *from) {
+  const ExecRows *groups = &from->groups;
+  for (u32 k = 0; k < from->key_count; ++k) {
+    into->key_vectors[k] = &groups->columns[k];
+  }
+  const i64 *hashes = groups->columns[from->key_count].i64s;
+  for (usize g = 0; g < groups->count; ++g) {
+    u32 target = 0; // The only group without keys
+    if (into->key_count > 0 &&
+        !exec_aggregate_find_group(ctx, into, into->key_vectors, (u32)g,
+                                   (u64)hashes[g], &target)) {
+      return false;
+    }
+    for (u32 a = 0; a < into->aggregate_count; ++a) {
+      u32 column = into->key_count + 1 + a;
+      ExecVector *dst = &into->groups.columns[column];
+      const ExecVector *src = &groups->columns[column];
+      ExecAggregateKind kind = into->aggregates[a].kind;
+      if (kind == EXEC_AGG_AVG) {
+        into->groups.columns[into->avg_columns[a]].i64s[target] +=
+            groups->columns[from->avg_columns[a]].i64s[g];
+      }
+      if (dst->type == EXEC_TYPE_INT64) {
+        i64 *out = &dst->i64s[target];
+        i64 value = src->i64s[g];
+        switch (kind) {
+        case EXEC_AGG_MIN:
+          *out = MIN(*out, value);
+          break;
+        case EXEC_AGG_MAX:
+          *out = MAX(*out, value);
+          break;
+        default: // COUNT(*), COUNT, SUM
+          *out = (i64)((u64)*out + (u64)value);
+          break;
+        }
+      } else {
+        f64 *out = &dst->f64s[target];
+        f64 value = src->f64s[g];
+        switch (kind) {
+        case EXEC_AGG_MIN:
+          *out = MIN(*out, value);
+          break;
+        case EXEC_AGG_MAX:
+          *out = MAX(*out, value);
+          break;
+        default: // SUM, AVG
+          *out += value;
+          break;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// --- Hash join ---
+
+static ExecJoinTable *exec_join_table_new(ExecContext *ctx,
+                                          ExecOperator *build,
+                                          ExecExpr *build_key) {
+  ASSERT(!build_key->is_predicate);
+  ExecJoinTable *table =
+      (ExecJoinTable *)exec_zalloc(ctx, sizeof(ExecJoinTable));
+  if (!table) {
+    return NULL;
+  }
+  table->build_key = build_key;
+  table->types = build->types;
+  table->column_count = build->column_count;
+  u32 row_columns = build->column_count + 1;
+  ExecType *types = (ExecType *)exec_alloc(ctx, row_columns * sizeof(ExecType));
+  table->append_vectors =
+      (ExecVector *)exec_alloc(ctx, row_columns * sizeof(ExecVector));
+  if (!types || !table->append_vectors) {
+    return NULL;
+  }
+  memcpy(types, build->types, build->column_count * sizeof(ExecType));
+  types[build->column_count] = build_key->type;
+  return exec_rows_init(ctx, &table->rows, types, row_columns) ? table : NULL;
+}
+
+// Loads every build row with its key, then chains the rows into a bucket
+// array sized to the final row count.
+static bool exec_join_table_load(ExecContext *ctx, ExecJoinTable *table,
+                                 ExecOperator *build) {
+  ExecRows *rows = &table->rows;
+  u32 key_column = rows->column_count - 1;
+  ExecBatch *input;
+  while ((input = exec_next(build)) != NULL) {
+    memcpy(table->append_vectors, input->columns,
+           key_column * sizeof(ExecVector));
+    table->append_vectors[key_column] =
+        *exec_eval(ctx, table->build_key, input);
+    if (!exec_rows_append(ctx, rows, table->append_vectors, input)) {
+      return false;
+    }
+  }
+  if (ctx->has_error) {
+    return false;
+  }
+
+  usize bucket_count = 16;
+  while (bucket_count < rows->count * 2) {
+    bucket_count *= 2;
+  }
+  table->buckets = (u32 *)exec_zalloc(ctx, bucket_count * sizeof(u32));
+  table->next = (u32 *)exec_alloc(ctx, MAX(rows->count, 1) * sizeof(u32));
+  if (!table->buckets || !table->next) {
+    return false;
+  }
+  table->bucket_mask = bucket_count - 1;
+  const ExecVector *keys = &rows->columns[key_column];
+  for (usize row = 0; row < rows->count; ++row) {
+    usize bucket = (usize)exec_hash_value(keys, row) & table->bucket_mask;
+    table->next[row] = table->buckets[bucket];
+    table->buckets[bucket] = (u32)row + 1;
+  }
+  return true;
+}
+
+// A join probing 'table', which exec_join_next loads first if it is the
+// join's pending_table.
+static ExecOperator *exec_join_new(ExecContext *ctx,
+                                   const ExecJoinTable *table,
+                                   ExecOperator *probe, ExecExpr *probe_key) {
+  if (!probe || !probe_key) {
+    return NULL;
+  }
+  ASSERT(!probe_key->is_predicate);
+  ASSERT_MSG(table->build_key->type == probe_key->type,
+             "Join keys must have the same type");
+  ExecOperator *op =
+      exec_new_operator(ctx, &join_ops, sizeof(JoinState),
+                        probe->column_count + table->column_count);
+  if (!op) {
+    return NULL;
+  }
+  op->child = probe;
+  memcpy(op->types, probe->types, probe->column_count * sizeof(ExecType));
+  memcpy(op->types + probe->column_count, table->types,
+         table->column_count * sizeof(ExecType));
+
+  JoinState *state = (JoinState *)op->state;
+  state->table = table;
+  state->probe_key = probe_key;
+  state->probe_rows = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  state->build_rows = (u32 *)exec_alloc(ctx, EXEC_BATCH_SIZE * sizeof(u32));
+  if (!state->probe_rows || !state->build_rows ||
+      !exec_init_batch(ctx, &state->batch, op->types, op->column_count,
+                       true)) {
+    return NULL;
+  }
+  return op;
+}
+
+static ExecBatch *exec_join_next(ExecOperator *op) {
+  JoinState *state = (JoinState *)op->state;
+  if (state->pending_table) {
+    if (!exec_join_table_load(op->ctx, state->pending_table, op->build)) {
+      return NULL;
+    }
+    state->pending_table = NULL;
+  }
+
+  const ExecJoinTable *table = state->table;
+  const ExecRows *rows = &table->rows;
+  const ExecVector *build_keys = &rows->columns[rows->column_count - 1];
+  u32 probe_columns = op->child->column_count;
+  for (;;) {
+    if (!state->probe_batch) {
+      state->probe_batch = exec_next(op->child);
+      if (!state->probe_batch) {
+        return NULL;
+      }
+      state->probe_keys =
+          exec_eval(op->ctx, state->probe_key, state->probe_batch);
+      state->probe_index = 0;
+      exec_join_start_row(state);
+    }
+
+    ExecBatch *probe = state->probe_batch;
+    u32 count = 0;
+    while (state->probe_index < probe->selected_count) {
+      u32 probe_row = exec_batch_row(probe, state->probe_index);
+      while (state->chain != 0 && count < EXEC_BATCH_SIZE) {
+        u32 build_row = state->chain - 1;
+        state->chain = table->next[build_row];
+        if (exec_values_equal(build_keys, build_row, state->probe_keys,
+                              probe_row)) {
+          state->probe_rows[count] = probe_row;
+          state->build_rows[count] = build_row;
+          count++;
+        }
+      }
+      if (state->chain != 0) {
+        break; // Output full in the middle of a chain
+      }
+      state->probe_index++;
+      exec_join_start_row(state);
+    }
+
+    if (count > 0) {
+      // Gather before the probe batch can be replaced by the next one.
+      ExecBatch *batch = &state->batch;
+      for (u32 c = 0; c < probe_columns; ++c) {
+        exec_gather(&batch->columns[c], &probe->columns[c], state->probe_rows,
+                    count);
+      }
+      for (u32 c = 0; c + 1 < rows->column_count; ++c) {
+        exec_gather(&batch->columns[probe_columns + c], &rows->columns[c],
+                    state->build_rows, count);
+      }
+      batch->row_count = count;
+      batch->selection = NULL;
+      batch->selected_count = count;
+      if (state->probe_index >= probe->selected_count) {
+        state->probe_batch = NULL;
+      }
+      return batch;
+    }
+    state->probe_batch = NULL;
+  }
+}
+
+static void exec_join_start_row(JoinState *state) {
+  ExecBatch *probe = state->probe_batch;
+  if (state->probe_index >= probe->selected_count) {
+    state->chain = 0;
+    return;
+  }
+  u32 row = exec_batch_row(probe, state->probe_index);
+  usize bucket = (usize)exec_hash_value(state->probe_keys, row) &
+                 state->table->bucket_mask;
+  state->chain = state->table->buckets[bucket];
+}
+
+// --- Radix join ---
+
+static ExecBatch *exec_radix_join_next(ExecOperator *op) {
+  RadixJoinState *state = (RadixJoinState *)op->state;
+  if (!state->is_started) {
+    state->is_started = true;
+    if (!exec_radix_join_start(op)) {
+      exec_radix_close_spill(state);
+      return NULL;
+    }
+  }
+
+  u32 probe_columns = op->child->column_count;
+  for (;;) {
+    u32 count = exec_radix_match(state);
+    if (count > 0) {
+      ExecBatch *batch = &state->batch;
+      for (u32 c = 0; c < probe_columns; ++c) {
+        exec_gather(&batch->columns[c], &state->probe.columns[c],
+                    state->probe_rows, count);
+      }
+      for (u32 c = 0; c + 1 < state->build.column_count; ++c) {
+        exec_gather(&batch->columns[probe_columns + c],
+                    &state->build.columns[c], state->build_rows, count);
+      }
+      batch->row_count = count;
+      batch->selection = NULL;
+      batch->selected_count = count;
+      return batch;
+    }
+    if (!exec_radix_next_chunk(op)) {
+      exec_radix_close_spill(state);
+      return NULL;
+    }
+  }
+}
+
+// Loads the build side and builds its table. Once the build rows outgrow the
+// memory budget, they and every later build row go to the spill files, and so
+// does the whole probe side; the join then runs one file pair at a time.
+static bool exec_radix_join_start(ExecOperator *op) {
+  RadixJoinState *state = (RadixJoinState *)op->state;
+  ExecContext *ctx = op->ctx;
+  ExecRows *build = &state->build;
+  u32 key_column = build->column_count - 1;
+  ExecBatch *input;
+  while ((input = exec_next(op->build)) != NULL) {
+    memcpy(state->append_vectors, input->columns,
+           key_column * sizeof(ExecVector));
+    state->append_vectors[key_column] =
+        *exec_eval(ctx, state->build_key, input);
+    if (!exec_rows_append(ctx, build, state->append_vectors, input)) {
+      return false;
+    }
+    if (!state->spill_files && (state->memory_budget == 0 ||
+                                build->count * state->build_row_bytes <=
+                                    state->memory_budget)) {
+      continue;
+    }
+    if ((!state->spill_files && !exec_radix_open_spill(ctx, state)) ||
+        !exec_radix_spill_rows(ctx, state, build, state->spill_files)) {
+      return false;
+    }
+  }
+  if (ctx->has_error) {
+    return false;
+  }
+  if (!state->spill_files) {
+    return exec_radix_build_table(ctx, state);
+  }
+
+  ExecRows *probe = &state->probe;
+  FILE **probe_files = state->spill_files + state->stats.spill_partitions;
+  key_column = probe->column_count - 1;
+  while ((input = exec_next(op->child)) != NULL) {
+    memcpy(state->append_vectors, input->columns,
+           key_column * sizeof(ExecVector));
+    state->append_vectors[key_column] =
+        *exec_eval(ctx, state->probe_key, input);
+    if (!exec_rows_append(ctx, probe, state->append_vectors, input) ||
+        !exec_radix_spill_rows(ctx, state, probe, probe_files)) {
+      return false;
+    }
+  }
+  state->is_probe_done = true;
+  return !ctx->has_error && exec_radix_load_partition(ctx, state, 0);
+}
+
+// Replaces the probe chunk with the next one: from the child, or from the
+// probe files, moving on to the next file pair as each one runs out.
+static bool exec_radix_next_chunk(ExecOperator *op) {
+  RadixJoinState *state = (RadixJoinState *)op->state;
+  if (!state->spill_files) {
+    return exec_radix_fill_chunk(op);
+  }
+  ExecContext *ctx = op->ctx;
+  u32 partitions = state->stats.spill_partitions;
+  for (;;) {
+    state->probe.count = 0;
+    state->probe_strings.size = 0;
+    if (!exec_radix_load_spill(
+            ctx, state->spill_files[partitions + state->spill_partition],
+            &state->probe, &state->probe_strings, EXEC_RADIX_PROBE_CHUNK)) {
+      return false;
+    }
+    if (state->probe.count > 0) {
+      exec_radix_partition_chunk(state);
+      return true;
+    }
+    // The probe file is done: join it again with the rest of a split build
+    // file, or move on to the next file pair.
+    if (state->is_build_split) {
+      if (!exec_radix_load_build(ctx, state)) {
+        return false;
+      }
+      if (state->build.count > 0) {
+        state->stats.probe_rescans++;
+        continue;
+      }
+    }
+    if (state->spill_partition + 1 == partitions ||
+        !exec_radix_load_partition(ctx, state, state->spill_partition + 1)) {
+      return false;
+    }
+  }
+}
+
+// Reads child batches into the probe chunk until it is full.
+static bool exec_radix_fill_chunk(ExecOperator *op) {
+  RadixJoinState *state = (RadixJoinState *)op->state;
+  ExecContext *ctx = op->ctx;
+  ExecRows *probe = &state->probe;
+  u32 key_column = probe->column_count - 1;
+  probe->count = 0;
+  while (!state->is_probe_done &&
+         probe->count + EXEC_BATCH_SIZE <= EXEC_RADIX_PROBE_CHUNK) {
+    ExecBatch *input = exec_next(op->child);
+    if (!input) {
+      state->is_probe_done = true;
+      break;
+    }
+    memcpy(state->append_vectors, input->columns,
+           key_column * sizeof(ExecVector));
+    state->append_vectors[key_column] =
+        *exec_eval(ctx, state->probe_key, input);
+    if (!exec_rows_append(ctx, probe, state->append_vectors, input)) {
+      return false;
+    }
+  }
+  if (ctx->has_error || probe->count == 0) {
+    return false;
+  }
+  exec_radix_partition_chunk(state);
+  return true;
+}
+
+// Hashes the probe chunk and groups it by the table's partitions, so the
+// probes of one partition run back to back against a cache-resident table.
+static void exec_radix_partition_chunk(RadixJoinState *state) {
+  const ExecVector *keys = &state->probe.columns[state->probe.column_count - 1];
+  u32 count = (u32)state->probe.count;
+  u32 partitions = 1u << state->table.bits;
+  u64 mask = partitions - 1;
+  u32 *start = state->probe_part_start;
+  memset(start, 0, (partitions + 1) * sizeof(u32));
+  for (u32 row = 0; row < count; ++row) {
+    u64 hash = exec_hash_value(keys, row);
+    state->probe_hashes[row] = hash;
+    start[(hash & mask) + 1]++;
+  }
+  for (u32 p = 0; p < partitions; ++p) {
+    start[p + 1] += start[p];
+  }
+  for (u32 row = 0; row < count; ++row) {
+    u64 hash = state->probe_hashes[row];
+    u32 entry = start[hash & mask]++;
+    state->probe_entry_hashes[entry] = hash;
+    state->probe_entry_rows[entry] = row;
+  }
+  state->probe_count = count;
+  state->probe_index = 0;
+}
+
+// Builds the table over state->build: partitions with enough bits that each
+// one's entries fit EXEC_RADIX_PARTITION_BYTES, then every partition split
+// into power-of-two buckets, one per entry or so. The second pass works on
+// one partition at a time, in parallel on the scheduler if there is one.
+static bool exec_radix_build_table(ExecContext *ctx, RadixJoinState *state) {
+  RadixTable *table = &state->table;
+  const ExecRows *build = &state->build;
+  u32 count = (u32)build->count;
+  if (count > table->capacity) {
+    usize capacity = MAX(MAX((usize)count, table->capacity * 2),
+                         (usize)EXEC_BATCH_SIZE);
+    table->hashes = (u64 *)exec_alloc(ctx, capacity * sizeof(u64));
+    table->rows = (u32 *)exec_alloc(ctx, capacity * sizeof(u32));
+    table->scratch_hashes = (u64 *)exec_alloc(ctx, capacity * sizeof(u64));
+    table->scratch_rows = (u32 *)exec_alloc(ctx, capacity * sizeof(u32));
+    if (!table->hashes || !table->rows || !table->scratch_hashes ||
+        !table->scratch_rows) {
+      return false;
+    }
+    table->capacity = capacity;
+  }
+
+  usize entry_bytes = (usize)count * (sizeof(u64) + 2 * sizeof(u32));
+  u32 bits = 0;
+  while (bits < EXEC_RADIX_MAX_BITS &&
+         (entry_bytes >> bits) > EXEC_RADIX_PARTITION_BYTES) {
+    bits++;
+  }
+  u32 partitions = 1u << bits;
+  u64 mask = partitions - 1;
+  table->bits = bits;
+
+  const ExecVector *keys = &build->columns[build->column_count - 1];
+  u32 *start = table->part_start;
+  memset(start, 0, (partitions + 1) * sizeof(u32));
+  for (u32 row = 0; row < count; ++row) {
+    u64 hash = exec_hash_value(keys, row);
+    table->scratch_hashes[row] = hash;
+    start[(hash & mask) + 1]++;
+  }
+  usize bucket_total = 0;
+  for (u32 p = 0; p < partitions; ++p) {
+    u32 size = start[p + 1];
+    u8 bucket_bits = 0;
+    while (((u32)1 << bucket_bits) < size) {
+      bucket_bits++;
+    }
+    table->bucket_bits[p] = bucket_bits;
+    table->bucket_base[p] = (u32)bucket_total;
+    bucket_total += ((usize)1 << bucket_bits) + 1;
+    start[p + 1] += start[p];
+  }
+  if (bucket_total > table->bucket_capacity) {
+    usize capacity = MAX(bucket_total, table->bucket_capacity * 2);
+    table->bucket_start = (u32 *)exec_alloc(ctx, capacity * sizeof(u32));
+    if (!table->bucket_start) {
+      return false;
+    }
+    table->bucket_capacity = capacity;
+  }
+
+  // Scatter into partition order, advancing start[p] to the partition's end,
+  // then shift the starts back.
+  for (u32 row = 0; row < count; ++row) {
+    u64 hash = table->scratch_hashes[row];
+    u32 entry = start[hash & mask]++;
+    table->hashes[entry] = hash;
+    table->rows[entry] = row;
+  }
+  memmove(start + 1, start, partitions * sizeof(u32));
+  start[0] = 0;
+
+  Scheduler *scheduler = state->scheduler;
+  if (scheduler && partitions > 1) {
+    usize morsel_size = MAX(partitions / (scheduler->worker_count * 8), 1u);
+    if (!sched_run(scheduler, partitions, morsel_size, exec_radix_build_job,
+                   table)) {
+      ctx->has_error = true;
+      return false;
+    }
+  } else {
+    for (u32 p = 0; p < partitions; ++p) {
+      exec_radix_bucket_partition(table, p);
+    }
+  }
+  u64 *hashes = table->hashes;
+  u32 *rows = table->rows;
+  table->hashes = table->scratch_hashes;
+  table->rows = table->scratch_rows;
+  table->scratch_hashes = hashes;
+  table->scratch_rows = rows;
+  state->stats.partitions = MAX(state->stats.partitions, partitions);
+  return true;
+}
+
+static void exec_radix_build_job(SchedWorker *worker, void *arg) {
+  RadixTable *table = (RadixTable *)arg;
+  SchedMorsel morsel;
+  while (sched_next_morsel(worker, &morsel)) {
+    for (usize p = morsel.begin; p < morsel.end; ++p) {
+      exec_radix_bucket_partition(table, (u32)p);
+    }
+  }
+}
+
+// Sorts the entries of one partition by bucket into the scratch arrays, at
+// the same positions, and fills in the partition's bucket starts.
+static void exec_radix_bucket_partition(RadixTable *table, u32 partition) {
+  u32 begin = table->part_start[partition];
+  u32 end = table->part_start[partition + 1];
+  u32 buckets = 1u << table->bucket_bits[partition];
+  u64 mask = buckets - 1;
+  u32 *start = &table->bucket_start[table->bucket_base[partition]];
+  memset(start, 0, (buckets + 1) * sizeof(u32));
+  for (u32 e = begin; e < end; ++e) {
+    start[((table->hashes[e] >> table->bits) & mask) + 1]++;
+  }
+  start[0] = begin;
+  for (u32 b = 0; b < buckets; ++b) {
+    start[b + 1] += start[b];
+  }
+  for (u32 e = begin; e < end; ++e) {
+    u64 hash = table->hashes[e];
+    u32 entry = start[(hash >> table->bits) & mask]++;
+    table->scratch_hashes[entry] = hash;
+    table->scratch_rows[entry] = table->rows[e];
+  }
+  memmove(start + 1, start, buckets * sizeof(u32));
+  start[0] = begin;
+}
+
+// Fills probe_rows/build_rows with up to EXEC_BATCH_SIZE matches, resuming
+// from the cursor left by the previous call. Returns 0 once the chunk is done.
+static u32 exec_radix_match(RadixJoinState *state) {
+  const RadixTable *table = &state->table;
+  const ExecVector *build_keys =
+      &state->build.columns[state->build.column_count - 1];
+  const ExecVector *probe_keys =
+      &state->probe.columns[state->probe.column_count - 1];
+  u64 mask = ((u64)1 << table->bits) - 1;
+  u32 count = 0;
+  while (count < EXEC_BATCH_SIZE) {
+    if (state->cursor == state->cursor_end) {
+      if (state->probe_index >= state->probe_count) {
+        break;
+      }
+      u32 entry = state->probe_index++;
+      u64 hash = state->probe_entry_hashes[entry];
+      u32 partition = (u32)(hash & mask);
+      u64 bucket = (hash >> table->bits) &
+                   (((u64)1 << table->bucket_bits[partition]) - 1);
+      const u32 *start =
+          &table->bucket_start[table->bucket_base[partition] + bucket];
+      state->probe_hash = hash;
+      state->probe_row = state->probe_entry_rows[entry];
+      state->cursor = start[0];
+      state->cursor_end = start[1];
+      continue;
+    }
+    u32 entry = state->cursor++;
+    if (table->hashes[entry] == state->probe_hash &&
+        exec_values_equal(build_keys, table->rows[entry], probe_keys,
+                          state->probe_row)) {
+      state->probe_rows[count] = state->probe_row;
+      state->build_rows[count] = table->rows[entry];
+      count++;
+    }
+  }
+  return count;
+}
+
+// Moves every row of 'rows' to the file of its spill partition (the top hash
+// bits, which the table partitions never use) and empties 'rows'.
+static bool exec_radix_spill_rows(ExecContext *ctx, RadixJoinState *state,
+                                  ExecRows *rows, FILE **files) {
+  const ExecVector *keys = &rows->columns[rows->column_count - 1];
+  for (usize row = 0; row < rows->count; ++row) {
+    FILE *file =
+        files[exec_hash_value(keys, row) >> (64 - EXEC_RADIX_SPILL_BITS)];
+    if (!exec_rows_write(file, rows, row)) {
+      LOG_ERROR("Failed to write a join spill file: %s", strerror(errno));
+      ctx->has_error = true;
+      return false;
+    }
+  }
+  state->stats.spilled_rows += rows->count;
+  rows->count = 0;
+  return true;
+}
+
+// Appends rows read from 'file' until 'rows' holds 'max_rows' or the file
+// ends. Strings are copied into 'strings', which the caller empties along
+// with 'rows'.
+static bool exec_radix_load_spill(ExecContext *ctx, FILE *file,
+                                  ExecRows *rows, ExecStrings *strings,
+                                  usize max_rows) {
+  while (rows->count < max_rows) {
+    if (!exec_rows_reserve(ctx, rows, rows->count + 1)) {
+      return false;
+    }
+    usize row = rows->count;
+    for (u32 c = 0; c < rows->column_count; ++c) {
+      ExecVector *column = &rows->columns[c];
+      bool is_read;
+      if (column->type == EXEC_TYPE_STRING) {
+        u32 length;
+        is_read = fread(&length, sizeof(length), 1, file) == 1;
+        char *data = is_read ? exec_string_space(ctx, strings, length) : NULL;
+        is_read = data && fread(data, 1, length, file) == length;
+        column->strings[row] = sv_from_parts(data, length);
+      } else {
+        is_read = fread(&column->i64s[row], sizeof(i64), 1, file) == 1;
+      }
+      if (!is_read) {
+        if (c == 0 && feof(file)) {
+          return true;
+        }
+        LOG_ERROR("Failed to read a join spill file");
+        ctx->has_error = true;
+        return false;
+      }
+    }
+    rows->count++;
+  }
+  return true;
+}
+
+static bool exec_radix_open_spill(ExecContext *ctx, RadixJoinState *state) {
+  u32 partitions = 1u << EXEC_RADIX_SPILL_BITS;
+  state->spill_files =
+      (FILE **)exec_zalloc(ctx, 2 * partitions * sizeof(FILE *));
+  if (!state->spill_files) {
+    return false;
+  }
+  state->stats.spill_partitions = partitions;
+  for (u32 i = 0; i < 2 * partitions; ++i) {
+    state->spill_files[i] = tmpfile();
+    if (!state->spill_files[i]) {
+      LOG_ERROR("Failed to create a join spill file: %s", strerror(errno));
+      ctx->has_error = true;
+      return false;
+    }
+  }
+  LOG_DEBUG("Join build side exceeds %zu bytes, spilling to %u partitions",
+            state->memory_budget, partitions);
+  return true;
+}
+
+// Makes spill file pair 'partition' current and loads its build rows.
+static bool exec_radix_load_partition(ExecContext *ctx, RadixJoinState *state,
+                                      u32 partition) {
+  state->spill_partition = partition;
+  rewind(state->spill_files[partition]);
+  return exec_radix_load_build(ctx, state);
+}
+
+// Loads the next build rows of the current file pair, as many as the memory
+// budget holds, builds their table and rewinds the probe file. Keys that
+// repeat too often for the hash to spread them fill one file past the budget;
+// such a file is joined in pieces, each against the whole probe file, so
+// 'build.count' is 0 once the last piece has been joined.
+static bool exec_radix_load_build(ExecContext *ctx, RadixJoinState *state) {
+  u32 partition = state->spill_partition;
+  usize max_rows = MAX(state->memory_budget / state->build_row_bytes,
+                       (usize)EXEC_BATCH_SIZE);
+  state->build.count = 0;
+  state->build_strings.size = 0;
+  if (!exec_radix_load_spill(ctx, state->spill_files[partition], &state->build,
+                             &state->build_strings, max_rows)) {
+    return false;
+  }
+  if (state->build.count == max_rows && !state->is_build_split) {
+    LOG_DEBUG("Join spill partition %u is over the memory budget, joining it "
+              "in pieces",
+              partition);
+  }
+  state->is_build_split = state->build.count == max_rows;
+  rewind(state->spill_files[state->stats.spill_partitions + partition]);
+  return exec_radix_build_table(ctx, state);
+}
+
+static void exec_radix_close_spill(RadixJoinState *state) {
+  if (!state->spill_files) {
+    return;
+  }
+  for (u32 i = 0; i < 2 * state->stats.spill_partitions; ++i) {
+    if (state->spill_files[i]) {
+      fclose(state->spill_files[i]);
+    }
+  }
+  state->spill_files = NULL;
+}
+
+static void exec_radix_join_close(ExecOperator *op) {
+  exec_radix_close_spill((RadixJoinState *)op->state);
+}
+
+// --- Sort ---
+
+static ExecBatch *exec_sort_next(ExecOperator *op) {
+  SortState *state = (SortState *)op->state;
+  if (!state->is_sorted) {
+    state->is_sorted = true;
+    if (!exec_sort_consume(op)) {
+      exec_sort_close_runs(state);
+      return NULL;
+    }
+  }
+  if (state->run_count > 0) {
+    ExecBatch *batch = exec_sort_merge_next(op);
+    if (!batch) {
+      exec_sort_close_runs(state);
+    }
+    return batch;
+  }
+
+  const ExecRows *rows = &state->rows;
+  if (state->position >= rows->count) {
+    return NULL;
+  }
+  u32 count = (u32)MIN((usize)EXEC_BATCH_SIZE, rows->count - state->position);
+  for (u32 i = 0; i < count; ++i) {
+    state->order[i] = state->entries[state->position + i].row;
+  }
+  for (u32 c = 0; c < op->column_count; ++c) {
+    exec_gather(&state->batch.columns[c], &rows->columns[c], state->order,
+                count);
+  }
+  state->batch.row_count = count;
+  state->batch.selection = NULL;
+  state->batch.selected_count = count;
+  state->position += count;
+  return &state->batch;
+}
+
+// Reads the whole input. Without spilling, the rows end up sorted in
+// state->entries; otherwise every run is on disk, merged down to at most
+// fan_in runs, and the final merge is started.
+static bool exec_sort_consume(ExecOperator *op) {
+  SortState *state = (SortState *)op->state;
+  ExecContext *ctx = op->ctx;
+  ExecRows *rows = &state->rows;
+  ExecBatch *input;
+  while ((input = exec_next(op->child)) != NULL) {
+    if (state->run_rows > 0 &&
+        rows->count + input->selected_count > state->run_rows &&
+        !exec_sort_spill_run(ctx, state)) {
+      return false;
+    }
+    if (!exec_rows_append(ctx, rows, input->columns, input)) {
+      return false;
+    }
+  }
+  if (ctx->has_error) {
+    return false;
+  }
+  if (state->run_count == 0) {
+    return exec_sort_run(ctx, state);
+  }
+  if (!exec_sort_spill_run(ctx, state)) {
+    return false;
+  }
+  LOG_DEBUG("Sort spilled %u runs, merging up to %u at a time",
+            state->run_count, state->fan_in);
+  while (state->run_count > state->fan_in) {
+    if (!exec_sort_merge_pass(op)) {
+      return false;
+    }
+  }
+  return exec_sort_start_merge(op, state->runs, state->run_count);
+}
+
+// Sorts state->rows into state->entries: a radix sort on the prefixes, then
+// each group of equal prefixes sorted on the full keys unless the prefix
+// already decides.
+static bool exec_sort_run(ExecContext *ctx, SortState *state) {
+  usize count = state->rows.count;
+  if (count > state->entry_capacity) {
+    usize capacity = MAX(MAX(count, state->entry_capacity * 2),
+                         (usize)EXEC_BATCH_SIZE);
+    state->entries = (SortEntry *)exec_alloc(ctx, capacity * sizeof(SortEntry));
+    state->scratch = (SortEntry *)exec_alloc(ctx, capacity * sizeof(SortEntry));
+    if (!state->entries || !state->scratch) {
+      return false;
+    }
+    state->entry_capacity = capacity;
+  }
+  const ExecSortKey *key = &state->keys[0];
+  const ExecVector *column = &state->rows.columns[key->column];
+  for (usize i = 0; i < count; ++i) {
+    state->entries[i] = (SortEntry){
+        exec_sort_prefix(column, i, key->is_descending), (u32)i};
+  }
+  SortEntry *sorted = exec_sort_radix(state->entries, state->scratch, count);
+  if (sorted != state->entries) {
+    state->scratch = state->entries;
+    state->entries = sorted;
+  }
+  if (state->is_prefix_complete) {
+    return true;
+  }
+  for (usize i = 0; i < count;) {
+    usize end = i + 1;
+    while (end < count && state->entries[end].prefix == state->entries[i].prefix) {
+      end++;
+    }
+    if (end - i > 1) {
+      qsort_r(&state->entries[i], end - i, sizeof(SortEntry),
+              exec_sort_compare, state);
+    }
+    i = end;
+  }
+  return true;
+}
+
+// LSD radix sort on the prefix, a byte per pass, skipping the bytes that all
+// entries share. Stable. Returns whichever of the two arrays holds the result.
+static SortEntry *exec_sort_radix(SortEntry *entries, SortEntry *scratch,
+                                  usize count) {
+  if (count < 2) {
+    return entries;
+  }
+  u32 counts[8][256];
+  memset(counts, 0, sizeof(counts));
+  for (usize i = 0; i < count; ++i) {
+    u64 prefix = entries[i].prefix;
+    for (u32 d = 0; d < 8; ++d) {
+      counts[d][(prefix >> (8 * d)) & 0xFF]++;
+    }
+  }
+  SortEntry *src = entries;
+  SortEntry *dst = scratch;
+  for (u32 d = 0; d < 8; ++d) {
+    u32 *offsets = counts[d];
+    if (offsets[(src[0].prefix >> (8 * d)) & 0xFF] == count) {
+      continue;
+    }
+    u32 offset = 0;
+    for (u32 b = 0; b < 256; ++b) {
+      u32 size = offsets[b];
+      offsets[b] = offset;
+      offset += size;
+    }
+    for (usize i = 0; i < count; ++i) {
+      dst[offsets[(src[i].prefix >> (8 * d)) & 0xFF]++] = src[i];
+    }
+    SortEntry *swap = src;
+    src = dst;
+    dst = swap;
+  }
+  return src;
+}
+
+// Maps a key to a u64 whose unsigned order is the key's order: ints with the
+// sign bit flipped, floats with the sign bit flipped or, if negative, every
+// bit, strings as their first 8 bytes big-endian.
+static u64 exec_sort_prefix(const ExecVector *column, usize row,
+                            bool is_descending) {
+  u64 prefix = 0;
+  switch (column->type) {
+  case EXEC_TYPE_INT64:
+    prefix = (u64)column->i64s[row] ^ (1ULL << 63);
+    break;
+  case EXEC_TYPE_FLOAT64: {
+    f64 value = column->f64s[row];
+    if (value == 0.0) {
+      value = 0.0; // -0.0 compares equal to 0.0
+    }
+    memcpy(&prefix, &value, sizeof(prefix));
+    prefix = (prefix >> 63) ? ~prefix : prefix | (1ULL << 63);
+    break;
+  }
+  case EXEC_TYPE_STRING: {
+    StringView value = column->strings[row];
+    usize length = MIN(value.length, sizeof(prefix));
+    for (usize i = 0; i < length; ++i) {
+      prefix |= (u64)(u8)value.data[i] << (56 - 8 * i);
+    }
+    break;
+  }
+  }
+  return is_descending ? ~prefix : prefix;
+}
+
+// Orders SortEntry values of the run being sorted. Ties keep input order
+// through the row index, so the sort is stable.
+static int exec_sort_compare(const void *a, const void *b, void *arg) {
+  const SortState *state = (const SortState *)arg;
+  u32 x = ((const SortEntry *)a)->row;
+  u32 y = ((const SortEntry *)b)->row;
+  int cmp = exec_sort_compare_rows(state, &state->rows, x, &state->rows, y);
+  return cmp != 0 ? cmp : (x > y) - (x < y);
+}
+
+static int exec_sort_compare_rows(const SortState *state, const ExecRows *a,
+                                  usize a_row, const ExecRows *b,
+                                  usize b_row) {
+  for (u32 k = 0; k < state->key_count; ++k) {
+    const ExecVector *x = &a->columns[state->keys[k].column];
+    const ExecVector *y = &b->columns[state->keys[k].column];
+    int cmp = 0;
+    switch (x->type) {
+    case EXEC_TYPE_INT64:
+      cmp = (x->i64s[a_row] > y->i64s[b_row]) -
+            (x->i64s[a_row] < y->i64s[b_row]);
+      break;
+    case EXEC_TYPE_FLOAT64:
+      cmp = (x->f64s[a_row] > y->f64s[b_row]) -
+            (x->f64s[a_row] < y->f64s[b_row]);
+      break;
+    case EXEC_TYPE_STRING:
+      cmp = sv_compare(x->strings[a_row], y->strings[b_row]);
+      break;
+    }
+    if (cmp != 0) {
+      return state->keys[k].is_descending ? -cmp : cmp;
+    }
+  }
+  return 0;
+}
+
+// Sorts state->rows and writes them out as a new run, emptying them.
+static bool exec_sort_spill_run(ExecContext *ctx, SortState *state) {
+  ExecRows *rows = &state->rows;
+  if (rows->count == 0) {
+    return true;
+  }
+  if (!exec_sort_run(ctx, state)) {
+    return false;
+  }
+  FILE *file = exec_sort_new_run(ctx, state);
+  if (!file) {
+    return false;
+  }
+  for (usize i = 0; i < rows->count; ++i) {
+    if (!exec_rows_write(file, rows, state->entries[i].row)) {
+      LOG_ERROR("Failed to write a sort run: %s", strerror(errno));
+      ctx->has_error = true;
+      return false;
+    }
+  }
+  state->stats.runs++;
+  state->stats.spilled_rows += rows->count;
+  rows->count = 0;
+  return true;
+}
+
+// Appends an empty temp file to state->runs.
+static FILE *exec_sort_new_run(ExecContext *ctx, SortState *state) {
+  if (state->run_count == state->run_capacity) {
+    u32 capacity = MAX(state->run_capacity * 2, 16u);
+    FILE **runs = (FILE **)exec_alloc(ctx, capacity * sizeof(FILE *));
+    if (!runs) {
+      return NULL;
+    }
+    if (state->run_count > 0) {
+      memcpy(runs, state->runs, state->run_count * sizeof(FILE *));
+    }
+    state->runs = runs;
+    state->run_capacity = capacity;
+  }
+  FILE *file = tmpfile();
+  if (!file) {
+    LOG_ERROR("Failed to create a sort run file: %s", strerror(errno));
+    ctx->has_error = true;
+    return NULL;
+  }
+  setvbuf(file, NULL, _IOFBF, EXEC_SORT_IO_BYTES);
+  state->runs[state->run_count++] = file;
+  return file;
+}
+
+// Merges each group of fan_in consecutive runs into one new run, so the runs
+// stay in input order and the merge stays stable.
+static bool exec_sort_merge_pass(ExecOperator *op) {
+  SortState *state = (SortState *)op->state;
+  ExecContext *ctx = op->ctx;
+  FILE **inputs = state->runs;
+  u32 input_count = state->run_count;
+  state->runs = NULL;
+  state->run_count = 0;
+  state->run_capacity = 0;
+
+  bool ok = true;
+  for (u32 first = 0; first < input_count && ok; first += state->fan_in) {
+    u32 count = MIN(state->fan_in, input_count - first);
+    FILE *output = exec_sort_new_run(ctx, state);
+    ok = output && exec_sort_start_merge(op, inputs + first, count);
+    SortReader *reader;
+    while (ok && (reader = exec_sort_head(state)) != NULL) {
+      if (!exec_rows_write(output, &reader->block, reader->position)) {
+        LOG_ERROR("Failed to write a sort run: %s", strerror(errno));
+        ctx->has_error = true;
+        ok = false;
+        break;
+      }
+      state->stats.spilled_rows++;
+      ok = exec_sort_advance(ctx, state);
+    }
+    for (u32 i = first; i < first + count; ++i) {
+      fclose(inputs[i]);
+      inputs[i] = NULL;
+    }
+  }
+  for (u32 i = 0; i < input_count; ++i) {
+    if (inputs[i]) {
+      fclose(inputs[i]);
+    }
+  }
+  state->stats.merge_passes++;
+  return ok;
+}
+
+// Points the first 'count' readers at 'files', from their start, and builds
+// the loser tree over their first rows.
+static bool exec_sort_start_merge(ExecOperator *op, FILE **files, u32 count) {
+  SortState *state = (SortState *)op->state;
+  ExecContext *ctx = op->ctx;
+  ASSERT(count > 0 && count <= state->fan_in);
+  if (!state->readers) {
+    u32 fan_in = state->fan_in;
+    state->readers =
+        (SortReader *)exec_zalloc(ctx, fan_in * sizeof(SortReader));
+    state->tree = (u32 *)exec_alloc(ctx, fan_in * sizeof(u32));
+    state->winners = (u32 *)exec_alloc(ctx, 2 * fan_in * sizeof(u32));
+    if (!state->readers || !state->tree || !state->winners) {
+      return false;
+    }
+    for (u32 r = 0; r < fan_in; ++r) {
+      ExecRows *block = &state->readers[r].block;
+      if (!exec_rows_init(ctx, block, op->types, op->column_count) ||
+          !exec_rows_reserve(ctx, block, EXEC_BATCH_SIZE)) {
+        return false;
+      }
+    }
+  }
+  state->merge_count = count;
+  for (u32 r = 0; r < count; ++r) {
+    SortReader *reader = &state->readers[r];
+    reader->file = files[r];
+    reader->is_done = false;
+    rewind(reader->file);
+    if (!exec_sort_read_block(ctx, state, reader)) {
+      return false;
+    }
+  }
+  exec_sort_build_tree(state);
+  return true;
+}
+
+// Replaces the reader's block with the next rows of its run, marking it done
+// at the end of the file.
+static bool exec_sort_read_block(ExecContext *ctx, const SortState *state,
+                                 SortReader *reader) {
+  ExecRows *block = &reader->block;
+  block->count = 0;
+  reader->position = 0;
+  reader->strings.size = 0;
+  bool is_end = false;
+  while (!is_end && block->count < EXEC_BATCH_SIZE) {
+    usize row = block->count;
+    for (u32 c = 0; c < block->column_count && !is_end; ++c) {
+      ExecVector *column = &block->columns[c];
+      bool is_read;
+      if (column->type == EXEC_TYPE_STRING) {
+        u32 length;
+        is_read = fread(&length, sizeof(length), 1, reader->file) == 1;
+        char *data =
+            is_read ? exec_string_space(ctx, &reader->strings, length) : NULL;
+        is_read = data && fread(data, 1, length, reader->file) == length;
+        column->strings[row] = sv_from_parts(data, length);
+      } else {
+        is_read = fread(&column->i64s[row], sizeof(i64), 1, reader->file) == 1;
+      }
+      if (!is_read && c == 0 && feof(reader->file)) {
+        is_end = true;
+      } else if (!is_read) {
+        LOG_ERROR("Failed to read a sort run");
+        ctx->has_error = true;
+        return false;
+      }
+    }
+    block->count += !is_end;
+  }
+  reader->is_done = block->count == 0;
+  if (!reader->is_done) {
+    const ExecSortKey *key = &state->keys[0];
+    reader->prefix =
+        exec_sort_prefix(&block->columns[key->column], 0, key->is_descending);
+  }
+  return true;
+}
+
+// The reader holding the smallest head row, NULL once every run is done.
+static SortReader *exec_sort_head(SortState *state) {
+  SortReader *reader = &state->readers[state->tree[0]];
+  return reader->is_done ? NULL : reader;
+}
+
+// Moves the winning reader past its head row and replays its matches.
+static bool exec_sort_advance(ExecContext *ctx, SortState *state) {
+  u32 winner = state->tree[0];
+  SortReader *reader = &state->readers[winner];
+  if (++reader->position == reader->block.count) {
+    if (!exec_sort_read_block(ctx, state, reader)) {
+      return false;
+    }
+  } else {
+    const ExecSortKey *key = &state->keys[0];
+    reader->prefix =
+        exec_sort_prefix(&reader->block.columns[key->column],
+                         reader->position, key->is_descending);
+  }
+  exec_sort_replay(state, winner);
+  return true;
+}
+
+// Whether reader a's head row goes before reader b's. Finished readers go
+// last, and ties go to the earlier run.
+static bool exec_sort_less(const SortState *state, u32 a, u32 b) {
+  const SortReader *x = &state->readers[a];
+  const SortReader *y = &state->readers[b];
+  if (x->is_done != y->is_done) {
+    return y->is_done;
+  }
+  if (!x->is_done && x->prefix != y->prefix) {
+    return x->prefix < y->prefix;
+  }
+  if (!x->is_done && !state->is_prefix_complete) {
+    int cmp = exec_sort_compare_rows(state, &x->block, x->position, &y->block,
+                                     y->position);
+    if (cmp != 0) {
+      return cmp < 0;
+    }
+  }
+  return a < b;
+}
+
+// Plays every match bottom-up. Leaf r is node merge_count + r, and node n
+// plays the winners of nodes 2n and 2n + 1, keeping the loser.
+static void exec_sort_build_tree(SortState *state) {
+  u32 count = state->merge_count;
+  u32 *winners = state->winners;
+  for (u32 r = 0; r < count; ++r) {
+    winners[count + r] = r;
+  }
+  for (u32 node = count - 1; node > 0; --node) {
+    u32 a = winners[2 * node];
+    u32 b = winners[2 * node + 1];
+    bool a_wins = exec_sort_less(state, a, b);
+    winners[node] = a_wins ? a : b;
+    state->tree[node] = a_wins ? b : a;
+  }
+  state->tree[0] = count > 1 ? winners[1] : 0;
+}
+
+// Replays the matches on the path from 'leaf' to the root after its head
+// row changed.
+static void exec_sort_replay(SortState *state, u32 leaf) {
+  u32 winner = leaf;
+  for (u32 node = (state->merge_count + leaf) / 2; node > 0; node /= 2) {
+    if (exec_sort_less(state, state->tree[node], winner)) {
+      u32 loser = winner;
+      winner = state->tree[node];
+      state->tree[node] = loser;
+    }
+  }
+  state->tree[0] = winner;
+}
+
+// Fills the output batch from the final merge. A reader's block can be
+// refilled before the batch is full, so strings are copied into the batch's
+// own buffer.
+static ExecBatch *exec_sort_merge_next(ExecOperator *op) {
+  SortState *state = (SortState *)op->state;
+  ExecContext *ctx = op->ctx;
+  ExecBatch *batch = &state->batch;
+  state->strings.size = 0;
+  u32 count = 0;
+  SortReader *reader;
+  while (count < EXEC_BATCH_SIZE && (reader = exec_sort_head(state)) != NULL) {
+    for (u32 c = 0; c < op->column_count; ++c) {
+      const ExecVector *src = &reader->block.columns[c];
+      ExecVector *dst = &batch->columns[c];
+      if (src->type != EXEC_TYPE_STRING) {
+        dst->i64s[count] = src->i64s[reader->position];
+        continue;
+      }
+      StringView value = src->strings[reader->position];
+      char *data = exec_string_space(ctx, &state->strings, value.length);
+      if (!data) {
+        return NULL;
+      }
+      if (value.length > 0) {
+        memcpy(data, value.data, value.length);
+      }
+      dst->strings[count] = sv_from_parts(data, value.length);
+    }
+    count++;
+    if (!exec_sort_advance(ctx, state)) {
+      return NULL;
+    }
+  }
+  if (count == 0) {
+    return NULL;
+  }
+  batch->row_count = count;
+  batch->selection = NULL;
+  batch->selected_count = count;
+  return batch;
+}
+
+static char *exec_string_space(ExecContext *ctx, ExecStrings *strings,
+                               usize length) {
+  if (!strings->data || strings->size + length > strings->capacity) {
+    usize capacity = MAX(MAX(strings->capacity * 2, length), (usize)4096);
+    strings->data = (char *)exec_alloc(ctx, capacity);
+    if (!strings->data) {
+      strings->capacity = 0;
+      return NULL;
+    }
+    strings->size = 0;
+    strings->capacity = capacity;
+  }
+  char *data = strings->data + strings->size;
+  strings->size += length;
+  return data;
+}
+
+static void exec_sort_close_runs(SortState *state) {
+  for (u32 i = 0; i < state->run_count; ++i) {
+    fclose(state->runs[i]);
+  }
+  state->run_count = 0;
+}
+
+static void exec_sort_close(ExecOperator *op) {
+  exec_sort_close_runs((SortState *)op->state);
+}
+
+// --- Limit ---
+
+static ExecBatch *exec_limit_next(ExecOperator *op) {
+  LimitState *state = (LimitState *)op->state;
+  while (state->limit > 0) {
+    ExecBatch *input = exec_next(op->child);
+    if (!input) {
+      return NULL;
+    }
+    u32 count = input->selected_count;
+    u32 skip = 0;
+    if (state->offset >= count) {
+      state->offset -= count;
+      continue;
+    }
+    skip = (u32)state->offset;
+    state->offset = 0;
+    u32 take = (u32)MIN((u64)(count - skip), state->limit);
+    state->limit -= take;
+    if (state->limit == 0) {
+      exec_close(op->child); // The batch stays valid until the arena reset
+    }
+
+    state->batch = *input;
+    if (input->selection) {
+      state->batch.selection = input->selection + skip;
+    } else if (skip == 0) {
+      state->batch.row_count = take;
+    } else {
+      for (u32 i = 0; i < take; ++i) {
+        state->selection[i] = skip + i;
+      }
+      state->batch.selection = state->selection;
+    }
+    state->batch.selected_count = take;
+    return &state->batch;
+  }
+  return NULL;
+}
+
+// --- Parallel execution ---
+
+// Builds every worker's pipeline in its own arena. The workers are idle
+// between jobs, so their arenas can be used from this thread.
+static ExecWorkerPlan *exec_parallel_plans(ExecContext *ctx,
+                                           Scheduler *scheduler,
+                                           const ExecMorselSource *source) {
+  ASSERT(source->table && source->columns && source->column_count > 0);
+  ExecWorkerPlan *plans = (ExecWorkerPlan *)exec_zalloc(
+      ctx, scheduler->worker_count * sizeof(ExecWorkerPlan));
+  if (!plans) {
+    return NULL;
+  }
+  for (u32 w = 0; w < scheduler->worker_count; ++w) {
+    SchedWorker *worker = &scheduler->workers[w];
+    ExecWorkerPlan *plan = &plans[w];
+    plan->ctx = (ExecContext){.arena = &worker->arena, .has_error = false};
+    ExecOperator *scan = exec_morsel_scan(&plan->ctx, source, worker);
+    plan->pipeline = scan && source->build
+                         ? source->build(&plan->ctx, scan, source->arg)
+                         : scan;
+    if (!plan->pipeline) {
+      ctx->has_error = ctx->has_error || plan->ctx.has_error;
+      return NULL;
+    }
+    ASSERT_MSG(plan->pipeline->column_count ==
+                       plans[0].pipeline->column_count &&
+                   memcmp(plan->pipeline->types, plans[0].pipeline->types,
+                          plan->pipeline->column_count * sizeof(ExecType)) ==
+                       0,
+               "Worker pipelines must have the same output columns");
+  }
+  return plans;
+}
+
+// Runs 'job' on every worker over the morsels of the source table. A failed
+// worker fails the operator.
+static bool exec_parallel_run(ExecOperator *op, SchedJobFn job) {
+  ParallelState *state = (ParallelState *)op->state;
+  if (!sched_run(state->scheduler, state->table->row_count, EXEC_MORSEL_ROWS,
+                 job, state)) {
+    op->ctx->has_error = true;
+    return false;
+  }
+  for (u32 w = 0; w < state->scheduler->worker_count; ++w) {
+    if (state->plans[w].ctx.has_error) {
+      op->ctx->has_error = true;
+      return false;
+    }
+  }
+  state->is_done = true;
+  return true;
+}
+
+static void exec_parallel_scan_job(SchedWorker *worker, void *arg) {
+  ParallelState *state = (ParallelState *)arg;
+  ExecWorkerPlan *plan = &state->plans[worker->index];
+  ExecBatch *batch;
+  while ((batch = exec_next(plan->pipeline)) != NULL) {
+    if (!exec_rows_append(&plan->ctx, &plan->rows, batch->columns, batch)) {
+      return;
+    }
+  }
+}
+
+static void exec_parallel_aggregate_job(SchedWorker *worker, void *arg) {
+  ParallelState *state = (ParallelState *)arg;
+  exec_aggregate_drain(state->plans[worker->index].aggregate);
+}
+
+// Hands out the rows collected by each worker in turn, without copying.
+static ExecBatch *exec_parallel_scan_next(ExecOperator *op) {
+  ParallelState *state = (ParallelState *)op->state;
+  if (!state->is_done && !exec_parallel_run(op, exec_parallel_scan_job)) {
+    return NULL;
+  }
+  u32 worker_count = state->scheduler->worker_count;
+  while (state->worker < worker_count &&
+         state->position >= state->plans[state->worker].rows.count) {
+    state->worker++;
+    state->position = 0;
+  }
+  if (state->worker >= worker_count) {
+    return NULL;
+  }
+  const ExecRows *rows = &state->plans[state->worker].rows;
+  u32 count = (u32)MIN((usize)EXEC_BATCH_SIZE, rows->count - state->position);
+  for (u32 c = 0; c < op->column_count; ++c) {
+    usize size = exec_type_size(rows->columns[c].type);
+    state->batch.columns[c].i64s =
+        (i64 *)((u8 *)rows->columns[c].i64s + state->position * size);
+  }
+  state->batch.row_count = count;
+  state->batch.selection = NULL;
+  state->batch.selected_count = count;
+  state->position += count;
+  return &state->batch;
+}
+
+// Merges every worker's partial groups into those of worker 0, then outputs
+// them like a serial aggregate.
+static ExecBatch *exec_parallel_aggregate_next(ExecOperator *op) {
+  ParallelState *state = (ParallelState *)op->state;
+  ExecOperator *result = state->plans[0].aggregate;
+  if (!state->is_done) {
+    if (!exec_parallel_run(op, exec_parallel_aggregate_job)) {
+      return NULL;
+    }
+    AggregateState *into = (AggregateState *)result->state;
+    for (u32 w = 1; w < state->scheduler->worker_count; ++w) {
+      const ExecOperator *partial = state->plans[w].aggregate;
+      if (!exec_aggregate_merge(result->ctx, into,
+                                (const AggregateState *)partial->state)) {
+        op->ctx->has_error = true;
+        return NULL;
+      }
+    }
+    exec_aggregate_finish(into);
+  }
+  return exec_aggregate_next(result);
+}
+
+// Closes every worker's pipeline, which the workers may have left undrained
+// after an error.
+static void exec_parallel_close(ExecOperator *op) {
+  ParallelState *state = (ParallelState *)op->state;
+  if (!state->plans) {
+    return;
+  }
+  for (u32 w = 0; w < state->scheduler->worker_count; ++w) {
+    exec_close(state->plans[w].aggregate);
+    exec_close(state->plans[w].pipeline);
+  }
+}
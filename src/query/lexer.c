@@ -0,0 +1,357 @@
+#include "sqldb/lexer.h"
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+typedef struct {
+  const char *text; // Upper case
+  TokenKind kind;
+} Keyword;
+
+// Sorted by text for binary search.
+static const Keyword keywords[] = {
+    {"AND", TOKEN_KW_AND},         {"AS", TOKEN_KW_AS},
+    {"ASC", TOKEN_KW_ASC},         {"BIGINT", TOKEN_KW_BIGINT},
+    {"BOOLEAN", TOKEN_KW_BOOLEAN}, {"BY", TOKEN_KW_BY},
+    {"CREATE", TOKEN_KW_CREATE},   {"DELETE", TOKEN_KW_DELETE},
+    {"DESC", TOKEN_KW_DESC},       {"DISTINCT", TOKEN_KW_DISTINCT},
+    {"DOUBLE", TOKEN_KW_DOUBLE},   {"EXISTS", TOKEN_KW_EXISTS},
+    {"FALSE", TOKEN_KW_FALSE},     {"FLOAT", TOKEN_KW_FLOAT},
+    {"FROM", TOKEN_KW_FROM},       {"GROUP", TOKEN_KW_GROUP},
+    {"HAVING", TOKEN_KW_HAVING},   {"IF", TOKEN_KW_IF},
+    {"INNER", TOKEN_KW_INNER},     {"INSERT", TOKEN_KW_INSERT},
+    {"INT", TOKEN_KW_INT},         {"INTEGER", TOKEN_KW_INTEGER},
+    {"INTO", TOKEN_KW_INTO},       {"IS", TOKEN_KW_IS},
+    {"JOIN", TOKEN_KW_JOIN},       {"KEY", TOKEN_KW_KEY},
+    {"LEFT", TOKEN_KW_LEFT},       {"LIMIT", TOKEN_KW_LIMIT},
+    {"NOT", TOKEN_KW_NOT},         {"NULL", TOKEN_KW_NULL},
+    {"OFFSET", TOKEN_KW_OFFSET},   {"ON", TOKEN_KW_ON},
+    {"OR", TOKEN_KW_OR},           {"ORDER", TOKEN_KW_ORDER},
+    {"OUTER", TOKEN_KW_OUTER},     {"PRIMARY", TOKEN_KW_PRIMARY},
+    {"REAL", TOKEN_KW_REAL},       {"SELECT", TOKEN_KW_SELECT},
+    {"SET", TOKEN_KW_SET},         {"TABLE", TOKEN_KW_TABLE},
+    {"TEXT", TOKEN_KW_TEXT},       {"TRUE", TOKEN_KW_TRUE},
+    {"UPDATE", TOKEN_KW_UPDATE},   {"VALUES", TOKEN_KW_VALUES},
+    {"VARCHAR", TOKEN_KW_VARCHAR}, {"WHERE", TOKEN_KW_WHERE},
+};
+
+static bool lexer_is_ident_start(char c);
+static bool lexer_is_ident_char(char c);
+static bool lexer_is_digit(char c);
+static char lexer_peek(const Lexer *lexer, usize ahead);
+static void lexer_skip_trivia(Lexer *lexer);
+static Token lexer_make(const Lexer *lexer, TokenKind kind, usize start);
+static Token lexer_fail(Lexer *lexer, usize start, const char *error);
+static Token lexer_number(Lexer *lexer, usize start);
+static Token lexer_quoted(Lexer *lexer, usize start, char quote);
+static TokenKind lexer_keyword(StringView text);
+static int lexer_keyword_compare(StringView text, const char *keyword);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void lexer_init(Lexer *lexer, StringView source) {
+  ASSERT(lexer);
+  *lexer = (Lexer){.source = source};
+}
+
+Token lexer_next(Lexer *lexer) {
+  ASSERT(lexer);
+  lexer_skip_trivia(lexer);
+  usize start = lexer->position;
+  if (start >= lexer->source.length) {
+    return lexer_make(lexer, TOKEN_EOF, start);
+  }
+
+  char c = lexer->source.data[lexer->position++];
+  if (lexer_is_ident_start(c)) {
+    while (lexer_is_ident_char(lexer_peek(lexer, 0))) {
+      lexer->position++;
+    }
+    Token token = lexer_make(lexer, TOKEN_IDENTIFIER, start);
+    if (!lexer->skip_keywords) {
+      token.kind = lexer_keyword(token.text);
+    }
+    return token;
+  }
+  if (lexer_is_digit(c) || (c == '.' && lexer_is_digit(lexer_peek(lexer, 0)))) {
+    return lexer_number(lexer, start);
+  }
+
+  switch (c) {
+  case '\'':
+  case '"':
+    return lexer_quoted(lexer, start, c);
+  case '(':
+    return lexer_make(lexer, TOKEN_LEFT_PAREN, start);
+  case ')':
+    return lexer_make(lexer, TOKEN_RIGHT_PAREN, start);
+  case ',':
+    return lexer_make(lexer, TOKEN_COMMA, start);
+  case ';':
+    return lexer_make(lexer, TOKEN_SEMICOLON, start);
+  case '?':
+    return lexer_make(lexer, TOKEN_PARAMETER, start);
+  case '$':
+    // PostgreSQL-style $n placeholder; the number stays in the token text.
+    if (!lexer_is_digit(lexer_peek(lexer, 0))) {
+      return lexer_fail(lexer, start, "expected a number after '$'");
+    }
+    while (lexer_is_digit(lexer_peek(lexer, 0))) {
+      lexer->position++;
+    }
+    return lexer_make(lexer, TOKEN_PARAMETER, start);
+  case '.':
+    return lexer_make(lexer, TOKEN_DOT, start);
+  case '*':
+    return lexer_make(lexer, TOKEN_STAR, start);
+  case '+':
+    return lexer_make(lexer, TOKEN_PLUS, start);
+  case '-':
+    return lexer_make(lexer, TOKEN_MINUS, start);
+  case '/':
+    return lexer_make(lexer, TOKEN_SLASH, start);
+  case '%':
+    return lexer_make(lexer, TOKEN_PERCENT, start);
+  case '=':
+    return lexer_make(lexer, TOKEN_EQUAL, start);
+  case '!':
+    if (lexer_peek(lexer, 0) == '=') {
+      lexer->position++;
+      return lexer_make(lexer, TOKEN_NOT_EQUAL, start);
+    }
+    return lexer_fail(lexer, start, "expected '=' after '!'");
+  case '<':
+    if (lexer_peek(lexer, 0) == '=') {
+      lexer->position++;
+      return lexer_make(lexer, TOKEN_LESS_EQUAL, start);
+    }
+    if (lexer_peek(lexer, 0) == '>') {
+      lexer->position++;
+      return lexer_make(lexer, TOKEN_NOT_EQUAL, start);
+    }
+    return lexer_make(lexer, TOKEN_LESS, start);
+  case '>':
+    if (lexer_peek(lexer, 0) == '=') {
+      lexer->position++;
+      return lexer_make(lexer, TOKEN_GREATER_EQUAL, start);
+    }
+    return lexer_make(lexer, TOKEN_GREATER, start);
+  default:
+    return lexer_fail(lexer, start, "unexpected character");
+  }
+}
+
+const char *token_kind_name(TokenKind kind) {
+  switch (kind) {
+  case TOKEN_EOF:
+    return "end of input";
+  case TOKEN_ERROR:
+    return "invalid token";
+  case TOKEN_IDENTIFIER:
+    return "identifier";
+  case TOKEN_INTEGER:
+    return "integer";
+  case TOKEN_FLOAT:
+    return "number";
+  case TOKEN_STRING:
+    return "string";
+  case TOKEN_PARAMETER:
+    return "parameter";
+  case TOKEN_LEFT_PAREN:
+    return "'('";
+  case TOKEN_RIGHT_PAREN:
+    return "')'";
+  case TOKEN_COMMA:
+    return "','";
+  case TOKEN_SEMICOLON:
+    return "';'";
+  case TOKEN_DOT:
+    return "'.'";
+  case TOKEN_STAR:
+    return "'*'";
+  case TOKEN_PLUS:
+    return "'+'";
+  case TOKEN_MINUS:
+    return "'-'";
+  case TOKEN_SLASH:
+    return "'/'";
+  case TOKEN_PERCENT:
+    return "'%'";
+  case TOKEN_EQUAL:
+    return "'='";
+  case TOKEN_NOT_EQUAL:
+    return "'<>'";
+  case TOKEN_LESS:
+    return "'<'";
+  case TOKEN_LESS_EQUAL:
+    return "'<='";
+  case TOKEN_GREATER:
+    return "'>'";
+  case TOKEN_GREATER_EQUAL:
+    return "'>='";
+  default:
+    break;
+  }
+  for (usize i = 0; i < ARRAY_SIZE(keywords); ++i) {
+    if (keywords[i].kind == kind) {
+      return keywords[i].text;
+    }
+  }
+  return "unknown";
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool lexer_is_ident_start(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool lexer_is_ident_char(char c) {
+  return lexer_is_ident_start(c) || lexer_is_digit(c);
+}
+
+static bool lexer_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Returns '\0' past the end, which no token continues with.
+static char lexer_peek(const Lexer *lexer, usize ahead) {
+  usize position = lexer->position + ahead;
+  return position < lexer->source.length ? lexer->source.data[position] : '\0';
+}
+
+static void lexer_skip_trivia(Lexer *lexer) {
+  for (;;) {
+    char c = lexer_peek(lexer, 0);
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      lexer->position++;
+    } else if (c == '-' && lexer_peek(lexer, 1) == '-') {
+      while (lexer->position < lexer->source.length &&
+             lexer->source.data[lexer->position] != '\n') {
+        lexer->position++;
+      }
+    } else if (c == '/' && lexer_peek(lexer, 1) == '*') {
+      // An unterminated block comment runs to the end of the input.
+      lexer->position += 2;
+      while (lexer->position < lexer->source.length &&
+             !(lexer_peek(lexer, 0) == '*' && lexer_peek(lexer, 1) == '/')) {
+        lexer->position++;
+      }
+      lexer->position = MIN(lexer->position + 2, lexer->source.length);
+    } else {
+      return;
+    }
+  }
+}
+
+static Token lexer_make(const Lexer *lexer, TokenKind kind, usize start) {
+  return (Token){
+      .kind = kind,
+      .text = sv_from_parts(lexer->source.data + start,
+                            lexer->position - start),
+      .offset = (u32)start,
+  };
+}
+
+static Token lexer_fail(Lexer *lexer, usize start, const char *error) {
+  lexer->error = error;
+  return lexer_make(lexer, TOKEN_ERROR, start);
+}
+
+static Token lexer_number(Lexer *lexer, usize start) {
+  TokenKind kind = lexer->source.data[start] == '.' ? TOKEN_FLOAT
+                                                    : TOKEN_INTEGER;
+  while (lexer_is_digit(lexer_peek(lexer, 0))) {
+    lexer->position++;
+  }
+  if (kind == TOKEN_INTEGER && lexer_peek(lexer, 0) == '.') {
+    kind = TOKEN_FLOAT;
+    lexer->position++;
+    while (lexer_is_digit(lexer_peek(lexer, 0))) {
+      lexer->position++;
+    }
+  }
+  char e = lexer_peek(lexer, 0);
+  if (e == 'e' || e == 'E') {
+    usize sign = lexer_peek(lexer, 1) == '+' || lexer_peek(lexer, 1) == '-';
+    if (!lexer_is_digit(lexer_peek(lexer, 1 + sign))) {
+      lexer->position++;
+      return lexer_fail(lexer, start, "malformed exponent");
+    }
+    kind = TOKEN_FLOAT;
+    lexer->position += 1 + sign;
+    while (lexer_is_digit(lexer_peek(lexer, 0))) {
+      lexer->position++;
+    }
+  }
+  if (lexer_is_ident_start(lexer_peek(lexer, 0))) {
+    return lexer_fail(lexer, start, "malformed number");
+  }
+  return lexer_make(lexer, kind, start);
+}
+
+// 'string' or "identifier". A doubled quote stands for one quote character
+// and does not end the token; it stays doubled in the token text.
+static Token lexer_quoted(Lexer *lexer, usize start, char quote) {
+  for (;;) {
+    if (lexer->position >= lexer->source.length) {
+      return lexer_fail(lexer, start, quote == '\''
+                                          ? "unterminated string literal"
+                                          : "unterminated quoted identifier");
+    }
+    char c = lexer->source.data[lexer->position++];
+    if (c == quote) {
+      if (lexer_peek(lexer, 0) != quote) {
+        break;
+      }
+      lexer->position++;
+    }
+  }
+  Token token = lexer_make(lexer, quote == '\'' ? TOKEN_STRING
+                                                : TOKEN_IDENTIFIER,
+                           start);
+  token.text = sv_from_parts(token.text.data + 1, token.text.length - 2);
+  if (token.kind == TOKEN_IDENTIFIER && token.text.length == 0) {
+    return lexer_fail(lexer, start, "empty quoted identifier");
+  }
+  return token;
+}
+
+static TokenKind lexer_keyword(StringView text) {
+  usize low = 0;
+  usize high = ARRAY_SIZE(keywords);
+  while (low < high) {
+    usize mid = low + (high - low) / 2;
+    int cmp = lexer_keyword_compare(text, keywords[mid].text);
+    if (cmp == 0) {
+      return keywords[mid].kind;
+    }
+    if (cmp < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return TOKEN_IDENTIFIER;
+}
+
+// Compares identifier text, folded to upper case, with an upper case keyword.
+static int lexer_keyword_compare(StringView text, const char *keyword) {
+  usize i = 0;
+  for (; i < text.length && keyword[i]; ++i) {
+    char c = text.data[i];
+    if (c >= 'a' && c <= 'z') {
+      c = (char)(c - 'a' + 'A');
+    }
+    if (c != keyword[i]) {
+      return (uchar)c < (uchar)keyword[i] ? -1 : 1;
+    }
+  }
+  if (i < text.length) {
+    return 1;
+  }
+  return keyword[i] ? -1 : 0;
+}
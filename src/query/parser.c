@@ -0,0 +1,840 @@
+#include "sqldb/parser.h"
+
+#include <stdarg.h>
+
+// =================================================================================================
+// :: Private Types ::
+// =================================================================================================
+
+typedef struct {
+  Lexer lexer;
+  Token current; // Next token to consume
+  Arena *arena;
+  SqlParseError *error;
+  u32 parameter_count; // ? placeholders seen so far
+  u32 depth;           // Expression nesting, up to SQL_MAX_EXPR_DEPTH
+  bool has_error;      // Only the first error is reported
+} Parser;
+
+// Binding strength of operators, loosest first.
+typedef enum {
+  PREC_OR = 1,
+  PREC_AND,
+  PREC_NOT,
+  PREC_COMPARISON,
+  PREC_ADDITIVE,
+  PREC_MULTIPLICATIVE,
+  PREC_UNARY,
+} Precedence;
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static void parser_advance(Parser *p);
+static bool parser_check(const Parser *p, TokenKind kind);
+static bool parser_match(Parser *p, TokenKind kind);
+static bool parser_expect(Parser *p, TokenKind kind);
+static void parser_error(Parser *p, Token token, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+static void *parser_alloc(Parser *p, usize size);
+static bool parser_is_name(TokenKind kind);
+static bool parser_name(Parser *p, StringView *out_name);
+static bool parser_alias(Parser *p, StringView *out_alias);
+
+static AstExpr *parse_expr(Parser *p);
+static AstExpr *parse_binary(Parser *p, Precedence min_prec);
+static AstExpr *parse_binary_ops(Parser *p, Precedence min_prec);
+static AstExpr *parse_prefix(Parser *p);
+static AstExpr *parse_primary(Parser *p);
+static AstExpr *parse_number(Parser *p, Token token);
+static AstExpr *parse_name_expr(Parser *p);
+static AstExpr *parse_expr_list(Parser *p, u32 *out_count);
+static Precedence parse_binary_op(TokenKind kind, AstOperator *out_op);
+static AstExpr *parser_new_expr(Parser *p, AstExprKind kind, u32 offset);
+
+static bool parse_select(Parser *p, AstSelect *select);
+static bool parse_select_items(Parser *p, AstSelect *select);
+static bool parse_from(Parser *p, AstSelect *select);
+static bool parse_order_by(Parser *p, AstSelect *select);
+static bool parse_insert(Parser *p, AstInsert *insert);
+static bool parse_update(Parser *p, AstUpdate *update);
+static bool parse_delete(Parser *p, AstDelete *delete);
+static bool parse_create_table(Parser *p, AstCreateTable *create);
+static bool parse_column_def(Parser *p, AstColumnDef *column);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+AstStatement *sql_parse(Arena *arena, StringView sql, SqlParseError *out_error) {
+  ASSERT(arena && out_error);
+  Parser p = {.arena = arena, .error = out_error};
+  ZERO_STRUCT(*out_error);
+  lexer_init(&p.lexer, sql);
+  parser_advance(&p);
+
+  AstStatement *stmt = (AstStatement *)parser_alloc(&p, sizeof(AstStatement));
+  if (!stmt) {
+    return NULL;
+  }
+  bool ok;
+  switch (p.current.kind) {
+  case TOKEN_KW_SELECT:
+    stmt->kind = AST_STMT_SELECT;
+    ok = parse_select(&p, &stmt->select);
+    break;
+  case TOKEN_KW_INSERT:
+    stmt->kind = AST_STMT_INSERT;
+    ok = parse_insert(&p, &stmt->insert);
+    break;
+  case TOKEN_KW_UPDATE:
+    stmt->kind = AST_STMT_UPDATE;
+    ok = parse_update(&p, &stmt->update);
+    break;
+  case TOKEN_KW_DELETE:
+    stmt->kind = AST_STMT_DELETE;
+    ok = parse_delete(&p, &stmt->delete);
+    break;
+  case TOKEN_KW_CREATE:
+    stmt->kind = AST_STMT_CREATE_TABLE;
+    ok = parse_create_table(&p, &stmt->create_table);
+    break;
+  default:
+    parser_error(&p, p.current, "expected a statement, found %s",
+                 token_kind_name(p.current.kind));
+    return NULL;
+  }
+
+  stmt->parameter_count = p.parameter_count;
+  if (ok) {
+    parser_match(&p, TOKEN_SEMICOLON);
+    if (!parser_check(&p, TOKEN_EOF)) {
+      parser_error(&p, p.current, "unexpected %s after the statement",
+                   token_kind_name(p.current.kind));
+    }
+  }
+  return p.has_error ? NULL : stmt;
+}
+
+// =================================================================================================
+// :: AST API ::
+// =================================================================================================
+
+const char *ast_statement_kind_name(AstStatementKind kind) {
+  switch (kind) {
+  case AST_STMT_SELECT:
+    return "SELECT";
+  case AST_STMT_INSERT:
+    return "INSERT";
+  case AST_STMT_UPDATE:
+    return "UPDATE";
+  case AST_STMT_DELETE:
+    return "DELETE";
+  case AST_STMT_CREATE_TABLE:
+    return "CREATE TABLE";
+  }
+  return "unknown";
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static void parser_advance(Parser *p) {
+  p->current = lexer_next(&p->lexer);
+  if (p->current.kind == TOKEN_ERROR) {
+    parser_error(p, p->current, "%s", p->lexer.error);
+  }
+}
+
+static bool parser_check(const Parser *p, TokenKind kind) {
+  return p->current.kind == kind;
+}
+
+static bool parser_match(Parser *p, TokenKind kind) {
+  if (p->current.kind != kind) {
+    return false;
+  }
+  parser_advance(p);
+  return true;
+}
+
+static bool parser_expect(Parser *p, TokenKind kind) {
+  if (parser_match(p, kind)) {
+    return true;
+  }
+  parser_error(p, p->current, "expected %s, found %s", token_kind_name(kind),
+               token_kind_name(p->current.kind));
+  return false;
+}
+
+static void parser_error(Parser *p, Token token, const char *fmt, ...) {
+  if (p->has_error) {
+    return;
+  }
+  p->has_error = true;
+  SqlParseError *error = p->error;
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(error->message, sizeof(error->message), fmt, args);
+  va_end(args);
+
+  error->offset = token.offset;
+  error->line = 1;
+  error->column = 1;
+  const char *source = p->lexer.source.data;
+  for (u32 i = 0; i < token.offset; ++i) {
+    if (source[i] == '\n') {
+      error->line++;
+      error->column = 1;
+    } else {
+      error->column++;
+    }
+  }
+}
+
+static void *parser_alloc(Parser *p, usize size) {
+  void *ptr = arena_alloc(p->arena, size);
+  if (!ptr) {
+    parser_error(p, p->current, "out of memory while parsing");
+    return NULL;
+  }
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+// Type names and other non-reserved keywords double as identifiers, so
+// columns can be called e.g. "key" or "text" without quoting.
+static bool parser_is_name(TokenKind kind) {
+  switch (kind) {
+  case TOKEN_IDENTIFIER:
+  case TOKEN_KW_BIGINT:
+  case TOKEN_KW_BOOLEAN:
+  case TOKEN_KW_DOUBLE:
+  case TOKEN_KW_FLOAT:
+  case TOKEN_KW_INT:
+  case TOKEN_KW_INTEGER:
+  case TOKEN_KW_KEY:
+  case TOKEN_KW_REAL:
+  case TOKEN_KW_TEXT:
+  case TOKEN_KW_VARCHAR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool parser_name(Parser *p, StringView *out_name) {
+  if (!parser_is_name(p->current.kind)) {
+    parser_error(p, p->current, "expected a name, found %s",
+                 token_kind_name(p->current.kind));
+    return false;
+  }
+  *out_name = p->current.text;
+  parser_advance(p);
+  return true;
+}
+
+// [AS] alias. Without AS only a plain identifier is taken, so that keywords
+// such as JOIN or WHERE end the clause instead.
+static bool parser_alias(Parser *p, StringView *out_alias) {
+  if (parser_match(p, TOKEN_KW_AS)) {
+    return parser_name(p, out_alias);
+  }
+  if (parser_check(p, TOKEN_IDENTIFIER)) {
+    *out_alias = p->current.text;
+    parser_advance(p);
+  }
+  return true;
+}
+
+// --- Expressions ---
+
+static AstExpr *parse_expr(Parser *p) { return parse_binary(p, PREC_OR); }
+
+// Every recursion (parentheses, prefix operators, right operands) passes
+// through here, so bounding it here keeps hostile input off the stack.
+static AstExpr *parse_binary(Parser *p, Precedence min_prec) {
+  if (p->depth >= SQL_MAX_EXPR_DEPTH) {
+    parser_error(p, p->current, "expression nested too deeply");
+    return NULL;
+  }
+  p->depth++;
+  AstExpr *expr = parse_binary_ops(p, min_prec);
+  p->depth--;
+  return expr;
+}
+
+// Precedence climbing: parses operators binding at least as tightly as
+// 'min_prec'. Binary operators are left associative.
+static AstExpr *parse_binary_ops(Parser *p, Precedence min_prec) {
+  AstExpr *left = parse_prefix(p);
+  while (left) {
+    Token token = p->current;
+    if (token.kind == TOKEN_KW_IS) {
+      if (PREC_COMPARISON < min_prec) {
+        break;
+      }
+      parser_advance(p);
+      AstExpr *expr = parser_new_expr(p, AST_EXPR_IS_NULL, token.offset);
+      if (!expr) {
+        return NULL;
+      }
+      expr->is_null.operand = left;
+      expr->is_null.is_not = parser_match(p, TOKEN_KW_NOT);
+      if (!parser_expect(p, TOKEN_KW_NULL)) {
+        return NULL;
+      }
+      left = expr;
+      continue;
+    }
+
+    AstOperator op;
+    Precedence prec = parse_binary_op(token.kind, &op);
+    if (prec == 0 || prec < min_prec) {
+      break;
+    }
+    parser_advance(p);
+    AstExpr *right = parse_binary(p, (Precedence)(prec + 1));
+    AstExpr *expr = parser_new_expr(p, AST_EXPR_BINARY, token.offset);
+    if (!right || !expr) {
+      return NULL;
+    }
+    expr->binary.op = op;
+    expr->binary.left = left;
+    expr->binary.right = right;
+    left = expr;
+  }
+  return left;
+}
+
+static AstExpr *parse_prefix(Parser *p) {
+  Token token = p->current;
+  AstOperator op;
+  Precedence operand_prec;
+  if (token.kind == TOKEN_KW_NOT) {
+    op = AST_OP_NOT;
+    operand_prec = PREC_NOT;
+  } else if (token.kind == TOKEN_MINUS) {
+    op = AST_OP_NEGATE;
+    operand_prec = PREC_UNARY;
+  } else if (token.kind == TOKEN_PLUS) {
+    parser_advance(p);
+    return parse_binary(p, PREC_UNARY);
+  } else {
+    return parse_primary(p);
+  }
+
+  parser_advance(p);
+  AstExpr *operand = parse_binary(p, operand_prec);
+  if (!operand) {
+    return NULL;
+  }
+  // Fold negative literals, so that -5 is a constant like 5.
+  if (op == AST_OP_NEGATE && operand->kind == AST_EXPR_INTEGER) {
+    operand->integer = -operand->integer;
+    operand->offset = token.offset;
+    return operand;
+  }
+  if (op == AST_OP_NEGATE && operand->kind == AST_EXPR_FLOAT) {
+    operand->real = -operand->real;
+    operand->offset = token.offset;
+    return operand;
+  }
+  AstExpr *expr = parser_new_expr(p, AST_EXPR_UNARY, token.offset);
+  if (!expr) {
+    return NULL;
+  }
+  expr->unary.op = op;
+  expr->unary.operand = operand;
+  return expr;
+}
+
+static AstExpr *parse_primary(Parser *p) {
+  Token token = p->current;
+  AstExpr *expr;
+  switch (token.kind) {
+  case TOKEN_INTEGER:
+  case TOKEN_FLOAT:
+    parser_advance(p);
+    return parse_number(p, token);
+  case TOKEN_STRING:
+    expr = parser_new_expr(p, AST_EXPR_STRING, token.offset);
+    if (expr) {
+      expr->string = token.text;
+      parser_advance(p);
+    }
+    return expr;
+  case TOKEN_KW_TRUE:
+  case TOKEN_KW_FALSE:
+    expr = parser_new_expr(p, AST_EXPR_BOOLEAN, token.offset);
+    if (expr) {
+      expr->boolean = token.kind == TOKEN_KW_TRUE;
+      parser_advance(p);
+    }
+    return expr;
+  case TOKEN_KW_NULL:
+    parser_advance(p);
+    return parser_new_expr(p, AST_EXPR_NULL, token.offset);
+  case TOKEN_PARAMETER:
+    expr = parser_new_expr(p, AST_EXPR_PARAMETER, token.offset);
+    if (expr) {
+      expr->parameter = p->parameter_count++;
+      parser_advance(p);
+    }
+    return expr;
+  case TOKEN_STAR:
+    parser_advance(p);
+    return parser_new_expr(p, AST_EXPR_STAR, token.offset);
+  case TOKEN_LEFT_PAREN:
+    parser_advance(p);
+    expr = parse_expr(p);
+    return expr && parser_expect(p, TOKEN_RIGHT_PAREN) ? expr : NULL;
+  default:
+    if (parser_is_name(token.kind)) {
+      return parse_name_expr(p);
+    }
+    parser_error(p, token, "expected an expression, found %s",
+                 token_kind_name(token.kind));
+    return NULL;
+  }
+}
+
+// The lexer only hands out digits (and '.', 'e', sign) here, so integers are
+// converted in place; floats need a NUL-terminated copy for strtod.
+static AstExpr *parse_number(Parser *p, Token token) {
+  AstExpr *expr = parser_new_expr(
+      p, token.kind == TOKEN_INTEGER ? AST_EXPR_INTEGER : AST_EXPR_FLOAT,
+      token.offset);
+  if (!expr) {
+    return NULL;
+  }
+  if (token.kind == TOKEN_INTEGER) {
+    u64 value = 0;
+    for (usize i = 0; i < token.text.length; ++i) {
+      u64 digit = (u64)(token.text.data[i] - '0');
+      if (value > ((u64)INT64_MAX - digit) / 10) {
+        parser_error(p, token, "integer literal out of range");
+        return NULL;
+      }
+      value = value * 10 + digit;
+    }
+    expr->integer = (i64)value;
+    return expr;
+  }
+  char buffer[64];
+  if (token.text.length >= sizeof(buffer)) {
+    parser_error(p, token, "numeric literal too long");
+    return NULL;
+  }
+  memcpy(buffer, token.text.data, token.text.length);
+  buffer[token.text.length] = '\0';
+  expr->real = strtod(buffer, NULL);
+  return expr;
+}
+
+// column, table.column, table.* or function(args).
+static AstExpr *parse_name_expr(Parser *p) {
+  Token token = p->current;
+  parser_advance(p);
+
+  if (parser_match(p, TOKEN_LEFT_PAREN)) {
+    AstExpr *expr = parser_new_expr(p, AST_EXPR_FUNCTION, token.offset);
+    if (!expr) {
+      return NULL;
+    }
+    expr->function.name = token.text;
+    if (parser_check(p, TOKEN_STAR)) {
+      expr->function.args = parse_primary(p);
+      expr->function.arg_count = 1;
+    } else if (!parser_check(p, TOKEN_RIGHT_PAREN)) {
+      expr->function.is_distinct = parser_match(p, TOKEN_KW_DISTINCT);
+      expr->function.args = parse_expr_list(p, &expr->function.arg_count);
+      if (!expr->function.args) {
+        return NULL;
+      }
+    }
+    return parser_expect(p, TOKEN_RIGHT_PAREN) ? expr : NULL;
+  }
+
+  AstExpr *expr = parser_new_expr(p, AST_EXPR_COLUMN, token.offset);
+  if (!expr) {
+    return NULL;
+  }
+  expr->column.name = token.text;
+  if (parser_match(p, TOKEN_DOT)) {
+    expr->column.table = token.text;
+    if (parser_match(p, TOKEN_STAR)) {
+      expr->kind = AST_EXPR_STAR;
+      expr->column.name = sv_from_parts(NULL, 0);
+    } else if (!parser_name(p, &expr->column.name)) {
+      return NULL;
+    }
+  }
+  return expr;
+}
+
+static AstExpr *parse_expr_list(Parser *p, u32 *out_count) {
+  AstExpr *head = NULL;
+  AstExpr **tail = &head;
+  *out_count = 0;
+  do {
+    AstExpr *expr = parse_expr(p);
+    if (!expr) {
+      return NULL;
+    }
+    *tail = expr;
+    tail = &expr->next;
+    (*out_count)++;
+  } while (parser_match(p, TOKEN_COMMA));
+  return head;
+}
+
+static Precedence parse_binary_op(TokenKind kind, AstOperator *out_op) {
+  switch (kind) {
+  case TOKEN_KW_OR:
+    *out_op = AST_OP_OR;
+    return PREC_OR;
+  case TOKEN_KW_AND:
+    *out_op = AST_OP_AND;
+    return PREC_AND;
+  case TOKEN_EQUAL:
+    *out_op = AST_OP_EQUAL;
+    return PREC_COMPARISON;
+  case TOKEN_NOT_EQUAL:
+    *out_op = AST_OP_NOT_EQUAL;
+    return PREC_COMPARISON;
+  case TOKEN_LESS:
+    *out_op = AST_OP_LESS;
+    return PREC_COMPARISON;
+  case TOKEN_LESS_EQUAL:
+    *out_op = AST_OP_LESS_EQUAL;
+    return PREC_COMPARISON;
+  case TOKEN_GREATER:
+    *out_op = AST_OP_GREATER;
+    return PREC_COMPARISON;
+  case TOKEN_GREATER_EQUAL:
+    *out_op = AST_OP_GREATER_EQUAL;
+    return PREC_COMPARISON;
+  case TOKEN_PLUS:
+    *out_op = AST_OP_ADD;
+    return PREC_ADDITIVE;
+  case TOKEN_MINUS:
+    *out_op = AST_OP_SUBTRACT;
+    return PREC_ADDITIVE;
+  case TOKEN_STAR:
+    *out_op = AST_OP_MULTIPLY;
+    return PREC_MULTIPLICATIVE;
+  case TOKEN_SLASH:
+    *out_op = AST_OP_DIVIDE;
+    return PREC_MULTIPLICATIVE;
+  case TOKEN_PERCENT:
+    *out_op = AST_OP_MODULO;
+    return PREC_MULTIPLICATIVE;
+  default:
+    return (Precedence)0;
+  }
+}
+
+static AstExpr *parser_new_expr(Parser *p, AstExprKind kind, u32 offset) {
+  AstExpr *expr = (AstExpr *)parser_alloc(p, sizeof(AstExpr));
+  if (expr) {
+    expr->kind = kind;
+    expr->offset = offset;
+  }
+  return expr;
+}
+
+// --- Statements ---
+
+static bool parse_select(Parser *p, AstSelect *select) {
+  parser_advance(p); // SELECT
+  select->is_distinct = parser_match(p, TOKEN_KW_DISTINCT);
+  if (!parse_select_items(p, select)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_FROM) && !parse_from(p, select)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_WHERE) && !(select->where = parse_expr(p))) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_GROUP)) {
+    if (!parser_expect(p, TOKEN_KW_BY) ||
+        !(select->group_by = parse_expr_list(p, &select->group_by_count))) {
+      return false;
+    }
+    if (parser_match(p, TOKEN_KW_HAVING) &&
+        !(select->having = parse_expr(p))) {
+      return false;
+    }
+  }
+  if (parser_match(p, TOKEN_KW_ORDER) && !parse_order_by(p, select)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_LIMIT)) {
+    if (!(select->limit = parse_expr(p))) {
+      return false;
+    }
+    if (parser_match(p, TOKEN_KW_OFFSET) &&
+        !(select->offset = parse_expr(p))) {
+      return false;
+    }
+  }
+  return !p->has_error;
+}
+
+static bool parse_select_items(Parser *p, AstSelect *select) {
+  AstSelectItem **tail = &select->items;
+  do {
+    AstSelectItem *item =
+        (AstSelectItem *)parser_alloc(p, sizeof(AstSelectItem));
+    if (!item || !(item->expr = parse_expr(p))) {
+      return false;
+    }
+    if (item->expr->kind != AST_EXPR_STAR &&
+        !parser_alias(p, &item->alias)) {
+      return false;
+    }
+    *tail = item;
+    tail = &item->next;
+    select->item_count++;
+  } while (parser_match(p, TOKEN_COMMA));
+  return true;
+}
+
+static bool parse_from(Parser *p, AstSelect *select) {
+  AstTableRef **tail = &select->from;
+  AstJoinKind join = AST_JOIN_NONE;
+  for (;;) {
+    AstTableRef *table = (AstTableRef *)parser_alloc(p, sizeof(AstTableRef));
+    if (!table || !parser_name(p, &table->name) ||
+        !parser_alias(p, &table->alias)) {
+      return false;
+    }
+    table->join = join;
+    if (join == AST_JOIN_INNER || join == AST_JOIN_LEFT) {
+      if (!parser_expect(p, TOKEN_KW_ON) || !(table->on = parse_expr(p))) {
+        return false;
+      }
+    }
+    *tail = table;
+    tail = &table->next;
+    select->from_count++;
+
+    if (parser_match(p, TOKEN_COMMA)) {
+      join = AST_JOIN_CROSS;
+    } else if (parser_match(p, TOKEN_KW_JOIN)) {
+      join = AST_JOIN_INNER;
+    } else if (parser_match(p, TOKEN_KW_INNER)) {
+      join = AST_JOIN_INNER;
+      if (!parser_expect(p, TOKEN_KW_JOIN)) {
+        return false;
+      }
+    } else if (parser_match(p, TOKEN_KW_LEFT)) {
+      join = AST_JOIN_LEFT;
+      parser_match(p, TOKEN_KW_OUTER);
+      if (!parser_expect(p, TOKEN_KW_JOIN)) {
+        return false;
+      }
+    } else {
+      return true;
+    }
+  }
+}
+
+static bool parse_order_by(Parser *p, AstSelect *select) {
+  if (!parser_expect(p, TOKEN_KW_BY)) {
+    return false;
+  }
+  AstOrderItem **tail = &select->order_by;
+  do {
+    AstOrderItem *item = (AstOrderItem *)parser_alloc(p, sizeof(AstOrderItem));
+    if (!item || !(item->expr = parse_expr(p))) {
+      return false;
+    }
+    if (!parser_match(p, TOKEN_KW_ASC)) {
+      item->is_descending = parser_match(p, TOKEN_KW_DESC);
+    }
+    *tail = item;
+    tail = &item->next;
+    select->order_by_count++;
+  } while (parser_match(p, TOKEN_COMMA));
+  return true;
+}
+
+static bool parse_insert(Parser *p, AstInsert *insert) {
+  parser_advance(p); // INSERT
+  if (!parser_expect(p, TOKEN_KW_INTO) || !parser_name(p, &insert->table)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_LEFT_PAREN)) {
+    AstName **tail = &insert->columns;
+    do {
+      AstName *column = (AstName *)parser_alloc(p, sizeof(AstName));
+      if (!column || !parser_name(p, &column->name)) {
+        return false;
+      }
+      *tail = column;
+      tail = &column->next;
+      insert->column_count++;
+    } while (parser_match(p, TOKEN_COMMA));
+    if (!parser_expect(p, TOKEN_RIGHT_PAREN)) {
+      return false;
+    }
+  }
+
+  if (!parser_expect(p, TOKEN_KW_VALUES)) {
+    return false;
+  }
+  AstInsertRow **tail = &insert->rows;
+  do {
+    AstInsertRow *row = (AstInsertRow *)parser_alloc(p, sizeof(AstInsertRow));
+    if (!row || !parser_expect(p, TOKEN_LEFT_PAREN) ||
+        !(row->values = parse_expr_list(p, &row->value_count)) ||
+        !parser_expect(p, TOKEN_RIGHT_PAREN)) {
+      return false;
+    }
+    if (insert->columns && row->value_count != insert->column_count) {
+      parser_error(p, p->current, "row has %u values for %u columns",
+                   row->value_count, insert->column_count);
+      return false;
+    }
+    *tail = row;
+    tail = &row->next;
+    insert->row_count++;
+  } while (parser_match(p, TOKEN_COMMA));
+  return true;
+}
+
+static bool parse_update(Parser *p, AstUpdate *update) {
+  parser_advance(p); // UPDATE
+  if (!parser_name(p, &update->table) || !parser_expect(p, TOKEN_KW_SET)) {
+    return false;
+  }
+  AstAssignment **tail = &update->assignments;
+  do {
+    AstAssignment *assignment =
+        (AstAssignment *)parser_alloc(p, sizeof(AstAssignment));
+    if (!assignment || !parser_name(p, &assignment->column) ||
+        !parser_expect(p, TOKEN_EQUAL) ||
+        !(assignment->value = parse_expr(p))) {
+      return false;
+    }
+    *tail = assignment;
+    tail = &assignment->next;
+    update->assignment_count++;
+  } while (parser_match(p, TOKEN_COMMA));
+  if (parser_match(p, TOKEN_KW_WHERE) && !(update->where = parse_expr(p))) {
+    return false;
+  }
+  return true;
+}
+
+static bool parse_delete(Parser *p, AstDelete *delete) {
+  parser_advance(p); // DELETE
+  if (!parser_expect(p, TOKEN_KW_FROM) || !parser_name(p, &delete->table)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_WHERE) && !(delete->where = parse_expr(p))) {
+    return false;
+  }
+  return true;
+}
+
+static bool parse_create_table(Parser *p, AstCreateTable *create) {
+  parser_advance(p); // CREATE
+  if (!parser_expect(p, TOKEN_KW_TABLE)) {
+    return false;
+  }
+  if (parser_match(p, TOKEN_KW_IF)) {
+    if (!parser_expect(p, TOKEN_KW_NOT) || !parser_expect(p, TOKEN_KW_EXISTS)) {
+      return false;
+    }
+    create->if_not_exists = true;
+  }
+  if (!parser_name(p, &create->table) ||
+      !parser_expect(p, TOKEN_LEFT_PAREN)) {
+    return false;
+  }
+  AstColumnDef **tail = &create->columns;
+  do {
+    AstColumnDef *column =
+        (AstColumnDef *)parser_alloc(p, sizeof(AstColumnDef));
+    if (!column || !parse_column_def(p, column)) {
+      return false;
+    }
+    *tail = column;
+    tail = &column->next;
+    create->column_count++;
+  } while (parser_match(p, TOKEN_COMMA));
+  return parser_expect(p, TOKEN_RIGHT_PAREN);
+}
+
+// name type [(length)] {NOT NULL | NULL | PRIMARY KEY}
+static bool parse_column_def(Parser *p, AstColumnDef *column) {
+  if (!parser_name(p, &column->name)) {
+    return false;
+  }
+  Token type = p->current;
+  switch (type.kind) {
+  case TOKEN_KW_INT:
+  case TOKEN_KW_INTEGER:
+  case TOKEN_KW_BIGINT:
+    column->type = AST_TYPE_INTEGER;
+    break;
+  case TOKEN_KW_REAL:
+  case TOKEN_KW_FLOAT:
+  case TOKEN_KW_DOUBLE:
+    column->type = AST_TYPE_FLOAT;
+    break;
+  case TOKEN_KW_TEXT:
+  case TOKEN_KW_VARCHAR:
+    column->type = AST_TYPE_TEXT;
+    break;
+  case TOKEN_KW_BOOLEAN:
+    column->type = AST_TYPE_BOOLEAN;
+    break;
+  default:
+    parser_error(p, type, "expected a column type, found %s",
+                 token_kind_name(type.kind));
+    return false;
+  }
+  parser_advance(p);
+
+  if (type.kind == TOKEN_KW_VARCHAR && parser_match(p, TOKEN_LEFT_PAREN)) {
+    Token length = p->current;
+    if (!parser_expect(p, TOKEN_INTEGER)) {
+      return false;
+    }
+    AstExpr *value = parse_number(p, length);
+    if (!value || value->integer <= 0 || value->integer > UINT32_MAX) {
+      parser_error(p, length, "invalid VARCHAR length");
+      return false;
+    }
+    column->max_length = (u32)value->integer;
+    if (!parser_expect(p, TOKEN_RIGHT_PAREN)) {
+      return false;
+    }
+  }
+
+  for (;;) {
+    if (parser_match(p, TOKEN_KW_NOT)) {
+      if (!parser_expect(p, TOKEN_KW_NULL)) {
+        return false;
+      }
+      column->is_not_null = true;
+    } else if (parser_match(p, TOKEN_KW_NULL)) {
+      column->is_not_null = false;
+    } else if (parser_match(p, TOKEN_KW_PRIMARY)) {
+      if (!parser_expect(p, TOKEN_KW_KEY)) {
+        return false;
+      }
+      column->is_primary_key = true;
+      column->is_not_null = true;
+    } else {
+      return true;
+    }
+  }
+}
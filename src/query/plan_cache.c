@@ -0,0 +1,428 @@
+#include "sqldb/plan_cache.h"
+
+#include <inttypes.h>
+
+// Parsed statements take roughly ten arena bytes per byte of query text, so
+// text longer than this fraction of a slot is not worth trying to cache.
+#define PLAN_CACHE_TEXT_FRACTION 8
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static usize plan_cache_slot_size(usize entry_size);
+static usize plan_cache_bucket_count(usize capacity);
+static u64 plan_cache_key_hash(const void *key);
+static bool plan_cache_key_equal(const void *key1, const void *key2);
+
+static bool plan_cache_normalize(Arena *temp, StringView sql,
+                                 PlanCacheKey *out_key, SqlParams *out_params);
+static bool plan_cache_literal(Token token, SqlValue *out_value);
+static bool plan_cache_push_param(Arena *temp, SqlParams *params,
+                                  u32 *capacity, SqlValue value);
+static const PreparedStatement *
+plan_cache_prepare_once(PlanCache *cache, Arena *temp, StringView sql,
+                        PlanCacheKey key, SqlParams *params,
+                        SqlParseError *out_error);
+
+static void plan_cache_lru_unlink(PlanCache *cache, u32 idx);
+static void plan_cache_lru_push_front(PlanCache *cache, u32 idx);
+static void plan_cache_evict(PlanCache *cache);
+static void plan_cache_rebuild_table(PlanCache *cache);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+usize plan_cache_required_arena_size(usize capacity, usize entry_size) {
+  usize slots = capacity + 1;
+  return slots * (sizeof(PreparedStatement) + plan_cache_slot_size(entry_size)) +
+         PLAN_CACHE_OVERSIZED_KEYS * sizeof(u64) +
+         plan_cache_bucket_count(capacity) * sizeof(HashTableEntryOA) +
+         4 * BASE_ARENA_DEFAULT_ALIGNMENT;
+}
+
+bool plan_cache_init(PlanCache *cache, Arena *arena, usize capacity,
+                     usize entry_size) {
+  ASSERT(cache && arena);
+  ASSERT(capacity > 0 && capacity < PLAN_CACHE_NONE);
+
+  ZERO_STRUCT(*cache);
+  cache->capacity = capacity;
+  cache->entry_size = plan_cache_slot_size(entry_size);
+
+  usize slots = capacity + 1;
+  cache->entries = (PreparedStatement *)arena_alloc(
+      arena, slots * sizeof(PreparedStatement));
+  cache->memory = (u8 *)arena_alloc(arena, slots * cache->entry_size);
+  cache->oversized =
+      (u64 *)arena_alloc(arena, PLAN_CACHE_OVERSIZED_KEYS * sizeof(u64));
+  if (!cache->entries || !cache->memory || !cache->oversized) {
+    LOG_ERROR("Failed to allocate %zu plan cache slots", slots);
+    return false;
+  }
+  memset(cache->oversized, 0, PLAN_CACHE_OVERSIZED_KEYS * sizeof(u64));
+
+  // Sized so that the table never rehashes (which would leak the old bucket
+  // array into the arena): plan_cache_rebuild_table clears tombstones first.
+  cache->table = ht_oa_init(plan_cache_bucket_count(capacity),
+                            plan_cache_key_hash, plan_cache_key_equal, arena);
+  if (cache->table.bucket_count == 0) {
+    return false;
+  }
+
+  for (usize i = 0; i < slots; ++i) {
+    PreparedStatement *entry = &cache->entries[i];
+    ZERO_STRUCT(*entry);
+    // Plans that outgrow their slot are expected: the parse just fails.
+    entry->arena = (Arena){.buffer = cache->memory + i * cache->entry_size,
+                           .total_size = cache->entry_size,
+                           .is_quiet = true};
+    entry->lru_prev = PLAN_CACHE_NONE;
+    entry->lru_next = i + 1 < slots ? (u32)(i + 1) : PLAN_CACHE_NONE;
+  }
+  cache->free_head = 0;
+  cache->lru_head = PLAN_CACHE_NONE;
+  cache->lru_tail = PLAN_CACHE_NONE;
+  return true;
+}
+
+const PreparedStatement *plan_cache_prepare(PlanCache *cache, Arena *temp,
+                                            StringView sql,
+                                            SqlParams *out_params,
+                                            SqlParseError *out_error) {
+  ASSERT(cache && temp && out_params && out_error);
+  ZERO_STRUCT(*out_error);
+
+  PlanCacheKey key;
+  if (!plan_cache_normalize(temp, sql, &key, out_params)) {
+    ZERO_STRUCT(*out_params);
+    key = (PlanCacheKey){.text = sql};
+    return plan_cache_prepare_once(cache, temp, sql, key, out_params,
+                                   out_error);
+  }
+
+  PreparedStatement *entry =
+      (PreparedStatement *)ht_oa_get(&cache->table, &key);
+  if (entry) {
+    cache->stats.hits++;
+    entry->executions++;
+    u32 idx = (u32)(entry - cache->entries);
+    if (idx != cache->lru_head) {
+      plan_cache_lru_unlink(cache, idx);
+      plan_cache_lru_push_front(cache, idx);
+    }
+    return entry;
+  }
+
+  u64 *oversized = &cache->oversized[key.hash % PLAN_CACHE_OVERSIZED_KEYS];
+  if (key.text.length > cache->entry_size / PLAN_CACHE_TEXT_FRACTION ||
+      *oversized == key.hash) {
+    return plan_cache_prepare_once(cache, temp, sql, key, out_params,
+                                   out_error);
+  }
+
+  // Parse into a free slot first, so a statement that turns out not to fit
+  // (or not to parse) evicts nothing.
+  u32 idx = cache->free_head;
+  ASSERT(idx != PLAN_CACHE_NONE);
+  entry = &cache->entries[idx];
+  arena_reset(&entry->arena);
+  char *text = (char *)arena_alloc(&entry->arena, key.text.length);
+  AstStatement *statement = NULL;
+  if (text) {
+    memcpy(text, key.text.data, key.text.length);
+    statement = sql_parse(&entry->arena,
+                          sv_from_parts(text, key.text.length), out_error);
+  }
+  if (!statement) {
+    const PreparedStatement *once = plan_cache_prepare_once(
+        cache, temp, sql, key, out_params, out_error);
+    if (once && once->key.text.data == key.text.data) {
+      *oversized = key.hash; // Parses, just not within a slot
+    }
+    return once;
+  }
+
+  cache->free_head = entry->lru_next;
+  if (cache->count == cache->capacity) {
+    plan_cache_evict(cache);
+    cache->stats.evictions++;
+  }
+  entry->key = (PlanCacheKey){.text = sv_from_parts(text, key.text.length),
+                              .hash = key.hash};
+  entry->statement = statement;
+  entry->executions = 1;
+  entry->is_cached = true;
+
+  if ((cache->table.item_count + cache->table.tombstone_count + 1) * 5 >
+      cache->table.bucket_count * 3) {
+    plan_cache_rebuild_table(cache);
+  }
+  bool inserted = ht_oa_insert(&cache->table, &entry->key, entry);
+  ASSERT_MSG(inserted, "Plan cache entry already present");
+  (void)inserted;
+  plan_cache_lru_push_front(cache, idx);
+  cache->count++;
+  cache->stats.misses++;
+  return entry;
+}
+
+void plan_cache_clear(PlanCache *cache) {
+  ASSERT(cache);
+  while (cache->lru_tail != PLAN_CACHE_NONE) {
+    plan_cache_evict(cache);
+  }
+  ht_oa_clear(&cache->table);
+}
+
+f64 plan_cache_hit_ratio(const PlanCache *cache) {
+  ASSERT(cache);
+  u64 total = cache->stats.hits + cache->stats.misses +
+              cache->stats.uncacheable;
+  return total > 0 ? (f64)cache->stats.hits / (f64)total : 0.0;
+}
+
+void plan_cache_log_stats(const PlanCache *cache) {
+  ASSERT(cache);
+  LOG_INFO("Plan cache: %" PRIu64 " hits, %" PRIu64 " misses (hit ratio "
+           "%.2f%%), %" PRIu64 " evictions, %" PRIu64 " uncacheable, %zu/%zu "
+           "plans",
+           cache->stats.hits, cache->stats.misses,
+           plan_cache_hit_ratio(cache) * 100.0, cache->stats.evictions,
+           cache->stats.uncacheable, cache->count, cache->capacity);
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static usize plan_cache_slot_size(usize entry_size) {
+  return ALIGN_UP(entry_size, BASE_ARENA_DEFAULT_ALIGNMENT);
+}
+
+// At most half full with every slot in use; tombstones are cleared before
+// inserts push the load past 60%, below BASE_HT_OA_MAX_LOAD_FACTOR.
+static usize plan_cache_bucket_count(usize capacity) {
+  return capacity * 2 + 1;
+}
+
+static u64 plan_cache_key_hash(const void *key) {
+  return ((const PlanCacheKey *)key)->hash;
+}
+
+static bool plan_cache_key_equal(const void *key1, const void *key2) {
+  const PlanCacheKey *a = (const PlanCacheKey *)key1;
+  const PlanCacheKey *b = (const PlanCacheKey *)key2;
+  return a->hash == b->hash && sv_equals(a->text, b->text);
+}
+
+// Rewrites 'sql' with single spaces between tokens, no comments or ';' and a
+// ? in place of every literal (and explicit placeholder), whose value is
+// appended to 'out_params'. Placeholders written in the query come back as
+// SQL_VALUE_NULL for the caller to bind. Returns false for statements that
+// are not cached: anything but SELECT, INSERT, UPDATE and DELETE (DDL needs
+// its literals, e.g. VARCHAR(n), and runs rarely) and input the lexer
+// rejects, which the parser then reports.
+static bool plan_cache_normalize(Arena *temp, StringView sql,
+                                 PlanCacheKey *out_key, SqlParams *out_params) {
+  ZERO_STRUCT(*out_params);
+  Lexer lexer;
+  lexer_init(&lexer, sql);
+  Token token = lexer_next(&lexer);
+  switch (token.kind) {
+  case TOKEN_KW_SELECT:
+  case TOKEN_KW_INSERT:
+  case TOKEN_KW_UPDATE:
+  case TOKEN_KW_DELETE:
+    break;
+  default:
+    return false;
+  }
+  // Only token boundaries matter from here on.
+  lexer.skip_keywords = true;
+
+  // Every token grows by at most the separator in front of it.
+  char *text = (char *)arena_alloc(temp, 2 * sql.length);
+  if (!text) {
+    return false;
+  }
+  usize length = 0;
+  u32 param_capacity = 0;
+  for (; token.kind != TOKEN_EOF; token = lexer_next(&lexer)) {
+    if (token.kind == TOKEN_ERROR) {
+      return false;
+    }
+    if (token.kind == TOKEN_SEMICOLON) {
+      continue; // Optional terminator; a misplaced one fails the parse anyway
+    }
+    if (length > 0) {
+      text[length++] = ' ';
+    }
+
+    SqlValue value;
+    ZERO_STRUCT(value);
+    if (token.kind == TOKEN_PARAMETER || plan_cache_literal(token, &value)) {
+      if (!plan_cache_push_param(temp, out_params, &param_capacity, value)) {
+        return false;
+      }
+      text[length++] = '?';
+      continue;
+    }
+
+    // The token's source span keeps the quotes of quoted identifiers.
+    usize span = lexer.position - token.offset;
+    memcpy(text + length, sql.data + token.offset, span);
+    length += span;
+  }
+
+  out_key->text = sv_from_parts(text, length);
+  out_key->hash = base_hash_bytes(text, length);
+  return true;
+}
+
+// Literals the parser would reject (an out-of-range integer, an overlong
+// number) stay in the text so the error is reported as usual.
+static bool plan_cache_literal(Token token, SqlValue *out_value) {
+  switch (token.kind) {
+  case TOKEN_INTEGER: {
+    u64 value = 0;
+    for (usize i = 0; i < token.text.length; ++i) {
+      u64 digit = (u64)(token.text.data[i] - '0');
+      if (value > ((u64)INT64_MAX - digit) / 10) {
+        return false;
+      }
+      value = value * 10 + digit;
+    }
+    out_value->kind = SQL_VALUE_INTEGER;
+    out_value->integer = (i64)value;
+    return true;
+  }
+  case TOKEN_FLOAT: {
+    char buffer[64];
+    if (token.text.length >= sizeof(buffer)) {
+      return false;
+    }
+    memcpy(buffer, token.text.data, token.text.length);
+    buffer[token.text.length] = '\0';
+    out_value->kind = SQL_VALUE_FLOAT;
+    out_value->real = strtod(buffer, NULL);
+    return true;
+  }
+  case TOKEN_STRING:
+    out_value->kind = SQL_VALUE_STRING;
+    out_value->string = token.text;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool plan_cache_push_param(Arena *temp, SqlParams *params,
+                                  u32 *capacity, SqlValue value) {
+  if (params->count == *capacity) {
+    u32 new_capacity = *capacity > 0 ? *capacity * 2 : 8;
+    SqlValue *values =
+        (SqlValue *)arena_alloc(temp, new_capacity * sizeof(SqlValue));
+    if (!values) {
+      return false;
+    }
+    if (params->count > 0) {
+      memcpy(values, params->values, params->count * sizeof(SqlValue));
+    }
+    params->values = values;
+    *capacity = new_capacity;
+  }
+  params->values[params->count++] = value;
+  return true;
+}
+
+// Parses a plan that is not cached into 'temp'. A normalized statement that
+// does not parse is retried as written: either the literals were needed, or
+// the error is real and its position should point into the user's text.
+static const PreparedStatement *
+plan_cache_prepare_once(PlanCache *cache, Arena *temp, StringView sql,
+                        PlanCacheKey key, SqlParams *params,
+                        SqlParseError *out_error) {
+  PreparedStatement *entry =
+      (PreparedStatement *)arena_alloc(temp, sizeof(PreparedStatement));
+  if (!entry) {
+    snprintf(out_error->message, sizeof(out_error->message),
+             "out of memory while parsing");
+    return NULL;
+  }
+  ZERO_STRUCT(*entry);
+  entry->key = key;
+  entry->executions = 1;
+  entry->lru_prev = PLAN_CACHE_NONE;
+  entry->lru_next = PLAN_CACHE_NONE;
+  entry->statement = sql_parse(temp, key.text, out_error);
+  if (!entry->statement && key.text.data != sql.data) {
+    ZERO_STRUCT(*params);
+    entry->key = (PlanCacheKey){.text = sql};
+    entry->statement = sql_parse(temp, sql, out_error);
+  }
+  if (!entry->statement) {
+    return NULL;
+  }
+  cache->stats.uncacheable++;
+  return entry;
+}
+
+static void plan_cache_lru_unlink(PlanCache *cache, u32 idx) {
+  PreparedStatement *entry = &cache->entries[idx];
+  if (entry->lru_prev != PLAN_CACHE_NONE) {
+    cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+  } else {
+    cache->lru_head = entry->lru_next;
+  }
+  if (entry->lru_next != PLAN_CACHE_NONE) {
+    cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+  } else {
+    cache->lru_tail = entry->lru_prev;
+  }
+  entry->lru_prev = PLAN_CACHE_NONE;
+  entry->lru_next = PLAN_CACHE_NONE;
+}
+
+static void plan_cache_lru_push_front(PlanCache *cache, u32 idx) {
+  PreparedStatement *entry = &cache->entries[idx];
+  entry->lru_prev = PLAN_CACHE_NONE;
+  entry->lru_next = cache->lru_head;
+  if (cache->lru_head != PLAN_CACHE_NONE) {
+    cache->entries[cache->lru_head].lru_prev = idx;
+  } else {
+    cache->lru_tail = idx;
+  }
+  cache->lru_head = idx;
+}
+
+// Drops the least recently used plan and returns its slot to the free list.
+static void plan_cache_evict(PlanCache *cache) {
+  u32 victim = cache->lru_tail;
+  ASSERT(victim != PLAN_CACHE_NONE);
+  PreparedStatement *entry = &cache->entries[victim];
+  bool removed = ht_oa_remove(&cache->table, &entry->key);
+  ASSERT_MSG(removed, "Cached plan missing from the plan table");
+  (void)removed;
+  plan_cache_lru_unlink(cache, victim);
+
+  entry->is_cached = false;
+  entry->statement = NULL;
+  entry->lru_next = cache->free_head;
+  cache->free_head = victim;
+  cache->count--;
+}
+
+// Every eviction leaves a tombstone; re-inserting the live plans into the
+// cleared bucket array drops them without allocating.
+static void plan_cache_rebuild_table(PlanCache *cache) {
+  ht_oa_clear(&cache->table);
+  for (u32 idx = cache->lru_head; idx != PLAN_CACHE_NONE;
+       idx = cache->entries[idx].lru_next) {
+    PreparedStatement *entry = &cache->entries[idx];
+    bool inserted = ht_oa_insert(&cache->table, &entry->key, entry);
+    ASSERT(inserted);
+    (void)inserted;
+  }
+}
@@ -0,0 +1,488 @@
+#include "sqldb/async_io.h"
+
+#include <errno.h>
+#include <inttypes.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SQLDB_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef SQLDB_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static AsyncIoRing *ring_create(u32 entries);
+static void ring_destroy(AsyncIoRing *ring);
+static void ring_prepare(AsyncIoRing *ring, const PageFile *file,
+                         const AsyncIoRequest *request, u32 slot);
+static u32 ring_submit(AsyncIo *aio, u32 count);
+static u32 ring_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max,
+                     u32 min_complete);
+
+static u32 sync_submit(AsyncIo *aio);
+static u32 stash_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max);
+
+static AsyncIoCompletion async_io_complete(AsyncIo *aio, u32 slot, bool ok);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool async_io_init(AsyncIo *aio, PageFile *file, u32 queue_depth,
+                   AsyncIoBackend preferred) {
+  ASSERT(aio && file);
+  ASSERT(queue_depth > 0 && queue_depth <= MAX_IO_QUEUE_DEPTH);
+
+  ZERO_STRUCT(*aio);
+  aio->file = file;
+  aio->queue_depth = queue_depth;
+  aio->slots = (AsyncIoRequest *)malloc(queue_depth * sizeof(AsyncIoRequest));
+  aio->free_slots = (u32 *)malloc(queue_depth * sizeof(u32));
+  aio->prepared = (u32 *)malloc(queue_depth * sizeof(u32));
+  aio->completed = (u32 *)malloc(queue_depth * sizeof(u32));
+  if (!aio->slots || !aio->free_slots || !aio->prepared || !aio->completed) {
+    LOG_ERROR("Failed to allocate async I/O queue (depth %u)", queue_depth);
+    async_io_shutdown(aio);
+    return false;
+  }
+  for (u32 i = 0; i < queue_depth; ++i) {
+    aio->free_slots[i] = queue_depth - 1 - i;
+  }
+  aio->free_slot_count = queue_depth;
+
+  aio->backend = ASYNC_IO_BACKEND_SYNC;
+  if (preferred == ASYNC_IO_BACKEND_IO_URING) {
+    aio->ring = ring_create(queue_depth);
+    if (aio->ring) {
+      aio->backend = ASYNC_IO_BACKEND_IO_URING;
+    } else {
+      LOG_WARN("io_uring unavailable, falling back to synchronous pread");
+    }
+  }
+
+  LOG_DEBUG("Async I/O initialized: %s backend, queue depth %u",
+            async_io_backend_name(aio->backend), queue_depth);
+  return true;
+}
+
+void async_io_shutdown(AsyncIo *aio) {
+  ASSERT(aio);
+  if (aio->ring) {
+    // Drain in-flight requests: the kernel may still write into their buffers,
+    // which belong to the caller.
+    AsyncIoCompletion scratch[32];
+    async_io_submit(aio);
+    while (async_io_in_flight(aio) > 0 &&
+           async_io_reap(aio, scratch, ARRAY_SIZE(scratch), 1) > 0) {
+    }
+    ring_destroy(aio->ring);
+    aio->ring = NULL;
+  }
+  free(aio->slots);
+  free(aio->free_slots);
+  free(aio->prepared);
+  free(aio->completed);
+  aio->slots = NULL;
+  aio->free_slots = NULL;
+  aio->prepared = NULL;
+  aio->completed = NULL;
+  aio->free_slot_count = 0;
+  aio->queue_depth = 0;
+}
+
+bool async_io_prepare(AsyncIo *aio, const AsyncIoRequest *request) {
+  ASSERT(aio && request && request->buffer);
+  if (aio->free_slot_count == 0) {
+    return false;
+  }
+
+  u32 slot = aio->free_slots[--aio->free_slot_count];
+  aio->slots[slot] = *request;
+  if (aio->backend == ASYNC_IO_BACKEND_IO_URING) {
+    ring_prepare(aio->ring, aio->file, request, slot);
+  } else {
+    aio->prepared[aio->prepared_count] = slot;
+  }
+  aio->prepared_count++;
+  return true;
+}
+
+u32 async_io_submit(AsyncIo *aio) {
+  ASSERT(aio);
+  u32 count = aio->prepared_count;
+  if (count == 0) {
+    return 0;
+  }
+
+  if (aio->backend == ASYNC_IO_BACKEND_IO_URING) {
+    // On failure the kernel may have taken only the first requests; the rest
+    // stay prepared and the caller may retry.
+    count = ring_submit(aio, count);
+    if (count == 0) {
+      return 0;
+    }
+  } else {
+    count = sync_submit(aio);
+  }
+  aio->prepared_count -= count;
+  aio->stats.submitted += count;
+  aio->stats.batches++;
+  return count;
+}
+
+u32 async_io_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max,
+                  u32 min_complete) {
+  ASSERT(aio && out);
+  u32 in_flight = async_io_in_flight(aio);
+  min_complete = MIN(MIN(min_complete, in_flight), max);
+  if (max == 0 || in_flight == 0) {
+    return 0;
+  }
+
+  if (aio->backend == ASYNC_IO_BACKEND_IO_URING) {
+    return ring_reap(aio, out, max, min_complete);
+  }
+  return stash_reap(aio, out, max);
+}
+
+const char *async_io_backend_name(AsyncIoBackend backend) {
+  switch (backend) {
+  case ASYNC_IO_BACKEND_SYNC:
+    return "sync";
+  case ASYNC_IO_BACKEND_IO_URING:
+    return "io_uring";
+  }
+  return "unknown";
+}
+
+// =================================================================================================
+// :: Synchronous Backend ::
+// =================================================================================================
+
+static u32 sync_submit(AsyncIo *aio) {
+  u32 count = aio->prepared_count;
+  for (u32 i = 0; i < count; ++i) {
+    u32 slot = aio->prepared[i];
+    const AsyncIoRequest *request = &aio->slots[slot];
+    bool ok = request->op == ASYNC_IO_READ
+                  ? pf_read_page(aio->file, request->page_id, request->buffer)
+                  : pf_write_page(aio->file, request->page_id,
+                                  request->buffer);
+    // Stash the outcome in the low bit; slots are < MAX_IO_QUEUE_DEPTH.
+    aio->completed[aio->completed_count++] = (slot << 1) | (ok ? 1u : 0u);
+  }
+  return count;
+}
+
+// Reaps the outcomes stashed in aio->completed: every request of the sync
+// backend, and io_uring completions that ring_submit moved off a full
+// completion queue.
+static u32 stash_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max) {
+  u32 count = MIN(max, aio->completed_count);
+  for (u32 i = 0; i < count; ++i) {
+    u32 entry = aio->completed[--aio->completed_count];
+    out[i] = async_io_complete(aio, entry >> 1, (entry & 1u) != 0);
+  }
+  return count;
+}
+
+static AsyncIoCompletion async_io_complete(AsyncIo *aio, u32 slot, bool ok) {
+  AsyncIoCompletion completion = {.user_data = aio->slots[slot].user_data,
+                                  .ok = ok};
+  aio->free_slots[aio->free_slot_count++] = slot;
+  aio->stats.completed++;
+  if (!ok) {
+    aio->stats.failures++;
+  }
+  return completion;
+}
+
+// =================================================================================================
+// :: io_uring Backend ::
+// =================================================================================================
+
+#ifdef SQLDB_HAVE_IO_URING
+
+struct AsyncIoRing {
+  int fd;
+  u8 *sq_ring;
+  usize sq_ring_size;
+  u8 *cq_ring;
+  usize cq_ring_size;
+  struct io_uring_sqe *sqes;
+  usize sqes_size;
+
+  u32 *sq_tail;
+  u32 *sq_mask;
+  u32 *sq_array;
+  u32 *cq_head;
+  u32 *cq_tail;
+  u32 *cq_mask;
+  struct io_uring_cqe *cqes;
+};
+
+static int ring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static bool ring_probe_has(const struct io_uring_probe *probe, u8 op) {
+  return op <= probe->last_op && op < probe->ops_len &&
+         (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+// IORING_OP_READ and IORING_OP_WRITE arrived in Linux 5.6, as did the probe
+// itself. Older kernels set up rings fine but fail every request with
+// -EINVAL, so they get the sync backend instead.
+static bool ring_supports_read_write(int fd) {
+  u32 op_count = 256;
+  struct io_uring_probe *probe = (struct io_uring_probe *)calloc(
+      1, sizeof(*probe) + op_count * sizeof(struct io_uring_probe_op));
+  if (!probe) {
+    return false;
+  }
+  bool ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                    op_count) == 0 &&
+            ring_probe_has(probe, IORING_OP_READ) &&
+            ring_probe_has(probe, IORING_OP_WRITE);
+  free(probe);
+  return ok;
+}
+
+static AsyncIoRing *ring_create(u32 entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    LOG_DEBUG("io_uring_setup failed: %s", strerror(errno));
+    return NULL;
+  }
+  if (!ring_supports_read_write(fd)) {
+    LOG_DEBUG("io_uring lacks IORING_OP_READ/WRITE (Linux 5.6+)");
+    close(fd);
+    return NULL;
+  }
+
+  AsyncIoRing *ring = (AsyncIoRing *)calloc(1, sizeof(AsyncIoRing));
+  if (!ring) {
+    close(fd);
+    return NULL;
+  }
+  ring->fd = fd;
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  ring->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->sq_ring_size = ring->cq_ring_size =
+        MAX(ring->sq_ring_size, ring->cq_ring_size);
+  }
+
+  void *sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  void *cq = sq;
+  if (sq != MAP_FAILED && !single_mmap) {
+    cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = MAP_FAILED;
+  if (sq != MAP_FAILED && cq != MAP_FAILED) {
+    sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  }
+  if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+    LOG_DEBUG("io_uring mmap failed: %s", strerror(errno));
+    if (sq != MAP_FAILED) {
+      munmap(sq, ring->sq_ring_size);
+    }
+    if (cq != MAP_FAILED && cq != sq) {
+      munmap(cq, ring->cq_ring_size);
+    }
+    close(fd);
+    free(ring);
+    return NULL;
+  }
+
+  ring->sq_ring = (u8 *)sq;
+  ring->cq_ring = (u8 *)cq;
+  ring->sqes = (struct io_uring_sqe *)sqes;
+  ring->sq_tail = (u32 *)(ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask = (u32 *)(ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_array = (u32 *)(ring->sq_ring + params.sq_off.array);
+  ring->cq_head = (u32 *)(ring->cq_ring + params.cq_off.head);
+  ring->cq_tail = (u32 *)(ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask = (u32 *)(ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(ring->cq_ring + params.cq_off.cqes);
+  return ring;
+}
+
+static void ring_destroy(AsyncIoRing *ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+  free(ring);
+}
+
+static void ring_prepare(AsyncIoRing *ring, const PageFile *file,
+                         const AsyncIoRequest *request, u32 slot) {
+  // Only this thread writes the SQ tail; the kernel reads it on enter.
+  u32 tail = *ring->sq_tail;
+  u32 index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request->op == ASYNC_IO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+  sqe->fd = file->fd;
+  sqe->addr = (u64)(uintptr_t)request->buffer;
+  sqe->len = file->page_size;
+  sqe->off = request->page_id * file->page_size;
+  sqe->user_data = slot;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Consumes the completion at the head of the CQ. Returns its slot with the
+// outcome in the low bit, as stored in aio->completed. Transfers the kernel
+// cut short are redone with pf_read_page/pf_write_page, which finish partial
+// transfers, zero-fill only past the end of the file and drop O_DIRECT when
+// the device rejects its alignment.
+static u32 ring_take_cqe(AsyncIo *aio) {
+  AsyncIoRing *ring = aio->ring;
+  u32 head = *ring->cq_head;
+  const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+  u32 slot = (u32)cqe->user_data;
+  i32 result = cqe->res;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+  const AsyncIoRequest *request = &aio->slots[slot];
+  PageFile *file = aio->file;
+  bool is_read = request->op == ASYNC_IO_READ;
+  bool ok = (u32)result == file->page_size;
+  bool is_retryable = result >= 0 || result == -EINTR || result == -EAGAIN ||
+                      (result == -EINVAL && pf_uses_direct_io(file));
+  if (!ok && is_retryable) {
+    LOG_DEBUG("Async %s of page %" PRIu64 " returned %d, finishing it "
+              "synchronously",
+              is_read ? "read" : "write", request->page_id, result);
+    ok = is_read ? pf_read_page(file, request->page_id, request->buffer)
+                 : pf_write_page(file, request->page_id, request->buffer);
+  } else if (ok && !is_read) {
+    pf_note_page_written(file, request->page_id);
+  } else if (!ok) {
+    LOG_ERROR("Async %s of page %" PRIu64 " failed: %s",
+              is_read ? "read" : "write", request->page_id,
+              strerror(-result));
+  }
+  return (slot << 1) | (ok ? 1u : 0u);
+}
+
+static bool ring_has_cqe(const AsyncIoRing *ring) {
+  return *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+}
+
+// Returns how many of the 'count' queued requests the kernel took: all of
+// them unless io_uring_enter fails.
+static u32 ring_submit(AsyncIo *aio, u32 count) {
+  AsyncIoRing *ring = aio->ring;
+  u32 done = 0;
+  while (done < count) {
+    int submitted = ring_enter(ring->fd, count - done, 0, 0);
+    if (submitted >= 0) {
+      done += (u32)submitted;
+      continue;
+    }
+    if (errno == EBUSY) {
+      // The completion queue is full and the kernel takes no more requests
+      // until it drains. Stash what is there for async_io_reap, or wait for
+      // the kernel to post an overflowed completion.
+      if (!ring_has_cqe(ring) &&
+          ring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+          errno != EINTR) {
+        LOG_ERROR("io_uring_enter (wait) failed: %s", strerror(errno));
+        return done;
+      }
+      while (ring_has_cqe(ring)) {
+        aio->completed[aio->completed_count++] = ring_take_cqe(aio);
+      }
+      continue;
+    }
+    if (errno != EINTR && errno != EAGAIN) {
+      LOG_ERROR("io_uring_enter (submit) failed: %s", strerror(errno));
+      return done;
+    }
+  }
+  return done;
+}
+
+static u32 ring_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max,
+                     u32 min_complete) {
+  AsyncIoRing *ring = aio->ring;
+  u32 count = stash_reap(aio, out, max);
+  while (count < max) {
+    if (!ring_has_cqe(ring)) {
+      if (count >= min_complete) {
+        break;
+      }
+      if (ring_enter(ring->fd, 0, min_complete - count,
+                     IORING_ENTER_GETEVENTS) < 0 &&
+          errno != EINTR) {
+        LOG_ERROR("io_uring_enter (wait) failed: %s", strerror(errno));
+        break;
+      }
+      continue;
+    }
+    u32 entry = ring_take_cqe(aio);
+    out[count++] = async_io_complete(aio, entry >> 1, (entry & 1u) != 0);
+  }
+  return count;
+}
+
+#else // !SQLDB_HAVE_IO_URING
+
+struct AsyncIoRing {
+  int unused;
+};
+
+static AsyncIoRing *ring_create(u32 entries) {
+  (void)entries;
+  return NULL;
+}
+
+static void ring_destroy(AsyncIoRing *ring) { (void)ring; }
+
+static void ring_prepare(AsyncIoRing *ring, const PageFile *file,
+                         const AsyncIoRequest *request, u32 slot) {
+  (void)ring;
+  (void)file;
+  (void)request;
+  (void)slot;
+}
+
+static u32 ring_submit(AsyncIo *aio, u32 count) {
+  (void)aio;
+  (void)count;
+  return 0;
+}
+
+static u32 ring_reap(AsyncIo *aio, AsyncIoCompletion *out, u32 max,
+                     u32 min_complete) {
+  (void)aio;
+  (void)out;
+  (void)max;
+  (void)min_complete;
+  return 0;
+}
+
+#endif // SQLDB_HAVE_IO_URING
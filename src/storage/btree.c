@@ -0,0 +1,1030 @@
+#include "sqldb/btree.h"
+
+#include <inttypes.h>
+#include <sched.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// Persistent root pointer, stored at the start of the meta page.
+typedef struct {
+  u32 magic;
+  u32 page_size;
+  PageId root_page_id;
+  u32 height;
+  u32 reserved;
+} BTreeMeta;
+
+// A key/value pair being moved into a rebuilt node. The key is the
+// concatenation of 'head' and 'tail', which lets inner node entries be
+// described as (node prefix, stored suffix) without copying them.
+typedef struct {
+  const u8 *head;
+  const u8 *tail;
+  u32 head_length;
+  u32 tail_length;
+  u64 value;
+} BTreeEntry;
+
+static BTreeNodeHeader *btree_node_header(u8 *page);
+static BTreeSlot *btree_node_slots(u8 *page);
+static u32 btree_node_count(const u8 *page, u32 page_size);
+static StringView btree_node_key(const u8 *page, u32 page_size, u32 index);
+static u64 btree_node_value(const u8 *page, u32 page_size, u32 index);
+static u32 btree_node_search(const u8 *page, u32 page_size, StringView key,
+                             bool *out_exact);
+static PageId btree_node_child(const u8 *page, u32 page_size, StringView key);
+static void btree_node_init_leaf(u8 *page, u32 page_size);
+static bool btree_leaf_insert_in_place(u8 *page, u32 index, StringView key,
+                                       u64 value);
+
+static u32 btree_entry_length(const BTreeEntry *entry);
+static u32 btree_entry_common_prefix(const BTreeEntry *a, const BTreeEntry *b);
+static void btree_entry_copy(const BTreeEntry *entry, u32 from, u32 to,
+                             u8 *dst);
+static u32 btree_node_prefix_length(const BTreeEntry *entries, u32 count,
+                                    u16 level);
+static usize btree_node_size(const BTreeEntry *entries, u32 count, u16 level);
+static void btree_node_build(u8 *page, u32 page_size, u16 level,
+                             PageId leftmost_child, PageId right_sibling,
+                             const BTreeEntry *entries, u32 count);
+static u32 btree_node_gather(const u8 *page, u32 page_size,
+                             BTreeEntry *entries);
+static bool btree_choose_split(const BTree *bt, const BTreeEntry *entries,
+                               u32 count, u16 level, u32 *out_split);
+
+static usize btree_max_entries(u32 page_size);
+static bool btree_alloc_scratch(BTree *bt);
+static BTreeEntry *btree_scratch_entries(const BTree *bt);
+static u8 *btree_scratch_page(const BTree *bt);
+static u8 *btree_scratch_key(const BTree *bt, u32 which);
+static bool btree_store_meta(BTree *bt);
+static BufferFrame *btree_find_leaf(BTree *bt, StringView key, PageId *path,
+                                    u32 *out_depth);
+static bool btree_insert_entry(BTree *bt, BufferFrame *frame,
+                               const BTreeEntry *entry, bool is_append,
+                               BTreeEntry *out_separator,
+                               PageId *out_right_id);
+static bool btree_grow_root(BTree *bt, const BTreeEntry *separator,
+                            PageId right_id);
+static bool btree_insert_locked(BTree *bt, StringView key, u64 value);
+
+static BTreeNodeLatch *btree_directory_get(const BTree *bt, PageId page_id);
+static bool btree_directory_put(BTree *bt, BufferFrame *frame);
+static void btree_directory_free(BTree *bt);
+static bool btree_track_node(BTree *bt, BufferFrame *frame);
+static void btree_lock_node(BTree *bt, const BufferFrame *frame);
+static void btree_unlock_nodes(BTree *bt);
+static u64 btree_read_lock(const BTreeNodeLatch *latch);
+static bool btree_read_validate(const BTreeNodeLatch *latch, u64 version);
+static BTreeNodeLatch *btree_find_leaf_optimistic(BTree *bt, StringView key,
+                                                  u64 *out_version);
+static bool btree_lookup_optimistic(BTree *bt, StringView key,
+                                    u64 *out_value);
+static void btree_snapshot_node(const BTree *bt, const BTreeNodeLatch *latch,
+                                u8 *dst);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+u32 btree_max_key_size(u32 page_size) {
+  u32 usable = page_size - (u32)sizeof(BTreeNodeHeader);
+  return usable / 4 - (u32)(sizeof(BTreeSlot) + sizeof(u64));
+}
+
+bool btree_create(BTree *bt, BufferPool *bp) {
+  ASSERT(bt && bp);
+  ASSERT(bp->page_size >= BTREE_MIN_PAGE_SIZE &&
+         bp->page_size <= BTREE_MAX_PAGE_SIZE);
+  ZERO_STRUCT(*bt);
+  bt->bp = bp;
+  pthread_mutex_init(&bt->write_lock, NULL);
+
+  BufferFrame *meta = bp_new_page(bp, &bt->meta_page_id);
+  if (!meta) {
+    return false;
+  }
+  bp_unpin_page(bp, meta, true);
+  BufferFrame *root = bp_new_page(bp, &bt->root_page_id);
+  if (!root) {
+    return false;
+  }
+  btree_node_init_leaf(root->data, bp->page_size);
+  bp_unpin_page(bp, root, true);
+  bt->height = 1;
+
+  return btree_alloc_scratch(bt) && btree_store_meta(bt);
+}
+
+bool btree_open(BTree *bt, BufferPool *bp, PageId meta_page_id) {
+  ASSERT(bt && bp);
+  ZERO_STRUCT(*bt);
+  bt->bp = bp;
+  bt->meta_page_id = meta_page_id;
+  pthread_mutex_init(&bt->write_lock, NULL);
+
+  BufferFrame *frame = bp_fetch_page(bp, meta_page_id);
+  if (!frame) {
+    return false;
+  }
+  BTreeMeta meta;
+  memcpy(&meta, frame->data, sizeof(meta));
+  bp_unpin_page(bp, frame, false);
+  if (meta.magic != BTREE_META_MAGIC || meta.page_size != bp->page_size ||
+      meta.height == 0 || meta.height > BTREE_MAX_HEIGHT) {
+    LOG_ERROR("Page %" PRIu64 " is not a B+tree meta page", meta_page_id);
+    return false;
+  }
+  bt->root_page_id = meta.root_page_id;
+  bt->height = meta.height;
+
+  return btree_alloc_scratch(bt);
+}
+
+void btree_close(BTree *bt) {
+  ASSERT(bt);
+  btree_directory_free(bt);
+  pthread_mutex_destroy(&bt->write_lock);
+  free(bt->scratch);
+  bt->scratch = NULL;
+}
+
+bool btree_enable_concurrency(BTree *bt) {
+  ASSERT(bt && !bt->directory);
+  bt->directory = (BTreeNodeLatch **)calloc(BTREE_DIRECTORY_CHUNKS,
+                                            sizeof(BTreeNodeLatch *));
+  if (!bt->directory) {
+    LOG_ERROR("Failed to allocate the B+tree latch directory");
+    return false;
+  }
+
+  // Pin every node, one level at a time along the sibling links.
+  PageId first_id = bt->root_page_id;
+  while (first_id != INVALID_PAGE_ID) {
+    PageId next_level_id = INVALID_PAGE_ID;
+    PageId page_id = first_id;
+    while (page_id != INVALID_PAGE_ID) {
+      BufferFrame *frame = bp_fetch_page(bt->bp, page_id);
+      if (!frame) {
+        LOG_ERROR("B+tree does not fit in the buffer pool");
+        btree_directory_free(bt);
+        return false;
+      }
+      if (!btree_directory_put(bt, frame)) {
+        bp_unpin_page(bt->bp, frame, false);
+        btree_directory_free(bt);
+        return false;
+      }
+      const BTreeNodeHeader *header = (const BTreeNodeHeader *)frame->data;
+      if (page_id == first_id && header->level > 0) {
+        next_level_id = header->leftmost_child;
+      }
+      page_id = header->right_sibling;
+    }
+    first_id = next_level_id;
+  }
+  return true;
+}
+
+bool btree_lookup(BTree *bt, StringView key, u64 *out_value) {
+  ASSERT(bt && out_value);
+  if (bt->directory) {
+    return btree_lookup_optimistic(bt, key, out_value);
+  }
+  bt->stats.lookups++;
+  BufferFrame *leaf = btree_find_leaf(bt, key, NULL, NULL);
+  if (!leaf) {
+    return false;
+  }
+  bool exact;
+  u32 index = btree_node_search(leaf->data, bt->bp->page_size, key, &exact);
+  if (exact) {
+    *out_value = btree_node_value(leaf->data, bt->bp->page_size, index);
+  }
+  bp_unpin_page(bt->bp, leaf, false);
+  return exact;
+}
+
+// Writers hold the write lock for the whole operation and, in a concurrent
+// tree, keep every node they modified locked until it is complete: a split is
+// only visible to readers once the parent knows about the new sibling.
+bool btree_insert(BTree *bt, StringView key, u64 value) {
+  ASSERT(bt);
+  if (key.length > btree_max_key_size(bt->bp->page_size)) {
+    LOG_ERROR("Key of %zu bytes exceeds the %u-byte B+tree key limit",
+              key.length, btree_max_key_size(bt->bp->page_size));
+    return false;
+  }
+  pthread_mutex_lock(&bt->write_lock);
+  bool ok = btree_insert_locked(bt, key, value);
+  btree_unlock_nodes(bt);
+  pthread_mutex_unlock(&bt->write_lock);
+  return ok;
+}
+
+bool btree_delete(BTree *bt, StringView key) {
+  ASSERT(bt);
+  pthread_mutex_lock(&bt->write_lock);
+  BufferFrame *leaf = btree_find_leaf(bt, key, NULL, NULL);
+  bool exact = false;
+  if (leaf) {
+    u32 index = btree_node_search(leaf->data, bt->bp->page_size, key, &exact);
+    if (exact) {
+      btree_lock_node(bt, leaf);
+      BTreeNodeHeader *header = btree_node_header(leaf->data);
+      BTreeSlot *slots = btree_node_slots(leaf->data);
+      header->dead_bytes += slots[index].length + (u32)sizeof(u64);
+      memmove(&slots[index], &slots[index + 1],
+              (header->count - index - 1) * sizeof(BTreeSlot));
+      header->count--;
+      bt->stats.deletes++;
+      btree_unlock_nodes(bt);
+    }
+    bp_unpin_page(bt->bp, leaf, exact);
+  }
+  pthread_mutex_unlock(&bt->write_lock);
+  return exact;
+}
+
+bool btree_seek(BTree *bt, StringView start, BTreeIterator *it) {
+  ASSERT(bt && it);
+  *it = (BTreeIterator){.tree = bt};
+  u32 page_size = bt->bp->page_size;
+  bool exact;
+  if (bt->directory) {
+    it->snapshot = (u8 *)malloc(page_size);
+    if (!it->snapshot) {
+      LOG_ERROR("Failed to allocate a B+tree iterator page");
+      return false;
+    }
+    // The copy is consistent once the leaf version is unchanged.
+    for (;;) {
+      u64 version;
+      BTreeNodeLatch *latch = btree_find_leaf_optimistic(bt, start, &version);
+      memcpy(it->snapshot, latch->frame->data, page_size);
+      if (btree_read_validate(latch, version)) {
+        break;
+      }
+    }
+    it->page = it->snapshot;
+  } else {
+    it->leaf = btree_find_leaf(bt, start, NULL, NULL);
+    if (!it->leaf) {
+      return false;
+    }
+    it->page = it->leaf->data;
+  }
+  it->index = btree_node_search(it->page, page_size, start, &exact);
+  return true;
+}
+
+bool btree_iter_next(BTreeIterator *it, StringView *out_key, u64 *out_value) {
+  ASSERT(it && out_key && out_value);
+  u32 page_size = it->tree->bp->page_size;
+  while (it->page) {
+    const BTreeNodeHeader *header = (const BTreeNodeHeader *)it->page;
+    if (it->index < btree_node_count(it->page, page_size)) {
+      *out_key = btree_node_key(it->page, page_size, it->index);
+      *out_value = btree_node_value(it->page, page_size, it->index);
+      it->index++;
+      return true;
+    }
+    // Step to the right sibling without revisiting the inner levels. Leaves
+    // emptied by deletes are simply passed over. Splits only move keys to the
+    // right, so a concurrent scan never skips a key that was present when it
+    // copied the leaf before.
+    PageId next = header->right_sibling;
+    it->index = 0;
+    if (it->snapshot) {
+      BTreeNodeLatch *latch = next != INVALID_PAGE_ID
+                                  ? btree_directory_get(it->tree, next)
+                                  : NULL;
+      if (latch) {
+        btree_snapshot_node(it->tree, latch, it->snapshot);
+      }
+      it->page = latch ? it->snapshot : NULL;
+    } else {
+      bp_unpin_page(it->tree->bp, it->leaf, false);
+      it->leaf = next != INVALID_PAGE_ID ? bp_fetch_page(it->tree->bp, next)
+                                         : NULL;
+      it->page = it->leaf ? it->leaf->data : NULL;
+    }
+  }
+  return false;
+}
+
+void btree_iter_close(BTreeIterator *it) {
+  ASSERT(it);
+  if (it->leaf) {
+    bp_unpin_page(it->tree->bp, it->leaf, false);
+    it->leaf = NULL;
+  }
+  free(it->snapshot);
+  it->snapshot = NULL;
+  it->page = NULL;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool btree_insert_locked(BTree *bt, StringView key, u64 value) {
+  u32 page_size = bt->bp->page_size;
+  PageId path[BTREE_MAX_HEIGHT];
+  u32 depth = 0;
+  BufferFrame *frame = btree_find_leaf(bt, key, path, &depth);
+  if (!frame) {
+    return false;
+  }
+  bool exact;
+  u32 index = btree_node_search(frame->data, page_size, key, &exact);
+  btree_lock_node(bt, frame);
+  if (exact) {
+    u8 *entry = frame->data + btree_node_slots(frame->data)[index].offset;
+    memcpy(entry + key.length, &value, sizeof(value));
+    bp_unpin_page(bt->bp, frame, true);
+    bt->stats.updates++;
+    return true;
+  }
+  bt->stats.inserts++;
+  if (btree_leaf_insert_in_place(frame->data, index, key, value)) {
+    bp_unpin_page(bt->bp, frame, true);
+    return true;
+  }
+
+  // Splits propagate upwards along the recorded path. Each level hands the
+  // separator for its new right sibling to the level above.
+  BTreeNodeHeader *header = btree_node_header(frame->data);
+  bool is_append = index == header->count &&
+                   header->right_sibling == INVALID_PAGE_ID;
+  BTreeEntry entry = {.head = (const u8 *)key.data,
+                      .head_length = (u32)key.length,
+                      .value = value};
+  for (;;) {
+    BTreeEntry separator;
+    PageId right_id = INVALID_PAGE_ID;
+    bool is_root = frame->page_id == bt->root_page_id;
+    bool ok = btree_insert_entry(bt, frame, &entry, is_append, &separator,
+                                 &right_id);
+    bp_unpin_page(bt->bp, frame, true);
+    if (!ok || right_id == INVALID_PAGE_ID) {
+      return ok;
+    }
+    if (is_root) {
+      return btree_grow_root(bt, &separator, right_id);
+    }
+    ASSERT(depth > 0);
+    frame = bp_fetch_page(bt->bp, path[--depth]);
+    if (!frame) {
+      return false;
+    }
+    btree_lock_node(bt, frame);
+    entry = separator;
+    entry.value = right_id;
+    is_append = false;
+  }
+}
+
+static BTreeNodeHeader *btree_node_header(u8 *page) {
+  return (BTreeNodeHeader *)page;
+}
+
+static BTreeSlot *btree_node_slots(u8 *page) {
+  return (BTreeSlot *)(page + sizeof(BTreeNodeHeader));
+}
+
+// Concurrent readers can see a node halfway through a rewrite. The accessors
+// below clamp what they read to the page, so a torn node yields garbage that
+// fails validation rather than an out-of-bounds access.
+static u32 btree_node_count(const u8 *page, u32 page_size) {
+  u32 max_count =
+      (page_size - (u32)sizeof(BTreeNodeHeader)) / (u32)sizeof(BTreeSlot);
+  return MIN(((const BTreeNodeHeader *)page)->count, max_count);
+}
+
+// Stored key bytes of entry 'index': the full key in leaves, the suffix after
+// the node prefix in inner nodes.
+static StringView btree_node_key(const u8 *page, u32 page_size, u32 index) {
+  const BTreeSlot *slot =
+      (const BTreeSlot *)(page + sizeof(BTreeNodeHeader)) + index;
+  if ((u32)slot->offset + slot->length + sizeof(u64) > page_size) {
+    return sv_from_parts((const char *)page, 0);
+  }
+  return sv_from_parts((const char *)page + slot->offset, slot->length);
+}
+
+static u64 btree_node_value(const u8 *page, u32 page_size, u32 index) {
+  StringView key = btree_node_key(page, page_size, index);
+  u64 value;
+  memcpy(&value, key.data + key.length, sizeof(value));
+  return value;
+}
+
+// Binary search for the first entry whose key is >= 'key'. In inner nodes
+// the node prefix is matched once up front: a key that diverges from it sorts
+// entirely before or after every separator, and otherwise only its suffix
+// needs comparing.
+static u32 btree_node_search(const u8 *page, u32 page_size, StringView key,
+                             bool *out_exact) {
+  const BTreeNodeHeader *header = (const BTreeNodeHeader *)page;
+  u32 count = btree_node_count(page, page_size);
+  *out_exact = false;
+  if (header->prefix_length > 0) {
+    if ((u64)header->prefix_offset + header->prefix_length > page_size) {
+      return 0;
+    }
+    StringView prefix =
+        sv_from_parts((const char *)page + header->prefix_offset,
+                      header->prefix_length);
+    usize common = MIN(key.length, prefix.length);
+    int cmp = common ? memcmp(key.data, prefix.data, common) : 0;
+    if (cmp < 0 || (cmp == 0 && key.length < prefix.length)) {
+      return 0;
+    }
+    if (cmp > 0) {
+      return count;
+    }
+    key = sv_from_parts(key.data + prefix.length, key.length - prefix.length);
+  }
+
+  u32 low = 0;
+  u32 high = count;
+  while (low < high) {
+    u32 mid = low + (high - low) / 2;
+    int cmp = sv_compare(btree_node_key(page, page_size, mid), key);
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      *out_exact = cmp == 0;
+      high = mid;
+    }
+  }
+  *out_exact = *out_exact && low < count &&
+               sv_compare(btree_node_key(page, page_size, low), key) == 0;
+  return low;
+}
+
+static PageId btree_node_child(const u8 *page, u32 page_size, StringView key) {
+  bool exact;
+  u32 index = btree_node_search(page, page_size, key, &exact);
+  // Separators equal to the key route right: they are the smallest key of
+  // their subtree.
+  index += exact ? 1 : 0;
+  return index == 0 ? ((const BTreeNodeHeader *)page)->leftmost_child
+                    : btree_node_value(page, page_size, index - 1);
+}
+
+static void btree_node_init_leaf(u8 *page, u32 page_size) {
+  *btree_node_header(page) = (BTreeNodeHeader){
+      .magic = BTREE_NODE_MAGIC,
+      .free_end = page_size,
+      .prefix_offset = page_size,
+      .right_sibling = INVALID_PAGE_ID,
+      .leftmost_child = INVALID_PAGE_ID,
+  };
+}
+
+// Fast path: adds the entry to the leaf's free gap. Fails if the gap is too
+// small, in which case the caller rebuilds or splits the node.
+static bool btree_leaf_insert_in_place(u8 *page, u32 index, StringView key,
+                                       u64 value) {
+  BTreeNodeHeader *header = btree_node_header(page);
+  usize free_start =
+      sizeof(BTreeNodeHeader) + (header->count + 1u) * sizeof(BTreeSlot);
+  usize entry_size = key.length + sizeof(u64);
+  if (free_start + entry_size > header->free_end) {
+    return false;
+  }
+  BTreeSlot *slots = btree_node_slots(page);
+  memmove(&slots[index + 1], &slots[index],
+          (header->count - index) * sizeof(BTreeSlot));
+  header->free_end -= (u32)entry_size;
+  memcpy(page + header->free_end, key.data, key.length);
+  memcpy(page + header->free_end + key.length, &value, sizeof(value));
+  slots[index] = (BTreeSlot){.offset = (u16)header->free_end,
+                             .length = (u16)key.length};
+  header->count++;
+  return true;
+}
+
+static u32 btree_entry_length(const BTreeEntry *entry) {
+  return entry->head_length + entry->tail_length;
+}
+
+static u32 btree_entry_common_prefix(const BTreeEntry *a, const BTreeEntry *b) {
+  u32 length = MIN(btree_entry_length(a), btree_entry_length(b));
+  for (u32 i = 0; i < length; ++i) {
+    u8 x = i < a->head_length ? a->head[i] : a->tail[i - a->head_length];
+    u8 y = i < b->head_length ? b->head[i] : b->tail[i - b->head_length];
+    if (x != y) {
+      return i;
+    }
+  }
+  return length;
+}
+
+// Copies key bytes [from, to) to 'dst'.
+static void btree_entry_copy(const BTreeEntry *entry, u32 from, u32 to,
+                             u8 *dst) {
+  if (from < entry->head_length) {
+    u32 end = MIN(to, entry->head_length);
+    memcpy(dst, entry->head + from, end - from);
+    dst += end - from;
+    from = end;
+  }
+  if (from < to) {
+    memcpy(dst, entry->tail + (from - entry->head_length), to - from);
+  }
+}
+
+// Entries are sorted, so the prefix common to all of them is the one shared
+// by the first and the last.
+static u32 btree_node_prefix_length(const BTreeEntry *entries, u32 count,
+                                    u16 level) {
+  if (level == 0 || count == 0) {
+    return 0;
+  }
+  return btree_entry_common_prefix(&entries[0], &entries[count - 1]);
+}
+
+// Bytes a node built from 'entries' would occupy.
+static usize btree_node_size(const BTreeEntry *entries, u32 count, u16 level) {
+  u32 prefix_length = btree_node_prefix_length(entries, count, level);
+  usize size = sizeof(BTreeNodeHeader) + prefix_length;
+  for (u32 i = 0; i < count; ++i) {
+    size += sizeof(BTreeSlot) + sizeof(u64) +
+            btree_entry_length(&entries[i]) - prefix_length;
+  }
+  return size;
+}
+
+// Writes a fresh node holding 'entries'. The caller has checked that they fit
+// with btree_node_size. 'entries' must not point into 'page'.
+static void btree_node_build(u8 *page, u32 page_size, u16 level,
+                             PageId leftmost_child, PageId right_sibling,
+                             const BTreeEntry *entries, u32 count) {
+  u32 prefix_length = btree_node_prefix_length(entries, count, level);
+  BTreeNodeHeader *header = btree_node_header(page);
+  *header = (BTreeNodeHeader){
+      .magic = BTREE_NODE_MAGIC,
+      .level = level,
+      .count = (u16)count,
+      .prefix_offset = page_size - prefix_length,
+      .prefix_length = prefix_length,
+      .right_sibling = right_sibling,
+      .leftmost_child = leftmost_child,
+  };
+  if (prefix_length > 0) {
+    btree_entry_copy(&entries[0], 0, prefix_length,
+                     page + header->prefix_offset);
+  }
+  header->free_end = header->prefix_offset;
+
+  BTreeSlot *slots = btree_node_slots(page);
+  for (u32 i = 0; i < count; ++i) {
+    u32 length = btree_entry_length(&entries[i]);
+    header->free_end -= length - prefix_length + (u32)sizeof(u64);
+    btree_entry_copy(&entries[i], prefix_length, length,
+                     page + header->free_end);
+    length -= prefix_length;
+    memcpy(page + header->free_end + length, &entries[i].value, sizeof(u64));
+    slots[i] = (BTreeSlot){.offset = (u16)header->free_end,
+                           .length = (u16)length};
+  }
+}
+
+// Describes every entry of 'page' (a copy that outlives the returned
+// entries) and returns their number.
+static u32 btree_node_gather(const u8 *page, u32 page_size,
+                             BTreeEntry *entries) {
+  const BTreeNodeHeader *header = (const BTreeNodeHeader *)page;
+  for (u32 i = 0; i < header->count; ++i) {
+    StringView key = btree_node_key(page, page_size, i);
+    entries[i] = (BTreeEntry){.head = page + header->prefix_offset,
+                              .tail = (const u8 *)key.data,
+                              .head_length = header->prefix_length,
+                              .tail_length = (u32)key.length,
+                              .value = btree_node_value(page, page_size, i)};
+  }
+  return header->count;
+}
+
+// Picks where to cut an overfull entry list. A leaf split at 's' keeps
+// [0, s) and moves [s, count) to the new sibling. An inner split moves
+// [s + 1, count) and pushes entry 's' up as the separator. Starting from the
+// byte-balanced point, the nearest cut whose halves both fit is chosen: the
+// halves' prefixes can be shorter than the original node's, so the balanced
+// cut alone is not guaranteed to fit.
+static bool btree_choose_split(const BTree *bt, const BTreeEntry *entries,
+                               u32 count, u16 level, u32 *out_split) {
+  usize total = 0;
+  for (u32 i = 0; i < count; ++i) {
+    total += btree_entry_length(&entries[i]);
+  }
+  u32 balanced = 0;
+  usize running = 0;
+  while (balanced < count && running * 2 < total) {
+    running += btree_entry_length(&entries[balanced++]);
+  }
+
+  u32 low = level == 0 ? 1 : 0;
+  u32 high = count - 1; // Leaves and inner nodes both need one entry moved
+  balanced = CLAMP(balanced, low, high);
+  for (u32 distance = 0; distance <= count; ++distance) {
+    for (u32 side = 0; side < 2; ++side) {
+      if (side == 0 ? distance > balanced - low : distance > high - balanced) {
+        continue;
+      }
+      u32 split = side == 0 ? balanced - distance : balanced + distance;
+      u32 right_start = level == 0 ? split : split + 1;
+      if (btree_node_size(entries, split, level) <= bt->bp->page_size &&
+          btree_node_size(entries + right_start, count - right_start,
+                          level) <= bt->bp->page_size) {
+        *out_split = split;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Entries of a full node plus the one being added, if every key were empty.
+static usize btree_max_entries(u32 page_size) {
+  return page_size / (sizeof(BTreeSlot) + sizeof(u64)) + 2;
+}
+
+// The scratch block holds the entry list, a copy of the node being rebuilt
+// and two separator keys.
+static bool btree_alloc_scratch(BTree *bt) {
+  u32 page_size = bt->bp->page_size;
+  usize size = btree_max_entries(page_size) * sizeof(BTreeEntry) + page_size +
+               2 * (usize)btree_max_key_size(page_size);
+  bt->scratch = (u8 *)malloc(size);
+  if (!bt->scratch) {
+    LOG_ERROR("Failed to allocate B+tree scratch space");
+    return false;
+  }
+  return true;
+}
+
+static BTreeEntry *btree_scratch_entries(const BTree *bt) {
+  return (BTreeEntry *)bt->scratch;
+}
+
+static u8 *btree_scratch_page(const BTree *bt) {
+  usize entries_size =
+      btree_max_entries(bt->bp->page_size) * sizeof(BTreeEntry);
+  return bt->scratch + entries_size;
+}
+
+// Two separator buffers used alternately: a split copies its separator into
+// the buffer the entry being inserted does not point to.
+static u8 *btree_scratch_key(const BTree *bt, u32 which) {
+  return btree_scratch_page(bt) + bt->bp->page_size +
+         (usize)which * btree_max_key_size(bt->bp->page_size);
+}
+
+static bool btree_store_meta(BTree *bt) {
+  BufferFrame *frame = bp_fetch_page(bt->bp, bt->meta_page_id);
+  if (!frame) {
+    return false;
+  }
+  BTreeMeta meta = {.magic = BTREE_META_MAGIC,
+                    .page_size = bt->bp->page_size,
+                    .root_page_id = bt->root_page_id,
+                    .height = bt->height};
+  memcpy(frame->data, &meta, sizeof(meta));
+  bp_unpin_page(bt->bp, frame, true);
+  return true;
+}
+
+// Descends to the leaf that may hold 'key' and returns it pinned. When 'path'
+// is given, the inner nodes visited are recorded root first.
+static BufferFrame *btree_find_leaf(BTree *bt, StringView key, PageId *path,
+                                    u32 *out_depth) {
+  PageId page_id = bt->root_page_id;
+  u32 depth = 0;
+  for (;;) {
+    BufferFrame *frame = bp_fetch_page(bt->bp, page_id);
+    if (!frame) {
+      return NULL;
+    }
+    const BTreeNodeHeader *header = (const BTreeNodeHeader *)frame->data;
+    ASSERT_MSG(header->magic == BTREE_NODE_MAGIC,
+               "Page %" PRIu64 " is not a B+tree node", page_id);
+    if (header->level == 0) {
+      if (out_depth) {
+        *out_depth = depth;
+      }
+      return frame;
+    }
+    if (path) {
+      ASSERT(depth < BTREE_MAX_HEIGHT);
+      path[depth] = page_id;
+    }
+    depth++;
+    page_id = btree_node_child(frame->data, bt->bp->page_size, key);
+    bp_unpin_page(bt->bp, frame, false);
+  }
+}
+
+// Adds 'entry' to the pinned node in 'frame', rebuilding it and splitting off
+// a new right sibling if needed. On a split, returns the sibling's page id
+// and the separator to insert into the parent (its value is unset).
+static bool btree_insert_entry(BTree *bt, BufferFrame *frame,
+                               const BTreeEntry *entry, bool is_append,
+                               BTreeEntry *out_separator,
+                               PageId *out_right_id) {
+  u32 page_size = bt->bp->page_size;
+  u8 *copy = btree_scratch_page(bt);
+  memcpy(copy, frame->data, page_size);
+  const BTreeNodeHeader *header = (const BTreeNodeHeader *)copy;
+  u16 level = header->level;
+
+  // Rebuild the entry list with the new entry in sorted position. Keys are
+  // unique, so it never matches an existing entry.
+  ASSERT(entry->tail_length == 0);
+  BTreeEntry *entries = btree_scratch_entries(bt);
+  u32 count = btree_node_gather(copy, page_size, entries);
+  bool exact;
+  u32 index = btree_node_search(
+      copy, page_size,
+      sv_from_parts((const char *)entry->head, entry->head_length), &exact);
+  ASSERT(!exact);
+  (void)exact;
+  memmove(&entries[index + 1], &entries[index],
+          (count - index) * sizeof(BTreeEntry));
+  entries[index] = *entry;
+  count++;
+
+  if (btree_node_size(entries, count, level) <= page_size) {
+    btree_node_build(frame->data, page_size, level, header->leftmost_child,
+                     header->right_sibling, entries, count);
+    return true;
+  }
+
+  // Sequential loads split off only the new entry, leaving full leaves.
+  u32 split;
+  if (is_append && level == 0) {
+    split = count - 1;
+  } else if (!btree_choose_split(bt, entries, count, level, &split)) {
+    LOG_ERROR("No valid split for B+tree page %" PRIu64, frame->page_id);
+    return false;
+  }
+
+  PageId right_id;
+  BufferFrame *right = bp_new_page(bt->bp, &right_id);
+  if (!right) {
+    return false;
+  }
+  u32 right_start = level == 0 ? split : split + 1;
+  PageId right_leftmost =
+      level == 0 ? INVALID_PAGE_ID : entries[split].value;
+  btree_node_build(right->data, page_size, level, right_leftmost,
+                   header->right_sibling, entries + right_start,
+                   count - right_start);
+  bool tracked = btree_track_node(bt, right);
+  bp_unpin_page(bt->bp, right, true);
+  if (!tracked) {
+    return false;
+  }
+
+  // Leaf separators are cut to the shortest prefix of the right half's first
+  // key that still sorts above the left half, which keeps inner nodes small.
+  u8 *separator =
+      btree_scratch_key(bt, entry->head == btree_scratch_key(bt, 0) ? 1 : 0);
+  u32 separator_length = btree_entry_length(&entries[split]);
+  if (level == 0) {
+    separator_length =
+        btree_entry_common_prefix(&entries[split - 1], &entries[split]) + 1;
+  }
+  btree_entry_copy(&entries[split], 0, separator_length, separator);
+
+  btree_node_build(frame->data, page_size, level, header->leftmost_child,
+                   right_id, entries, split);
+  *out_separator = (BTreeEntry){.head = separator,
+                                .head_length = separator_length};
+  *out_right_id = right_id;
+  if (level == 0) {
+    bt->stats.leaf_splits++;
+  } else {
+    bt->stats.inner_splits++;
+  }
+  return true;
+}
+
+static bool btree_grow_root(BTree *bt, const BTreeEntry *separator,
+                            PageId right_id) {
+  if (bt->height == BTREE_MAX_HEIGHT) {
+    LOG_ERROR("B+tree reached its maximum height of %d", BTREE_MAX_HEIGHT);
+    return false;
+  }
+  PageId root_id;
+  BufferFrame *root = bp_new_page(bt->bp, &root_id);
+  if (!root) {
+    return false;
+  }
+  BTreeEntry entry = *separator;
+  entry.value = right_id;
+  btree_node_build(root->data, bt->bp->page_size, (u16)bt->height,
+                   bt->root_page_id, INVALID_PAGE_ID, &entry, 1);
+  bool tracked = btree_track_node(bt, root);
+  bp_unpin_page(bt->bp, root, true);
+  if (!tracked) {
+    return false;
+  }
+  // Published while the old root is still locked, so readers that find the
+  // old root unlocked also see that it is no longer the root.
+  __atomic_store_n(&bt->root_page_id, root_id, __ATOMIC_RELEASE);
+  bt->height++;
+  bt->stats.inner_splits++;
+  return btree_store_meta(bt);
+}
+
+// =================================================================================================
+// :: Optimistic Lock Coupling ::
+// =================================================================================================
+
+static BTreeNodeLatch *btree_directory_get(const BTree *bt, PageId page_id) {
+  PageId chunk_index = page_id >> BTREE_DIRECTORY_CHUNK_BITS;
+  if (chunk_index >= BTREE_DIRECTORY_CHUNKS) {
+    return NULL;
+  }
+  BTreeNodeLatch *chunk =
+      __atomic_load_n(&bt->directory[chunk_index], __ATOMIC_ACQUIRE);
+  if (!chunk) {
+    return NULL;
+  }
+  BTreeNodeLatch *latch =
+      &chunk[page_id & (BTREE_DIRECTORY_CHUNK_SIZE - 1)];
+  return __atomic_load_n(&latch->frame, __ATOMIC_ACQUIRE) ? latch : NULL;
+}
+
+// Registers a node whose pin the directory takes over. Only called by the
+// writer holding the write lock, or before the tree is shared.
+static bool btree_directory_put(BTree *bt, BufferFrame *frame) {
+  PageId chunk_index = frame->page_id >> BTREE_DIRECTORY_CHUNK_BITS;
+  if (chunk_index >= BTREE_DIRECTORY_CHUNKS) {
+    LOG_ERROR("Page %" PRIu64 " is beyond the B+tree latch directory",
+              frame->page_id);
+    return false;
+  }
+  BTreeNodeLatch *chunk = bt->directory[chunk_index];
+  if (!chunk) {
+    chunk = (BTreeNodeLatch *)calloc(BTREE_DIRECTORY_CHUNK_SIZE,
+                                     sizeof(BTreeNodeLatch));
+    if (!chunk) {
+      LOG_ERROR("Failed to allocate a B+tree latch directory chunk");
+      return false;
+    }
+    __atomic_store_n(&bt->directory[chunk_index], chunk, __ATOMIC_RELEASE);
+  }
+  BTreeNodeLatch *latch =
+      &chunk[frame->page_id & (BTREE_DIRECTORY_CHUNK_SIZE - 1)];
+  ASSERT(!latch->frame);
+  __atomic_store_n(&latch->frame, frame, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void btree_directory_free(BTree *bt) {
+  if (!bt->directory) {
+    return;
+  }
+  for (u32 i = 0; i < BTREE_DIRECTORY_CHUNKS; ++i) {
+    BTreeNodeLatch *chunk = bt->directory[i];
+    if (!chunk) {
+      continue;
+    }
+    for (u32 j = 0; j < BTREE_DIRECTORY_CHUNK_SIZE; ++j) {
+      if (chunk[j].frame) {
+        bp_unpin_page(bt->bp, chunk[j].frame, false);
+      }
+    }
+    free(chunk);
+  }
+  free(bt->directory);
+  bt->directory = NULL;
+}
+
+// Gives a newly allocated node its own directory pin in a concurrent tree.
+static bool btree_track_node(BTree *bt, BufferFrame *frame) {
+  if (!bt->directory) {
+    return true;
+  }
+  BufferFrame *pinned = bp_fetch_page(bt->bp, frame->page_id);
+  if (!pinned) {
+    return false;
+  }
+  if (!btree_directory_put(bt, pinned)) {
+    bp_unpin_page(bt->bp, pinned, false);
+    return false;
+  }
+  return true;
+}
+
+// Marks a node the writer is about to modify. Writers are serialized, so the
+// lock only has to stop readers: the odd version is published before any
+// change to the node becomes visible.
+static void btree_lock_node(BTree *bt, const BufferFrame *frame) {
+  if (!bt->directory) {
+    return;
+  }
+  BTreeNodeLatch *latch = btree_directory_get(bt, frame->page_id);
+  ASSERT(latch && bt->locked_count < BTREE_MAX_HEIGHT);
+  u64 version = __atomic_load_n(&latch->version, __ATOMIC_RELAXED);
+  __atomic_store_n(&latch->version, version + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  bt->locked[bt->locked_count++] = latch;
+}
+
+static void btree_unlock_nodes(BTree *bt) {
+  for (u32 i = 0; i < bt->locked_count; ++i) {
+    BTreeNodeLatch *latch = bt->locked[i];
+    u64 version = __atomic_load_n(&latch->version, __ATOMIC_RELAXED);
+    __atomic_store_n(&latch->version, version + 1, __ATOMIC_RELEASE);
+  }
+  bt->locked_count = 0;
+}
+
+// Waits for the node to be unlocked and returns the version to validate
+// against once the reader is done with it.
+static u64 btree_read_lock(const BTreeNodeLatch *latch) {
+  for (;;) {
+    u64 version = __atomic_load_n(&latch->version, __ATOMIC_ACQUIRE);
+    if ((version & 1) == 0) {
+      return version;
+    }
+    sched_yield();
+  }
+}
+
+static bool btree_read_validate(const BTreeNodeLatch *latch, u64 version) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&latch->version, __ATOMIC_RELAXED) == version;
+}
+
+// Descends to the leaf that may hold 'key' without taking any latch. Each
+// child is read-locked before its parent is validated, so a validated parent
+// vouches for the child pointer. Returns the leaf and its read version, which
+// the caller validates after reading the leaf.
+static BTreeNodeLatch *btree_find_leaf_optimistic(BTree *bt, StringView key,
+                                                  u64 *out_version) {
+  u32 page_size = bt->bp->page_size;
+  for (;;) {
+    PageId root_id = __atomic_load_n(&bt->root_page_id, __ATOMIC_ACQUIRE);
+    BTreeNodeLatch *latch = btree_directory_get(bt, root_id);
+    ASSERT(latch);
+    u64 version = btree_read_lock(latch);
+    if (__atomic_load_n(&bt->root_page_id, __ATOMIC_ACQUIRE) != root_id) {
+      continue;
+    }
+    for (u32 depth = 0; depth < BTREE_MAX_HEIGHT; ++depth) {
+      const u8 *page = latch->frame->data;
+      if (((const BTreeNodeHeader *)page)->level == 0) {
+        *out_version = version;
+        return latch;
+      }
+      PageId child_id = btree_node_child(page, page_size, key);
+      BTreeNodeLatch *child = btree_directory_get(bt, child_id);
+      u64 child_version = child ? btree_read_lock(child) : 0;
+      if (!btree_read_validate(latch, version)) {
+        break;
+      }
+      ASSERT_MSG(child, "B+tree child %" PRIu64 " is not pinned", child_id);
+      latch = child;
+      version = child_version;
+    }
+  }
+}
+
+static bool btree_lookup_optimistic(BTree *bt, StringView key,
+                                    u64 *out_value) {
+  u32 page_size = bt->bp->page_size;
+  for (;;) {
+    u64 version;
+    BTreeNodeLatch *latch = btree_find_leaf_optimistic(bt, key, &version);
+    const u8 *page = latch->frame->data;
+    bool exact;
+    u32 index = btree_node_search(page, page_size, key, &exact);
+    u64 value = exact ? btree_node_value(page, page_size, index) : 0;
+    if (btree_read_validate(latch, version)) {
+      if (exact) {
+        *out_value = value;
+      }
+      return exact;
+    }
+  }
+}
+
+static void btree_snapshot_node(const BTree *bt, const BTreeNodeLatch *latch,
+                                u8 *dst) {
+  for (;;) {
+    u64 version = btree_read_lock(latch);
+    memcpy(dst, latch->frame->data, bt->bp->page_size);
+    if (btree_read_validate(latch, version)) {
+      return;
+    }
+  }
+}
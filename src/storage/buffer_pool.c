@@ -0,0 +1,495 @@
+#include "sqldb/buffer_pool.h"
+
+#include <inttypes.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool bp_frame_is_evictable(usize frame_idx, void *ctx);
+static BufferFrame *bp_find_victim(BufferPool *bp);
+static void bp_release_frame(BufferPool *bp, BufferFrame *frame);
+static bool bp_read_page(BufferPool *bp, BufferFrame *frame, PageId page_id);
+static bool bp_write_page(BufferPool *bp, PageId page_id, const u8 *data);
+static bool bp_flush_wal_for(BufferPool *bp, Lsn page_lsn);
+static void bp_finish_prefetch(BufferPool *bp,
+                               const AsyncIoCompletion *completions, u32 count);
+static bool bp_finish_writeback(BufferPool *bp,
+                                const AsyncIoCompletion *completions,
+                                u32 count);
+
+#define BP_IO_BATCH 64
+
+HT_SWISS_DEFINE(PageTable, PageId, BufferFrame *, base_mix_u64,
+                BASE_HT_SWISS_EQUAL)
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+usize bp_required_arena_size(usize frame_count, u32 page_size,
+                             EvictionPolicyKind eviction, bool is_mapped) {
+  usize descriptors = frame_count * (sizeof(BufferFrame) + sizeof(usize)) +
+                      3 * BASE_ARENA_DEFAULT_ALIGNMENT;
+  // Frame data is aligned to page_size (for O_DIRECT), so reserve one extra
+  // page of slack.
+  usize data = is_mapped ? 0 : (frame_count + 1) * (usize)page_size;
+  return descriptors + data +
+         eviction_policy_required_arena_size(eviction, frame_count);
+}
+
+bool bp_init(BufferPool *bp, Arena *arena, usize frame_count, u32 page_size,
+             EvictionPolicyKind eviction, PageFile *file) {
+  ASSERT(bp && arena && file);
+  ASSERT(frame_count > 0 && page_size > 0);
+
+  ZERO_STRUCT(*bp);
+  bp->frame_count = frame_count;
+  bp->page_size = page_size;
+  bp->file = file;
+  bp->is_mapped = file->map != NULL;
+
+  bp->frames =
+      (BufferFrame *)arena_alloc(arena, frame_count * sizeof(BufferFrame));
+  bp->free_frames = (usize *)arena_alloc(arena, frame_count * sizeof(usize));
+  u8 *data = NULL;
+  if (!bp->is_mapped) {
+    data = (u8 *)arena_alloc_aligned(arena, frame_count * (usize)page_size,
+                                     page_size);
+  }
+  if (!bp->frames || !bp->free_frames || (!bp->is_mapped && !data)) {
+    LOG_ERROR("Failed to carve %zu frames of %u bytes from the arena",
+              frame_count, page_size);
+    return false;
+  }
+
+  for (usize i = 0; i < frame_count; ++i) {
+    bp->frames[i] = (BufferFrame){
+        .page_id = INVALID_PAGE_ID,
+        .data = data ? data + i * (usize)page_size : NULL,
+    };
+    bp->free_frames[i] = frame_count - 1 - i; // Hand out frame 0 first
+  }
+  bp->free_frame_count = frame_count;
+
+  if (!eviction_policy_init(&bp->eviction, eviction, frame_count, arena)) {
+    return false;
+  }
+
+  // The page table lives on the heap: evictions leave tombstones behind, and
+  // rebuilding the table to drop them needs a new slot array. It never holds
+  // more than frame_count pages, so it never grows.
+  bp->page_table = ht_PageTable_init(frame_count);
+  if (bp->page_table.capacity == 0) {
+    return false;
+  }
+
+  ASSERT(file->page_size == page_size);
+  bp->page_count = pf_page_count(file);
+
+  LOG_DEBUG("Buffer pool initialized: %zu %s frames of %u bytes (%s "
+            "eviction), %" PRIu64 " pages on disk",
+            frame_count, bp->is_mapped ? "mapped" : "buffered", page_size,
+            eviction_policy_name(eviction), bp->page_count);
+  return true;
+}
+
+void bp_shutdown(BufferPool *bp) {
+  ASSERT(bp);
+  ht_PageTable_free(&bp->page_table);
+  eviction_policy_free(&bp->eviction);
+  // Frames and their data belong to the arena passed to bp_init.
+  bp->frames = NULL;
+  bp->free_frames = NULL;
+  bp->frame_count = 0;
+  bp->free_frame_count = 0;
+}
+
+BufferFrame *bp_fetch_page(BufferPool *bp, PageId page_id) {
+  ASSERT(bp && page_id != INVALID_PAGE_ID);
+
+  if (bp->trace_file) {
+    fprintf(bp->trace_file, "%" PRIu64 "\n", page_id);
+  }
+
+  BufferFrame **resident = ht_PageTable_get(&bp->page_table, page_id);
+  if (resident) {
+    BufferFrame *frame = *resident;
+    bp->stats.hits++;
+    frame->pin_count++;
+    eviction_policy_on_access(&bp->eviction, (usize)(frame - bp->frames));
+    return frame;
+  }
+
+  bp->stats.misses++;
+  BufferFrame *frame = bp_find_victim(bp);
+  if (!frame) {
+    LOG_ERROR("Buffer pool exhausted: all %zu frames are pinned or failed "
+              "to write back",
+              bp->frame_count);
+    return NULL;
+  }
+
+  if (!bp_read_page(bp, frame, page_id)) {
+    bp_release_frame(bp, frame);
+    return NULL;
+  }
+
+  frame->page_id = page_id;
+  frame->page_lsn = INVALID_LSN;
+  frame->pin_count = 1;
+  frame->is_dirty = false;
+  frame->is_valid = true;
+  if (!ht_PageTable_insert(&bp->page_table, page_id, frame)) {
+    LOG_ERROR("Failed to register page %" PRIu64 " in the page table",
+              page_id);
+    bp_release_frame(bp, frame);
+    return NULL;
+  }
+  eviction_policy_on_insert(&bp->eviction, (usize)(frame - bp->frames),
+                            page_id);
+  return frame;
+}
+
+BufferFrame *bp_new_page(BufferPool *bp, PageId *out_page_id) {
+  ASSERT(bp && out_page_id);
+  if (bp->is_mapped) {
+    LOG_ERROR("Cannot allocate pages in a memory-mapped (read-only) database");
+    return NULL;
+  }
+
+  BufferFrame *frame = bp_find_victim(bp);
+  if (!frame) {
+    LOG_ERROR("Buffer pool exhausted: all %zu frames are pinned or failed "
+              "to write back",
+              bp->frame_count);
+    return NULL;
+  }
+
+  PageId page_id = bp->page_count;
+  memset(frame->data, 0, bp->page_size);
+  frame->page_id = page_id;
+  frame->page_lsn = INVALID_LSN;
+  frame->pin_count = 1;
+  frame->is_dirty = true; // Must reach disk even if the caller never writes
+  frame->is_valid = true;
+  if (!ht_PageTable_insert(&bp->page_table, page_id, frame)) {
+    LOG_ERROR("Failed to register page %" PRIu64 " in the page table",
+              page_id);
+    bp_release_frame(bp, frame);
+    return NULL;
+  }
+  eviction_policy_on_insert(&bp->eviction, (usize)(frame - bp->frames),
+                            page_id);
+
+  bp->page_count++;
+  *out_page_id = page_id;
+  return frame;
+}
+
+void bp_set_async_io(BufferPool *bp, AsyncIo *io) {
+  ASSERT(bp);
+  ASSERT(!io || io->file == bp->file);
+  bp->io = io;
+}
+
+u32 bp_prefetch_pages(BufferPool *bp, PageId first_page_id, u32 count) {
+  ASSERT(bp);
+  if (first_page_id >= bp->page_count) {
+    return 0;
+  }
+  if (bp->is_mapped) {
+    PageId mapped = MIN((PageId)count, bp->page_count - first_page_id);
+    if (!pf_advise(bp->file, first_page_id, mapped, PAGE_ACCESS_WILLNEED)) {
+      return 0;
+    }
+    bp->stats.prefetches += mapped;
+    return (u32)mapped;
+  }
+  if (!bp->io) {
+    return 0;
+  }
+
+  PageId end = MIN(first_page_id + count, bp->page_count);
+  u64 before = bp->stats.prefetches;
+  AsyncIoCompletion completions[BP_IO_BATCH];
+  for (PageId page_id = first_page_id; page_id < end; ++page_id) {
+    if (ht_PageTable_get(&bp->page_table, page_id)) {
+      continue;
+    }
+    BufferFrame *frame = bp_find_victim(bp);
+    if (!frame) {
+      break; // Everything else is pinned, possibly by this very batch
+    }
+
+    // Publish the page right away, pinned, so the rest of the batch cannot
+    // pick this frame as a victim while the read is in flight.
+    frame->page_id = page_id;
+    frame->page_lsn = INVALID_LSN;
+    frame->pin_count = 1;
+    frame->is_dirty = false;
+    frame->is_valid = true;
+    if (!ht_PageTable_insert(&bp->page_table, page_id, frame)) {
+      bp_release_frame(bp, frame);
+      break;
+    }
+
+    AsyncIoRequest request = {.op = ASYNC_IO_READ,
+                              .page_id = page_id,
+                              .buffer = frame->data,
+                              .user_data = frame};
+    while (!async_io_prepare(bp->io, &request)) {
+      async_io_submit(bp->io);
+      u32 n = async_io_reap(bp->io, completions, BP_IO_BATCH, 1);
+      bp_finish_prefetch(bp, completions, n);
+    }
+  }
+
+  async_io_submit(bp->io);
+  while (async_io_in_flight(bp->io) > 0) {
+    u32 n = async_io_reap(bp->io, completions, BP_IO_BATCH, 1);
+    if (n == 0) {
+      break;
+    }
+    bp_finish_prefetch(bp, completions, n);
+  }
+  return (u32)(bp->stats.prefetches - before);
+}
+
+void bp_set_wal(BufferPool *bp, Wal *wal) {
+  ASSERT(bp);
+  ASSERT(!wal || !bp->is_mapped);
+  bp->wal = wal;
+}
+
+Lsn bp_log_page_write(BufferPool *bp, BufferFrame *frame, u64 txn_id,
+                      u32 offset, u32 length) {
+  ASSERT(bp && frame && frame->is_valid && frame->pin_count > 0);
+  if (!bp->wal) {
+    return INVALID_LSN;
+  }
+  Lsn lsn = wal_log_page_write(bp->wal, txn_id, frame->page_id, offset,
+                               frame->data + offset, length);
+  if (lsn != INVALID_LSN) {
+    frame->page_lsn = lsn;
+    frame->is_dirty = true;
+  }
+  return lsn;
+}
+
+void bp_set_trace_file(BufferPool *bp, FILE *trace_file) {
+  ASSERT(bp);
+  bp->trace_file = trace_file;
+}
+
+void bp_unpin_page(BufferPool *bp, BufferFrame *frame, bool is_dirty) {
+  (void)bp;
+  ASSERT(bp && frame);
+  ASSERT_MSG(frame->pin_count > 0,
+             "Unpinning page %" PRIu64 " more often than it was pinned",
+             frame->page_id);
+  ASSERT_MSG(!is_dirty || !bp->is_mapped,
+             "Page %" PRIu64 " of a memory-mapped database was modified",
+             frame->page_id);
+  frame->pin_count--;
+  frame->is_dirty |= is_dirty;
+}
+
+bool bp_flush_page(BufferPool *bp, BufferFrame *frame) {
+  ASSERT(bp && frame);
+  if (!frame->is_valid || !frame->is_dirty) {
+    return true;
+  }
+  if (!bp_flush_wal_for(bp, frame->page_lsn) ||
+      !bp_write_page(bp, frame->page_id, frame->data)) {
+    return false;
+  }
+  frame->is_dirty = false;
+  bp->stats.writebacks++;
+  return true;
+}
+
+bool bp_flush_all(BufferPool *bp) {
+  ASSERT(bp);
+  bool ok = true;
+  if (!bp->io) {
+    for (usize i = 0; i < bp->frame_count; ++i) {
+      ok &= bp_flush_page(bp, &bp->frames[i]);
+    }
+    return pf_sync(bp->file) && ok;
+  }
+
+  // One log flush covers every page in the batch.
+  if (bp->wal && !wal_flush(bp->wal, bp->wal->next_lsn)) {
+    return false;
+  }
+  AsyncIoCompletion completions[BP_IO_BATCH];
+  for (usize i = 0; i < bp->frame_count; ++i) {
+    BufferFrame *frame = &bp->frames[i];
+    if (!frame->is_valid || !frame->is_dirty) {
+      continue;
+    }
+    AsyncIoRequest request = {.op = ASYNC_IO_WRITE,
+                              .page_id = frame->page_id,
+                              .buffer = frame->data,
+                              .user_data = frame};
+    while (!async_io_prepare(bp->io, &request)) {
+      async_io_submit(bp->io);
+      u32 n = async_io_reap(bp->io, completions, BP_IO_BATCH, 1);
+      ok &= bp_finish_writeback(bp, completions, n);
+    }
+  }
+  async_io_submit(bp->io);
+  while (async_io_in_flight(bp->io) > 0) {
+    u32 n = async_io_reap(bp->io, completions, BP_IO_BATCH, 1);
+    if (n == 0) {
+      ok = false;
+      break;
+    }
+    ok &= bp_finish_writeback(bp, completions, n);
+  }
+  return pf_sync(bp->file) && ok;
+}
+
+bool bp_has_pinned_dirty_page(const BufferPool *bp) {
+  ASSERT(bp);
+  for (usize i = 0; i < bp->frame_count; ++i) {
+    const BufferFrame *frame = &bp->frames[i];
+    if (frame->is_valid && frame->is_dirty && frame->pin_count > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+f64 bp_hit_ratio(const BufferPool *bp) {
+  ASSERT(bp);
+  u64 total = bp->stats.hits + bp->stats.misses;
+  return total > 0 ? (f64)bp->stats.hits / (f64)total : 0.0;
+}
+
+void bp_log_stats(const BufferPool *bp) {
+  ASSERT(bp);
+  LOG_INFO("Buffer pool: %" PRIu64 " hits, %" PRIu64 " misses (hit ratio "
+           "%.2f%%), %" PRIu64 " evictions, %" PRIu64 " writebacks, %" PRIu64
+           " prefetches",
+           bp->stats.hits, bp->stats.misses, bp_hit_ratio(bp) * 100.0,
+           bp->stats.evictions, bp->stats.writebacks, bp->stats.prefetches);
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool bp_frame_is_evictable(usize frame_idx, void *ctx) {
+  const BufferPool *bp = (const BufferPool *)ctx;
+  return bp->frames[frame_idx].pin_count == 0;
+}
+
+// Returns an unpinned frame ready to receive a new page, writing back and
+// unmapping its previous page if needed. A page whose write-back fails stays
+// resident and the next candidate is tried, so every frame gets a turn.
+// Returns NULL if all frames are pinned or none could be written back.
+static BufferFrame *bp_find_victim(BufferPool *bp) {
+  if (bp->free_frame_count > 0) {
+    return &bp->frames[bp->free_frames[--bp->free_frame_count]];
+  }
+
+  for (usize attempt = 0; attempt < bp->frame_count; ++attempt) {
+    usize frame_idx;
+    if (!eviction_policy_pick_victim(&bp->eviction, bp_frame_is_evictable, bp,
+                                     &frame_idx)) {
+      return NULL;
+    }
+
+    BufferFrame *frame = &bp->frames[frame_idx];
+    if (frame->is_dirty && !bp_flush_page(bp, frame)) {
+      // Keep the page resident rather than lose the update.
+      eviction_policy_on_reinstate(&bp->eviction, frame_idx);
+      continue;
+    }
+    ht_PageTable_remove(&bp->page_table, frame->page_id);
+    bp->stats.evictions++;
+    frame->page_id = INVALID_PAGE_ID;
+    frame->is_valid = false;
+    return frame;
+  }
+  return NULL;
+}
+
+// Returns a frame obtained from bp_find_victim to the free list unused.
+static void bp_release_frame(BufferPool *bp, BufferFrame *frame) {
+  frame->page_id = INVALID_PAGE_ID;
+  frame->pin_count = 0;
+  frame->is_dirty = false;
+  frame->is_valid = false;
+  if (bp->is_mapped) {
+    frame->data = NULL;
+  }
+  bp->free_frames[bp->free_frame_count++] = (usize)(frame - bp->frames);
+}
+
+static bool bp_read_page(BufferPool *bp, BufferFrame *frame, PageId page_id) {
+  if (bp->is_mapped) {
+    // No copy: the frame simply points at the page in the mapping.
+    frame->data = pf_mapped_page(bp->file, page_id);
+    if (!frame->data) {
+      LOG_ERROR("Page %" PRIu64 " is past the end of the mapped file",
+                page_id);
+      return false;
+    }
+    return true;
+  }
+  if (page_id >= bp->page_count) {
+    // Allocated by bp_new_page but never written back: nothing on disk yet.
+    memset(frame->data, 0, bp->page_size);
+    return true;
+  }
+  return pf_read_page(bp->file, page_id, frame->data);
+}
+
+static bool bp_write_page(BufferPool *bp, PageId page_id, const u8 *data) {
+  return pf_write_page(bp->file, page_id, data);
+}
+
+// Write-ahead rule: the log records describing a page must be durable before
+// the page itself overwrites its previous version on disk.
+static bool bp_flush_wal_for(BufferPool *bp, Lsn page_lsn) {
+  if (!bp->wal || page_lsn == INVALID_LSN) {
+    return true;
+  }
+  return wal_flush(bp->wal, page_lsn + 1);
+}
+
+static void bp_finish_prefetch(BufferPool *bp,
+                               const AsyncIoCompletion *completions,
+                               u32 count) {
+  for (u32 i = 0; i < count; ++i) {
+    BufferFrame *frame = (BufferFrame *)completions[i].user_data;
+    if (!completions[i].ok) {
+      ht_PageTable_remove(&bp->page_table, frame->page_id);
+      bp_release_frame(bp, frame);
+      continue;
+    }
+    frame->pin_count = 0;
+    eviction_policy_on_insert(&bp->eviction, (usize)(frame - bp->frames),
+                              frame->page_id);
+    bp->stats.prefetches++;
+  }
+}
+
+static bool bp_finish_writeback(BufferPool *bp,
+                                const AsyncIoCompletion *completions,
+                                u32 count) {
+  bool ok = true;
+  for (u32 i = 0; i < count; ++i) {
+    BufferFrame *frame = (BufferFrame *)completions[i].user_data;
+    if (completions[i].ok) {
+      frame->is_dirty = false;
+      bp->stats.writebacks++;
+    } else {
+      ok = false;
+    }
+  }
+  return ok;
+}
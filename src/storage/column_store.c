@@ -0,0 +1,1066 @@
+#include "sqldb/column_store.h"
+
+#include <inttypes.h>
+#include <math.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// How one chunk will be encoded, and the sizes that decided it.
+typedef struct {
+  ColumnEncoding encoding;
+  u32 dictionary_count;  // Distinct values
+  usize dictionary_bytes; // String bytes of the distinct values
+  u32 run_count;
+  usize run_bytes; // String bytes of the run values
+  i64 base;        // FOR minimum
+  u32 for_width;   // FOR bit width, 0 if FOR does not apply
+  u32 *codes;      // Dictionary code of every row
+  u32 *dictionary; // First row holding each distinct value
+} ColumnPlan;
+
+static bool column_buffer_init(ColumnBuffer *buffer, ColumnType type);
+static void column_buffer_free(ColumnBuffer *buffer);
+static void column_buffer_reset(ColumnBuffer *buffer, ColumnType type);
+static bool column_buffer_append(ColumnBuffer *buffer, ColumnType type,
+                                 const ColumnInput *input, u32 first,
+                                 u32 count, u32 at);
+static bool column_add_group(ColumnTable *table, u32 row_count,
+                             ColumnChunkInfo *chunks);
+static bool column_write_chunk(ColumnTable *table, u32 column,
+                               ColumnChunkInfo *out_info);
+static void column_fill_nulls(ColumnBuffer *buffer, u32 row_count);
+static void column_compute_zone(ColumnType type, const ColumnBuffer *buffer,
+                                u32 row_count, ColumnZoneMap *zone);
+static bool column_plan(ColumnType type, const ColumnBuffer *buffer,
+                        u32 row_count, ColumnPlan *plan);
+static bool column_build_dictionary(ColumnType type,
+                                    const ColumnBuffer *buffer, u32 row_count,
+                                    ColumnPlan *plan);
+static usize column_payload_size(ColumnType type, const ColumnBuffer *buffer,
+                                 u32 row_count, const ColumnPlan *plan,
+                                 ColumnEncoding encoding);
+static usize column_write_payload(ColumnType type, const ColumnBuffer *buffer,
+                                  u32 row_count, const ColumnPlan *plan,
+                                  u8 *out);
+static usize column_write_values(ColumnType type, const ColumnBuffer *buffer,
+                                 const u32 *rows, u32 count, u8 *out);
+static usize column_values_size(ColumnType type, u32 count,
+                                usize string_bytes);
+static usize column_packed_size(u32 count, u32 bit_width);
+static void column_pack(u8 *packed, u32 index, u32 bit_width, u64 value);
+static u64 column_unpack(const u8 *packed, u32 index, u32 bit_width);
+static u32 column_bit_width(u64 max_value);
+static bool column_rows_equal(ColumnType type, const ColumnBuffer *buffer,
+                              u32 a, u32 b);
+static u64 column_row_hash(ColumnType type, const ColumnBuffer *buffer,
+                           u32 row);
+static u64 column_row_bits(const ColumnBuffer *buffer, u32 row);
+static StringView column_row_string(const ColumnBuffer *buffer, u32 row);
+static StringView column_value_string(const u8 *values, u32 value_count,
+                                      u32 index);
+static void column_zone_string(ColumnZoneString *out, StringView value);
+static bool column_is_null(const u8 *bitmap, usize row);
+
+// Sections of a chunk start on this boundary so values can be read in place.
+#define COLUMN_SECTION_ALIGNMENT ((usize)8)
+// Bit-packed values are read with one unaligned 8-byte load, which holds a
+// value of up to 57 bits at any bit offset.
+#define COLUMN_MAX_PACKED_WIDTH 57
+#define COLUMN_INITIAL_STRING_BYTES (64 * 1024)
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool column_table_init(ColumnTable *table, BufferPool *bp,
+                       const ColumnType *types, u32 column_count) {
+  ASSERT(table && bp && types && column_count > 0);
+  ZERO_STRUCT(*table);
+  table->bp = bp;
+  table->column_count = column_count;
+  table->types = (ColumnType *)malloc(column_count * sizeof(ColumnType));
+  table->pending = (ColumnBuffer *)calloc(column_count, sizeof(ColumnBuffer));
+  if (!table->types || !table->pending) {
+    LOG_ERROR("Failed to allocate a column table of %u columns",
+              column_count);
+    column_table_free(table);
+    return false;
+  }
+  memcpy(table->types, types, column_count * sizeof(ColumnType));
+  for (u32 c = 0; c < column_count; ++c) {
+    if (!column_buffer_init(&table->pending[c], types[c])) {
+      LOG_ERROR("Failed to allocate the row group buffer of column %u", c);
+      column_table_free(table);
+      return false;
+    }
+  }
+  return true;
+}
+
+void column_table_free(ColumnTable *table) {
+  ASSERT(table);
+  if (table->pending) {
+    for (u32 c = 0; c < table->column_count; ++c) {
+      column_buffer_free(&table->pending[c]);
+    }
+  }
+  for (u32 g = 0; g < table->group_count; ++g) {
+    free(table->groups[g].chunks);
+  }
+  free(table->groups);
+  free(table->pending);
+  free(table->types);
+  free(table->scratch);
+  ZERO_STRUCT(*table);
+}
+
+bool column_table_append(ColumnTable *table, const ColumnInput *columns,
+                         u32 row_count) {
+  ASSERT(table && columns);
+  u32 done = 0;
+  while (done < row_count) {
+    u32 count = MIN(row_count - done, COLUMN_GROUP_ROWS - table->pending_rows);
+    for (u32 c = 0; c < table->column_count; ++c) {
+      if (!column_buffer_append(&table->pending[c], table->types[c],
+                                &columns[c], done, count,
+                                table->pending_rows)) {
+        return false;
+      }
+    }
+    table->pending_rows += count;
+    done += count;
+    if (table->pending_rows == COLUMN_GROUP_ROWS &&
+        !column_table_flush(table)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool column_table_flush(ColumnTable *table) {
+  ASSERT(table);
+  if (table->pending_rows == 0) {
+    return true;
+  }
+  ColumnChunkInfo *chunks =
+      (ColumnChunkInfo *)calloc(table->column_count, sizeof(ColumnChunkInfo));
+  if (!chunks) {
+    LOG_ERROR("Failed to allocate a row group directory entry");
+    return false;
+  }
+  for (u32 c = 0; c < table->column_count; ++c) {
+    if (!column_write_chunk(table, c, &chunks[c])) {
+      free(chunks);
+      return false;
+    }
+  }
+  if (!column_add_group(table, table->pending_rows, chunks)) {
+    free(chunks);
+    return false;
+  }
+  for (u32 c = 0; c < table->column_count; ++c) {
+    column_buffer_reset(&table->pending[c], table->types[c]);
+  }
+  table->pending_rows = 0;
+  return true;
+}
+
+bool column_table_add_row_group(ColumnTable *table,
+                                const PageId *first_pages) {
+  ASSERT(table && first_pages);
+  u32 page_size = table->bp->page_size;
+  ColumnChunkInfo *chunks =
+      (ColumnChunkInfo *)calloc(table->column_count, sizeof(ColumnChunkInfo));
+  if (!chunks) {
+    LOG_ERROR("Failed to allocate a row group directory entry");
+    return false;
+  }
+  u32 row_count = 0;
+  for (u32 c = 0; c < table->column_count; ++c) {
+    BufferFrame *frame = bp_fetch_page(table->bp, first_pages[c]);
+    if (!frame) {
+      free(chunks);
+      return false;
+    }
+    ColumnChunkHeader header;
+    memcpy(&header, frame->data, sizeof(header));
+    bp_unpin_page(table->bp, frame, false);
+    if (header.magic != COLUMN_CHUNK_MAGIC ||
+        header.type != (u8)table->types[c] ||
+        header.encoding >= COLUMN_ENCODING_COUNT ||
+        header.byte_length < sizeof(header) ||
+        (c > 0 && header.row_count != row_count)) {
+      LOG_ERROR("Page %" PRIu64 " does not start chunk %u of a row group",
+                first_pages[c], c);
+      free(chunks);
+      return false;
+    }
+    row_count = header.row_count;
+    chunks[c] = (ColumnChunkInfo){
+        .first_page = first_pages[c],
+        .page_count = (header.byte_length + page_size - 1) / page_size,
+        .byte_length = header.byte_length,
+        .encoding = (ColumnEncoding)header.encoding,
+        .zone = header.zone,
+    };
+  }
+  if (!column_add_group(table, row_count, chunks)) {
+    free(chunks);
+    return false;
+  }
+  return true;
+}
+
+bool column_reader_open(ColumnReader *reader, const ColumnTable *table,
+                        u32 group, u32 column, u8 *buffer) {
+  ASSERT(reader && table && buffer);
+  ASSERT(group < table->group_count && column < table->column_count);
+  const ColumnChunkInfo *info = &table->groups[group].chunks[column];
+  BufferPool *bp = table->bp;
+  if (info->page_count > 1) {
+    bp_prefetch_pages(bp, info->first_page, info->page_count);
+  }
+  usize copied = 0;
+  for (u32 p = 0; p < info->page_count; ++p) {
+    BufferFrame *frame = bp_fetch_page(bp, info->first_page + p);
+    if (!frame) {
+      return false;
+    }
+    usize length = MIN((usize)bp->page_size, info->byte_length - copied);
+    memcpy(buffer + copied, frame->data, length);
+    bp_unpin_page(bp, frame, false);
+    copied += length;
+  }
+
+  ZERO_STRUCT(*reader);
+  const ColumnChunkHeader *header = (const ColumnChunkHeader *)buffer;
+  if (header->magic != COLUMN_CHUNK_MAGIC ||
+      header->byte_length != info->byte_length) {
+    LOG_ERROR("Chunk at page %" PRIu64 " is corrupt", info->first_page);
+    return false;
+  }
+  reader->header = header;
+  const u8 *section =
+      buffer + ALIGN_UP(sizeof(ColumnChunkHeader), COLUMN_SECTION_ALIGNMENT);
+  if (header->zone.null_count > 0) {
+    reader->nulls = section;
+    section += ALIGN_UP(((usize)header->row_count + 7) / 8,
+                        COLUMN_SECTION_ALIGNMENT);
+  }
+
+  ColumnType type = (ColumnType)header->type;
+  const u32 *counts = (const u32 *)section;
+  switch ((ColumnEncoding)header->encoding) {
+  case COLUMN_ENCODING_PLAIN:
+    reader->values = section;
+    reader->value_count = header->row_count;
+    break;
+  case COLUMN_ENCODING_DICTIONARY:
+    reader->value_count = counts[0];
+    reader->bit_width = counts[1];
+    reader->values = section + 2 * sizeof(u32);
+    reader->packed =
+        reader->values +
+        column_values_size(type, reader->value_count,
+                           type == COLUMN_TYPE_STRING
+                               ? ((const u32 *)reader->values)
+                                     [reader->value_count]
+                               : 0);
+    break;
+  case COLUMN_ENCODING_RLE:
+    reader->value_count = counts[0];
+    reader->values = section + 2 * sizeof(u32);
+    reader->lengths =
+        (const u32 *)(reader->values +
+                      column_values_size(
+                          type, reader->value_count,
+                          type == COLUMN_TYPE_STRING
+                              ? ((const u32 *)reader->values)
+                                    [reader->value_count]
+                              : 0));
+    reader->run_left = reader->value_count > 0 ? reader->lengths[0] : 0;
+    break;
+  case COLUMN_ENCODING_FOR:
+    memcpy(&reader->base, section, sizeof(i64));
+    reader->bit_width = counts[2];
+    reader->packed = section + 2 * sizeof(i64);
+    break;
+  default:
+    LOG_ERROR("Chunk at page %" PRIu64 " has unknown encoding %u",
+              info->first_page, header->encoding);
+    return false;
+  }
+  return true;
+}
+
+void column_reader_read(ColumnReader *reader, u32 count, void *out,
+                        bool *out_nulls) {
+  ASSERT(reader && reader->header && out);
+  const ColumnChunkHeader *header = reader->header;
+  ASSERT(reader->position + count <= header->row_count);
+  ColumnType type = (ColumnType)header->type;
+  u32 position = reader->position;
+  u64 *bits = (u64 *)out;
+  StringView *strings = (StringView *)out;
+
+  switch ((ColumnEncoding)header->encoding) {
+  case COLUMN_ENCODING_PLAIN:
+    if (type != COLUMN_TYPE_STRING) {
+      memcpy(out, reader->values + (usize)position * sizeof(u64),
+             count * sizeof(u64));
+    } else {
+      for (u32 i = 0; i < count; ++i) {
+        strings[i] = column_value_string(reader->values, reader->value_count,
+                                         position + i);
+      }
+    }
+    break;
+  case COLUMN_ENCODING_DICTIONARY:
+    if (type != COLUMN_TYPE_STRING) {
+      const u64 *dictionary = (const u64 *)reader->values;
+      for (u32 i = 0; i < count; ++i) {
+        bits[i] = dictionary[column_unpack(reader->packed, position + i,
+                                           reader->bit_width)];
+      }
+    } else {
+      for (u32 i = 0; i < count; ++i) {
+        u32 code = (u32)column_unpack(reader->packed, position + i,
+                                      reader->bit_width);
+        strings[i] =
+            column_value_string(reader->values, reader->value_count, code);
+      }
+    }
+    break;
+  case COLUMN_ENCODING_RLE: {
+    u32 i = 0;
+    while (i < count) {
+      while (reader->run_left == 0) {
+        reader->run_left = reader->lengths[++reader->run];
+      }
+      u32 n = MIN(count - i, reader->run_left);
+      if (type != COLUMN_TYPE_STRING) {
+        u64 value = ((const u64 *)reader->values)[reader->run];
+        for (u32 k = 0; k < n; ++k) {
+          bits[i + k] = value;
+        }
+      } else {
+        StringView value = column_value_string(
+            reader->values, reader->value_count, reader->run);
+        for (u32 k = 0; k < n; ++k) {
+          strings[i + k] = value;
+        }
+      }
+      reader->run_left -= n;
+      i += n;
+    }
+    break;
+  }
+  case COLUMN_ENCODING_FOR: {
+    i64 *values = (i64 *)out;
+    for (u32 i = 0; i < count; ++i) {
+      values[i] = reader->base + (i64)column_unpack(reader->packed,
+                                                    position + i,
+                                                    reader->bit_width);
+    }
+    break;
+  }
+  default:
+    ASSERT_MSG(false, "Unknown column encoding");
+    break;
+  }
+
+  if (reader->nulls) {
+    u32 i = 0;
+    while (i < count) {
+      usize row = (usize)position + i;
+      if (row % 8 == 0 && count - i >= 8 && reader->nulls[row / 8] == 0) {
+        i += 8;
+        continue;
+      }
+      if (column_is_null(reader->nulls, row)) {
+        if (type == COLUMN_TYPE_STRING) {
+          strings[i] = sv_from_parts("", 0);
+        } else {
+          bits[i] = 0; // 0 and 0.0 alike
+        }
+        if (out_nulls) {
+          out_nulls[i] = true;
+        }
+      }
+      ++i;
+    }
+  }
+  reader->position += count;
+}
+
+void column_reader_skip(ColumnReader *reader, u32 count) {
+  ASSERT(reader && reader->header);
+  ASSERT(reader->position + count <= reader->header->row_count);
+  reader->position += count;
+  if (reader->header->encoding != COLUMN_ENCODING_RLE) {
+    return;
+  }
+  while (count > reader->run_left) {
+    count -= reader->run_left;
+    reader->run_left = reader->lengths[++reader->run];
+  }
+  reader->run_left -= count;
+}
+
+const char *column_encoding_name(ColumnEncoding encoding) {
+  switch (encoding) {
+  case COLUMN_ENCODING_PLAIN:
+    return "plain";
+  case COLUMN_ENCODING_DICTIONARY:
+    return "dictionary";
+  case COLUMN_ENCODING_RLE:
+    return "rle";
+  case COLUMN_ENCODING_FOR:
+    return "for";
+  default:
+    return "unknown";
+  }
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// --- Row group buffers ---
+
+static bool column_buffer_init(ColumnBuffer *buffer, ColumnType type) {
+  usize value_bytes = type == COLUMN_TYPE_STRING
+                          ? (COLUMN_GROUP_ROWS + 1) * sizeof(u32)
+                          : COLUMN_GROUP_ROWS * sizeof(u64);
+  buffer->values = (u8 *)malloc(value_bytes);
+  buffer->nulls = (u8 *)calloc(COLUMN_GROUP_ROWS / 8, 1);
+  if (type == COLUMN_TYPE_STRING) {
+    buffer->bytes = (char *)malloc(COLUMN_INITIAL_STRING_BYTES);
+    buffer->byte_capacity = COLUMN_INITIAL_STRING_BYTES;
+  }
+  if (!buffer->values || !buffer->nulls ||
+      (type == COLUMN_TYPE_STRING && !buffer->bytes)) {
+    return false;
+  }
+  column_buffer_reset(buffer, type);
+  return true;
+}
+
+static void column_buffer_free(ColumnBuffer *buffer) {
+  free(buffer->values);
+  free(buffer->bytes);
+  free(buffer->nulls);
+  ZERO_STRUCT(*buffer);
+}
+
+static void column_buffer_reset(ColumnBuffer *buffer, ColumnType type) {
+  if (type == COLUMN_TYPE_STRING) {
+    ((u32 *)buffer->values)[0] = 0;
+  }
+  buffer->byte_count = 0;
+  if (buffer->null_count > 0) {
+    memset(buffer->nulls, 0, COLUMN_GROUP_ROWS / 8);
+    buffer->null_count = 0;
+  }
+}
+
+// Copies rows [first, first + count) of 'input' to rows [at, at + count) of
+// the buffer. NULL strings are stored empty.
+static bool column_buffer_append(ColumnBuffer *buffer, ColumnType type,
+                                 const ColumnInput *input, u32 first,
+                                 u32 count, u32 at) {
+  ASSERT(input->values || count == 0);
+  for (u32 i = 0; i < count; ++i) {
+    if (input->nulls && column_is_null(input->nulls, first + i)) {
+      buffer->nulls[(at + i) / 8] |= (u8)(1u << ((at + i) % 8));
+      buffer->null_count++;
+    }
+  }
+  if (type != COLUMN_TYPE_STRING) {
+    memcpy(buffer->values + (usize)at * sizeof(u64),
+           (const u8 *)input->values + (usize)first * sizeof(u64),
+           count * sizeof(u64));
+    return true;
+  }
+
+  const StringView *strings = (const StringView *)input->values + first;
+  u32 *offsets = (u32 *)buffer->values;
+  for (u32 i = 0; i < count; ++i) {
+    usize length = column_is_null(buffer->nulls, at + i) ? 0
+                                                         : strings[i].length;
+    usize needed = buffer->byte_count + length;
+    if (needed > UINT32_MAX) {
+      LOG_ERROR("Strings of a row group exceed 4 GB");
+      return false;
+    }
+    if (needed > buffer->byte_capacity) {
+      usize capacity = MAX(buffer->byte_capacity * 2, needed);
+      char *bytes = (char *)realloc(buffer->bytes, capacity);
+      if (!bytes) {
+        LOG_ERROR("Failed to grow string buffer to %zu bytes", capacity);
+        return false;
+      }
+      buffer->bytes = bytes;
+      buffer->byte_capacity = capacity;
+    }
+    if (length > 0) {
+      memcpy(buffer->bytes + buffer->byte_count, strings[i].data, length);
+    }
+    buffer->byte_count = needed;
+    offsets[at + i + 1] = (u32)needed;
+  }
+  return true;
+}
+
+static bool column_add_group(ColumnTable *table, u32 row_count,
+                             ColumnChunkInfo *chunks) {
+  if (table->group_count == table->group_capacity) {
+    u32 capacity = MAX(table->group_capacity * 2, 16u);
+    ColumnRowGroup *groups = (ColumnRowGroup *)realloc(
+        table->groups, capacity * sizeof(ColumnRowGroup));
+    if (!groups) {
+      LOG_ERROR("Failed to grow the row group directory to %u groups",
+                capacity);
+      return false;
+    }
+    table->groups = groups;
+    table->group_capacity = capacity;
+  }
+  table->groups[table->group_count++] =
+      (ColumnRowGroup){.row_count = row_count, .chunks = chunks};
+  table->row_count += row_count;
+  table->stats.row_groups++;
+  return true;
+}
+
+// --- Encoding ---
+
+// Encodes the buffered rows of 'column' into table->scratch and writes them
+// to freshly appended, consecutive pages.
+static bool column_write_chunk(ColumnTable *table, u32 column,
+                               ColumnChunkInfo *out_info) {
+  ColumnType type = table->types[column];
+  ColumnBuffer *buffer = &table->pending[column];
+  u32 row_count = table->pending_rows;
+  if (type != COLUMN_TYPE_STRING && buffer->null_count > 0) {
+    column_fill_nulls(buffer, row_count);
+  }
+
+  ColumnChunkHeader header = {
+      .magic = COLUMN_CHUNK_MAGIC,
+      .type = (u8)type,
+      .row_count = row_count,
+  };
+  column_compute_zone(type, buffer, row_count, &header.zone);
+  header.zone.null_count = buffer->null_count;
+
+  ColumnPlan plan;
+  if (!column_plan(type, buffer, row_count, &plan)) {
+    return false;
+  }
+  header.encoding = (u8)plan.encoding;
+  usize head_bytes =
+      ALIGN_UP(sizeof(ColumnChunkHeader), COLUMN_SECTION_ALIGNMENT);
+  if (buffer->null_count > 0) {
+    head_bytes += ALIGN_UP(((usize)row_count + 7) / 8,
+                           COLUMN_SECTION_ALIGNMENT);
+  }
+  usize length = head_bytes + column_payload_size(type, buffer, row_count,
+                                                  &plan, plan.encoding);
+  if (length > UINT32_MAX) {
+    LOG_ERROR("Chunk of column %u takes more than 4 GB", column);
+    free(plan.codes);
+    free(plan.dictionary);
+    return false;
+  }
+  if (length > table->scratch_capacity) {
+    u8 *scratch = (u8 *)realloc(table->scratch, length);
+    if (!scratch) {
+      LOG_ERROR("Failed to allocate %zu bytes to encode a chunk", length);
+      free(plan.codes);
+      free(plan.dictionary);
+      return false;
+    }
+    table->scratch = scratch;
+    table->scratch_capacity = length;
+  }
+
+  u8 *blob = table->scratch;
+  memset(blob, 0, length);
+  header.byte_length = (u32)length;
+  memcpy(blob, &header, sizeof(header));
+  if (buffer->null_count > 0) {
+    memcpy(blob + ALIGN_UP(sizeof(ColumnChunkHeader),
+                           COLUMN_SECTION_ALIGNMENT),
+           buffer->nulls, ((usize)row_count + 7) / 8);
+  }
+  usize written = column_write_payload(type, buffer, row_count, &plan,
+                                       blob + head_bytes);
+  ASSERT(head_bytes + written == length);
+  (void)written;
+  free(plan.codes);
+  free(plan.dictionary);
+
+  BufferPool *bp = table->bp;
+  u32 page_count = (u32)((length + bp->page_size - 1) / bp->page_size);
+  PageId first_page = INVALID_PAGE_ID;
+  for (u32 p = 0; p < page_count; ++p) {
+    PageId page_id;
+    BufferFrame *frame = bp_new_page(bp, &page_id);
+    if (!frame) {
+      return false;
+    }
+    if (p == 0) {
+      first_page = page_id;
+    }
+    usize offset = (usize)p * bp->page_size;
+    memcpy(frame->data, blob + offset, MIN((usize)bp->page_size,
+                                           length - offset));
+    bp_unpin_page(bp, frame, true);
+    // Nothing else allocates pages between these calls.
+    ASSERT_MSG(page_id == first_page + p, "Chunk pages are not consecutive");
+  }
+
+  *out_info = (ColumnChunkInfo){
+      .first_page = first_page,
+      .page_count = page_count,
+      .byte_length = (u32)length,
+      .encoding = plan.encoding,
+      .zone = header.zone,
+  };
+  table->stats.chunks[plan.encoding]++;
+  table->stats.encoded_bytes += length;
+  table->stats.plain_bytes +=
+      head_bytes + column_payload_size(type, buffer, row_count, &plan,
+                                       COLUMN_ENCODING_PLAIN);
+  return true;
+}
+
+// Gives every NULL number the value of the row before it (leading NULLs the
+// first non-NULL value), so NULLs extend runs and stay within FOR bounds.
+static void column_fill_nulls(ColumnBuffer *buffer, u32 row_count) {
+  u64 *values = (u64 *)buffer->values;
+  u32 first = 0;
+  while (first < row_count && column_is_null(buffer->nulls, first)) {
+    ++first;
+  }
+  u64 previous = first < row_count ? values[first] : 0;
+  for (u32 row = 0; row < row_count; ++row) {
+    if (column_is_null(buffer->nulls, row)) {
+      values[row] = previous;
+    } else {
+      previous = values[row];
+    }
+  }
+}
+
+static void column_compute_zone(ColumnType type, const ColumnBuffer *buffer,
+                                u32 row_count, ColumnZoneMap *zone) {
+  ZERO_STRUCT(*zone);
+  u32 row = 0;
+  while (row < row_count && column_is_null(buffer->nulls, row)) {
+    ++row;
+  }
+  if (row == row_count) {
+    return;
+  }
+  zone->has_bounds = true;
+  zone->has_max = true;
+
+  switch (type) {
+  case COLUMN_TYPE_INT64: {
+    const i64 *values = (const i64 *)buffer->values;
+    i64 min = values[row], max = values[row];
+    for (; row < row_count; ++row) {
+      // NULLs hold a copy of a neighbour, so they never move the bounds.
+      min = MIN(min, values[row]);
+      max = MAX(max, values[row]);
+    }
+    zone->min.i64 = min;
+    zone->max.i64 = max;
+    break;
+  }
+  case COLUMN_TYPE_FLOAT64: {
+    const f64 *values = (const f64 *)buffer->values;
+    f64 min = values[row], max = values[row];
+    for (; row < row_count; ++row) {
+      if (isnan(values[row])) {
+        zone->has_bounds = false;
+        zone->has_max = false;
+        return;
+      }
+      min = MIN(min, values[row]);
+      max = MAX(max, values[row]);
+    }
+    zone->min.f64 = min;
+    zone->max.f64 = max;
+    break;
+  }
+  case COLUMN_TYPE_STRING: {
+    StringView min = column_row_string(buffer, row);
+    StringView max = min;
+    for (; row < row_count; ++row) {
+      if (column_is_null(buffer->nulls, row)) {
+        continue;
+      }
+      StringView value = column_row_string(buffer, row);
+      if (sv_compare(value, min) < 0) {
+        min = value;
+      } else if (sv_compare(value, max) > 0) {
+        max = value;
+      }
+    }
+    column_zone_string(&zone->min.string, min);
+    if (max.length <= COLUMN_ZONE_STRING_BYTES) {
+      column_zone_string(&zone->max.string, max);
+    } else {
+      zone->has_max = false;
+    }
+    break;
+  }
+  }
+}
+
+// Sizes every encoding that applies and picks the smallest; ties go to the
+// cheaper one to decode, in enum order.
+static bool column_plan(ColumnType type, const ColumnBuffer *buffer,
+                        u32 row_count, ColumnPlan *plan) {
+  ZERO_STRUCT(*plan);
+  if (!column_build_dictionary(type, buffer, row_count, plan)) {
+    return false;
+  }
+
+  plan->run_count = row_count > 0 ? 1 : 0;
+  plan->run_bytes = row_count > 0 && type == COLUMN_TYPE_STRING
+                        ? column_row_string(buffer, 0).length
+                        : 0;
+  for (u32 row = 1; row < row_count; ++row) {
+    if (!column_rows_equal(type, buffer, row - 1, row)) {
+      plan->run_count++;
+      if (type == COLUMN_TYPE_STRING) {
+        plan->run_bytes += column_row_string(buffer, row).length;
+      }
+    }
+  }
+
+  if (type == COLUMN_TYPE_INT64 && row_count > 0) {
+    const i64 *values = (const i64 *)buffer->values;
+    i64 min = values[0], max = values[0];
+    for (u32 row = 1; row < row_count; ++row) {
+      min = MIN(min, values[row]);
+      max = MAX(max, values[row]);
+    }
+    u32 width = column_bit_width((u64)max - (u64)min);
+    if (width <= COLUMN_MAX_PACKED_WIDTH) {
+      plan->base = min;
+      plan->for_width = width;
+    } else {
+      plan->for_width = UINT32_MAX;
+    }
+  }
+
+  plan->encoding = COLUMN_ENCODING_PLAIN;
+  usize best = column_payload_size(type, buffer, row_count, plan,
+                                   COLUMN_ENCODING_PLAIN);
+  for (u32 e = COLUMN_ENCODING_DICTIONARY; e < COLUMN_ENCODING_COUNT; ++e) {
+    ColumnEncoding encoding = (ColumnEncoding)e;
+    if (encoding == COLUMN_ENCODING_DICTIONARY && !plan->codes) {
+      continue;
+    }
+    if (encoding == COLUMN_ENCODING_FOR &&
+        (type != COLUMN_TYPE_INT64 || row_count == 0 ||
+         plan->for_width == UINT32_MAX)) {
+      continue;
+    }
+    usize size =
+        column_payload_size(type, buffer, row_count, plan, encoding);
+    if (size < best) {
+      best = size;
+      plan->encoding = encoding;
+    }
+  }
+  return true;
+}
+
+// Assigns every row the code of its value, in order of first appearance.
+// Leaves plan->codes NULL, and the encoding unused, once there are so many
+// distinct values that it could not beat PLAIN.
+static bool column_build_dictionary(ColumnType type,
+                                    const ColumnBuffer *buffer, u32 row_count,
+                                    ColumnPlan *plan) {
+  usize slot_count = 1;
+  while (slot_count < (usize)row_count * 2) {
+    slot_count <<= 1;
+  }
+  u32 *slots = (u32 *)calloc(slot_count, sizeof(u32)); // Code + 1, 0 empty
+  plan->codes = (u32 *)malloc(MAX(row_count, 1u) * sizeof(u32));
+  plan->dictionary = (u32 *)malloc(MAX(row_count, 1u) * sizeof(u32));
+  if (!slots || !plan->codes || !plan->dictionary) {
+    LOG_ERROR("Failed to allocate a dictionary for %u rows", row_count);
+    free(slots);
+    free(plan->codes);
+    free(plan->dictionary);
+    plan->codes = NULL;
+    plan->dictionary = NULL;
+    return false;
+  }
+
+  u32 limit = row_count / 2;
+  usize mask = slot_count - 1;
+  for (u32 row = 0; row < row_count; ++row) {
+    usize slot = (usize)column_row_hash(type, buffer, row) & mask;
+    while (slots[slot] != 0 &&
+           !column_rows_equal(type, buffer,
+                              plan->dictionary[slots[slot] - 1], row)) {
+      slot = (slot + 1) & mask;
+    }
+    if (slots[slot] == 0) {
+      if (plan->dictionary_count == limit && row_count > 1) {
+        free(plan->codes);
+        free(plan->dictionary);
+        plan->codes = NULL;
+        plan->dictionary = NULL;
+        plan->dictionary_count = 0;
+        plan->dictionary_bytes = 0;
+        break;
+      }
+      plan->dictionary[plan->dictionary_count] = row;
+      slots[slot] = ++plan->dictionary_count;
+      if (type == COLUMN_TYPE_STRING) {
+        plan->dictionary_bytes += column_row_string(buffer, row).length;
+      }
+    }
+    plan->codes[row] = slots[slot] - 1;
+  }
+  free(slots);
+  return true;
+}
+
+static usize column_payload_size(ColumnType type, const ColumnBuffer *buffer,
+                                 u32 row_count, const ColumnPlan *plan,
+                                 ColumnEncoding encoding) {
+  switch (encoding) {
+  case COLUMN_ENCODING_PLAIN:
+    return column_values_size(type, row_count, buffer->byte_count);
+  case COLUMN_ENCODING_DICTIONARY:
+    return 2 * sizeof(u32) +
+           column_values_size(type, plan->dictionary_count,
+                              plan->dictionary_bytes) +
+           column_packed_size(row_count,
+                              column_bit_width(plan->dictionary_count > 0
+                                                   ? plan->dictionary_count - 1
+                                                   : 0));
+  case COLUMN_ENCODING_RLE:
+    return 2 * sizeof(u32) +
+           column_values_size(type, plan->run_count, plan->run_bytes) +
+           ALIGN_UP(plan->run_count * sizeof(u32), COLUMN_SECTION_ALIGNMENT);
+  case COLUMN_ENCODING_FOR:
+    return 2 * sizeof(i64) + column_packed_size(row_count, plan->for_width);
+  default:
+    ASSERT_MSG(false, "Unknown column encoding");
+    return 0;
+  }
+}
+
+// Writes the payload for plan->encoding to 'out', which is zeroed. Returns
+// its size.
+static usize column_write_payload(ColumnType type, const ColumnBuffer *buffer,
+                                  u32 row_count, const ColumnPlan *plan,
+                                  u8 *out) {
+  u32 *counts = (u32 *)out;
+  switch (plan->encoding) {
+  case COLUMN_ENCODING_PLAIN:
+    return column_write_values(type, buffer, NULL, row_count, out);
+  case COLUMN_ENCODING_DICTIONARY: {
+    u32 width = column_bit_width(
+        plan->dictionary_count > 0 ? plan->dictionary_count - 1 : 0);
+    counts[0] = plan->dictionary_count;
+    counts[1] = width;
+    usize size = 2 * sizeof(u32);
+    size += column_write_values(type, buffer, plan->dictionary,
+                                plan->dictionary_count, out + size);
+    for (u32 row = 0; row < row_count; ++row) {
+      column_pack(out + size, row, width, plan->codes[row]);
+    }
+    return size + column_packed_size(row_count, width);
+  }
+  case COLUMN_ENCODING_RLE: {
+    // The value of every run in PLAIN layout, then the run lengths.
+    counts[0] = plan->run_count;
+    u8 *values = out + 2 * sizeof(u32);
+    u32 *offsets = (u32 *)values;
+    char *bytes = (char *)values + ALIGN_UP(((usize)plan->run_count + 1) *
+                                                sizeof(u32),
+                                            COLUMN_SECTION_ALIGNMENT);
+    u32 *lengths = (u32 *)(values + column_values_size(type, plan->run_count,
+                                                       plan->run_bytes));
+    u32 runs = 0;
+    u32 offset = 0;
+    for (u32 row = 0; row < row_count; ++row) {
+      if (row > 0 && column_rows_equal(type, buffer, row - 1, row)) {
+        lengths[runs - 1]++;
+        continue;
+      }
+      if (type != COLUMN_TYPE_STRING) {
+        ((u64 *)values)[runs] = column_row_bits(buffer, row);
+      } else {
+        StringView value = column_row_string(buffer, row);
+        if (value.length > 0) {
+          memcpy(bytes + offset, value.data, value.length);
+        }
+        offsets[runs] = offset;
+        offset += (u32)value.length;
+        offsets[runs + 1] = offset;
+      }
+      lengths[runs++] = 1;
+    }
+    ASSERT(runs == plan->run_count);
+    return column_payload_size(type, buffer, row_count, plan,
+                               COLUMN_ENCODING_RLE);
+  }
+  case COLUMN_ENCODING_FOR: {
+    const i64 *values = (const i64 *)buffer->values;
+    memcpy(out, &plan->base, sizeof(i64));
+    counts[2] = plan->for_width;
+    u8 *packed = out + 2 * sizeof(i64);
+    for (u32 row = 0; row < row_count; ++row) {
+      column_pack(packed, row, plan->for_width,
+                  (u64)values[row] - (u64)plan->base);
+    }
+    return 2 * sizeof(i64) + column_packed_size(row_count, plan->for_width);
+  }
+  default:
+    ASSERT_MSG(false, "Unknown column encoding");
+    return 0;
+  }
+}
+
+// Writes the values of 'rows' (all rows if NULL) in PLAIN layout.
+static usize column_write_values(ColumnType type, const ColumnBuffer *buffer,
+                                 const u32 *rows, u32 count, u8 *out) {
+  if (type != COLUMN_TYPE_STRING) {
+    if (!rows) {
+      memcpy(out, buffer->values, count * sizeof(u64));
+    } else {
+      u64 *values = (u64 *)out;
+      for (u32 i = 0; i < count; ++i) {
+        values[i] = column_row_bits(buffer, rows[i]);
+      }
+    }
+    return count * sizeof(u64);
+  }
+
+  u32 *offsets = (u32 *)out;
+  usize string_bytes = 0;
+  for (u32 i = 0; i < count; ++i) {
+    string_bytes += column_row_string(buffer, rows ? rows[i] : i).length;
+  }
+  char *bytes = (char *)out + ALIGN_UP((count + 1) * sizeof(u32),
+                                       COLUMN_SECTION_ALIGNMENT);
+  u32 offset = 0;
+  offsets[0] = 0;
+  for (u32 i = 0; i < count; ++i) {
+    StringView value = column_row_string(buffer, rows ? rows[i] : i);
+    if (value.length > 0) {
+      memcpy(bytes + offset, value.data, value.length);
+    }
+    offset += (u32)value.length;
+    offsets[i + 1] = offset;
+  }
+  return column_values_size(type, count, string_bytes);
+}
+
+static usize column_values_size(ColumnType type, u32 count,
+                                usize string_bytes) {
+  if (type != COLUMN_TYPE_STRING) {
+    return (usize)count * sizeof(u64);
+  }
+  return ALIGN_UP(((usize)count + 1) * sizeof(u32),
+                  COLUMN_SECTION_ALIGNMENT) +
+         ALIGN_UP(string_bytes, COLUMN_SECTION_ALIGNMENT);
+}
+
+// Packed bits plus one spare word, so the last value can be loaded with a
+// full 8-byte read.
+static usize column_packed_size(u32 count, u32 bit_width) {
+  return ALIGN_UP(((usize)count * bit_width + 7) / 8,
+                  COLUMN_SECTION_ALIGNMENT) +
+         sizeof(u64);
+}
+
+static void column_pack(u8 *packed, u32 index, u32 bit_width, u64 value) {
+  if (bit_width == 0) {
+    return;
+  }
+  u64 bit = (u64)index * bit_width;
+  u64 word;
+  memcpy(&word, packed + bit / 8, sizeof(word));
+  word |= value << (bit % 8);
+  memcpy(packed + bit / 8, &word, sizeof(word));
+}
+
+static u64 column_unpack(const u8 *packed, u32 index, u32 bit_width) {
+  u64 bit = (u64)index * bit_width;
+  u64 word;
+  memcpy(&word, packed + bit / 8, sizeof(word));
+  return (word >> (bit % 8)) & ((1ULL << bit_width) - 1);
+}
+
+static u32 column_bit_width(u64 max_value) {
+  return max_value == 0 ? 0 : 64u - (u32)__builtin_clzll(max_value);
+}
+
+// --- Row access ---
+
+static bool column_rows_equal(ColumnType type, const ColumnBuffer *buffer,
+                              u32 a, u32 b) {
+  if (type != COLUMN_TYPE_STRING) {
+    return column_row_bits(buffer, a) == column_row_bits(buffer, b);
+  }
+  return sv_equals(column_row_string(buffer, a), column_row_string(buffer, b));
+}
+
+static u64 column_row_hash(ColumnType type, const ColumnBuffer *buffer,
+                           u32 row) {
+  if (type == COLUMN_TYPE_STRING) {
+    StringView value = column_row_string(buffer, row);
+    return base_hash_bytes(value.data, value.length);
+  }
+  // Numbers are compared bit for bit, so hash their bits.
+  return base_mix_u64(column_row_bits(buffer, row));
+}
+
+static u64 column_row_bits(const ColumnBuffer *buffer, u32 row) {
+  return ((const u64 *)buffer->values)[row];
+}
+
+static StringView column_row_string(const ColumnBuffer *buffer, u32 row) {
+  const u32 *offsets = (const u32 *)buffer->values;
+  return sv_from_parts(buffer->bytes + offsets[row],
+                       offsets[row + 1] - offsets[row]);
+}
+
+// String 'index' of a PLAIN values section holding 'value_count' strings.
+static StringView column_value_string(const u8 *values, u32 value_count,
+                                      u32 index) {
+  const u32 *offsets = (const u32 *)values;
+  const char *bytes =
+      (const char *)values +
+      ALIGN_UP(((usize)value_count + 1) * sizeof(u32),
+               COLUMN_SECTION_ALIGNMENT);
+  return sv_from_parts(bytes + offsets[index],
+                       offsets[index + 1] - offsets[index]);
+}
+
+static void column_zone_string(ColumnZoneString *out, StringView value) {
+  out->length = (u8)MIN(value.length, (usize)COLUMN_ZONE_STRING_BYTES);
+  if (out->length > 0) {
+    memcpy(out->bytes, value.data, out->length);
+  }
+}
+
+static bool column_is_null(const u8 *bitmap, usize row) {
+  return (bitmap[row / 8] >> (row % 8)) & 1;
+}
@@ -0,0 +1,404 @@
+#include "sqldb/eviction.h"
+
+#include <inttypes.h>
+
+// =================================================================================================
+// :: Private Types ::
+// =================================================================================================
+
+#define EVICTION_NIL ((u32)UINT32_MAX)
+
+typedef struct {
+  u8 *ref_bits;    // Second-chance bit per frame
+  u8 *is_tracked;  // Whether the frame currently holds a page
+  usize hand;      // Next frame examined by the sweep
+  usize frame_count;
+} ClockState;
+
+typedef enum {
+  TWO_Q_NONE = 0, // Frame is not tracked
+  TWO_Q_A1IN = 1, // FIFO of pages referenced once since they were loaded
+  TWO_Q_AM = 2,   // LRU of pages re-referenced after leaving A1in
+} TwoQQueue;
+
+typedef struct {
+  u64 page_id;
+  u32 prev; // Towards the head (newer) of the queue
+  u32 next; // Towards the tail (older) of the queue
+  u8 queue;
+  u8 victim_of; // Queue pick_victim last took the frame from
+} TwoQFrame;
+
+typedef struct {
+  u32 head;
+  u32 tail;
+  usize size;
+} TwoQList;
+
+typedef struct {
+  TwoQFrame *frames;
+  usize frame_count;
+  TwoQList a1in;
+  TwoQList am;
+  usize a1in_target; // Kin: A1in is drained first once it grows past this
+
+  // A1out: ring of page ids recently evicted from A1in, with no data. A miss
+  // on a page found here means it was re-referenced after a full A1in pass,
+  // so it goes straight to Am. Pages touched once by a scan never do.
+  u64 *ghosts;
+  usize ghost_capacity; // Kout
+  usize ghost_head;     // Oldest ghost
+  usize ghost_count;
+  BaseHashTableOA ghost_set; // &ghosts[i] -> &ghosts[i]
+} TwoQState;
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static void clock_on_insert(void *state, usize frame_idx, u64 page_id);
+static void clock_on_access(void *state, usize frame_idx);
+static bool clock_pick_victim(void *state, EvictionCanEvictFunction can_evict,
+                              void *ctx, usize *out_frame_idx);
+static void clock_on_reinstate(void *state, usize frame_idx);
+static void clock_destroy(void *state);
+
+static void two_q_on_insert(void *state, usize frame_idx, u64 page_id);
+static void two_q_on_access(void *state, usize frame_idx);
+static bool two_q_pick_victim(void *state, EvictionCanEvictFunction can_evict,
+                              void *ctx, usize *out_frame_idx);
+static void two_q_on_reinstate(void *state, usize frame_idx);
+static void two_q_destroy(void *state);
+
+static const EvictionPolicyOps clock_ops = {
+    .name = "clock",
+    .on_insert = clock_on_insert,
+    .on_access = clock_on_access,
+    .pick_victim = clock_pick_victim,
+    .on_reinstate = clock_on_reinstate,
+    .destroy = clock_destroy,
+};
+
+static const EvictionPolicyOps two_q_ops = {
+    .name = "2q",
+    .on_insert = two_q_on_insert,
+    .on_access = two_q_on_access,
+    .pick_victim = two_q_pick_victim,
+    .on_reinstate = two_q_on_reinstate,
+    .destroy = two_q_destroy,
+};
+
+static usize two_q_ghost_capacity(usize frame_count);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+usize eviction_policy_required_arena_size(EvictionPolicyKind kind,
+                                          usize frame_count) {
+  usize slack = 4 * BASE_ARENA_DEFAULT_ALIGNMENT;
+  switch (kind) {
+  case EVICTION_POLICY_CLOCK:
+    return sizeof(ClockState) + 2 * frame_count + slack;
+  case EVICTION_POLICY_2Q:
+    return sizeof(TwoQState) + frame_count * sizeof(TwoQFrame) +
+           two_q_ghost_capacity(frame_count) * sizeof(u64) + slack;
+  }
+  return slack;
+}
+
+bool eviction_policy_init(EvictionPolicy *policy, EvictionPolicyKind kind,
+                          usize frame_count, Arena *arena) {
+  ASSERT(policy && arena);
+  ASSERT(frame_count > 0 && frame_count < EVICTION_NIL);
+  ZERO_STRUCT(*policy);
+  policy->kind = kind;
+
+  switch (kind) {
+  case EVICTION_POLICY_CLOCK: {
+    ClockState *clock = (ClockState *)arena_alloc(arena, sizeof(ClockState));
+    u8 *bits = (u8 *)arena_alloc(arena, 2 * frame_count);
+    if (!clock || !bits) {
+      break;
+    }
+    memset(bits, 0, 2 * frame_count);
+    *clock = (ClockState){
+        .ref_bits = bits,
+        .is_tracked = bits + frame_count,
+        .frame_count = frame_count,
+    };
+    policy->ops = &clock_ops;
+    policy->state = clock;
+    return true;
+  }
+  case EVICTION_POLICY_2Q: {
+    usize ghost_capacity = two_q_ghost_capacity(frame_count);
+    TwoQState *two_q = (TwoQState *)arena_alloc(arena, sizeof(TwoQState));
+    TwoQFrame *frames =
+        (TwoQFrame *)arena_alloc(arena, frame_count * sizeof(TwoQFrame));
+    u64 *ghosts = (u64 *)arena_alloc(arena, ghost_capacity * sizeof(u64));
+    if (!two_q || !frames || !ghosts) {
+      break;
+    }
+    for (usize i = 0; i < frame_count; ++i) {
+      frames[i] = (TwoQFrame){.prev = EVICTION_NIL, .next = EVICTION_NIL};
+    }
+    *two_q = (TwoQState){
+        .frames = frames,
+        .frame_count = frame_count,
+        .a1in = {.head = EVICTION_NIL, .tail = EVICTION_NIL},
+        .am = {.head = EVICTION_NIL, .tail = EVICTION_NIL},
+        .a1in_target = MAX(frame_count / 4, (usize)1),
+        .ghosts = ghosts,
+        .ghost_capacity = ghost_capacity,
+    };
+    // Ghost entries churn constantly, so keep the set off the arena.
+    two_q->ghost_set = ht_oa_init(ghost_capacity * 2, base_hash_u64,
+                                  base_key_equal_u64, NULL);
+    if (!two_q->ghost_set.entries) {
+      break;
+    }
+    policy->ops = &two_q_ops;
+    policy->state = two_q;
+    return true;
+  }
+  }
+
+  LOG_ERROR("Failed to allocate %s eviction state for %zu frames",
+            eviction_policy_name(kind), frame_count);
+  return false;
+}
+
+void eviction_policy_free(EvictionPolicy *policy) {
+  ASSERT(policy);
+  if (policy->ops && policy->ops->destroy) {
+    policy->ops->destroy(policy->state);
+  }
+  policy->ops = NULL;
+  policy->state = NULL;
+}
+
+const char *eviction_policy_name(EvictionPolicyKind kind) {
+  switch (kind) {
+  case EVICTION_POLICY_CLOCK:
+    return clock_ops.name;
+  case EVICTION_POLICY_2Q:
+    return two_q_ops.name;
+  }
+  return "unknown";
+}
+
+bool eviction_policy_from_name(const char *name, EvictionPolicyKind *out_kind) {
+  ASSERT(name && out_kind);
+  if (strcmp(name, clock_ops.name) == 0) {
+    *out_kind = EVICTION_POLICY_CLOCK;
+    return true;
+  }
+  if (strcmp(name, two_q_ops.name) == 0) {
+    *out_kind = EVICTION_POLICY_2Q;
+    return true;
+  }
+  return false;
+}
+
+// =================================================================================================
+// :: CLOCK ::
+// =================================================================================================
+
+static void clock_on_insert(void *state, usize frame_idx, u64 page_id) {
+  (void)page_id;
+  ClockState *clock = (ClockState *)state;
+  ASSERT(frame_idx < clock->frame_count);
+  clock->is_tracked[frame_idx] = 1;
+  clock->ref_bits[frame_idx] = 1;
+}
+
+static void clock_on_access(void *state, usize frame_idx) {
+  ClockState *clock = (ClockState *)state;
+  ASSERT(frame_idx < clock->frame_count);
+  clock->ref_bits[frame_idx] = 1;
+}
+
+static bool clock_pick_victim(void *state, EvictionCanEvictFunction can_evict,
+                              void *ctx, usize *out_frame_idx) {
+  ClockState *clock = (ClockState *)state;
+
+  // One full sweep clears every reference bit, so the second one finds a
+  // victim unless every tracked frame is rejected by can_evict.
+  for (usize step = 0; step < 2 * clock->frame_count + 1; ++step) {
+    usize idx = clock->hand;
+    clock->hand = (clock->hand + 1) % clock->frame_count;
+
+    if (!clock->is_tracked[idx] || !can_evict(idx, ctx)) {
+      continue;
+    }
+    if (clock->ref_bits[idx]) {
+      clock->ref_bits[idx] = 0;
+      continue;
+    }
+    clock->is_tracked[idx] = 0;
+    *out_frame_idx = idx;
+    return true;
+  }
+  return false;
+}
+
+// The hand has already moved past the frame, so it is examined last.
+static void clock_on_reinstate(void *state, usize frame_idx) {
+  ClockState *clock = (ClockState *)state;
+  ASSERT(frame_idx < clock->frame_count && !clock->is_tracked[frame_idx]);
+  clock->is_tracked[frame_idx] = 1;
+  clock->ref_bits[frame_idx] = 1;
+}
+
+static void clock_destroy(void *state) {
+  (void)state; // All state lives in the arena
+}
+
+// =================================================================================================
+// :: 2Q ::
+// =================================================================================================
+
+static usize two_q_ghost_capacity(usize frame_count) {
+  return MAX(frame_count / 2, (usize)1);
+}
+
+static TwoQList *two_q_list(TwoQState *two_q, u8 queue) {
+  return queue == TWO_Q_A1IN ? &two_q->a1in : &two_q->am;
+}
+
+static void two_q_push_head(TwoQState *two_q, u32 idx, u8 queue) {
+  TwoQList *list = two_q_list(two_q, queue);
+  TwoQFrame *frame = &two_q->frames[idx];
+  frame->queue = queue;
+  frame->prev = EVICTION_NIL;
+  frame->next = list->head;
+  if (list->head != EVICTION_NIL) {
+    two_q->frames[list->head].prev = idx;
+  } else {
+    list->tail = idx;
+  }
+  list->head = idx;
+  list->size++;
+}
+
+static void two_q_unlink(TwoQState *two_q, u32 idx) {
+  TwoQFrame *frame = &two_q->frames[idx];
+  TwoQList *list = two_q_list(two_q, frame->queue);
+  if (frame->prev != EVICTION_NIL) {
+    two_q->frames[frame->prev].next = frame->next;
+  } else {
+    list->head = frame->next;
+  }
+  if (frame->next != EVICTION_NIL) {
+    two_q->frames[frame->next].prev = frame->prev;
+  } else {
+    list->tail = frame->prev;
+  }
+  frame->prev = frame->next = EVICTION_NIL;
+  frame->queue = TWO_Q_NONE;
+  list->size--;
+}
+
+static void two_q_ghost_push(TwoQState *two_q, u64 page_id) {
+  if (two_q->ghost_count == two_q->ghost_capacity) {
+    // Forget the oldest ghost. Its slot may be stale if the page was already
+    // promoted and re-ghosted elsewhere, so only drop the set entry it owns.
+    u64 *oldest = &two_q->ghosts[two_q->ghost_head];
+    if (ht_oa_get(&two_q->ghost_set, oldest) == oldest) {
+      ht_oa_remove(&two_q->ghost_set, oldest);
+    }
+    two_q->ghost_head = (two_q->ghost_head + 1) % two_q->ghost_capacity;
+    two_q->ghost_count--;
+  }
+
+  usize slot = (two_q->ghost_head + two_q->ghost_count) % two_q->ghost_capacity;
+  two_q->ghosts[slot] = page_id;
+  two_q->ghost_count++;
+  u64 *ghost = &two_q->ghosts[slot];
+  if (!ht_oa_put(&two_q->ghost_set, ghost, ghost)) {
+    LOG_WARN("2Q: failed to remember evicted page %" PRIu64, page_id);
+  }
+}
+
+static bool two_q_ghost_take(TwoQState *two_q, u64 page_id) {
+  return ht_oa_remove(&two_q->ghost_set, &page_id);
+}
+
+static void two_q_on_insert(void *state, usize frame_idx, u64 page_id) {
+  TwoQState *two_q = (TwoQState *)state;
+  ASSERT(frame_idx < two_q->frame_count);
+  ASSERT(two_q->frames[frame_idx].queue == TWO_Q_NONE);
+  two_q->frames[frame_idx].page_id = page_id;
+  u8 queue = two_q_ghost_take(two_q, page_id) ? TWO_Q_AM : TWO_Q_A1IN;
+  two_q_push_head(two_q, (u32)frame_idx, queue);
+}
+
+static void two_q_on_access(void *state, usize frame_idx) {
+  TwoQState *two_q = (TwoQState *)state;
+  ASSERT(frame_idx < two_q->frame_count);
+  // Hits in A1in are treated as correlated with the first reference and do
+  // not promote the page; only Am is kept in LRU order.
+  if (two_q->frames[frame_idx].queue == TWO_Q_AM) {
+    two_q_unlink(two_q, (u32)frame_idx);
+    two_q_push_head(two_q, (u32)frame_idx, TWO_Q_AM);
+  }
+}
+
+// Walks a queue from its tail (oldest) and detaches the first evictable frame.
+static bool two_q_take_tail(TwoQState *two_q, TwoQList *list,
+                            EvictionCanEvictFunction can_evict, void *ctx,
+                            usize *out_frame_idx) {
+  for (u32 idx = list->tail; idx != EVICTION_NIL;
+       idx = two_q->frames[idx].prev) {
+    if (can_evict(idx, ctx)) {
+      two_q->frames[idx].victim_of = two_q->frames[idx].queue;
+      two_q_unlink(two_q, idx);
+      *out_frame_idx = idx;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool two_q_pick_victim(void *state, EvictionCanEvictFunction can_evict,
+                              void *ctx, usize *out_frame_idx) {
+  TwoQState *two_q = (TwoQState *)state;
+
+  bool prefer_a1in = two_q->a1in.size > two_q->a1in_target ||
+                     two_q->am.size == 0;
+  if (prefer_a1in &&
+      two_q_take_tail(two_q, &two_q->a1in, can_evict, ctx, out_frame_idx)) {
+    two_q_ghost_push(two_q, two_q->frames[*out_frame_idx].page_id);
+    return true;
+  }
+  if (two_q_take_tail(two_q, &two_q->am, can_evict, ctx, out_frame_idx)) {
+    return true;
+  }
+  // Everything in Am is pinned; fall back to A1in even below its target.
+  if (!prefer_a1in &&
+      two_q_take_tail(two_q, &two_q->a1in, can_evict, ctx, out_frame_idx)) {
+    two_q_ghost_push(two_q, two_q->frames[*out_frame_idx].page_id);
+    return true;
+  }
+  return false;
+}
+
+// Back to the head of the queue it was taken from. An A1in victim was also
+// remembered as a ghost; dropping that keeps its next load from counting as
+// a re-reference and promoting it into Am.
+static void two_q_on_reinstate(void *state, usize frame_idx) {
+  TwoQState *two_q = (TwoQState *)state;
+  ASSERT(frame_idx < two_q->frame_count);
+  TwoQFrame *frame = &two_q->frames[frame_idx];
+  ASSERT(frame->queue == TWO_Q_NONE && frame->victim_of != TWO_Q_NONE);
+  if (frame->victim_of == TWO_Q_A1IN) {
+    two_q_ghost_take(two_q, frame->page_id);
+  }
+  two_q_push_head(two_q, (u32)frame_idx, frame->victim_of);
+}
+
+static void two_q_destroy(void *state) {
+  TwoQState *two_q = (TwoQState *)state;
+  ht_oa_free(&two_q->ghost_set); // The rest lives in the arena
+}
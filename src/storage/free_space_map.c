@@ -0,0 +1,152 @@
+#include "sqldb/free_space_map.h"
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool fsm_reserve(FreeSpaceMap *fsm, PageId page_id);
+static void fsm_link(FreeSpaceMap *fsm, PageId page_id, u8 category);
+static void fsm_unlink(FreeSpaceMap *fsm, PageId page_id);
+
+#define FSM_INITIAL_CAPACITY 64
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void fsm_init(FreeSpaceMap *fsm, u32 page_size) {
+  ASSERT(fsm && page_size >= 256);
+  ZERO_STRUCT(*fsm);
+  fsm->page_size = page_size;
+  fsm->category_bytes = page_size / 256;
+  for (usize i = 0; i < FSM_CATEGORY_COUNT; ++i) {
+    fsm->heads[i] = INVALID_PAGE_ID;
+  }
+}
+
+void fsm_free(FreeSpaceMap *fsm) {
+  ASSERT(fsm);
+  free(fsm->categories);
+  free(fsm->prev);
+  free(fsm->next);
+  fsm->categories = NULL;
+  fsm->prev = NULL;
+  fsm->next = NULL;
+  fsm->capacity = 0;
+  fsm->page_count = 0;
+}
+
+bool fsm_update(FreeSpaceMap *fsm, PageId page_id, u32 free_bytes) {
+  ASSERT(fsm && page_id != INVALID_PAGE_ID);
+  if (!fsm_reserve(fsm, page_id)) {
+    return false;
+  }
+  // Round down: a page in category c always has c * category_bytes free.
+  u8 category =
+      (u8)MIN(free_bytes / fsm->category_bytes, FSM_CATEGORY_COUNT - 1u);
+  u8 current = fsm->categories[page_id];
+  if (current == category) {
+    return true;
+  }
+  if (current == FSM_UNTRACKED) {
+    fsm->page_count++;
+  } else {
+    fsm_unlink(fsm, page_id);
+  }
+  fsm_link(fsm, page_id, category);
+  return true;
+}
+
+void fsm_remove(FreeSpaceMap *fsm, PageId page_id) {
+  ASSERT(fsm);
+  if (page_id >= fsm->capacity || fsm->categories[page_id] == FSM_UNTRACKED) {
+    return;
+  }
+  fsm_unlink(fsm, page_id);
+  fsm->categories[page_id] = FSM_UNTRACKED;
+  fsm->page_count--;
+}
+
+PageId fsm_find(const FreeSpaceMap *fsm, u32 needed) {
+  ASSERT(fsm);
+  // Round up so that any page in the category is guaranteed to fit.
+  u32 category = (needed + fsm->category_bytes - 1) / fsm->category_bytes;
+  if (category >= FSM_CATEGORY_COUNT) {
+    return INVALID_PAGE_ID;
+  }
+  for (u32 word = category / 64; word < FSM_BITMAP_WORDS; ++word) {
+    u64 bits = fsm->non_empty[word];
+    if (word == category / 64) {
+      bits &= ~0ULL << (category % 64);
+    }
+    if (bits != 0) {
+      u32 found = word * 64 + (u32)__builtin_ctzll(bits);
+      return fsm->heads[found];
+    }
+  }
+  return INVALID_PAGE_ID;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool fsm_reserve(FreeSpaceMap *fsm, PageId page_id) {
+  if (page_id < fsm->capacity) {
+    return true;
+  }
+  usize capacity = MAX(fsm->capacity, (usize)FSM_INITIAL_CAPACITY);
+  while (capacity <= page_id) {
+    capacity *= 2;
+  }
+  u8 *categories = (u8 *)realloc(fsm->categories, capacity);
+  if (categories) {
+    fsm->categories = categories;
+  }
+  PageId *prev = (PageId *)realloc(fsm->prev, capacity * sizeof(PageId));
+  if (prev) {
+    fsm->prev = prev;
+  }
+  PageId *next = (PageId *)realloc(fsm->next, capacity * sizeof(PageId));
+  if (next) {
+    fsm->next = next;
+  }
+  if (!categories || !prev || !next) {
+    LOG_ERROR("Failed to grow the free space map to %zu pages", capacity);
+    return false;
+  }
+  memset(fsm->categories + fsm->capacity, FSM_UNTRACKED,
+         capacity - fsm->capacity);
+  fsm->capacity = capacity;
+  return true;
+}
+
+// Pushes the page at the head of its category's list.
+static void fsm_link(FreeSpaceMap *fsm, PageId page_id, u8 category) {
+  PageId head = fsm->heads[category];
+  fsm->categories[page_id] = category;
+  fsm->prev[page_id] = INVALID_PAGE_ID;
+  fsm->next[page_id] = head;
+  if (head != INVALID_PAGE_ID) {
+    fsm->prev[head] = page_id;
+  }
+  fsm->heads[category] = page_id;
+  fsm->non_empty[category / 64] |= 1ULL << (category % 64);
+}
+
+static void fsm_unlink(FreeSpaceMap *fsm, PageId page_id) {
+  u8 category = fsm->categories[page_id];
+  PageId prev = fsm->prev[page_id];
+  PageId next = fsm->next[page_id];
+  if (prev != INVALID_PAGE_ID) {
+    fsm->next[prev] = next;
+  } else {
+    fsm->heads[category] = next;
+  }
+  if (next != INVALID_PAGE_ID) {
+    fsm->prev[next] = prev;
+  }
+  if (fsm->heads[category] == INVALID_PAGE_ID) {
+    fsm->non_empty[category / 64] &= ~(1ULL << (category % 64));
+  }
+}
@@ -0,0 +1,140 @@
+#include "sqldb/heap_file.h"
+
+#include <inttypes.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static BufferFrame *heap_file_page_with_room(HeapFile *heap, u32 length);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void heap_file_init(HeapFile *heap, BufferPool *bp) {
+  ASSERT(heap && bp);
+  ASSERT(bp->page_size >= HEAP_PAGE_MIN_SIZE &&
+         bp->page_size <= HEAP_PAGE_MAX_SIZE);
+  ZERO_STRUCT(*heap);
+  heap->bp = bp;
+  fsm_init(&heap->fsm, bp->page_size);
+}
+
+void heap_file_free(HeapFile *heap) {
+  ASSERT(heap);
+  fsm_free(&heap->fsm);
+}
+
+bool heap_file_add_page(HeapFile *heap, PageId page_id) {
+  ASSERT(heap);
+  BufferFrame *frame = bp_fetch_page(heap->bp, page_id);
+  if (!frame) {
+    return false;
+  }
+  bool ok = heap_page_is_valid(frame->data, heap->bp->page_size);
+  if (ok) {
+    for (u16 slot = 0; slot < heap_page_slot_count(frame->data); ++slot) {
+      u32 length;
+      if (heap_page_get(frame->data, slot, &length)) {
+        heap->tuple_count++;
+        heap->tuple_bytes += length;
+      }
+    }
+    ok = fsm_update(&heap->fsm, page_id, heap_page_free_space(frame->data));
+  } else {
+    LOG_ERROR("Page %" PRIu64 " is not a heap page", page_id);
+  }
+  bp_unpin_page(heap->bp, frame, false);
+  return ok;
+}
+
+bool heap_insert(HeapFile *heap, const u8 *data, u32 length,
+                 RecordId *out_rid) {
+  ASSERT(heap && data && out_rid);
+  if (length == 0 || length > heap_page_max_tuple_size(heap->bp->page_size)) {
+    LOG_ERROR("Tuple of %u bytes does not fit in a %u-byte page", length,
+              heap->bp->page_size);
+    return false;
+  }
+
+  BufferFrame *frame = heap_file_page_with_room(heap, length);
+  if (!frame) {
+    return false;
+  }
+  u16 slot;
+  bool ok = heap_page_insert(frame->data, data, length, &slot);
+  // The map only promises a lower bound, so a miss here is a bug.
+  ASSERT_MSG(ok, "Free space map sent a %u-byte tuple to a full page",
+             length);
+  if (ok) {
+    fsm_update(&heap->fsm, frame->page_id, heap_page_free_space(frame->data));
+    *out_rid = (RecordId){.page_id = frame->page_id, .slot = slot};
+    heap->tuple_count++;
+    heap->tuple_bytes += length;
+    heap->stats.inserts++;
+  }
+  bp_unpin_page(heap->bp, frame, ok);
+  return ok;
+}
+
+const u8 *heap_fetch(HeapFile *heap, RecordId rid, u32 *out_length,
+                     BufferFrame **out_frame) {
+  ASSERT(heap && out_length && out_frame);
+  BufferFrame *frame = bp_fetch_page(heap->bp, rid.page_id);
+  if (!frame) {
+    return NULL;
+  }
+  const u8 *tuple = heap_page_get(frame->data, rid.slot, out_length);
+  if (!tuple) {
+    bp_unpin_page(heap->bp, frame, false);
+    return NULL;
+  }
+  *out_frame = frame;
+  return tuple;
+}
+
+bool heap_delete(HeapFile *heap, RecordId rid) {
+  ASSERT(heap);
+  BufferFrame *frame = bp_fetch_page(heap->bp, rid.page_id);
+  if (!frame) {
+    return false;
+  }
+  u32 length = 0;
+  bool ok = heap_page_get(frame->data, rid.slot, &length) != NULL &&
+            heap_page_delete(frame->data, rid.slot);
+  if (ok) {
+    fsm_update(&heap->fsm, rid.page_id, heap_page_free_space(frame->data));
+    heap->tuple_count--;
+    heap->tuple_bytes -= length;
+    heap->stats.deletes++;
+  }
+  bp_unpin_page(heap->bp, frame, ok);
+  return ok;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// Returns a pinned heap page that can take a 'length'-byte tuple: one found
+// through the free space map, or a freshly appended page.
+static BufferFrame *heap_file_page_with_room(HeapFile *heap, u32 length) {
+  PageId page_id = fsm_find(&heap->fsm, length);
+  if (page_id != INVALID_PAGE_ID) {
+    return bp_fetch_page(heap->bp, page_id);
+  }
+
+  heap->stats.fsm_misses++;
+  BufferFrame *frame = bp_new_page(heap->bp, &page_id);
+  if (!frame) {
+    return NULL;
+  }
+  heap_page_init(frame->data, heap->bp->page_size);
+  if (!fsm_update(&heap->fsm, page_id, heap_page_free_space(frame->data))) {
+    bp_unpin_page(heap->bp, frame, true);
+    return NULL;
+  }
+  heap->stats.pages_allocated++;
+  return frame;
+}
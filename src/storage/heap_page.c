@@ -0,0 +1,211 @@
+#include "sqldb/heap_page.h"
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static HeapPageHeader *heap_page_header(u8 *page);
+static HeapSlot *heap_page_slots(u8 *page);
+static bool heap_page_reserve(u8 *page, u32 length, bool needs_slot);
+static void heap_page_trim_slots(u8 *page);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void heap_page_init(u8 *page, u32 page_size) {
+  ASSERT(page);
+  ASSERT(page_size >= HEAP_PAGE_MIN_SIZE && page_size <= HEAP_PAGE_MAX_SIZE);
+  HeapPageHeader *header = heap_page_header(page);
+  *header = (HeapPageHeader){
+      .free_start = sizeof(HeapPageHeader),
+      .free_end = page_size,
+      .page_size = page_size,
+      .magic = HEAP_PAGE_MAGIC,
+  };
+}
+
+bool heap_page_is_valid(const u8 *page, u32 page_size) {
+  ASSERT(page);
+  const HeapPageHeader *header = (const HeapPageHeader *)page;
+  return header->magic == HEAP_PAGE_MAGIC && header->page_size == page_size &&
+         header->free_start == sizeof(HeapPageHeader) +
+                                   header->slot_count * sizeof(HeapSlot) &&
+         header->free_start <= header->free_end &&
+         header->free_end <= page_size;
+}
+
+u32 heap_page_max_tuple_size(u32 page_size) {
+  return page_size - (u32)(sizeof(HeapPageHeader) + sizeof(HeapSlot));
+}
+
+u32 heap_page_free_space(const u8 *page) {
+  ASSERT(page);
+  const HeapPageHeader *header = (const HeapPageHeader *)page;
+  u32 available = header->free_end - header->free_start + header->dead_bytes;
+  bool has_free_slot = header->live_count < header->slot_count;
+  u32 slot_cost = has_free_slot ? 0 : (u32)sizeof(HeapSlot);
+  return available > slot_cost ? available - slot_cost : 0;
+}
+
+bool heap_page_insert(u8 *page, const u8 *data, u32 length, u16 *out_slot) {
+  ASSERT(page && data && out_slot && length > 0);
+  HeapPageHeader *header = heap_page_header(page);
+  if (length > heap_page_free_space(page)) {
+    return false;
+  }
+
+  // Reuse the lowest free slot so the directory stays dense.
+  HeapSlot *slots = heap_page_slots(page);
+  u16 slot = header->slot_count;
+  if (header->live_count < header->slot_count) {
+    for (u16 i = 0; i < header->slot_count; ++i) {
+      if (slots[i].offset == 0) {
+        slot = i;
+        break;
+      }
+    }
+  }
+  if (!heap_page_reserve(page, length, slot == header->slot_count)) {
+    return false;
+  }
+
+  if (slot == header->slot_count) {
+    header->slot_count++;
+    header->free_start += (u32)sizeof(HeapSlot);
+  }
+  header->free_end -= length;
+  memcpy(page + header->free_end, data, length);
+  slots[slot] = (HeapSlot){.offset = (u16)header->free_end,
+                           .length = (u16)length};
+  header->live_count++;
+  *out_slot = slot;
+  return true;
+}
+
+const u8 *heap_page_get(const u8 *page, u16 slot, u32 *out_length) {
+  ASSERT(page && out_length);
+  const HeapPageHeader *header = (const HeapPageHeader *)page;
+  if (slot >= header->slot_count) {
+    return NULL;
+  }
+  const HeapSlot *entry = (const HeapSlot *)(header + 1) + slot;
+  if (entry->offset == 0) {
+    return NULL;
+  }
+  *out_length = entry->length;
+  return page + entry->offset;
+}
+
+bool heap_page_delete(u8 *page, u16 slot) {
+  ASSERT(page);
+  HeapPageHeader *header = heap_page_header(page);
+  HeapSlot *slots = heap_page_slots(page);
+  if (slot >= header->slot_count || slots[slot].offset == 0) {
+    return false;
+  }
+  header->dead_bytes += slots[slot].length;
+  slots[slot] = (HeapSlot){0};
+  header->live_count--;
+  heap_page_trim_slots(page);
+  return true;
+}
+
+bool heap_page_update(u8 *page, u16 slot, const u8 *data, u32 length) {
+  ASSERT(page && data && length > 0);
+  HeapPageHeader *header = heap_page_header(page);
+  HeapSlot *slots = heap_page_slots(page);
+  if (slot >= header->slot_count || slots[slot].offset == 0) {
+    return false;
+  }
+
+  HeapSlot old = slots[slot];
+  if (length <= old.length) {
+    // Shrink in place; the tail becomes dead space.
+    memcpy(page + old.offset, data, length);
+    slots[slot].length = (u16)length;
+    header->dead_bytes += old.length - length;
+    return true;
+  }
+
+  u32 contiguous = header->free_end - header->free_start;
+  if (length > contiguous + header->dead_bytes + old.length) {
+    return false;
+  }
+  // Free the old version first so compaction can reclaim its bytes. Slot
+  // offset 0 keeps heap_page_compact from moving it.
+  slots[slot] = (HeapSlot){0};
+  header->dead_bytes += old.length;
+  if (length > contiguous) {
+    heap_page_compact(page);
+  }
+  header->free_end -= length;
+  memcpy(page + header->free_end, data, length);
+  slots[slot] = (HeapSlot){.offset = (u16)header->free_end,
+                           .length = (u16)length};
+  return true;
+}
+
+void heap_page_compact(u8 *page) {
+  ASSERT(page);
+  HeapPageHeader *header = heap_page_header(page);
+  HeapSlot *slots = heap_page_slots(page);
+  if (header->dead_bytes == 0) {
+    return;
+  }
+
+  // Copy the live tuples out, packed against the end of a scratch page, then
+  // copy the packed area back in one go.
+  u8 scratch[HEAP_PAGE_MAX_SIZE];
+  u32 end = header->page_size;
+  for (u16 i = 0; i < header->slot_count; ++i) {
+    if (slots[i].offset == 0) {
+      continue;
+    }
+    end -= slots[i].length;
+    memcpy(scratch + end, page + slots[i].offset, slots[i].length);
+    slots[i].offset = (u16)end;
+  }
+  memcpy(page + end, scratch + end, header->page_size - end);
+  header->free_end = end;
+  header->dead_bytes = 0;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static HeapPageHeader *heap_page_header(u8 *page) {
+  return (HeapPageHeader *)page;
+}
+
+static HeapSlot *heap_page_slots(u8 *page) {
+  return (HeapSlot *)(page + sizeof(HeapPageHeader));
+}
+
+// Makes room for a 'length'-byte tuple (and a new slot) in the contiguous
+// gap, compacting if the gap alone is too small.
+static bool heap_page_reserve(u8 *page, u32 length, bool needs_slot) {
+  HeapPageHeader *header = heap_page_header(page);
+  u32 needed = length + (needs_slot ? (u32)sizeof(HeapSlot) : 0);
+  u32 contiguous = header->free_end - header->free_start;
+  if (needed <= contiguous) {
+    return true;
+  }
+  if (needed > contiguous + header->dead_bytes) {
+    return false;
+  }
+  heap_page_compact(page);
+  return true;
+}
+
+// Drops free slots at the end of the directory, returning their bytes to the
+// free gap. Slots below the last live one must stay to keep numbers stable.
+static void heap_page_trim_slots(u8 *page) {
+  HeapPageHeader *header = heap_page_header(page);
+  HeapSlot *slots = heap_page_slots(page);
+  while (header->slot_count > 0 && slots[header->slot_count - 1].offset == 0) {
+    header->slot_count--;
+    header->free_start -= (u32)sizeof(HeapSlot);
+  }
+}
@@ -0,0 +1,279 @@
+#include "sqldb/page_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool pf_disable_direct_io(PageFile *pf);
+static int pf_madvise_flag(PageAccessHint hint);
+
+static const char *const pf_access_hint_names[] = {
+    [PAGE_ACCESS_NORMAL] = "normal",
+    [PAGE_ACCESS_RANDOM] = "random",
+    [PAGE_ACCESS_SEQUENTIAL] = "sequential",
+    [PAGE_ACCESS_WILLNEED] = "willneed",
+};
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool pf_open(PageFile *pf, const char *path, u32 page_size, bool read_only,
+             bool direct_io) {
+  ASSERT(pf && path && page_size > 0);
+  ASSERT(page_size % PAGE_FILE_DIRECT_IO_ALIGNMENT == 0);
+
+  ZERO_STRUCT(*pf);
+  pf->fd = -1;
+  pf->page_size = page_size;
+  pf->read_only = read_only;
+
+  int flags = read_only ? O_RDONLY : O_RDWR;
+  flags |= O_CLOEXEC;
+#ifdef O_DIRECT
+  if (direct_io) {
+    flags |= O_DIRECT;
+  }
+#else
+  if (direct_io) {
+    LOG_WARN("O_DIRECT is not available on this platform, using buffered I/O");
+    direct_io = false;
+  }
+#endif
+
+  pf->fd = open(path, flags);
+  if (pf->fd < 0 && errno == ENOENT && !read_only) {
+    LOG_INFO("Database file doesn't exist, creating new file: %s", path);
+    pf->fd = open(path, flags | O_CREAT, 0644);
+  }
+#ifdef O_DIRECT
+  if (pf->fd < 0 && errno == EINVAL && direct_io) {
+    LOG_WARN("File system rejected O_DIRECT for %s, using buffered I/O", path);
+    direct_io = false;
+    flags &= ~O_DIRECT;
+    pf->fd = open(path, read_only ? flags : flags | O_CREAT, 0644);
+  }
+#endif
+  if (pf->fd < 0) {
+    LOG_ERROR("Failed to open database file %s: %s", path, strerror(errno));
+    return false;
+  }
+  pf->direct_io = direct_io;
+
+  struct stat st;
+  if (fstat(pf->fd, &st) != 0) {
+    LOG_ERROR("Failed to stat database file %s: %s", path, strerror(errno));
+    pf_close(pf);
+    return false;
+  }
+  pf->page_count = (PageId)st.st_size / page_size;
+  if ((u64)st.st_size % page_size != 0) {
+    LOG_WARN("Database file %s ends with a partial page (%lld bytes)", path,
+             (long long)st.st_size);
+  }
+  return true;
+}
+
+void pf_close(PageFile *pf) {
+  ASSERT(pf);
+  if (pf->map) {
+    munmap(pf->map, pf->map_size);
+    pf->map = NULL;
+    pf->map_size = 0;
+  }
+  if (pf->fd >= 0) {
+    close(pf->fd);
+    pf->fd = -1;
+  }
+}
+
+bool pf_read_page(PageFile *pf, PageId page_id, u8 *out_data) {
+  ASSERT(pf && pf->fd >= 0 && out_data);
+  ASSERT(!pf_uses_direct_io(pf) ||
+         (uintptr_t)out_data % PAGE_FILE_DIRECT_IO_ALIGNMENT == 0);
+
+  off_t offset = (off_t)(page_id * pf->page_size);
+  usize done = 0;
+  while (done < pf->page_size) {
+    ssize_t n = pread(pf->fd, out_data + done, pf->page_size - done,
+                      offset + (off_t)done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && pf_uses_direct_io(pf) &&
+          pf_disable_direct_io(pf)) {
+        continue; // Device needs a larger alignment than page_size
+      }
+      LOG_ERROR("Failed to read page %" PRIu64 ": %s", page_id,
+                strerror(errno));
+      return false;
+    }
+    if (n == 0) {
+      memset(out_data + done, 0, pf->page_size - done); // Past end of file
+      break;
+    }
+    done += (usize)n;
+  }
+  return true;
+}
+
+bool pf_write_page(PageFile *pf, PageId page_id, const u8 *data) {
+  ASSERT(pf && pf->fd >= 0 && data);
+  ASSERT(!pf_uses_direct_io(pf) ||
+         (uintptr_t)data % PAGE_FILE_DIRECT_IO_ALIGNMENT == 0);
+  if (pf->read_only) {
+    LOG_ERROR("Refusing to write page %" PRIu64 " to a read-only file",
+              page_id);
+    return false;
+  }
+
+  off_t offset = (off_t)(page_id * pf->page_size);
+  usize done = 0;
+  while (done < pf->page_size) {
+    ssize_t n = pwrite(pf->fd, data + done, pf->page_size - done,
+                       offset + (off_t)done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && pf_uses_direct_io(pf) &&
+          pf_disable_direct_io(pf)) {
+        continue;
+      }
+      LOG_ERROR("Failed to write page %" PRIu64 ": %s", page_id,
+                strerror(errno));
+      return false;
+    }
+    done += (usize)n;
+  }
+  pf_note_page_written(pf, page_id);
+  return true;
+}
+
+void pf_note_page_written(PageFile *pf, PageId page_id) {
+  ASSERT(pf);
+  PageId count = __atomic_load_n(&pf->page_count, __ATOMIC_RELAXED);
+  while (count <= page_id &&
+         !__atomic_compare_exchange_n(&pf->page_count, &count, page_id + 1,
+                                      true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+    // A failed exchange reloads 'count'; stop once another writer covers us
+  }
+}
+
+bool pf_sync(const PageFile *pf) {
+  ASSERT(pf && pf->fd >= 0);
+  if (pf->read_only) {
+    return true;
+  }
+  if (fdatasync(pf->fd) != 0) {
+    LOG_ERROR("Failed to sync database file: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool pf_map(PageFile *pf, PageAccessHint hint) {
+  ASSERT(pf && pf->fd >= 0 && !pf->map);
+  if (!pf->read_only) {
+    LOG_ERROR("Only read-only database files can be memory-mapped");
+    return false;
+  }
+  if (pf_page_count(pf) == 0) {
+    LOG_WARN("Database file is empty, nothing to map");
+    return false;
+  }
+
+  usize size = (usize)pf_page_count(pf) * pf->page_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, pf->fd, 0);
+  if (map == MAP_FAILED) {
+    LOG_ERROR("Failed to map %zu bytes of the database file: %s", size,
+              strerror(errno));
+    return false;
+  }
+  pf->map = (u8 *)map;
+  pf->map_size = size;
+  pf_advise(pf, 0, pf_page_count(pf), hint);
+  return true;
+}
+
+bool pf_advise(const PageFile *pf, PageId first_page_id, PageId count,
+               PageAccessHint hint) {
+  ASSERT(pf);
+  if (!pf->map || first_page_id >= pf_page_count(pf)) {
+    return true;
+  }
+  count = MIN(count, pf_page_count(pf) - first_page_id);
+  // Page ids are page_size aligned offsets into a page-aligned mapping, so the
+  // range start is aligned whenever page_size is a multiple of the OS page.
+  usize os_page = (usize)sysconf(_SC_PAGESIZE);
+  usize start = (usize)first_page_id * pf->page_size;
+  usize end = start + (usize)count * pf->page_size;
+  start -= start % os_page;
+  if (madvise(pf->map + start, end - start, pf_madvise_flag(hint)) != 0) {
+    LOG_WARN("madvise(%s) failed: %s", pf_access_hint_name(hint),
+             strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+const char *pf_access_hint_name(PageAccessHint hint) {
+  ASSERT((usize)hint < ARRAY_SIZE(pf_access_hint_names));
+  return pf_access_hint_names[hint];
+}
+
+bool pf_access_hint_from_name(const char *name, PageAccessHint *out_hint) {
+  ASSERT(name && out_hint);
+  for (usize i = 0; i < ARRAY_SIZE(pf_access_hint_names); ++i) {
+    if (strcmp(name, pf_access_hint_names[i]) == 0) {
+      *out_hint = (PageAccessHint)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// Drops O_DIRECT after the device rejected a transfer (e.g. a 512-byte page on
+// a 4K-sector disk). Returns false if the flag could not be cleared.
+static bool pf_disable_direct_io(PageFile *pf) {
+#ifdef O_DIRECT
+  int flags = fcntl(pf->fd, F_GETFL);
+  if (flags < 0 || fcntl(pf->fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+    return false;
+  }
+  LOG_WARN("Device rejected %u-byte direct I/O, using buffered I/O",
+           pf->page_size);
+  __atomic_store_n(&pf->direct_io, false, __ATOMIC_RELAXED);
+  return true;
+#else
+  (void)pf;
+  return false;
+#endif
+}
+
+static int pf_madvise_flag(PageAccessHint hint) {
+  switch (hint) {
+  case PAGE_ACCESS_RANDOM:
+    return MADV_RANDOM;
+  case PAGE_ACCESS_SEQUENTIAL:
+    return MADV_SEQUENTIAL;
+  case PAGE_ACCESS_WILLNEED:
+    return MADV_WILLNEED;
+  case PAGE_ACCESS_NORMAL:
+    return MADV_NORMAL;
+  }
+  return MADV_NORMAL;
+}
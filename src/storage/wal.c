@@ -0,0 +1,571 @@
+#include "sqldb/wal.h"
+#include "sqldb/checksum.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Private Types ::
+// =================================================================================================
+
+#define WAL_MAGIC 0x57514C53u // "SLQW"
+#define WAL_VERSION 1u
+#define WAL_RECORD_ALIGNMENT ((usize)8)
+#define WAL_FIRST_LSN 1
+
+// First bytes of the log file; records start right after it.
+typedef struct {
+  u32 magic;
+  u32 version;
+  u32 page_size;
+  u32 checksum; // CRC-32C of the header with this field zeroed
+  Lsn base_lsn; // LSN of the first record
+  u64 next_txn_id;
+} WalFileHeader;
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool wal_write_header(Wal *wal);
+static bool wal_read_header(Wal *wal, WalFileHeader *out_header);
+static bool wal_write_all(int fd, const u8 *data, usize len, off_t offset);
+static bool wal_write_buffer(Wal *wal);
+static Lsn wal_append(Wal *wal, WalRecordType type, u64 txn_id, PageId page_id,
+                      u32 offset, const u8 *data, u32 length);
+static u32 wal_record_checksum(const WalRecordHeader *header);
+static off_t wal_file_offset(const Wal *wal, Lsn lsn);
+static const WalRecordHeader *wal_parse_record(const Wal *wal, const u8 *log,
+                                               usize log_size, usize offset);
+static bool wal_apply_page_write(PageFile *file, const WalRecordHeader *record,
+                                 u8 *page);
+static bool wal_flush_locked(Wal *wal, Lsn lsn, bool is_commit);
+static void wal_lead_flush(Wal *wal, bool is_commit);
+static void wal_wait_for_batch(Wal *wal);
+static u64 wal_now_us(void);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool wal_open(Wal *wal, const char *path, u32 page_size) {
+  ASSERT(wal && path && page_size > 0);
+
+  ZERO_STRUCT(*wal);
+  wal->page_size = page_size;
+  wal->commit_window_us = DEFAULT_COMMIT_WINDOW_US;
+  wal->commit_batch_size = DEFAULT_COMMIT_BATCH_SIZE;
+  wal->checkpoint_bytes = DEFAULT_WAL_CHECKPOINT_BYTES;
+  histogram_init(&wal->stats.commit_batch_sizes);
+  histogram_init(&wal->stats.flush_latency_us);
+
+  // Leaders wait for their batch against the monotonic clock.
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&wal->lock, NULL);
+  pthread_cond_init(&wal->flushed, NULL);
+  pthread_cond_init(&wal->batch_ready, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  wal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (wal->fd < 0) {
+    LOG_ERROR("Failed to open WAL file %s: %s", path, strerror(errno));
+    wal_close(wal);
+    return false;
+  }
+
+  wal->buffer = (u8 *)malloc(WAL_BUFFER_SIZE);
+  wal->flush_buffer = (u8 *)malloc(WAL_BUFFER_SIZE);
+  if (!wal->buffer || !wal->flush_buffer) {
+    LOG_ERROR("Failed to allocate the %d-byte WAL buffers", WAL_BUFFER_SIZE);
+    wal_close(wal);
+    return false;
+  }
+
+  WalFileHeader header;
+  if (!wal_read_header(wal, &header)) {
+    LOG_INFO("Starting a new write-ahead log: %s", path);
+    wal->base_lsn = WAL_FIRST_LSN;
+    wal->next_txn_id = 1;
+    if (!wal_write_header(wal) || ftruncate(wal->fd, sizeof(header)) != 0 ||
+        fdatasync(wal->fd) != 0) {
+      LOG_ERROR("Failed to initialize WAL file %s: %s", path,
+                strerror(errno));
+      wal_close(wal);
+      return false;
+    }
+  } else if (header.page_size != page_size) {
+    LOG_ERROR("WAL file %s was written with %u-byte pages, not %u", path,
+              header.page_size, page_size);
+    wal_close(wal);
+    return false;
+  } else {
+    wal->base_lsn = header.base_lsn;
+    wal->next_txn_id = header.next_txn_id;
+  }
+
+  // Until wal_recover has scanned the file, new records start at base_lsn.
+  wal->next_lsn = wal->base_lsn;
+  wal->flushed_lsn = wal->base_lsn;
+  wal->buffer_lsn = wal->base_lsn;
+  return true;
+}
+
+void wal_close(Wal *wal) {
+  ASSERT(wal && !wal->flush_in_progress);
+  if (wal->fd >= 0) {
+    close(wal->fd);
+    wal->fd = -1;
+  }
+  free(wal->buffer);
+  free(wal->flush_buffer);
+  wal->buffer = NULL;
+  wal->flush_buffer = NULL;
+  wal->buffer_used = 0;
+  pthread_cond_destroy(&wal->batch_ready);
+  pthread_cond_destroy(&wal->flushed);
+  pthread_mutex_destroy(&wal->lock);
+}
+
+void wal_set_group_commit(Wal *wal, u32 window_us, u32 batch_size) {
+  ASSERT(wal && batch_size > 0);
+  pthread_mutex_lock(&wal->lock);
+  wal->commit_window_us = window_us;
+  wal->commit_batch_size = batch_size;
+  pthread_mutex_unlock(&wal->lock);
+}
+
+bool wal_recover(Wal *wal, PageFile *file) {
+  ASSERT(wal && wal->fd >= 0 && file);
+  ASSERT(file->page_size == wal->page_size);
+
+  struct stat st;
+  if (fstat(wal->fd, &st) != 0) {
+    LOG_ERROR("Failed to stat WAL file: %s", strerror(errno));
+    return false;
+  }
+  usize log_size = (usize)st.st_size;
+  if (log_size <= sizeof(WalFileHeader)) {
+    return true; // Clean shutdown: nothing to replay
+  }
+
+  u8 *log = (u8 *)malloc(log_size);
+  u8 *page = (u8 *)aligned_alloc(file->page_size, file->page_size);
+  BaseHashTableOA committed =
+      ht_oa_init(64, base_hash_u64, base_key_equal_u64, NULL);
+  bool ok = log && page;
+  if (!ok) {
+    LOG_ERROR("Failed to allocate %zu bytes to replay the WAL", log_size);
+  }
+
+  usize done = 0;
+  while (ok && done < log_size) {
+    ssize_t n = pread(wal->fd, log + done, log_size - done, (off_t)done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      LOG_ERROR("Failed to read WAL file: %s", n < 0 ? strerror(errno) : "EOF");
+      ok = false;
+      break;
+    }
+    done += (usize)n;
+  }
+
+  // Pass 1: find the valid prefix of the log and the transactions that
+  // committed within it. Commit records are 8-byte aligned inside 'log', so
+  // the table can key on their txn_id fields directly.
+  usize end = sizeof(WalFileHeader);
+  u64 record_count = 0;
+  u64 max_txn_id = 0;
+  while (ok && end < log_size) {
+    const WalRecordHeader *record = wal_parse_record(wal, log, log_size, end);
+    if (!record) {
+      break;
+    }
+    if (record->type == WAL_RECORD_COMMIT) {
+      ht_oa_put(&committed, &record->txn_id, (void *)record);
+    }
+    max_txn_id = MAX(max_txn_id, record->txn_id);
+    record_count++;
+    end += record->size;
+  }
+  if (ok && end < log_size) {
+    LOG_WARN("Ignoring %zu bytes of torn or corrupt WAL tail", log_size - end);
+  }
+
+  // Pass 2: redo the page writes of committed transactions in LSN order.
+  u64 replayed = 0;
+  for (usize offset = sizeof(WalFileHeader); ok && offset < end;) {
+    const WalRecordHeader *record = (const WalRecordHeader *)(log + offset);
+    if (record->type == WAL_RECORD_PAGE_WRITE &&
+        ht_oa_contains(&committed, &record->txn_id)) {
+      ok = wal_apply_page_write(file, record, page);
+      replayed++;
+    }
+    offset += record->size;
+  }
+
+  if (ok) {
+    LOG_INFO("WAL recovery: %" PRIu64 " records, %zu committed transactions, "
+             "%" PRIu64 " page writes replayed",
+             record_count, ht_oa_size(&committed), replayed);
+    wal->stats.recovered += replayed;
+    wal->next_lsn = wal->base_lsn + (end - sizeof(WalFileHeader));
+    wal->flushed_lsn = wal->next_lsn;
+    wal->buffer_lsn = wal->next_lsn;
+    wal->next_txn_id = MAX(wal->next_txn_id, max_txn_id + 1);
+    // The replayed pages must be durable before the log that produced them
+    // is thrown away.
+    ok = pf_sync(file) && wal_checkpoint(wal, wal->next_lsn);
+  }
+
+  ht_oa_free(&committed);
+  free(page);
+  free(log);
+  return ok;
+}
+
+u64 wal_begin_txn(Wal *wal) {
+  ASSERT(wal);
+  pthread_mutex_lock(&wal->lock);
+  u64 txn_id = wal->next_txn_id++;
+  pthread_mutex_unlock(&wal->lock);
+  return txn_id;
+}
+
+Lsn wal_log_page_write(Wal *wal, u64 txn_id, PageId page_id, u32 offset,
+                       const u8 *data, u32 length) {
+  ASSERT(wal && data);
+  if ((u64)offset + length > wal->page_size) {
+    LOG_ERROR("WAL page write [%u, %u) exceeds the %u-byte page", offset,
+              offset + length, wal->page_size);
+    return INVALID_LSN;
+  }
+  pthread_mutex_lock(&wal->lock);
+  Lsn lsn = wal_append(wal, WAL_RECORD_PAGE_WRITE, txn_id, page_id, offset,
+                       data, length);
+  pthread_mutex_unlock(&wal->lock);
+  return lsn;
+}
+
+bool wal_commit(Wal *wal, u64 txn_id) {
+  ASSERT(wal);
+  pthread_mutex_lock(&wal->lock);
+  Lsn lsn = wal_append(wal, WAL_RECORD_COMMIT, txn_id, INVALID_PAGE_ID, 0,
+                       NULL, 0);
+  bool ok = lsn != INVALID_LSN;
+  if (ok) {
+    wal->pending_commits++;
+    if (wal->pending_commits >= wal->commit_batch_size) {
+      pthread_cond_signal(&wal->batch_ready);
+    }
+    ok = wal_flush_locked(wal, lsn + 1, true);
+  }
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+bool wal_flush(Wal *wal, Lsn lsn) {
+  ASSERT(wal && wal->fd >= 0);
+  pthread_mutex_lock(&wal->lock);
+  bool ok = wal_flush_locked(wal, lsn, false);
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+Lsn wal_next_lsn(Wal *wal) {
+  ASSERT(wal);
+  pthread_mutex_lock(&wal->lock);
+  Lsn lsn = wal->next_lsn;
+  pthread_mutex_unlock(&wal->lock);
+  return lsn;
+}
+
+bool wal_needs_checkpoint(Wal *wal) {
+  ASSERT(wal);
+  pthread_mutex_lock(&wal->lock);
+  bool needed = wal->next_lsn - wal->base_lsn >= wal->checkpoint_bytes;
+  pthread_mutex_unlock(&wal->lock);
+  return needed;
+}
+
+bool wal_checkpoint(Wal *wal, Lsn lsn) {
+  ASSERT(wal && wal->fd >= 0);
+  pthread_mutex_lock(&wal->lock);
+  // A leader writes at offsets relative to base_lsn without the lock.
+  while (wal->flush_in_progress) {
+    pthread_cond_wait(&wal->flushed, &wal->lock);
+  }
+  if (wal->next_lsn != lsn) {
+    // Records at or after 'lsn' may describe changes the data file lacks.
+    pthread_mutex_unlock(&wal->lock);
+    LOG_DEBUG("WAL checkpoint skipped: the log grew past LSN %" PRIu64, lsn);
+    return true;
+  }
+
+  // LSNs keep growing across truncations so that page LSNs stay comparable.
+  // Staged records are dropped too: the data file already holds their
+  // changes, so their commits count as durable.
+  wal->buffer_used = 0;
+  wal->base_lsn = wal->next_lsn;
+  wal->buffer_lsn = wal->next_lsn;
+  wal->flushed_lsn = wal->next_lsn;
+  bool ok = wal_write_header(wal) &&
+            ftruncate(wal->fd, sizeof(WalFileHeader)) == 0 &&
+            fdatasync(wal->fd) == 0;
+  if (ok) {
+    wal->stats.checkpoints++;
+  } else {
+    LOG_ERROR("Failed to truncate WAL: %s", strerror(errno));
+  }
+  pthread_cond_broadcast(&wal->flushed);
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+void wal_log_stats(const Wal *wal) {
+  ASSERT(wal);
+  LOG_INFO("WAL: %" PRIu64 " records (%" PRIu64 " bytes), %" PRIu64
+           " commits, %" PRIu64 " flushes, %" PRIu64 " checkpoints, "
+           "next LSN %" PRIu64,
+           wal->stats.records, wal->stats.bytes, wal->stats.commits,
+           wal->stats.flushes, wal->stats.checkpoints, wal->next_lsn);
+  histogram_log(&wal->stats.commit_batch_sizes, "WAL commits per flush", "");
+  histogram_log(&wal->stats.flush_latency_us, "WAL flush latency", "us");
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static bool wal_write_header(Wal *wal) {
+  WalFileHeader header = {
+      .magic = WAL_MAGIC,
+      .version = WAL_VERSION,
+      .page_size = wal->page_size,
+      .base_lsn = wal->base_lsn,
+      .next_txn_id = wal->next_txn_id,
+  };
+  header.checksum = crc32c(0, &header, sizeof(header));
+  return wal_write_all(wal->fd, (const u8 *)&header, sizeof(header), 0);
+}
+
+static bool wal_read_header(Wal *wal, WalFileHeader *out_header) {
+  ssize_t n = pread(wal->fd, out_header, sizeof(*out_header), 0);
+  if (n != (ssize_t)sizeof(*out_header)) {
+    return false;
+  }
+  u32 checksum = out_header->checksum;
+  out_header->checksum = 0;
+  bool valid = out_header->magic == WAL_MAGIC &&
+               out_header->version == WAL_VERSION &&
+               crc32c(0, out_header, sizeof(*out_header)) == checksum;
+  out_header->checksum = checksum;
+  if (!valid) {
+    LOG_WARN("WAL header is missing or corrupt, discarding the log");
+  }
+  return valid;
+}
+
+static bool wal_write_all(int fd, const u8 *data, usize len, off_t offset) {
+  usize done = 0;
+  while (done < len) {
+    ssize_t n = pwrite(fd, data + done, len - done, offset + (off_t)done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("Failed to write WAL: %s", strerror(errno));
+      return false;
+    }
+    done += (usize)n;
+  }
+  return true;
+}
+
+// Hands staged records to the kernel (not yet durable).
+static bool wal_write_buffer(Wal *wal) {
+  if (wal->buffer_used == 0) {
+    return true;
+  }
+  if (!wal_write_all(wal->fd, wal->buffer, wal->buffer_used,
+                     wal_file_offset(wal, wal->buffer_lsn))) {
+    return false;
+  }
+  wal->buffer_lsn += wal->buffer_used;
+  wal->buffer_used = 0;
+  return true;
+}
+
+static Lsn wal_append(Wal *wal, WalRecordType type, u64 txn_id, PageId page_id,
+                      u32 offset, const u8 *data, u32 length) {
+  usize size = ALIGN_UP(sizeof(WalRecordHeader) + length, WAL_RECORD_ALIGNMENT);
+  ASSERT(size <= WAL_BUFFER_SIZE);
+  if (wal->buffer_used + size > WAL_BUFFER_SIZE && !wal_write_buffer(wal)) {
+    return INVALID_LSN;
+  }
+
+  WalRecordHeader *header = (WalRecordHeader *)(wal->buffer + wal->buffer_used);
+  *header = (WalRecordHeader){
+      .size = (u32)size,
+      .lsn = wal->next_lsn,
+      .txn_id = txn_id,
+      .page_id = page_id,
+      .page_offset = offset,
+      .length = length,
+      .type = (u32)type,
+  };
+  u8 *payload = (u8 *)(header + 1);
+  if (length > 0) {
+    memcpy(payload, data, length);
+  }
+  memset(payload + length, 0, size - sizeof(WalRecordHeader) - length);
+  header->checksum = wal_record_checksum(header);
+
+  Lsn lsn = wal->next_lsn;
+  wal->buffer_used += size;
+  wal->next_lsn += size;
+  wal->stats.records++;
+  wal->stats.bytes += size;
+  return lsn;
+}
+
+static u32 wal_record_checksum(const WalRecordHeader *header) {
+  const u8 *bytes = (const u8 *)header + sizeof(header->checksum);
+  return crc32c(0, bytes, header->size - sizeof(header->checksum));
+}
+
+static off_t wal_file_offset(const Wal *wal, Lsn lsn) {
+  return (off_t)(sizeof(WalFileHeader) + (lsn - wal->base_lsn));
+}
+
+// Returns the record at 'offset' if it is complete, belongs at this position
+// and passes its checksum; NULL marks the end of the valid log.
+static const WalRecordHeader *wal_parse_record(const Wal *wal, const u8 *log,
+                                               usize log_size, usize offset) {
+  if (log_size - offset < sizeof(WalRecordHeader)) {
+    return NULL;
+  }
+  const WalRecordHeader *record = (const WalRecordHeader *)(log + offset);
+  if (record->size < sizeof(WalRecordHeader) ||
+      record->size % WAL_RECORD_ALIGNMENT != 0 ||
+      record->size > log_size - offset ||
+      record->length > record->size - sizeof(WalRecordHeader)) {
+    return NULL;
+  }
+  if (record->lsn != wal->base_lsn + (offset - sizeof(WalFileHeader)) ||
+      record->checksum != wal_record_checksum(record)) {
+    return NULL;
+  }
+  switch ((WalRecordType)record->type) {
+  case WAL_RECORD_PAGE_WRITE:
+    return (u64)record->page_offset + record->length <= wal->page_size
+               ? record
+               : NULL;
+  case WAL_RECORD_COMMIT:
+    return record;
+  }
+  return NULL;
+}
+
+static bool wal_apply_page_write(PageFile *file, const WalRecordHeader *record,
+                                 u8 *page) {
+  if (!pf_read_page(file, record->page_id, page)) {
+    return false;
+  }
+  memcpy(page + record->page_offset, record + 1, record->length);
+  return pf_write_page(file, record->page_id, page);
+}
+
+// Waits until every record below 'lsn' is durable, leading a flush whenever
+// none is running. Called and returns with wal->lock held.
+static bool wal_flush_locked(Wal *wal, Lsn lsn, bool is_commit) {
+  lsn = MIN(lsn, wal->next_lsn);
+  while (wal->flushed_lsn < lsn && !wal->io_failed) {
+    if (wal->flush_in_progress) {
+      pthread_cond_wait(&wal->flushed, &wal->lock);
+    } else {
+      wal_lead_flush(wal, is_commit);
+    }
+  }
+  return wal->flushed_lsn >= lsn;
+}
+
+// Flushes everything appended so far as one batch. The lock is released for
+// the write and fdatasync so the next batch can keep appending meanwhile.
+static void wal_lead_flush(Wal *wal, bool is_commit) {
+  wal->flush_in_progress = true;
+  if (is_commit) {
+    wal_wait_for_batch(wal);
+  }
+
+  // Claim the staged records and hand appenders the spare buffer.
+  u8 *data = wal->buffer;
+  usize size = wal->buffer_used;
+  off_t offset = wal_file_offset(wal, wal->buffer_lsn);
+  wal->buffer = wal->flush_buffer;
+  wal->flush_buffer = data;
+  wal->buffer_lsn += size;
+  wal->buffer_used = 0;
+  Lsn target = wal->next_lsn;
+  u32 batch = wal->pending_commits;
+  wal->pending_commits = 0;
+  pthread_mutex_unlock(&wal->lock);
+
+  u64 start = wal_now_us();
+  bool ok = wal_write_all(wal->fd, data, size, offset);
+  if (ok && fdatasync(wal->fd) != 0) {
+    LOG_ERROR("Failed to sync WAL: %s", strerror(errno));
+    ok = false;
+  }
+  u64 elapsed = wal_now_us() - start;
+
+  pthread_mutex_lock(&wal->lock);
+  if (ok) {
+    wal->flushed_lsn = MAX(wal->flushed_lsn, target);
+    wal->stats.flushes++;
+    wal->stats.commits += batch;
+    histogram_record(&wal->stats.flush_latency_us, elapsed);
+    if (batch > 0) {
+      histogram_record(&wal->stats.commit_batch_sizes, batch);
+    }
+  } else {
+    // After a failed fdatasync the kernel may have dropped the dirty pages,
+    // so no later flush can vouch for these records again.
+    wal->io_failed = true;
+  }
+  wal->flush_in_progress = false;
+  pthread_cond_broadcast(&wal->flushed);
+}
+
+// Lets more commits join the leader's batch: waits until commit_batch_size
+// commits are pending or commit_window_us has passed.
+static void wal_wait_for_batch(Wal *wal) {
+  if (wal->commit_window_us == 0 ||
+      wal->pending_commits >= wal->commit_batch_size) {
+    return;
+  }
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  u64 nsec = (u64)deadline.tv_nsec + (u64)wal->commit_window_us * 1000;
+  deadline.tv_sec += (time_t)(nsec / 1000000000);
+  deadline.tv_nsec = (long)(nsec % 1000000000);
+  while (wal->pending_commits < wal->commit_batch_size) {
+    if (pthread_cond_timedwait(&wal->batch_ready, &wal->lock, &deadline) ==
+        ETIMEDOUT) {
+      break;
+    }
+  }
+}
+
+static u64 wal_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
@@ -0,0 +1,176 @@
+#include "sqldb/concurrent_map.h"
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static CMapShard *cmap_shard(const ConcurrentMap *map, const void *key) {
+  u64 hash = map->hash_fn(key);
+  // A single shard would shift by 64, which C leaves undefined.
+  usize index = map->shard_count > 1 ? (usize)(hash >> map->shard_shift) : 0;
+  return &map->shards[index];
+}
+
+static void cmap_read_lock(CMapShard *shard) {
+  pthread_rwlock_rdlock(&shard->lock);
+}
+
+static void cmap_write_lock(CMapShard *shard) {
+  pthread_rwlock_wrlock(&shard->lock);
+}
+
+static void cmap_unlock(CMapShard *shard) {
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+bool cmap_init(ConcurrentMap *map, u32 shard_count, usize capacity,
+               BaseHashFunction hash_fn, BaseKeyEqualFunction key_equal_fn) {
+  ASSERT(map && hash_fn && key_equal_fn);
+  ZERO_STRUCT(*map);
+  if (shard_count == 0) {
+    shard_count = CMAP_DEFAULT_SHARDS;
+  }
+  shard_count = MIN(shard_count, (u32)CMAP_MAX_SHARDS);
+  u32 shard_bits = 0;
+  while ((1u << shard_bits) < shard_count) {
+    shard_bits++;
+  }
+  shard_count = 1u << shard_bits;
+
+  map->shards = (CMapShard *)aligned_alloc(CMAP_CACHE_LINE,
+                                           shard_count * sizeof(CMapShard));
+  if (!map->shards) {
+    LOG_ERROR("Failed to allocate %u map shards", shard_count);
+    return false;
+  }
+  memset(map->shards, 0, shard_count * sizeof(CMapShard));
+  map->shard_count = shard_count;
+  map->shard_shift = 64 - shard_bits;
+  map->hash_fn = hash_fn;
+
+  pthread_rwlockattr_t attr;
+  pthread_rwlockattr_init(&attr);
+#if defined(__GLIBC__)
+  // glibc prefers readers by default, which starves writers under a
+  // read-mostly load.
+  pthread_rwlockattr_setkind_np(&attr,
+                                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+  // Room for 'capacity' keys below the table's load factor.
+  usize buckets = (usize)((f64)(capacity / shard_count + 1) /
+                          BASE_HT_OA_MAX_LOAD_FACTOR) +
+                  1;
+  bool ok = true;
+  for (u32 s = 0; s < shard_count; ++s) {
+    CMapShard *shard = &map->shards[s];
+    pthread_rwlock_init(&shard->lock, &attr);
+    shard->table = ht_oa_init(buckets, hash_fn, key_equal_fn, NULL);
+    ok = ok && shard->table.entries;
+  }
+  pthread_rwlockattr_destroy(&attr);
+  if (!ok) {
+    LOG_ERROR("Failed to allocate map shards of %zu buckets", buckets);
+    cmap_free(map);
+    return false;
+  }
+  return true;
+}
+
+void cmap_free(ConcurrentMap *map) {
+  ASSERT(map);
+  if (!map->shards) {
+    return;
+  }
+  for (u32 s = 0; s < map->shard_count; ++s) {
+    CMapShard *shard = &map->shards[s];
+    ht_oa_free(&shard->table);
+    pthread_rwlock_destroy(&shard->lock);
+  }
+  free(map->shards);
+  ZERO_STRUCT(*map);
+}
+
+void cmap_set_incremental(ConcurrentMap *map, bool incremental) {
+  ASSERT(map);
+  for (u32 s = 0; s < map->shard_count; ++s) {
+    ht_oa_set_incremental(&map->shards[s].table, incremental);
+  }
+}
+
+bool cmap_insert(ConcurrentMap *map, const void *key, void *value) {
+  ASSERT(map && key);
+  CMapShard *shard = cmap_shard(map, key);
+  cmap_write_lock(shard);
+  bool inserted = ht_oa_insert(&shard->table, key, value);
+  cmap_unlock(shard);
+  return inserted;
+}
+
+bool cmap_put(ConcurrentMap *map, const void *key, void *value,
+              void **out_old_value) {
+  ASSERT(map && key);
+  CMapShard *shard = cmap_shard(map, key);
+  cmap_write_lock(shard);
+  if (out_old_value) {
+    *out_old_value = ht_oa_get(&shard->table, key);
+  }
+  bool stored = ht_oa_put(&shard->table, key, value);
+  cmap_unlock(shard);
+  return stored;
+}
+
+void *cmap_get(const ConcurrentMap *map, const void *key) {
+  ASSERT(map && key);
+  CMapShard *shard = cmap_shard(map, key);
+  cmap_read_lock(shard); // ht_oa_get does not move entries, even mid-resize
+  void *value = ht_oa_get(&shard->table, key);
+  cmap_unlock(shard);
+  return value;
+}
+
+bool cmap_contains(const ConcurrentMap *map, const void *key) {
+  ASSERT(map && key);
+  CMapShard *shard = cmap_shard(map, key);
+  cmap_read_lock(shard);
+  bool found = ht_oa_contains(&shard->table, key);
+  cmap_unlock(shard);
+  return found;
+}
+
+bool cmap_remove(ConcurrentMap *map, const void *key, void **out_value) {
+  ASSERT(map && key);
+  CMapShard *shard = cmap_shard(map, key);
+  cmap_write_lock(shard);
+  if (out_value) {
+    *out_value = ht_oa_get(&shard->table, key);
+  }
+  bool removed = ht_oa_remove(&shard->table, key);
+  cmap_unlock(shard);
+  return removed;
+}
+
+usize cmap_size(const ConcurrentMap *map) {
+  ASSERT(map);
+  usize size = 0;
+  for (u32 s = 0; s < map->shard_count; ++s) {
+    CMapShard *shard = &map->shards[s];
+    cmap_read_lock(shard);
+    size += ht_oa_size(&shard->table);
+    cmap_unlock(shard);
+  }
+  return size;
+}
+
+void cmap_clear(ConcurrentMap *map) {
+  ASSERT(map);
+  for (u32 s = 0; s < map->shard_count; ++s) {
+    CMapShard *shard = &map->shards[s];
+    cmap_write_lock(shard);
+    ht_oa_clear(&shard->table);
+    cmap_unlock(shard);
+  }
+}
@@ -0,0 +1,100 @@
+#include "sqldb/histogram.h"
+
+#include <inttypes.h>
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static usize histogram_bucket_index(u64 value);
+static u64 histogram_bucket_upper_bound(usize index);
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+void histogram_init(Histogram *hist) {
+  ASSERT(hist);
+  ZERO_STRUCT(*hist);
+  hist->min = UINT64_MAX;
+}
+
+void histogram_record(Histogram *hist, u64 value) {
+  ASSERT(hist);
+  hist->counts[histogram_bucket_index(value)]++;
+  hist->total_count++;
+  hist->sum += value;
+  hist->min = MIN(hist->min, value);
+  hist->max = MAX(hist->max, value);
+}
+
+void histogram_merge(Histogram *dst, const Histogram *src) {
+  ASSERT(dst && src);
+  for (usize i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total_count += src->total_count;
+  dst->sum += src->sum;
+  dst->min = MIN(dst->min, src->min);
+  dst->max = MAX(dst->max, src->max);
+}
+
+u64 histogram_percentile(const Histogram *hist, f64 percentile) {
+  ASSERT(hist);
+  if (hist->total_count == 0) {
+    return 0;
+  }
+  f64 clamped = CLAMP(percentile, 0.0, 100.0);
+  u64 rank = (u64)((clamped / 100.0) * (f64)hist->total_count + 0.5);
+  rank = CLAMP(rank, (u64)1, hist->total_count);
+
+  u64 seen = 0;
+  for (usize i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+    seen += hist->counts[i];
+    if (seen >= rank) {
+      return MIN(histogram_bucket_upper_bound(i), hist->max);
+    }
+  }
+  return hist->max;
+}
+
+void histogram_log(const Histogram *hist, const char *name, const char *unit) {
+  ASSERT(hist && name && unit);
+  if (hist->total_count == 0) {
+    LOG_INFO("%s: no samples", name);
+    return;
+  }
+  LOG_INFO("%s: n=%" PRIu64 " mean=%.1f%s p50=%" PRIu64 "%s p90=%" PRIu64
+           "%s p99=%" PRIu64 "%s p99.9=%" PRIu64 "%s max=%" PRIu64 "%s",
+           name, hist->total_count, histogram_mean(hist), unit,
+           histogram_percentile(hist, 50.0), unit,
+           histogram_percentile(hist, 90.0), unit,
+           histogram_percentile(hist, 99.0), unit,
+           histogram_percentile(hist, 99.9), unit, hist->max, unit);
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+// Values below HISTOGRAM_SUB_BUCKETS get exact buckets. Above that, the top
+// HISTOGRAM_SUB_BUCKET_BITS bits below the leading one select the sub-bucket.
+static usize histogram_bucket_index(u64 value) {
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return (usize)value;
+  }
+  u32 magnitude = 63u - (u32)__builtin_clzll(value);
+  u32 shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+  u64 sub_bucket = (value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+  return (usize)(shift + 1) * HISTOGRAM_SUB_BUCKETS + (usize)sub_bucket;
+}
+
+static u64 histogram_bucket_upper_bound(usize index) {
+  if (index < HISTOGRAM_SUB_BUCKETS) {
+    return (u64)index;
+  }
+  u32 shift = (u32)(index / HISTOGRAM_SUB_BUCKETS) - 1;
+  u64 sub_bucket = index % HISTOGRAM_SUB_BUCKETS;
+  u64 lower = (HISTOGRAM_SUB_BUCKETS + sub_bucket) << shift;
+  return lower + ((u64)1 << shift) - 1;
+}
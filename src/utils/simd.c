@@ -0,0 +1,1284 @@
+#include "sqldb/simd.h"
+
+#include <math.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#define SIMD_HAS_X86 1
+#include <immintrin.h>
+#define SIMD_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define SIMD_HAS_X86 0
+#endif
+
+// =================================================================================================
+// :: Private Types ::
+// =================================================================================================
+
+typedef struct {
+  SimdLevel level;
+  void (*select_i32)(const i32 *, usize, SimdCompare, i32, u64 *);
+  void (*select_i64)(const i64 *, usize, SimdCompare, i64, u64 *);
+  void (*select_f64)(const f64 *, usize, SimdCompare, f64, u64 *);
+  void (*between_i32)(const i32 *, usize, i32, i32, u64 *);
+  void (*between_i64)(const i64 *, usize, i64, i64, u64 *);
+  void (*between_f64)(const f64 *, usize, f64, f64, u64 *);
+  void (*in_i32)(const i32 *, usize, const i32 *, usize, u64 *);
+  void (*in_i64)(const i64 *, usize, const i64 *, usize, u64 *);
+  void (*in_f64)(const f64 *, usize, const f64 *, usize, u64 *);
+  i64 (*sum_i32)(const i32 *, usize, const u64 *);
+  i64 (*sum_i64)(const i64 *, usize, const u64 *);
+  f64 (*sum_f64)(const f64 *, usize, const u64 *);
+  i32 (*min_i32)(const i32 *, usize, const u64 *);
+  i64 (*min_i64)(const i64 *, usize, const u64 *);
+  f64 (*min_f64)(const f64 *, usize, const u64 *);
+  i32 (*max_i32)(const i32 *, usize, const u64 *);
+  i64 (*max_i64)(const i64 *, usize, const u64 *);
+  f64 (*max_f64)(const f64 *, usize, const u64 *);
+  usize (*bitmap_count)(const u64 *, usize);
+} SimdKernels;
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static const SimdKernels *simd_kernels(void);
+static const SimdKernels *simd_kernels_for_level(SimdLevel level);
+
+// Kernel tables for every level, defined after the kernels.
+static const SimdKernels g_scalar_kernels;
+#if SIMD_HAS_X86
+static const SimdKernels g_sse42_kernels;
+static const SimdKernels g_avx2_kernels;
+#endif
+
+// Active kernels, chosen on first use.
+static const SimdKernels *g_simd_kernels = NULL;
+
+// =================================================================================================
+// :: Public API ::
+// =================================================================================================
+
+SimdLevel simd_detect_level(void) {
+#if SIMD_HAS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("popcnt")) {
+    if (__builtin_cpu_supports("avx2")) {
+      return SIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return SIMD_LEVEL_SSE42;
+    }
+  }
+#endif
+  return SIMD_LEVEL_SCALAR;
+}
+
+SimdLevel simd_level(void) { return simd_kernels()->level; }
+
+bool simd_set_level(SimdLevel level) {
+  ASSERT(level < SIMD_LEVEL_COUNT);
+  if (level > simd_detect_level()) {
+    LOG_ERROR("SIMD level %s is not supported by this CPU",
+              simd_level_name(level));
+    return false;
+  }
+  __atomic_store_n(&g_simd_kernels, simd_kernels_for_level(level),
+                   __ATOMIC_RELEASE);
+  return true;
+}
+
+const char *simd_level_name(SimdLevel level) {
+  switch (level) {
+  case SIMD_LEVEL_SCALAR:
+    return "scalar";
+  case SIMD_LEVEL_SSE42:
+    return "sse4.2";
+  case SIMD_LEVEL_AVX2:
+    return "avx2";
+  default:
+    return "unknown";
+  }
+}
+
+// --- Predicates ---
+
+void simd_select_i32(const i32 *values, usize count, SimdCompare op,
+                     i32 constant, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->select_i32(values, count, op, constant, out_bits);
+}
+
+void simd_select_i64(const i64 *values, usize count, SimdCompare op,
+                     i64 constant, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->select_i64(values, count, op, constant, out_bits);
+}
+
+void simd_select_f64(const f64 *values, usize count, SimdCompare op,
+                     f64 constant, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->select_f64(values, count, op, constant, out_bits);
+}
+
+void simd_between_i32(const i32 *values, usize count, i32 low, i32 high,
+                      u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->between_i32(values, count, low, high, out_bits);
+}
+
+void simd_between_i64(const i64 *values, usize count, i64 low, i64 high,
+                      u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->between_i64(values, count, low, high, out_bits);
+}
+
+void simd_between_f64(const f64 *values, usize count, f64 low, f64 high,
+                      u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  simd_kernels()->between_f64(values, count, low, high, out_bits);
+}
+
+void simd_in_i32(const i32 *values, usize count, const i32 *set,
+                 usize set_count, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  ASSERT(set || set_count == 0);
+  simd_kernels()->in_i32(values, count, set, set_count, out_bits);
+}
+
+void simd_in_i64(const i64 *values, usize count, const i64 *set,
+                 usize set_count, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  ASSERT(set || set_count == 0);
+  simd_kernels()->in_i64(values, count, set, set_count, out_bits);
+}
+
+void simd_in_f64(const f64 *values, usize count, const f64 *set,
+                 usize set_count, u64 *out_bits) {
+  ASSERT((values && out_bits) || count == 0);
+  ASSERT(set || set_count == 0);
+  simd_kernels()->in_f64(values, count, set, set_count, out_bits);
+}
+
+// --- Aggregates ---
+
+i64 simd_sum_i32(const i32 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->sum_i32(values, count, bits);
+}
+
+i64 simd_sum_i64(const i64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->sum_i64(values, count, bits);
+}
+
+f64 simd_sum_f64(const f64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->sum_f64(values, count, bits);
+}
+
+i32 simd_min_i32(const i32 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->min_i32(values, count, bits);
+}
+
+i64 simd_min_i64(const i64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->min_i64(values, count, bits);
+}
+
+f64 simd_min_f64(const f64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->min_f64(values, count, bits);
+}
+
+i32 simd_max_i32(const i32 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->max_i32(values, count, bits);
+}
+
+i64 simd_max_i64(const i64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->max_i64(values, count, bits);
+}
+
+f64 simd_max_f64(const f64 *values, usize count, const u64 *bits) {
+  ASSERT(values || count == 0);
+  return simd_kernels()->max_f64(values, count, bits);
+}
+
+// --- Bitmaps ---
+
+usize simd_bitmap_count(const u64 *bits, usize count) {
+  ASSERT(bits || count == 0);
+  return simd_kernels()->bitmap_count(bits, count);
+}
+
+void simd_bitmap_and(u64 *dst, const u64 *src, usize count) {
+  ASSERT((dst && src) || count == 0);
+  for (usize w = 0; w < SIMD_BITMAP_WORDS(count); ++w) {
+    dst[w] &= src[w];
+  }
+}
+
+void simd_bitmap_or(u64 *dst, const u64 *src, usize count) {
+  ASSERT((dst && src) || count == 0);
+  for (usize w = 0; w < SIMD_BITMAP_WORDS(count); ++w) {
+    dst[w] |= src[w];
+  }
+}
+
+u32 simd_bitmap_to_selection(const u64 *bits, usize count, u32 *out) {
+  ASSERT((bits && out) || count == 0);
+  ASSERT(count <= UINT32_MAX);
+  u32 n = 0;
+  for (usize w = 0; w < SIMD_BITMAP_WORDS(count); ++w) {
+    u64 word = bits[w];
+    u32 base = (u32)(w * 64);
+    while (word != 0) {
+      out[n++] = base + (u32)__builtin_ctzll(word);
+      word &= word - 1;
+    }
+  }
+  return n;
+}
+
+// =================================================================================================
+// :: Private Helper Functions ::
+// =================================================================================================
+
+static const SimdKernels *simd_kernels(void) {
+  const SimdKernels *kernels =
+      __atomic_load_n(&g_simd_kernels, __ATOMIC_ACQUIRE);
+  if (!kernels) {
+    // Racing threads all pick the same table.
+    kernels = simd_kernels_for_level(simd_detect_level());
+    __atomic_store_n(&g_simd_kernels, kernels, __ATOMIC_RELEASE);
+  }
+  return kernels;
+}
+
+static const SimdKernels *simd_kernels_for_level(SimdLevel level) {
+#if SIMD_HAS_X86
+  switch (level) {
+  case SIMD_LEVEL_AVX2:
+    return &g_avx2_kernels;
+  case SIMD_LEVEL_SSE42:
+    return &g_sse42_kernels;
+  default:
+    break;
+  }
+#else
+  (void)level;
+#endif
+  return &g_scalar_kernels;
+}
+
+// Integer comparisons are built from = and >; NOT EQUAL, LESS EQUAL and
+// GREATER EQUAL are the complement of the other three.
+static u64 simd_invert_mask(SimdCompare op) {
+  return op == SIMD_CMP_NOT_EQUAL || op == SIMD_CMP_LESS_EQUAL ||
+                 op == SIMD_CMP_GREATER_EQUAL
+             ? ~0ULL
+             : 0;
+}
+
+// --- Scalar kernels ---
+
+// Sets bit j of each output word when 'cond' holds for 'value', the value at
+// that position.
+#define SCALAR_SELECT(T, values, count, out_bits, cond)                        \
+  do {                                                                         \
+    for (usize w_ = 0; w_ < SIMD_BITMAP_WORDS(count); ++w_) {                  \
+      const T *p_ = (values) + w_ * 64;                                        \
+      usize n_ = MIN((count) - w_ * 64, (usize)64);                            \
+      u64 word_ = 0;                                                           \
+      for (usize j_ = 0; j_ < n_; ++j_) {                                      \
+        T value = p_[j_];                                                      \
+        word_ |= (u64)(cond) << j_;                                            \
+      }                                                                        \
+      (out_bits)[w_] = word_;                                                  \
+    }                                                                          \
+  } while (0)
+
+#define SCALAR_COMPARE(T, values, count, op, constant, out_bits)               \
+  switch (op) {                                                                \
+  case SIMD_CMP_EQUAL:                                                         \
+    SCALAR_SELECT(T, values, count, out_bits, value == (constant));            \
+    break;                                                                     \
+  case SIMD_CMP_NOT_EQUAL:                                                     \
+    SCALAR_SELECT(T, values, count, out_bits, value != (constant));            \
+    break;                                                                     \
+  case SIMD_CMP_LESS:                                                          \
+    SCALAR_SELECT(T, values, count, out_bits, value < (constant));             \
+    break;                                                                     \
+  case SIMD_CMP_LESS_EQUAL:                                                    \
+    SCALAR_SELECT(T, values, count, out_bits, value <= (constant));            \
+    break;                                                                     \
+  case SIMD_CMP_GREATER:                                                       \
+    SCALAR_SELECT(T, values, count, out_bits, value > (constant));             \
+    break;                                                                     \
+  case SIMD_CMP_GREATER_EQUAL:                                                 \
+    SCALAR_SELECT(T, values, count, out_bits, value >= (constant));            \
+    break;                                                                     \
+  }
+
+#define SCALAR_IN(T, values, count, set, set_count, out_bits)                  \
+  do {                                                                         \
+    for (usize w_ = 0; w_ < SIMD_BITMAP_WORDS(count); ++w_) {                  \
+      const T *p_ = (values) + w_ * 64;                                        \
+      usize n_ = MIN((count) - w_ * 64, (usize)64);                            \
+      u64 word_ = 0;                                                           \
+      for (usize j_ = 0; j_ < n_; ++j_) {                                      \
+        bool found_ = false;                                                   \
+        for (usize k_ = 0; k_ < (set_count); ++k_) {                           \
+          found_ |= p_[j_] == (set)[k_];                                       \
+        }                                                                      \
+        word_ |= (u64)found_ << j_;                                            \
+      }                                                                        \
+      (out_bits)[w_] = word_;                                                  \
+    }                                                                          \
+  } while (0)
+
+// Runs the statements after 'bits' with 'value' bound to each selected value.
+#define SCALAR_FOR_EACH_SELECTED(T, values, count, bits, ...)                  \
+  do {                                                                         \
+    if (!(bits)) {                                                             \
+      for (usize i_ = 0; i_ < (count); ++i_) {                                 \
+        T value = (values)[i_];                                                \
+        __VA_ARGS__;                                                           \
+      }                                                                        \
+      break;                                                                   \
+    }                                                                          \
+    for (usize w_ = 0; w_ < SIMD_BITMAP_WORDS(count); ++w_) {                  \
+      u64 word_ = (bits)[w_];                                                  \
+      while (word_ != 0) {                                                     \
+        T value = (values)[w_ * 64 + (usize)__builtin_ctzll(word_)];           \
+        word_ &= word_ - 1;                                                    \
+        __VA_ARGS__;                                                           \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+static void select_i32_scalar(const i32 *values, usize count, SimdCompare op,
+                              i32 constant, u64 *out_bits) {
+  SCALAR_COMPARE(i32, values, count, op, constant, out_bits);
+}
+
+static void select_i64_scalar(const i64 *values, usize count, SimdCompare op,
+                              i64 constant, u64 *out_bits) {
+  SCALAR_COMPARE(i64, values, count, op, constant, out_bits);
+}
+
+static void select_f64_scalar(const f64 *values, usize count, SimdCompare op,
+                              f64 constant, u64 *out_bits) {
+  SCALAR_COMPARE(f64, values, count, op, constant, out_bits);
+}
+
+static void between_i32_scalar(const i32 *values, usize count, i32 low,
+                               i32 high, u64 *out_bits) {
+  SCALAR_SELECT(i32, values, count, out_bits, (value >= low) & (value <= high));
+}
+
+static void between_i64_scalar(const i64 *values, usize count, i64 low,
+                               i64 high, u64 *out_bits) {
+  SCALAR_SELECT(i64, values, count, out_bits, (value >= low) & (value <= high));
+}
+
+static void between_f64_scalar(const f64 *values, usize count, f64 low,
+                               f64 high, u64 *out_bits) {
+  SCALAR_SELECT(f64, values, count, out_bits, (value >= low) & (value <= high));
+}
+
+static void in_i32_scalar(const i32 *values, usize count, const i32 *set,
+                          usize set_count, u64 *out_bits) {
+  SCALAR_IN(i32, values, count, set, set_count, out_bits);
+}
+
+static void in_i64_scalar(const i64 *values, usize count, const i64 *set,
+                          usize set_count, u64 *out_bits) {
+  SCALAR_IN(i64, values, count, set, set_count, out_bits);
+}
+
+static void in_f64_scalar(const f64 *values, usize count, const f64 *set,
+                          usize set_count, u64 *out_bits) {
+  SCALAR_IN(f64, values, count, set, set_count, out_bits);
+}
+
+static i64 sum_i32_scalar(const i32 *values, usize count, const u64 *bits) {
+  u64 sum = 0;
+  SCALAR_FOR_EACH_SELECTED(i32, values, count, bits, sum += (u64)(i64)value);
+  return (i64)sum;
+}
+
+static i64 sum_i64_scalar(const i64 *values, usize count, const u64 *bits) {
+  u64 sum = 0;
+  SCALAR_FOR_EACH_SELECTED(i64, values, count, bits, sum += (u64)value);
+  return (i64)sum;
+}
+
+static f64 sum_f64_scalar(const f64 *values, usize count, const u64 *bits) {
+  f64 sum = 0.0;
+  SCALAR_FOR_EACH_SELECTED(f64, values, count, bits, sum += value);
+  return sum;
+}
+
+static i32 min_i32_scalar(const i32 *values, usize count, const u64 *bits) {
+  i32 result = INT32_MAX;
+  SCALAR_FOR_EACH_SELECTED(i32, values, count, bits,
+                           result = value < result ? value : result);
+  return result;
+}
+
+static i64 min_i64_scalar(const i64 *values, usize count, const u64 *bits) {
+  i64 result = INT64_MAX;
+  SCALAR_FOR_EACH_SELECTED(i64, values, count, bits,
+                           result = value < result ? value : result);
+  return result;
+}
+
+static f64 min_f64_scalar(const f64 *values, usize count, const u64 *bits) {
+  f64 result = INFINITY;
+  SCALAR_FOR_EACH_SELECTED(f64, values, count, bits,
+                           result = value < result ? value : result);
+  return result;
+}
+
+static i32 max_i32_scalar(const i32 *values, usize count, const u64 *bits) {
+  i32 result = INT32_MIN;
+  SCALAR_FOR_EACH_SELECTED(i32, values, count, bits,
+                           result = value > result ? value : result);
+  return result;
+}
+
+static i64 max_i64_scalar(const i64 *values, usize count, const u64 *bits) {
+  i64 result = INT64_MIN;
+  SCALAR_FOR_EACH_SELECTED(i64, values, count, bits,
+                           result = value > result ? value : result);
+  return result;
+}
+
+static f64 max_f64_scalar(const f64 *values, usize count, const u64 *bits) {
+  f64 result = -INFINITY;
+  SCALAR_FOR_EACH_SELECTED(f64, values, count, bits,
+                           result = value > result ? value : result);
+  return result;
+}
+
+static usize bitmap_count_scalar(const u64 *bits, usize count) {
+  usize n = 0;
+  for (usize w = 0; w < SIMD_BITMAP_WORDS(count); ++w) {
+    n += (usize)__builtin_popcountll(bits[w]);
+  }
+  return n;
+}
+
+static const SimdKernels g_scalar_kernels = {
+    SIMD_LEVEL_SCALAR,  select_i32_scalar,  select_i64_scalar,
+    select_f64_scalar,  between_i32_scalar, between_i64_scalar,
+    between_f64_scalar, in_i32_scalar,      in_i64_scalar,
+    in_f64_scalar,      sum_i32_scalar,     sum_i64_scalar,
+    sum_f64_scalar,     min_i32_scalar,     min_i64_scalar,
+    min_f64_scalar,     max_i32_scalar,     max_i64_scalar,
+    max_f64_scalar,     bitmap_count_scalar,
+};
+
+#if SIMD_HAS_X86
+
+// --- Shared vector loops ---
+
+// Byte i of entry b is 0xFF when bit i of b is set. Masked folds widen these
+// into lane masks with one sign-extending load instead of building them from
+// the bitmap word lane by lane.
+#define LANE_MASK(b)                                                           \
+  (((b)&0x01 ? 0xFFULL : 0) | ((b)&0x02 ? 0xFF00ULL : 0) |                     \
+   ((b)&0x04 ? 0xFF0000ULL : 0) | ((b)&0x08 ? 0xFF000000ULL : 0) |             \
+   ((b)&0x10 ? 0xFF00000000ULL : 0) | ((b)&0x20 ? 0xFF0000000000ULL : 0) |     \
+   ((b)&0x40 ? 0xFF000000000000ULL : 0) |                                      \
+   ((b)&0x80 ? 0xFF00000000000000ULL : 0))
+#define LANE_MASKS_4(b)                                                        \
+  LANE_MASK(b), LANE_MASK((b) + 1), LANE_MASK((b) + 2), LANE_MASK((b) + 3)
+#define LANE_MASKS_16(b)                                                       \
+  LANE_MASKS_4(b), LANE_MASKS_4((b) + 4), LANE_MASKS_4((b) + 8),               \
+      LANE_MASKS_4((b) + 12)
+#define LANE_MASKS_64(b)                                                       \
+  LANE_MASKS_16(b), LANE_MASKS_16((b) + 16), LANE_MASKS_16((b) + 32),          \
+      LANE_MASKS_16((b) + 48)
+
+static const u64 g_lane_masks[256] = {LANE_MASKS_64(0), LANE_MASKS_64(64),
+                                      LANE_MASKS_64(128), LANE_MASKS_64(192)};
+
+
+// Vector kernels cover the full 64-value words of the input and hand the
+// remaining values, with their part of the bitmap, to the scalar kernel.
+
+// Builds every full output word from 64 / 'lanes' vector comparisons;
+// 'mask_bits' computes the movemask of the 'lanes' values at 'p'.
+#define SIMD_BITMAP_LOOP(T, values, count, out_bits, lanes, invert, mask_bits) \
+  for (usize w_ = 0; w_ < (count) / 64; ++w_) {                                \
+    const T *p = (values) + w_ * 64;                                           \
+    u64 word_ = 0;                                                             \
+    for (u32 j_ = 0; j_ < 64; j_ += (lanes), p += (lanes)) {                   \
+      word_ |= (u64)(u32)(mask_bits) << j_;                                    \
+    }                                                                          \
+    (out_bits)[w_] = word_ ^ (invert);                                         \
+  }
+
+// Folds every full word of values: 'dense' when the whole word is selected,
+// 'masked' (with the word's bits for 'p' in the low bits of 'lane_bits')
+// when only part of it is. Unselected words are skipped.
+#define SIMD_FOLD_LOOP(T, values, count, bits, lanes, dense, masked)           \
+  for (usize w_ = 0; w_ < (count) / 64; ++w_) {                                \
+    u64 word_ = (bits) ? (bits)[w_] : ~0ULL;                                   \
+    const T *p = (values) + w_ * 64;                                           \
+    if (word_ == ~0ULL) {                                                      \
+      for (u32 j_ = 0; j_ < 64; j_ += (lanes), p += (lanes)) {                 \
+        dense;                                                                 \
+      }                                                                        \
+    } else if (word_ != 0) {                                                   \
+      for (u32 j_ = 0; j_ < 64; j_ += (lanes), p += (lanes)) {                 \
+        u64 lane_bits = word_ >> j_;                                           \
+        masked;                                                                \
+      }                                                                        \
+    }                                                                          \
+  }
+
+#define SIMD_TAIL_START(count) ((count) / 64 * 64)
+#define SIMD_TAIL_BITS(bits, count) ((bits) ? (bits) + (count) / 64 : NULL)
+
+#define SIMD_SELECT_TAIL(kernel, values, count, out_bits, ...)                 \
+  do {                                                                         \
+    usize tail_ = SIMD_TAIL_START(count);                                      \
+    if (tail_ < (count)) {                                                     \
+      kernel((values) + tail_, (count) - tail_, __VA_ARGS__,                   \
+             (out_bits) + tail_ / 64);                                         \
+    }                                                                          \
+  } while (0)
+
+#define SIMD_FOLD_TAIL(kernel, values, count, bits)                            \
+  kernel((values) + SIMD_TAIL_START(count), (count) - SIMD_TAIL_START(count),  \
+         SIMD_TAIL_BITS(bits, count))
+
+// --- SSE4.2 kernels ---
+
+#define SSE_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define SSE_MOVEMASK_32(m) _mm_movemask_ps(_mm_castsi128_ps(m))
+#define SSE_MOVEMASK_64(m) _mm_movemask_pd(_mm_castsi128_pd(m))
+// Lane masks for the low bits of 'lane_bits', sign-extended from the byte
+// masks in g_lane_masks.
+#define LANE_MASK_BYTES(lane_bits, mask)                                       \
+  _mm_loadl_epi64((const __m128i *)&g_lane_masks[(lane_bits) & (mask)])
+#define SSE_LANES_32(lane_bits) _mm_cvtepi8_epi32(LANE_MASK_BYTES(lane_bits, 0xF))
+#define SSE_LANES_64(lane_bits) _mm_cvtepi8_epi64(LANE_MASK_BYTES(lane_bits, 0x3))
+
+SIMD_TARGET_SSE42 static void select_i32_sse42(const i32 *values, usize count,
+                                               SimdCompare op, i32 constant,
+                                               u64 *out_bits) {
+  __m128i c = _mm_set1_epi32(constant);
+  u64 invert = simd_invert_mask(op);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+  case SIMD_CMP_NOT_EQUAL:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 4, invert,
+                     SSE_MOVEMASK_32(_mm_cmpeq_epi32(SSE_LOAD(p), c)));
+    break;
+  case SIMD_CMP_LESS:
+  case SIMD_CMP_GREATER_EQUAL:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 4, invert,
+                     SSE_MOVEMASK_32(_mm_cmpgt_epi32(c, SSE_LOAD(p))));
+    break;
+  default:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 4, invert,
+                     SSE_MOVEMASK_32(_mm_cmpgt_epi32(SSE_LOAD(p), c)));
+    break;
+  }
+  SIMD_SELECT_TAIL(select_i32_scalar, values, count, out_bits, op, constant);
+}
+
+SIMD_TARGET_SSE42 static void select_i64_sse42(const i64 *values, usize count,
+                                               SimdCompare op, i64 constant,
+                                               u64 *out_bits) {
+  __m128i c = _mm_set1_epi64x(constant);
+  u64 invert = simd_invert_mask(op);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+  case SIMD_CMP_NOT_EQUAL:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 2, invert,
+                     SSE_MOVEMASK_64(_mm_cmpeq_epi64(SSE_LOAD(p), c)));
+    break;
+  case SIMD_CMP_LESS:
+  case SIMD_CMP_GREATER_EQUAL:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 2, invert,
+                     SSE_MOVEMASK_64(_mm_cmpgt_epi64(c, SSE_LOAD(p))));
+    break;
+  default:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 2, invert,
+                     SSE_MOVEMASK_64(_mm_cmpgt_epi64(SSE_LOAD(p), c)));
+    break;
+  }
+  SIMD_SELECT_TAIL(select_i64_scalar, values, count, out_bits, op, constant);
+}
+
+SIMD_TARGET_SSE42 static void select_f64_sse42(const f64 *values, usize count,
+                                               SimdCompare op, f64 constant,
+                                               u64 *out_bits) {
+  __m128d c = _mm_set1_pd(constant);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(p), c)));
+    break;
+  case SIMD_CMP_NOT_EQUAL:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmpneq_pd(_mm_loadu_pd(p), c)));
+    break;
+  case SIMD_CMP_LESS:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(p), c)));
+    break;
+  case SIMD_CMP_LESS_EQUAL:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmple_pd(_mm_loadu_pd(p), c)));
+    break;
+  case SIMD_CMP_GREATER:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(p), c)));
+    break;
+  case SIMD_CMP_GREATER_EQUAL:
+    SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                     _mm_movemask_pd(_mm_cmpge_pd(_mm_loadu_pd(p), c)));
+    break;
+  }
+  SIMD_SELECT_TAIL(select_f64_scalar, values, count, out_bits, op, constant);
+}
+
+// low <= v <= high is NOT (low > v OR v > high).
+SIMD_TARGET_SSE42 static void between_i32_sse42(const i32 *values,
+                                                usize count, i32 low, i32 high,
+                                                u64 *out_bits) {
+  __m128i lo = _mm_set1_epi32(low);
+  __m128i hi = _mm_set1_epi32(high);
+  SIMD_BITMAP_LOOP(i32, values, count, out_bits, 4, ~0ULL,
+                   SSE_MOVEMASK_32(_mm_or_si128(
+                       _mm_cmpgt_epi32(lo, SSE_LOAD(p)),
+                       _mm_cmpgt_epi32(SSE_LOAD(p), hi))));
+  SIMD_SELECT_TAIL(between_i32_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_SSE42 static void between_i64_sse42(const i64 *values,
+                                                usize count, i64 low, i64 high,
+                                                u64 *out_bits) {
+  __m128i lo = _mm_set1_epi64x(low);
+  __m128i hi = _mm_set1_epi64x(high);
+  SIMD_BITMAP_LOOP(i64, values, count, out_bits, 2, ~0ULL,
+                   SSE_MOVEMASK_64(_mm_or_si128(
+                       _mm_cmpgt_epi64(lo, SSE_LOAD(p)),
+                       _mm_cmpgt_epi64(SSE_LOAD(p), hi))));
+  SIMD_SELECT_TAIL(between_i64_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_SSE42 static void between_f64_sse42(const f64 *values,
+                                                usize count, f64 low, f64 high,
+                                                u64 *out_bits) {
+  __m128d lo = _mm_set1_pd(low);
+  __m128d hi = _mm_set1_pd(high);
+  SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                   _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(_mm_loadu_pd(p), lo),
+                                              _mm_cmple_pd(_mm_loadu_pd(p), hi))));
+  SIMD_SELECT_TAIL(between_f64_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_SSE42 static inline u32 in_mask_i32_sse42(const i32 *p,
+                                                      const i32 *set,
+                                                      usize set_count) {
+  __m128i v = SSE_LOAD(p);
+  __m128i m = _mm_setzero_si128();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(v, _mm_set1_epi32(set[k])));
+  }
+  return (u32)SSE_MOVEMASK_32(m);
+}
+
+SIMD_TARGET_SSE42 static inline u32 in_mask_i64_sse42(const i64 *p,
+                                                      const i64 *set,
+                                                      usize set_count) {
+  __m128i v = SSE_LOAD(p);
+  __m128i m = _mm_setzero_si128();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm_or_si128(m, _mm_cmpeq_epi64(v, _mm_set1_epi64x(set[k])));
+  }
+  return (u32)SSE_MOVEMASK_64(m);
+}
+
+SIMD_TARGET_SSE42 static inline u32 in_mask_f64_sse42(const f64 *p,
+                                                      const f64 *set,
+                                                      usize set_count) {
+  __m128d v = _mm_loadu_pd(p);
+  __m128d m = _mm_setzero_pd();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm_or_pd(m, _mm_cmpeq_pd(v, _mm_set1_pd(set[k])));
+  }
+  return (u32)_mm_movemask_pd(m);
+}
+
+SIMD_TARGET_SSE42 static void in_i32_sse42(const i32 *values, usize count,
+                                           const i32 *set, usize set_count,
+                                           u64 *out_bits) {
+  SIMD_BITMAP_LOOP(i32, values, count, out_bits, 4, 0,
+                   in_mask_i32_sse42(p, set, set_count));
+  SIMD_SELECT_TAIL(in_i32_scalar, values, count, out_bits, set, set_count);
+}
+
+SIMD_TARGET_SSE42 static void in_i64_sse42(const i64 *values, usize count,
+                                           const i64 *set, usize set_count,
+                                           u64 *out_bits) {
+  SIMD_BITMAP_LOOP(i64, values, count, out_bits, 2, 0,
+                   in_mask_i64_sse42(p, set, set_count));
+  SIMD_SELECT_TAIL(in_i64_scalar, values, count, out_bits, set, set_count);
+}
+
+SIMD_TARGET_SSE42 static void in_f64_sse42(const f64 *values, usize count,
+                                           const f64 *set, usize set_count,
+                                           u64 *out_bits) {
+  SIMD_BITMAP_LOOP(f64, values, count, out_bits, 2, 0,
+                   in_mask_f64_sse42(p, set, set_count));
+  SIMD_SELECT_TAIL(in_f64_scalar, values, count, out_bits, set, set_count);
+}
+
+SIMD_TARGET_SSE42 static i64 sum_i32_sse42(const i32 *values, usize count,
+                                           const u64 *bits) {
+  __m128i lo = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+  SIMD_FOLD_LOOP(
+      i32, values, count, bits, 4,
+      {
+        __m128i v = SSE_LOAD(p);
+        lo = _mm_add_epi64(lo, _mm_cvtepi32_epi64(v));
+        hi = _mm_add_epi64(hi, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+      },
+      {
+        __m128i v = _mm_and_si128(SSE_LOAD(p), SSE_LANES_32(lane_bits));
+        lo = _mm_add_epi64(lo, _mm_cvtepi32_epi64(v));
+        hi = _mm_add_epi64(hi, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+      });
+  i64 lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(lo, hi));
+  return (i64)((u64)lanes[0] + (u64)lanes[1] +
+               (u64)SIMD_FOLD_TAIL(sum_i32_scalar, values, count, bits));
+}
+
+SIMD_TARGET_SSE42 static i64 sum_i64_sse42(const i64 *values, usize count,
+                                           const u64 *bits) {
+  __m128i acc = _mm_setzero_si128();
+  SIMD_FOLD_LOOP(i64, values, count, bits, 2,
+                 acc = _mm_add_epi64(acc, SSE_LOAD(p)),
+                 acc = _mm_add_epi64(
+                     acc, _mm_and_si128(SSE_LOAD(p), SSE_LANES_64(lane_bits))));
+  i64 lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  return (i64)((u64)lanes[0] + (u64)lanes[1] +
+               (u64)SIMD_FOLD_TAIL(sum_i64_scalar, values, count, bits));
+}
+
+SIMD_TARGET_SSE42 static f64 sum_f64_sse42(const f64 *values, usize count,
+                                           const u64 *bits) {
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  SIMD_FOLD_LOOP(
+      f64, values, count, bits, 4,
+      {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(p));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(p + 2));
+      },
+      {
+        acc0 = _mm_add_pd(acc0, _mm_and_pd(_mm_loadu_pd(p),
+                                           _mm_castsi128_pd(
+                                               SSE_LANES_64(lane_bits))));
+        acc1 = _mm_add_pd(acc1, _mm_and_pd(_mm_loadu_pd(p + 2),
+                                           _mm_castsi128_pd(
+                                               SSE_LANES_64(lane_bits >> 2))));
+      });
+  f64 lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  return lanes[0] + lanes[1] +
+         SIMD_FOLD_TAIL(sum_f64_scalar, values, count, bits);
+}
+
+// MIN and MAX replace unselected lanes with the identity before folding.
+#define SSE_MIN_MAX_I32(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_SSE42 static i32 name(const i32 *values, usize count,            \
+                                    const u64 *bits) {                         \
+    __m128i id = _mm_set1_epi32(identity);                                     \
+    __m128i acc = id;                                                          \
+    SIMD_FOLD_LOOP(i32, values, count, bits, 4,                                \
+                   acc = fold(acc, SSE_LOAD(p)),                               \
+                   acc = fold(acc, _mm_blendv_epi8(id, SSE_LOAD(p),            \
+                                                   SSE_LANES_32(lane_bits)))); \
+    i32 lanes[4];                                                              \
+    _mm_storeu_si128((__m128i *)lanes, acc);                                   \
+    i32 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    for (u32 i = 0; i < 4; ++i) {                                              \
+      result = op(result, lanes[i]);                                           \
+    }                                                                          \
+    return result;                                                             \
+  }
+
+SSE_MIN_MAX_I32(min_i32_sse42, _mm_min_epi32, MIN, INT32_MAX, min_i32_scalar)
+SSE_MIN_MAX_I32(max_i32_sse42, _mm_max_epi32, MAX, INT32_MIN, max_i32_scalar)
+
+// There is no 64-bit integer min/max before AVX-512: compare and blend.
+SIMD_TARGET_SSE42 static inline __m128i sse_min_i64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b));
+}
+
+SIMD_TARGET_SSE42 static inline __m128i sse_max_i64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(b, a));
+}
+
+#define SSE_MIN_MAX_I64(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_SSE42 static i64 name(const i64 *values, usize count,            \
+                                    const u64 *bits) {                         \
+    __m128i id = _mm_set1_epi64x(identity);                                    \
+    __m128i acc0 = id;                                                         \
+    __m128i acc1 = id;                                                         \
+    SIMD_FOLD_LOOP(                                                            \
+        i64, values, count, bits, 4,                                           \
+        {                                                                      \
+          acc0 = fold(acc0, SSE_LOAD(p));                                      \
+          acc1 = fold(acc1, SSE_LOAD(p + 2));                                  \
+        },                                                                     \
+        {                                                                      \
+          acc0 = fold(acc0, _mm_blendv_epi8(id, SSE_LOAD(p),                   \
+                                            SSE_LANES_64(lane_bits)));         \
+          acc1 = fold(acc1, _mm_blendv_epi8(id, SSE_LOAD(p + 2),               \
+                                            SSE_LANES_64(lane_bits >> 2)));    \
+        });                                                                    \
+    i64 lanes[2];                                                              \
+    _mm_storeu_si128((__m128i *)lanes, fold(acc0, acc1));                      \
+    i64 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    result = op(result, lanes[0]);                                             \
+    return op(result, lanes[1]);                                               \
+  }
+
+SSE_MIN_MAX_I64(min_i64_sse42, sse_min_i64, MIN, INT64_MAX, min_i64_scalar)
+SSE_MIN_MAX_I64(max_i64_sse42, sse_max_i64, MAX, INT64_MIN, max_i64_scalar)
+
+// _mm_min_pd(v, acc) returns acc when v is NaN, which skips NaNs.
+#define SSE_MIN_MAX_F64(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_SSE42 static f64 name(const f64 *values, usize count,            \
+                                    const u64 *bits) {                         \
+    __m128d id = _mm_set1_pd(identity);                                        \
+    __m128d acc0 = id;                                                         \
+    __m128d acc1 = id;                                                         \
+    SIMD_FOLD_LOOP(                                                            \
+        f64, values, count, bits, 4,                                           \
+        {                                                                      \
+          acc0 = fold(_mm_loadu_pd(p), acc0);                                  \
+          acc1 = fold(_mm_loadu_pd(p + 2), acc1);                              \
+        },                                                                     \
+        {                                                                      \
+          acc0 = fold(_mm_blendv_pd(id, _mm_loadu_pd(p),                       \
+                                    _mm_castsi128_pd(SSE_LANES_64(lane_bits))), \
+                      acc0);                                                   \
+          acc1 = fold(_mm_blendv_pd(id, _mm_loadu_pd(p + 2),                   \
+                                    _mm_castsi128_pd(                          \
+                                        SSE_LANES_64(lane_bits >> 2))),        \
+                      acc1);                                                   \
+        });                                                                    \
+    f64 lanes[2];                                                              \
+    _mm_storeu_pd(lanes, fold(acc0, acc1));                                    \
+    f64 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    result = op(result, lanes[0]);                                             \
+    return op(result, lanes[1]);                                               \
+  }
+
+SSE_MIN_MAX_F64(min_f64_sse42, _mm_min_pd, MIN, INFINITY, min_f64_scalar)
+SSE_MIN_MAX_F64(max_f64_sse42, _mm_max_pd, MAX, -INFINITY, max_f64_scalar)
+
+SIMD_TARGET_SSE42 static usize bitmap_count_popcnt(const u64 *bits,
+                                                   usize count) {
+  usize n = 0;
+  for (usize w = 0; w < SIMD_BITMAP_WORDS(count); ++w) {
+    n += (usize)_mm_popcnt_u64(bits[w]);
+  }
+  return n;
+}
+
+static const SimdKernels g_sse42_kernels = {
+    SIMD_LEVEL_SSE42,  select_i32_sse42,  select_i64_sse42,
+    select_f64_sse42,  between_i32_sse42, between_i64_sse42,
+    between_f64_sse42, in_i32_sse42,      in_i64_sse42,
+    in_f64_sse42,      sum_i32_sse42,     sum_i64_sse42,
+    sum_f64_sse42,     min_i32_sse42,     min_i64_sse42,
+    min_f64_sse42,     max_i32_sse42,     max_i64_sse42,
+    max_f64_sse42,     bitmap_count_popcnt,
+};
+
+// --- AVX2 kernels ---
+
+#define AVX_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX_MOVEMASK_32(m) _mm256_movemask_ps(_mm256_castsi256_ps(m))
+#define AVX_MOVEMASK_64(m) _mm256_movemask_pd(_mm256_castsi256_pd(m))
+#define AVX_LANES_32(lane_bits)                                                \
+  _mm256_cvtepi8_epi32(LANE_MASK_BYTES(lane_bits, 0xFF))
+#define AVX_LANES_64(lane_bits)                                                \
+  _mm256_cvtepi8_epi64(LANE_MASK_BYTES(lane_bits, 0xF))
+
+SIMD_TARGET_AVX2 static void select_i32_avx2(const i32 *values, usize count,
+                                             SimdCompare op, i32 constant,
+                                             u64 *out_bits) {
+  __m256i c = _mm256_set1_epi32(constant);
+  u64 invert = simd_invert_mask(op);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+  case SIMD_CMP_NOT_EQUAL:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 8, invert,
+                     AVX_MOVEMASK_32(_mm256_cmpeq_epi32(AVX_LOAD(p), c)));
+    break;
+  case SIMD_CMP_LESS:
+  case SIMD_CMP_GREATER_EQUAL:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 8, invert,
+                     AVX_MOVEMASK_32(_mm256_cmpgt_epi32(c, AVX_LOAD(p))));
+    break;
+  default:
+    SIMD_BITMAP_LOOP(i32, values, count, out_bits, 8, invert,
+                     AVX_MOVEMASK_32(_mm256_cmpgt_epi32(AVX_LOAD(p), c)));
+    break;
+  }
+  SIMD_SELECT_TAIL(select_i32_scalar, values, count, out_bits, op, constant);
+}
+
+SIMD_TARGET_AVX2 static void select_i64_avx2(const i64 *values, usize count,
+                                             SimdCompare op, i64 constant,
+                                             u64 *out_bits) {
+  __m256i c = _mm256_set1_epi64x(constant);
+  u64 invert = simd_invert_mask(op);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+  case SIMD_CMP_NOT_EQUAL:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 4, invert,
+                     AVX_MOVEMASK_64(_mm256_cmpeq_epi64(AVX_LOAD(p), c)));
+    break;
+  case SIMD_CMP_LESS:
+  case SIMD_CMP_GREATER_EQUAL:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 4, invert,
+                     AVX_MOVEMASK_64(_mm256_cmpgt_epi64(c, AVX_LOAD(p))));
+    break;
+  default:
+    SIMD_BITMAP_LOOP(i64, values, count, out_bits, 4, invert,
+                     AVX_MOVEMASK_64(_mm256_cmpgt_epi64(AVX_LOAD(p), c)));
+    break;
+  }
+  SIMD_SELECT_TAIL(select_i64_scalar, values, count, out_bits, op, constant);
+}
+
+#define AVX_SELECT_F64(predicate)                                              \
+  SIMD_BITMAP_LOOP(f64, values, count, out_bits, 4, 0,                         \
+                   _mm256_movemask_pd(                                         \
+                       _mm256_cmp_pd(_mm256_loadu_pd(p), c, predicate)))
+
+SIMD_TARGET_AVX2 static void select_f64_avx2(const f64 *values, usize count,
+                                             SimdCompare op, f64 constant,
+                                             u64 *out_bits) {
+  __m256d c = _mm256_set1_pd(constant);
+  switch (op) {
+  case SIMD_CMP_EQUAL:
+    AVX_SELECT_F64(_CMP_EQ_OQ);
+    break;
+  case SIMD_CMP_NOT_EQUAL:
+    AVX_SELECT_F64(_CMP_NEQ_UQ);
+    break;
+  case SIMD_CMP_LESS:
+    AVX_SELECT_F64(_CMP_LT_OQ);
+    break;
+  case SIMD_CMP_LESS_EQUAL:
+    AVX_SELECT_F64(_CMP_LE_OQ);
+    break;
+  case SIMD_CMP_GREATER:
+    AVX_SELECT_F64(_CMP_GT_OQ);
+    break;
+  case SIMD_CMP_GREATER_EQUAL:
+    AVX_SELECT_F64(_CMP_GE_OQ);
+    break;
+  }
+  SIMD_SELECT_TAIL(select_f64_scalar, values, count, out_bits, op, constant);
+}
+
+SIMD_TARGET_AVX2 static void between_i32_avx2(const i32 *values, usize count,
+                                              i32 low, i32 high,
+                                              u64 *out_bits) {
+  __m256i lo = _mm256_set1_epi32(low);
+  __m256i hi = _mm256_set1_epi32(high);
+  SIMD_BITMAP_LOOP(i32, values, count, out_bits, 8, ~0ULL,
+                   AVX_MOVEMASK_32(_mm256_or_si256(
+                       _mm256_cmpgt_epi32(lo, AVX_LOAD(p)),
+                       _mm256_cmpgt_epi32(AVX_LOAD(p), hi))));
+  SIMD_SELECT_TAIL(between_i32_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_AVX2 static void between_i64_avx2(const i64 *values, usize count,
+                                              i64 low, i64 high,
+                                              u64 *out_bits) {
+  __m256i lo = _mm256_set1_epi64x(low);
+  __m256i hi = _mm256_set1_epi64x(high);
+  SIMD_BITMAP_LOOP(i64, values, count, out_bits, 4, ~0ULL,
+                   AVX_MOVEMASK_64(_mm256_or_si256(
+                       _mm256_cmpgt_epi64(lo, AVX_LOAD(p)),
+                       _mm256_cmpgt_epi64(AVX_LOAD(p), hi))));
+  SIMD_SELECT_TAIL(between_i64_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_AVX2 static void between_f64_avx2(const f64 *values, usize count,
+                                              f64 low, f64 high,
+                                              u64 *out_bits) {
+  __m256d lo = _mm256_set1_pd(low);
+  __m256d hi = _mm256_set1_pd(high);
+  SIMD_BITMAP_LOOP(
+      f64, values, count, out_bits, 4, 0,
+      _mm256_movemask_pd(
+          _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(p), lo, _CMP_GE_OQ),
+                        _mm256_cmp_pd(_mm256_loadu_pd(p), hi, _CMP_LE_OQ))));
+  SIMD_SELECT_TAIL(between_f64_scalar, values, count, out_bits, low, high);
+}
+
+SIMD_TARGET_AVX2 static inline u32 in_mask_i32_avx2(const i32 *p,
+                                                    const i32 *set,
+                                                    usize set_count) {
+  __m256i v = AVX_LOAD(p);
+  __m256i m = _mm256_setzero_si256();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi32(v, _mm256_set1_epi32(set[k])));
+  }
+  return (u32)AVX_MOVEMASK_32(m);
+}
+
+SIMD_TARGET_AVX2 static inline u32 in_mask_i64_avx2(const i64 *p,
+                                                    const i64 *set,
+                                                    usize set_count) {
+  __m256i v = AVX_LOAD(p);
+  __m256i m = _mm256_setzero_si256();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(set[k])));
+  }
+  return (u32)AVX_MOVEMASK_64(m);
+}
+
+SIMD_TARGET_AVX2 static inline u32 in_mask_f64_avx2(const f64 *p,
+                                                    const f64 *set,
+                                                    usize set_count) {
+  __m256d v = _mm256_loadu_pd(p);
+  __m256d m = _mm256_setzero_pd();
+  for (usize k = 0; k < set_count; ++k) {
+    m = _mm256_or_pd(
+        m, _mm256_cmp_pd(v, _mm256_set1_pd(set[k]), _CMP_EQ_OQ));
+  }
+  return (u32)_mm256_movemask_pd(m);
+}
+
+SIMD_TARGET_AVX2 static void in_i32_avx2(const i32 *values, usize count,
+                                         const i32 *set, usize set_count,
+                                         u64 *out_bits) {
+  SIMD_BITMAP_LOOP(i32, values, count, out_bits, 8, 0,
+                   in_mask_i32_avx2(p, set, set_count));
+  SIMD_SELECT_TAIL(in_i32_scalar, values, count, out_bits, set, set_count);
+}
+
+SIMD_TARGET_AVX2 static void in_i64_avx2(const i64 *values, usize count,
+                                         const i64 *set, usize set_count,
+                                         u64 *out_bits) {
+  SIMD_BITMAP_LOOP(i64, values, count, out_bits, 4, 0,
+                   in_mask_i64_avx2(p, set, set_count));
+  SIMD_SELECT_TAIL(in_i64_scalar, values, count, out_bits, set, set_count);
+}
+
+SIMD_TARGET_AVX2 static void in_f64_avx2(const f64 *values, usize count,
+                                         const f64 *set, usize set_count,
+                                         u64 *out_bits) {
+  SIMD_BITMAP_LOOP(f64, values, count, out_bits, 4, 0,
+                   in_mask_f64_avx2(p, set, set_count));
+  SIMD_SELECT_TAIL(in_f64_scalar, values, count, out_bits, set, set_count);
+}
+
+// Adds the eight i32 lanes of 'v', widened to i64, into 'acc'.
+SIMD_TARGET_AVX2 static inline __m256i avx_add_widened(__m256i acc,
+                                                       __m256i v) {
+  acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+  return _mm256_add_epi64(acc,
+                          _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+}
+
+SIMD_TARGET_AVX2 static inline i64 avx_reduce_add_i64(__m256i acc) {
+  i64 lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, acc);
+  return (i64)((u64)lanes[0] + (u64)lanes[1] + (u64)lanes[2] + (u64)lanes[3]);
+}
+
+SIMD_TARGET_AVX2 static i64 sum_i32_avx2(const i32 *values, usize count,
+                                         const u64 *bits) {
+  __m256i acc = _mm256_setzero_si256();
+  SIMD_FOLD_LOOP(i32, values, count, bits, 8,
+                 acc = avx_add_widened(acc, AVX_LOAD(p)),
+                 acc = avx_add_widened(acc,
+                                       _mm256_and_si256(AVX_LOAD(p),
+                                                        AVX_LANES_32(
+                                                            lane_bits))));
+  return (i64)((u64)avx_reduce_add_i64(acc) +
+               (u64)SIMD_FOLD_TAIL(sum_i32_scalar, values, count, bits));
+}
+
+SIMD_TARGET_AVX2 static i64 sum_i64_avx2(const i64 *values, usize count,
+                                         const u64 *bits) {
+  __m256i acc = _mm256_setzero_si256();
+  SIMD_FOLD_LOOP(i64, values, count, bits, 4,
+                 acc = _mm256_add_epi64(acc, AVX_LOAD(p)),
+                 acc = _mm256_add_epi64(
+                     acc, _mm256_and_si256(AVX_LOAD(p),
+                                           AVX_LANES_64(lane_bits))));
+  return (i64)((u64)avx_reduce_add_i64(acc) +
+               (u64)SIMD_FOLD_TAIL(sum_i64_scalar, values, count, bits));
+}
+
+// Two accumulators hide the latency of the float adds.
+SIMD_TARGET_AVX2 static f64 sum_f64_avx2(const f64 *values, usize count,
+                                         const u64 *bits) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  SIMD_FOLD_LOOP(
+      f64, values, count, bits, 8,
+      {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(p));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(p + 4));
+      },
+      {
+        acc0 = _mm256_add_pd(
+            acc0, _mm256_and_pd(_mm256_loadu_pd(p),
+                                _mm256_castsi256_pd(AVX_LANES_64(lane_bits))));
+        acc1 = _mm256_add_pd(
+            acc1,
+            _mm256_and_pd(_mm256_loadu_pd(p + 4),
+                          _mm256_castsi256_pd(AVX_LANES_64(lane_bits >> 4))));
+      });
+  f64 lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+         SIMD_FOLD_TAIL(sum_f64_scalar, values, count, bits);
+}
+
+#define AVX_MIN_MAX_I32(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_AVX2 static i32 name(const i32 *values, usize count,             \
+                                   const u64 *bits) {                          \
+    __m256i id = _mm256_set1_epi32(identity);                                  \
+    __m256i acc = id;                                                          \
+    SIMD_FOLD_LOOP(i32, values, count, bits, 8,                                \
+                   acc = fold(acc, AVX_LOAD(p)),                               \
+                   acc = fold(acc,                                             \
+                              _mm256_blendv_epi8(id, AVX_LOAD(p),              \
+                                                 AVX_LANES_32(lane_bits))));   \
+    i32 lanes[8];                                                              \
+    _mm256_storeu_si256((__m256i *)lanes, acc);                                \
+    i32 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    for (u32 i = 0; i < 8; ++i) {                                              \
+      result = op(result, lanes[i]);                                           \
+    }                                                                          \
+    return result;                                                             \
+  }
+
+AVX_MIN_MAX_I32(min_i32_avx2, _mm256_min_epi32, MIN, INT32_MAX, min_i32_scalar)
+AVX_MIN_MAX_I32(max_i32_avx2, _mm256_max_epi32, MAX, INT32_MIN, max_i32_scalar)
+
+SIMD_TARGET_AVX2 static inline __m256i avx_min_i64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+SIMD_TARGET_AVX2 static inline __m256i avx_max_i64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a));
+}
+
+#define AVX_MIN_MAX_I64(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_AVX2 static i64 name(const i64 *values, usize count,             \
+                                   const u64 *bits) {                          \
+    __m256i id = _mm256_set1_epi64x(identity);                                 \
+    __m256i acc0 = id;                                                         \
+    __m256i acc1 = id;                                                         \
+    SIMD_FOLD_LOOP(                                                            \
+        i64, values, count, bits, 8,                                           \
+        {                                                                      \
+          acc0 = fold(acc0, AVX_LOAD(p));                                      \
+          acc1 = fold(acc1, AVX_LOAD(p + 4));                                  \
+        },                                                                     \
+        {                                                                      \
+          acc0 = fold(acc0, _mm256_blendv_epi8(id, AVX_LOAD(p),                \
+                                               AVX_LANES_64(lane_bits)));      \
+          acc1 = fold(acc1, _mm256_blendv_epi8(id, AVX_LOAD(p + 4),            \
+                                               AVX_LANES_64(lane_bits >> 4))); \
+        });                                                                    \
+    i64 lanes[4];                                                              \
+    _mm256_storeu_si256((__m256i *)lanes, fold(acc0, acc1));                   \
+    i64 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    for (u32 i = 0; i < 4; ++i) {                                              \
+      result = op(result, lanes[i]);                                           \
+    }                                                                          \
+    return result;                                                             \
+  }
+
+AVX_MIN_MAX_I64(min_i64_avx2, avx_min_i64, MIN, INT64_MAX, min_i64_scalar)
+AVX_MIN_MAX_I64(max_i64_avx2, avx_max_i64, MAX, INT64_MIN, max_i64_scalar)
+
+#define AVX_MIN_MAX_F64(name, fold, op, identity, scalar)                      \
+  SIMD_TARGET_AVX2 static f64 name(const f64 *values, usize count,             \
+                                   const u64 *bits) {                          \
+    __m256d id = _mm256_set1_pd(identity);                                     \
+    __m256d acc0 = id;                                                         \
+    __m256d acc1 = id;                                                         \
+    SIMD_FOLD_LOOP(                                                            \
+        f64, values, count, bits, 8,                                           \
+        {                                                                      \
+          acc0 = fold(_mm256_loadu_pd(p), acc0);                               \
+          acc1 = fold(_mm256_loadu_pd(p + 4), acc1);                           \
+        },                                                                     \
+        {                                                                      \
+          acc0 = fold(_mm256_blendv_pd(id, _mm256_loadu_pd(p),                 \
+                                       _mm256_castsi256_pd(                    \
+                                           AVX_LANES_64(lane_bits))),          \
+                      acc0);                                                   \
+          acc1 = fold(_mm256_blendv_pd(id, _mm256_loadu_pd(p + 4),             \
+                                       _mm256_castsi256_pd(                    \
+                                           AVX_LANES_64(lane_bits >> 4))),     \
+                      acc1);                                                   \
+        });                                                                    \
+    f64 lanes[4];                                                              \
+    _mm256_storeu_pd(lanes, fold(acc0, acc1));                                 \
+    f64 result = scalar(values + SIMD_TAIL_START(count),                       \
+                        count - SIMD_TAIL_START(count),                        \
+                        SIMD_TAIL_BITS(bits, count));                          \
+    for (u32 i = 0; i < 4; ++i) {                                              \
+      result = op(result, lanes[i]);                                           \
+    }                                                                          \
+    return result;                                                             \
+  }
+
+AVX_MIN_MAX_F64(min_f64_avx2, _mm256_min_pd, MIN, INFINITY, min_f64_scalar)
+AVX_MIN_MAX_F64(max_f64_avx2, _mm256_max_pd, MAX, -INFINITY, max_f64_scalar)
+
+static const SimdKernels g_avx2_kernels = {
+    SIMD_LEVEL_AVX2,  select_i32_avx2,  select_i64_avx2,
+    select_f64_avx2,  between_i32_avx2, between_i64_avx2,
+    between_f64_avx2, in_i32_avx2,      in_i64_avx2,
+    in_f64_avx2,      sum_i32_avx2,     sum_i64_avx2,
+    sum_f64_avx2,     min_i32_avx2,     min_i64_avx2,
+    min_f64_avx2,     max_i32_avx2,     max_i64_avx2,
+    max_f64_avx2,     bitmap_count_popcnt,
+};
+
+#endif // SIMD_HAS_X86
@@ -0,0 +1,704 @@
+#ifndef SQLDB_TEST_PG_REPLAY_H
+#define SQLDB_TEST_PG_REPLAY_H
+
+// Replays PostgreSQL protocol transcripts against a server and checks every
+// reply byte for byte, standing in for a PostgreSQL client library. The
+// built-in transcripts walk through startup, the simple and extended query
+// protocols, errors, result streaming and native clients on the same port.
+// Shared by tools/pg_replay.c and tests/integration/test_pg_wire.c; define
+// BASE_IMPLEMENTATION in exactly one translation unit before including it.
+// It stays a header rather than a .c file because each tool is built from a
+// single source, and the test drives the connection helpers directly; all of
+// it is static so each includer gets a private copy.
+//
+// Transcript lines:
+//   == name          Starts a scenario on a new connection
+//   > T fields       Sends a message of type T (its length is filled in)
+//   > - fields       Sends an untyped startup packet with a length
+//   >raw fields      Sends the bytes as they are
+//   < T fields       Expects a message of type T with exactly this body;
+//                    a trailing * accepts any remaining bytes
+//   <* N T           Expects N messages of type T with any body
+//   <raw fields      Expects exactly these bytes
+//   <closed          Expects the server to close the connection
+//   # comment
+// Fields: "text" (with its NUL), t"text" (i32 length, then the bytes),
+// i8:/i16:/i32:/i64:N, c:X (one byte), x:HEX, null (i32 -1).
+
+#include "sqldb/network.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Transcripts ::
+// =================================================================================================
+
+#define STARTUP                                                                \
+  "> - i32:196608 \"user\" \"alice\" \"database\" \"shop\" "                   \
+  "\"application_name\" \"replay\" x:00\n"                                     \
+  "< R i32:0\n"                                                                \
+  "< S \"server_version\" \"14.0\"\n"                                          \
+  "<* 9 S\n"                                                                   \
+  "< K *\n"                                                                    \
+  "< Z c:I\n"
+
+// Field descriptions of a RowDescription column: name, type OID, length and
+// format.
+#define COLUMN(name, oid, length, format)                                      \
+  "\"" name "\" i32:0 i16:0 i32:" #oid " i16:" #length " i32:-1 i16:" #format
+
+static const char *g_default_transcript =
+    "== startup and terminate\n" STARTUP
+    "> Q \"SELECT current_database() AS db\"\n"
+    "< T i16:1 " COLUMN("db", 25, -1, 0) "\n"
+    "< D i16:1 t\"shop\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    "> X\n"
+    "<closed\n"
+
+    "== SSL request declined\n"
+    "> - i32:80877103\n"
+    "<raw c:N\n" STARTUP
+    "> Q \"SELECT 1\"\n"
+    "< T i16:1 " COLUMN("?column?", 20, 8, 0) "\n"
+    "< D i16:1 t\"1\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+
+    "== unsupported protocol version\n"
+    "> - i32:131072 \"user\" \"alice\" x:00\n"
+    "< E c:S \"FATAL\" c:V \"FATAL\" c:C \"0A000\" *\n"
+    "<closed\n"
+
+    "== simple query with several statements\n" STARTUP
+    "> Q \"SELECT 1 AS One, 'it''s' AS \\\"Str\\\"; SELECT 2.5 + 1, "
+    "true AND NULL IS NULL;\"\n"
+    "< T i16:2 " COLUMN("one", 20, 8, 0) " " COLUMN("Str", 25, -1, 0) "\n"
+    "< D i16:2 t\"1\" t\"it's\"\n"
+    "< C \"SELECT 1\"\n"
+    "< T i16:2 " COLUMN("?column?", 701, 8, 0) " " COLUMN("?column?", 16, 1,
+                                                           0) "\n"
+    "< D i16:2 t\"3.5\" t\"t\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    "> Q \"SELECT 0.1 + 0.2 AS f, 7 / 2 AS q, -7 % 3 AS r, NULL AS n\"\n"
+    "< T i16:4 " COLUMN("f", 701, 8, 0) " " COLUMN("q", 20, 8, 0) " " COLUMN(
+        "r", 20, 8, 0) " " COLUMN("n", 25, -1, 0) "\n"
+    "< D i16:4 t\"0.30000000000000004\" t\"3\" t\"-1\" null\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+
+    "== empty queries and utility commands\n" STARTUP
+    "> Q \"\"\n"
+    "< I\n"
+    "< Z c:I\n"
+    "> Q \" ; -- nothing\"\n"
+    "< I\n"
+    "< Z c:I\n"
+    "> Q \"BEGIN; SET extra_float_digits = 3; COMMIT\"\n"
+    "< C \"BEGIN\"\n"
+    "< C \"SET\"\n"
+    "< C \"COMMIT\"\n"
+    "< Z c:I\n"
+
+    "== errors in simple queries\n" STARTUP
+    "> Q \"SELEC 1\"\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"42601\" *\n"
+    "< Z c:I\n"
+    "> Q \"SELECT 1 / 0 AS x; SELECT 2\"\n"
+    "< T i16:1 " COLUMN("x", 20, 8, 0) "\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"22012\" *\n"
+    "< Z c:I\n"
+    "> Q \"SELECT * FROM users\"\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"42P01\" c:M "
+    "\"relation \\\"users\\\" does not exist\" x:00\n"
+    "< Z c:I\n"
+    "> Q \"SELECT 9223372036854775807 + 1\"\n"
+    "< T *\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"22003\" *\n"
+    "< Z c:I\n"
+    "> Q \"SELECT $1\"\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"42P02\" *\n"
+    "< Z c:I\n"
+
+    "== extended query with text and binary parameters\n" STARTUP
+    "> P \"s1\" \"SELECT $1 + $2 AS sum, $3 AS label\" i16:3 i32:20 i32:23 "
+    "i32:25\n"
+    "> D c:S \"s1\"\n"
+    "> B \"\" \"s1\" i16:3 i16:0 i16:1 i16:0 i16:3 t\"40\" i32:4 i32:2 "
+    "t\"hi\" i16:1 i16:1\n"
+    "> D c:P \"\"\n"
+    "> E \"\" i32:0\n"
+    "> S\n"
+    "< 1\n"
+    "< t i16:3 i32:20 i32:23 i32:25\n"
+    "< T i16:2 " COLUMN("sum", 20, 8, 0) " " COLUMN("label", 25, -1, 0) "\n"
+    "< 2\n"
+    "< T i16:2 " COLUMN("sum", 20, 8, 1) " " COLUMN("label", 25, -1, 1) "\n"
+    "< D i16:2 i32:8 i64:42 t\"hi\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    // The named statement outlives Sync; bind it again with NULL.
+    "> B \"p\" \"s1\" i16:0 i16:3 t\"1\" null t\"x\" i16:0\n"
+    "> E \"p\" i32:0\n"
+    "> S\n"
+    "< 2\n"
+    "< D i16:2 null t\"x\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    // Untyped parameters read as numbers when they look like one.
+    "> P \"\" \"SELECT $1 * 2 AS d, $2 = 'abc' AS eq\" i16:0\n"
+    "> B \"\" \"\" i16:0 i16:2 t\"2.25\" t\"abc\" i16:0\n"
+    "> E \"\" i32:0\n"
+    "> S\n"
+    "< 1\n"
+    "< 2\n"
+    "< D i16:2 t\"4.5\" t\"t\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    "> P \"\" \"SELECT $1 AS b\" i16:1 i32:16\n"
+    "> B \"\" \"\" i16:0 i16:1 t\"maybe\" i16:0\n"
+    "> S\n"
+    "< 1\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"22P02\" *\n"
+    "< Z c:I\n"
+
+    "== execute with a row limit\n" STARTUP
+    "> P \"\" \"SELECT generate_series($1, $2, 3) AS x\" i16:0\n"
+    "> B \"\" \"\" i16:0 i16:2 t\"1\" t\"13\" i16:0\n"
+    "> E \"\" i32:2\n"
+    "> E \"\" i32:2\n"
+    "> E \"\" i32:2\n"
+    "> E \"\" i32:2\n"
+    "> S\n"
+    "< 1\n"
+    "< 2\n"
+    "< D i16:1 t\"1\"\n"
+    "< D i16:1 t\"4\"\n"
+    "< s\n"
+    "< D i16:1 t\"7\"\n"
+    "< D i16:1 t\"10\"\n"
+    "< s\n"
+    "< D i16:1 t\"13\"\n"
+    "< C \"SELECT 1\"\n"
+    "< C \"SELECT 0\"\n"
+    "< Z c:I\n"
+
+    "== streaming a large result\n" STARTUP
+    "> Q \"SELECT generate_series(1, 20000) AS n, 'abcdefghijklmnopqrstuvwxyz' "
+    "AS pad\"\n"
+    "< T i16:2 " COLUMN("n", 20, 8, 0) " " COLUMN("pad", 25, -1, 0) "\n"
+    "<* 19999 D\n"
+    "< D i16:2 t\"20000\" t\"abcdefghijklmnopqrstuvwxyz\"\n"
+    "< C \"SELECT 20000\"\n"
+    "< Z c:I\n"
+    "> Q \"SELECT generate_series(10, 1, -1) AS n LIMIT 2 OFFSET 7; "
+    "SELECT generate_series(1, 3) AS n WHERE 1 > 2\"\n"
+    "< T i16:1 " COLUMN("n", 20, 8, 0) "\n"
+    "< D i16:1 t\"3\"\n"
+    "< D i16:1 t\"2\"\n"
+    "< C \"SELECT 2\"\n"
+    "< T i16:1 " COLUMN("n", 20, 8, 0) "\n"
+    "< C \"SELECT 0\"\n"
+    "< Z c:I\n"
+
+    "== errors skip to Sync\n" STARTUP
+    "> P \"\" \"SELECT 1 / 0\" i16:0\n"
+    "> B \"\" \"\" i16:0 i16:0 i16:0\n"
+    "> E \"\" i32:0\n"
+    "> P \"s2\" \"SELECT 1\" i16:0\n"
+    "> S\n"
+    "< 1\n"
+    "< 2\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"22012\" *\n"
+    "< Z c:I\n"
+    "> D c:S \"s2\"\n"
+    "> S\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"26000\" *\n"
+    "< Z c:I\n"
+    "> P \"\" \"SELECT FROM WHERE\" i16:0\n"
+    "> S\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"42601\" *\n"
+    "< Z c:I\n"
+    "> B \"\" \"s1\" i16:0 i16:0 i16:0\n"
+    "> E \"nope\" i32:0\n"
+    "> S\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"26000\" *\n"
+    "< Z c:I\n"
+
+    "== close and reuse names\n" STARTUP
+    "> P \"a\" \"SELECT 1\" i16:0\n"
+    "> P \"a\" \"SELECT 2\" i16:0\n"
+    "> S\n"
+    "< 1\n"
+    "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"42P05\" *\n"
+    "< Z c:I\n"
+    "> C c:S \"a\"\n"
+    "> C c:S \"missing\"\n"
+    "> P \"a\" \"SELECT 'two' AS v\" i16:0\n"
+    "> B \"\" \"a\" i16:0 i16:0 i16:0\n"
+    "> D c:P \"\"\n"
+    "> E \"\" i32:0\n"
+    "> S\n"
+    "< 3\n"
+    "< 3\n"
+    "< 1\n"
+    "< 2\n"
+    "< T i16:1 " COLUMN("v", 25, -1, 0) "\n"
+    "< D i16:1 t\"two\"\n"
+    "< C \"SELECT 1\"\n"
+    "< Z c:I\n"
+    "> P \"\" \"BEGIN\" i16:0\n"
+    "> D c:S \"\"\n"
+    "> B \"\" \"\" i16:0 i16:0 i16:0\n"
+    "> E \"\" i32:0\n"
+    "> S\n"
+    "< 1\n"
+    "< t i16:0\n"
+    "< n\n"
+    "< 2\n"
+    "< C \"BEGIN\"\n"
+    "< Z c:I\n"
+
+    "== unknown message type\n" STARTUP
+    "> y\n"
+    "< E c:S \"FATAL\" c:V \"FATAL\" c:C \"08P01\" *\n"
+    "<closed\n"
+
+    "== native protocol on the same port\n"
+    ">raw x:0000000001\n"
+    "<raw x:0000000040\n";
+
+// =================================================================================================
+// :: Replay ::
+// =================================================================================================
+
+#define REPLAY_MAX_MESSAGE 65536
+#define REPLAY_TIMEOUT_S 5
+
+typedef struct {
+  const char *host;
+  u16 port;
+  bool trickle;
+  bool verbose;
+  bool quiet; // Print only the scenarios that fail
+} ReplayOptions;
+
+typedef struct {
+  u8 *data;
+  usize length;
+  usize capacity;
+} ByteBuffer;
+
+typedef struct {
+  int fd;
+  ByteBuffer pending; // Messages not sent yet
+  u32 received;       // Messages read so far
+} ReplayConnection;
+
+static bool put_bytes(ByteBuffer *buffer, const void *data, usize length) {
+  if (length > buffer->capacity - buffer->length) {
+    return false;
+  }
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+  return true;
+}
+
+static bool put_integer(ByteBuffer *buffer, i64 value, u32 size) {
+  u8 bytes[8];
+  for (u32 i = 0; i < size; ++i) {
+    bytes[i] = (u8)((u64)value >> (8 * (size - 1 - i)));
+  }
+  return put_bytes(buffer, bytes, size);
+}
+
+// Reads a "quoted" string at '*cursor' with \" and \\ escapes into 'out'.
+static bool parse_quoted(const char **cursor, ByteBuffer *out) {
+  const char *p = *cursor + 1;
+  while (*p && *p != '"') {
+    if (*p == '\\' && p[1]) {
+      p++;
+    }
+    if (!put_bytes(out, p, 1)) {
+      return false;
+    }
+    p++;
+  }
+  if (*p != '"') {
+    return false;
+  }
+  *cursor = p + 1;
+  return true;
+}
+
+// Encodes the fields of a transcript line. Sets '*out_prefix' if the last
+// field is *.
+static bool parse_fields(const char *text, ByteBuffer *out, bool *out_prefix) {
+  *out_prefix = false;
+  const char *p = text;
+  for (;;) {
+    while (*p == ' ' || *p == '\t') {
+      p++;
+    }
+    if (*p == '\0' || *p == '\n') {
+      return true;
+    }
+    if (*out_prefix) {
+      return false; // * must come last
+    }
+    bool ok = true;
+    if (*p == '"') {
+      ok = parse_quoted(&p, out) && put_bytes(out, "", 1);
+    } else if (p[0] == 't' && p[1] == '"') {
+      ok = out->capacity - out->length >= 4;
+      ByteBuffer text_bytes = {
+          .data = out->data + out->length + 4,
+          .capacity = ok ? out->capacity - out->length - 4 : 0,
+      };
+      p++;
+      ok = ok && parse_quoted(&p, &text_bytes);
+      if (ok) {
+        // The bytes went past the length, which goes in front now.
+        usize length = text_bytes.length;
+        ok = put_integer(out, (i64)length, 4);
+        out->length += length;
+      }
+    } else if (*p == '*') {
+      *out_prefix = true;
+      p++;
+    } else if (strncmp(p, "null", 4) == 0) {
+      ok = put_integer(out, -1, 4);
+      p += 4;
+    } else if (strncmp(p, "c:", 2) == 0 && p[2]) {
+      ok = put_bytes(out, p + 2, 1);
+      p += 3;
+    } else if (strncmp(p, "x:", 2) == 0) {
+      p += 2;
+      while (isxdigit((unsigned char)p[0]) && isxdigit((unsigned char)p[1])) {
+        char hex[3] = {p[0], p[1], '\0'};
+        u8 byte = (u8)strtoul(hex, NULL, 16);
+        ok = ok && put_bytes(out, &byte, 1);
+        p += 2;
+      }
+    } else if (*p == 'i') {
+      char *end;
+      u32 bits = (u32)strtoul(p + 1, &end, 10);
+      bool is_size = bits == 8 || bits == 16 || bits == 32 || bits == 64;
+      if (*end != ':' || !is_size) {
+        return false;
+      }
+      i64 value = strtoll(end + 1, &end, 10);
+      ok = put_integer(out, value, bits / 8);
+      p = end;
+    } else {
+      return false;
+    }
+    if (!ok || (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\0')) {
+      return false;
+    }
+  }
+}
+
+static int connect_to(const ReplayOptions *opts) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  ZERO_STRUCT(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(opts->port);
+  inet_pton(AF_INET, opts->host, &addr.sin_addr);
+  int one = 1;
+  struct timeval timeout = {.tv_sec = REPLAY_TIMEOUT_S, .tv_usec = 0};
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Sends what the transcript queued; with --trickle one byte at a time, so
+// the server sees every message split across reads.
+static bool flush_pending(ReplayConnection *conn, const ReplayOptions *opts) {
+  usize sent = 0;
+  while (sent < conn->pending.length) {
+    usize chunk = opts->trickle ? 1 : conn->pending.length - sent;
+    ssize_t n = send(conn->fd, conn->pending.data + sent, chunk, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += (usize)n;
+    if (opts->trickle) {
+      usleep(50);
+    }
+  }
+  conn->pending.length = 0;
+  return true;
+}
+
+// Returns the number of bytes read: 'length' unless the peer closed or the
+// read timed out.
+static usize read_exact(int fd, u8 *out, usize length) {
+  usize done = 0;
+  while (done < length) {
+    ssize_t n = recv(fd, out + done, length - done, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += (usize)n;
+  }
+  return done;
+}
+
+static bool read_message(ReplayConnection *conn, u8 *out_type, u8 *body,
+                         u32 *out_length) {
+  u8 header[5];
+  if (read_exact(conn->fd, header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  u32 length = net_get_u32(header + 1);
+  if (length < 4 || length - 4 > REPLAY_MAX_MESSAGE) {
+    return false;
+  }
+  *out_type = header[0];
+  *out_length = length - 4;
+  conn->received++;
+  return read_exact(conn->fd, body, *out_length) == *out_length;
+}
+
+static void print_bytes(const char *label, const u8 *data, usize length) {
+  printf("    %s (%zu bytes): ", label, length);
+  for (usize i = 0; i < length && i < 160; ++i) {
+    u8 c = data[i];
+    if (isprint(c) && c != '\\') {
+      putchar(c);
+    } else {
+      printf("\\x%02x", c);
+    }
+  }
+  printf("%s\n", length > 160 ? "..." : "");
+}
+
+// Runs one transcript line. Returns false and explains why if the server
+// did not answer as expected.
+static bool run_line(ReplayConnection *conn, const ReplayOptions *opts,
+                     const char *line, ByteBuffer *scratch, u8 *body) {
+  bool is_prefix = false;
+  scratch->length = 0;
+  if (line[0] == '>') {
+    bool is_raw = strncmp(line, ">raw", 4) == 0;
+    const char *fields = line + (is_raw ? 4 : 3);
+    if (!is_raw && (strlen(line) < 3 || line[1] != ' ')) {
+      printf("  malformed line\n");
+      return false;
+    }
+    if (!parse_fields(fields, scratch, &is_prefix) || is_prefix) {
+      printf("  malformed fields\n");
+      return false;
+    }
+    ByteBuffer *out = &conn->pending;
+    bool ok = true;
+    if (is_raw) {
+      ok = put_bytes(out, scratch->data, scratch->length);
+    } else if (line[2] == '-') {
+      ok = put_integer(out, (i64)scratch->length + 4, 4) &&
+           put_bytes(out, scratch->data, scratch->length);
+    } else {
+      ok = put_bytes(out, &line[2], 1) &&
+           put_integer(out, (i64)scratch->length + 4, 4) &&
+           put_bytes(out, scratch->data, scratch->length);
+    }
+    if (!ok) {
+      printf("  message too large\n");
+    }
+    return ok;
+  }
+
+  if (!flush_pending(conn, opts)) {
+    printf("  send failed: %s\n", strerror(errno));
+    return false;
+  }
+  if (strncmp(line, "<closed", 7) == 0) {
+    u8 byte;
+    ssize_t n;
+    do {
+      n = recv(conn->fd, &byte, 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n != 0 && !(n < 0 && errno == ECONNRESET)) {
+      printf("  expected the connection to close\n");
+      return false;
+    }
+    return true;
+  }
+  if (strncmp(line, "<raw", 4) == 0) {
+    if (!parse_fields(line + 4, scratch, &is_prefix) || is_prefix) {
+      printf("  malformed fields\n");
+      return false;
+    }
+    usize got = read_exact(conn->fd, body, scratch->length);
+    if (got != scratch->length || memcmp(body, scratch->data, got) != 0) {
+      print_bytes("expected", scratch->data, scratch->length);
+      print_bytes("got", body, got);
+      return false;
+    }
+    return true;
+  }
+  if (strncmp(line, "<* ", 3) == 0) {
+    char *end;
+    u64 count = strtoull(line + 3, &end, 10);
+    while (*end == ' ') {
+      end++;
+    }
+    for (u64 i = 0; i < count; ++i) {
+      u8 type;
+      u32 length;
+      if (!read_message(conn, &type, body, &length) || type != (u8)*end) {
+        printf("  message %" PRIu64 " of %" PRIu64 ": expected '%c'\n", i + 1,
+               count, *end);
+        return false;
+      }
+    }
+    return true;
+  }
+  if (line[0] != '<' || strlen(line) < 3 || line[1] != ' ') {
+    printf("  malformed line\n");
+    return false;
+  }
+  if (!parse_fields(line + 3, scratch, &is_prefix)) {
+    printf("  malformed fields\n");
+    return false;
+  }
+  u8 type;
+  u32 length;
+  if (!read_message(conn, &type, body, &length)) {
+    printf("  expected '%c', but no message arrived\n", line[2]);
+    return false;
+  }
+  bool matches = type == (u8)line[2] &&
+                 (is_prefix ? length >= scratch->length
+                            : length == scratch->length) &&
+                 memcmp(body, scratch->data, scratch->length) == 0;
+  if (opts->verbose || !matches) {
+    printf("  %s '%c'\n", matches ? "got" : "MISMATCH, got", type);
+    print_bytes("body", body, length);
+  }
+  if (!matches) {
+    printf("  expected '%c'%s\n", line[2], is_prefix ? " starting with" : "");
+    print_bytes("body", scratch->data, scratch->length);
+  }
+  return matches;
+}
+
+// Runs every scenario of 'transcript'; returns the number that failed.
+static u32 run_transcript(const ReplayOptions *opts, const char *transcript) {
+  u8 *memory = (u8 *)malloc(3 * REPLAY_MAX_MESSAGE);
+  if (!memory) {
+    LOG_ERROR("Out of memory");
+    return 1;
+  }
+  ByteBuffer scratch = {.data = memory, .capacity = REPLAY_MAX_MESSAGE};
+  u8 *body = memory + REPLAY_MAX_MESSAGE;
+  ReplayConnection conn = {
+      .fd = -1,
+      .pending = {.data = memory + 2 * REPLAY_MAX_MESSAGE,
+                  .capacity = REPLAY_MAX_MESSAGE},
+  };
+  char name[128] = "";
+  bool failed = false;
+  u32 scenarios = 0, failures = 0, line_number = 0;
+
+  const char *cursor = transcript;
+  for (;;) {
+    const char *newline = strchr(cursor, '\n');
+    usize length = newline ? (usize)(newline - cursor) : strlen(cursor);
+    char line[4096];
+    if (length >= sizeof(line)) {
+      length = sizeof(line) - 1;
+    }
+    memcpy(line, cursor, length);
+    line[length] = '\0';
+    line_number++;
+    bool at_end = !newline && length == 0;
+
+    bool is_new_scenario = at_end || strncmp(line, "== ", 3) == 0;
+    if (is_new_scenario && name[0]) {
+      if (!failed && !flush_pending(&conn, opts)) {
+        failed = true;
+      }
+      if (failed || !opts->quiet) {
+        printf("%-4s %s (%u messages)\n", failed ? "FAIL" : "ok", name,
+               conn.received);
+      }
+      failures += failed ? 1 : 0;
+      close(conn.fd);
+      conn.fd = -1;
+      name[0] = '\0';
+    }
+    if (at_end) {
+      break;
+    }
+    if (is_new_scenario) {
+      // An overlong name is reported cut short and fails its scenario.
+      usize name_length = strlen(line + 3);
+      bool name_fits = name_length < sizeof(name);
+      if (!name_fits) {
+        name_length = sizeof(name) - 1;
+      }
+      memcpy(name, line + 3, name_length);
+      name[name_length] = '\0';
+      conn.pending.length = 0;
+      conn.received = 0;
+      scenarios++;
+      if (!name_fits) {
+        printf("  scenario name at line %u is longer than %zu bytes\n",
+               line_number, sizeof(name) - 1);
+        failed = true;
+      } else {
+        conn.fd = connect_to(opts);
+        failed = conn.fd < 0;
+        if (failed) {
+          printf("  cannot connect to %s:%u: %s\n", opts->host, opts->port,
+                 strerror(errno));
+        }
+      }
+    } else if (line[0] != '\0' && line[0] != '#' && name[0] && !failed) {
+      if (!run_line(&conn, opts, line, &scratch, body)) {
+        printf("  at line %u: %s\n", line_number, line);
+        failed = true;
+      }
+    }
+    if (!newline) {
+      break;
+    }
+    cursor = newline + 1;
+  }
+  if (conn.fd >= 0) {
+    close(conn.fd);
+  }
+  free(memory);
+  if (!opts->quiet) {
+    printf("\n%u of %u scenarios passed\n", scenarios - failures, scenarios);
+  }
+  return failures;
+}
+
+#endif // SQLDB_TEST_PG_REPLAY_H
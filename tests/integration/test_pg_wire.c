@@ -0,0 +1,242 @@
+// Serves PostgreSQL clients from an in-process server on a free port and
+// replays the pg_replay transcripts against it, whole and one byte at a time,
+// then cancels a long query from a second connection.
+
+#include "../fixtures/pg_replay.h"
+#include "../test.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define PG_TEST_CACHE_MB 4
+#define PG_TEST_MAX_CONNECTIONS 64
+
+typedef struct {
+  char path[32];
+  DatabaseConfig config;
+  Database db;
+  NetServer server;
+  pthread_t thread;
+  volatile bool stop;
+  bool has_db;
+  bool has_server;
+  bool is_running;
+} PgWireFixture;
+
+static void *server_thread(void *arg) {
+  PgWireFixture *f = (PgWireFixture *)arg;
+  net_server_run(&f->server, &f->stop);
+  return NULL;
+}
+
+static bool fixture_init(PgWireFixture *f) {
+  ZERO_STRUCT(*f);
+  char path[] = "/tmp/sqldb_test_pg_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_CHECK(fd >= 0);
+  memcpy(f->path, path, sizeof(path));
+  close(fd);
+  db_config_init_defaults(&f->config);
+  f->config.db_file_path = f->path;
+  f->config.cache_size_mb = PG_TEST_CACHE_MB;
+  f->config.worker_threads = 1;
+  f->config.log_level = g_log_level;
+  f->has_db = db_init(&f->db, &f->config);
+  TEST_CHECK(f->has_db);
+  f->has_server =
+      net_server_init(&f->server, &f->db, 0, PG_TEST_MAX_CONNECTIONS);
+  TEST_CHECK(f->has_server);
+  TEST_CHECK(f->server.port != 0);
+  TEST_CHECK(pthread_create(&f->thread, NULL, server_thread, f) == 0);
+  f->is_running = true;
+  return true;
+}
+
+static void fixture_free(PgWireFixture *f) {
+  if (f->is_running) {
+    f->stop = true;
+    pthread_join(f->thread, NULL);
+  }
+  if (f->has_server) {
+    net_server_shutdown(&f->server);
+  }
+  if (f->has_db) {
+    db_shutdown(&f->db);
+  }
+  if (f->path[0]) {
+    unlink(f->path);
+  }
+}
+
+static ReplayOptions replay_options(const PgWireFixture *f, bool trickle) {
+  return (ReplayOptions){
+      .host = "127.0.0.1",
+      .port = f->server.port,
+      .trickle = trickle,
+      .verbose = false,
+      .quiet = true,
+  };
+}
+
+static u32 replay_default_transcript(bool trickle) {
+  PgWireFixture f;
+  if (!fixture_init(&f)) {
+    fixture_free(&f);
+    return 1;
+  }
+  ReplayOptions opts = replay_options(&f, trickle);
+  u32 failures = run_transcript(&opts, g_default_transcript);
+  fixture_free(&f);
+  return failures;
+}
+
+typedef struct {
+  u8 memory[3 * REPLAY_MAX_MESSAGE];
+  ByteBuffer scratch;
+  u8 *body;
+  ReplayConnection conn;
+} PgTestClient;
+
+static bool client_connect(PgTestClient *c, const ReplayOptions *opts) {
+  c->scratch = (ByteBuffer){.data = c->memory, .capacity = REPLAY_MAX_MESSAGE};
+  c->body = c->memory + REPLAY_MAX_MESSAGE;
+  c->conn = (ReplayConnection){
+      .fd = connect_to(opts),
+      .pending = {.data = c->memory + 2 * REPLAY_MAX_MESSAGE,
+                  .capacity = REPLAY_MAX_MESSAGE},
+  };
+  return c->conn.fd >= 0;
+}
+
+static bool client_run(PgTestClient *c, const ReplayOptions *opts,
+                       const char *line) {
+  return run_line(&c->conn, opts, line, &c->scratch, c->body);
+}
+
+// Reads the startup replies up to ReadyForQuery and keeps the BackendKeyData.
+static bool client_startup(PgTestClient *c, const ReplayOptions *opts,
+                           u8 key[8]) {
+  TEST_CHECK(client_run(c, opts, "> - i32:196608 \"user\" \"alice\" x:00"));
+  TEST_CHECK(flush_pending(&c->conn, opts));
+  bool has_key = false;
+  for (;;) {
+    u8 type;
+    u32 length;
+    TEST_CHECK(read_message(&c->conn, &type, c->body, &length));
+    if (type == 'K' && length == 8) {
+      memcpy(key, c->body, 8);
+      has_key = true;
+    } else if (type == 'Z') {
+      return has_key;
+    }
+  }
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_replay_transcripts(void) {
+  TEST_CHECK(replay_default_transcript(false) == 0);
+  return true;
+}
+
+static bool test_replay_transcripts_trickled(void) {
+  TEST_CHECK(replay_default_transcript(true) == 0);
+  return true;
+}
+
+// A query with no rows to send runs until cancelled; the CancelRequest comes
+// on its own connection with the key from startup.
+static bool cancel_long_query(const ReplayOptions *opts, PgTestClient *target,
+                              PgTestClient *cancel) {
+  u8 key[8];
+  TEST_CHECK(client_connect(target, opts));
+  TEST_CHECK(client_startup(target, opts, key));
+  TEST_CHECK(client_run(target, opts,
+                        "> Q \"SELECT generate_series(1, 9000000000000000000) "
+                        "WHERE false\""));
+  TEST_CHECK(flush_pending(&target->conn, opts));
+  // The RowDescription shows the query started, so the cancel cannot
+  // overtake it.
+  TEST_CHECK(client_run(target, opts, "<* 1 T"));
+
+  TEST_CHECK(client_connect(cancel, opts));
+  TEST_CHECK(put_integer(&cancel->conn.pending, 16, 4) &&
+             put_integer(&cancel->conn.pending, 80877102, 4) &&
+             put_bytes(&cancel->conn.pending, key, 8));
+  bool closed = client_run(cancel, opts, "<closed");
+  close(cancel->conn.fd);
+  TEST_CHECK(closed);
+
+  TEST_CHECK(client_run(
+      target, opts, "< E c:S \"ERROR\" c:V \"ERROR\" c:C \"57014\" *"));
+  TEST_CHECK(client_run(target, opts, "< Z c:I"));
+  // The session carries on.
+  TEST_CHECK(client_run(target, opts, "> Q \"SELECT 2\""));
+  TEST_CHECK(client_run(target, opts, "<* 1 T"));
+  TEST_CHECK(client_run(target, opts, "<* 1 D"));
+  TEST_CHECK(client_run(target, opts, "< C \"SELECT 1\""));
+  TEST_CHECK(client_run(target, opts, "< Z c:I"));
+  return true;
+}
+
+static bool test_cancel_request(void) {
+  PgTestClient *clients = (PgTestClient *)malloc(2 * sizeof(PgTestClient));
+  TEST_CHECK(clients);
+  clients[0].conn.fd = -1;
+  PgWireFixture f;
+  bool ok = fixture_init(&f);
+  if (ok) {
+    ReplayOptions opts = replay_options(&f, false);
+    ok = cancel_long_query(&opts, &clients[0], &clients[1]);
+  }
+  if (clients[0].conn.fd >= 0) {
+    close(clients[0].conn.fd);
+  }
+  fixture_free(&f);
+  free(clients);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Sessions share nothing a client could use to guess another's cancel key.
+static bool test_cancel_keys_differ(void) {
+  PgTestClient *clients = (PgTestClient *)malloc(2 * sizeof(PgTestClient));
+  TEST_CHECK(clients);
+  clients[0].conn.fd = -1;
+  clients[1].conn.fd = -1;
+  PgWireFixture f;
+  bool ok = fixture_init(&f);
+  u8 keys[2][8];
+  if (ok) {
+    ReplayOptions opts = replay_options(&f, false);
+    for (u32 i = 0; i < 2 && ok; ++i) {
+      ok = client_connect(&clients[i], &opts) &&
+           client_startup(&clients[i], &opts, keys[i]);
+    }
+  }
+  for (u32 i = 0; i < 2; ++i) {
+    if (clients[i].conn.fd >= 0) {
+      close(clients[i].conn.fd);
+    }
+  }
+  fixture_free(&f);
+  free(clients);
+  TEST_CHECK(ok);
+  TEST_CHECK(memcmp(keys[0], keys[1], 4) != 0); // process_id
+  TEST_CHECK(memcmp(keys[0] + 4, keys[1] + 4, 4) != 0); // secret_key
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_replay_transcripts),
+    TEST_CASE(test_replay_transcripts_trickled),
+    TEST_CASE(test_cancel_request),
+    TEST_CASE(test_cancel_keys_differ),
+};
+
+const TestSuite g_pg_wire_tests = TEST_SUITE("pg_wire", g_cases);
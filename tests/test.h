@@ -0,0 +1,67 @@
+#ifndef SQLDB_TEST_H
+#define SQLDB_TEST_H
+
+#include "base.h"
+
+// =================================================================================================
+// :: Test Types ::
+// =================================================================================================
+
+// A test is a function that returns false as soon as a check fails. Suites
+// group the tests of one module; each file under tests/unit or
+// tests/integration defines one and test_runner.c lists them all.
+typedef bool (*TestFn)(void);
+
+typedef struct {
+  const char *name;
+  TestFn fn;
+} TestCase;
+
+typedef struct {
+  const char *name;
+  const TestCase *cases;
+  usize case_count;
+} TestSuite;
+
+#define TEST_CASE(fn) {#fn, fn}
+#define TEST_SUITE(suite_name, case_array)                                     \
+  {suite_name, case_array, ARRAY_SIZE(case_array)}
+
+// Fails the current test, logging the condition and where it is.
+#define TEST_CHECK(cond)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      LOG_ERROR("%s:%d: check failed: %s", __FILE__, __LINE__, #cond);         \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// Runs 'expr' with logging off, for code expected to log an error.
+#define TEST_QUIETLY(expr)                                                     \
+  do {                                                                         \
+    LogLevel test_log_level_ = g_log_level;                                    \
+    g_log_level = LOG_LEVEL_FATAL;                                             \
+    expr;                                                                      \
+    g_log_level = test_log_level_;                                             \
+  } while (0)
+
+// =================================================================================================
+// :: Test Suites ::
+// =================================================================================================
+
+extern const TestSuite g_arena_tests;
+extern const TestSuite g_async_io_tests;
+extern const TestSuite g_btree_tests;
+extern const TestSuite g_buffer_pool_tests;
+extern const TestSuite g_concurrent_map_tests;
+extern const TestSuite g_executor_tests;
+extern const TestSuite g_hash_function_tests;
+extern const TestSuite g_hash_table_tests;
+extern const TestSuite g_heap_page_tests;
+extern const TestSuite g_parser_tests;
+extern const TestSuite g_pg_wire_tests;
+extern const TestSuite g_plan_cache_tests;
+extern const TestSuite g_simd_tests;
+extern const TestSuite g_wal_tests;
+
+#endif // SQLDB_TEST_H
@@ -0,0 +1,59 @@
+// Runs the unit and integration tests. `make test` builds this against the
+// debug objects, so every test also runs under AddressSanitizer and
+// UndefinedBehaviorSanitizer.
+//
+// Usage: test_runner [FILTER]
+//   Runs only the suites and tests whose "suite/test" name contains FILTER.
+
+#define BASE_IMPLEMENTATION
+#include "test.h"
+
+// =================================================================================================
+// :: Test Runner ::
+// =================================================================================================
+
+static const TestSuite *g_suites[] = {
+    &g_arena_tests,
+    &g_async_io_tests,
+    &g_btree_tests,
+    &g_buffer_pool_tests,
+    &g_concurrent_map_tests,
+    &g_executor_tests,
+    &g_hash_function_tests,
+    &g_hash_table_tests,
+    &g_heap_page_tests,
+    &g_parser_tests,
+    &g_pg_wire_tests,
+    &g_plan_cache_tests,
+    &g_simd_tests,
+    &g_wal_tests,
+};
+
+int main(int argc, char **argv) {
+  const char *filter = argc > 1 ? argv[1] : NULL;
+  g_log_level = LOG_LEVEL_WARNING;
+
+  u32 passed = 0;
+  u32 failed = 0;
+  for (usize s = 0; s < ARRAY_SIZE(g_suites); ++s) {
+    const TestSuite *suite = g_suites[s];
+    for (usize c = 0; c < suite->case_count; ++c) {
+      const TestCase *test = &suite->cases[c];
+      char name[256];
+      snprintf(name, sizeof(name), "%s/%s", suite->name, test->name);
+      if (filter && !strstr(name, filter)) {
+        continue;
+      }
+      bool ok = test->fn();
+      printf("[%s] %s\n", ok ? "PASS" : "FAIL", name);
+      fflush(stdout);
+      if (ok) {
+        passed++;
+      } else {
+        failed++;
+      }
+    }
+  }
+  printf("\n%u passed, %u failed\n", passed, failed);
+  return failed == 0 && passed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,157 @@
+// Checks arena savepoints: nested scopes on a growable arena chain new blocks
+// and restoring each one leaves what the outer scopes allocated intact and
+// the usage exactly as it was, also when the blocks are reused. Savepoints
+// that are no longer live are refused. Oversized allocations get a block of
+// their own, a reset goes back to the first block, and savepoints work on
+// fixed arenas, which still fail when full.
+
+#include "../test.h"
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define ARENA_TEST_DEPTH 12
+#define ARENA_TEST_ALLOCS 200
+#define ARENA_TEST_LARGE_EVERY 64 // One 4-64 KB allocation per this many
+#define ARENA_TEST_FIRST_BLOCK 4096
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static usize alloc_size(u64 r, usize i) {
+  if (i % ARENA_TEST_LARGE_EVERY == ARENA_TEST_LARGE_EVERY - 1) {
+    return 4096 + (usize)(r % (60 * 1024));
+  }
+  return 16 + (usize)(r % 241);
+}
+
+// Allocates at 'depth', fills each allocation with a pattern, opens a nested
+// scope, and checks that the inner scope did not disturb this one.
+static bool check_scope(Arena *arena, u32 depth, u64 *rng) {
+  u8 *ptrs[ARENA_TEST_ALLOCS];
+  usize sizes[ARENA_TEST_ALLOCS];
+  ArenaSavepoint savepoint = arena_save(arena);
+  usize used = arena_used(arena);
+  for (usize i = 0; i < ARENA_TEST_ALLOCS; ++i) {
+    sizes[i] = alloc_size(next_random(rng), i);
+    ptrs[i] = (u8 *)arena_alloc(arena, sizes[i]);
+    TEST_CHECK(ptrs[i]);
+    memset(ptrs[i], (int)(depth * 31 + i) & 0xFF, sizes[i]);
+  }
+  if (depth + 1 < ARENA_TEST_DEPTH) {
+    TEST_CHECK(check_scope(arena, depth + 1, rng));
+  }
+  for (usize i = 0; i < ARENA_TEST_ALLOCS; ++i) {
+    u8 expected = (u8)((depth * 31 + i) & 0xFF);
+    for (usize b = 0; b < sizes[i]; ++b) {
+      TEST_CHECK(ptrs[i][b] == expected);
+    }
+  }
+  TEST_CHECK(arena_restore(arena, savepoint));
+  TEST_CHECK(arena_used(arena) == used);
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// Twice: the second pass reuses the blocks the first one released.
+static bool test_nested_savepoints_across_blocks(void) {
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  Arena arena = arena_init_growable(ARENA_TEST_FIRST_BLOCK, false);
+  TEST_CHECK(arena.buffer);
+  bool ok = true;
+  for (u32 pass = 0; pass < 2 && ok; ++pass) {
+    ok = check_scope(&arena, 0, &rng) && arena_used(&arena) == 0 &&
+         !arena.block->prev;
+  }
+  ok = ok && arena.spare != NULL;
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Restoring an outer savepoint invalidates the ones taken after it, in its
+// own block and in blocks it released; restoring those afterwards, or one
+// from another arena, is refused and leaves the arena as it is.
+static bool test_out_of_order_restore(void) {
+  Arena arena = arena_init_growable(ARENA_TEST_FIRST_BLOCK, false);
+  Arena other = arena_init_growable(ARENA_TEST_FIRST_BLOCK, false);
+  TEST_CHECK(arena.buffer && other.buffer);
+  ArenaSavepoint outer = arena_save(&arena);
+  bool ok = arena_alloc(&arena, 100) != NULL;
+  ArenaSavepoint same_block = arena_save(&arena);
+  ok = ok && arena_alloc(&arena, 100) &&
+       arena_alloc(&arena, 2 * ARENA_TEST_FIRST_BLOCK) && arena.block->prev;
+  ArenaSavepoint next_block = arena_save(&arena);
+  ok = ok && arena_alloc(&arena, 100);
+  ArenaSavepoint foreign = arena_save(&other);
+  ArenaSavepoint fixed = {.block = NULL, .offset = 0};
+
+  ok = ok && arena_restore(&arena, same_block) && arena_restore(&arena, outer);
+  usize used = arena_used(&arena);
+  const ArenaBlock *block = arena.block;
+  TEST_QUIETLY(ok = ok && !arena_restore(&arena, same_block) &&
+                    !arena_restore(&arena, next_block) &&
+                    !arena_restore(&arena, foreign) &&
+                    !arena_restore(&arena, fixed));
+  ok = ok && arena_used(&arena) == used && arena.block == block &&
+       !block->prev && arena_restore(&arena, outer);
+
+  // Fixed arenas have no blocks; only the offset tells.
+  Arena fixed_arena = arena_init(1024);
+  TEST_CHECK(fixed_arena.buffer);
+  outer = arena_save(&fixed_arena);
+  ok = ok && arena_alloc(&fixed_arena, 100);
+  ArenaSavepoint inner = arena_save(&fixed_arena);
+  ok = ok && arena_alloc(&fixed_arena, 100) &&
+       arena_restore(&fixed_arena, outer);
+  TEST_QUIETLY(ok = ok && !arena_restore(&fixed_arena, inner));
+  ok = ok && arena_used(&fixed_arena) == 0;
+  arena_free_all(&fixed_arena);
+  arena_free_all(&other);
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_oversized_allocation(void) {
+  Arena arena = arena_init_growable(ARENA_TEST_FIRST_BLOCK, false);
+  TEST_CHECK(arena.buffer);
+  bool ok = arena_alloc(&arena, 100) &&
+            arena_alloc(&arena, 2 * BASE_ARENA_MAX_BLOCK_SIZE) &&
+            arena.total_size >= 2 * BASE_ARENA_MAX_BLOCK_SIZE;
+  arena_reset(&arena);
+  ok = ok && arena_used(&arena) == 0 && arena.block && !arena.block->prev;
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_fixed_arena_savepoint(void) {
+  Arena arena = arena_init(1024);
+  TEST_CHECK(arena.buffer);
+  ArenaSavepoint savepoint = arena_save(&arena);
+  bool ok = arena_alloc(&arena, 512) != NULL;
+  TEST_QUIETLY(ok = ok && !arena_alloc(&arena, 1024));
+  ok = ok && arena_restore(&arena, savepoint) && arena_used(&arena) == 0 &&
+       arena_alloc(&arena, 1024);
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_nested_savepoints_across_blocks),
+    TEST_CASE(test_out_of_order_restore),
+    TEST_CASE(test_oversized_allocation),
+    TEST_CASE(test_fixed_arena_savepoint),
+};
+
+const TestSuite g_arena_tests = TEST_SUITE("arena", g_cases);
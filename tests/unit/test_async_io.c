@@ -0,0 +1,152 @@
+// Writes pages through each async I/O backend in batches larger than the
+// queue, reads them back, and checks that reads past the end of the file are
+// zero-filled. io_uring falls back to the sync backend where the kernel
+// lacks it, so both runs pass either way.
+
+#include "../test.h"
+#include "sqldb/async_io.h"
+
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define AIO_TEST_PAGE_SIZE 4096
+#define AIO_TEST_PAGES 64
+#define AIO_TEST_QUEUE_DEPTH 8
+
+// Submits whatever is prepared and reaps until nothing is in flight, checking
+// every completion. Returns the number of completions.
+static u32 drain(AsyncIo *aio, bool *out_ok) {
+  AsyncIoCompletion completions[AIO_TEST_QUEUE_DEPTH];
+  u32 total = 0;
+  async_io_submit(aio);
+  while (async_io_in_flight(aio) > 0) {
+    u32 n = async_io_reap(aio, completions, AIO_TEST_QUEUE_DEPTH, 1);
+    if (n == 0) {
+      *out_ok = false;
+      break;
+    }
+    for (u32 i = 0; i < n; ++i) {
+      *out_ok &= completions[i].ok;
+    }
+    total += n;
+  }
+  return total;
+}
+
+// Runs 'op' on pages [0, count), a queue's worth at a time.
+static bool run_pages(AsyncIo *aio, AsyncIoOp op, u8 *pages, PageId count) {
+  bool ok = true;
+  u32 completed = 0;
+  for (PageId page_id = 0; page_id < count; ++page_id) {
+    AsyncIoRequest request = {
+        .op = op,
+        .page_id = page_id,
+        .buffer = pages + page_id * AIO_TEST_PAGE_SIZE,
+    };
+    if (!async_io_prepare(aio, &request)) {
+      completed += drain(aio, &ok);
+      TEST_CHECK(async_io_prepare(aio, &request));
+    }
+  }
+  completed += drain(aio, &ok);
+  TEST_CHECK(ok && completed == count);
+  return true;
+}
+
+static bool round_trip(AsyncIoBackend backend) {
+  char path[] = "/tmp/sqldb_test_aio_XXXXXX";
+  int tmp_fd = mkstemp(path);
+  TEST_CHECK(tmp_fd >= 0);
+  close(tmp_fd);
+  PageFile file;
+  TEST_CHECK(pf_open(&file, path, AIO_TEST_PAGE_SIZE, false, false));
+  AsyncIo aio;
+  TEST_CHECK(async_io_init(&aio, &file, AIO_TEST_QUEUE_DEPTH, backend));
+
+  usize size = (usize)(AIO_TEST_PAGES + 1) * AIO_TEST_PAGE_SIZE;
+  u8 *written = (u8 *)aligned_alloc(AIO_TEST_PAGE_SIZE, size);
+  u8 *read = (u8 *)aligned_alloc(AIO_TEST_PAGE_SIZE, size);
+  TEST_CHECK(written && read);
+  for (usize i = 0; i < size; ++i) {
+    written[i] = (u8)(i * 31 + i / AIO_TEST_PAGE_SIZE);
+  }
+  memset(read, 0xEE, size);
+
+  bool ok = run_pages(&aio, ASYNC_IO_WRITE, written, AIO_TEST_PAGES) &&
+            run_pages(&aio, ASYNC_IO_READ, read, AIO_TEST_PAGES + 1);
+  if (ok) {
+    usize data_size = (usize)AIO_TEST_PAGES * AIO_TEST_PAGE_SIZE;
+    ok = memcmp(written, read, data_size) == 0;
+    for (usize i = data_size; ok && i < size; ++i) {
+      ok = read[i] == 0; // Past the end of the file
+    }
+  }
+  ok = ok && aio.stats.failures == 0 &&
+       aio.stats.completed == 2 * AIO_TEST_PAGES + 1;
+
+  async_io_shutdown(&aio);
+  pf_close(&file);
+  unlink(path);
+  free(written);
+  free(read);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_sync_round_trip(void) {
+  return round_trip(ASYNC_IO_BACKEND_SYNC);
+}
+
+static bool test_io_uring_round_trip(void) {
+  return round_trip(ASYNC_IO_BACKEND_IO_URING);
+}
+
+// A file that ends halfway through a page reads back its bytes followed by
+// zeroes; only the part past the end of the file is zero-filled.
+static bool test_io_uring_partial_last_page(void) {
+  char path[] = "/tmp/sqldb_test_aio_XXXXXX";
+  int tmp_fd = mkstemp(path);
+  TEST_CHECK(tmp_fd >= 0);
+  u8 *page = (u8 *)aligned_alloc(AIO_TEST_PAGE_SIZE, AIO_TEST_PAGE_SIZE);
+  TEST_CHECK(page);
+  memset(page, 0xAB, AIO_TEST_PAGE_SIZE);
+  usize half = AIO_TEST_PAGE_SIZE / 2;
+  bool ok = write(tmp_fd, page, AIO_TEST_PAGE_SIZE) == AIO_TEST_PAGE_SIZE &&
+            write(tmp_fd, page, half) == (ssize_t)half;
+  close(tmp_fd);
+  PageFile file;
+  AsyncIo aio;
+  ok = ok && pf_open(&file, path, AIO_TEST_PAGE_SIZE, false, false);
+  ok = ok && async_io_init(&aio, &file, AIO_TEST_QUEUE_DEPTH,
+                           ASYNC_IO_BACKEND_IO_URING);
+  if (ok) {
+    memset(page, 0xEE, AIO_TEST_PAGE_SIZE);
+    AsyncIoRequest request = {
+        .op = ASYNC_IO_READ, .page_id = 1, .buffer = page};
+    ok = async_io_prepare(&aio, &request) && drain(&aio, &ok) == 1 && ok;
+    for (usize i = 0; ok && i < AIO_TEST_PAGE_SIZE; ++i) {
+      ok = page[i] == (i < half ? 0xAB : 0);
+    }
+    async_io_shutdown(&aio);
+    pf_close(&file);
+  }
+  unlink(path);
+  free(page);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_sync_round_trip),
+    TEST_CASE(test_io_uring_round_trip),
+    TEST_CASE(test_io_uring_partial_last_page),
+};
+
+const TestSuite g_async_io_tests = TEST_SUITE("async_io", g_cases);
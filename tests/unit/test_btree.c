@@ -0,0 +1,563 @@
+// Builds B+trees on the smallest page size, so a few thousand keys split
+// every level, and checks them against a sorted reference: point lookups of
+// present and absent keys, seeks and scans that cross many sibling links,
+// inner-node prefixes with shared and diverging separators, keys of the
+// maximum size and deletes.
+//
+// A concurrent tree is read by several threads while writers split its nodes
+// under them: keys present before the readers started must always be found,
+// and scans must stay sorted without duplicates or gaps.
+
+#include "../test.h"
+#include "sqldb/btree.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define BT_TEST_PAGE_SIZE BTREE_MIN_PAGE_SIZE
+#define BT_TEST_FRAMES 8192
+#define BT_TEST_KEY_CAPACITY 128
+#define BT_TEST_STRIDE 7919 // Prime, so i * stride % count visits every key
+#define BT_TEST_READERS 4
+#define BT_TEST_WRITERS 2
+#define BT_TEST_PRELOADED 6000 // Keys 0, 3, 6, ...; writers add the others
+#define BT_TEST_SCAN_LENGTH 200
+
+typedef struct {
+  char path[32];
+  PageFile file;
+  Arena arena;
+  BufferPool bp;
+  BTree tree;
+  bool has_file;
+  bool has_bp;
+  bool has_tree;
+} BTreeFixture;
+
+// One key of the reference: the tree must hold exactly the present ones.
+typedef struct {
+  char data[BT_TEST_KEY_CAPACITY];
+  u32 length;
+  u64 value;
+  bool is_present;
+} RefKey;
+
+// Nodes of every level, leaves first, and the range of inner node prefixes.
+typedef struct {
+  u32 nodes[BTREE_MAX_HEIGHT];
+  u32 min_prefix;
+  u32 max_prefix;
+} TreeShape;
+
+static bool fixture_init(BTreeFixture *f) {
+  ZERO_STRUCT(*f);
+  char path[] = "/tmp/sqldb_test_btree_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_CHECK(fd >= 0);
+  close(fd);
+  memcpy(f->path, path, sizeof(path));
+  f->has_file = pf_open(&f->file, f->path, BT_TEST_PAGE_SIZE, false, false);
+  TEST_CHECK(f->has_file);
+  f->arena = arena_init(bp_required_arena_size(
+      BT_TEST_FRAMES, BT_TEST_PAGE_SIZE, DEFAULT_EVICTION_POLICY, false));
+  f->has_bp = bp_init(&f->bp, &f->arena, BT_TEST_FRAMES, BT_TEST_PAGE_SIZE,
+                      DEFAULT_EVICTION_POLICY, &f->file);
+  TEST_CHECK(f->has_bp);
+  f->has_tree = btree_create(&f->tree, &f->bp);
+  TEST_CHECK(f->has_tree);
+  return true;
+}
+
+static void fixture_free(BTreeFixture *f) {
+  if (f->has_tree) {
+    btree_close(&f->tree);
+  }
+  if (f->has_bp) {
+    bp_shutdown(&f->bp);
+  }
+  arena_free_all(&f->arena);
+  if (f->has_file) {
+    pf_close(&f->file);
+  }
+  if (f->path[0]) {
+    unlink(f->path);
+  }
+}
+
+static StringView ref_key(const RefKey *ref) {
+  return sv_from_parts(ref->data, ref->length);
+}
+
+static int ref_compare(const void *a, const void *b) {
+  return sv_compare(ref_key((const RefKey *)a), ref_key((const RefKey *)b));
+}
+
+// Fills refs[0, count) with 'length'-byte keys: 'prefix', then the key's
+// number scaled by 3 (so the numbers in between are absent keys), zero-padded
+// to the length or, with 'pad_after', written first and padded with 'x'.
+static void make_keys(RefKey *refs, u32 count, u32 first, const char *prefix,
+                      u32 length, bool pad_after) {
+  for (u32 i = 0; i < count; ++i) {
+    RefKey *ref = &refs[i];
+    u32 number = (first + i) * 3;
+    int prefix_length = (int)strlen(prefix);
+    if (pad_after) {
+      int n = snprintf(ref->data, sizeof(ref->data), "%s%08u", prefix, number);
+      memset(ref->data + n, 'x', length - (u32)n);
+    } else {
+      snprintf(ref->data, sizeof(ref->data), "%s%0*u", prefix,
+               (int)length - prefix_length, number);
+    }
+    ref->length = length;
+    ref->value = (u64)number * 7 + 1;
+    ref->is_present = false;
+  }
+}
+
+// Inserts every key in a scattered order and sorts the reference.
+static bool insert_all(BTree *bt, RefKey *refs, u32 count) {
+  ASSERT(count % BT_TEST_STRIDE != 0);
+  for (u32 i = 0; i < count; ++i) {
+    RefKey *ref = &refs[(u64)i * BT_TEST_STRIDE % count];
+    TEST_CHECK(btree_insert(bt, ref_key(ref), ref->value));
+    ref->is_present = true;
+  }
+  qsort(refs, count, sizeof(RefKey), ref_compare);
+  return true;
+}
+
+static bool check_lookups(BTree *bt, const RefKey *refs, u32 count) {
+  for (u32 i = 0; i < count; ++i) {
+    u64 value = 0;
+    bool found = btree_lookup(bt, ref_key(&refs[i]), &value);
+    TEST_CHECK(found == refs[i].is_present);
+    TEST_CHECK(!found || value == refs[i].value);
+  }
+  return true;
+}
+
+// Seeks to 'start' and checks that the scan returns every present key from
+// there on, in order, and then ends.
+static bool check_scan(BTree *bt, StringView start, const RefKey *refs,
+                       u32 count) {
+  BTreeIterator it;
+  TEST_CHECK(btree_seek(bt, start, &it));
+  bool ok = true;
+  for (u32 i = 0; i < count && ok; ++i) {
+    if (!refs[i].is_present || sv_compare(ref_key(&refs[i]), start) < 0) {
+      continue;
+    }
+    StringView key;
+    u64 value;
+    ok = btree_iter_next(&it, &key, &value) &&
+         sv_equals(key, ref_key(&refs[i])) && value == refs[i].value;
+  }
+  StringView key;
+  u64 value;
+  ok = ok && !btree_iter_next(&it, &key, &value);
+  btree_iter_close(&it);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Walks every level from the root down along the sibling links.
+static bool tree_shape(BTree *bt, TreeShape *out_shape) {
+  ZERO_STRUCT(*out_shape);
+  out_shape->min_prefix = UINT32_MAX;
+  PageId first = bt->root_page_id;
+  for (u32 level = bt->height; level-- > 0;) {
+    PageId next_first = INVALID_PAGE_ID;
+    for (PageId page_id = first; page_id != INVALID_PAGE_ID;) {
+      BufferFrame *frame = bp_fetch_page(bt->bp, page_id);
+      TEST_CHECK(frame);
+      BTreeNodeHeader header;
+      memcpy(&header, frame->data, sizeof(header));
+      bp_unpin_page(bt->bp, frame, false);
+      TEST_CHECK(header.magic == BTREE_NODE_MAGIC && header.level == level);
+      if (level > 0) {
+        out_shape->min_prefix = MIN(out_shape->min_prefix,
+                                    header.prefix_length);
+        out_shape->max_prefix = MAX(out_shape->max_prefix,
+                                    header.prefix_length);
+      }
+      if (page_id == first) {
+        next_first = header.leftmost_child;
+      }
+      out_shape->nodes[level]++;
+      page_id = header.right_sibling;
+    }
+    first = next_first;
+  }
+  return true;
+}
+
+typedef struct {
+  BTree *tree;
+  pthread_barrier_t *start;
+  const bool *stop;
+  u32 writer_idx; // Writers: adds the keys numbered 3i + writer_idx + 1
+  u64 rng_state;  // Readers
+  u64 lookups;
+  u64 scans;
+  bool ok;
+} ConcurrentSession;
+
+static u64 session_rng(ConcurrentSession *session) {
+  u64 x = session->rng_state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  session->rng_state = x;
+  return x;
+}
+
+// Key number 'number' of the concurrent test, with the usual value.
+static void olc_key(RefKey *ref, u32 number) {
+  ref->length = (u32)snprintf(ref->data, sizeof(ref->data), "olc/%08u",
+                              number);
+  ref->value = (u64)number * 7 + 1;
+  ref->is_present = true;
+}
+
+// Parses a key made by olc_key.
+static bool olc_key_number(StringView key, u32 *out_number) {
+  if (key.length != 12 || memcmp(key.data, "olc/", 4) != 0) {
+    return false;
+  }
+  u32 number = 0;
+  for (usize i = 4; i < key.length; ++i) {
+    if (key.data[i] < '0' || key.data[i] > '9') {
+      return false;
+    }
+    number = number * 10 + (u32)(key.data[i] - '0');
+  }
+  *out_number = number;
+  return true;
+}
+
+// Scans from a preloaded key: keys must ascend strictly, and every preloaded
+// key on the way must show up (only writer keys may appear in between).
+static bool olc_scan(ConcurrentSession *session, u32 start_number) {
+  RefKey start;
+  olc_key(&start, start_number);
+  BTreeIterator it;
+  if (!btree_seek(session->tree, ref_key(&start), &it)) {
+    return false;
+  }
+  bool ok = true;
+  u32 expected = start_number; // Next preloaded key the scan owes
+  u32 previous = 0;
+  StringView key;
+  u64 value;
+  for (u32 n = 0; ok && n < BT_TEST_SCAN_LENGTH &&
+                  btree_iter_next(&it, &key, &value);
+       ++n) {
+    u32 number;
+    ok = olc_key_number(key, &number) && (n == 0 || number > previous) &&
+         value == (u64)number * 7 + 1;
+    if (ok && number % 3 == 0) {
+      ok = number == expected;
+      expected += 3;
+    }
+    previous = number;
+  }
+  btree_iter_close(&it);
+  session->scans++;
+  return ok;
+}
+
+static void *olc_reader_main(void *arg) {
+  ConcurrentSession *session = (ConcurrentSession *)arg;
+  session->ok = true;
+  pthread_barrier_wait(session->start);
+  while (session->ok && !__atomic_load_n(session->stop, __ATOMIC_ACQUIRE)) {
+    u32 number = (u32)(session_rng(session) % BT_TEST_PRELOADED) * 3;
+    if (session->lookups % 16 == 15) {
+      session->ok = olc_scan(session, number);
+    }
+    RefKey ref;
+    olc_key(&ref, number);
+    u64 value = 0;
+    session->ok &= btree_lookup(session->tree, ref_key(&ref), &value) &&
+                   value == ref.value;
+    session->lookups++;
+  }
+  return NULL;
+}
+
+static void *olc_writer_main(void *arg) {
+  ConcurrentSession *session = (ConcurrentSession *)arg;
+  session->ok = true;
+  pthread_barrier_wait(session->start);
+  for (u32 i = 0; session->ok && i < BT_TEST_PRELOADED; ++i) {
+    u32 number = ((u32)((u64)i * BT_TEST_STRIDE % BT_TEST_PRELOADED)) * 3 +
+                 session->writer_idx + 1;
+    RefKey ref;
+    olc_key(&ref, number);
+    session->ok = btree_insert(session->tree, ref_key(&ref), ref.value);
+  }
+  return NULL;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// Enough keys for a four-level tree: leaves, two inner levels and a root that
+// split in turn. Every level below the root must have more than one node.
+static bool test_splits_at_every_level(void) {
+  u32 count = 20000;
+  RefKey *refs = (RefKey *)malloc(count * sizeof(RefKey));
+  TEST_CHECK(refs);
+  make_keys(refs, count, 0, "key-", 12, false);
+  BTreeFixture f;
+  TreeShape shape;
+  bool ok = fixture_init(&f) && insert_all(&f.tree, refs, count) &&
+            check_lookups(&f.tree, refs, count) &&
+            check_scan(&f.tree, sv_from_parts("", 0), refs, count) &&
+            tree_shape(&f.tree, &shape);
+  ok = ok && f.tree.height >= 4 && shape.nodes[f.tree.height - 1] == 1 &&
+       f.tree.stats.inserts == count && f.tree.stats.leaf_splits > 0 &&
+       f.tree.stats.inner_splits >= f.tree.height - 1;
+  for (u32 level = 0; ok && level + 1 < f.tree.height; ++level) {
+    ok = shape.nodes[level] > shape.nodes[level + 1];
+  }
+
+  // Absent keys fall between the present ones.
+  for (u32 i = 0; ok && i < count; i += 97) {
+    char absent[16];
+    int length = snprintf(absent, sizeof(absent), "key-%08u", i * 3 + 1);
+    u64 value;
+    ok = !btree_lookup(&f.tree, sv_from_parts(absent, (usize)length), &value);
+  }
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Inner nodes store the prefix their separators share once. With one shared
+// key prefix every inner node has at least that prefix; with two key groups
+// that diverge after a common part, some node spans the divergence and keeps
+// only the common part. Keys that leave a node's prefix early, in either
+// direction, must still route and seek correctly.
+static bool test_inner_prefix_compression(void) {
+  static const char *shared = "tenant-0042/orders/by-date/";
+  u32 count = 6000;
+  RefKey *refs = (RefKey *)malloc(count * sizeof(RefKey));
+  TEST_CHECK(refs);
+  make_keys(refs, count, 0, shared, 40, false);
+  BTreeFixture f;
+  TreeShape shape;
+  bool ok = fixture_init(&f) && insert_all(&f.tree, refs, count) &&
+            check_lookups(&f.tree, refs, count) &&
+            tree_shape(&f.tree, &shape) && f.tree.height >= 3 &&
+            shape.min_prefix >= strlen(shared);
+  fixture_free(&f);
+
+  static const char *common = "tenant-0042/";
+  make_keys(refs, count / 2, 0, "tenant-0042/orders/", 40, false);
+  make_keys(refs + count / 2, count / 2, 0, "tenant-0042/refunds/", 40, false);
+  ok = ok && fixture_init(&f) && insert_all(&f.tree, refs, count) &&
+       check_lookups(&f.tree, refs, count) && tree_shape(&f.tree, &shape) &&
+       shape.min_prefix == strlen(common) &&
+       shape.max_prefix >= strlen("tenant-0042/orders/");
+
+  static const char *probes[] = {
+      "",                      // Before everything
+      "tenant-0041/zzz",       // Sorts below the common prefix
+      "tenant-0042",           // A proper prefix of every separator
+      "tenant-0042/",          // Exactly the common prefix
+      "tenant-0042/p",         // Between the groups
+      "tenant-0042/refunds/0", // A prefix of the second group's keys
+      "tenant-0043",           // After everything
+  };
+  for (u32 i = 0; ok && i < ARRAY_SIZE(probes); ++i) {
+    u64 value;
+    ok = !btree_lookup(&f.tree, sv_from_cstr(probes[i]), &value) &&
+         check_scan(&f.tree, sv_from_cstr(probes[i]), refs, count);
+  }
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Keys of btree_max_key_size bytes, one group sharing almost all of them and
+// one differing in the first bytes, so separators are as long as keys get.
+// One byte more is rejected.
+static bool test_max_size_keys(void) {
+  u32 max = btree_max_key_size(BT_TEST_PAGE_SIZE);
+  TEST_CHECK(max + 1 <= BT_TEST_KEY_CAPACITY);
+  u32 count = 3000;
+  RefKey *refs = (RefKey *)malloc((count + 1) * sizeof(RefKey));
+  TEST_CHECK(refs);
+  make_keys(refs, count / 2, 0, "", max, false);
+  make_keys(refs + count / 2, count / 2, 0, "", max, true);
+  BTreeFixture f;
+  bool ok = fixture_init(&f) && insert_all(&f.tree, refs, count) &&
+            check_lookups(&f.tree, refs, count) &&
+            check_scan(&f.tree, sv_from_parts("", 0), refs, count) &&
+            check_scan(&f.tree, ref_key(&refs[count / 3]), refs, count) &&
+            f.tree.height >= 3;
+
+  make_keys(&refs[count], 1, count, "", max + 1, false);
+  TEST_QUIETLY(ok = ok && !btree_insert(&f.tree, ref_key(&refs[count]), 1));
+  ok = ok && f.tree.stats.inserts == count;
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Deletes leave emptied leaves in place; lookups, seeks and scans skip them.
+// Deleting twice fails, and deleted keys can be inserted again.
+static bool test_delete(void) {
+  u32 count = 5000;
+  RefKey *refs = (RefKey *)malloc(count * sizeof(RefKey));
+  TEST_CHECK(refs);
+  make_keys(refs, count, 0, "row:", 16, false);
+  BTreeFixture f;
+  bool ok = fixture_init(&f) && insert_all(&f.tree, refs, count);
+
+  // Every other key, then a solid run that empties whole leaves.
+  for (u32 i = 0; ok && i < count; ++i) {
+    RefKey *ref = &refs[(u64)i * BT_TEST_STRIDE % count];
+    u32 index = (u32)(ref - refs);
+    if (index % 2 == 1 || (index >= 1000 && index < 3000)) {
+      ok = btree_delete(&f.tree, ref_key(ref)) &&
+           !btree_delete(&f.tree, ref_key(ref));
+      ref->is_present = false;
+    }
+  }
+  ok = ok && check_lookups(&f.tree, refs, count) &&
+       check_scan(&f.tree, sv_from_parts("", 0), refs, count) &&
+       check_scan(&f.tree, ref_key(&refs[1500]), refs, count);
+
+  for (u32 i = 1000; ok && i < 3000; i += 10) {
+    ok = btree_insert(&f.tree, ref_key(&refs[i]), refs[i].value);
+    refs[i].is_present = true;
+  }
+  ok = ok && check_lookups(&f.tree, refs, count) &&
+       check_scan(&f.tree, ref_key(&refs[999]), refs, count);
+
+  for (u32 i = 0; ok && i < count; ++i) {
+    if (refs[i].is_present) {
+      ok = btree_delete(&f.tree, ref_key(&refs[i]));
+      refs[i].is_present = false;
+    }
+  }
+  ok = ok && check_scan(&f.tree, sv_from_parts("", 0), refs, count);
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Seeks to present keys, absent keys, the first and past the last key, and
+// compares each scan to the end of the tree with the reference. Every scan
+// from the front crosses hundreds of leaves through their sibling links.
+static bool test_range_scan_across_siblings(void) {
+  u32 count = 10000;
+  RefKey *refs = (RefKey *)malloc(count * sizeof(RefKey));
+  TEST_CHECK(refs);
+  make_keys(refs, count, 0, "scan/", 14, false);
+  BTreeFixture f;
+  TreeShape shape;
+  bool ok = fixture_init(&f) && insert_all(&f.tree, refs, count) &&
+            tree_shape(&f.tree, &shape) && shape.nodes[0] > 100;
+
+  for (u32 i = 0; ok && i < count; i += 611) {
+    RefKey absent = refs[i];
+    absent.data[absent.length - 1]++; // Between key i and key i + 1
+    ok = check_scan(&f.tree, ref_key(&refs[i]), refs, count) &&
+         check_scan(&f.tree, ref_key(&absent), refs, count);
+  }
+  ok = ok && check_scan(&f.tree, sv_from_cstr("scan"), refs, count) &&
+       check_scan(&f.tree, sv_from_cstr("scan/~"), refs, count);
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Readers look up and scan preloaded keys while writers fill the gaps between
+// them, splitting the very leaves being read. Every node stays pinned, so the
+// whole tree must fit in the pool; writers take turns on the tree's lock.
+static bool test_optimistic_readers_during_splits(void) {
+  u32 count = BT_TEST_PRELOADED * 3;
+  RefKey *refs = (RefKey *)malloc(count * sizeof(RefKey));
+  TEST_CHECK(refs);
+  for (u32 i = 0; i < count; ++i) {
+    olc_key(&refs[i], i);
+  }
+  BTreeFixture f;
+  bool ok = fixture_init(&f);
+  for (u32 i = 0; ok && i < BT_TEST_PRELOADED; ++i) {
+    const RefKey *ref = &refs[(u64)i * BT_TEST_STRIDE % BT_TEST_PRELOADED * 3];
+    ok = btree_insert(&f.tree, ref_key(ref), ref->value);
+  }
+  ok = ok && btree_enable_concurrency(&f.tree);
+  u64 preload_splits = f.tree.stats.leaf_splits;
+
+  ConcurrentSession sessions[BT_TEST_READERS + BT_TEST_WRITERS];
+  pthread_t threads[BT_TEST_READERS + BT_TEST_WRITERS];
+  pthread_barrier_t start;
+  bool stop = false;
+  u32 started = 0;
+  pthread_barrier_init(&start, NULL, ARRAY_SIZE(threads));
+  for (u32 t = 0; ok && t < ARRAY_SIZE(threads); ++t) {
+    bool is_writer = t >= BT_TEST_READERS;
+    sessions[t] = (ConcurrentSession){
+        .tree = &f.tree,
+        .start = &start,
+        .stop = &stop,
+        .writer_idx = is_writer ? t - BT_TEST_READERS : 0,
+        .rng_state = 0x9E3779B97F4A7C15ull * (t + 1),
+    };
+    ok = pthread_create(&threads[t], NULL,
+                        is_writer ? olc_writer_main : olc_reader_main,
+                        &sessions[t]) == 0;
+    started += ok;
+  }
+  if (started > 0 && started < ARRAY_SIZE(threads)) {
+    // The threads that did start would wait at the barrier forever.
+    LOG_FATAL("Failed to start the B+tree test threads");
+  }
+  for (u32 t = BT_TEST_READERS; t < started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+  u64 scans = 0;
+  for (u32 t = 0; t < started; ++t) {
+    if (t < BT_TEST_READERS) {
+      pthread_join(threads[t], NULL);
+      scans += sessions[t].scans;
+    }
+    ok &= sessions[t].ok;
+  }
+  pthread_barrier_destroy(&start);
+
+  ok = ok && scans > 0 && f.tree.stats.leaf_splits > preload_splits &&
+       check_lookups(&f.tree, refs, count) &&
+       check_scan(&f.tree, sv_from_parts("", 0), refs, count);
+  fixture_free(&f);
+  free(refs);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_splits_at_every_level),
+    TEST_CASE(test_inner_prefix_compression),
+    TEST_CASE(test_max_size_keys),
+    TEST_CASE(test_delete),
+    TEST_CASE(test_range_scan_across_siblings),
+    TEST_CASE(test_optimistic_readers_during_splits),
+};
+
+const TestSuite g_btree_tests = TEST_SUITE("btree", g_cases);
@@ -0,0 +1,148 @@
+// Checks victim selection when a dirty page cannot be written back: the page
+// stays resident with its policy state intact and the next candidate is
+// evicted instead.
+
+#include "../test.h"
+#include "sqldb/buffer_pool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define BP_TEST_PAGE_SIZE 4096
+#define BP_TEST_FRAMES 4
+
+static bool all_frames_evictable(usize frame_idx, void *ctx) {
+  (void)frame_idx;
+  (void)ctx;
+  return true;
+}
+
+// Picks 'count' victims and checks they are 'expected', in order.
+static bool picks_in_order(EvictionPolicy *policy, const usize *expected,
+                           usize count) {
+  for (usize i = 0; i < count; ++i) {
+    usize frame_idx;
+    TEST_CHECK(eviction_policy_pick_victim(policy, all_frames_evictable, NULL,
+                                           &frame_idx));
+    TEST_CHECK(frame_idx == expected[i]);
+  }
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_clock_reinstated_victim_goes_last(void) {
+  EvictionPolicyKind kind = EVICTION_POLICY_CLOCK;
+  Arena arena = arena_init(eviction_policy_required_arena_size(kind, 4));
+  EvictionPolicy policy;
+  TEST_CHECK(eviction_policy_init(&policy, kind, 4, &arena));
+  for (usize i = 0; i < 4; ++i) {
+    eviction_policy_on_insert(&policy, i, 100 + i);
+  }
+  usize victim;
+  TEST_CHECK(eviction_policy_pick_victim(&policy, all_frames_evictable, NULL,
+                                         &victim));
+  TEST_CHECK(victim == 0);
+  eviction_policy_on_reinstate(&policy, victim);
+  static const usize expected[] = {1, 2, 3, 0};
+  bool ok = picks_in_order(&policy, expected, ARRAY_SIZE(expected));
+  eviction_policy_free(&policy);
+  arena_free_all(&arena);
+  return ok;
+}
+
+// With 8 frames the A1in target is 2. Four pages in A1in are evicted oldest
+// first. Had the reinstated page been promoted into Am, it would be taken
+// as soon as A1in shrank to its target, ahead of pages 2 and 3.
+static bool test_2q_reinstated_victim_stays_in_a1in(void) {
+  EvictionPolicyKind kind = EVICTION_POLICY_2Q;
+  Arena arena = arena_init(eviction_policy_required_arena_size(kind, 8));
+  EvictionPolicy policy;
+  TEST_CHECK(eviction_policy_init(&policy, kind, 8, &arena));
+  for (usize i = 0; i < 4; ++i) {
+    eviction_policy_on_insert(&policy, i, 100 + i);
+  }
+  usize victim;
+  TEST_CHECK(eviction_policy_pick_victim(&policy, all_frames_evictable, NULL,
+                                         &victim));
+  TEST_CHECK(victim == 0);
+  eviction_policy_on_reinstate(&policy, victim);
+  static const usize expected[] = {1, 2, 3, 0};
+  bool ok = picks_in_order(&policy, expected, ARRAY_SIZE(expected));
+  eviction_policy_free(&policy);
+  arena_free_all(&arena);
+  return ok;
+}
+
+static bool test_failed_write_back_tries_next_victim(void) {
+  char path[] = "/tmp/sqldb_test_bp_XXXXXX";
+  int tmp_fd = mkstemp(path);
+  TEST_CHECK(tmp_fd >= 0);
+  close(tmp_fd);
+
+  PageFile file;
+  TEST_CHECK(pf_open(&file, path, BP_TEST_PAGE_SIZE, false, false));
+  EvictionPolicyKind kind = EVICTION_POLICY_2Q;
+  Arena arena = arena_init(bp_required_arena_size(
+      BP_TEST_FRAMES, BP_TEST_PAGE_SIZE, kind, false));
+  BufferPool bp;
+  TEST_CHECK(bp_init(&bp, &arena, BP_TEST_FRAMES, BP_TEST_PAGE_SIZE, kind,
+                     &file));
+  for (u32 i = 0; i < BP_TEST_FRAMES; ++i) {
+    PageId page_id;
+    BufferFrame *frame = bp_new_page(&bp, &page_id);
+    TEST_CHECK(frame && page_id == i);
+    bp_unpin_page(&bp, frame, true);
+  }
+  TEST_CHECK(bp_flush_all(&bp));
+
+  // Pages 0 and 1 are dirty again; 2 and 3 are clean.
+  for (PageId page_id = 0; page_id < 2; ++page_id) {
+    BufferFrame *frame = bp_fetch_page(&bp, page_id);
+    TEST_CHECK(frame);
+    frame->data[0] = 0x42;
+    bp_unpin_page(&bp, frame, true);
+  }
+
+  // Every write now fails.
+  int read_only_fd = open(path, O_RDONLY);
+  TEST_CHECK(read_only_fd >= 0);
+  TEST_CHECK(dup2(read_only_fd, file.fd) == file.fd);
+  close(read_only_fd);
+
+  PageId new_page_id;
+  BufferFrame *frame = NULL;
+  TEST_QUIETLY(frame = bp_new_page(&bp, &new_page_id));
+  TEST_CHECK(frame && new_page_id == BP_TEST_FRAMES);
+  TEST_CHECK(bp.stats.evictions == 1);
+  bp_unpin_page(&bp, frame, false);
+
+  // The dirty pages kept their updates and are still resident.
+  u64 hits = bp.stats.hits;
+  for (PageId page_id = 0; page_id < 2; ++page_id) {
+    BufferFrame *resident = bp_fetch_page(&bp, page_id);
+    TEST_CHECK(resident && resident->is_dirty && resident->data[0] == 0x42);
+    bp_unpin_page(&bp, resident, false);
+  }
+  TEST_CHECK(bp.stats.hits == hits + 2);
+
+  bp_shutdown(&bp);
+  pf_close(&file);
+  unlink(path);
+  arena_free_all(&arena);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_clock_reinstated_victim_goes_last),
+    TEST_CASE(test_2q_reinstated_victim_stays_in_a1in),
+    TEST_CASE(test_failed_write_back_tries_next_victim),
+};
+
+const TestSuite g_buffer_pool_tests = TEST_SUITE("buffer_pool", g_cases);
@@ -0,0 +1,132 @@
+// Checks the sharded map under concurrent writers: threads insert, replace
+// and remove disjoint key ranges at once while every shard resizes, with the
+// shards rehashing all at once and incrementally. Afterwards every key has
+// its last value, each shard holds exactly the keys its hash bits pick, and
+// the shard sizes add up.
+
+#include "../test.h"
+#include "sqldb/concurrent_map.h"
+
+#include <pthread.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define CMAP_TEST_THREADS 8
+#define CMAP_TEST_KEYS_PER_THREAD 20000
+#define CMAP_TEST_SHARDS 16
+
+typedef struct {
+  ConcurrentMap *map;
+  u64 *slots; // This thread's keys
+  bool ok;
+} WriterContext;
+
+// Inserts all of its keys, removes the odd ones and replaces the values of
+// the even ones with their successors.
+static void *writer_main(void *arg) {
+  WriterContext *ctx = (WriterContext *)arg;
+  ctx->ok = true;
+  for (u64 i = 0; i < CMAP_TEST_KEYS_PER_THREAD; ++i) {
+    ctx->ok &= cmap_insert(ctx->map, &ctx->slots[i], &ctx->slots[i]);
+  }
+  for (u64 i = 0; i < CMAP_TEST_KEYS_PER_THREAD; ++i) {
+    void *old_value = NULL;
+    if (i % 2 == 1) {
+      ctx->ok &= cmap_remove(ctx->map, &ctx->slots[i], &old_value);
+    } else {
+      ctx->ok &= cmap_put(ctx->map, &ctx->slots[i], &ctx->slots[i + 1],
+                          &old_value);
+    }
+    ctx->ok &= old_value == &ctx->slots[i];
+  }
+  return NULL;
+}
+
+static bool run_writers(ConcurrentMap *map, u64 *slots) {
+  WriterContext contexts[CMAP_TEST_THREADS];
+  pthread_t threads[CMAP_TEST_THREADS];
+  u32 started = 0;
+  for (u32 t = 0; t < CMAP_TEST_THREADS; ++t) {
+    contexts[t] = (WriterContext){
+        .map = map, .slots = &slots[t * CMAP_TEST_KEYS_PER_THREAD]};
+    if (pthread_create(&threads[t], NULL, writer_main, &contexts[t]) != 0) {
+      break;
+    }
+    started++;
+  }
+  bool ok = started == CMAP_TEST_THREADS;
+  for (u32 t = 0; t < started; ++t) {
+    pthread_join(threads[t], NULL);
+    ok = ok && contexts[t].ok;
+  }
+  return ok;
+}
+
+// Every key is where its hash says and has its writer's last value.
+static bool map_is_consistent(const ConcurrentMap *map, const u64 *slots,
+                              usize key_count) {
+  usize shard_total = 0;
+  for (u32 s = 0; s < map->shard_count; ++s) {
+    const BaseHashTableOA *table = &map->shards[s].table;
+    HashTableIteratorOA iter = ht_oa_iterator_begin(table);
+    const void *key;
+    void *value;
+    while (ht_oa_iterator_next(&iter, &key, &value)) {
+      TEST_CHECK((u32)(map->hash_fn(key) >> map->shard_shift) == s);
+      usize index = (usize)((const u64 *)key - slots);
+      TEST_CHECK(index < key_count && index % 2 == 0);
+      TEST_CHECK(value == &slots[index + 1]);
+    }
+    TEST_CHECK(ht_oa_size(table) > 0);
+    shard_total += ht_oa_size(table);
+  }
+  for (usize i = 0; i < key_count; ++i) {
+    void *expected = i % 2 == 0 ? (void *)&slots[i + 1] : NULL;
+    TEST_CHECK(cmap_get(map, &slots[i]) == expected);
+  }
+  TEST_CHECK(shard_total == key_count / 2);
+  TEST_CHECK(cmap_size(map) == key_count / 2);
+  return true;
+}
+
+// A capacity of 0 makes every shard resize while the writers run.
+static bool writers_agree(bool incremental) {
+  usize key_count = CMAP_TEST_THREADS * CMAP_TEST_KEYS_PER_THREAD;
+  u64 *slots = (u64 *)malloc(key_count * sizeof(u64));
+  TEST_CHECK(slots);
+  for (usize i = 0; i < key_count; ++i) {
+    slots[i] = i * 0x9E3779B97F4A7C15ULL;
+  }
+  ConcurrentMap map;
+  bool ok = cmap_init(&map, CMAP_TEST_SHARDS, 0, base_hash_u64,
+                      base_key_equal_u64);
+  if (ok) {
+    cmap_set_incremental(&map, incremental);
+    ok = run_writers(&map, slots) && map_is_consistent(&map, slots, key_count);
+    cmap_clear(&map);
+    ok = ok && cmap_size(&map) == 0 && !cmap_get(&map, &slots[0]);
+    cmap_free(&map);
+  }
+  free(slots);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_concurrent_writers(void) { return writers_agree(false); }
+
+static bool test_concurrent_writers_incremental(void) {
+  return writers_agree(true);
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_concurrent_writers),
+    TEST_CASE(test_concurrent_writers_incremental),
+};
+
+const TestSuite g_concurrent_map_tests = TEST_SUITE("concurrent_map", g_cases);
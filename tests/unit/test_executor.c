@@ -0,0 +1,189 @@
+// Checks that operators spilling to temp files release them when the plan
+// stops early: a LIMIT over a spilling sort or radix join closes its input
+// once it has its rows, and exec_close releases whatever is left. Also checks
+// that a radix join over skewed string keys stays near its memory budget.
+
+#include "../test.h"
+#include "sqldb/executor.h"
+
+#include <dirent.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define EXEC_TEST_ROWS (64 * EXEC_BATCH_SIZE)
+#define EXEC_TEST_ARENA_SIZE (64 * 1024 * 1024)
+#define EXEC_TEST_BUDGET (64 * 1024) // Small enough that every input spills
+
+static u32 open_fd_count(void) {
+  DIR *dir = opendir("/proc/self/fd");
+  if (!dir) {
+    return 0;
+  }
+  u32 count = 0;
+  while (readdir(dir) != NULL) {
+    count++;
+  }
+  closedir(dir);
+  return count;
+}
+
+// One INT64 column of keys in descending order, so sorts have work to do.
+static bool make_table(ExecContext *ctx, ExecTable *table, ExecVector *column) {
+  column->type = EXEC_TYPE_INT64;
+  column->i64s = (i64 *)exec_alloc(ctx, EXEC_TEST_ROWS * sizeof(i64));
+  TEST_CHECK(column->i64s);
+  for (usize i = 0; i < EXEC_TEST_ROWS; ++i) {
+    column->i64s[i] = (i64)(EXEC_TEST_ROWS - i);
+  }
+  *table = (ExecTable){column, 1, EXEC_TEST_ROWS};
+  return true;
+}
+
+// Pulls the single batch LIMIT 10 returns and checks the files are closed
+// before the plan runs out.
+static bool limit_closes_input(ExecContext *ctx, ExecOperator *spilling,
+                               u32 fds_before) {
+  ExecOperator *root = exec_limit(ctx, spilling, 10, 0);
+  TEST_CHECK(root);
+  ExecBatch *batch = exec_next(root);
+  TEST_CHECK(batch && batch->selected_count == 10);
+  TEST_CHECK(spilling->is_closed);
+  TEST_CHECK(open_fd_count() == fds_before);
+  TEST_CHECK(exec_next(root) == NULL);
+  exec_close(root);
+  exec_close(root);
+  TEST_CHECK(!ctx->has_error);
+  return true;
+}
+
+// One STRING column of EXEC_TEST_ROWS copies of one long key: the worst skew,
+// where every build row hashes to the same spill file.
+static bool make_skewed_table(ExecContext *ctx, ExecTable *table,
+                              ExecVector *column, usize rows) {
+  static const char key[] = "a join key long enough that copying every "
+                            "spilled copy of it adds up";
+  column->type = EXEC_TYPE_STRING;
+  column->strings = (StringView *)exec_alloc(ctx, rows * sizeof(StringView));
+  TEST_CHECK(column->strings);
+  for (usize i = 0; i < rows; ++i) {
+    column->strings[i] = sv_from_parts(key, sizeof(key) - 1);
+  }
+  *table = (ExecTable){column, 1, rows};
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_limit_closes_sort_runs(void) {
+  Arena arena = arena_init(EXEC_TEST_ARENA_SIZE);
+  ExecContext ctx = {.arena = &arena, .has_error = false};
+  ExecTable table;
+  ExecVector column;
+  bool ok = make_table(&ctx, &table, &column);
+  u32 fds_before = open_fd_count();
+  static const u32 columns[] = {0};
+  static const ExecSortKey keys[] = {{0, false}};
+  ExecOperator *sort = exec_external_sort(
+      &ctx, exec_scan(&ctx, &table, columns, 1), keys, 1, EXEC_TEST_BUDGET);
+  ok = ok && sort && limit_closes_input(&ctx, sort, fds_before);
+  ok = ok && exec_sort_stats(sort).runs > 1;
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_limit_closes_join_spill_files(void) {
+  Arena arena = arena_init(EXEC_TEST_ARENA_SIZE);
+  ExecContext ctx = {.arena = &arena, .has_error = false};
+  ExecTable table;
+  ExecVector column;
+  bool ok = make_table(&ctx, &table, &column);
+  u32 fds_before = open_fd_count();
+  static const u32 columns[] = {0};
+  ExecOperator *build = exec_scan(&ctx, &table, columns, 1);
+  ExecOperator *probe = exec_scan(&ctx, &table, columns, 1);
+  ExecOperator *join =
+      build && probe
+          ? exec_radix_join(&ctx, build,
+                            exec_expr_column(&ctx, 0, EXEC_TYPE_INT64), probe,
+                            exec_expr_column(&ctx, 0, EXEC_TYPE_INT64),
+                            EXEC_TEST_BUDGET, NULL)
+          : NULL;
+  ok = ok && join && limit_closes_input(&ctx, join, fds_before);
+  ok = ok && exec_radix_join_stats(join).spill_partitions > 0;
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Closing a plan that was never pulled, or only partly, releases its files.
+static bool test_close_undrained_sort(void) {
+  Arena arena = arena_init(EXEC_TEST_ARENA_SIZE);
+  ExecContext ctx = {.arena = &arena, .has_error = false};
+  ExecTable table;
+  ExecVector column;
+  bool ok = make_table(&ctx, &table, &column);
+  u32 fds_before = open_fd_count();
+  static const u32 columns[] = {0};
+  static const ExecSortKey keys[] = {{0, true}};
+  ExecOperator *sort = exec_external_sort(
+      &ctx, exec_scan(&ctx, &table, columns, 1), keys, 1, EXEC_TEST_BUDGET);
+  ExecBatch *batch = sort ? exec_next(sort) : NULL;
+  ok = ok && batch && batch->columns[0].i64s[0] == EXEC_TEST_ROWS;
+  ok = ok && open_fd_count() > fds_before;
+  exec_close(sort);
+  ok = ok && open_fd_count() == fds_before && exec_next(sort) == NULL;
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// A spill file of build rows far over the budget is joined in pieces, and
+// strings read back reuse their buffers instead of piling up in the arena.
+static bool test_skewed_string_join_stays_in_budget(void) {
+  Arena arena = arena_init(EXEC_TEST_ARENA_SIZE);
+  ExecContext ctx = {.arena = &arena, .has_error = false};
+  ExecTable build_table, probe_table;
+  ExecVector build_column, probe_column;
+  bool ok = make_skewed_table(&ctx, &build_table, &build_column,
+                              EXEC_TEST_ROWS) &&
+            make_skewed_table(&ctx, &probe_table, &probe_column, 2);
+  static const u32 columns[] = {0};
+  ExecOperator *join = exec_radix_join(
+      &ctx, exec_scan(&ctx, &build_table, columns, 1),
+      exec_expr_column(&ctx, 0, EXEC_TYPE_STRING),
+      exec_scan(&ctx, &probe_table, columns, 1),
+      exec_expr_column(&ctx, 0, EXEC_TYPE_STRING), EXEC_TEST_BUDGET, NULL);
+  ok = ok && join;
+  usize used_before = arena_used(&arena);
+  u64 matches = 0;
+  ExecBatch *batch;
+  while (ok && (batch = exec_next(join)) != NULL) {
+    for (u32 i = 0; i < batch->selected_count; ++i) {
+      ok = ok && sv_equals(batch->columns[1].strings[i],
+                           build_column.strings[0]);
+    }
+    matches += batch->selected_count;
+  }
+  usize string_bytes = EXEC_TEST_ROWS * build_column.strings[0].length;
+  ok = ok && !ctx.has_error && matches == 2 * (u64)EXEC_TEST_ROWS;
+  ok = ok && exec_radix_join_stats(join).probe_rescans > 0;
+  ok = ok && arena_used(&arena) - used_before < string_bytes / 4;
+  exec_close(join);
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_limit_closes_sort_runs),
+    TEST_CASE(test_limit_closes_join_spill_files),
+    TEST_CASE(test_close_undrained_sort),
+    TEST_CASE(test_skewed_string_join_stays_in_budget),
+};
+
+const TestSuite g_executor_tests = TEST_SUITE("executor", g_cases);
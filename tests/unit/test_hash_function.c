@@ -0,0 +1,129 @@
+// Checks the byte hash and the checksum against published values: wyhash
+// (final version 4) against its reference test vectors, and CRC-32C against
+// the iSCSI ones (RFC 3720). The crc32 instruction and the lookup table agree
+// at every length and alignment, also when a checksum is extended across a
+// split, and every input bit, the length and the seed change the hash.
+
+#include "../test.h"
+#include "sqldb/checksum.h"
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define HASH_TEST_MAX_LENGTH 256
+#define HASH_TEST_BUFFER_SIZE (HASH_TEST_MAX_LENGTH + 8)
+
+static void fill_random(u8 *buffer, usize size) {
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  for (usize i = 0; i < size; ++i) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    buffer[i] = (u8)rng;
+  }
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// The vectors of the reference implementation, each hashed with its index as
+// the seed.
+static bool test_wyhash_known_answers(void) {
+  static const struct {
+    const char *text;
+    u64 hash;
+  } vectors[] = {
+      {"", 0x93228A4DE0EEC5A2ULL},
+      {"a", 0xC5BAC3DB178713C4ULL},
+      {"abc", 0xA97F2F7B1D9B3314ULL},
+      {"message digest", 0x786D1F1DF3801DF4ULL},
+      {"abcdefghijklmnopqrstuvwxyz", 0xDCA5A8138AD37C87ULL},
+      {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+       0xB9E734F117CFAF70ULL},
+      {"1234567890123456789012345678901234567890"
+       "1234567890123456789012345678901234567890",
+       0x6CC5EAB49A92D617ULL},
+  };
+  for (u64 i = 0; i < ARRAY_SIZE(vectors); ++i) {
+    const char *text = vectors[i].text;
+    TEST_CHECK(base_hash_bytes_seeded(text, strlen(text), i) ==
+               vectors[i].hash);
+  }
+  return true;
+}
+
+static bool test_wyhash_uses_every_input(void) {
+  u8 buffer[HASH_TEST_BUFFER_SIZE];
+  fill_random(buffer, sizeof(buffer));
+  for (usize len = 0; len <= HASH_TEST_MAX_LENGTH; ++len) {
+    u64 hash = base_hash_bytes(buffer, len);
+    TEST_CHECK(base_hash_bytes_seeded(buffer, len, base_hash_seed() + 2) !=
+               hash);
+    for (usize bit = 0; bit < len * 8; ++bit) {
+      buffer[bit / 8] ^= (u8)(1u << (bit % 8));
+      bool changed = base_hash_bytes(buffer, len) != hash;
+      buffer[bit / 8] ^= (u8)(1u << (bit % 8));
+      TEST_CHECK(changed);
+    }
+  }
+  // Zero bytes of different lengths hash differently.
+  u8 zeros[64] = {0};
+  for (usize len = 1; len < sizeof(zeros); ++len) {
+    TEST_CHECK(base_hash_bytes(zeros, len) != base_hash_bytes(zeros, len - 1));
+  }
+  return true;
+}
+
+static bool test_crc32c_known_answers(void) {
+  u8 zeros[32] = {0};
+  u8 ones[32];
+  u8 ascending[32];
+  u8 descending[32];
+  for (u32 i = 0; i < 32; ++i) {
+    ones[i] = 0xFF;
+    ascending[i] = (u8)i;
+    descending[i] = (u8)(31 - i);
+  }
+  static const char digits[] = "123456789";
+  TEST_CHECK(crc32c(0, digits, 9) == 0xE3069283u);
+  TEST_CHECK(crc32c(0, zeros, 32) == 0x8A9136AAu);
+  TEST_CHECK(crc32c(0, ones, 32) == 0x62A8AB43u);
+  TEST_CHECK(crc32c(0, ascending, 32) == 0x46DD794Eu);
+  TEST_CHECK(crc32c(0, descending, 32) == 0x113FDB5Cu);
+  TEST_CHECK(crc32c_portable(0, digits, 9) == 0xE3069283u);
+  TEST_CHECK(crc32c_portable(0, ones, 32) == 0x62A8AB43u);
+  TEST_CHECK(crc32c(0, NULL, 0) == 0);
+  return true;
+}
+
+// Without SSE4.2 both sides are the table, and this only checks the splits.
+static bool test_crc32c_hardware_matches_table(void) {
+  u8 buffer[HASH_TEST_BUFFER_SIZE];
+  fill_random(buffer, sizeof(buffer));
+  for (usize offset = 0; offset < 8; ++offset) {
+    for (usize len = 0; len <= HASH_TEST_MAX_LENGTH; ++len) {
+      const u8 *data = buffer + offset;
+      u32 expected = crc32c_portable(0, data, len);
+      TEST_CHECK(crc32c(0, data, len) == expected);
+      // Extended across a split, as WAL records are.
+      usize split = len / 3;
+      TEST_CHECK(crc32c(crc32c(0, data, split), data + split, len - split) ==
+                 expected);
+      TEST_CHECK(crc32c_portable(crc32c(0, data, split), data + split,
+                                 len - split) == expected);
+    }
+  }
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_wyhash_known_answers),
+    TEST_CASE(test_wyhash_uses_every_input),
+    TEST_CASE(test_crc32c_known_answers),
+    TEST_CASE(test_crc32c_hardware_matches_table),
+};
+
+const TestSuite g_hash_function_tests =
+    TEST_SUITE("hash_function", g_cases);
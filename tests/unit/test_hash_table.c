@@ -0,0 +1,318 @@
+// Checks the hash tables against each other and at their edge cases: the Swiss
+// table agrees with BaseHashTableOA over random operations, probes past full
+// groups, and reuses its tombstones instead of growing; the incremental
+// BaseHashTableOA agrees with the stop-the-world one, on the heap and in an
+// arena, finds keys in both arrays while a resize is in progress, and leaves
+// no drained array behind in its arena.
+
+#include "../test.h"
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define HT_TEST_KEY_RANGE 4096
+#define HT_TEST_OPS 200000
+#define HT_TEST_ARENA_SIZE (16 * 1024 * 1024)
+#define HT_TEST_GROUP_KEYS 40 // Of the same home group; spill over 2 groups
+
+HT_SWISS_DECLARE(TestTable, u64, u64)
+HT_SWISS_DEFINE(TestTable, u64, u64, base_mix_u64, BASE_HT_SWISS_EQUAL)
+
+// Every key starts probing at group 0; the tag is the key's low 7 bits.
+#define HT_TEST_SAME_GROUP_HASH(key) ((u64)(key) << 57)
+
+HT_SWISS_DECLARE(SameGroupTable, u64, u64)
+HT_SWISS_DEFINE(SameGroupTable, u64, u64, HT_TEST_SAME_GROUP_HASH,
+                BASE_HT_SWISS_EQUAL)
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Keys spread over the whole key space; the OA tables point at them.
+static u64 *make_slots(usize count) {
+  u64 *slots = (u64 *)malloc(count * sizeof(u64));
+  for (usize k = 0; slots && k < count; ++k) {
+    slots[k] = k * 0x9E3779B97F4A7C15ULL;
+  }
+  return slots;
+}
+
+static usize find_slot(const SameGroupTable *ht, u64 key) {
+  for (usize i = 0; i < ht->capacity; ++i) {
+    if (!(ht->ctrl[i] & BASE_HT_SWISS_EMPTY) && ht->keys[i] == key) {
+      return i;
+    }
+  }
+  return BASE_HT_SWISS_NOT_FOUND;
+}
+
+// Runs HT_TEST_OPS random operations against a stop-the-world table and an
+// incremental one and compares every result. Inserts alone grow both to the
+// whole key range, then removals are as likely as inserts, so resizes happen
+// while tombstones pile up in both arrays.
+static bool incremental_agrees(const u64 *slots, Arena *reference_arena,
+                               Arena *incremental_arena) {
+  BaseHashTableOA reference =
+      ht_oa_init(0, base_hash_u64, base_key_equal_u64, reference_arena);
+  BaseHashTableOA incremental =
+      ht_oa_init(0, base_hash_u64, base_key_equal_u64, incremental_arena);
+  ht_oa_set_incremental(&incremental, true);
+  u64 rng = 0x2545F4914F6CDD1DULL;
+  bool ok = true;
+  for (u64 i = 0; i < HT_TEST_OPS && ok; ++i) {
+    u64 r = next_random(&rng);
+    const u64 *key = &slots[(r >> 8) % HT_TEST_KEY_RANGE];
+    switch (i < HT_TEST_OPS / 4 ? 0 : r % 8) {
+    case 0:
+    case 1:
+      ok = ht_oa_insert(&reference, key, (void *)key) ==
+           ht_oa_insert(&incremental, key, (void *)key);
+      break;
+    case 2:
+      ok = ht_oa_put(&reference, key, (void *)key) &&
+           ht_oa_put(&incremental, key, (void *)key);
+      break;
+    case 3:
+    case 4:
+    case 5:
+      ok = ht_oa_remove(&reference, key) == ht_oa_remove(&incremental, key);
+      break;
+    default:
+      ok = ht_oa_get(&reference, key) == ht_oa_get(&incremental, key);
+      break;
+    }
+    ok = ok && ht_oa_size(&reference) == ht_oa_size(&incremental);
+  }
+
+  // Every key the incremental table iterates over, in either of its arrays,
+  // is in the reference table once.
+  HashTableIteratorOA iter = ht_oa_iterator_begin(&incremental);
+  const void *key;
+  void *value;
+  usize iterated = 0;
+  while (ok && ht_oa_iterator_next(&iter, &key, &value)) {
+    ok = ht_oa_get(&reference, key) == value;
+    iterated++;
+  }
+  ok = ok && iterated == ht_oa_size(&reference);
+  ht_oa_free(&reference);
+  ht_oa_free(&incremental);
+  return ok;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// A key range small enough that removals keep cycling slots through
+// tombstones, with both tables emptied now and then.
+static bool test_swiss_matches_oa(void) {
+  u64 *slots = make_slots(HT_TEST_KEY_RANGE);
+  TEST_CHECK(slots);
+  BaseHashTableOA oa = ht_oa_init(0, base_hash_u64, base_key_equal_u64, NULL);
+  TestTable swiss = ht_TestTable_init(0);
+  u64 rng = 0x2545F4914F6CDD1DULL;
+  bool ok = true;
+  for (u64 i = 0; i < HT_TEST_OPS && ok; ++i) {
+    u64 r = next_random(&rng);
+    u64 *key = &slots[(r >> 8) % HT_TEST_KEY_RANGE];
+    switch (r % 8) {
+    case 0:
+    case 1:
+      ok = ht_oa_insert(&oa, key, key) ==
+           ht_TestTable_insert(&swiss, *key, *key);
+      break;
+    case 2:
+      ok = ht_oa_put(&oa, key, key) && ht_TestTable_put(&swiss, *key, *key);
+      break;
+    case 3:
+    case 4:
+    case 5:
+      ok = ht_oa_remove(&oa, key) == ht_TestTable_remove(&swiss, *key);
+      break;
+    default: {
+      u64 *oa_value = (u64 *)ht_oa_get(&oa, key);
+      u64 *swiss_value = ht_TestTable_get(&swiss, *key);
+      ok = oa_value ? swiss_value && *swiss_value == *oa_value : !swiss_value;
+      break;
+    }
+    }
+    if (i % 50000 == 49999) {
+      ht_oa_clear(&oa);
+      ht_TestTable_clear(&swiss);
+    }
+    ok = ok && ht_oa_size(&oa) == ht_TestTable_size(&swiss);
+  }
+
+  // Every key the Swiss table iterates over is in the OA table once.
+  usize cursor = 0;
+  usize iterated = 0;
+  u64 key;
+  u64 value;
+  while (ok && ht_TestTable_next(&swiss, &cursor, &key, &value)) {
+    u64 *oa_value = (u64 *)ht_oa_get(&oa, &key);
+    ok = oa_value && *oa_value == value;
+    iterated++;
+  }
+  ok = ok && iterated == ht_oa_size(&oa);
+  ht_oa_free(&oa);
+  ht_TestTable_free(&swiss);
+  free(slots);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Keys of one home group fill it and spill into the groups after it; lookups
+// of the spilled keys and misses both have to probe past the full group.
+static bool test_swiss_full_group_probing(void) {
+  SameGroupTable ht = ht_SameGroupTable_init(100);
+  TEST_CHECK(ht.capacity > 2 * BASE_HT_SWISS_GROUP_SIZE);
+  bool ok = true;
+  for (u64 k = 0; k < HT_TEST_GROUP_KEYS && ok; ++k) {
+    ok = ht_SameGroupTable_insert(&ht, k, k * 10);
+  }
+  // No slot of the home group is left empty, and some keys live elsewhere.
+  ok = ok && base_swiss_match_free(ht.ctrl) == 0 &&
+       find_slot(&ht, HT_TEST_GROUP_KEYS - 1) >= BASE_HT_SWISS_GROUP_SIZE;
+  for (u64 k = 0; k < HT_TEST_GROUP_KEYS && ok; ++k) {
+    u64 *value = ht_SameGroupTable_get(&ht, k);
+    ok = value && *value == k * 10;
+  }
+  // Same tags as the stored keys, so every candidate slot is compared.
+  for (u64 k = 128; k < 128 + HT_TEST_GROUP_KEYS && ok; ++k) {
+    ok = !ht_SameGroupTable_get(&ht, k);
+  }
+  ok = ok && ht_SameGroupTable_size(&ht) == HT_TEST_GROUP_KEYS;
+  ht_SameGroupTable_free(&ht);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Removing from a full group leaves a tombstone that later probes step over
+// and the next insert on that probe sequence fills, so churn at a steady size
+// neither grows the table nor uses up its empty slots.
+static bool test_swiss_tombstone_reuse(void) {
+  SameGroupTable ht = ht_SameGroupTable_init(100);
+  bool ok = true;
+  for (u64 k = 0; k < HT_TEST_GROUP_KEYS && ok; ++k) {
+    ok = ht_SameGroupTable_insert(&ht, k, k);
+  }
+  TEST_CHECK(ok);
+  usize capacity = ht.capacity;
+  usize growth_left = ht.growth_left;
+
+  usize slot = find_slot(&ht, 3);
+  ok = slot < BASE_HT_SWISS_GROUP_SIZE && ht_SameGroupTable_remove(&ht, 3) &&
+       ht.ctrl[slot] == BASE_HT_SWISS_DELETED &&
+       ht.growth_left == growth_left && !ht_SameGroupTable_get(&ht, 3);
+  // Spilled keys are still found past the tombstone.
+  ok = ok && ht_SameGroupTable_get(&ht, HT_TEST_GROUP_KEYS - 1);
+  ok = ok && ht_SameGroupTable_insert(&ht, 1000, 1000) &&
+       find_slot(&ht, 1000) == slot && ht.growth_left == growth_left;
+
+  // Replace every key many times over, oldest first.
+  for (u64 k = 0; k < 50 * HT_TEST_GROUP_KEYS && ok; ++k) {
+    u64 old_key = k < HT_TEST_GROUP_KEYS ? (k == 3 ? 1000 : k)
+                                         : 2000 + k - HT_TEST_GROUP_KEYS;
+    ok = ht_SameGroupTable_remove(&ht, old_key) &&
+         ht_SameGroupTable_insert(&ht, 2000 + k, k);
+  }
+  ok = ok && ht.capacity == capacity && ht.growth_left == growth_left &&
+       ht_SameGroupTable_size(&ht) == HT_TEST_GROUP_KEYS;
+  for (u64 k = 49 * HT_TEST_GROUP_KEYS; k < 50 * HT_TEST_GROUP_KEYS && ok;
+       ++k) {
+    u64 *value = ht_SameGroupTable_get(&ht, 2000 + k);
+    ok = value && *value == k;
+  }
+  ht_SameGroupTable_free(&ht);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_incremental_matches_stop_the_world(void) {
+  u64 *slots = make_slots(HT_TEST_KEY_RANGE);
+  TEST_CHECK(slots);
+  bool ok = incremental_agrees(slots, NULL, NULL);
+  free(slots);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// In an arena, only the incremental table's first array stays behind: the
+// ones it grows into come from the heap and are freed once drained.
+static bool test_incremental_in_arena(void) {
+  u64 *slots = make_slots(HT_TEST_KEY_RANGE);
+  Arena reference_arena = arena_init(HT_TEST_ARENA_SIZE);
+  Arena incremental_arena = arena_init(HT_TEST_ARENA_SIZE);
+  bool ok = slots && reference_arena.buffer && incremental_arena.buffer &&
+            incremental_agrees(slots, &reference_arena, &incremental_arena);
+  usize first_array = BASE_HT_OA_DEFAULT_CAPACITY * sizeof(HashTableEntryOA);
+  ok = ok && arena_used(&incremental_arena) <= first_array + 64 &&
+       arena_used(&reference_arena) > 16 * first_array;
+  free(slots);
+  arena_free_all(&reference_arena);
+  arena_free_all(&incremental_arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Stops writing halfway through a migration: lookups have to find the keys
+// still in the old array and the ones already moved, and iteration has to
+// return each of them once. Early odd keys are removed along the way, so
+// removals hit both arrays too.
+static bool test_incremental_lookup_across_arrays(void) {
+  u64 *slots = make_slots(HT_TEST_KEY_RANGE);
+  TEST_CHECK(slots);
+  BaseHashTableOA ht = ht_oa_init(0, base_hash_u64, base_key_equal_u64, NULL);
+  ht_oa_set_incremental(&ht, true);
+  bool present[HT_TEST_KEY_RANGE] = {0};
+  usize present_count = 0;
+  bool ok = true;
+  for (usize k = 0; k < HT_TEST_KEY_RANGE && ok; ++k) {
+    ok = ht_oa_insert(&ht, &slots[k], &slots[k]);
+    present[k] = true;
+    present_count++;
+    if (k % 2 == 0 && k / 2 % 2 == 1) {
+      ok = ok && ht_oa_remove(&ht, &slots[k / 2]);
+      present[k / 2] = false;
+      present_count--;
+    }
+    if (ht.old_entries && ht.old_item_count <= ht.item_count / 2) {
+      break;
+    }
+  }
+  ok = ok && ht.old_entries != NULL && ht.old_item_count > 0;
+  for (usize k = 0; k < HT_TEST_KEY_RANGE && ok; ++k) {
+    ok = ht_oa_get(&ht, &slots[k]) == (present[k] ? &slots[k] : NULL) &&
+         ht_oa_contains(&ht, &slots[k]) == present[k];
+  }
+  HashTableIteratorOA iter = ht_oa_iterator_begin(&ht);
+  const void *key;
+  void *value;
+  usize iterated = 0;
+  while (ok && ht_oa_iterator_next(&iter, &key, &value)) {
+    ok = key == value && present[(const u64 *)key - slots];
+    iterated++;
+  }
+  ok = ok && iterated == present_count && ht_oa_size(&ht) == present_count;
+  ht_oa_free(&ht);
+  free(slots);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_swiss_matches_oa),
+    TEST_CASE(test_swiss_full_group_probing),
+    TEST_CASE(test_swiss_tombstone_reuse),
+    TEST_CASE(test_incremental_matches_stop_the_world),
+    TEST_CASE(test_incremental_in_arena),
+    TEST_CASE(test_incremental_lookup_across_arrays),
+};
+
+const TestSuite g_hash_table_tests = TEST_SUITE("hash_table", g_cases);
@@ -0,0 +1,291 @@
+// Checks the slotted heap page: freed slots are reused lowest first and
+// trailing ones are trimmed, compaction keeps slot numbers and tuple bytes,
+// tuples that exactly fill a page fit (and one byte more does not), and the
+// heap file keeps the free space map in step after deletes and after inserts
+// that had to compact a page.
+
+#include "../test.h"
+#include "sqldb/heap_file.h"
+
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define HEAP_TEST_PAGE_SIZE 4096
+#define HEAP_TEST_FRAMES 16
+
+// Tuple 'id' of 'length' bytes; every byte identifies the tuple and position.
+static void fill_tuple(u8 *data, u32 length, u32 id) {
+  for (u32 i = 0; i < length; ++i) {
+    data[i] = (u8)(id * 31 + i);
+  }
+}
+
+static bool tuple_matches(const u8 *page, u16 slot, u32 length, u32 id) {
+  u8 expected[HEAP_PAGE_MAX_SIZE];
+  fill_tuple(expected, length, id);
+  u32 stored_length = 0;
+  const u8 *tuple = heap_page_get(page, slot, &stored_length);
+  TEST_CHECK(tuple && stored_length == length);
+  TEST_CHECK(memcmp(tuple, expected, length) == 0);
+  return true;
+}
+
+static bool insert_tuple(u8 *page, u32 length, u32 id, u16 *out_slot) {
+  u8 data[HEAP_PAGE_MAX_SIZE];
+  fill_tuple(data, length, id);
+  return heap_page_insert(page, data, length, out_slot);
+}
+
+typedef struct {
+  char path[32];
+  PageFile file;
+  Arena arena;
+  BufferPool bp;
+  HeapFile heap;
+  bool has_file;
+  bool has_bp;
+} HeapFixture;
+
+static bool fixture_init(HeapFixture *f) {
+  ZERO_STRUCT(*f);
+  char path[] = "/tmp/sqldb_test_heap_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_CHECK(fd >= 0);
+  close(fd);
+  memcpy(f->path, path, sizeof(path));
+  f->has_file = pf_open(&f->file, f->path, HEAP_TEST_PAGE_SIZE, false, false);
+  TEST_CHECK(f->has_file);
+  f->arena = arena_init(bp_required_arena_size(
+      HEAP_TEST_FRAMES, HEAP_TEST_PAGE_SIZE, DEFAULT_EVICTION_POLICY, false));
+  f->has_bp = bp_init(&f->bp, &f->arena, HEAP_TEST_FRAMES, HEAP_TEST_PAGE_SIZE,
+                      DEFAULT_EVICTION_POLICY, &f->file);
+  TEST_CHECK(f->has_bp);
+  heap_file_init(&f->heap, &f->bp);
+  return true;
+}
+
+static void fixture_free(HeapFixture *f) {
+  if (f->has_bp) {
+    heap_file_free(&f->heap);
+    bp_shutdown(&f->bp);
+  }
+  arena_free_all(&f->arena);
+  if (f->has_file) {
+    pf_close(&f->file);
+  }
+  if (f->path[0]) {
+    unlink(f->path);
+  }
+}
+
+// The map's category for 'page_id' must match the page's free space now.
+static bool fsm_matches_page(HeapFixture *f, PageId page_id) {
+  BufferFrame *frame = bp_fetch_page(&f->bp, page_id);
+  TEST_CHECK(frame);
+  u32 free_bytes = heap_page_free_space(frame->data);
+  bool is_valid = heap_page_is_valid(frame->data, HEAP_TEST_PAGE_SIZE);
+  bp_unpin_page(&f->bp, frame, false);
+  TEST_CHECK(is_valid);
+  u32 category = MIN(free_bytes / f->heap.fsm.category_bytes,
+                     FSM_CATEGORY_COUNT - 1u);
+  TEST_CHECK(f->heap.fsm.categories[page_id] == category);
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// Inserts take the lowest free slot before growing the directory. Deleting
+// the last slots shrinks the directory; deleting others keeps their numbers.
+static bool test_slot_reuse(void) {
+  u8 page[HEAP_TEST_PAGE_SIZE];
+  heap_page_init(page, sizeof(page));
+  for (u32 i = 0; i < 6; ++i) {
+    u16 slot;
+    TEST_CHECK(insert_tuple(page, 40 + i, i, &slot) && slot == i);
+  }
+  TEST_CHECK(heap_page_delete(page, 3) && heap_page_delete(page, 1));
+  TEST_CHECK(!heap_page_delete(page, 1));
+  TEST_CHECK(heap_page_slot_count(page) == 6 &&
+             heap_page_live_count(page) == 4);
+
+  u16 slot;
+  TEST_CHECK(insert_tuple(page, 50, 100, &slot) && slot == 1);
+  TEST_CHECK(insert_tuple(page, 60, 101, &slot) && slot == 3);
+  TEST_CHECK(insert_tuple(page, 70, 102, &slot) && slot == 6);
+  TEST_CHECK(tuple_matches(page, 0, 40, 0) && tuple_matches(page, 1, 50, 100) &&
+             tuple_matches(page, 2, 42, 2) && tuple_matches(page, 3, 60, 101) &&
+             tuple_matches(page, 4, 44, 4) && tuple_matches(page, 5, 45, 5) &&
+             tuple_matches(page, 6, 70, 102));
+
+  // Trailing free slots are trimmed, down to the last live one.
+  TEST_CHECK(heap_page_delete(page, 5) && heap_page_slot_count(page) == 7);
+  TEST_CHECK(heap_page_delete(page, 6) && heap_page_slot_count(page) == 5);
+  u32 length;
+  TEST_CHECK(!heap_page_get(page, 5, &length));
+  for (u16 i = 0; i < 5; ++i) {
+    TEST_CHECK(heap_page_delete(page, i));
+  }
+  TEST_CHECK(heap_page_slot_count(page) == 0 &&
+             heap_page_live_count(page) == 0);
+  TEST_CHECK(heap_page_free_space(page) ==
+             heap_page_max_tuple_size(HEAP_TEST_PAGE_SIZE));
+  TEST_CHECK(heap_page_is_valid(page, HEAP_TEST_PAGE_SIZE));
+  return true;
+}
+
+// Deleting every other tuple leaves free space in holes. An insert that only
+// fits once the holes are merged compacts the page; slot numbers and the
+// bytes of the surviving tuples are unchanged, and so are growing updates.
+static bool test_compaction(void) {
+  u8 page[HEAP_TEST_PAGE_SIZE];
+  heap_page_init(page, sizeof(page));
+  u32 count = 0;
+  u16 slot;
+  while (insert_tuple(page, 100, count, &slot)) {
+    TEST_CHECK(slot == count);
+    count++;
+  }
+  TEST_CHECK(count > 10);
+  for (u16 i = 0; i < count; i += 2) {
+    TEST_CHECK(heap_page_delete(page, i));
+  }
+  const HeapPageHeader *header = (const HeapPageHeader *)page;
+  u32 contiguous = header->free_end - header->free_start;
+  u32 free_bytes = heap_page_free_space(page);
+  TEST_CHECK(contiguous < 300 && free_bytes >= 300);
+
+  TEST_CHECK(insert_tuple(page, 300, 1000, &slot) && slot == 0);
+  TEST_CHECK(header->dead_bytes == 0 &&
+             heap_page_free_space(page) == free_bytes - 300);
+  TEST_CHECK(tuple_matches(page, 0, 300, 1000));
+  for (u16 i = 1; i < count; i += 2) {
+    TEST_CHECK(tuple_matches(page, i, 100, i));
+  }
+
+  // A growing update that only fits after compaction keeps its slot.
+  u8 data[HEAP_TEST_PAGE_SIZE];
+  u32 grown = heap_page_free_space(page) + 100;
+  fill_tuple(data, grown, 2000);
+  TEST_CHECK(heap_page_delete(page, 3));
+  TEST_CHECK(heap_page_update(page, 1, data, grown));
+  TEST_CHECK(tuple_matches(page, 1, grown, 2000) &&
+             tuple_matches(page, 0, 300, 1000));
+  for (u16 i = 5; i < count; i += 2) {
+    TEST_CHECK(tuple_matches(page, i, 100, i));
+  }
+
+  // Compacting again has nothing to reclaim and changes nothing.
+  u8 before[HEAP_TEST_PAGE_SIZE];
+  heap_page_compact(page);
+  memcpy(before, page, sizeof(page));
+  heap_page_compact(page);
+  TEST_CHECK(memcmp(before, page, sizeof(page)) == 0);
+  TEST_CHECK(heap_page_is_valid(page, HEAP_TEST_PAGE_SIZE));
+  return true;
+}
+
+// At every page size a tuple of heap_page_max_tuple_size fills an empty page
+// and one byte more does not fit; likewise a second tuple of exactly the
+// remaining free space.
+static bool test_tuples_exactly_fill_page(void) {
+  static const u32 page_sizes[] = {HEAP_PAGE_MIN_SIZE, HEAP_TEST_PAGE_SIZE,
+                                   HEAP_PAGE_MAX_SIZE};
+  u8 *page = (u8 *)malloc(HEAP_PAGE_MAX_SIZE);
+  TEST_CHECK(page);
+  bool ok = true;
+  for (u32 i = 0; ok && i < ARRAY_SIZE(page_sizes); ++i) {
+    u32 page_size = page_sizes[i];
+    u32 max = heap_page_max_tuple_size(page_size);
+    u16 slot;
+    heap_page_init(page, page_size);
+    ok = !insert_tuple(page, max + 1, 1, &slot) &&
+         insert_tuple(page, max, 1, &slot) &&
+         heap_page_free_space(page) == 0 && !insert_tuple(page, 1, 2, &slot) &&
+         tuple_matches(page, slot, max, 1);
+
+    // A second tuple of exactly the space left, which needs its own slot.
+    heap_page_init(page, page_size);
+    u32 first = page_size / 3;
+    ok = ok && insert_tuple(page, first, 3, &slot);
+    u32 rest = heap_page_free_space(page);
+    ok = ok && rest > 0 && !insert_tuple(page, rest + 1, 4, &slot) &&
+         insert_tuple(page, rest, 4, &slot) &&
+         heap_page_free_space(page) == 0 && tuple_matches(page, 0, first, 3) &&
+         tuple_matches(page, 1, rest, 4);
+
+    // Freed space, reclaimed by compaction, exactly fits again.
+    ok = ok && heap_page_delete(page, 0) &&
+         insert_tuple(page, first, 5, &slot) && slot == 0 &&
+         heap_page_free_space(page) == 0 &&
+         heap_page_is_valid(page, page_size);
+  }
+  free(page);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Three full pages of 1000-byte tuples. Deleting two tuples from the middle
+// page must advertise it in the free space map even though its space is in
+// two holes; a 1500-byte insert then goes there (compacting it) rather than
+// to a new page, and the map follows the page's free space at every step.
+static bool test_fsm_after_delete_and_compaction(void) {
+  HeapFixture f;
+  bool ok = fixture_init(&f);
+  u8 data[1500];
+  RecordId rids[12];
+  for (u32 i = 0; ok && i < ARRAY_SIZE(rids); ++i) {
+    fill_tuple(data, 1000, i);
+    ok = heap_insert(&f.heap, data, 1000, &rids[i]) &&
+         rids[i].page_id == i / 4 && rids[i].slot == i % 4;
+  }
+  ok = ok && f.heap.stats.pages_allocated == 3 &&
+       fsm_find(&f.heap.fsm, 1000) == INVALID_PAGE_ID &&
+       fsm_matches_page(&f, 0) && fsm_matches_page(&f, 1) &&
+       fsm_matches_page(&f, 2);
+
+  ok = ok && heap_delete(&f.heap, rids[4]) && heap_delete(&f.heap, rids[6]) &&
+       !heap_delete(&f.heap, rids[6]) && fsm_matches_page(&f, 1) &&
+       fsm_find(&f.heap.fsm, 1500) == 1;
+
+  RecordId rid;
+  fill_tuple(data, 1500, 100);
+  ok = ok && heap_insert(&f.heap, data, 1500, &rid) && rid.page_id == 1 &&
+       rid.slot == 0 && f.heap.stats.pages_allocated == 3 &&
+       fsm_matches_page(&f, 1) &&
+       fsm_find(&f.heap.fsm, 1500) == INVALID_PAGE_ID;
+
+  for (u32 i = 5; ok && i < 8; i += 2) {
+    u32 length;
+    BufferFrame *frame;
+    const u8 *tuple = heap_fetch(&f.heap, rids[i], &length, &frame);
+    fill_tuple(data, 1000, i);
+    ok = tuple && length == 1000 && memcmp(tuple, data, 1000) == 0;
+    if (tuple) {
+      bp_unpin_page(&f.bp, frame, false);
+    }
+  }
+
+  // Emptied completely, the page lands in the top category, which promises
+  // the most any category can (categories round free space down).
+  u32 top = (FSM_CATEGORY_COUNT - 1) * f.heap.fsm.category_bytes;
+  ok = ok && heap_delete(&f.heap, rid) && heap_delete(&f.heap, rids[5]) &&
+       heap_delete(&f.heap, rids[7]) && fsm_matches_page(&f, 1) &&
+       fsm_find(&f.heap.fsm, top) == 1 && f.heap.tuple_count == 8;
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_slot_reuse),
+    TEST_CASE(test_compaction),
+    TEST_CASE(test_tuples_exactly_fill_page),
+    TEST_CASE(test_fsm_after_delete_and_compaction),
+};
+
+const TestSuite g_heap_page_tests = TEST_SUITE("heap_page", g_cases);
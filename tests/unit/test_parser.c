@@ -0,0 +1,136 @@
+// Checks that the parser bounds its recursion: deeply nested expressions are
+// a parse error rather than a stack overflow, and nesting up to the limit
+// still parses.
+
+#include "../test.h"
+#include "sqldb/parser.h"
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+// "SELECT " + 'depth' copies of 'open' + "1" + 'depth' copies of 'close'.
+static char *nested_query(const char *open, const char *close, u32 depth) {
+  usize open_length = strlen(open);
+  usize close_length = strlen(close);
+  usize length = 7 + depth * (open_length + close_length) + 1;
+  char *sql = (char *)malloc(length + 1);
+  if (!sql) {
+    return NULL;
+  }
+  char *p = sql;
+  memcpy(p, "SELECT ", 7);
+  p += 7;
+  for (u32 i = 0; i < depth; ++i, p += open_length) {
+    memcpy(p, open, open_length);
+  }
+  *p++ = '1';
+  for (u32 i = 0; i < depth; ++i, p += close_length) {
+    memcpy(p, close, close_length);
+  }
+  *p = '\0';
+  return sql;
+}
+
+static bool parses(Arena *arena, const char *sql, SqlParseError *out_error) {
+  ArenaSavepoint savepoint = arena_save(arena);
+  AstStatement *stmt = sql_parse(arena, sv_from_cstr(sql), out_error);
+  if (!arena_restore(arena, savepoint)) {
+    LOG_FATAL("The parser released memory below its caller's savepoint");
+  }
+  return stmt != NULL;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_deep_parentheses_are_an_error(void) {
+  Arena arena = arena_init_growable(64 * 1024, false);
+  char *sql = nested_query("(", ")", 100000);
+  TEST_CHECK(sql);
+  SqlParseError error;
+  bool ok = parses(&arena, sql, &error);
+  free(sql);
+  arena_free_all(&arena);
+  TEST_CHECK(!ok);
+  TEST_CHECK(strcmp(error.message, "expression nested too deeply") == 0);
+  TEST_CHECK(error.line == 1 && error.offset > 7);
+  return true;
+}
+
+static bool test_deep_prefix_operators_are_an_error(void) {
+  Arena arena = arena_init_growable(64 * 1024, false);
+  char *not_chain = nested_query("NOT ", "", 100000);
+  char *minus_chain = nested_query("- (", ")", 100000);
+  TEST_CHECK(not_chain && minus_chain);
+  SqlParseError not_error;
+  SqlParseError minus_error;
+  bool not_ok = parses(&arena, not_chain, &not_error);
+  bool minus_ok = parses(&arena, minus_chain, &minus_error);
+  free(not_chain);
+  free(minus_chain);
+  arena_free_all(&arena);
+  TEST_CHECK(!not_ok && !minus_ok);
+  TEST_CHECK(strcmp(not_error.message, "expression nested too deeply") == 0);
+  TEST_CHECK(strcmp(minus_error.message, "expression nested too deeply") == 0);
+  return true;
+}
+
+static bool test_nesting_below_the_limit_parses(void) {
+  Arena arena = arena_init_growable(64 * 1024, false);
+  // Every parenthesis is one level: parse_expr inside parse_primary.
+  char *sql = nested_query("(", ")", SQL_MAX_EXPR_DEPTH - 1);
+  char *too_deep = nested_query("(", ")", SQL_MAX_EXPR_DEPTH);
+  TEST_CHECK(sql && too_deep);
+  SqlParseError error;
+  bool ok = parses(&arena, sql, &error);
+  bool too_deep_ok = parses(&arena, too_deep, &error);
+  free(sql);
+  free(too_deep);
+  TEST_CHECK(ok);
+  TEST_CHECK(!too_deep_ok);
+
+  // Long flat expressions loop rather than recurse, so they have no limit.
+  usize terms = 20000;
+  char *flat = (char *)malloc(7 + terms * 4 + 1);
+  TEST_CHECK(flat);
+  memcpy(flat, "SELECT 1", 8);
+  usize length = 8;
+  for (usize i = 1; i < terms; ++i, length += 4) {
+    memcpy(flat + length, " + 1", 4);
+  }
+  flat[length] = '\0';
+  ok = parses(&arena, flat, &error);
+  free(flat);
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_depth_resets_between_expressions(void) {
+  Arena arena = arena_init_growable(64 * 1024, false);
+  char *inner = nested_query("(", ")", SQL_MAX_EXPR_DEPTH - 1);
+  TEST_CHECK(inner);
+  // Two siblings each just below the limit: depth is not cumulative.
+  usize length = strlen(inner);
+  char *sql = (char *)malloc(2 * length + 16);
+  TEST_CHECK(sql);
+  snprintf(sql, 2 * length + 16, "%s, %s", inner, inner + 7);
+  SqlParseError error;
+  bool ok = parses(&arena, sql, &error);
+  free(inner);
+  free(sql);
+  arena_free_all(&arena);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_deep_parentheses_are_an_error),
+    TEST_CASE(test_deep_prefix_operators_are_an_error),
+    TEST_CASE(test_nesting_below_the_limit_parses),
+    TEST_CASE(test_depth_resets_between_expressions),
+};
+
+const TestSuite g_parser_tests = TEST_SUITE("parser", g_cases);
@@ -0,0 +1,112 @@
+// Checks that short statements whose plan outgrows a cache slot are parsed
+// once per execution, straight into the temp arena, without logging, while
+// statements that fit are cached as usual.
+
+#include "../test.h"
+#include "sqldb/plan_cache.h"
+
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define PC_TEST_ENTRIES 8
+#define PC_TEST_WIDE_COLUMNS 120
+
+typedef struct {
+  Arena arena;
+  Arena temp;
+  PlanCache cache;
+} PlanCacheFixture;
+
+static bool fixture_init(PlanCacheFixture *f) {
+  f->arena = arena_init(plan_cache_required_arena_size(
+      PC_TEST_ENTRIES, DEFAULT_PLAN_CACHE_ENTRY_SIZE));
+  f->temp = arena_init(1024 * 1024);
+  return plan_cache_init(&f->cache, &f->arena, PC_TEST_ENTRIES,
+                         DEFAULT_PLAN_CACHE_ENTRY_SIZE);
+}
+
+static void fixture_free(PlanCacheFixture *f) {
+  arena_free_all(&f->arena);
+  arena_free_all(&f->temp);
+}
+
+static bool prepare(PlanCacheFixture *f, StringView sql) {
+  arena_reset(&f->temp);
+  SqlParams params;
+  SqlParseError error;
+  return plan_cache_prepare(&f->cache, &f->temp, sql, &params, &error) !=
+         NULL;
+}
+
+// Runs 'count' prepares of 'sql' with stderr sent to a temp file, and returns
+// how many bytes were logged, or -1 if a prepare failed.
+static long prepare_logged_bytes(PlanCacheFixture *f, StringView sql,
+                                 u32 count) {
+  FILE *log = tmpfile();
+  if (!log) {
+    return -1;
+  }
+  fflush(stderr);
+  int saved = dup(STDERR_FILENO);
+  dup2(fileno(log), STDERR_FILENO);
+  bool ok = true;
+  for (u32 i = 0; i < count && ok; ++i) {
+    ok = prepare(f, sql);
+  }
+  fflush(stderr);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  long size = (long)lseek(fileno(log), 0, SEEK_END);
+  fclose(log);
+  return ok ? size : -1;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_wide_select_is_parsed_once_quietly(void) {
+  PlanCacheFixture f;
+  TEST_CHECK(fixture_init(&f));
+  char sql[512];
+  usize length = (usize)snprintf(sql, sizeof(sql), "SELECT a");
+  for (u32 i = 1; i < PC_TEST_WIDE_COLUMNS; ++i) {
+    length += (usize)snprintf(sql + length, sizeof(sql) - length, ", a");
+  }
+  length += (usize)snprintf(sql + length, sizeof(sql) - length, " FROM t");
+  TEST_CHECK(length < f.cache.entry_size / 8); // Short enough to try a slot
+
+  long logged = prepare_logged_bytes(&f, sv_from_parts(sql, length), 3);
+  bool ok = logged == 0 && f.cache.stats.uncacheable == 3 &&
+            f.cache.stats.misses == 0 && f.cache.count == 0;
+  // Remembered: repeats no longer try the spare slot.
+  Arena *slot = &f.cache.entries[f.cache.free_head].arena;
+  slot->current_offset = 0;
+  ok = ok && prepare(&f, sv_from_parts(sql, length)) &&
+       slot->current_offset == 0;
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static bool test_small_select_is_cached(void) {
+  PlanCacheFixture f;
+  TEST_CHECK(fixture_init(&f));
+  bool ok = prepare(&f, SV("SELECT a FROM t WHERE b = 1")) &&
+            prepare(&f, SV("SELECT a FROM t WHERE b = 2"));
+  ok = ok && f.cache.stats.misses == 1 && f.cache.stats.hits == 1 &&
+       f.cache.stats.uncacheable == 0;
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_wide_select_is_parsed_once_quietly),
+    TEST_CASE(test_small_select_is_cached),
+};
+
+const TestSuite g_plan_cache_tests = TEST_SUITE("plan_cache", g_cases);
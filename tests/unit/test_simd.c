@@ -0,0 +1,267 @@
+// Checks the SIMD kernels against their scalar versions at every level this
+// CPU supports, and the scalar versions against values worked out by hand.
+// Lengths straddle the 64-value word boundaries, the float data has NaNs,
+// and aggregates run over empty, full and random selections.
+
+#include "../test.h"
+#include "sqldb/simd.h"
+
+#include <math.h>
+
+// =================================================================================================
+// :: Test Data ::
+// =================================================================================================
+
+#define SIMD_TEST_VALUES 1024
+#define SIMD_TEST_SET_SIZE 8
+
+typedef struct {
+  i32 i32s[SIMD_TEST_VALUES];
+  i64 i64s[SIMD_TEST_VALUES];
+  f64 f64s[SIMD_TEST_VALUES];
+  f64 f64s_nan[SIMD_TEST_VALUES]; // f64s with a NaN every 17 values
+  u64 some[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)]; // Random selection
+  i32 in_i32[SIMD_TEST_SET_SIZE];
+  i64 in_i64[SIMD_TEST_SET_SIZE];
+  f64 in_f64[SIMD_TEST_SET_SIZE];
+} SimdTestData;
+
+static const usize g_counts[] = {0,  1,   3,   31,  63,  64,
+                                 65, 127, 128, 129, 777, SIMD_TEST_VALUES};
+
+// Values are uniform in [0, 1000), so a constant of 500 selects about half.
+static const SimdTestData *simd_test_data(void) {
+  static SimdTestData data;
+  static bool is_generated = false;
+  if (is_generated) {
+    return &data;
+  }
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  for (usize i = 0; i < SIMD_TEST_VALUES; ++i) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    data.i32s[i] = (i32)(rng % 1000);
+    data.i64s[i] = (i64)((rng >> 16) % 1000);
+    data.f64s[i] = (f64)((rng >> 32) % 100000) / 100.0;
+    data.f64s_nan[i] = i % 17 == 5 ? NAN : data.f64s[i];
+    if ((rng >> 48) % 2 == 0) {
+      data.some[i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  for (u32 k = 0; k < SIMD_TEST_SET_SIZE; ++k) {
+    data.in_i32[k] = (i32)(k * 97);
+    data.in_i64[k] = (i64)(k * 97);
+    data.in_f64[k] = data.f64s[(usize)k * 7];
+  }
+  is_generated = true;
+  return &data;
+}
+
+// Selections must not have bits past the last value.
+static void simd_test_selections(usize n, u64 *all, u64 *some) {
+  const SimdTestData *data = simd_test_data();
+  memset(all, 0, SIMD_BITMAP_WORDS(SIMD_TEST_VALUES) * sizeof(u64));
+  memset(some, 0, SIMD_BITMAP_WORDS(SIMD_TEST_VALUES) * sizeof(u64));
+  for (usize i = 0; i < n; ++i) {
+    all[i / 64] |= 1ULL << (i % 64);
+    some[i / 64] |= data->some[i / 64] & (1ULL << (i % 64));
+  }
+}
+
+static bool same_f64(f64 a, f64 b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+// Sums may be added in another order; allow for the rounding that causes.
+static bool close_f64(f64 a, f64 b) {
+  return fabs(a - b) <= 1e-9 * MAX(fabs(a), 1.0);
+}
+
+// Runs 'call' (which writes to 'out') at the scalar level and at 'level' and
+// compares the bitmaps. Both buffers start out garbage, so every word must
+// be written.
+#define CHECK_BITMAP(level, n, call)                                           \
+  do {                                                                         \
+    u64 expected[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)];                         \
+    u64 actual[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)];                           \
+    u64 *out = expected;                                                       \
+    memset(expected, 0xA5, sizeof(expected));                                  \
+    memset(actual, 0x5A, sizeof(actual));                                      \
+    simd_set_level(SIMD_LEVEL_SCALAR);                                         \
+    call;                                                                      \
+    out = actual;                                                              \
+    simd_set_level(level);                                                     \
+    call;                                                                      \
+    TEST_CHECK(memcmp(expected, actual,                                        \
+                      SIMD_BITMAP_WORDS(n) * sizeof(u64)) == 0);               \
+  } while (0)
+
+// Runs 'call' at both levels and compares its results with 'equal'.
+#define CHECK_VALUE(level, T, call, equal)                                     \
+  do {                                                                         \
+    simd_set_level(SIMD_LEVEL_SCALAR);                                         \
+    T want = call;                                                             \
+    simd_set_level(level);                                                     \
+    T got = call;                                                              \
+    TEST_CHECK(equal);                                                         \
+  } while (0)
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+static bool test_select_matches_scalar(void) {
+  const SimdTestData *d = simd_test_data();
+  SimdLevel best = simd_detect_level();
+  for (int level = SIMD_LEVEL_SSE42; level <= (int)best; ++level) {
+    SimdLevel l = (SimdLevel)level;
+    for (usize c = 0; c < ARRAY_SIZE(g_counts); ++c) {
+      usize n = g_counts[c];
+      for (int op = SIMD_CMP_EQUAL; op <= SIMD_CMP_GREATER_EQUAL; ++op) {
+        SimdCompare cmp = (SimdCompare)op;
+        CHECK_BITMAP(l, n, simd_select_i32(d->i32s, n, cmp, 500, out));
+        CHECK_BITMAP(l, n, simd_select_i64(d->i64s, n, cmp, 500, out));
+        CHECK_BITMAP(l, n, simd_select_f64(d->f64s_nan, n, cmp, 500.0, out));
+        CHECK_BITMAP(l, n,
+                     simd_select_f64(d->f64s, n, cmp, d->f64s[0], out));
+      }
+    }
+  }
+  simd_set_level(best);
+  return true;
+}
+
+static bool test_between_and_in_match_scalar(void) {
+  const SimdTestData *d = simd_test_data();
+  SimdLevel best = simd_detect_level();
+  for (int level = SIMD_LEVEL_SSE42; level <= (int)best; ++level) {
+    SimdLevel l = (SimdLevel)level;
+    for (usize c = 0; c < ARRAY_SIZE(g_counts); ++c) {
+      usize n = g_counts[c];
+      CHECK_BITMAP(l, n, simd_between_i32(d->i32s, n, 250, 750, out));
+      CHECK_BITMAP(l, n, simd_between_i64(d->i64s, n, 250, 750, out));
+      CHECK_BITMAP(l, n,
+                   simd_between_f64(d->f64s_nan, n, 250.0, 750.0, out));
+      CHECK_BITMAP(l, n,
+                   simd_in_i32(d->i32s, n, d->in_i32, SIMD_TEST_SET_SIZE,
+                               out));
+      CHECK_BITMAP(l, n,
+                   simd_in_i64(d->i64s, n, d->in_i64, SIMD_TEST_SET_SIZE,
+                               out));
+      CHECK_BITMAP(l, n,
+                   simd_in_f64(d->f64s_nan, n, d->in_f64, SIMD_TEST_SET_SIZE,
+                               out));
+    }
+  }
+  simd_set_level(best);
+  return true;
+}
+
+static bool test_aggregates_match_scalar(void) {
+  const SimdTestData *d = simd_test_data();
+  SimdLevel best = simd_detect_level();
+  u64 none[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)] = {0};
+  u64 all[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)];
+  u64 some[SIMD_BITMAP_WORDS(SIMD_TEST_VALUES)];
+  for (int level = SIMD_LEVEL_SSE42; level <= (int)best; ++level) {
+    SimdLevel l = (SimdLevel)level;
+    for (usize c = 0; c < ARRAY_SIZE(g_counts); ++c) {
+      usize n = g_counts[c];
+      simd_test_selections(n, all, some);
+      const u64 *selections[] = {NULL, some, none, all};
+      for (usize s = 0; s < ARRAY_SIZE(selections); ++s) {
+        const u64 *bits = selections[s];
+        CHECK_VALUE(l, i64, simd_sum_i32(d->i32s, n, bits), want == got);
+        CHECK_VALUE(l, i64, simd_sum_i64(d->i64s, n, bits), want == got);
+        CHECK_VALUE(l, f64, simd_sum_f64(d->f64s, n, bits),
+                    close_f64(want, got));
+        CHECK_VALUE(l, i32, simd_min_i32(d->i32s, n, bits), want == got);
+        CHECK_VALUE(l, i32, simd_max_i32(d->i32s, n, bits), want == got);
+        CHECK_VALUE(l, i64, simd_min_i64(d->i64s, n, bits), want == got);
+        CHECK_VALUE(l, i64, simd_max_i64(d->i64s, n, bits), want == got);
+        CHECK_VALUE(l, f64, simd_min_f64(d->f64s_nan, n, bits),
+                    same_f64(want, got));
+        CHECK_VALUE(l, f64, simd_max_f64(d->f64s_nan, n, bits),
+                    same_f64(want, got));
+        if (bits) {
+          CHECK_VALUE(l, usize, simd_bitmap_count(bits, n), want == got);
+        }
+      }
+    }
+  }
+  simd_set_level(best);
+  return true;
+}
+
+static bool test_scalar_known_values(void) {
+  static const i64 values[] = {5, -3, 12, 7, 0, 12, -8, 4};
+  static const f64 floats[] = {1.5, NAN, -2.0, 8.25};
+  SimdLevel best = simd_detect_level();
+  TEST_CHECK(simd_set_level(SIMD_LEVEL_SCALAR));
+  u64 bits = ~0ULL;
+  simd_select_i64(values, ARRAY_SIZE(values), SIMD_CMP_GREATER, 4, &bits);
+  TEST_CHECK(bits == 0x2D); // 5, 12, 7, 12
+  simd_between_i64(values, ARRAY_SIZE(values), 0, 7, &bits);
+  TEST_CHECK(bits == 0x99); // 5, 7, 0, 4
+  i64 set[] = {12, -8};
+  simd_in_i64(values, ARRAY_SIZE(values), set, ARRAY_SIZE(set), &bits);
+  TEST_CHECK(bits == 0x64);
+  TEST_CHECK(simd_sum_i64(values, ARRAY_SIZE(values), &bits) == 16);
+  TEST_CHECK(simd_sum_i64(values, ARRAY_SIZE(values), NULL) == 29);
+  TEST_CHECK(simd_min_i64(values, ARRAY_SIZE(values), NULL) == -8);
+  TEST_CHECK(simd_max_i64(values, ARRAY_SIZE(values), NULL) == 12);
+
+  // Only <> holds for NaN, and MIN/MAX skip it.
+  simd_select_f64(floats, ARRAY_SIZE(floats), SIMD_CMP_NOT_EQUAL, 1.5, &bits);
+  TEST_CHECK(bits == 0xE);
+  simd_select_f64(floats, ARRAY_SIZE(floats), SIMD_CMP_LESS, 100.0, &bits);
+  TEST_CHECK(bits == 0xD);
+  TEST_CHECK(simd_min_f64(floats, ARRAY_SIZE(floats), NULL) == -2.0);
+  TEST_CHECK(simd_max_f64(floats, ARRAY_SIZE(floats), NULL) == 8.25);
+
+  // Empty selections give the identity.
+  u64 none = 0;
+  TEST_CHECK(simd_min_i64(values, ARRAY_SIZE(values), &none) == INT64_MAX);
+  TEST_CHECK(simd_max_i64(values, ARRAY_SIZE(values), &none) == INT64_MIN);
+  TEST_CHECK(simd_max_f64(floats, ARRAY_SIZE(floats), &none) == -INFINITY);
+  TEST_CHECK(simd_sum_i64(values, ARRAY_SIZE(values), &none) == 0);
+  simd_set_level(best);
+  return true;
+}
+
+static bool test_bitmap_helpers(void) {
+  u64 a[2] = {0xF0F0ULL, 0x1ULL};
+  u64 b[2] = {0xFF00ULL, 0x3ULL};
+  TEST_CHECK(simd_bitmap_count(a, 65) == 9);
+  simd_bitmap_and(a, b, 66);
+  TEST_CHECK(a[0] == 0xF000ULL && a[1] == 0x1ULL);
+  simd_bitmap_or(a, b, 66);
+  TEST_CHECK(a[0] == 0xFF00ULL && a[1] == 0x3ULL);
+
+  u32 selection[128];
+  u32 n = simd_bitmap_to_selection(a, 66, selection);
+  TEST_CHECK(n == 10);
+  TEST_CHECK(selection[0] == 8 && selection[7] == 15);
+  TEST_CHECK(selection[8] == 64 && selection[9] == 65);
+
+  // Bits past 'count' in the last word are cleared.
+  i32 values[70];
+  for (i32 i = 0; i < 70; ++i) {
+    values[i] = i;
+  }
+  u64 out[2] = {~0ULL, ~0ULL};
+  simd_select_i32(values, 70, SIMD_CMP_GREATER_EQUAL, 0, out);
+  TEST_CHECK(out[0] == ~0ULL && out[1] == 0x3FULL);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_select_matches_scalar),
+    TEST_CASE(test_between_and_in_match_scalar),
+    TEST_CASE(test_aggregates_match_scalar),
+    TEST_CASE(test_scalar_known_values),
+    TEST_CASE(test_bitmap_helpers),
+};
+
+const TestSuite g_simd_tests = TEST_SUITE("simd", g_cases);
@@ -0,0 +1,467 @@
+// Damages the write-ahead log the ways a crash or a stale file can, and checks
+// that recovery replays exactly the committed prefix: a torn tail, a flipped
+// payload byte, a tail left over from before a checkpoint and a transaction
+// that never committed. Also checks that replaying the same log twice is
+// harmless and that commits trim the log once it outgrows its threshold.
+//
+// Group commit runs with concurrent sessions: every commit that returned true
+// survives a restart, commits inside the window share a flush, and a failed
+// flush fails every later commit.
+
+#include "../test.h"
+#include "sqldb/core.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Test Helpers ::
+// =================================================================================================
+
+#define WAL_TEST_PAGE_SIZE 4096
+#define WAL_TEST_OFFSET 16
+#define WAL_TEST_LENGTH 64
+#define WAL_TEST_THREADS 8
+#define WAL_TEST_COMMITS 64
+#define WAL_TEST_SLOT 8 // Bytes each session commit writes to its page
+
+typedef struct {
+  char data_path[32];
+  char wal_path[32];
+  PageFile file;
+  Wal wal;
+  bool has_file;
+  bool has_wal;
+} WalFixture;
+
+static bool temp_path(char *path, usize size) {
+  char name[] = "/tmp/sqldb_test_wal_XXXXXX";
+  int fd = mkstemp(name);
+  TEST_CHECK(fd >= 0 && sizeof(name) <= size);
+  close(fd);
+  memcpy(path, name, sizeof(name));
+  return true;
+}
+
+static bool fixture_init(WalFixture *f) {
+  ZERO_STRUCT(*f);
+  TEST_CHECK(temp_path(f->data_path, sizeof(f->data_path)));
+  TEST_CHECK(temp_path(f->wal_path, sizeof(f->wal_path)));
+  // wal_open starts a fresh log only where there is no file to recover.
+  unlink(f->wal_path);
+  f->has_file = pf_open(&f->file, f->data_path, WAL_TEST_PAGE_SIZE, false,
+                        false);
+  TEST_CHECK(f->has_file);
+  f->has_wal = wal_open(&f->wal, f->wal_path, WAL_TEST_PAGE_SIZE);
+  TEST_CHECK(f->has_wal);
+  return true;
+}
+
+static void fixture_free(WalFixture *f) {
+  if (f->has_wal) {
+    wal_close(&f->wal);
+  }
+  if (f->has_file) {
+    pf_close(&f->file);
+  }
+  unlink(f->data_path);
+  unlink(f->wal_path);
+}
+
+// Simulates a restart: drops everything in memory and recovers from the file.
+static bool reopen_and_recover(WalFixture *f) {
+  wal_close(&f->wal);
+  f->has_wal = wal_open(&f->wal, f->wal_path, WAL_TEST_PAGE_SIZE);
+  TEST_CHECK(f->has_wal);
+  TEST_CHECK(wal_recover(&f->wal, &f->file));
+  return true;
+}
+
+static Lsn log_fill(Wal *wal, u64 txn_id, PageId page_id, u8 byte) {
+  u8 data[WAL_TEST_LENGTH];
+  memset(data, byte, sizeof(data));
+  return wal_log_page_write(wal, txn_id, page_id, WAL_TEST_OFFSET, data,
+                            sizeof(data));
+}
+
+// Checks that the logged range of 'page_id' holds 'byte' in the data file.
+static bool page_holds(PageFile *file, PageId page_id, u8 byte) {
+  u8 page[WAL_TEST_PAGE_SIZE];
+  TEST_CHECK(pf_read_page(file, page_id, page));
+  for (u32 i = 0; i < WAL_TEST_LENGTH; ++i) {
+    TEST_CHECK(page[WAL_TEST_OFFSET + i] == byte);
+  }
+  return true;
+}
+
+static u64 file_size(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 ? (u64)st.st_size : 0;
+}
+
+// File offset of the record at 'lsn' once the whole log has been flushed.
+static off_t lsn_offset(const Wal *wal, Lsn lsn) {
+  return (off_t)(file_size(wal->fd) - (wal->next_lsn - lsn));
+}
+
+// Logs and commits 'page_id' = 'byte' in a transaction of its own. Returns
+// the LSN of its commit record.
+static Lsn commit_fill(Wal *wal, PageId page_id, u8 byte) {
+  u64 txn_id = wal_begin_txn(wal);
+  if (log_fill(wal, txn_id, page_id, byte) == INVALID_LSN) {
+    return INVALID_LSN;
+  }
+  Lsn lsn = wal_next_lsn(wal);
+  return wal_commit(wal, txn_id) ? lsn : INVALID_LSN;
+}
+
+// One thread committing transactions that each fill the next WAL_TEST_SLOT
+// bytes of its own page with the commit's number.
+typedef struct {
+  Wal *wal;
+  pthread_barrier_t *start;
+  PageId page_id;
+  u32 commits;
+  bool is_committed[WAL_TEST_COMMITS]; // wal_commit returned true
+} CommitSession;
+
+static void *commit_session_main(void *arg) {
+  CommitSession *session = (CommitSession *)arg;
+  pthread_barrier_wait(session->start);
+  for (u32 i = 0; i < session->commits; ++i) {
+    u8 data[WAL_TEST_SLOT];
+    memset(data, (int)(i + 1), sizeof(data));
+    u64 txn_id = wal_begin_txn(session->wal);
+    session->is_committed[i] =
+        wal_log_page_write(session->wal, txn_id, session->page_id,
+                           i * WAL_TEST_SLOT, data,
+                           sizeof(data)) != INVALID_LSN &&
+        wal_commit(session->wal, txn_id);
+  }
+  return NULL;
+}
+
+// Runs WAL_TEST_THREADS sessions of 'commits' commits each, on pages 1 and up,
+// and returns the number of commits that returned true.
+static u32 run_sessions(Wal *wal, CommitSession *sessions, u32 commits) {
+  pthread_barrier_t start;
+  pthread_t threads[WAL_TEST_THREADS];
+  pthread_barrier_init(&start, NULL, WAL_TEST_THREADS);
+  for (u32 t = 0; t < WAL_TEST_THREADS; ++t) {
+    sessions[t] = (CommitSession){
+        .wal = wal, .start = &start, .page_id = t + 1, .commits = commits};
+    pthread_create(&threads[t], NULL, commit_session_main, &sessions[t]);
+  }
+  u32 committed = 0;
+  for (u32 t = 0; t < WAL_TEST_THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+    for (u32 i = 0; i < commits; ++i) {
+      committed += sessions[t].is_committed[i];
+    }
+  }
+  pthread_barrier_destroy(&start);
+  return committed;
+}
+
+// Checks that every commit reported as done is in the recovered data file.
+static bool sessions_are_durable(PageFile *file,
+                                 const CommitSession *sessions) {
+  u8 page[WAL_TEST_PAGE_SIZE];
+  for (u32 t = 0; t < WAL_TEST_THREADS; ++t) {
+    TEST_CHECK(pf_read_page(file, sessions[t].page_id, page));
+    for (u32 i = 0; i < sessions[t].commits; ++i) {
+      if (sessions[t].is_committed[i]) {
+        TEST_CHECK(page[i * WAL_TEST_SLOT] == (u8)(i + 1));
+        TEST_CHECK(page[(i + 1) * WAL_TEST_SLOT - 1] == (u8)(i + 1));
+      }
+    }
+  }
+  return true;
+}
+
+// =================================================================================================
+// :: Tests ::
+// =================================================================================================
+
+// A crash in the middle of writing a commit record loses that transaction
+// only, and the log resumes where the torn record started.
+static bool test_torn_tail(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  Lsn torn = INVALID_LSN;
+  if (ok) {
+    ok = commit_fill(&f.wal, 1, 0xAA) != INVALID_LSN;
+    torn = commit_fill(&f.wal, 2, 0xBB);
+    ok &= torn != INVALID_LSN &&
+          ftruncate(f.wal.fd, lsn_offset(&f.wal, torn) + 20) == 0;
+  }
+  TEST_QUIETLY(ok = ok && reopen_and_recover(&f));
+  ok = ok && page_holds(&f.file, 1, 0xAA) && page_holds(&f.file, 2, 0) &&
+       f.wal.next_lsn == torn && f.wal.base_lsn == torn;
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// A flipped payload byte ends the valid log at that record: neither its
+// transaction nor anything logged after it is replayed.
+static bool test_checksum_mismatch(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  if (ok) {
+    ok = commit_fill(&f.wal, 1, 0xAA) != INVALID_LSN;
+    u64 txn_id = wal_begin_txn(&f.wal);
+    Lsn corrupt = log_fill(&f.wal, txn_id, 2, 0xBB);
+    ok &= corrupt != INVALID_LSN && wal_commit(&f.wal, txn_id) &&
+          commit_fill(&f.wal, 3, 0xCC) != INVALID_LSN;
+    u8 byte = 0xBA;
+    off_t payload = lsn_offset(&f.wal, corrupt) +
+                    (off_t)sizeof(WalRecordHeader);
+    ok &= ok && pwrite(f.wal.fd, &byte, 1, payload) == 1;
+  }
+  TEST_QUIETLY(ok = ok && reopen_and_recover(&f));
+  ok = ok && page_holds(&f.file, 1, 0xAA) && page_holds(&f.file, 2, 0) &&
+       page_holds(&f.file, 3, 0);
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Records left behind a checkpoint carry LSNs from before it, so they are not
+// mistaken for the continuation of the current log even though they are
+// otherwise intact.
+static bool test_stale_lsn_tail(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  u8 *stale = NULL;
+  usize stale_size = 0;
+  if (ok) {
+    Lsn start = wal_next_lsn(&f.wal);
+    ok = commit_fill(&f.wal, 1, 0xAA) != INVALID_LSN;
+    stale_size = (usize)(f.wal.next_lsn - start);
+    stale = (u8 *)malloc(stale_size);
+    ok &= stale && pread(f.wal.fd, stale, stale_size,
+                         lsn_offset(&f.wal, start)) == (ssize_t)stale_size;
+    // The data file never got page 1, as if the crash came right after the
+    // log was truncated.
+    ok &= ok && wal_checkpoint(&f.wal, f.wal.next_lsn);
+    ok &= ok && commit_fill(&f.wal, 2, 0xBB) != INVALID_LSN;
+    ok &= ok && pwrite(f.wal.fd, stale, stale_size,
+                       (off_t)file_size(f.wal.fd)) == (ssize_t)stale_size;
+  }
+  TEST_QUIETLY(ok = ok && reopen_and_recover(&f));
+  ok = ok && page_holds(&f.file, 1, 0) && page_holds(&f.file, 2, 0xBB);
+  free(stale);
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Page writes of a transaction without a commit record are skipped, even when
+// they are interleaved with a committed one and durable.
+static bool test_uncommitted_txn_skipped(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  if (ok) {
+    u64 committed = wal_begin_txn(&f.wal);
+    u64 uncommitted = wal_begin_txn(&f.wal);
+    ok = log_fill(&f.wal, committed, 1, 0xAA) != INVALID_LSN &&
+         log_fill(&f.wal, uncommitted, 2, 0xBB) != INVALID_LSN &&
+         log_fill(&f.wal, uncommitted, 1, 0xBB) != INVALID_LSN &&
+         wal_commit(&f.wal, committed) &&
+         wal_flush(&f.wal, wal_next_lsn(&f.wal));
+  }
+  ok = ok && reopen_and_recover(&f) && page_holds(&f.file, 1, 0xAA) &&
+       page_holds(&f.file, 2, 0) && f.wal.stats.recovered == 1;
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// A crash after replay but before the log is truncated replays the same log
+// again over the already updated data file, with the same result.
+static bool test_replay_is_idempotent(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  u8 *log = NULL;
+  usize log_size = 0;
+  if (ok) {
+    // Overlapping writes to one page: only LSN order gives 0xBB.
+    ok = commit_fill(&f.wal, 1, 0xAA) != INVALID_LSN &&
+         commit_fill(&f.wal, 1, 0xBB) != INVALID_LSN &&
+         commit_fill(&f.wal, 2, 0xCC) != INVALID_LSN;
+    log_size = (usize)file_size(f.wal.fd);
+    log = (u8 *)malloc(log_size);
+    ok &= log && pread(f.wal.fd, log, log_size, 0) == (ssize_t)log_size;
+  }
+  for (u32 run = 0; run < 2 && ok; ++run) {
+    ok = pwrite(f.wal.fd, log, log_size, 0) == (ssize_t)log_size &&
+         reopen_and_recover(&f) && page_holds(&f.file, 1, 0xBB) &&
+         page_holds(&f.file, 2, 0xCC) && f.wal.stats.recovered == 3;
+  }
+  free(log);
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// A checkpoint for an LSN the log has since grown past keeps the newer
+// records, whose changes may not be in the data file yet.
+static bool test_checkpoint_keeps_newer_records(void) {
+  WalFixture f;
+  bool ok = fixture_init(&f);
+  if (ok) {
+    Lsn lsn = wal_next_lsn(&f.wal);
+    ok = commit_fill(&f.wal, 1, 0xAA) != INVALID_LSN &&
+         wal_checkpoint(&f.wal, lsn) && f.wal.stats.checkpoints == 0;
+  }
+  ok = ok && reopen_and_recover(&f) && page_holds(&f.file, 1, 0xAA);
+  fixture_free(&f);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Logs 'byte' into a new page of the pool for its own transaction and
+// commits it, holding the pin across the commit if 'keep_pinned'. Checks
+// whether the commit wrote the page back.
+static bool db_commit_page(Database *db, u8 byte, bool keep_pinned) {
+  PageId page_id;
+  BufferFrame *frame = bp_new_page(&db->page_cache, &page_id);
+  TEST_CHECK(frame);
+  u64 txn_id = db_begin_txn(db);
+  memset(frame->data + WAL_TEST_OFFSET, byte, WAL_TEST_LENGTH);
+  TEST_CHECK(bp_log_page_write(&db->page_cache, frame, txn_id,
+                               WAL_TEST_OFFSET, WAL_TEST_LENGTH) !=
+             INVALID_LSN);
+  if (!keep_pinned) {
+    bp_unpin_page(&db->page_cache, frame, true);
+  }
+  bool ok = db_commit(db, txn_id) &&
+            page_holds(&db->db_file, page_id, keep_pinned ? 0 : byte);
+  if (keep_pinned) {
+    bp_unpin_page(&db->page_cache, frame, true);
+  }
+  return ok;
+}
+
+// Once the log outgrows checkpoint_bytes, a commit writes the pool back and
+// truncates the log, unless a pinned page is dirty.
+static bool test_commit_checkpoints_large_log(void) {
+  char path[32];
+  TEST_CHECK(temp_path(path, sizeof(path)));
+  DatabaseConfig config;
+  db_config_init_defaults(&config);
+  config.db_file_path = path;
+  config.page_size = WAL_TEST_PAGE_SIZE;
+  config.cache_size_mb = 1;
+  config.worker_threads = 1;
+  config.enable_wal = true;
+  config.log_level = g_log_level;
+  Database db;
+  bool ok = db_init(&db, &config);
+  if (ok) {
+    db.wal.checkpoint_bytes = 1;
+    ok = db_commit_page(&db, 0xAA, false) &&
+         db.wal.stats.checkpoints == 1 &&
+         db.wal.base_lsn == db.wal.next_lsn &&
+         db_commit_page(&db, 0xBB, true) && db.wal.stats.checkpoints == 1 &&
+         db.wal.base_lsn < db.wal.next_lsn;
+    db_shutdown(&db);
+  }
+  char wal_path[sizeof(path) + sizeof(WAL_FILE_SUFFIX)];
+  snprintf(wal_path, sizeof(wal_path), "%s%s", path, WAL_FILE_SUFFIX);
+  unlink(wal_path);
+  unlink(path);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Sessions racing without a window: whoever returned true must survive a
+// restart, however the commits were grouped.
+static bool test_group_commit_is_durable(void) {
+  WalFixture f;
+  CommitSession *sessions =
+      (CommitSession *)calloc(WAL_TEST_THREADS, sizeof(CommitSession));
+  bool ok = sessions && fixture_init(&f);
+  if (ok) {
+    ok = run_sessions(&f.wal, sessions, WAL_TEST_COMMITS) ==
+             WAL_TEST_THREADS * WAL_TEST_COMMITS &&
+         f.wal.stats.commits == WAL_TEST_THREADS * WAL_TEST_COMMITS;
+  }
+  ok = ok && reopen_and_recover(&f) && sessions_are_durable(&f.file, sessions);
+  fixture_free(&f);
+  free(sessions);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// With a window long enough for every session to append, leaders flush whole
+// batches instead of one commit at a time.
+static bool test_group_commit_batches_within_window(void) {
+  WalFixture f;
+  CommitSession *sessions =
+      (CommitSession *)calloc(WAL_TEST_THREADS, sizeof(CommitSession));
+  bool ok = sessions && fixture_init(&f);
+  if (ok) {
+    wal_set_group_commit(&f.wal, MAX_COMMIT_WINDOW_US, WAL_TEST_THREADS);
+    ok = run_sessions(&f.wal, sessions, 4) == WAL_TEST_THREADS * 4;
+    const Histogram *batches = &f.wal.stats.commit_batch_sizes;
+    ok &= batches->max > 1 && batches->sum == WAL_TEST_THREADS * 4 &&
+          batches->total_count < WAL_TEST_THREADS * 4;
+  }
+  ok = ok && reopen_and_recover(&f) && sessions_are_durable(&f.file, sessions);
+  fixture_free(&f);
+  free(sessions);
+  TEST_CHECK(ok);
+  return true;
+}
+
+// Once a flush fails, no later commit may report success, even after the
+// file works again: the kernel may have dropped the records it failed to sync.
+static bool test_failed_flush_stops_commits(void) {
+  WalFixture f;
+  CommitSession *sessions =
+      (CommitSession *)calloc(WAL_TEST_THREADS, sizeof(CommitSession));
+  bool ok = sessions && fixture_init(&f);
+  int saved_fd = -1;
+  int read_only_fd = -1;
+  if (ok) {
+    ok = commit_fill(&f.wal, 0, 0xAA) != INVALID_LSN;
+    // Swap a read-only descriptor in under the log so the next write fails.
+    saved_fd = dup(f.wal.fd);
+    read_only_fd = open(f.wal_path, O_RDONLY | O_CLOEXEC);
+    ok &= saved_fd >= 0 && read_only_fd >= 0 &&
+          dup2(read_only_fd, f.wal.fd) >= 0;
+    TEST_QUIETLY(ok &= ok && commit_fill(&f.wal, 0, 0xBB) == INVALID_LSN);
+    ok &= ok && f.wal.io_failed && dup2(saved_fd, f.wal.fd) >= 0;
+    ok &= ok && run_sessions(&f.wal, sessions, WAL_TEST_COMMITS) == 0 &&
+          !wal_flush(&f.wal, wal_next_lsn(&f.wal));
+  }
+  if (saved_fd >= 0) {
+    close(saved_fd);
+  }
+  if (read_only_fd >= 0) {
+    close(read_only_fd);
+  }
+  ok = ok && reopen_and_recover(&f) && page_holds(&f.file, 0, 0xAA);
+  fixture_free(&f);
+  free(sessions);
+  TEST_CHECK(ok);
+  return true;
+}
+
+static const TestCase g_cases[] = {
+    TEST_CASE(test_torn_tail),
+    TEST_CASE(test_checksum_mismatch),
+    TEST_CASE(test_stale_lsn_tail),
+    TEST_CASE(test_uncommitted_txn_skipped),
+    TEST_CASE(test_replay_is_idempotent),
+    TEST_CASE(test_checkpoint_keeps_newer_records),
+    TEST_CASE(test_commit_checkpoints_large_log),
+    TEST_CASE(test_group_commit_is_durable),
+    TEST_CASE(test_group_commit_batches_within_window),
+    TEST_CASE(test_failed_flush_stops_commits),
+};
+
+const TestSuite g_wal_tests = TEST_SUITE("wal", g_cases);
@@ -0,0 +1,167 @@
+// Compares allocation throughput of the arenas with malloc. Each round
+// allocates a statement's worth of small objects (16 to 256 bytes, with a
+// few 4-64 KB buffers mixed in) and then frees them all: malloc frees every
+// object, a fixed arena and a growable one are reset. The growable arena
+// starts with a small block, so early rounds chain blocks, and runs with and
+// without huge pages. tests/unit/test_arena.c checks savepoints.
+//
+// Usage: arena_bench [--allocs N] [--rounds N] [--block-kb N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_LARGE_EVERY 64 // One 4-64 KB buffer per this many allocations
+
+typedef enum {
+  BENCH_MALLOC,
+  BENCH_FIXED,
+  BENCH_GROWABLE,
+  BENCH_GROWABLE_HUGE,
+} BenchAllocator;
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static usize alloc_size(u64 r, usize i) {
+  if (i % BENCH_LARGE_EVERY == BENCH_LARGE_EVERY - 1) {
+    return 4096 + (usize)(r % (60 * 1024));
+  }
+  return 16 + (usize)(r % 241);
+}
+
+// Returns allocations per second; 'out_peak' gets the arena bytes in use at
+// the end of the last round.
+static f64 run(BenchAllocator allocator, u64 allocs, u64 rounds,
+               usize block_size, usize *out_peak) {
+  void **ptrs = (void **)malloc(allocs * sizeof(void *));
+  if (!ptrs) {
+    LOG_FATAL("Failed to allocate %" PRIu64 " pointers", allocs);
+  }
+  Arena arena = {0};
+  if (allocator == BENCH_FIXED) {
+    // Sized for the worst case so it never runs out: every allocation at its
+    // largest, plus its alignment padding.
+    usize per_alloc = 64 * 1024 / BENCH_LARGE_EVERY + 256 + 2 * 16;
+    arena = arena_init((usize)(allocs + BENCH_LARGE_EVERY) * per_alloc);
+  } else if (allocator != BENCH_MALLOC) {
+    arena = arena_init_growable(block_size,
+                                allocator == BENCH_GROWABLE_HUGE);
+  }
+  u64 rng = 0x2545F4914F6CDD1DULL;
+  u64 sink = 0;
+  *out_peak = 0;
+  f64 start = now_seconds();
+  for (u64 round = 0; round < rounds; ++round) {
+    for (u64 i = 0; i < allocs; ++i) {
+      usize size = alloc_size(next_random(&rng), (usize)i);
+      void *ptr = allocator == BENCH_MALLOC ? malloc(size)
+                                            : arena_alloc(&arena, size);
+      if (!ptr) {
+        LOG_FATAL("Allocation %" PRIu64 " failed", i);
+      }
+      *(u8 *)ptr = (u8)i; // Touch it, as a caller would
+      ptrs[i] = ptr;
+    }
+    for (u64 i = 0; i < allocs; i += 97) {
+      sink += *(u8 *)ptrs[i];
+    }
+    if (allocator == BENCH_MALLOC) {
+      for (u64 i = 0; i < allocs; ++i) {
+        free(ptrs[i]);
+      }
+    } else {
+      *out_peak = arena_used(&arena);
+      arena_reset(&arena);
+    }
+  }
+  f64 elapsed = now_seconds() - start;
+  if (allocator != BENCH_MALLOC) {
+    arena_free_all(&arena);
+  }
+  free(ptrs);
+  if (sink == 1) {
+    printf(" "); // Keeps the reads above
+  }
+  return (f64)(allocs * rounds) / elapsed;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --allocs <N>       Allocations per round (default: 100000)\n");
+  printf("  --rounds <N>       Rounds per allocator (default: 50)\n");
+  printf("  --block-kb <N>     First block of the growable arenas "
+         "(default: 64)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 allocs = 100000;
+  u64 rounds = 50;
+  usize block_kb = 64;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--allocs") == 0 && has_value) {
+      allocs = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--rounds") == 0 && has_value) {
+      rounds = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--block-kb") == 0 && has_value) {
+      block_kb = (usize)strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (allocs == 0 || rounds == 0 || block_kb == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+
+  static const char *names[] = {"malloc/free", "fixed arena", "growable",
+                                "growable huge"};
+  printf("%" PRIu64 " allocations per round, %" PRIu64 " rounds, %zu KB "
+         "first block\n",
+         allocs, rounds, block_kb);
+  printf("  %-14s %14s %10s %12s\n", "allocator", "allocs/s", "ns/alloc",
+         "round KB");
+  f64 baseline = 0.0;
+  for (u32 a = BENCH_MALLOC; a <= BENCH_GROWABLE_HUGE; ++a) {
+    usize peak;
+    f64 rate = run((BenchAllocator)a, allocs, rounds, block_kb * 1024, &peak);
+    if (baseline == 0.0) {
+      baseline = rate;
+    }
+    printf("  %-14s %14.0f %10.1f %12zu  %6.2fx\n", names[a], rate, 1e9 / rate,
+           peak / 1024, rate / baseline);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,250 @@
+// Measures B+tree point lookups and range scans over a large key set. Keys
+// are 21-byte strings ("user:" plus 16 hex digits of a scrambled counter)
+// inserted in random order, so they share a short common prefix and inner
+// nodes get to compress the longer prefixes their neighbourhoods share.
+//
+// Usage: btree_bench [--keys N] [--lookups N] [--scans N] [--scan-length N]
+//                    [--page-size N] [--cache-mb N] [--file <path>]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/btree.h"
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+typedef struct {
+  u64 keys;
+  u64 lookups;
+  u64 scans;
+  u32 scan_length;
+  u32 page_size;
+  u32 cache_mb;
+  const char *path;
+} BenchOptions;
+
+#define KEY_LENGTH 21
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// Bijective mixer (splitmix64 finalizer): distinct indices give distinct,
+// randomly ordered keys.
+static u64 scramble(u64 x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static StringView make_key(char *buffer, u64 bits) {
+  snprintf(buffer, KEY_LENGTH + 1, "user:%016" PRIx64, bits);
+  return sv_from_parts(buffer, KEY_LENGTH);
+}
+
+static void report(const char *name, u64 ops, f64 seconds) {
+  printf("  %-24s %12.0f ops/s %10.3f us/op\n", name, (f64)ops / seconds,
+         seconds * 1e6 / (f64)ops);
+}
+
+static bool run(const BenchOptions *opts) {
+  unlink(opts->path);
+  PageFile file;
+  if (!pf_open(&file, opts->path, opts->page_size, false, false)) {
+    return false;
+  }
+  usize frame_count = (usize)opts->cache_mb * 1024 * 1024 / opts->page_size;
+  Arena arena = arena_init(bp_required_arena_size(
+      frame_count, opts->page_size, DEFAULT_EVICTION_POLICY, false));
+  BufferPool bp;
+  if (!bp_init(&bp, &arena, frame_count, opts->page_size,
+               DEFAULT_EVICTION_POLICY, &file)) {
+    arena_free_all(&arena);
+    pf_close(&file);
+    return false;
+  }
+  BTree tree;
+  if (!btree_create(&tree, &bp)) {
+    LOG_FATAL("Failed to create the B+tree");
+  }
+  char key_buffer[KEY_LENGTH + 1];
+
+  f64 start = now_seconds();
+  for (u64 i = 0; i < opts->keys; ++i) {
+    if (!btree_insert(&tree, make_key(key_buffer, scramble(i)), i)) {
+      LOG_FATAL("Insert %" PRIu64 " failed", i);
+    }
+  }
+  f64 load_seconds = now_seconds() - start;
+  printf("Loaded %" PRIu64 " keys: height %u, %" PRIu64
+         " pages, %.1f bytes/key, %" PRIu64 " evictions\n",
+         opts->keys, tree.height, bp.page_count,
+         (f64)bp.page_count * opts->page_size / (f64)opts->keys,
+         bp.stats.evictions);
+  report("insert (random order)", opts->keys, load_seconds);
+
+  start = now_seconds();
+  for (u64 i = 0; i < opts->lookups; ++i) {
+    u64 index = rng_next() % opts->keys;
+    u64 value;
+    if (!btree_lookup(&tree, make_key(key_buffer, scramble(index)), &value) ||
+        value != index) {
+      LOG_FATAL("Lookup of key %" PRIu64 " failed", index);
+    }
+  }
+  report("point lookup (hit)", opts->lookups, now_seconds() - start);
+
+  start = now_seconds();
+  u64 found = 0;
+  for (u64 i = 0; i < opts->lookups; ++i) {
+    u64 value;
+    found += btree_lookup(&tree, make_key(key_buffer, rng_next()), &value);
+  }
+  report("point lookup (miss)", opts->lookups, now_seconds() - start);
+
+  // Scans start at random positions, so each one pays for a descent and
+  // then streams leaves through their sibling links.
+  start = now_seconds();
+  u64 scanned = 0;
+  for (u64 i = 0; i < opts->scans; ++i) {
+    BTreeIterator it;
+    if (!btree_seek(&tree, make_key(key_buffer, rng_next()), &it)) {
+      LOG_FATAL("Seek failed");
+    }
+    StringView key;
+    u64 value;
+    for (u32 n = 0; n < opts->scan_length && btree_iter_next(&it, &key, &value);
+         ++n) {
+      scanned++;
+    }
+    btree_iter_close(&it);
+  }
+  f64 scan_seconds = now_seconds() - start;
+  char label[64];
+  snprintf(label, sizeof(label), "range scan (%u keys)", opts->scan_length);
+  report(label, opts->scans, scan_seconds);
+  printf("  %-24s %12.0f keys/s\n", "", (f64)scanned / scan_seconds);
+
+  start = now_seconds();
+  BTreeIterator it;
+  if (!btree_seek(&tree, sv_from_parts(NULL, 0), &it)) {
+    LOG_FATAL("Seek failed");
+  }
+  StringView key;
+  u64 value;
+  u64 count = 0;
+  char previous[KEY_LENGTH];
+  while (btree_iter_next(&it, &key, &value)) {
+    if (count > 0 &&
+        sv_compare(sv_from_parts(previous, KEY_LENGTH), key) >= 0) {
+      LOG_FATAL("Full scan out of order at key %" PRIu64, count);
+    }
+    memcpy(previous, key.data, KEY_LENGTH);
+    count++;
+  }
+  btree_iter_close(&it);
+  f64 full_seconds = now_seconds() - start;
+  if (count != opts->keys) {
+    LOG_FATAL("Full scan returned %" PRIu64 " of %" PRIu64 " keys", count,
+              opts->keys);
+  }
+  printf("  %-24s %12.0f keys/s\n", "full scan", (f64)count / full_seconds);
+  printf("  %" PRIu64 " leaf splits, %" PRIu64 " inner splits, %" PRIu64
+         " random misses found\n",
+         tree.stats.leaf_splits, tree.stats.inner_splits, found);
+
+  btree_close(&tree);
+  bp_shutdown(&bp);
+  arena_free_all(&arena);
+  pf_close(&file);
+  unlink(opts->path);
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --keys <N>         Keys to load (default: 10000000)\n");
+  printf("  --lookups <N>      Point lookups per phase (default: 1000000)\n");
+  printf("  --scans <N>        Range scans (default: 100000)\n");
+  printf("  --scan-length <N>  Keys read per range scan (default: 100)\n");
+  printf("  --page-size <N>    Page size in bytes (default: 4096)\n");
+  printf("  --cache-mb <N>     Buffer pool size in MB (default: 1024)\n");
+  printf("  --file <path>      Scratch database file "
+         "(default: btree_bench.db)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts = {
+      .keys = 10000000,
+      .lookups = 1000000,
+      .scans = 100000,
+      .scan_length = 100,
+      .page_size = 4096,
+      .cache_mb = 1024,
+      .path = "btree_bench.db",
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--keys") == 0 && has_value) {
+      opts.keys = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--lookups") == 0 && has_value) {
+      opts.lookups = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--scans") == 0 && has_value) {
+      opts.scans = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--scan-length") == 0 && has_value) {
+      opts.scan_length = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--page-size") == 0 && has_value) {
+      opts.page_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--cache-mb") == 0 && has_value) {
+      opts.cache_mb = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      opts.path = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  bool power_of_two = (opts.page_size & (opts.page_size - 1)) == 0;
+  if (opts.keys == 0 || opts.lookups == 0 || opts.scans == 0 ||
+      opts.cache_mb == 0 || !power_of_two ||
+      opts.page_size < BTREE_MIN_PAGE_SIZE ||
+      opts.page_size > BTREE_MAX_PAGE_SIZE) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  printf("%u-byte pages, %u MB buffer pool\n", opts.page_size, opts.cache_mb);
+  return run(&opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
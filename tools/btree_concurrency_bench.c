@@ -0,0 +1,297 @@
+// Measures how B+tree point lookups scale with reader threads while writers
+// keep inserting. The tree uses optimistic lock coupling, so readers take no
+// latches; each configuration runs for a fixed time and reports the combined
+// reader throughput and its speedup over a single reader.
+//
+// Usage: btree_concurrency_bench [--keys N] [--readers 1,2,4,8]
+//                                [--writers N] [--seconds N]
+//                                [--page-size N] [--cache-mb N]
+//                                [--file <path>]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/btree.h"
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define KEY_LENGTH 21
+#define BENCH_MAX_CONFIGS 16
+
+typedef struct {
+  BTree *tree;
+  const bool *stop;
+  u64 keys;      // Readers look up keys [0, keys)
+  u64 rng_state; // Per-thread xorshift state
+  u64 next_key;  // Writers insert next_key, next_key + stride, ...
+  u64 stride;
+  u64 ops;
+  bool ok;
+} WorkerContext;
+
+static u64 rng_next(u64 *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// Bijective mixer (splitmix64 finalizer): distinct indices give distinct,
+// randomly ordered keys.
+static u64 scramble(u64 x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static StringView make_key(char *buffer, u64 bits) {
+  snprintf(buffer, KEY_LENGTH + 1, "user:%016" PRIx64, bits);
+  return sv_from_parts(buffer, KEY_LENGTH);
+}
+
+static bool should_stop(const WorkerContext *ctx) {
+  return __atomic_load_n(ctx->stop, __ATOMIC_RELAXED);
+}
+
+static void *reader_main(void *arg) {
+  WorkerContext *ctx = (WorkerContext *)arg;
+  char key_buffer[KEY_LENGTH + 1];
+  ctx->ok = true;
+  while (!should_stop(ctx)) {
+    // The stop flag is shared by all threads, so poll it only now and then.
+    for (u32 i = 0; i < 64; ++i) {
+      u64 index = rng_next(&ctx->rng_state) % ctx->keys;
+      u64 value;
+      if (!btree_lookup(ctx->tree, make_key(key_buffer, scramble(index)),
+                        &value) ||
+          value != index) {
+        ctx->ok = false;
+        return NULL;
+      }
+    }
+    ctx->ops += 64;
+  }
+  return NULL;
+}
+
+static void *writer_main(void *arg) {
+  WorkerContext *ctx = (WorkerContext *)arg;
+  char key_buffer[KEY_LENGTH + 1];
+  ctx->ok = true;
+  while (!should_stop(ctx)) {
+    if (!btree_insert(ctx->tree, make_key(key_buffer, scramble(ctx->next_key)),
+                      ctx->next_key)) {
+      ctx->ok = false;
+      return NULL;
+    }
+    ctx->next_key += ctx->stride;
+    ctx->ops++;
+  }
+  return NULL;
+}
+
+// Runs 'readers' lookup threads next to 'writers' insert threads for
+// 'seconds' and returns the readers' combined lookups per second.
+static f64 run_config(BTree *tree, u64 keys, u32 readers, u32 writers,
+                      u32 seconds, u64 *next_key) {
+  u32 threads = readers + writers;
+  WorkerContext *workers =
+      (WorkerContext *)calloc(threads, sizeof(WorkerContext));
+  pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  if (!workers || !tids) {
+    LOG_FATAL("Failed to allocate %u workers", threads);
+  }
+
+  bool stop = false;
+  for (u32 t = 0; t < threads; ++t) {
+    bool is_reader = t < readers;
+    workers[t] = (WorkerContext){
+        .tree = tree,
+        .stop = &stop,
+        .keys = keys,
+        .rng_state = 0x9E3779B97F4A7C15ULL * (t + 1),
+        .next_key = is_reader ? 0 : *next_key + (t - readers),
+        .stride = writers,
+    };
+    pthread_create(&tids[t], NULL, is_reader ? reader_main : writer_main,
+                   &workers[t]);
+  }
+  f64 start = now_seconds();
+  sleep(seconds);
+  __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+  u64 lookups = 0;
+  u64 inserts = 0;
+  bool ok = true;
+  for (u32 t = 0; t < threads; ++t) {
+    pthread_join(tids[t], NULL);
+    if (t < readers) {
+      lookups += workers[t].ops;
+    } else {
+      inserts += workers[t].ops;
+      *next_key = MAX(*next_key, workers[t].next_key);
+    }
+    ok &= workers[t].ok;
+  }
+  f64 elapsed = now_seconds() - start;
+
+  f64 lookup_rate = (f64)lookups / elapsed;
+  printf("%7u  %7u  %12.0f  %12.0f  %10.0f", readers, writers, lookup_rate,
+         lookup_rate / readers, (f64)inserts / elapsed);
+  free(tids);
+  free(workers);
+  if (!ok) {
+    LOG_FATAL("A worker failed: lookups must always find loaded keys");
+  }
+  return lookup_rate;
+}
+
+static u32 parse_list(const char *list, i64 *out, u32 max) {
+  u32 count = 0;
+  const char *p = list;
+  while (*p && count < max) {
+    char *end;
+    out[count++] = strtoll(p, &end, 10);
+    if (end == p) {
+      return 0;
+    }
+    p = *end == ',' ? end + 1 : end;
+  }
+  return count;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --keys <N>         Keys loaded before the runs (default: "
+         "1000000)\n");
+  printf("  --readers <list>   Reader thread counts (default: 1,2,4,... up "
+         "to the core count)\n");
+  printf("  --writers <N>      Concurrent insert threads (default: 2)\n");
+  printf("  --seconds <N>      Duration of each run (default: 3)\n");
+  printf("  --page-size <N>    Page size in bytes (default: 4096)\n");
+  printf("  --cache-mb <N>     Buffer pool size in MB (default: 1024)\n");
+  printf("  --file <path>      Scratch database file "
+         "(default: btree_concurrency_bench.db)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 keys = 1000000;
+  u32 writers = 2;
+  u32 seconds = 3;
+  u32 page_size = 4096;
+  u32 cache_mb = 1024;
+  const char *path = "btree_concurrency_bench.db";
+  i64 readers[BENCH_MAX_CONFIGS];
+  u32 reader_count = 0;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  for (i64 r = 1; r <= MAX(cores, 1) && reader_count < BENCH_MAX_CONFIGS;
+       r *= 2) {
+    readers[reader_count++] = r;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--keys") == 0 && has_value) {
+      keys = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--readers") == 0 && has_value) {
+      reader_count = parse_list(argv[++i], readers, BENCH_MAX_CONFIGS);
+    } else if (strcmp(arg, "--writers") == 0 && has_value) {
+      writers = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--seconds") == 0 && has_value) {
+      seconds = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--page-size") == 0 && has_value) {
+      page_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--cache-mb") == 0 && has_value) {
+      cache_mb = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      path = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  bool power_of_two = (page_size & (page_size - 1)) == 0;
+  if (keys == 0 || reader_count == 0 || seconds == 0 || cache_mb == 0 ||
+      !power_of_two || page_size < BTREE_MIN_PAGE_SIZE ||
+      page_size > BTREE_MAX_PAGE_SIZE) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+  g_log_level = LOG_LEVEL_WARNING;
+
+  unlink(path);
+  PageFile file;
+  if (!pf_open(&file, path, page_size, false, false)) {
+    return EXIT_FAILURE;
+  }
+  usize frame_count = (usize)cache_mb * 1024 * 1024 / page_size;
+  Arena arena = arena_init(bp_required_arena_size(
+      frame_count, page_size, DEFAULT_EVICTION_POLICY, false));
+  BufferPool bp;
+  if (!bp_init(&bp, &arena, frame_count, page_size, DEFAULT_EVICTION_POLICY,
+               &file)) {
+    return EXIT_FAILURE;
+  }
+  BTree tree;
+  if (!btree_create(&tree, &bp) || !btree_enable_concurrency(&tree)) {
+    LOG_FATAL("Failed to create the B+tree");
+  }
+  char key_buffer[KEY_LENGTH + 1];
+  for (u64 i = 0; i < keys; ++i) {
+    if (!btree_insert(&tree, make_key(key_buffer, scramble(i)), i)) {
+      LOG_FATAL("Insert %" PRIu64 " failed", i);
+    }
+  }
+  printf("%" PRIu64 " keys loaded, %u-byte pages, %ld cores, %us per run\n\n",
+         keys, page_size, cores, seconds);
+
+  printf("%7s  %7s  %12s  %12s  %10s  %7s\n", "readers", "writers",
+         "lookups/s", "per reader", "inserts/s", "speedup");
+  u64 next_key = keys;
+  f64 baseline = 0.0;
+  for (u32 r = 0; r < reader_count; ++r) {
+    if (readers[r] <= 0) {
+      continue;
+    }
+    f64 rate = run_config(&tree, keys, (u32)readers[r], writers, seconds,
+                          &next_key);
+    if (baseline == 0.0) {
+      baseline = rate;
+    }
+    printf("  %6.2fx\n", rate / baseline);
+  }
+  printf("\nFinal tree: %" PRIu64 " keys, height %u\n",
+         tree.stats.inserts, tree.height);
+
+  btree_close(&tree);
+  bp_shutdown(&bp);
+  arena_free_all(&arena);
+  pf_close(&file);
+  unlink(path);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,304 @@
+// Replays page-access traces against the buffer pool eviction policies and
+// reports their hit ratios.
+//
+// Synthetic traces are generated in memory. Recorded traces are text files
+// with one decimal page id per line, as written by `sqldb --page-trace`.
+//
+// Usage: cache_replay [--frames N] [--accesses N] [--trace <path>]...
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+
+#include <math.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Traces ::
+// =================================================================================================
+
+typedef struct {
+  const char *name;
+  u64 *pages;
+  usize count;
+} Trace;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  // xorshift64*
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 rng_unit(void) { return (f64)(rng_next() >> 11) * 0x1.0p-53; }
+
+typedef struct {
+  f64 *cdf;
+  usize count;
+} ZipfGenerator;
+
+static ZipfGenerator zipf_init(usize count, f64 skew) {
+  ZipfGenerator zipf = {.cdf = (f64 *)malloc(count * sizeof(f64)),
+                        .count = count};
+  if (!zipf.cdf) {
+    LOG_FATAL("Failed to allocate zipf table for %zu items", count);
+  }
+  f64 sum = 0.0;
+  for (usize i = 0; i < count; ++i) {
+    sum += 1.0 / pow((f64)(i + 1), skew);
+    zipf.cdf[i] = sum;
+  }
+  for (usize i = 0; i < count; ++i) {
+    zipf.cdf[i] /= sum;
+  }
+  return zipf;
+}
+
+static u64 zipf_next(const ZipfGenerator *zipf) {
+  f64 u = rng_unit();
+  usize lo = 0;
+  usize hi = zipf->count - 1;
+  while (lo < hi) {
+    usize mid = lo + (hi - lo) / 2;
+    if (zipf->cdf[mid] < u) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static Trace trace_alloc(const char *name, usize count) {
+  Trace trace = {.name = name,
+                 .pages = (u64 *)malloc(count * sizeof(u64)),
+                 .count = count};
+  if (!trace.pages) {
+    LOG_FATAL("Failed to allocate trace %s (%zu accesses)", name, count);
+  }
+  return trace;
+}
+
+// Skewed point lookups over a working set ten times the cache.
+static Trace trace_zipf(usize frames, usize accesses) {
+  Trace trace = trace_alloc("zipf", accesses);
+  ZipfGenerator zipf = zipf_init(frames * 10, 0.99);
+  for (usize i = 0; i < accesses; ++i) {
+    trace.pages[i] = zipf_next(&zipf);
+  }
+  free(zipf.cdf);
+  return trace;
+}
+
+// The zipf workload interrupted by full scans over a table four times the
+// size of the cache, as a reporting query would do to a hot index.
+static Trace trace_zipf_scan(usize frames, usize accesses) {
+  Trace trace = trace_alloc("zipf+scan", accesses);
+  ZipfGenerator zipf = zipf_init(frames * 10, 0.99);
+  u64 scan_base = (u64)frames * 100;
+  usize scan_length = frames * 4;
+  usize i = 0;
+  while (i < accesses) {
+    for (usize n = 0; n < scan_length * 2 && i < accesses; ++n) {
+      trace.pages[i++] = zipf_next(&zipf);
+    }
+    for (usize n = 0; n < scan_length && i < accesses; ++n) {
+      trace.pages[i++] = scan_base + n;
+    }
+  }
+  free(zipf.cdf);
+  return trace;
+}
+
+// A loop slightly larger than the cache: the worst case for recency.
+static Trace trace_loop(usize frames, usize accesses) {
+  Trace trace = trace_alloc("loop", accesses);
+  usize loop_length = frames + frames / 2;
+  for (usize i = 0; i < accesses; ++i) {
+    trace.pages[i] = i % loop_length;
+  }
+  return trace;
+}
+
+static bool trace_load(const char *path, Trace *out_trace) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    LOG_ERROR("Failed to open trace file: %s", path);
+    return false;
+  }
+
+  usize capacity = 1 << 16;
+  Trace trace = trace_alloc(path, capacity);
+  trace.count = 0;
+  char line[64];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (trace.count == capacity) {
+      capacity *= 2;
+      u64 *pages = (u64 *)realloc(trace.pages, capacity * sizeof(u64));
+      if (!pages) {
+        LOG_FATAL("Failed to grow trace %s", path);
+      }
+      trace.pages = pages;
+    }
+    trace.pages[trace.count++] = strtoull(line, NULL, 10);
+  }
+  fclose(file);
+
+  if (trace.count == 0) {
+    LOG_ERROR("Trace file is empty: %s", path);
+    free(trace.pages);
+    return false;
+  }
+  *out_trace = trace;
+  return true;
+}
+
+// =================================================================================================
+// :: Cache Simulation ::
+// =================================================================================================
+
+typedef struct {
+  u64 hits;
+  u64 misses;
+  f64 ns_per_access;
+} ReplayResult;
+
+static bool replay_can_evict(usize frame_idx, void *ctx) {
+  (void)frame_idx;
+  (void)ctx;
+  return true; // Nothing is ever pinned during a replay
+}
+
+static ReplayResult replay(const Trace *trace, EvictionPolicyKind kind,
+                           usize frames) {
+  Arena arena =
+      arena_init(eviction_policy_required_arena_size(kind, frames) +
+                 frames * sizeof(u64) + BASE_ARENA_DEFAULT_ALIGNMENT);
+  EvictionPolicy policy;
+  if (!eviction_policy_init(&policy, kind, frames, &arena)) {
+    LOG_FATAL("Failed to initialize %s policy", eviction_policy_name(kind));
+  }
+  u64 *frame_pages = (u64 *)arena_alloc(&arena, frames * sizeof(u64));
+  BaseHashTableOA page_map =
+      ht_oa_init(frames * 2, base_hash_u64, base_key_equal_u64, NULL);
+  usize used = 0;
+  ReplayResult result = {0};
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (usize i = 0; i < trace->count; ++i) {
+    u64 page_id = trace->pages[i];
+    void *slot = ht_oa_get(&page_map, &page_id);
+    if (slot) {
+      result.hits++;
+      eviction_policy_on_access(&policy, (usize)((u64 *)slot - frame_pages));
+      continue;
+    }
+
+    result.misses++;
+    usize frame_idx = used;
+    if (used < frames) {
+      used++;
+    } else {
+      if (!eviction_policy_pick_victim(&policy, replay_can_evict, NULL,
+                                       &frame_idx)) {
+        LOG_FATAL("%s policy found no victim", eviction_policy_name(kind));
+      }
+      ht_oa_remove(&page_map, &frame_pages[frame_idx]);
+    }
+    frame_pages[frame_idx] = page_id;
+    ht_oa_insert(&page_map, &frame_pages[frame_idx], &frame_pages[frame_idx]);
+    eviction_policy_on_insert(&policy, frame_idx, page_id);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  f64 elapsed_ns = (f64)(end.tv_sec - start.tv_sec) * 1e9 +
+                   (f64)(end.tv_nsec - start.tv_nsec);
+  result.ns_per_access = elapsed_ns / (f64)trace->count;
+
+  ht_oa_free(&page_map);
+  eviction_policy_free(&policy);
+  arena_free_all(&arena);
+  return result;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --frames <N>     Cache size in frames (default: 4096)\n");
+  printf("  --accesses <N>   Synthetic trace length (default: 2000000)\n");
+  printf("  --trace <path>   Also replay a recorded trace (repeatable)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  usize frames = 4096;
+  usize accesses = 2000000;
+  Trace traces[16];
+  usize trace_count = 0;
+  const char *trace_paths[ARRAY_SIZE(traces) - 3];
+  usize trace_path_count = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--frames") == 0 && i + 1 < argc) {
+      frames = (usize)strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--accesses") == 0 && i + 1 < argc) {
+      accesses = (usize)strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--trace") == 0 && i + 1 < argc &&
+               trace_path_count < ARRAY_SIZE(trace_paths)) {
+      trace_paths[trace_path_count++] = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (frames < 4 || accesses == 0) {
+    LOG_ERROR("Need at least 4 frames and 1 access");
+    return EXIT_FAILURE;
+  }
+
+  traces[trace_count++] = trace_zipf(frames, accesses);
+  traces[trace_count++] = trace_zipf_scan(frames, accesses);
+  traces[trace_count++] = trace_loop(frames, accesses);
+  for (usize i = 0; i < trace_path_count; ++i) {
+    if (!trace_load(trace_paths[i], &traces[trace_count])) {
+      return EXIT_FAILURE;
+    }
+    trace_count++;
+  }
+
+  const EvictionPolicyKind kinds[] = {EVICTION_POLICY_CLOCK,
+                                      EVICTION_POLICY_2Q};
+  printf("Cache: %zu frames\n\n", frames);
+  printf("%-24s %12s", "trace", "accesses");
+  for (usize k = 0; k < ARRAY_SIZE(kinds); ++k) {
+    printf(" %10s %8s", eviction_policy_name(kinds[k]), "ns/acc");
+  }
+  printf("\n");
+
+  for (usize t = 0; t < trace_count; ++t) {
+    printf("%-24.24s %12zu", traces[t].name, traces[t].count);
+    for (usize k = 0; k < ARRAY_SIZE(kinds); ++k) {
+      ReplayResult result = replay(&traces[t], kinds[k], frames);
+      f64 ratio = (f64)result.hits / (f64)(result.hits + result.misses);
+      printf(" %9.2f%% %8.1f", ratio * 100.0, result.ns_per_access);
+    }
+    printf("\n");
+    free(traces[t].pages);
+  }
+  return EXIT_SUCCESS;
+}
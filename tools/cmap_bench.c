@@ -0,0 +1,231 @@
+// Measures ConcurrentMap throughput at 1, 4, 16 and 64 threads, with 95/5 and
+// 50/50 read/write mixes over u64 keys. Writes are half upserts, half
+// removals, so the map stays about half full; every read checks that it found
+// either nothing or the key's own value. Each configuration runs once with
+// the default shard count and once with a single shard, which is the same
+// table behind one global reader-writer lock. tests/unit/test_concurrent_map.c
+// checks concurrent writers.
+//
+// Usage: cmap_bench [--keys N] [--threads 1,4,16,64] [--shards N]
+//                   [--seconds N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/concurrent_map.h"
+#include "sqldb/core.h"
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_MAX_CONFIGS 16
+
+typedef struct {
+  ConcurrentMap *map;
+  u64 *slots; // Key i is &slots[i], and its value too
+  u64 key_count;
+  u32 read_percent;
+  const bool *stop;
+  u64 rng_state; // Per-thread xorshift state
+  u64 ops;
+  bool ok;
+} WorkerContext;
+
+static u64 rng_next(u64 *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void *worker_main(void *arg) {
+  WorkerContext *ctx = (WorkerContext *)arg;
+  ctx->ok = true;
+  while (!__atomic_load_n(ctx->stop, __ATOMIC_RELAXED)) {
+    // The stop flag is shared by all threads, so poll it only now and then.
+    for (u32 i = 0; i < 64; ++i) {
+      u64 r = rng_next(&ctx->rng_state);
+      u64 *key = &ctx->slots[(r >> 8) % ctx->key_count];
+      u32 roll = (u32)(r % 100);
+      if (roll < ctx->read_percent) {
+        void *value = cmap_get(ctx->map, key);
+        if (value && value != key) {
+          ctx->ok = false;
+          return NULL;
+        }
+      } else if (roll % 2 == 0) {
+        if (!cmap_put(ctx->map, key, key, NULL)) {
+          ctx->ok = false;
+          return NULL;
+        }
+      } else {
+        cmap_remove(ctx->map, key, NULL);
+      }
+    }
+    ctx->ops += 64;
+  }
+  return NULL;
+}
+
+// Fills half of the keys, runs 'threads' workers for 'seconds' and returns
+// their combined operations per second.
+static f64 run_config(u64 *slots, u64 key_count, u32 shards, u32 threads,
+                      u32 read_percent, u32 seconds) {
+  ConcurrentMap map;
+  if (!cmap_init(&map, shards, key_count, base_hash_u64,
+                 base_key_equal_u64)) {
+    LOG_FATAL("Failed to create the map");
+  }
+  for (u64 i = 0; i < key_count; i += 2) {
+    cmap_insert(&map, &slots[i], &slots[i]);
+  }
+
+  WorkerContext *workers =
+      (WorkerContext *)calloc(threads, sizeof(WorkerContext));
+  pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  if (!workers || !tids) {
+    LOG_FATAL("Failed to allocate %u workers", threads);
+  }
+  bool stop = false;
+  for (u32 t = 0; t < threads; ++t) {
+    workers[t] = (WorkerContext){
+        .map = &map,
+        .slots = slots,
+        .key_count = key_count,
+        .read_percent = read_percent,
+        .stop = &stop,
+        .rng_state = 0x9E3779B97F4A7C15ULL * (t + 1),
+    };
+    pthread_create(&tids[t], NULL, worker_main, &workers[t]);
+  }
+  f64 start = now_seconds();
+  sleep(seconds);
+  __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+  u64 ops = 0;
+  bool ok = true;
+  for (u32 t = 0; t < threads; ++t) {
+    pthread_join(tids[t], NULL);
+    ops += workers[t].ops;
+    ok &= workers[t].ok;
+  }
+  f64 elapsed = now_seconds() - start;
+  free(tids);
+  free(workers);
+  cmap_free(&map);
+  if (!ok) {
+    LOG_FATAL("A worker failed: reads must find nothing or the key's value");
+  }
+  return (f64)ops / elapsed;
+}
+
+static u32 parse_list(const char *list, i64 *out, u32 max) {
+  u32 count = 0;
+  const char *p = list;
+  while (*p && count < max) {
+    char *end;
+    out[count++] = strtoll(p, &end, 10);
+    if (end == p) {
+      return 0;
+    }
+    p = *end == ',' ? end + 1 : end;
+  }
+  return count;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --keys <N>         Key range; half of it is loaded "
+         "(default: 1000000)\n");
+  printf("  --threads <list>   Thread counts (default: 1,4,16,64)\n");
+  printf("  --shards <N>       Shards of the sharded runs (default: %d)\n",
+         CMAP_DEFAULT_SHARDS);
+  printf("  --seconds <N>      Duration of each run (default: 1)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 key_count = 1000000;
+  u32 shards = CMAP_DEFAULT_SHARDS;
+  u32 seconds = 1;
+  i64 threads[BENCH_MAX_CONFIGS] = {1, 4, 16, 64};
+  u32 thread_count = 4;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--keys") == 0 && has_value) {
+      key_count = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--threads") == 0 && has_value) {
+      thread_count = parse_list(argv[++i], threads, BENCH_MAX_CONFIGS);
+    } else if (strcmp(arg, "--shards") == 0 && has_value) {
+      shards = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--seconds") == 0 && has_value) {
+      seconds = (u32)strtoul(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (key_count == 0 || thread_count == 0 || shards == 0 || seconds == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+  g_log_level = LOG_LEVEL_WARNING;
+
+  u64 *slots = (u64 *)malloc(key_count * sizeof(u64));
+  if (!slots) {
+    LOG_ERROR("Failed to allocate %" PRIu64 " keys", key_count);
+    return EXIT_FAILURE;
+  }
+  for (u64 i = 0; i < key_count; ++i) {
+    slots[i] = i * 0x9E3779B97F4A7C15ULL;
+  }
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  printf("%" PRIu64 " keys, %ld cores, %us per run\n", key_count, cores,
+         seconds);
+  static const u32 read_percents[] = {95, 50};
+  for (usize m = 0; m < sizeof(read_percents) / sizeof(read_percents[0]);
+       ++m) {
+    u32 read_percent = read_percents[m];
+    printf("\n%u%% reads, %u%% writes\n", read_percent, 100 - read_percent);
+    printf("  %7s  %14s  %7s  %14s  %7s\n", "threads", "sharded ops/s",
+           "speedup", "1 shard ops/s", "sharded");
+    f64 baseline = 0.0;
+    for (u32 t = 0; t < thread_count; ++t) {
+      if (threads[t] <= 0) {
+        continue;
+      }
+      f64 sharded = run_config(slots, key_count, shards, (u32)threads[t],
+                               read_percent, seconds);
+      f64 single = run_config(slots, key_count, 1, (u32)threads[t],
+                              read_percent, seconds);
+      if (baseline == 0.0) {
+        baseline = sharded;
+      }
+      printf("  %7" PRIi64 "  %14.0f  %6.2fx  %14.0f  %6.2fx\n", threads[t],
+             sharded, sharded / baseline, single, sharded / single);
+    }
+  }
+  free(slots);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,436 @@
+// Compares scans of an in-memory row table (exec_scan + exec_filter) with
+// scans of the same rows stored in the columnar format (exec_column_scan).
+// The generated table mixes columns that suit each encoding: a sorted id
+// (frame of reference), small quantities with NULLs, random prices (plain),
+// a low-cardinality status (dictionary) and long runs of regions (RLE). The
+// queries range from a narrow id range, which zone maps cut down to a few row
+// groups, to full scans, and every columnar result is checked against the
+// row scan's digest.
+//
+// Usage: column_bench [--rows N] [--runs N] [--cache-mb N] [--arena-mb N]
+//                     [--file <path>]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/executor.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+enum { T_ID, T_QUANTITY, T_PRICE, T_STATUS, T_REGION, TABLE_COLUMNS };
+
+static const char *g_column_names[TABLE_COLUMNS] = {"id", "quantity", "price",
+                                                    "status", "region"};
+
+typedef struct {
+  usize rows;
+  u32 runs;
+  u32 cache_mb;
+  u32 arena_mb;
+  const char *path;
+} BenchOptions;
+
+typedef struct {
+  ExecTable table;
+  ExecVector columns[TABLE_COLUMNS];
+  u8 *quantity_nulls; // Bitmap; NULL quantities are 0 in the row table
+} BenchData;
+
+// Order-independent digest of a query's output: its row count and the sum of
+// every column (string lengths for strings).
+typedef struct {
+  u64 rows;
+  f64 sums[TABLE_COLUMNS];
+} OutputDigest;
+
+typedef enum {
+  Q_ID_RANGE,     // id in a 1% range
+  Q_QUANTITY,     // quantity > 40
+  Q_STATUS,       // status = 'O'
+  Q_REGION_PRICE, // region = 'ASIA' AND price < 100.0
+  Q_FULL,         // no predicate
+  QUERY_COUNT,
+} BenchQuery;
+
+static const char *g_query_names[QUERY_COUNT] = {
+    "id range 1%", "quantity > 40", "status = 'O'", "region+price",
+    "full scan"};
+
+static const u32 g_columns[] = {T_ID, T_QUANTITY, T_PRICE, T_STATUS,
+                                T_REGION};
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static bool alloc_column(Arena *arena, ExecVector *column, ExecType type,
+                         usize rows) {
+  column->type = type;
+  usize size = type == EXEC_TYPE_STRING ? sizeof(StringView) : sizeof(i64);
+  column->i64s = (i64 *)arena_alloc(arena, MAX(rows, 1) * size);
+  return column->i64s != NULL;
+}
+
+static bool generate_data(Arena *arena, BenchData *data, usize rows) {
+  static const char *statuses[] = {"F", "O", "P"};
+  static const char *regions[] = {"AFRICA", "AMERICA", "ASIA", "EUROPE",
+                                  "MIDDLE EAST"};
+  ExecVector *t = data->columns;
+  data->quantity_nulls = (u8 *)arena_alloc(arena, rows / 8 + 1);
+  bool ok = data->quantity_nulls &&
+            alloc_column(arena, &t[T_ID], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &t[T_QUANTITY], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &t[T_PRICE], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &t[T_STATUS], EXEC_TYPE_STRING, rows) &&
+            alloc_column(arena, &t[T_REGION], EXEC_TYPE_STRING, rows);
+  if (!ok) {
+    return false;
+  }
+  memset(data->quantity_nulls, 0, rows / 8 + 1);
+  usize region = 0;
+  for (usize i = 0; i < rows; ++i) {
+    t[T_ID].i64s[i] = 1000000 + (i64)i;
+    if (rng_next() % 100 == 0) {
+      data->quantity_nulls[i / 8] |= (u8)(1u << (i % 8));
+      t[T_QUANTITY].i64s[i] = 0;
+    } else {
+      t[T_QUANTITY].i64s[i] = 1 + (i64)(rng_next() % 50);
+    }
+    t[T_PRICE].f64s[i] = (f64)(rng_next() % 10000000) / 100.0;
+    const char *status = statuses[rng_next() % ARRAY_SIZE(statuses)];
+    t[T_STATUS].strings[i] = sv_from_parts(status, strlen(status));
+    if (rng_next() % 4096 == 0) {
+      region = rng_next() % ARRAY_SIZE(regions);
+    }
+    t[T_REGION].strings[i] =
+        sv_from_parts(regions[region], strlen(regions[region]));
+  }
+  data->table = (ExecTable){data->columns, TABLE_COLUMNS, rows};
+  return true;
+}
+
+static bool load_column_table(ColumnTable *table, const BenchData *data) {
+  ColumnInput inputs[TABLE_COLUMNS];
+  for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+    inputs[c] = (ColumnInput){.values = data->columns[c].i64s, .nulls = NULL};
+  }
+  inputs[T_QUANTITY].nulls = data->quantity_nulls;
+  usize rows = data->table.row_count;
+  if (rows > UINT32_MAX) {
+    LOG_ERROR("Too many rows for one append");
+    return false;
+  }
+  return column_table_append(table, inputs, (u32)rows) &&
+         column_table_flush(table);
+}
+
+static ExecExpr *build_predicate(ExecContext *ctx, BenchQuery query,
+                                 usize rows) {
+  ExecExpr *id = exec_expr_column(ctx, T_ID, EXEC_TYPE_INT64);
+  ExecExpr *quantity = exec_expr_column(ctx, T_QUANTITY, EXEC_TYPE_INT64);
+  ExecExpr *price = exec_expr_column(ctx, T_PRICE, EXEC_TYPE_FLOAT64);
+  ExecExpr *status = exec_expr_column(ctx, T_STATUS, EXEC_TYPE_STRING);
+  ExecExpr *region = exec_expr_column(ctx, T_REGION, EXEC_TYPE_STRING);
+  i64 low = 1000000 + (i64)(rows / 2);
+  switch (query) {
+  case Q_ID_RANGE:
+    return exec_expr_between(
+        ctx, id,
+        exec_expr_constant(
+            ctx, (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = low}),
+        exec_expr_constant(ctx, (SqlValue){.kind = SQL_VALUE_INTEGER,
+                                           .integer = low +
+                                                      (i64)(rows / 100)}));
+  case Q_QUANTITY:
+    return exec_expr_compare(
+        ctx, AST_OP_GREATER, quantity,
+        exec_expr_constant(
+            ctx, (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = 40}));
+  case Q_STATUS:
+    return exec_expr_compare(
+        ctx, AST_OP_EQUAL, status,
+        exec_expr_constant(
+            ctx, (SqlValue){.kind = SQL_VALUE_STRING, .string = SV("O")}));
+  case Q_REGION_PRICE:
+    return exec_expr_and(
+        ctx,
+        exec_expr_compare(ctx, AST_OP_EQUAL, region,
+                          exec_expr_constant(
+                              ctx, (SqlValue){.kind = SQL_VALUE_STRING,
+                                              .string = SV("ASIA")})),
+        exec_expr_compare(
+            ctx, AST_OP_LESS, price,
+            exec_expr_constant(
+                ctx, (SqlValue){.kind = SQL_VALUE_FLOAT, .real = 100.0})));
+  default:
+    return NULL;
+  }
+}
+
+static void digest_batch(OutputDigest *digest, const ExecBatch *batch) {
+  for (u32 i = 0; i < batch->selected_count; ++i) {
+    u32 row = exec_batch_row(batch, i);
+    digest->rows++;
+    for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+      const ExecVector *column = &batch->columns[c];
+      switch (column->type) {
+      case EXEC_TYPE_INT64:
+        digest->sums[c] += (f64)column->i64s[row];
+        break;
+      case EXEC_TYPE_FLOAT64:
+        digest->sums[c] += column->f64s[row];
+        break;
+      case EXEC_TYPE_STRING:
+        digest->sums[c] += (f64)column->strings[row].length;
+        break;
+      }
+    }
+  }
+}
+
+static bool digests_equal(const OutputDigest *a, const OutputDigest *b) {
+  if (a->rows != b->rows) {
+    return false;
+  }
+  for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+    if (fabs(a->sums[c] - b->sums[c]) > 1e-9 * MAX(fabs(b->sums[c]), 1.0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs 'query' 'runs' times over the row table, or over 'columns' if it is
+// not NULL, and returns the fastest run in seconds (a negative value on
+// failure). The last run's output goes to 'out_digest'.
+static f64 run_query(Arena *arena, const BenchOptions *opts,
+                     const BenchData *data, const ColumnTable *columns,
+                     BenchQuery query, OutputDigest *out_digest,
+                     ExecColumnScanStats *out_stats) {
+  f64 best = INFINITY;
+  for (u32 run = 0; run < opts->runs; ++run) {
+    arena_reset(arena);
+    ExecContext ctx = {.arena = arena, .has_error = false};
+    f64 start = now_seconds();
+    ExecExpr *predicate = build_predicate(&ctx, query, opts->rows);
+    ExecOperator *root;
+    if (columns) {
+      root = exec_column_scan(&ctx, columns, g_columns,
+                              ARRAY_SIZE(g_columns), predicate);
+    } else {
+      root = exec_scan(&ctx, &data->table, g_columns, ARRAY_SIZE(g_columns));
+      if (predicate) {
+        root = exec_filter(&ctx, root, predicate);
+      }
+    }
+    if (!root) {
+      LOG_ERROR("Could not build query %s", g_query_names[query]);
+      return -1.0;
+    }
+    OutputDigest digest;
+    ZERO_STRUCT(digest);
+    ExecBatch *batch;
+    while ((batch = exec_next(root)) != NULL) {
+      digest_batch(&digest, batch);
+    }
+    if (ctx.has_error) {
+      LOG_ERROR("Query %s failed", g_query_names[query]);
+      return -1.0;
+    }
+    best = MIN(best, now_seconds() - start);
+    *out_digest = digest;
+    if (columns) {
+      *out_stats = exec_column_scan_stats(root);
+    }
+  }
+  return best;
+}
+
+static void print_storage(const ColumnTable *table, const BenchData *data) {
+  printf("%-10s %-15s %12s %12s %8s\n", "column", "encoding", "memory MB",
+         "stored MB", "ratio");
+  usize rows = data->table.row_count;
+  for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+    // In-memory size: 8 bytes per number; per string its view and bytes.
+    f64 memory = (f64)rows * sizeof(i64);
+    if (data->columns[c].type == EXEC_TYPE_STRING) {
+      memory = 0;
+      for (usize i = 0; i < rows; ++i) {
+        memory += (f64)(sizeof(StringView) + data->columns[c].strings[i].length);
+      }
+    }
+    u64 stored = 0;
+    u32 used[COLUMN_ENCODING_COUNT] = {0};
+    for (u32 g = 0; g < table->group_count; ++g) {
+      stored += table->groups[g].chunks[c].byte_length;
+      used[table->groups[g].chunks[c].encoding]++;
+    }
+    char encodings[64] = "";
+    for (u32 e = 0; e < COLUMN_ENCODING_COUNT; ++e) {
+      if (used[e] > 0) {
+        usize length = strlen(encodings);
+        snprintf(encodings + length, sizeof(encodings) - length, "%s%s",
+                 length > 0 ? "+" : "",
+                 column_encoding_name((ColumnEncoding)e));
+      }
+    }
+    printf("%-10s %-15s %12.2f %12.2f %7.1fx\n", g_column_names[c], encodings,
+           memory / (1024.0 * 1024.0), (f64)stored / (1024.0 * 1024.0),
+           memory / MAX((f64)stored, 1.0));
+  }
+  const ColumnTableStats *stats = &table->stats;
+  printf("%" PRIu64 " row groups, %.2f MB stored vs %.2f MB plain\n\n",
+         stats->row_groups, (f64)stats->encoded_bytes / (1024.0 * 1024.0),
+         (f64)stats->plain_bytes / (1024.0 * 1024.0));
+}
+
+static bool run_bench(const BenchOptions *opts) {
+  unlink(opts->path);
+  PageFile file;
+  if (!pf_open(&file, opts->path, DEFAULT_PAGE_SIZE, false, false)) {
+    return false;
+  }
+  usize frame_count = (usize)opts->cache_mb * 1024 * 1024 / DEFAULT_PAGE_SIZE;
+  Arena pool_arena = arena_init(bp_required_arena_size(
+      frame_count, DEFAULT_PAGE_SIZE, DEFAULT_EVICTION_POLICY, false));
+  Arena data_arena = arena_init(opts->rows * 80 + 1024 * 1024);
+  Arena arena = arena_init((usize)opts->arena_mb * 1024 * 1024);
+  BufferPool bp;
+  BenchData data;
+  ColumnTable table;
+  static const ColumnType types[TABLE_COLUMNS] = {
+      COLUMN_TYPE_INT64, COLUMN_TYPE_INT64, COLUMN_TYPE_FLOAT64,
+      COLUMN_TYPE_STRING, COLUMN_TYPE_STRING};
+  bool ok = bp_init(&bp, &pool_arena, frame_count, DEFAULT_PAGE_SIZE,
+                    DEFAULT_EVICTION_POLICY, &file);
+  if (!ok) {
+    arena_free_all(&arena);
+    arena_free_all(&data_arena);
+    arena_free_all(&pool_arena);
+    pf_close(&file);
+    return false;
+  }
+  ok = generate_data(&data_arena, &data, opts->rows) &&
+       column_table_init(&table, &bp, types, TABLE_COLUMNS);
+  if (ok) {
+    f64 start = now_seconds();
+    ok = load_column_table(&table, &data);
+    if (ok) {
+      printf("Loaded %zu rows in %.3f s\n\n", opts->rows,
+             now_seconds() - start);
+      print_storage(&table, &data);
+    }
+  }
+
+  if (ok) {
+    printf("%-14s %10s %10s %10s %8s %9s\n", "query", "rows", "row ms",
+           "column ms", "speedup", "skipped");
+  }
+  for (u32 q = 0; ok && q < QUERY_COUNT; ++q) {
+    BenchQuery query = (BenchQuery)q;
+    OutputDigest expected, actual;
+    ExecColumnScanStats stats;
+    ZERO_STRUCT(stats);
+    f64 row_seconds =
+        run_query(&arena, opts, &data, NULL, query, &expected, &stats);
+    f64 column_seconds =
+        run_query(&arena, opts, &data, &table, query, &actual, &stats);
+    if (row_seconds < 0 || column_seconds < 0) {
+      ok = false;
+      break;
+    }
+    bool is_correct = digests_equal(&actual, &expected);
+    printf("%-14s %10" PRIu64 " %10.2f %10.2f %7.2fx %4u/%-4u%s\n",
+           g_query_names[q], expected.rows, row_seconds * 1000.0,
+           column_seconds * 1000.0, row_seconds / column_seconds,
+           stats.row_groups_skipped, stats.row_groups,
+           is_correct ? "" : "  MISMATCH");
+    ok = is_correct;
+  }
+
+  column_table_free(&table);
+  bp_shutdown(&bp);
+  arena_free_all(&arena);
+  arena_free_all(&data_arena);
+  arena_free_all(&pool_arena);
+  pf_close(&file);
+  unlink(opts->path);
+  return ok;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --rows <N>       Rows in the table (default: 4000000)\n");
+  printf("  --runs <N>       Runs per query, the fastest is reported "
+         "(default: 3)\n");
+  printf("  --cache-mb <N>   Buffer pool size in MB (default: 512)\n");
+  printf("  --arena-mb <N>   Query arena size in MB (default: 256)\n");
+  printf("  --file <path>    Scratch database file (default: "
+         "column_bench.db)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts = {
+      .rows = 4000000,
+      .runs = 3,
+      .cache_mb = 512,
+      .arena_mb = 256,
+      .path = "column_bench.db",
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--rows") == 0 && has_value) {
+      opts.rows = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--runs") == 0 && has_value) {
+      opts.runs = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--cache-mb") == 0 && has_value) {
+      opts.cache_mb = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--arena-mb") == 0 && has_value) {
+      opts.arena_mb = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      opts.path = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (opts.rows < 100 || opts.runs == 0 || opts.cache_mb == 0 ||
+      opts.arena_mb == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  printf("%zu rows, %u-row groups, %u MB buffer pool, best of %u runs\n\n",
+         opts.rows, COLUMN_GROUP_ROWS, opts.cache_mb, opts.runs);
+  return run_bench(&opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,209 @@
+// Measures WAL commit throughput and latency with concurrent sessions, with and
+// without group commit. Every transaction logs one small page write and then
+// commits. The "serial" rows force one log flush per commit for comparison.
+//
+// Usage: commit_bench [--file <path>] [--commits N] [--threads 1,4,16]
+//                     [--windows 0,100,1000] [--batch N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_RECORD_BYTES 128
+#define BENCH_MAX_CONFIGS 16
+
+typedef struct {
+  Wal *wal;
+  pthread_mutex_t *serial_lock; // Non-NULL: one flush per commit
+  u32 commits;
+  u32 thread_idx;
+  Histogram latency_us;
+  bool ok;
+} SessionContext;
+
+static u64 now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
+
+static void *session_main(void *arg) {
+  SessionContext *ctx = (SessionContext *)arg;
+  u8 payload[BENCH_RECORD_BYTES];
+  memset(payload, (int)ctx->thread_idx, sizeof(payload));
+  ctx->ok = true;
+  for (u32 i = 0; i < ctx->commits && ctx->ok; ++i) {
+    u64 start = now_us();
+    if (ctx->serial_lock) {
+      pthread_mutex_lock(ctx->serial_lock);
+    }
+    u64 txn_id = wal_begin_txn(ctx->wal);
+    PageId page_id = (PageId)ctx->thread_idx;
+    ctx->ok = wal_log_page_write(ctx->wal, txn_id, page_id, 0, payload,
+                                 sizeof(payload)) != INVALID_LSN &&
+              wal_commit(ctx->wal, txn_id);
+    if (ctx->serial_lock) {
+      pthread_mutex_unlock(ctx->serial_lock);
+    }
+    histogram_record(&ctx->latency_us, now_us() - start);
+  }
+  return NULL;
+}
+
+static void run_config(const char *path, u32 threads, u32 commits_per_thread,
+                       i64 window_us, u32 batch_size) {
+  unlink(path);
+  Wal wal;
+  if (!wal_open(&wal, path, BENCH_PAGE_SIZE)) {
+    return;
+  }
+  bool serial = window_us < 0;
+  wal_set_group_commit(&wal, serial ? 0 : (u32)window_us, batch_size);
+
+  pthread_mutex_t serial_lock = PTHREAD_MUTEX_INITIALIZER;
+  SessionContext *sessions =
+      (SessionContext *)calloc(threads, sizeof(SessionContext));
+  pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  if (!sessions || !tids) {
+    LOG_FATAL("Failed to allocate %u sessions", threads);
+  }
+
+  u64 start = now_us();
+  for (u32 t = 0; t < threads; ++t) {
+    sessions[t] = (SessionContext){
+        .wal = &wal,
+        .serial_lock = serial ? &serial_lock : NULL,
+        .commits = commits_per_thread,
+        .thread_idx = t,
+    };
+    histogram_init(&sessions[t].latency_us);
+    pthread_create(&tids[t], NULL, session_main, &sessions[t]);
+  }
+  Histogram latency;
+  histogram_init(&latency);
+  bool ok = true;
+  for (u32 t = 0; t < threads; ++t) {
+    pthread_join(tids[t], NULL);
+    histogram_merge(&latency, &sessions[t].latency_us);
+    ok &= sessions[t].ok;
+  }
+  u64 elapsed = now_us() - start;
+
+  char label[32];
+  if (serial) {
+    snprintf(label, sizeof(label), "serial");
+  } else {
+    snprintf(label, sizeof(label), "group %" PRIi64 "us", window_us);
+  }
+  f64 seconds = (f64)elapsed / 1e6;
+  printf("%7u  %-12s %10.0f %8" PRIu64 " %7.1f %8" PRIu64 " %8" PRIu64
+         " %9" PRIu64 "%s\n",
+         threads, label, (f64)latency.total_count / seconds,
+         wal.stats.flushes, histogram_mean(&wal.stats.commit_batch_sizes),
+         histogram_percentile(&latency, 50.0),
+         histogram_percentile(&latency, 99.0),
+         histogram_percentile(&wal.stats.flush_latency_us, 50.0),
+         ok ? "" : "  (errors)");
+
+  free(tids);
+  free(sessions);
+  wal_close(&wal);
+  unlink(path);
+}
+
+static u32 parse_list(const char *list, i64 *out, u32 max) {
+  u32 count = 0;
+  const char *p = list;
+  while (*p && count < max) {
+    char *end;
+    out[count++] = strtoll(p, &end, 10);
+    if (end == p) {
+      return 0;
+    }
+    p = *end == ',' ? end + 1 : end;
+  }
+  return count;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --file <path>      WAL file to create (default: "
+         "commit_bench.wal)\n");
+  printf("  --commits <N>      Total commits per configuration (default: "
+         "4096)\n");
+  printf("  --threads <list>   Concurrent sessions (default: 1,4,16,64)\n");
+  printf("  --windows <list>   Group commit windows in us (default: 0,200)\n");
+  printf("  --batch <N>        Group commit batch size (default: %d)\n",
+         DEFAULT_COMMIT_BATCH_SIZE);
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  const char *path = "commit_bench.wal";
+  u32 total_commits = 4096;
+  u32 batch_size = DEFAULT_COMMIT_BATCH_SIZE;
+  i64 threads[BENCH_MAX_CONFIGS] = {1, 4, 16, 64};
+  u32 thread_count = 4;
+  i64 windows[BENCH_MAX_CONFIGS] = {0, 200};
+  u32 window_count = 2;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      path = argv[++i];
+    } else if (strcmp(arg, "--commits") == 0 && has_value) {
+      total_commits = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--threads") == 0 && has_value) {
+      thread_count = parse_list(argv[++i], threads, BENCH_MAX_CONFIGS);
+    } else if (strcmp(arg, "--windows") == 0 && has_value) {
+      window_count = parse_list(argv[++i], windows, BENCH_MAX_CONFIGS);
+    } else if (strcmp(arg, "--batch") == 0 && has_value) {
+      batch_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (total_commits == 0 || thread_count == 0 || window_count == 0 ||
+      batch_size == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  printf("%u commits of one %d-byte page write each, batch size %u\n\n",
+         total_commits, BENCH_RECORD_BYTES, batch_size);
+  printf("%7s  %-12s %10s %8s %7s %8s %8s %9s\n", "threads", "mode",
+         "commits/s", "flushes", "batch", "p50 us", "p99 us", "fsync us");
+  for (u32 t = 0; t < thread_count; ++t) {
+    if (threads[t] <= 0) {
+      continue;
+    }
+    u32 thread_total = (u32)threads[t];
+    u32 per_thread = MAX(total_commits / thread_total, 1u);
+    run_config(path, thread_total, per_thread, -1, batch_size);
+    for (u32 w = 0; w < window_count; ++w) {
+      run_config(path, thread_total, per_thread, MAX(windows[w], 0),
+                 batch_size);
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,740 @@
+// Measures the vectorized executor on TPC-H-like queries over generated,
+// in-memory lineitem and orders tables. Each query is built as an operator
+// pipeline, drained, and reported as input rows per second together with the
+// batches and rows each operator produced. Q6 is also computed by a plain
+// row-at-a-time loop over the same arrays as a reference point (and to check
+// the result). The p* queries run the same plans morsel by morsel on a worker
+// pool, and their output is checked against the serial plans.
+//
+// Usage: exec_bench [--rows N] [--runs N] [--arena-mb N] [--workers N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/executor.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+// Dates are days since 1970-01-01.
+#define DATE_1992_01_01 8035
+#define DATE_1994_01_01 8766
+#define DATE_1995_01_01 9131
+#define DATE_1998_09_02 10471
+#define DATE_1998_12_01 10561
+
+enum {
+  L_ORDERKEY,
+  L_PARTKEY,
+  L_QUANTITY,
+  L_EXTENDEDPRICE,
+  L_DISCOUNT,
+  L_TAX,
+  L_RETURNFLAG,
+  L_LINESTATUS,
+  L_SHIPDATE,
+  LINEITEM_COLUMNS,
+};
+
+enum {
+  O_ORDERKEY,
+  O_CUSTKEY,
+  O_ORDERDATE,
+  O_ORDERPRIORITY,
+  ORDERS_COLUMNS,
+};
+
+typedef struct {
+  ExecTable lineitem;
+  ExecTable orders;
+  ExecVector lineitem_columns[LINEITEM_COLUMNS];
+  ExecVector orders_columns[ORDERS_COLUMNS];
+  Scheduler *scheduler; // Runs the parallel queries
+} BenchData;
+
+typedef ExecOperator *(*BuildQuery)(ExecContext *ctx, const BenchData *data);
+
+typedef struct {
+  const char *name;
+  BuildQuery build;
+} BenchQuery;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static i64 rng_range(i64 low, i64 high) {
+  return low + (i64)(rng_next() % (u64)(high - low + 1));
+}
+
+static bool alloc_column(Arena *arena, ExecVector *column, ExecType type,
+                         usize rows) {
+  column->type = type;
+  usize size = type == EXEC_TYPE_STRING ? sizeof(StringView) : sizeof(i64);
+  column->i64s = (i64 *)arena_alloc(arena, MAX(rows, 1) * size);
+  return column->i64s != NULL;
+}
+
+// One order per four line items on average; line items reference orders
+// uniformly, so every order joins with some of them.
+static bool generate_data(Arena *arena, BenchData *data, usize rows) {
+  static const char *flags = "RAN";
+  static const char *statuses = "OF";
+  static const char *priorities[] = {"1-URGENT", "2-HIGH", "3-MEDIUM",
+                                     "4-NOT SPECIFIED", "5-LOW"};
+  usize order_count = MAX(rows / 4, 1);
+
+  ExecVector *l = data->lineitem_columns;
+  ExecVector *o = data->orders_columns;
+  bool ok = alloc_column(arena, &l[L_ORDERKEY], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &l[L_PARTKEY], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &l[L_QUANTITY], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &l[L_EXTENDEDPRICE], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &l[L_DISCOUNT], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &l[L_TAX], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &l[L_RETURNFLAG], EXEC_TYPE_STRING, rows) &&
+            alloc_column(arena, &l[L_LINESTATUS], EXEC_TYPE_STRING, rows) &&
+            alloc_column(arena, &l[L_SHIPDATE], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &o[O_ORDERKEY], EXEC_TYPE_INT64, order_count) &&
+            alloc_column(arena, &o[O_CUSTKEY], EXEC_TYPE_INT64, order_count) &&
+            alloc_column(arena, &o[O_ORDERDATE], EXEC_TYPE_INT64, order_count) &&
+            alloc_column(arena, &o[O_ORDERPRIORITY], EXEC_TYPE_STRING,
+                         order_count);
+  if (!ok) {
+    return false;
+  }
+
+  for (usize i = 0; i < order_count; ++i) {
+    o[O_ORDERKEY].i64s[i] = (i64)i + 1;
+    o[O_CUSTKEY].i64s[i] = rng_range(1, (i64)MAX(order_count / 10, 1));
+    o[O_ORDERDATE].i64s[i] = rng_range(DATE_1992_01_01, DATE_1998_12_01 - 151);
+    const char *priority = priorities[rng_next() % ARRAY_SIZE(priorities)];
+    o[O_ORDERPRIORITY].strings[i] = sv_from_parts(priority, strlen(priority));
+  }
+  for (usize i = 0; i < rows; ++i) {
+    f64 quantity = (f64)rng_range(1, 50);
+    l[L_ORDERKEY].i64s[i] = rng_range(1, (i64)order_count);
+    l[L_PARTKEY].i64s[i] = rng_range(1, 200000);
+    l[L_QUANTITY].f64s[i] = quantity;
+    l[L_EXTENDEDPRICE].f64s[i] = quantity * (f64)rng_range(901, 2000);
+    l[L_DISCOUNT].f64s[i] = (f64)rng_range(0, 10) / 100.0;
+    l[L_TAX].f64s[i] = (f64)rng_range(0, 8) / 100.0;
+    l[L_RETURNFLAG].strings[i] = sv_from_parts(&flags[rng_next() % 3], 1);
+    l[L_LINESTATUS].strings[i] = sv_from_parts(&statuses[rng_next() % 2], 1);
+    l[L_SHIPDATE].i64s[i] = rng_range(DATE_1992_01_01, DATE_1998_12_01);
+  }
+
+  data->lineitem =
+      (ExecTable){data->lineitem_columns, LINEITEM_COLUMNS, rows};
+  data->orders = (ExecTable){data->orders_columns, ORDERS_COLUMNS, order_count};
+  return true;
+}
+
+// --- Expression shorthands ---
+
+static ExecExpr *col(ExecContext *ctx, const ExecOperator *input, u32 column) {
+  return exec_expr_column(ctx, column, input->types[column]);
+}
+
+static ExecExpr *int_const(ExecContext *ctx, i64 value) {
+  return exec_expr_constant(
+      ctx, (SqlValue){.kind = SQL_VALUE_INTEGER, .integer = value});
+}
+
+static ExecExpr *float_const(ExecContext *ctx, f64 value) {
+  return exec_expr_constant(ctx,
+                            (SqlValue){.kind = SQL_VALUE_FLOAT, .real = value});
+}
+
+static const u32 g_lineitem_columns[] = {
+    L_ORDERKEY, L_PARTKEY,    L_QUANTITY,   L_EXTENDEDPRICE, L_DISCOUNT,
+    L_TAX,      L_RETURNFLAG, L_LINESTATUS, L_SHIPDATE};
+
+static ExecOperator *scan_lineitem(ExecContext *ctx, const BenchData *data) {
+  return exec_scan(ctx, &data->lineitem, g_lineitem_columns,
+                   ARRAY_SIZE(g_lineitem_columns));
+}
+
+static const u32 g_join_item_columns[] = {L_ORDERKEY, L_EXTENDEDPRICE};
+
+static ExecMorselSource lineitem_morsels(const BenchData *data,
+                                         ExecPipelineFn build, void *arg) {
+  return (ExecMorselSource){&data->lineitem, g_lineitem_columns,
+                            ARRAY_SIZE(g_lineitem_columns), build, arg};
+}
+
+// --- Queries ---
+
+// SELECT * FROM lineitem
+static ExecOperator *query_scan(ExecContext *ctx, const BenchData *data) {
+  return scan_lineitem(ctx, data);
+}
+
+static ExecOperator *filter_pipeline(ExecContext *ctx, ExecOperator *scan,
+                                     void *arg) {
+  (void)arg;
+  return exec_filter(ctx, scan,
+                     exec_expr_compare(ctx, AST_OP_LESS,
+                                       col(ctx, scan, L_QUANTITY),
+                                       float_const(ctx, 24.0)));
+}
+
+// SELECT * FROM lineitem WHERE l_quantity < 24
+static ExecOperator *query_filter(ExecContext *ctx, const BenchData *data) {
+  ExecOperator *scan = scan_lineitem(ctx, data);
+  return scan ? filter_pipeline(ctx, scan, NULL) : NULL;
+}
+
+static ExecOperator *query_parallel_filter(ExecContext *ctx,
+                                           const BenchData *data) {
+  ExecMorselSource source = lineitem_morsels(data, filter_pipeline, NULL);
+  return exec_parallel_scan(ctx, data->scheduler, &source);
+}
+
+// SELECT l_extendedprice * (1 - l_discount) * (1 + l_tax) FROM lineitem
+static ExecOperator *query_project(ExecContext *ctx, const BenchData *data) {
+  ExecOperator *scan = scan_lineitem(ctx, data);
+  if (!scan) {
+    return NULL;
+  }
+  ExecExpr *disc_price = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY, col(ctx, scan, L_EXTENDEDPRICE),
+      exec_expr_arithmetic(ctx, AST_OP_SUBTRACT, int_const(ctx, 1),
+                           col(ctx, scan, L_DISCOUNT)));
+  ExecExpr *charge = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY, disc_price,
+      exec_expr_arithmetic(ctx, AST_OP_ADD, int_const(ctx, 1),
+                           col(ctx, scan, L_TAX)));
+  return exec_project(ctx, scan, &charge, 1);
+}
+
+// TPC-H Q1: pricing summary report.
+static ExecOperator *query_q1(ExecContext *ctx, const BenchData *data) {
+  ExecOperator *scan = scan_lineitem(ctx, data);
+  if (!scan) {
+    return NULL;
+  }
+  ExecOperator *filter = exec_filter(
+      ctx, scan,
+      exec_expr_compare(ctx, AST_OP_LESS_EQUAL, col(ctx, scan, L_SHIPDATE),
+                        int_const(ctx, DATE_1998_09_02)));
+  if (!filter) {
+    return NULL;
+  }
+  ExecExpr *disc_price = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY, col(ctx, filter, L_EXTENDEDPRICE),
+      exec_expr_arithmetic(ctx, AST_OP_SUBTRACT, float_const(ctx, 1.0),
+                           col(ctx, filter, L_DISCOUNT)));
+  ExecExpr *charge = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY,
+      exec_expr_arithmetic(
+          ctx, AST_OP_MULTIPLY, col(ctx, filter, L_EXTENDEDPRICE),
+          exec_expr_arithmetic(ctx, AST_OP_SUBTRACT, float_const(ctx, 1.0),
+                               col(ctx, filter, L_DISCOUNT))),
+      exec_expr_arithmetic(ctx, AST_OP_ADD, float_const(ctx, 1.0),
+                           col(ctx, filter, L_TAX)));
+  ExecExpr *groups[] = {col(ctx, filter, L_RETURNFLAG),
+                        col(ctx, filter, L_LINESTATUS)};
+  ExecAggregate aggregates[] = {
+      {EXEC_AGG_SUM, col(ctx, filter, L_QUANTITY)},
+      {EXEC_AGG_SUM, col(ctx, filter, L_EXTENDEDPRICE)},
+      {EXEC_AGG_SUM, disc_price},
+      {EXEC_AGG_SUM, charge},
+      {EXEC_AGG_AVG, col(ctx, filter, L_QUANTITY)},
+      {EXEC_AGG_AVG, col(ctx, filter, L_EXTENDEDPRICE)},
+      {EXEC_AGG_AVG, col(ctx, filter, L_DISCOUNT)},
+      {EXEC_AGG_COUNT_STAR, NULL},
+  };
+  ExecOperator *aggregate =
+      exec_hash_aggregate(ctx, filter, groups, ARRAY_SIZE(groups), aggregates,
+                          ARRAY_SIZE(aggregates));
+  static const ExecSortKey keys[] = {{0, false}, {1, false}};
+  return exec_sort(ctx, aggregate, keys, ARRAY_SIZE(keys));
+}
+
+// Q1 below the aggregate: the group keys, then the aggregate inputs.
+static ExecOperator *q1_pipeline(ExecContext *ctx, ExecOperator *scan,
+                                 void *arg) {
+  (void)arg;
+  ExecOperator *filter = exec_filter(
+      ctx, scan,
+      exec_expr_compare(ctx, AST_OP_LESS_EQUAL, col(ctx, scan, L_SHIPDATE),
+                        int_const(ctx, DATE_1998_09_02)));
+  if (!filter) {
+    return NULL;
+  }
+  ExecExpr *disc_price = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY, col(ctx, filter, L_EXTENDEDPRICE),
+      exec_expr_arithmetic(ctx, AST_OP_SUBTRACT, float_const(ctx, 1.0),
+                           col(ctx, filter, L_DISCOUNT)));
+  ExecExpr *charge = exec_expr_arithmetic(
+      ctx, AST_OP_MULTIPLY,
+      exec_expr_arithmetic(
+          ctx, AST_OP_MULTIPLY, col(ctx, filter, L_EXTENDEDPRICE),
+          exec_expr_arithmetic(ctx, AST_OP_SUBTRACT, float_const(ctx, 1.0),
+                               col(ctx, filter, L_DISCOUNT))),
+      exec_expr_arithmetic(ctx, AST_OP_ADD, float_const(ctx, 1.0),
+                           col(ctx, filter, L_TAX)));
+  ExecExpr *columns[] = {col(ctx, filter, L_RETURNFLAG),
+                         col(ctx, filter, L_LINESTATUS),
+                         col(ctx, filter, L_QUANTITY),
+                         col(ctx, filter, L_EXTENDEDPRICE),
+                         disc_price,
+                         charge,
+                         col(ctx, filter, L_DISCOUNT)};
+  return exec_project(ctx, filter, columns, ARRAY_SIZE(columns));
+}
+
+static ExecOperator *query_parallel_q1(ExecContext *ctx,
+                                       const BenchData *data) {
+  static const u32 groups[] = {0, 1};
+  static const ExecColumnAggregate aggregates[] = {
+      {EXEC_AGG_SUM, 2}, {EXEC_AGG_SUM, 3}, {EXEC_AGG_SUM, 4},
+      {EXEC_AGG_SUM, 5}, {EXEC_AGG_AVG, 2}, {EXEC_AGG_AVG, 3},
+      {EXEC_AGG_AVG, 6}, {EXEC_AGG_COUNT_STAR, 0},
+  };
+  static const ExecSortKey keys[] = {{0, false}, {1, false}};
+  ExecMorselSource source = lineitem_morsels(data, q1_pipeline, NULL);
+  return exec_sort(ctx,
+                   exec_parallel_aggregate(ctx, data->scheduler, &source,
+                                           groups, ARRAY_SIZE(groups),
+                                           aggregates, ARRAY_SIZE(aggregates)),
+                   keys, ARRAY_SIZE(keys));
+}
+
+static ExecExpr *q6_predicate(ExecContext *ctx, const ExecOperator *scan) {
+  ExecExpr *shipdate = col(ctx, scan, L_SHIPDATE);
+  return exec_expr_and(
+      ctx,
+      exec_expr_and(ctx,
+                    exec_expr_compare(ctx, AST_OP_GREATER_EQUAL, shipdate,
+                                      int_const(ctx, DATE_1994_01_01)),
+                    exec_expr_compare(ctx, AST_OP_LESS, shipdate,
+                                      int_const(ctx, DATE_1995_01_01))),
+      exec_expr_and(ctx,
+                    exec_expr_between(ctx, col(ctx, scan, L_DISCOUNT),
+                                      float_const(ctx, 0.05),
+                                      float_const(ctx, 0.07)),
+                    exec_expr_compare(ctx, AST_OP_LESS,
+                                      col(ctx, scan, L_QUANTITY),
+                                      float_const(ctx, 24.0))));
+}
+
+// TPC-H Q6: forecasting revenue change.
+static ExecOperator *query_q6(ExecContext *ctx, const BenchData *data) {
+  ExecOperator *scan = scan_lineitem(ctx, data);
+  if (!scan) {
+    return NULL;
+  }
+  ExecOperator *filter = exec_filter(ctx, scan, q6_predicate(ctx, scan));
+  if (!filter) {
+    return NULL;
+  }
+  ExecAggregate revenue = {
+      EXEC_AGG_SUM,
+      exec_expr_arithmetic(ctx, AST_OP_MULTIPLY,
+                           col(ctx, filter, L_EXTENDEDPRICE),
+                           col(ctx, filter, L_DISCOUNT))};
+  return exec_hash_aggregate(ctx, filter, NULL, 0, &revenue, 1);
+}
+
+// Q6 below the aggregate: l_extendedprice * l_discount of matching rows.
+static ExecOperator *q6_pipeline(ExecContext *ctx, ExecOperator *scan,
+                                 void *arg) {
+  (void)arg;
+  ExecOperator *filter = exec_filter(ctx, scan, q6_predicate(ctx, scan));
+  if (!filter) {
+    return NULL;
+  }
+  ExecExpr *revenue = exec_expr_arithmetic(ctx, AST_OP_MULTIPLY,
+                                           col(ctx, filter, L_EXTENDEDPRICE),
+                                           col(ctx, filter, L_DISCOUNT));
+  return exec_project(ctx, filter, &revenue, 1);
+}
+
+static ExecOperator *query_parallel_q6(ExecContext *ctx,
+                                       const BenchData *data) {
+  static const ExecColumnAggregate revenue = {EXEC_AGG_SUM, 0};
+  ExecMorselSource source = lineitem_morsels(data, q6_pipeline, NULL);
+  return exec_parallel_aggregate(ctx, data->scheduler, &source, NULL, 0,
+                                 &revenue, 1);
+}
+
+// SELECT o_orderpriority, COUNT(*) FROM orders JOIN lineitem
+//   ON o_orderkey = l_orderkey WHERE o_orderdate < '1995-01-01'
+//   GROUP BY o_orderpriority ORDER BY o_orderpriority
+static ExecOperator *query_join(ExecContext *ctx, const BenchData *data) {
+  static const u32 order_columns[] = {O_ORDERKEY, O_ORDERDATE,
+                                      O_ORDERPRIORITY};
+  ExecOperator *orders = exec_scan(ctx, &data->orders, order_columns,
+                                   ARRAY_SIZE(order_columns));
+  ExecOperator *items = exec_scan(ctx, &data->lineitem, g_join_item_columns,
+                                  ARRAY_SIZE(g_join_item_columns));
+  if (!orders || !items) {
+    return NULL;
+  }
+  ExecOperator *recent = exec_filter(
+      ctx, orders,
+      exec_expr_compare(ctx, AST_OP_LESS, col(ctx, orders, 1),
+                        int_const(ctx, DATE_1995_01_01)));
+  if (!recent) {
+    return NULL;
+  }
+  // Output: l_orderkey, l_extendedprice, o_orderkey, o_orderdate, priority
+  ExecOperator *join = exec_hash_join(ctx, recent, col(ctx, recent, 0), items,
+                                      col(ctx, items, 0));
+  if (!join) {
+    return NULL;
+  }
+  ExecExpr *group = col(ctx, join, 4);
+  ExecAggregate aggregates[] = {{EXEC_AGG_COUNT_STAR, NULL},
+                                {EXEC_AGG_SUM, col(ctx, join, 1)}};
+  ExecOperator *aggregate = exec_hash_aggregate(
+      ctx, join, &group, 1, aggregates, ARRAY_SIZE(aggregates));
+  static const ExecSortKey key = {0, false};
+  return exec_sort(ctx, aggregate, &key, 1);
+}
+
+// Probes the shared orders table with one worker's line items.
+static ExecOperator *join_pipeline(ExecContext *ctx, ExecOperator *scan,
+                                   void *arg) {
+  return exec_hash_join_probe(ctx, (const ExecJoinTable *)arg, scan,
+                              col(ctx, scan, 0));
+}
+
+// The join query with the orders table built once and line items probed in
+// parallel.
+static ExecOperator *query_parallel_join(ExecContext *ctx,
+                                         const BenchData *data) {
+  static const u32 order_columns[] = {O_ORDERKEY, O_ORDERDATE,
+                                      O_ORDERPRIORITY};
+  ExecOperator *orders = exec_scan(ctx, &data->orders, order_columns,
+                                   ARRAY_SIZE(order_columns));
+  if (!orders) {
+    return NULL;
+  }
+  ExecOperator *recent = exec_filter(
+      ctx, orders,
+      exec_expr_compare(ctx, AST_OP_LESS, col(ctx, orders, 1),
+                        int_const(ctx, DATE_1995_01_01)));
+  if (!recent) {
+    return NULL;
+  }
+  ExecJoinTable *table =
+      exec_join_table_build(ctx, recent, col(ctx, recent, 0));
+  if (!table) {
+    return NULL;
+  }
+  static const u32 group = 4;
+  static const ExecColumnAggregate aggregates[] = {{EXEC_AGG_COUNT_STAR, 0},
+                                                   {EXEC_AGG_SUM, 1}};
+  ExecMorselSource source = {&data->lineitem, g_join_item_columns,
+                             ARRAY_SIZE(g_join_item_columns), join_pipeline,
+                             table};
+  static const ExecSortKey key = {0, false};
+  return exec_sort(ctx,
+                   exec_parallel_aggregate(ctx, data->scheduler, &source,
+                                           &group, 1, aggregates,
+                                           ARRAY_SIZE(aggregates)),
+                   &key, 1);
+}
+
+// SELECT l_orderkey, l_extendedprice, l_shipdate FROM lineitem
+//   ORDER BY l_shipdate DESC, l_orderkey
+static ExecOperator *query_sort(ExecContext *ctx, const BenchData *data) {
+  static const u32 columns[] = {L_ORDERKEY, L_EXTENDEDPRICE, L_SHIPDATE};
+  static const ExecSortKey keys[] = {{2, true}, {0, false}};
+  return exec_sort(ctx,
+                   exec_scan(ctx, &data->lineitem, columns,
+                             ARRAY_SIZE(columns)),
+                   keys, ARRAY_SIZE(keys));
+}
+
+// SELECT * FROM lineitem WHERE l_quantity < 24 LIMIT 1000 OFFSET 5000
+static ExecOperator *query_limit(ExecContext *ctx, const BenchData *data) {
+  return exec_limit(ctx, query_filter(ctx, data), 1000, 5000);
+}
+
+static const BenchQuery g_queries[] = {
+    {"scan", query_scan},       {"filter", query_filter},
+    {"project", query_project}, {"q1", query_q1},
+    {"q6", query_q6},           {"join", query_join},
+    {"sort", query_sort},       {"limit", query_limit},
+};
+
+// Parallel plans and the serial plans that must give the same output.
+static const BenchQuery g_parallel_queries[][2] = {
+    {{"pfilter", query_parallel_filter}, {"filter", query_filter}},
+    {{"pq1", query_parallel_q1}, {"q1", query_q1}},
+    {{"pq6", query_parallel_q6}, {"q6", query_q6}},
+    {{"pjoin", query_parallel_join}, {"join", query_join}},
+};
+
+// Q6 one row at a time, without batches or selection vectors.
+static f64 q6_reference(const BenchData *data) {
+  const ExecVector *l = data->lineitem_columns;
+  f64 revenue = 0.0;
+  for (usize i = 0; i < data->lineitem.row_count; ++i) {
+    i64 shipdate = l[L_SHIPDATE].i64s[i];
+    f64 discount = l[L_DISCOUNT].f64s[i];
+    if (shipdate >= DATE_1994_01_01 && shipdate < DATE_1995_01_01 &&
+        discount >= 0.05 && discount <= 0.07 && l[L_QUANTITY].f64s[i] < 24.0) {
+      revenue += l[L_EXTENDEDPRICE].f64s[i] * discount;
+    }
+  }
+  return revenue;
+}
+
+static void print_operators(const ExecOperator *op, int depth) {
+  for (; op; op = op->child) {
+    printf("    %*s%-16s %10" PRIu64 " batches %12" PRIu64 " rows\n",
+           depth * 2, "", op->ops->name, op->stats.batches, op->stats.rows);
+    if (op->build) {
+      print_operators(op->build, depth + 1);
+    }
+    depth++;
+  }
+}
+
+// Runs 'query' 'runs' times and prints its fastest run. Returns false if the
+// query failed.
+static bool run_query(const BenchQuery *query, Arena *arena,
+                      const BenchData *data, u32 runs) {
+  f64 best = INFINITY;
+  u64 output_rows = 0;
+  ExecOperator *root = NULL;
+  for (u32 run = 0; run < runs; ++run) {
+    arena_reset(arena);
+    sched_reset_arenas(data->scheduler);
+    ExecContext ctx = {.arena = arena, .has_error = false};
+    f64 start = now_seconds();
+    root = query->build(&ctx, data);
+    if (!root) {
+      LOG_ERROR("Could not build query %s", query->name);
+      return false;
+    }
+    output_rows = 0;
+    ExecBatch *batch;
+    while ((batch = exec_next(root)) != NULL) {
+      output_rows += batch->selected_count;
+    }
+    exec_close(root);
+    best = MIN(best, now_seconds() - start);
+    if (ctx.has_error) {
+      LOG_ERROR("Query %s failed", query->name);
+      return false;
+    }
+  }
+  f64 input_rows = (f64)data->lineitem.row_count;
+  printf("  %-8s %10.2f ms %10.1f M rows/s %10" PRIu64 " rows out, %zu KB\n",
+         query->name, best * 1e3, input_rows / best / 1e6, output_rows,
+         arena->current_offset / 1024);
+  print_operators(root, 0);
+  return true;
+}
+
+// Checks the executor's Q6 against the reference loop and times both.
+static bool check_q6(Arena *arena, const BenchData *data) {
+  arena_reset(arena);
+  ExecContext ctx = {.arena = arena, .has_error = false};
+  ExecOperator *root = query_q6(&ctx, data);
+  ExecBatch *batch = root ? exec_next(root) : NULL;
+  if (!batch) {
+    LOG_ERROR("Q6 returned no row");
+    return false;
+  }
+  f64 revenue = batch->columns[0].f64s[0];
+  exec_close(root);
+
+  f64 start = now_seconds();
+  f64 expected = q6_reference(data);
+  f64 seconds = now_seconds() - start;
+  printf("  %-8s %10.2f ms %10.1f M rows/s (row at a time)\n", "q6 ref",
+         seconds * 1e3, (f64)data->lineitem.row_count / seconds / 1e6);
+  if (fabs(revenue - expected) > 1e-6 * MAX(fabs(expected), 1.0)) {
+    LOG_ERROR("Q6 revenue %.4f, expected %.4f", revenue, expected);
+    return false;
+  }
+  return true;
+}
+
+// Order-independent digest of a query's output: its row count and the sum of
+// every column (string lengths for strings).
+typedef struct {
+  u64 rows;
+  u32 column_count;
+  f64 sums[16];
+} OutputDigest;
+
+static bool digest_query(const BenchQuery *query, Arena *arena,
+                         const BenchData *data, OutputDigest *out) {
+  arena_reset(arena);
+  sched_reset_arenas(data->scheduler);
+  ExecContext ctx = {.arena = arena, .has_error = false};
+  ExecOperator *root = query->build(&ctx, data);
+  if (!root || root->column_count > ARRAY_SIZE(out->sums)) {
+    LOG_ERROR("Could not build query %s", query->name);
+    return false;
+  }
+  ZERO_STRUCT(*out);
+  out->column_count = root->column_count;
+  ExecBatch *batch;
+  while ((batch = exec_next(root)) != NULL) {
+    out->rows += batch->selected_count;
+    for (u32 c = 0; c < root->column_count; ++c) {
+      const ExecVector *column = &batch->columns[c];
+      for (u32 i = 0; i < batch->selected_count; ++i) {
+        u32 row = exec_batch_row(batch, i);
+        switch (column->type) {
+        case EXEC_TYPE_INT64:
+          out->sums[c] += (f64)column->i64s[row];
+          break;
+        case EXEC_TYPE_FLOAT64:
+          out->sums[c] += column->f64s[row];
+          break;
+        case EXEC_TYPE_STRING:
+          out->sums[c] += (f64)column->strings[row].length;
+          break;
+        }
+      }
+    }
+  }
+  exec_close(root);
+  if (ctx.has_error) {
+    LOG_ERROR("Query %s failed", query->name);
+    return false;
+  }
+  return true;
+}
+
+// Checks that every parallel plan gives the output of its serial plan.
+static bool check_parallel(Arena *arena, const BenchData *data) {
+  for (usize i = 0; i < ARRAY_SIZE(g_parallel_queries); ++i) {
+    const BenchQuery *parallel = &g_parallel_queries[i][0];
+    const BenchQuery *serial = &g_parallel_queries[i][1];
+    OutputDigest got;
+    OutputDigest expected;
+    if (!digest_query(parallel, arena, data, &got) ||
+        !digest_query(serial, arena, data, &expected)) {
+      return false;
+    }
+    bool is_equal = got.rows == expected.rows &&
+                    got.column_count == expected.column_count;
+    for (u32 c = 0; c < got.column_count && is_equal; ++c) {
+      // Partial sums are added in a different order.
+      is_equal = fabs(got.sums[c] - expected.sums[c]) <=
+                 1e-9 * MAX(fabs(expected.sums[c]), 1.0);
+    }
+    if (!is_equal) {
+      LOG_ERROR("%s differs from %s (%" PRIu64 " vs %" PRIu64 " rows)",
+                parallel->name, serial->name, got.rows, expected.rows);
+      return false;
+    }
+  }
+  printf("  Parallel plans match their serial plans\n");
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --rows <N>       Lineitem rows (default: 1000000)\n");
+  printf("  --runs <N>       Runs per query, fastest is reported (default: 3)\n");
+  printf("  --arena-mb <N>   Query arena size in MB, also per worker "
+         "(default: 256)\n");
+  printf("  --workers <N>    Worker threads for p* queries (default: one per "
+         "core)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 rows = 1000000;
+  u64 runs = 3;
+  u64 arena_mb = 256;
+  u64 workers = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--rows") == 0 && has_value) {
+      rows = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--runs") == 0 && has_value) {
+      runs = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--arena-mb") == 0 && has_value) {
+      arena_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--workers") == 0 && has_value) {
+      workers = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (rows == 0 || rows > UINT32_MAX || runs == 0 || runs > UINT32_MAX ||
+      arena_mb == 0 || workers > MAX_WORKER_THREADS) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  usize data_size = (usize)rows * (LINEITEM_COLUMNS + 2) * sizeof(StringView) +
+                    (usize)rows / 4 * (ORDERS_COLUMNS + 1) * sizeof(StringView) +
+                    (usize)64 * 1024;
+  Arena data_arena = arena_init(data_size);
+  Arena query_arena = arena_init((usize)arena_mb * 1024 * 1024);
+  Scheduler scheduler;
+  BenchData data;
+  ZERO_STRUCT(data);
+  if (!sched_init(&scheduler, (u32)workers, (usize)arena_mb * 1024 * 1024)) {
+    arena_free_all(&data_arena);
+    arena_free_all(&query_arena);
+    return EXIT_FAILURE;
+  }
+  data.scheduler = &scheduler;
+  if (!generate_data(&data_arena, &data, (usize)rows)) {
+    sched_shutdown(&scheduler);
+    arena_free_all(&data_arena);
+    arena_free_all(&query_arena);
+    return EXIT_FAILURE;
+  }
+
+  printf("%" PRIu64 " lineitem rows, %zu orders, batches of %d rows, "
+         "%u workers\n",
+         rows, data.orders.row_count, EXEC_BATCH_SIZE, scheduler.worker_count);
+  bool ok = true;
+  for (usize i = 0; i < ARRAY_SIZE(g_queries) && ok; ++i) {
+    ok = run_query(&g_queries[i], &query_arena, &data, (u32)runs);
+  }
+  ok = ok && check_q6(&query_arena, &data);
+  for (usize i = 0; i < ARRAY_SIZE(g_parallel_queries) && ok; ++i) {
+    ok = run_query(&g_parallel_queries[i][0], &query_arena, &data, (u32)runs);
+  }
+  ok = ok && check_parallel(&query_arena, &data);
+
+  sched_shutdown(&scheduler);
+  arena_free_all(&data_arena);
+  arena_free_all(&query_arena);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,187 @@
+// Compares the Swiss table (HT_SWISS_DEFINE) with BaseHashTableOA on u64
+// keys. For table sizes from L1-resident to DRAM-resident, both are filled
+// with random keys from empty (so growth is included), and probed in random
+// order with keys that are present (hits) and keys that are not (misses).
+// Times are per operation. tests/unit/test_hash_table.c checks that the two
+// agree.
+//
+// Usage: hash_bench [--max-keys N] [--probes N]
+
+#define BASE_IMPLEMENTATION
+#include "base.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_MIN_KEYS 1024
+
+HT_SWISS_DECLARE(BenchTable, u64, u64)
+HT_SWISS_DEFINE(BenchTable, u64, u64, base_mix_u64, BASE_HT_SWISS_EQUAL)
+
+typedef struct {
+  f64 insert_ns;
+  f64 hit_ns;
+  f64 miss_ns;
+  u64 checksum; // Sum of the values found, so the probes are not optimized out
+} BenchResult;
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static BenchResult run_oa(const u64 *keys, usize count, const u64 *hits,
+                          const u64 *misses, usize probes) {
+  BenchResult result = {0};
+  BaseHashTableOA oa = ht_oa_init(0, base_hash_u64, base_key_equal_u64, NULL);
+  f64 start = now_seconds();
+  for (usize i = 0; i < count; ++i) {
+    ht_oa_insert(&oa, &keys[i], (void *)&keys[i]);
+  }
+  result.insert_ns = (now_seconds() - start) * 1e9 / (f64)count;
+
+  start = now_seconds();
+  for (usize i = 0; i < probes; ++i) {
+    const u64 *value = (const u64 *)ht_oa_get(&oa, &hits[i]);
+    result.checksum += *value;
+  }
+  result.hit_ns = (now_seconds() - start) * 1e9 / (f64)probes;
+
+  start = now_seconds();
+  for (usize i = 0; i < probes; ++i) {
+    result.checksum += ht_oa_get(&oa, &misses[i]) ? 1 : 0;
+  }
+  result.miss_ns = (now_seconds() - start) * 1e9 / (f64)probes;
+  ht_oa_free(&oa);
+  return result;
+}
+
+static BenchResult run_swiss(const u64 *keys, usize count, const u64 *hits,
+                             const u64 *misses, usize probes) {
+  BenchResult result = {0};
+  BenchTable swiss = ht_BenchTable_init(0);
+  f64 start = now_seconds();
+  for (usize i = 0; i < count; ++i) {
+    ht_BenchTable_insert(&swiss, keys[i], keys[i]);
+  }
+  result.insert_ns = (now_seconds() - start) * 1e9 / (f64)count;
+
+  start = now_seconds();
+  for (usize i = 0; i < probes; ++i) {
+    result.checksum += *ht_BenchTable_get(&swiss, hits[i]);
+  }
+  result.hit_ns = (now_seconds() - start) * 1e9 / (f64)probes;
+
+  start = now_seconds();
+  for (usize i = 0; i < probes; ++i) {
+    result.checksum += ht_BenchTable_get(&swiss, misses[i]) ? 1 : 0;
+  }
+  result.miss_ns = (now_seconds() - start) * 1e9 / (f64)probes;
+  ht_BenchTable_free(&swiss);
+  return result;
+}
+
+// Keys are odd and misses even, so no miss is ever present.
+static bool run_size(usize count, usize probes, u64 *rng) {
+  u64 *keys = (u64 *)malloc(count * sizeof(u64));
+  u64 *hits = (u64 *)malloc(probes * sizeof(u64));
+  u64 *misses = (u64 *)malloc(probes * sizeof(u64));
+  if (!keys || !hits || !misses) {
+    LOG_ERROR("Failed to allocate %zu keys and %zu probes", count, probes);
+    free(keys);
+    free(hits);
+    free(misses);
+    return false;
+  }
+  for (usize i = 0; i < count; ++i) {
+    keys[i] = next_random(rng) | 1;
+  }
+  for (usize i = 0; i < probes; ++i) {
+    hits[i] = keys[next_random(rng) % count];
+    misses[i] = next_random(rng) & ~1ULL;
+  }
+
+  BenchResult oa = run_oa(keys, count, hits, misses, probes);
+  BenchResult swiss = run_swiss(keys, count, hits, misses, probes);
+  if (oa.checksum != swiss.checksum) {
+    LOG_ERROR("Probe results differ at %zu keys", count);
+  }
+  printf("  %10zu  %-6s %8.1f %8.1f %8.1f\n", count, "oa", oa.insert_ns,
+         oa.hit_ns, oa.miss_ns);
+  printf("  %10s  %-6s %8.1f %8.1f %8.1f   (%.2fx / %.2fx / %.2fx)\n", "",
+         "swiss", swiss.insert_ns, swiss.hit_ns, swiss.miss_ns,
+         oa.insert_ns / swiss.insert_ns, oa.hit_ns / swiss.hit_ns,
+         oa.miss_ns / swiss.miss_ns);
+  free(keys);
+  free(hits);
+  free(misses);
+  return oa.checksum == swiss.checksum;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --max-keys <N>     Largest table size (default: 4194304)\n");
+  printf("  --probes <N>       Lookups per measurement (default: 4000000)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 max_keys = 4194304;
+  u64 probes = 4000000;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--max-keys") == 0 && has_value) {
+      max_keys = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--probes") == 0 && has_value) {
+      probes = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (max_keys < BENCH_MIN_KEYS || probes == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+#if defined(__SSE2__)
+  printf("Control groups probed with SSE2\n");
+#else
+  printf("Control groups probed with scalar code\n");
+#endif
+
+  printf("\n  %10s  %-6s %8s %8s %8s   (OA / Swiss)\n", "keys", "table",
+         "insert", "hit", "miss");
+  printf("  %10s  %-6s %8s %8s %8s\n", "", "", "ns/op", "ns/op", "ns/op");
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  for (u64 count = BENCH_MIN_KEYS; count <= max_keys; count *= 8) {
+    if (!run_size((usize)count, (usize)probes, &rng)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
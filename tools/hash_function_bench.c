@@ -0,0 +1,170 @@
+// Measures the byte hashes and checksums in bytes per cycle, for keys from 4
+// to 4096 bytes: the old byte-at-a-time FNV-1a (kept here as the baseline),
+// the seeded wyhash behind base_hash_bytes, and CRC-32C from the lookup table
+// and from the SSE4.2 instruction. tests/unit/test_hash_function.c checks
+// their results. Cycles are read from the time stamp counter, which ticks at
+// the nominal frequency rather than the current one.
+//
+// Usage: hash_function_bench [--bytes N] [--seed N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/checksum.h"
+#include "sqldb/core.h"
+
+#include <inttypes.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_BUFFER_SIZE (4096 + 64)
+#define BENCH_MIN_LENGTH 4
+#define BENCH_MAX_LENGTH 4096
+
+typedef u64 (*BenchHashFunction)(const u8 *data, usize len);
+
+typedef struct {
+  const char *name;
+  BenchHashFunction hash;
+} BenchFunction;
+
+#if !BENCH_HAS_TSC
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+#endif
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static u64 bench_fnv1a(const u8 *data, usize len) {
+  u64 hash = 0xCBF29CE484222325ULL;
+  for (usize i = 0; i < len; ++i) {
+    hash ^= data[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+static u64 bench_wyhash(const u8 *data, usize len) {
+  return base_hash_bytes(data, len);
+}
+
+static u64 bench_crc32c_table(const u8 *data, usize len) {
+  return crc32c_portable(0, data, len);
+}
+
+static u64 bench_crc32c(const u8 *data, usize len) {
+  return crc32c(0, data, len);
+}
+
+// Returns bytes per cycle (or per nanosecond without a TSC).
+static f64 time_function(const BenchFunction *function, const u8 *buffer,
+                         usize len, u64 total_bytes, u64 *sink) {
+  u64 iterations = total_bytes / len + 1;
+  *sink += function->hash(buffer, len); // Warm up
+#if BENCH_HAS_TSC
+  u64 start = __rdtsc();
+#else
+  f64 start = now_seconds();
+#endif
+  for (u64 i = 0; i < iterations; ++i) {
+    // A varying start keeps the calls independent of each other.
+    *sink += function->hash(buffer + (i & 63), len);
+  }
+#if BENCH_HAS_TSC
+  f64 elapsed = (f64)(__rdtsc() - start);
+#else
+  f64 elapsed = (now_seconds() - start) * 1e9;
+#endif
+  return (f64)(iterations * len) / elapsed;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --bytes <N>        Bytes hashed per function and length "
+         "(default: 268435456)\n");
+  printf("  --seed <N>         Hash seed (default: random)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 total_bytes = 256ULL * 1024 * 1024;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--bytes") == 0 && has_value) {
+      total_bytes = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--seed") == 0 && has_value) {
+      base_hash_set_seed(strtoull(argv[++i], NULL, 10));
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (total_bytes == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  u8 *buffer = (u8 *)malloc(BENCH_BUFFER_SIZE);
+  if (!buffer) {
+    LOG_ERROR("Failed to allocate the benchmark buffer");
+    return EXIT_FAILURE;
+  }
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  for (usize i = 0; i < BENCH_BUFFER_SIZE; ++i) {
+    buffer[i] = (u8)next_random(&rng);
+  }
+
+  const BenchFunction functions[] = {
+      {"fnv1a", bench_fnv1a},
+      {"wyhash", bench_wyhash},
+      {"crc32c table", bench_crc32c_table},
+      {crc32c_is_hardware() ? "crc32c sse4.2" : "crc32c", bench_crc32c},
+  };
+  usize function_count = sizeof(functions) / sizeof(functions[0]);
+
+  printf("Bytes per %s, seed %016" PRIx64 "\n",
+         BENCH_HAS_TSC ? "TSC cycle" : "nanosecond", base_hash_seed());
+  printf("  %-8s", "length");
+  for (usize f = 0; f < function_count; ++f) {
+    printf(" %14s", functions[f].name);
+  }
+  printf("\n");
+  u64 sink = 0;
+  for (usize len = BENCH_MIN_LENGTH; len <= BENCH_MAX_LENGTH; len *= 2) {
+    printf("  %-8zu", len);
+    for (usize f = 0; f < function_count; ++f) {
+      printf(" %14.2f",
+             time_function(&functions[f], buffer, len, total_bytes, &sink));
+    }
+    printf("\n");
+  }
+  printf("(checksum %016" PRIx64 ")\n", sink);
+  free(buffer);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+// Compares heap insert throughput and space amplification across page sizes.
+// Each run inserts tuples of random length into a fresh heap file, then
+// deletes half of them at random and inserts as many again, so the second
+// phase exercises the free space map and in-page compaction.
+//
+// Usage: heap_bench [--tuples N] [--min-size N] [--max-size N]
+//                   [--cache-mb N] [--file <path>]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/heap_file.h"
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+typedef struct {
+  u64 tuples;
+  u32 min_size;
+  u32 max_size;
+  u32 cache_mb;
+  const char *path;
+} BenchOptions;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static u32 random_length(const BenchOptions *opts) {
+  return opts->min_size +
+         (u32)(rng_next() % (opts->max_size - opts->min_size + 1));
+}
+
+static f64 space_amplification(const HeapFile *heap, u32 page_size) {
+  f64 used = (f64)heap_file_page_count(heap) * page_size;
+  return heap->tuple_bytes ? used / (f64)heap->tuple_bytes : 0.0;
+}
+
+static void run_page_size(const BenchOptions *opts, u32 page_size) {
+  if (opts->max_size > heap_page_max_tuple_size(page_size)) {
+    printf("%6u  skipped: tuples up to %u bytes do not fit\n", page_size,
+           opts->max_size);
+    return;
+  }
+  unlink(opts->path);
+  PageFile file;
+  if (!pf_open(&file, opts->path, page_size, false, false)) {
+    return;
+  }
+  usize frame_count = (usize)opts->cache_mb * 1024 * 1024 / page_size;
+  Arena arena = arena_init(bp_required_arena_size(
+      frame_count, page_size, DEFAULT_EVICTION_POLICY, false));
+  BufferPool bp;
+  if (!bp_init(&bp, &arena, frame_count, page_size, DEFAULT_EVICTION_POLICY,
+               &file)) {
+    arena_free_all(&arena);
+    pf_close(&file);
+    return;
+  }
+  HeapFile heap;
+  heap_file_init(&heap, &bp);
+
+  RecordId *rids = (RecordId *)malloc(opts->tuples * sizeof(RecordId));
+  u8 *tuple = (u8 *)malloc(opts->max_size);
+  if (!rids || !tuple) {
+    LOG_FATAL("Failed to allocate benchmark buffers");
+  }
+  memset(tuple, 0x5A, opts->max_size);
+
+  f64 start = now_seconds();
+  for (u64 i = 0; i < opts->tuples; ++i) {
+    if (!heap_insert(&heap, tuple, random_length(opts), &rids[i])) {
+      LOG_FATAL("Insert %" PRIu64 " failed", i);
+    }
+  }
+  f64 load_seconds = now_seconds() - start;
+  f64 load_amp = space_amplification(&heap, page_size);
+  usize load_pages = heap_file_page_count(&heap);
+
+  // Churn: delete a random half, then refill the holes.
+  u64 churn = opts->tuples / 2;
+  for (u64 i = 0; i < churn; ++i) {
+    u64 j = i + rng_next() % (opts->tuples - i);
+    RecordId tmp = rids[i];
+    rids[i] = rids[j];
+    rids[j] = tmp;
+    heap_delete(&heap, rids[i]);
+  }
+  start = now_seconds();
+  for (u64 i = 0; i < churn; ++i) {
+    if (!heap_insert(&heap, tuple, random_length(opts), &rids[i])) {
+      LOG_FATAL("Churn insert %" PRIu64 " failed", i);
+    }
+  }
+  f64 churn_seconds = now_seconds() - start;
+
+  printf("%6u %12.0f %8.3f %8zu %12.0f %8.3f %8zu %10" PRIu64 "\n", page_size,
+         (f64)opts->tuples / load_seconds, load_amp, load_pages,
+         (f64)churn / churn_seconds, space_amplification(&heap, page_size),
+         heap_file_page_count(&heap), bp.stats.evictions);
+
+  free(tuple);
+  free(rids);
+  heap_file_free(&heap);
+  bp_shutdown(&bp);
+  arena_free_all(&arena);
+  pf_close(&file);
+  unlink(opts->path);
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --tuples <N>     Tuples to load per page size (default: "
+         "1000000)\n");
+  printf("  --min-size <N>   Smallest tuple in bytes (default: 16)\n");
+  printf("  --max-size <N>   Largest tuple in bytes (default: 256)\n");
+  printf("  --cache-mb <N>   Buffer pool size in MB (default: 256)\n");
+  printf("  --file <path>    Scratch database file (default: heap_bench.db)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts = {
+      .tuples = 1000000,
+      .min_size = 16,
+      .max_size = 256,
+      .cache_mb = 256,
+      .path = "heap_bench.db",
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--tuples") == 0 && has_value) {
+      opts.tuples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--min-size") == 0 && has_value) {
+      opts.min_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--max-size") == 0 && has_value) {
+      opts.max_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--cache-mb") == 0 && has_value) {
+      opts.cache_mb = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      opts.path = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (opts.tuples < 2 || opts.min_size == 0 ||
+      opts.min_size > opts.max_size || opts.cache_mb == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  printf("%" PRIu64 " tuples of %u-%u bytes, %u MB buffer pool\n\n",
+         opts.tuples, opts.min_size, opts.max_size, opts.cache_mb);
+  printf("%6s %12s %8s %8s %12s %8s %8s %10s\n", "page", "load ins/s",
+         "amp", "pages", "churn ins/s", "amp", "pages", "evictions");
+  const u32 page_sizes[] = {4096, 16384, 65536};
+  for (usize i = 0; i < ARRAY_SIZE(page_sizes); ++i) {
+    run_page_size(&opts, page_sizes[i]);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+// Measures page I/O throughput and latency of the async I/O backends (io_uring
+// and the synchronous pread/pwrite fallback) against a local file.
+//
+// Usage: io_bench [--file <path>] [--size-mb N] [--page-size N] [--depth N]
+//                 [--ops N] [--write] [--sequential] [--direct]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/histogram.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+typedef struct {
+  const char *path;
+  u64 size_mb;
+  u32 page_size;
+  u32 depth;
+  u64 ops;
+  bool write;
+  bool sequential;
+  bool direct;
+} BenchOptions;
+
+typedef struct {
+  u8 *buffer;
+  u64 start_ns;
+} InflightOp;
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static u64 g_rng_state = 0x2545F4914F6CDD1DULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static bool prepare_file(const BenchOptions *opts, PageId page_count) {
+  PageFile pf;
+  if (!pf_open(&pf, opts->path, opts->page_size, false, false)) {
+    return false;
+  }
+  bool ok = true;
+  if (pf_page_count(&pf) < page_count) {
+    printf("Creating %" PRIu64 " MB test file %s...\n", opts->size_mb,
+           opts->path);
+    u8 *page = (u8 *)aligned_alloc(opts->page_size, opts->page_size);
+    for (PageId id = pf_page_count(&pf); ok && id < page_count; ++id) {
+      memset(page, (int)(id & 0xFF), opts->page_size);
+      ok = pf_write_page(&pf, id, page);
+    }
+    free(page);
+    ok = ok && pf_sync(&pf);
+  }
+  pf_close(&pf);
+  return ok;
+}
+
+static void run_backend(const BenchOptions *opts, AsyncIoBackend backend,
+                        PageId page_count) {
+  PageFile pf;
+  if (!pf_open(&pf, opts->path, opts->page_size, false, opts->direct)) {
+    return;
+  }
+  AsyncIo aio;
+  if (!async_io_init(&aio, &pf, opts->depth, backend)) {
+    pf_close(&pf);
+    return;
+  }
+  if (aio.backend != backend) {
+    printf("%-9s unavailable on this system\n",
+           async_io_backend_name(backend));
+    async_io_shutdown(&aio);
+    pf_close(&pf);
+    return;
+  }
+
+  InflightOp *ops = (InflightOp *)calloc(opts->depth, sizeof(InflightOp));
+  InflightOp **free_ops = (InflightOp **)malloc(opts->depth * sizeof(void *));
+  AsyncIoCompletion *completions =
+      (AsyncIoCompletion *)malloc(opts->depth * sizeof(AsyncIoCompletion));
+  u8 *buffers = (u8 *)aligned_alloc(opts->page_size,
+                                    (usize)opts->depth * opts->page_size);
+  if (!ops || !free_ops || !completions || !buffers) {
+    LOG_FATAL("Failed to allocate benchmark buffers");
+  }
+  for (u32 i = 0; i < opts->depth; ++i) {
+    ops[i].buffer = buffers + (usize)i * opts->page_size;
+    memset(ops[i].buffer, 0xA5, opts->page_size);
+    free_ops[i] = &ops[i];
+  }
+  u32 free_count = opts->depth;
+
+  Histogram latency;
+  histogram_init(&latency);
+  u64 issued = 0;
+  u64 done = 0;
+  u64 failures = 0;
+  PageId next_sequential = 0;
+  u64 start = now_ns();
+
+  while (done < opts->ops) {
+    while (free_count > 0 && issued < opts->ops) {
+      InflightOp *op = free_ops[--free_count];
+      PageId page_id = opts->sequential ? next_sequential++ % page_count
+                                        : rng_next() % page_count;
+      AsyncIoRequest request = {
+          .op = opts->write ? ASYNC_IO_WRITE : ASYNC_IO_READ,
+          .page_id = page_id,
+          .buffer = op->buffer,
+          .user_data = op,
+      };
+      op->start_ns = now_ns();
+      if (!async_io_prepare(&aio, &request)) {
+        free_ops[free_count++] = op;
+        break;
+      }
+      issued++;
+    }
+    async_io_submit(&aio);
+
+    u32 n = async_io_reap(&aio, completions, opts->depth, 1);
+    u64 end = now_ns();
+    for (u32 i = 0; i < n; ++i) {
+      InflightOp *op = (InflightOp *)completions[i].user_data;
+      histogram_record(&latency, end - op->start_ns);
+      failures += completions[i].ok ? 0 : 1;
+      free_ops[free_count++] = op;
+    }
+    done += n;
+    if (n == 0 && async_io_in_flight(&aio) == 0 && issued >= opts->ops) {
+      break;
+    }
+  }
+  u64 elapsed = now_ns() - start;
+
+  f64 seconds = (f64)elapsed / 1e9;
+  f64 iops = (f64)done / seconds;
+  printf("%-9s %10.0f %9.1f %9.1f %9.1f %9.1f %9.1f %8" PRIu64 "\n",
+         async_io_backend_name(backend), iops,
+         iops * opts->page_size / (1024.0 * 1024.0),
+         (f64)histogram_percentile(&latency, 50.0) / 1e3,
+         (f64)histogram_percentile(&latency, 99.0) / 1e3,
+         (f64)histogram_percentile(&latency, 99.9) / 1e3,
+         histogram_mean(&latency) / 1e3, failures);
+
+  free(buffers);
+  free(completions);
+  free(free_ops);
+  free(ops);
+  async_io_shutdown(&aio);
+  pf_close(&pf);
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --file <path>      Test file (default: io_bench.dat)\n");
+  printf("  --size-mb <N>      Test file size in MB (default: 256)\n");
+  printf("  --page-size <N>    Page size in bytes (default: %d)\n",
+         DEFAULT_PAGE_SIZE);
+  printf("  --depth <N>        Queue depth (default: %d)\n",
+         DEFAULT_IO_QUEUE_DEPTH);
+  printf("  --ops <N>          Operations per backend (default: 200000)\n");
+  printf("  --write            Random writes instead of reads\n");
+  printf("  --sequential       Sequential instead of random pages\n");
+  printf("  --direct           Use O_DIRECT (measures the device, not the "
+         "page cache)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts = {
+      .path = "io_bench.dat",
+      .size_mb = 256,
+      .page_size = DEFAULT_PAGE_SIZE,
+      .depth = DEFAULT_IO_QUEUE_DEPTH,
+      .ops = 200000,
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      opts.path = argv[++i];
+    } else if (strcmp(arg, "--size-mb") == 0 && has_value) {
+      opts.size_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--page-size") == 0 && has_value) {
+      opts.page_size = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--depth") == 0 && has_value) {
+      opts.depth = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--ops") == 0 && has_value) {
+      opts.ops = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--write") == 0) {
+      opts.write = true;
+    } else if (strcmp(arg, "--sequential") == 0) {
+      opts.sequential = true;
+    } else if (strcmp(arg, "--direct") == 0) {
+      opts.direct = true;
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (opts.page_size < 512 || (opts.page_size & (opts.page_size - 1)) != 0 ||
+      opts.depth == 0 || opts.depth > MAX_IO_QUEUE_DEPTH || opts.ops == 0 ||
+      opts.size_mb == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  PageId page_count = opts.size_mb * 1024 * 1024 / opts.page_size;
+  if (!prepare_file(&opts, page_count)) {
+    return EXIT_FAILURE;
+  }
+
+  printf("%s %s, %u-byte pages, queue depth %u, %" PRIu64 " ops%s\n\n",
+         opts.sequential ? "Sequential" : "Random",
+         opts.write ? "writes" : "reads", opts.page_size, opts.depth,
+         opts.ops, opts.direct ? ", O_DIRECT" : "");
+  printf("%-9s %10s %9s %9s %9s %9s %9s %8s\n", "backend", "IOPS", "MB/s",
+         "p50 us", "p99 us", "p99.9 us", "mean us", "errors");
+  run_backend(&opts, ASYNC_IO_BACKEND_SYNC, page_count);
+  run_backend(&opts, ASYNC_IO_BACKEND_IO_URING, page_count);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,387 @@
+// Compares the executor's hash joins on a generated build table (unique keys,
+// a float and a string column) joined with a probe table four times its size.
+// Probe keys are drawn uniformly or from a Zipf distribution, where a few hot
+// keys take most of the probes. Each distribution runs the chained hash join,
+// the radix join serially and on a worker pool, and the radix join with a
+// memory budget small enough to spill; every variant's output is checked
+// against the chained join.
+//
+// Usage: join_bench [--rows N] [--runs N] [--zipf S] [--budget-mb N]
+//                   [--arena-mb N] [--workers N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/executor.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+enum { B_KEY, B_PRICE, B_TAG, BUILD_COLUMNS };
+enum { P_KEY, P_AMOUNT, PROBE_COLUMNS };
+
+typedef struct {
+  ExecTable build;
+  ExecTable probe;
+  ExecVector build_columns[BUILD_COLUMNS];
+  ExecVector probe_columns[PROBE_COLUMNS];
+} JoinData;
+
+typedef enum {
+  JOIN_CHAINED,
+  JOIN_RADIX,
+  JOIN_PARALLEL_RADIX,
+  JOIN_SPILLING_RADIX,
+} JoinKind;
+
+typedef struct {
+  const char *name;
+  JoinKind kind;
+} BenchJoin;
+
+static const BenchJoin g_joins[] = {
+    {"chained", JOIN_CHAINED},
+    {"radix", JOIN_RADIX},
+    {"pradix", JOIN_PARALLEL_RADIX},
+    {"spill", JOIN_SPILLING_RADIX},
+};
+
+typedef struct {
+  Scheduler *scheduler;
+  usize budget; // For JOIN_SPILLING_RADIX
+  u32 runs;
+} BenchSettings;
+
+// Order-independent digest of a join's output: its row count and the sum of
+// every column (string lengths for strings).
+typedef struct {
+  u64 rows;
+  f64 sums[BUILD_COLUMNS + PROBE_COLUMNS];
+} OutputDigest;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, 1).
+static f64 rng_unit(void) {
+  return (f64)(rng_next() >> 11) / 9007199254740992.0;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static bool alloc_column(Arena *arena, ExecVector *column, ExecType type,
+                         usize rows) {
+  column->type = type;
+  usize size = type == EXEC_TYPE_STRING ? sizeof(StringView) : sizeof(i64);
+  column->i64s = (i64 *)arena_alloc(arena, MAX(rows, 1) * size);
+  return column->i64s != NULL;
+}
+
+// Build keys are 1..build_rows in random order. Probe keys are uniform over
+// them if 'zipf' is 0, else key k is drawn with weight 1 / k^zipf.
+static bool generate_data(Arena *arena, JoinData *data, usize build_rows,
+                          usize probe_rows, f64 zipf) {
+  static const char *tags[] = {"AIR", "MAIL", "RAIL", "SHIP", "TRUCK"};
+  ExecVector *b = data->build_columns;
+  ExecVector *p = data->probe_columns;
+  f64 *cdf = (f64 *)arena_alloc(arena, build_rows * sizeof(f64));
+  bool ok = cdf &&
+            alloc_column(arena, &b[B_KEY], EXEC_TYPE_INT64, build_rows) &&
+            alloc_column(arena, &b[B_PRICE], EXEC_TYPE_FLOAT64, build_rows) &&
+            alloc_column(arena, &b[B_TAG], EXEC_TYPE_STRING, build_rows) &&
+            alloc_column(arena, &p[P_KEY], EXEC_TYPE_INT64, probe_rows) &&
+            alloc_column(arena, &p[P_AMOUNT], EXEC_TYPE_INT64, probe_rows);
+  if (!ok) {
+    return false;
+  }
+
+  for (usize i = 0; i < build_rows; ++i) {
+    b[B_KEY].i64s[i] = (i64)i + 1;
+    b[B_PRICE].f64s[i] = (f64)(rng_next() % 100000) / 100.0;
+    const char *tag = tags[rng_next() % ARRAY_SIZE(tags)];
+    b[B_TAG].strings[i] = sv_from_parts(tag, strlen(tag));
+  }
+  for (usize i = build_rows - 1; i > 0; --i) {
+    usize j = (usize)(rng_next() % (i + 1));
+    i64 key = b[B_KEY].i64s[i];
+    b[B_KEY].i64s[i] = b[B_KEY].i64s[j];
+    b[B_KEY].i64s[j] = key;
+  }
+
+  f64 total = 0.0;
+  for (usize k = 0; k < build_rows; ++k) {
+    total += zipf > 0.0 ? 1.0 / pow((f64)(k + 1), zipf) : 1.0;
+    cdf[k] = total;
+  }
+  for (usize i = 0; i < probe_rows; ++i) {
+    f64 target = rng_unit() * total;
+    usize low = 0;
+    usize high = build_rows - 1;
+    while (low < high) {
+      usize mid = low + (high - low) / 2;
+      if (cdf[mid] < target) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    p[P_KEY].i64s[i] = (i64)low + 1;
+    p[P_AMOUNT].i64s[i] = (i64)(rng_next() % 1000);
+  }
+
+  data->build = (ExecTable){data->build_columns, BUILD_COLUMNS, build_rows};
+  data->probe = (ExecTable){data->probe_columns, PROBE_COLUMNS, probe_rows};
+  return true;
+}
+
+// Output: p_key, p_amount, b_key, b_price, b_tag
+static ExecOperator *build_join(ExecContext *ctx, const JoinData *data,
+                                const BenchJoin *join,
+                                const BenchSettings *settings) {
+  static const u32 build_columns[] = {B_KEY, B_PRICE, B_TAG};
+  static const u32 probe_columns[] = {P_KEY, P_AMOUNT};
+  ExecOperator *build = exec_scan(ctx, &data->build, build_columns,
+                                  ARRAY_SIZE(build_columns));
+  ExecOperator *probe = exec_scan(ctx, &data->probe, probe_columns,
+                                  ARRAY_SIZE(probe_columns));
+  if (!build || !probe) {
+    return NULL;
+  }
+  ExecExpr *build_key = exec_expr_column(ctx, 0, build->types[0]);
+  ExecExpr *probe_key = exec_expr_column(ctx, 0, probe->types[0]);
+  switch (join->kind) {
+  case JOIN_CHAINED:
+    return exec_hash_join(ctx, build, build_key, probe, probe_key);
+  case JOIN_RADIX:
+    return exec_radix_join(ctx, build, build_key, probe, probe_key, 0, NULL);
+  case JOIN_PARALLEL_RADIX:
+    return exec_radix_join(ctx, build, build_key, probe, probe_key, 0,
+                           settings->scheduler);
+  case JOIN_SPILLING_RADIX:
+    return exec_radix_join(ctx, build, build_key, probe, probe_key,
+                           settings->budget, settings->scheduler);
+  }
+  return NULL;
+}
+
+static void digest_batch(OutputDigest *digest, const ExecBatch *batch,
+                         u32 column_count) {
+  digest->rows += batch->selected_count;
+  for (u32 c = 0; c < column_count; ++c) {
+    const ExecVector *column = &batch->columns[c];
+    for (u32 i = 0; i < batch->selected_count; ++i) {
+      u32 row = exec_batch_row(batch, i);
+      switch (column->type) {
+      case EXEC_TYPE_INT64:
+        digest->sums[c] += (f64)column->i64s[row];
+        break;
+      case EXEC_TYPE_FLOAT64:
+        digest->sums[c] += column->f64s[row];
+        break;
+      case EXEC_TYPE_STRING:
+        digest->sums[c] += (f64)column->strings[row].length;
+        break;
+      }
+    }
+  }
+}
+
+static bool digests_equal(const OutputDigest *a, const OutputDigest *b) {
+  if (a->rows != b->rows) {
+    return false;
+  }
+  for (usize c = 0; c < ARRAY_SIZE(a->sums); ++c) {
+    // Rows come out in a different order.
+    if (fabs(a->sums[c] - b->sums[c]) > 1e-9 * MAX(fabs(b->sums[c]), 1.0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs 'join' settings->runs times and prints its fastest run, then digests
+// one more run into 'out'. Returns false if the join failed.
+static bool run_join(const BenchJoin *join, Arena *arena, const JoinData *data,
+                     const BenchSettings *settings, OutputDigest *out) {
+  f64 best = INFINITY;
+  u64 output_rows = 0;
+  ExecRadixJoinStats stats = {0};
+  for (u32 run = 0; run <= settings->runs; ++run) {
+    arena_reset(arena);
+    sched_reset_arenas(settings->scheduler);
+    ExecContext ctx = {.arena = arena, .has_error = false};
+    bool is_digest_run = run == settings->runs;
+    f64 start = now_seconds();
+    ExecOperator *root = build_join(&ctx, data, join, settings);
+    if (!root) {
+      LOG_ERROR("Could not build join %s", join->name);
+      return false;
+    }
+    output_rows = 0;
+    ZERO_STRUCT(*out);
+    ExecBatch *batch;
+    while ((batch = exec_next(root)) != NULL) {
+      output_rows += batch->selected_count;
+      if (is_digest_run) {
+        digest_batch(out, batch, root->column_count);
+      }
+    }
+    exec_close(root);
+    if (!is_digest_run) {
+      best = MIN(best, now_seconds() - start);
+    }
+    if (ctx.has_error) {
+      LOG_ERROR("Join %s failed", join->name);
+      return false;
+    }
+    if (is_digest_run && join->kind != JOIN_CHAINED) {
+      stats = exec_radix_join_stats(root);
+    }
+  }
+
+  f64 input_rows = (f64)(data->build.row_count + data->probe.row_count);
+  printf("  %-8s %10.2f ms %10.1f M rows/s %10" PRIu64 " rows out, %zu KB\n",
+         join->name, best * 1e3, input_rows / best / 1e6, output_rows,
+         arena->current_offset / 1024);
+  if (join->kind != JOIN_CHAINED) {
+    printf("    %u partitions, %u spill files per side, %" PRIu64
+           " rows spilled, %" PRIu64 " probe rescans\n",
+           stats.partitions, stats.spill_partitions, stats.spilled_rows,
+           stats.probe_rescans);
+  }
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --rows <N>       Build rows; the probe side has 4x as many "
+         "(default: 1000000)\n");
+  printf("  --runs <N>       Runs per join, fastest is reported (default: 3)\n");
+  printf("  --zipf <S>       Zipf exponent of the skewed probe keys "
+         "(default: 1.0)\n");
+  printf("  --budget-mb <N>  Memory budget of the spilling join in MB "
+         "(default: 1/8 of\n"
+         "                   the build side)\n");
+  printf("  --arena-mb <N>   Join arena size in MB (default: 512)\n");
+  printf("  --workers <N>    Worker threads for pradix and spill (default: "
+         "one per core)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 rows = 1000000;
+  u64 runs = 3;
+  f64 zipf = 1.0;
+  u64 budget_mb = 0;
+  u64 arena_mb = 512;
+  u64 workers = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--rows") == 0 && has_value) {
+      rows = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--runs") == 0 && has_value) {
+      runs = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--zipf") == 0 && has_value) {
+      zipf = strtod(argv[++i], NULL);
+    } else if (strcmp(arg, "--budget-mb") == 0 && has_value) {
+      budget_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--arena-mb") == 0 && has_value) {
+      arena_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--workers") == 0 && has_value) {
+      workers = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (rows == 0 || rows > UINT32_MAX / 4 || runs == 0 || runs > UINT32_MAX ||
+      !(zipf > 0.0) || arena_mb == 0 || workers > MAX_WORKER_THREADS) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  usize build_rows = (usize)rows;
+  usize probe_rows = 4 * build_rows;
+  usize data_size = build_rows * (BUILD_COLUMNS + 2) * sizeof(StringView) +
+                    probe_rows * (PROBE_COLUMNS + 1) * sizeof(i64) +
+                    (usize)64 * 1024;
+  Arena data_arena = arena_init(data_size);
+  Arena query_arena = arena_init((usize)arena_mb * 1024 * 1024);
+  Scheduler scheduler;
+  if (!sched_init(&scheduler, (u32)workers,
+                  (usize)DEFAULT_WORKER_ARENA_MB * 1024 * 1024)) {
+    arena_free_all(&data_arena);
+    arena_free_all(&query_arena);
+    return EXIT_FAILURE;
+  }
+  // The join charges about 68 bytes per build row (columns, key and table
+  // entries), so an eighth of that makes it spill early.
+  usize budget = budget_mb > 0 ? (usize)budget_mb * 1024 * 1024
+                               : build_rows * 68 / 8;
+  BenchSettings settings = {&scheduler, budget, (u32)runs};
+
+  printf("%zu build rows, %zu probe rows, %u workers, spill budget %zu KB\n",
+         build_rows, probe_rows, scheduler.worker_count, budget / 1024);
+  static const char *distributions[] = {"uniform", "zipf"};
+  bool ok = true;
+  for (usize d = 0; d < ARRAY_SIZE(distributions) && ok; ++d) {
+    arena_reset(&data_arena);
+    JoinData data;
+    ZERO_STRUCT(data);
+    if (!generate_data(&data_arena, &data, build_rows, probe_rows,
+                       d == 0 ? 0.0 : zipf)) {
+      ok = false;
+      break;
+    }
+    if (d == 0) {
+      printf("\nUniform probe keys\n");
+    } else {
+      printf("\nZipf probe keys (s = %.2f)\n", zipf);
+    }
+    OutputDigest expected;
+    for (usize j = 0; j < ARRAY_SIZE(g_joins) && ok; ++j) {
+      OutputDigest got;
+      ok = run_join(&g_joins[j], &query_arena, &data, &settings,
+                    j == 0 ? &expected : &got);
+      if (ok && j > 0 && !digests_equal(&got, &expected)) {
+        LOG_ERROR("%s differs from %s (%" PRIu64 " vs %" PRIu64 " rows)",
+                  g_joins[j].name, g_joins[0].name, got.rows, expected.rows);
+        ok = false;
+      }
+    }
+  }
+  if (ok) {
+    printf("\nEvery join matches the chained join\n");
+  }
+
+  sched_shutdown(&scheduler);
+  arena_free_all(&data_arena);
+  arena_free_all(&query_arena);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
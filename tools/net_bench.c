@@ -0,0 +1,341 @@
+// Load generator for the network front end. Opens a number of active
+// connections, each keeping a fixed number of requests in flight (closed
+// loop), plus optional idle connections that only sit open, and reports
+// throughput and request latency percentiles. Queries carry a different
+// literal every time, so after the first one they are plan cache hits.
+//
+// Start the server first, e.g. build/release/sqldb --port 5433, then:
+//
+// Usage: net_bench [--host <ip>] [--port N] [--connections N] [--idle N]
+//                  [--pipeline N] [--duration S] [--ping]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/network.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_MAX_PIPELINE 64
+#define BENCH_MAX_REQUEST 128
+#define BENCH_BUFFER_SIZE (BENCH_MAX_PIPELINE * NET_MAX_RESPONSE)
+#define BENCH_MAX_EVENTS 256
+
+typedef struct {
+  const char *host;
+  u16 port;
+  u32 connections;
+  u32 idle;
+  u32 pipeline;
+  f64 duration;
+  bool ping;
+} BenchOptions;
+
+typedef struct {
+  int fd;
+  u32 in_length;
+  u32 out_length;
+  u32 out_sent;
+  u32 in_flight;
+  u32 oldest; // Slot of sent_ns holding the oldest request in flight
+  u64 sent_ns[BENCH_MAX_PIPELINE];
+  u8 in[BENCH_BUFFER_SIZE];
+  u8 out[BENCH_BUFFER_SIZE];
+} ClientConnection;
+
+typedef struct {
+  Histogram latency_ns;
+  u64 responses;
+  u64 errors; // ERROR responses
+  u64 next_id; // Literal of the next query
+} BenchResult;
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+static void raise_fd_limit(u32 needed) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < needed) {
+    limit.rlim_cur = limit.rlim_max == RLIM_INFINITY
+                         ? needed
+                         : MIN((rlim_t)needed, limit.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+static int connect_to(const BenchOptions *opts) {
+  struct sockaddr_in addr;
+  ZERO_STRUCT(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(opts->port);
+  if (inet_pton(AF_INET, opts->host, &addr.sin_addr) != 1) {
+    LOG_ERROR("Invalid IPv4 address: %s", opts->host);
+    return -1;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR("Failed to create a socket: %s", strerror(errno));
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    LOG_ERROR("Failed to connect to %s:%u: %s", opts->host, opts->port,
+              strerror(errno));
+    close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+static void queue_request(ClientConnection *conn, const BenchOptions *opts,
+                          BenchResult *result) {
+  ASSERT(conn->in_flight < BENCH_MAX_PIPELINE);
+  u8 *frame = conn->out + conn->out_length;
+  u32 length = 0;
+  if (opts->ping) {
+    net_encode_header(frame, NET_MSG_PING, 0);
+  } else {
+    int written = snprintf((char *)frame + NET_FRAME_HEADER_SIZE,
+                           BENCH_MAX_REQUEST,
+                           "SELECT name, email FROM users WHERE id = %" PRIu64,
+                           result->next_id++ % 1000000);
+    length = (u32)MIN(written, BENCH_MAX_REQUEST - 1);
+    net_encode_header(frame, NET_MSG_QUERY, length);
+  }
+  conn->out_length += NET_FRAME_HEADER_SIZE + length;
+  u32 slot = (conn->oldest + conn->in_flight) % BENCH_MAX_PIPELINE;
+  conn->sent_ns[slot] = now_ns();
+  conn->in_flight++;
+}
+
+static bool flush_requests(ClientConnection *conn) {
+  while (conn->out_sent < conn->out_length) {
+    ssize_t n = send(conn->fd, conn->out + conn->out_sent,
+                     conn->out_length - conn->out_sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      conn->out_sent += (u32)n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    } else if (n < 0 && errno != EINTR) {
+      return false;
+    }
+  }
+  conn->out_length = 0;
+  conn->out_sent = 0;
+  return true;
+}
+
+// Reads every available response, recording the latency of each one and
+// sending a replacement request for it.
+static bool read_responses(ClientConnection *conn, const BenchOptions *opts,
+                           BenchResult *result) {
+  for (;;) {
+    ssize_t n = recv(conn->fd, conn->in + conn->in_length,
+                     BENCH_BUFFER_SIZE - conn->in_length, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    conn->in_length += (u32)n;
+    u32 offset = 0;
+    NetFrameHeader header;
+    u64 now = now_ns();
+    while (net_decode_header(conn->in + offset, conn->in_length - offset,
+                             &header) &&
+           conn->in_length - offset - NET_FRAME_HEADER_SIZE >= header.length) {
+      if (conn->in_flight == 0) {
+        LOG_ERROR("Unexpected %s response",
+                  net_message_type_name((NetMessageType)header.type));
+        return false;
+      }
+      histogram_record(&result->latency_ns, now - conn->sent_ns[conn->oldest]);
+      conn->oldest = (conn->oldest + 1) % BENCH_MAX_PIPELINE;
+      conn->in_flight--;
+      result->responses++;
+      result->errors += header.type == NET_MSG_ERROR;
+      offset += NET_FRAME_HEADER_SIZE + header.length;
+      queue_request(conn, opts, result);
+    }
+    memmove(conn->in, conn->in + offset, conn->in_length - offset);
+    conn->in_length -= offset;
+    if (!flush_requests(conn)) {
+      return false;
+    }
+  }
+}
+
+static bool run_bench(const BenchOptions *opts, BenchResult *result) {
+  int *idle_fds = (int *)calloc(MAX(opts->idle, 1), sizeof(int));
+  ClientConnection *conns = (ClientConnection *)calloc(
+      opts->connections, sizeof(ClientConnection));
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (!idle_fds || !conns || epoll_fd < 0) {
+    LOG_FATAL("Failed to allocate %u connections", opts->connections);
+  }
+
+  bool ok = true;
+  u32 idle_open = 0;
+  f64 idle_start = (f64)now_ns() / 1e9;
+  while (ok && idle_open < opts->idle) {
+    int fd = connect_to(opts);
+    ok = fd >= 0;
+    if (ok) {
+      idle_fds[idle_open++] = fd;
+    }
+  }
+  if (opts->idle > 0) {
+    printf("opened %u idle connections in %.2f s\n", idle_open,
+           (f64)now_ns() / 1e9 - idle_start);
+  }
+
+  u32 active_open = 0;
+  while (ok && active_open < opts->connections) {
+    ClientConnection *conn = &conns[active_open];
+    conn->fd = connect_to(opts);
+    if (conn->fd < 0) {
+      ok = false;
+      break;
+    }
+    active_open++;
+    fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                                .data.ptr = conn};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &event);
+  }
+
+  if (ok) {
+    for (u32 c = 0; c < active_open; ++c) {
+      for (u32 p = 0; p < opts->pipeline; ++p) {
+        queue_request(&conns[c], opts, result);
+      }
+    }
+    u64 start = now_ns();
+    u64 end = start + (u64)(opts->duration * 1e9);
+    struct epoll_event events[BENCH_MAX_EVENTS];
+    for (u64 now = start; now < end && ok; now = now_ns()) {
+      int count = epoll_wait(epoll_fd, events, BENCH_MAX_EVENTS, 100);
+      for (int i = 0; i < count && ok; ++i) {
+        ClientConnection *conn = (ClientConnection *)events[i].data.ptr;
+        ok = (events[i].events & EPOLLERR) == 0 &&
+             flush_requests(conn) && read_responses(conn, opts, result);
+      }
+    }
+    f64 seconds = (f64)(now_ns() - start) / 1e9;
+    Histogram *latency = &result->latency_ns;
+    printf("%11s %8s %10s %10s %10s %10s %10s %8s\n", "connections",
+           "pipeline", "QPS", "p50 us", "p99 us", "p99.9 us", "max us",
+           "errors");
+    printf("%11u %8u %10.0f %10.1f %10.1f %10.1f %10.1f %8" PRIu64 "\n",
+           active_open, opts->pipeline, (f64)result->responses / seconds,
+           (f64)histogram_percentile(latency, 50.0) / 1e3,
+           (f64)histogram_percentile(latency, 99.0) / 1e3,
+           (f64)histogram_percentile(latency, 99.9) / 1e3,
+           (f64)latency->max / 1e3, result->errors);
+  }
+
+  for (u32 c = 0; c < active_open; ++c) {
+    close(conns[c].fd);
+  }
+  for (u32 c = 0; c < idle_open; ++c) {
+    close(idle_fds[c]);
+  }
+  close(epoll_fd);
+  free(conns);
+  free(idle_fds);
+  return ok;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --host <ip>         Server address (default: 127.0.0.1)\n");
+  printf("  --port <N>          Server port (default: %d)\n", DEFAULT_PORT);
+  printf("  --connections <N>   Connections sending requests (default: "
+         "32)\n");
+  printf("  --idle <N>          Extra connections held open without "
+         "traffic (default: 0)\n");
+  printf("  --pipeline <N>      Requests in flight per connection "
+         "(default: 1, max %d)\n",
+         BENCH_MAX_PIPELINE);
+  printf("  --duration <S>      Seconds to run (default: 5)\n");
+  printf("  --ping              Send PING instead of QUERY requests\n");
+  printf("  -h, --help          Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts = {
+      .host = "127.0.0.1",
+      .port = DEFAULT_PORT,
+      .connections = 32,
+      .idle = 0,
+      .pipeline = 1,
+      .duration = 5.0,
+      .ping = false,
+  };
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--host") == 0 && has_value) {
+      opts.host = argv[++i];
+    } else if (strcmp(arg, "--port") == 0 && has_value) {
+      opts.port = (u16)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--connections") == 0 && has_value) {
+      opts.connections = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--idle") == 0 && has_value) {
+      opts.idle = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--pipeline") == 0 && has_value) {
+      opts.pipeline = (u32)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--duration") == 0 && has_value) {
+      opts.duration = strtod(argv[++i], NULL);
+    } else if (strcmp(arg, "--ping") == 0) {
+      opts.ping = true;
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (opts.port == 0 || opts.connections == 0 || opts.pipeline == 0 ||
+      opts.pipeline > BENCH_MAX_PIPELINE || opts.duration <= 0.0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  raise_fd_limit(opts.connections + opts.idle + 64);
+  printf("%s requests to %s:%u for %.1f s\n\n", opts.ping ? "PING" : "QUERY",
+         opts.host, opts.port, opts.duration);
+  BenchResult result;
+  ZERO_STRUCT(result);
+  histogram_init(&result.latency_ns);
+  bool ok = run_bench(&opts, &result);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+// Measures SQL parse throughput in queries per second. Each query of a small
+// mix, from short point lookups to a multi-way join, is parsed repeatedly into
+// an arena that is reset after every statement, the way the server recycles
+// Database.temp_arena.
+//
+// Usage: parse_bench [--iterations N] [--query <sql>]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/parser.h"
+
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_ARENA_SIZE (64 * 1024)
+
+typedef struct {
+  const char *name;
+  const char *sql;
+} BenchQuery;
+
+static const BenchQuery default_queries[] = {
+    {"point select", "SELECT name, email FROM users WHERE id = 42"},
+    {"point update", "UPDATE users SET balance = balance - 10 WHERE id = 42"},
+    {"insert", "INSERT INTO users (id, name, email, balance) VALUES "
+               "(42, 'alice', 'alice@example.com', 100.5)"},
+    {"delete", "DELETE FROM sessions WHERE expires_at < 1700000000"},
+    {"range + order", "SELECT id, total FROM orders WHERE customer_id = 7 "
+                      "AND total >= 100 ORDER BY created_at DESC LIMIT 20"},
+    {"join + group by",
+     "SELECT c.name, COUNT(*) AS orders, SUM(o.total) AS revenue "
+     "FROM customers c JOIN orders o ON o.customer_id = c.id "
+     "LEFT JOIN refunds r ON r.order_id = o.id "
+     "WHERE o.status = 'shipped' AND r.id IS NULL "
+     "GROUP BY c.name HAVING SUM(o.total) > 1000 "
+     "ORDER BY revenue DESC, c.name LIMIT 10"},
+    {"create table",
+     "CREATE TABLE IF NOT EXISTS users (id BIGINT PRIMARY KEY, "
+     "name VARCHAR(64) NOT NULL, email TEXT, balance REAL, active BOOLEAN)"},
+};
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// Parses 'sql' 'iterations' times and prints the rate. Returns false if the
+// query does not parse.
+static bool run_query(Arena *arena, const BenchQuery *query, u64 iterations,
+                      u64 *total_bytes) {
+  StringView sql = sv_from_cstr(query->sql);
+  SqlParseError error;
+  if (!sql_parse(arena, sql, &error)) {
+    LOG_ERROR("%s: %u:%u: %s", query->name, error.line, error.column,
+              error.message);
+    return false;
+  }
+  usize arena_bytes = arena->current_offset;
+  arena_reset(arena);
+
+  f64 start = now_seconds();
+  for (u64 i = 0; i < iterations; ++i) {
+    AstStatement *stmt = sql_parse(arena, sql, &error);
+    if (!stmt) {
+      LOG_FATAL("Parse failed on iteration %llu", (unsigned long long)i);
+    }
+    arena_reset(arena);
+  }
+  f64 seconds = now_seconds() - start;
+  printf("  %-16s %12.0f q/s %9.0f ns/q %8.1f MB/s %7zu B arena\n",
+         query->name, (f64)iterations / seconds, seconds * 1e9 /
+         (f64)iterations, (f64)(sql.length * iterations) / seconds / 1e6,
+         arena_bytes);
+  *total_bytes += sql.length;
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --iterations <N>   Parses per query (default: 1000000)\n");
+  printf("  --query <sql>      Benchmark this query instead of the "
+         "built-in mix\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 iterations = 1000000;
+  BenchQuery custom = {.name = "custom"};
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--iterations") == 0 && has_value) {
+      iterations = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--query") == 0 && has_value) {
+      custom.sql = argv[++i];
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (iterations == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  const BenchQuery *queries = custom.sql ? &custom : default_queries;
+  usize query_count = custom.sql ? 1 : ARRAY_SIZE(default_queries);
+  Arena arena = arena_init(BENCH_ARENA_SIZE);
+
+  printf("%llu parses per query\n", (unsigned long long)iterations);
+  u64 total_bytes = 0;
+  f64 start = now_seconds();
+  for (usize q = 0; q < query_count; ++q) {
+    if (!run_query(&arena, &queries[q], iterations, &total_bytes)) {
+      arena_free_all(&arena);
+      return EXIT_FAILURE;
+    }
+  }
+  f64 seconds = now_seconds() - start;
+  u64 parses = iterations * query_count;
+  printf("  %-16s %12.0f q/s %9.0f ns/q %8.1f MB/s\n", "overall",
+         (f64)parses / seconds, seconds * 1e9 / (f64)parses,
+         (f64)(total_bytes * iterations) / seconds / 1e6);
+
+  arena_free_all(&arena);
+  return EXIT_SUCCESS;
+}
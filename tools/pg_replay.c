@@ -0,0 +1,94 @@
+// Replays PostgreSQL protocol transcripts against a running server and checks
+// every reply byte for byte; tests/fixtures/pg_replay.h holds the built-in
+// transcripts and describes the transcript format.
+//
+// Start the server first, e.g. build/release/sqldb --port 5433, then:
+//
+// Usage: pg_replay [--host <ip>] [--port N] [--file <path>] [--trickle]
+//                  [--verbose]
+
+#define BASE_IMPLEMENTATION
+#include "../tests/fixtures/pg_replay.h"
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static char *read_file(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    LOG_ERROR("Cannot open %s: %s", path, strerror(errno));
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *text = size >= 0 ? (char *)malloc((usize)size + 1) : NULL;
+  if (text && fread(text, 1, (usize)size, file) != (usize)size) {
+    free(text);
+    text = NULL;
+  }
+  fclose(file);
+  if (!text) {
+    LOG_ERROR("Cannot read %s", path);
+    return NULL;
+  }
+  text[size] = '\0';
+  return text;
+}
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --host <ip>      Server address (default: 127.0.0.1)\n");
+  printf("  --port <N>       Server port (default: 5433)\n");
+  printf("  --file <path>    Replay this transcript instead of the built-in "
+         "ones\n");
+  printf("  --trickle        Send one byte at a time\n");
+  printf("  --verbose        Print every message received\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  ReplayOptions opts = {
+      .host = "127.0.0.1",
+      .port = 5433,
+      .trickle = false,
+      .verbose = false,
+      .quiet = false,
+  };
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--host") == 0 && has_value) {
+      opts.host = argv[++i];
+    } else if (strcmp(arg, "--port") == 0 && has_value) {
+      opts.port = (u16)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--file") == 0 && has_value) {
+      path = argv[++i];
+    } else if (strcmp(arg, "--trickle") == 0) {
+      opts.trickle = true;
+    } else if (strcmp(arg, "--verbose") == 0) {
+      opts.verbose = true;
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  char *transcript = NULL;
+  if (path && !(transcript = read_file(path))) {
+    return EXIT_FAILURE;
+  }
+  u32 failures =
+      run_transcript(&opts, transcript ? transcript : g_default_transcript);
+  free(transcript);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
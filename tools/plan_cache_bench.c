@@ -0,0 +1,183 @@
+// Measures statement preparation with and without the plan cache. The
+// workload draws from a fixed set of statement shapes (point selects, range
+// scans, updates, inserts and deletes over numbered tables and columns) and
+// fills every execution with fresh literals, the way an application repeats
+// a few hundred queries with different arguments. Without the cache each
+// statement is parsed; with it each is normalized, looked up and only parsed
+// the first time its shape is seen (or after it was evicted). Normalizing
+// still lexes the statement, so the gain is the parser's share of the work.
+//
+// Usage: plan_cache_bench [--executions N] [--shapes N] [--capacity N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/parser.h"
+#include "sqldb/plan_cache.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_TEMP_ARENA_SIZE (64 * 1024)
+#define BENCH_SQL_SIZE 512
+#define BENCH_TEMPLATE_COUNT 5
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Writes a statement of shape 'shape' with random literals into 'buffer'.
+// Returns the statement length.
+static usize make_statement(char *buffer, u32 shape, u64 *rng) {
+  u32 table = shape / BENCH_TEMPLATE_COUNT;
+  unsigned long long key = next_random(rng) % 1000000;
+  unsigned long long amount = next_random(rng) % 10000;
+  int length = 0;
+  switch (shape % BENCH_TEMPLATE_COUNT) {
+  case 0:
+    length = snprintf(buffer, BENCH_SQL_SIZE,
+                      "SELECT id, name, c%u FROM t%u WHERE id = %llu", table,
+                      table, key);
+    break;
+  case 1:
+    length = snprintf(buffer, BENCH_SQL_SIZE,
+                      "SELECT id, total FROM t%u WHERE c%u = %llu AND total "
+                      ">= %llu.5 ORDER BY created_at DESC LIMIT 20",
+                      table, table, key, amount);
+    break;
+  case 2:
+    length = snprintf(buffer, BENCH_SQL_SIZE,
+                      "UPDATE t%u SET balance = balance - %llu, note = "
+                      "'paid %llu' WHERE id = %llu",
+                      table, amount, key, key);
+    break;
+  case 3:
+    length = snprintf(buffer, BENCH_SQL_SIZE,
+                      "INSERT INTO t%u (id, c%u, email, balance) VALUES "
+                      "(%llu, 'user%llu', 'user%llu@example.com', %llu.25)",
+                      table, table, key, key, key, amount);
+    break;
+  default:
+    length = snprintf(buffer, BENCH_SQL_SIZE,
+                      "DELETE FROM t%u WHERE expires_at < %llu AND c%u = "
+                      "'stale'",
+                      table, key, table);
+    break;
+  }
+  return (usize)length;
+}
+
+// Runs 'executions' statements and returns the elapsed seconds.
+static f64 run(PlanCache *cache, Arena *temp, u64 executions, u32 shapes) {
+  char sql[BENCH_SQL_SIZE];
+  u64 rng = 0x9e3779b97f4a7c15ULL;
+  SqlParseError error;
+  f64 start = now_seconds();
+  for (u64 i = 0; i < executions; ++i) {
+    u32 shape = (u32)(next_random(&rng) % shapes);
+    StringView text = sv_from_parts(sql, make_statement(sql, shape, &rng));
+    bool ok;
+    if (cache) {
+      SqlParams params;
+      ok = plan_cache_prepare(cache, temp, text, &params, &error) != NULL;
+    } else {
+      ok = sql_parse(temp, text, &error) != NULL;
+    }
+    if (!ok) {
+      LOG_FATAL("%.*s: %u:%u: %s", (int)text.length, text.data, error.line,
+                error.column, error.message);
+    }
+    arena_reset(temp);
+  }
+  return now_seconds() - start;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --executions <N>   Statements to prepare (default: 2000000)\n");
+  printf("  --shapes <N>       Distinct statement shapes (default: 300)\n");
+  printf("  --capacity <N>     Plan cache entries (default: %d)\n",
+         DEFAULT_PLAN_CACHE_ENTRIES);
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 executions = 2000000;
+  u64 shapes = 300;
+  u64 capacity = DEFAULT_PLAN_CACHE_ENTRIES;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--executions") == 0 && has_value) {
+      executions = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--shapes") == 0 && has_value) {
+      shapes = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--capacity") == 0 && has_value) {
+      capacity = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (executions == 0 || shapes == 0 || shapes > UINT32_MAX ||
+      capacity == 0 || capacity >= PLAN_CACHE_NONE) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  Arena temp = arena_init(BENCH_TEMP_ARENA_SIZE);
+  Arena main_arena = arena_init(
+      plan_cache_required_arena_size(capacity, DEFAULT_PLAN_CACHE_ENTRY_SIZE));
+  PlanCache cache;
+  if (!plan_cache_init(&cache, &main_arena, capacity,
+                       DEFAULT_PLAN_CACHE_ENTRY_SIZE)) {
+    arena_free_all(&temp);
+    arena_free_all(&main_arena);
+    return EXIT_FAILURE;
+  }
+
+  printf("%llu executions over %llu shapes, %llu cache entries (%zu KB)\n",
+         (unsigned long long)executions, (unsigned long long)shapes,
+         (unsigned long long)capacity, main_arena.total_size / 1024);
+
+  f64 parse_seconds = run(NULL, &temp, executions, (u32)shapes);
+  printf("  %-12s %12.0f q/s %9.0f ns/q\n", "parse", (f64)executions /
+         parse_seconds, parse_seconds * 1e9 / (f64)executions);
+
+  f64 cache_seconds = run(&cache, &temp, executions, (u32)shapes);
+  printf("  %-12s %12.0f q/s %9.0f ns/q (%.2fx)\n", "plan cache",
+         (f64)executions / cache_seconds,
+         cache_seconds * 1e9 / (f64)executions, parse_seconds / cache_seconds);
+  printf("  %" PRIu64 " hits, %" PRIu64 " misses (hit ratio %.2f%%), %" PRIu64
+         " evictions, %" PRIu64 " uncacheable\n",
+         cache.stats.hits, cache.stats.misses,
+         plan_cache_hit_ratio(&cache) * 100.0, cache.stats.evictions,
+         cache.stats.uncacheable);
+
+  arena_free_all(&temp);
+  arena_free_all(&main_arena);
+  return EXIT_SUCCESS;
+}
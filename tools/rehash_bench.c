@@ -0,0 +1,115 @@
+// Measures the latency of single inserts into a growing BaseHashTableOA, with
+// every rehash done at once and with the incremental mode
+// (ht_oa_set_incremental). Both tables start at the default size and take
+// the same random u64 keys; each insert is timed on its own and the tail
+// percentiles show the stalls of moving the whole table.
+// tests/unit/test_hash_table.c checks that the two modes agree.
+//
+// Usage: rehash_bench [--keys N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static bool run(const char *name, const u64 *keys, usize count,
+                bool incremental) {
+  BaseHashTableOA ht = ht_oa_init(0, base_hash_u64, base_key_equal_u64, NULL);
+  ht_oa_set_incremental(&ht, incremental);
+  Histogram latency;
+  histogram_init(&latency);
+  u64 start = now_ns();
+  for (usize i = 0; i < count; ++i) {
+    u64 before = now_ns();
+    if (!ht_oa_insert(&ht, &keys[i], (void *)&keys[i])) {
+      LOG_ERROR("Insert %zu failed", i);
+      ht_oa_free(&ht);
+      return false;
+    }
+    histogram_record(&latency, now_ns() - before);
+  }
+  f64 seconds = (f64)(now_ns() - start) / 1e9;
+  printf("  %-16s %8.3f %8.1f %8" PRIu64 " %8" PRIu64 " %8" PRIu64
+         " %12" PRIu64 "\n",
+         name, seconds, histogram_mean(&latency),
+         histogram_percentile(&latency, 50.0),
+         histogram_percentile(&latency, 99.0),
+         histogram_percentile(&latency, 99.9), latency.max);
+  ht_oa_free(&ht);
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --keys <N>         Keys to insert (default: 4000000)\n");
+  printf("  -h, --help         Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 key_count = 4000000;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--keys") == 0 && has_value) {
+      key_count = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (key_count == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+
+  u64 *keys = (u64 *)malloc(key_count * sizeof(u64));
+  if (!keys) {
+    LOG_ERROR("Failed to allocate %" PRIu64 " keys", key_count);
+    return EXIT_FAILURE;
+  }
+  u64 rng = 0x9E3779B97F4A7C15ULL;
+  for (u64 i = 0; i < key_count; ++i) {
+    keys[i] = next_random(&rng);
+  }
+
+  printf("%" PRIu64 " inserts from %d buckets, %d buckets migrated and "
+         "%d bytes zeroed per operation\n",
+         key_count, BASE_HT_OA_DEFAULT_CAPACITY, BASE_HT_OA_MIGRATE_BUCKETS,
+         BASE_HT_OA_ZERO_BYTES);
+  printf("  %-16s %8s %8s %8s %8s %8s %12s\n", "rehash", "total s",
+         "mean ns", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+  bool ok = run("stop-the-world", keys, (usize)key_count, false) &&
+            run("incremental", keys, (usize)key_count, true);
+  free(keys);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,434 @@
+// Checks the SIMD kernels against their scalar versions, then measures them
+// in cycles per value at every level this CPU supports. The check covers all
+// comparison operators, lengths around the 64-value word boundaries, NaNs, and
+// selection bitmaps that are empty, full and random. Timings run each kernel
+// over a cache-resident batch many times; cycles are read from the time stamp
+// counter, which ticks at the nominal frequency rather than the current one.
+//
+// Usage: simd_bench [--values N] [--iterations N] [--selectivity PERCENT]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/simd.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+#define BENCH_IN_SET_SIZE 8
+
+typedef struct {
+  usize count;
+  i32 *i32s;
+  i64 *i64s;
+  f64 *f64s;
+  f64 *f64s_nan; // f64s with a NaN every 17 values
+  u64 *bits;     // Random selection
+  u64 *out;      // Bitmap output
+  i32 in_i32[BENCH_IN_SET_SIZE];
+  i64 in_i64[BENCH_IN_SET_SIZE];
+  f64 in_f64[BENCH_IN_SET_SIZE];
+} BenchData;
+
+typedef struct {
+  const char *name;
+  // Runs the kernel once over the whole batch and returns a value derived
+  // from its output, so the call cannot be optimized away.
+  u64 (*run)(const BenchData *data);
+} BenchKernel;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+#if !BENCH_HAS_TSC
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+#endif
+
+static u64 f64_bits(f64 value) {
+  u64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Values are uniform in [0, 1000), so a constant of 500 selects about half.
+static bool generate_data(BenchData *data, usize count, u32 selectivity) {
+  usize words = SIMD_BITMAP_WORDS(count);
+  data->count = count;
+  data->i32s = (i32 *)malloc(count * sizeof(i32));
+  data->i64s = (i64 *)malloc(count * sizeof(i64));
+  data->f64s = (f64 *)malloc(count * sizeof(f64));
+  data->f64s_nan = (f64 *)malloc(count * sizeof(f64));
+  data->bits = (u64 *)calloc(words, sizeof(u64));
+  data->out = (u64 *)calloc(words, sizeof(u64));
+  if (!data->i32s || !data->i64s || !data->f64s || !data->f64s_nan ||
+      !data->bits || !data->out) {
+    LOG_ERROR("Out of memory for %zu values", count);
+    return false;
+  }
+  for (usize i = 0; i < count; ++i) {
+    u64 r = rng_next();
+    data->i32s[i] = (i32)(r % 1000);
+    data->i64s[i] = (i64)((r >> 16) % 1000);
+    data->f64s[i] = (f64)((r >> 32) % 100000) / 100.0;
+    data->f64s_nan[i] = i % 17 == 5 ? NAN : data->f64s[i];
+    if (rng_next() % 100 < selectivity) {
+      data->bits[i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  for (u32 k = 0; k < BENCH_IN_SET_SIZE; ++k) {
+    data->in_i32[k] = (i32)(k * 97);
+    data->in_i64[k] = (i64)(k * 97);
+    data->in_f64[k] = data->f64s[(usize)k * 7 % count];
+  }
+  return true;
+}
+
+static void free_data(BenchData *data) {
+  free(data->i32s);
+  free(data->i64s);
+  free(data->f64s);
+  free(data->f64s_nan);
+  free(data->bits);
+  free(data->out);
+}
+
+// --- Verification ---
+
+// Runs 'call' (which writes to 'out') at the scalar level and at 'level' and
+// compares the bitmaps word for word. Both buffers start out garbage so every
+// word must be written.
+#define VERIFY_BITMAP(label, n, call)                                          \
+  do {                                                                         \
+    u64 *out = expected;                                                       \
+    memset(expected, 0xA5, sizeof(expected));                                  \
+    memset(actual, 0x5A, sizeof(actual));                                      \
+    simd_set_level(SIMD_LEVEL_SCALAR);                                         \
+    call;                                                                      \
+    out = actual;                                                              \
+    simd_set_level(level);                                                     \
+    call;                                                                      \
+    if (memcmp(expected, actual, SIMD_BITMAP_WORDS(n) * sizeof(u64)) != 0) {   \
+      LOG_ERROR("%s: %s differs from scalar for %zu values",                   \
+                simd_level_name(level), label, (usize)(n));                    \
+      return false;                                                            \
+    }                                                                          \
+    checks++;                                                                  \
+  } while (0)
+
+// Runs 'call' at both levels and compares its results with 'equal'.
+#define VERIFY_VALUE(label, T, n, call, equal)                                 \
+  do {                                                                         \
+    simd_set_level(SIMD_LEVEL_SCALAR);                                         \
+    T want = call;                                                             \
+    simd_set_level(level);                                                     \
+    T got = call;                                                              \
+    if (!(equal)) {                                                            \
+      LOG_ERROR("%s: %s differs from scalar for %zu values",                   \
+                simd_level_name(level), label, (usize)(n));                    \
+      return false;                                                            \
+    }                                                                          \
+    checks++;                                                                  \
+  } while (0)
+
+#define BENCH_VERIFY_MAX 1024
+
+static bool same_f64(f64 a, f64 b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+// Sums may be added in another order; allow for the rounding that causes.
+static bool close_f64(f64 a, f64 b) {
+  return fabs(a - b) <= 1e-9 * MAX(fabs(a), 1.0);
+}
+
+static bool verify_level(SimdLevel level, const BenchData *data,
+                         u64 *out_checks) {
+  static const usize counts[] = {0,  1,   3,   31,  63,  64,
+                                 65, 127, 128, 129, 777, BENCH_VERIFY_MAX};
+  u64 expected[SIMD_BITMAP_WORDS(BENCH_VERIFY_MAX)];
+  u64 actual[SIMD_BITMAP_WORDS(BENCH_VERIFY_MAX)];
+  u64 none[SIMD_BITMAP_WORDS(BENCH_VERIFY_MAX)];
+  u64 all[SIMD_BITMAP_WORDS(BENCH_VERIFY_MAX)];
+  u64 some[SIMD_BITMAP_WORDS(BENCH_VERIFY_MAX)];
+  memset(none, 0, sizeof(none));
+  u64 checks = 0;
+
+  for (usize c = 0; c < ARRAY_SIZE(counts); ++c) {
+    usize n = MIN(counts[c], data->count);
+    // Selections must not have bits past the last value.
+    memset(all, 0, sizeof(all));
+    memset(some, 0, sizeof(some));
+    for (usize i = 0; i < n; ++i) {
+      all[i / 64] |= 1ULL << (i % 64);
+      some[i / 64] |= data->bits[i / 64] & (1ULL << (i % 64));
+    }
+
+    for (int op = SIMD_CMP_EQUAL; op <= SIMD_CMP_GREATER_EQUAL; ++op) {
+      SimdCompare cmp = (SimdCompare)op;
+      VERIFY_BITMAP("select_i32", n,
+                    simd_select_i32(data->i32s, n, cmp, 500, out));
+      VERIFY_BITMAP("select_i64", n,
+                    simd_select_i64(data->i64s, n, cmp, 500, out));
+      VERIFY_BITMAP("select_f64", n,
+                    simd_select_f64(data->f64s_nan, n, cmp, 500.0, out));
+      VERIFY_BITMAP("select_f64 =", n,
+                    simd_select_f64(data->f64s, n, cmp, data->f64s[0], out));
+    }
+    VERIFY_BITMAP("between_i32", n,
+                  simd_between_i32(data->i32s, n, 250, 750, out));
+    VERIFY_BITMAP("between_i64", n,
+                  simd_between_i64(data->i64s, n, 250, 750, out));
+    VERIFY_BITMAP("between_f64", n,
+                  simd_between_f64(data->f64s_nan, n, 250.0, 750.0, out));
+    VERIFY_BITMAP("in_i32", n,
+                  simd_in_i32(data->i32s, n, data->in_i32, BENCH_IN_SET_SIZE,
+                              out));
+    VERIFY_BITMAP("in_i64", n,
+                  simd_in_i64(data->i64s, n, data->in_i64, BENCH_IN_SET_SIZE,
+                              out));
+    VERIFY_BITMAP("in_f64", n,
+                  simd_in_f64(data->f64s_nan, n, data->in_f64,
+                              BENCH_IN_SET_SIZE, out));
+
+    const u64 *selections[] = {NULL, some, none, all};
+    for (usize s = 0; s < ARRAY_SIZE(selections); ++s) {
+      const u64 *bits = selections[s];
+      VERIFY_VALUE("sum_i32", i64, n, simd_sum_i32(data->i32s, n, bits),
+                   want == got);
+      VERIFY_VALUE("sum_i64", i64, n, simd_sum_i64(data->i64s, n, bits),
+                   want == got);
+      VERIFY_VALUE("sum_f64", f64, n, simd_sum_f64(data->f64s, n, bits),
+                   close_f64(want, got));
+      VERIFY_VALUE("min_i32", i32, n, simd_min_i32(data->i32s, n, bits),
+                   want == got);
+      VERIFY_VALUE("max_i32", i32, n, simd_max_i32(data->i32s, n, bits),
+                   want == got);
+      VERIFY_VALUE("min_i64", i64, n, simd_min_i64(data->i64s, n, bits),
+                   want == got);
+      VERIFY_VALUE("max_i64", i64, n, simd_max_i64(data->i64s, n, bits),
+                   want == got);
+      VERIFY_VALUE("min_f64", f64, n, simd_min_f64(data->f64s_nan, n, bits),
+                   same_f64(want, got));
+      VERIFY_VALUE("max_f64", f64, n, simd_max_f64(data->f64s_nan, n, bits),
+                   same_f64(want, got));
+      if (bits) {
+        VERIFY_VALUE("bitmap_count", usize, n, simd_bitmap_count(bits, n),
+                     want == got);
+      }
+    }
+  }
+  *out_checks += checks;
+  return true;
+}
+
+// --- Timed kernels ---
+
+static u64 run_select_i32(const BenchData *d) {
+  simd_select_i32(d->i32s, d->count, SIMD_CMP_LESS, 500, d->out);
+  return d->out[0];
+}
+
+static u64 run_select_i64(const BenchData *d) {
+  simd_select_i64(d->i64s, d->count, SIMD_CMP_LESS, 500, d->out);
+  return d->out[0];
+}
+
+static u64 run_select_f64(const BenchData *d) {
+  simd_select_f64(d->f64s, d->count, SIMD_CMP_LESS, 500.0, d->out);
+  return d->out[0];
+}
+
+static u64 run_between_i64(const BenchData *d) {
+  simd_between_i64(d->i64s, d->count, 250, 750, d->out);
+  return d->out[0];
+}
+
+static u64 run_between_f64(const BenchData *d) {
+  simd_between_f64(d->f64s, d->count, 250.0, 750.0, d->out);
+  return d->out[0];
+}
+
+static u64 run_in_i64(const BenchData *d) {
+  simd_in_i64(d->i64s, d->count, d->in_i64, BENCH_IN_SET_SIZE, d->out);
+  return d->out[0];
+}
+
+static u64 run_sum_i32(const BenchData *d) {
+  return (u64)simd_sum_i32(d->i32s, d->count, NULL);
+}
+
+static u64 run_sum_i64(const BenchData *d) {
+  return (u64)simd_sum_i64(d->i64s, d->count, NULL);
+}
+
+static u64 run_sum_i64_selected(const BenchData *d) {
+  return (u64)simd_sum_i64(d->i64s, d->count, d->bits);
+}
+
+static u64 run_sum_f64(const BenchData *d) {
+  return f64_bits(simd_sum_f64(d->f64s, d->count, NULL));
+}
+
+static u64 run_sum_f64_selected(const BenchData *d) {
+  return f64_bits(simd_sum_f64(d->f64s, d->count, d->bits));
+}
+
+static u64 run_min_i32(const BenchData *d) {
+  return (u64)simd_min_i32(d->i32s, d->count, NULL);
+}
+
+static u64 run_min_i64(const BenchData *d) {
+  return (u64)simd_min_i64(d->i64s, d->count, NULL);
+}
+
+static u64 run_max_f64_selected(const BenchData *d) {
+  return f64_bits(simd_max_f64(d->f64s, d->count, d->bits));
+}
+
+static u64 run_bitmap_count(const BenchData *d) {
+  return simd_bitmap_count(d->bits, d->count);
+}
+
+static const BenchKernel g_kernels[] = {
+    {"select_i32 <", run_select_i32},
+    {"select_i64 <", run_select_i64},
+    {"select_f64 <", run_select_f64},
+    {"between_i64", run_between_i64},
+    {"between_f64", run_between_f64},
+    {"in_i64 (8)", run_in_i64},
+    {"sum_i32", run_sum_i32},
+    {"sum_i64", run_sum_i64},
+    {"sum_i64 sel", run_sum_i64_selected},
+    {"sum_f64", run_sum_f64},
+    {"sum_f64 sel", run_sum_f64_selected},
+    {"min_i32", run_min_i32},
+    {"min_i64", run_min_i64},
+    {"max_f64 sel", run_max_f64_selected},
+    {"bitmap_count", run_bitmap_count},
+};
+
+// Returns cycles (or nanoseconds without a TSC) per value.
+static f64 time_kernel(const BenchKernel *kernel, const BenchData *data,
+                       u64 iterations, u64 *sink) {
+  *sink += kernel->run(data); // Warm up
+#if BENCH_HAS_TSC
+  u64 start = __rdtsc();
+#else
+  f64 start = now_seconds();
+#endif
+  for (u64 i = 0; i < iterations; ++i) {
+    *sink += kernel->run(data);
+  }
+#if BENCH_HAS_TSC
+  f64 elapsed = (f64)(__rdtsc() - start);
+#else
+  f64 elapsed = (now_seconds() - start) * 1e9;
+#endif
+  return elapsed / ((f64)iterations * (f64)data->count);
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --values <N>          Values per batch (default: 4096)\n");
+  printf("  --iterations <N>      Timed runs per kernel (default: 20000)\n");
+  printf("  --selectivity <PCT>   Share of values selected for 'sel' kernels "
+         "(default: 50)\n");
+  printf("  -h, --help            Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 values = 4096;
+  u64 iterations = 20000;
+  u64 selectivity = 50;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--values") == 0 && has_value) {
+      values = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--iterations") == 0 && has_value) {
+      iterations = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--selectivity") == 0 && has_value) {
+      selectivity = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (values < BENCH_IN_SET_SIZE * 7 || values > UINT32_MAX ||
+      iterations == 0 || selectivity > 100) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  BenchData data;
+  ZERO_STRUCT(data);
+  if (!generate_data(&data, (usize)values, (u32)selectivity)) {
+    free_data(&data);
+    return EXIT_FAILURE;
+  }
+
+  SimdLevel best = simd_detect_level();
+  u64 checks = 0;
+  for (int level = SIMD_LEVEL_SSE42; level <= (int)best; ++level) {
+    if (!verify_level((SimdLevel)level, &data, &checks)) {
+      free_data(&data);
+      return EXIT_FAILURE;
+    }
+  }
+  printf("Verified %" PRIu64 " kernel calls against scalar (best level: %s)\n",
+         checks, simd_level_name(best));
+
+  printf("\n%" PRIu64 " values per batch, %s per value\n", values,
+         BENCH_HAS_TSC ? "TSC cycles" : "nanoseconds");
+  printf("%-14s", "kernel");
+  for (int level = SIMD_LEVEL_SCALAR; level <= (int)best; ++level) {
+    printf(" %9s", simd_level_name((SimdLevel)level));
+  }
+  printf("\n");
+
+  u64 sink = 0;
+  for (usize k = 0; k < ARRAY_SIZE(g_kernels); ++k) {
+    printf("%-14s", g_kernels[k].name);
+    for (int level = SIMD_LEVEL_SCALAR; level <= (int)best; ++level) {
+      simd_set_level((SimdLevel)level);
+      printf(" %9.3f", time_kernel(&g_kernels[k], &data, iterations, &sink));
+    }
+    printf("\n");
+  }
+  simd_set_level(best);
+  LOG_DEBUG("Checksum %" PRIu64, sink);
+
+  free_data(&data);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+// Measures the sort operator on generated tables holding 1x, 4x and 16x as
+// many rows as its memory budget can sort at once: at 1x the sort runs in
+// memory, above it the rows are cut into runs, spilled to temp files and
+// merged back. Each size is sorted on an integer key, a string key and a
+// (string DESC, integer) key pair, with and without the budget, and every
+// output is checked for order and against the input's digest.
+//
+// Usage: sort_bench [--budget-mb N] [--runs N] [--arena-mb N]
+
+#define BASE_IMPLEMENTATION
+#include "sqldb/core.h"
+#include "sqldb/executor.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+// =================================================================================================
+// :: Benchmark ::
+// =================================================================================================
+
+enum { T_KEY, T_PRICE, T_NAME, T_SEGMENT, TABLE_COLUMNS };
+
+// Bytes the sort charges per row of the table: its columns and two 16-byte
+// sort entries.
+#define SORT_ROW_BYTES (2 * sizeof(i64) + 2 * sizeof(StringView) + 2 * 16)
+
+typedef struct {
+  const char *name;
+  ExecSortKey keys[2];
+  u32 key_count;
+} BenchSort;
+
+static const BenchSort g_sorts[] = {
+    {"int", {{T_KEY, false}}, 1},
+    {"string", {{T_NAME, false}}, 1},
+    {"str+int", {{T_SEGMENT, true}, {T_KEY, false}}, 2},
+};
+
+typedef struct {
+  ExecTable table;
+  ExecVector columns[TABLE_COLUMNS];
+} SortData;
+
+// Order-independent digest of a table: its row count and the sum of every
+// column (string lengths for strings).
+typedef struct {
+  u64 rows;
+  f64 sums[TABLE_COLUMNS];
+} OutputDigest;
+
+static u64 g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u64 rng_next(void) {
+  g_rng_state ^= g_rng_state >> 12;
+  g_rng_state ^= g_rng_state << 25;
+  g_rng_state ^= g_rng_state >> 27;
+  return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static bool alloc_column(Arena *arena, ExecVector *column, ExecType type,
+                         usize rows) {
+  column->type = type;
+  usize size = type == EXEC_TYPE_STRING ? sizeof(StringView) : sizeof(i64);
+  column->i64s = (i64 *)arena_alloc(arena, MAX(rows, 1) * size);
+  return column->i64s != NULL;
+}
+
+// Keys repeat about four times, so stability matters. Names are 4 to 16
+// random lowercase letters; segments are one of five words.
+static bool generate_data(Arena *arena, SortData *data, usize rows) {
+  static const char *segments[] = {"AUTOMOBILE", "BUILDING", "FURNITURE",
+                                   "HOUSEHOLD", "MACHINERY"};
+  ExecVector *t = data->columns;
+  char *names = (char *)arena_alloc(arena, rows * 16);
+  bool ok = names &&
+            alloc_column(arena, &t[T_KEY], EXEC_TYPE_INT64, rows) &&
+            alloc_column(arena, &t[T_PRICE], EXEC_TYPE_FLOAT64, rows) &&
+            alloc_column(arena, &t[T_NAME], EXEC_TYPE_STRING, rows) &&
+            alloc_column(arena, &t[T_SEGMENT], EXEC_TYPE_STRING, rows);
+  if (!ok) {
+    return false;
+  }
+  for (usize i = 0; i < rows; ++i) {
+    t[T_KEY].i64s[i] = (i64)(rng_next() % MAX(rows / 4, 1)) - (i64)rows / 8;
+    t[T_PRICE].f64s[i] = (f64)(rng_next() % 1000000) / 100.0;
+    char *name = names + i * 16;
+    usize length = 4 + rng_next() % 13;
+    for (usize c = 0; c < length; ++c) {
+      name[c] = (char)('a' + rng_next() % 26);
+    }
+    t[T_NAME].strings[i] = sv_from_parts(name, length);
+    const char *segment = segments[rng_next() % ARRAY_SIZE(segments)];
+    t[T_SEGMENT].strings[i] = sv_from_parts(segment, strlen(segment));
+  }
+  data->table = (ExecTable){data->columns, TABLE_COLUMNS, rows};
+  return true;
+}
+
+static void digest_row(OutputDigest *digest, const ExecVector *columns,
+                       usize row) {
+  digest->rows++;
+  for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+    const ExecVector *column = &columns[c];
+    switch (column->type) {
+    case EXEC_TYPE_INT64:
+      digest->sums[c] += (f64)column->i64s[row];
+      break;
+    case EXEC_TYPE_FLOAT64:
+      digest->sums[c] += column->f64s[row];
+      break;
+    case EXEC_TYPE_STRING:
+      digest->sums[c] += (f64)column->strings[row].length;
+      break;
+    }
+  }
+}
+
+static bool digests_equal(const OutputDigest *a, const OutputDigest *b) {
+  if (a->rows != b->rows) {
+    return false;
+  }
+  for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+    if (fabs(a->sums[c] - b->sums[c]) > 1e-9 * MAX(fabs(b->sums[c]), 1.0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int compare_keys(const BenchSort *sort, const ExecVector *a,
+                        usize a_row, const ExecVector *b, usize b_row) {
+  for (u32 k = 0; k < sort->key_count; ++k) {
+    u32 column = sort->keys[k].column;
+    int cmp;
+    if (a[column].type == EXEC_TYPE_STRING) {
+      cmp = sv_compare(a[column].strings[a_row], b[column].strings[b_row]);
+    } else {
+      cmp = (a[column].i64s[a_row] > b[column].i64s[b_row]) -
+            (a[column].i64s[a_row] < b[column].i64s[b_row]);
+    }
+    if (cmp != 0) {
+      return sort->keys[k].is_descending ? -cmp : cmp;
+    }
+  }
+  return 0;
+}
+
+// Runs 'sort' 'runs' times with 'budget' (0: in memory), printing the fastest
+// run, and checks the last run's output against 'expected'.
+static bool run_sort(const BenchSort *sort, Arena *arena, const SortData *data,
+                     usize budget, u32 runs, const OutputDigest *expected) {
+  static const u32 columns[] = {T_KEY, T_PRICE, T_NAME, T_SEGMENT};
+  f64 best = INFINITY;
+  for (u32 run = 0; run < runs; ++run) {
+    arena_reset(arena);
+    ExecContext ctx = {.arena = arena, .has_error = false};
+    bool is_last = run + 1 == runs;
+    f64 start = now_seconds();
+    ExecOperator *root = exec_external_sort(
+        &ctx, exec_scan(&ctx, &data->table, columns, ARRAY_SIZE(columns)),
+        sort->keys, sort->key_count, budget);
+    if (!root) {
+      LOG_ERROR("Could not build sort %s", sort->name);
+      return false;
+    }
+
+    // The previous row is kept by value: its batch is gone once the next
+    // one arrives.
+    OutputDigest digest;
+    ZERO_STRUCT(digest);
+    ExecVector previous[TABLE_COLUMNS];
+    i64 previous_values[TABLE_COLUMNS];
+    char previous_bytes[TABLE_COLUMNS][16];
+    for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+      previous[c].type = data->columns[c].type;
+      previous[c].i64s = &previous_values[c];
+    }
+    StringView previous_strings[TABLE_COLUMNS];
+    bool is_ordered = true;
+    ExecBatch *batch;
+    while ((batch = exec_next(root)) != NULL) {
+      if (!is_last) {
+        continue;
+      }
+      for (u32 i = 0; i < batch->selected_count; ++i) {
+        u32 row = exec_batch_row(batch, i);
+        if (digest.rows > 0 &&
+            compare_keys(sort, previous, 0, batch->columns, row) > 0) {
+          is_ordered = false;
+        }
+        digest_row(&digest, batch->columns, row);
+        for (u32 c = 0; c < TABLE_COLUMNS; ++c) {
+          if (previous[c].type != EXEC_TYPE_STRING) {
+            previous_values[c] = batch->columns[c].i64s[row];
+            continue;
+          }
+          StringView value = batch->columns[c].strings[row];
+          memcpy(previous_bytes[c], value.data, MIN(value.length, 16));
+          previous_strings[c] =
+              sv_from_parts(previous_bytes[c], MIN(value.length, 16));
+          previous[c].strings = &previous_strings[c];
+        }
+      }
+    }
+    if (!is_last) {
+      best = MIN(best, now_seconds() - start);
+    }
+    exec_close(root);
+    if (ctx.has_error) {
+      LOG_ERROR("Sort %s failed", sort->name);
+      return false;
+    }
+    if (is_last) {
+      ExecSortStats stats = exec_sort_stats(root);
+      printf("  %-8s %-7s %10.2f ms %8.1f M rows/s %5u runs %3u passes "
+             "%10" PRIu64 " rows spilled, %zu KB\n",
+             sort->name, budget > 0 ? "budget" : "memory", best * 1e3,
+             (f64)data->table.row_count / best / 1e6, stats.runs,
+             stats.merge_passes, stats.spilled_rows,
+             arena->current_offset / 1024);
+      if (!is_ordered || !digests_equal(&digest, expected)) {
+        LOG_ERROR("Sort %s returned %s rows", sort->name,
+                  is_ordered ? "the wrong" : "unordered");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// =================================================================================================
+// :: Entry Point ::
+// =================================================================================================
+
+static void print_usage(const char *program_name) {
+  printf("Usage: %s [OPTIONS]\n", program_name);
+  printf("\nOptions:\n");
+  printf("  --budget-mb <N>  Sort memory budget in MB (default: 16)\n");
+  printf("  --runs <N>       Runs per sort, fastest is reported (default: 3)\n");
+  printf("  --arena-mb <N>   Query arena size in MB (default: 1024)\n");
+  printf("  -h, --help       Show this help message\n");
+}
+
+int main(int argc, char **argv) {
+  u64 budget_mb = 16;
+  u64 runs = 3;
+  u64 arena_mb = 1024;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (strcmp(arg, "--budget-mb") == 0 && has_value) {
+      budget_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--runs") == 0 && has_value) {
+      runs = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--arena-mb") == 0 && has_value) {
+      arena_mb = strtoull(argv[++i], NULL, 10);
+    } else {
+      LOG_ERROR("Unknown or incomplete option: %s", arg);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (budget_mb == 0 || budget_mb > 4096 || runs == 0 || runs > UINT32_MAX ||
+      arena_mb == 0) {
+    LOG_ERROR("Invalid benchmark parameters");
+    return EXIT_FAILURE;
+  }
+
+  g_log_level = LOG_LEVEL_WARNING;
+  usize budget = (usize)budget_mb * 1024 * 1024;
+  usize max_rows = 16 * (budget / SORT_ROW_BYTES);
+  usize data_size = max_rows * (TABLE_COLUMNS * sizeof(StringView) + 16) +
+                    (usize)64 * 1024;
+  Arena data_arena = arena_init(data_size);
+  Arena query_arena = arena_init((usize)arena_mb * 1024 * 1024);
+
+  static const u32 factors[] = {1, 4, 16};
+  bool ok = true;
+  for (usize f = 0; f < ARRAY_SIZE(factors) && ok; ++f) {
+    usize rows = factors[f] * (budget / SORT_ROW_BYTES);
+    arena_reset(&data_arena);
+    SortData data;
+    ZERO_STRUCT(data);
+    if (!generate_data(&data_arena, &data, rows)) {
+      ok = false;
+      break;
+    }
+    OutputDigest expected;
+    ZERO_STRUCT(expected);
+    for (usize row = 0; row < rows; ++row) {
+      digest_row(&expected, data.columns, row);
+    }
+    printf("\n%ux budget: %zu rows, %zu MB budget\n", factors[f], rows,
+           budget / (1024 * 1024));
+    for (usize s = 0; s < ARRAY_SIZE(g_sorts) && ok; ++s) {
+      ok = run_sort(&g_sorts[s], &query_arena, &data, 0, (u32)runs + 1,
+                    &expected) &&
+           run_sort(&g_sorts[s], &query_arena, &data, budget, (u32)runs + 1,
+                    &expected);
+    }
+  }
+  if (ok) {
+    printf("\nEvery sort returned its input in order\n");
+  }
+
+  arena_free_all(&data_arena);
+  arena_free_all(&query_arena);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}